@@ -0,0 +1,56 @@
+#include "bench_pinned.h"
+#include <stdbool.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#define TAG "BENCH"
+
+typedef struct {
+    void (*fn)(void *arg);
+    void *arg;
+    SemaphoreHandle_t done;
+} bench_job_t;
+
+static bool running = false;
+
+static void bench_task(void *arg)
+{
+    bench_job_t *job = arg;
+    job->fn(job->arg);
+    xSemaphoreGive(job->done);
+    vTaskDelete(NULL);
+}
+
+esp_err_t bench_run_pinned(const char *name, void (*fn)(void *arg), void *arg)
+{
+    if (running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    bench_job_t job = {
+        .fn = fn,
+        .arg = arg,
+        .done = xSemaphoreCreateBinary(),
+    };
+    if (job.done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    running = true;
+    if (xTaskCreatePinnedToCore(bench_task, name, BENCH_PINNED_STACK, &job,
+                                BENCH_PINNED_PRIORITY, NULL, BENCH_PINNED_CORE) != pdPASS) {
+        running = false;
+        vSemaphoreDelete(job.done);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // The job lives on this stack, so wait for the task whatever happens
+    while (xSemaphoreTake(job.done, pdMS_TO_TICKS(BENCH_PINNED_TIMEOUT_MS)) != pdTRUE) {
+        ESP_LOGW(TAG, "%s still running", name);
+    }
+    vSemaphoreDelete(job.done);
+    running = false;
+    return ESP_OK;
+}
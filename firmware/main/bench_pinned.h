@@ -0,0 +1,23 @@
+#ifndef BENCH_PINNED_H
+#define BENCH_PINNED_H
+
+#include "esp_err.h"
+
+// Runs a benchmark body in its own task on the LVGL handler core, above the
+// handler's priority, so a draw it measures is not interrupted by the
+// handler and the per-core perfmon counters count it. The caller blocks
+// until fn returns, however long that takes, since fn's argument usually
+// lives on the caller's stack; a warning is logged every
+// BENCH_PINNED_TIMEOUT_MS meanwhile.
+//
+// One benchmark at a time: ESP_ERR_INVALID_STATE while another one runs,
+// ESP_ERR_NO_MEM if the task could not be created.
+
+#define BENCH_PINNED_CORE       0       // LVGL handler core
+#define BENCH_PINNED_PRIORITY   10      // Above the LVGL handler
+#define BENCH_PINNED_STACK      4096
+#define BENCH_PINNED_TIMEOUT_MS 10000
+
+esp_err_t bench_run_pinned(const char *name, void (*fn)(void *arg), void *arg);
+
+#endif // BENCH_PINNED_H
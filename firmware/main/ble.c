@@ -14,613 +14,280 @@
 #include <string.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "driver/uart.h"
 
-#include "esp_bt.h"
 #include "nvs_flash.h"
-#include "esp_bt_device.h"
-#include "esp_gap_ble_api.h"
-#include "esp_gattc_api.h"
-#include "esp_gatt_defs.h"
-#include "esp_bt_main.h"
-#include "esp_system.h"
-#include "esp_gatt_common_api.h"
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 #include "target_config.h"
 #include "throttle.h"
 #include "ui_updater.h"
 #include "vesc_config.h"
+#include "telemetry.h"
+#include "telemetry_decode.h"
+#include "telemetry_schema.h"
+#include "stream.h"
+#include "latency_bench.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/semphr.h"
+#include "ble_transport.h"
+#include "espnow_link.h"
+#include "ble_ota.h"
+#include "ble_bench.h"
+#include "link_quality.h"
+#include "deadline_monitor.h"
+#include "throttle_map.h"
 #include "ble.h"
-#define DEVICE_NAME                 "GS-THUMB"
 #define GATTC_TAG                   "GATTC_SPP_DEMO"
 
-#define PROFILE_NUM                 1
-#define PROFILE_APP_ID              0
-#define BT_BD_ADDR_STR              "%02x:%02x:%02x:%02x:%02x:%02x"
-#define BT_BD_ADDR_HEX(addr)        addr[0],addr[1],addr[2],addr[3],addr[4],addr[5]
-#define ESP_GATT_SPP_SERVICE_UUID   0xABF0
-#define SCAN_ALL_THE_TIME           0
-
-struct gattc_profile_inst {
-    esp_gattc_cb_t gattc_cb;
-    uint16_t gattc_if;
-    uint16_t app_id;
-    uint16_t conn_id;
-    uint16_t service_start_handle;
-    uint16_t service_end_handle;
-    uint16_t char_handle;
-    esp_bd_addr_t remote_bda;
-};
-
-enum {
-    SPP_IDX_SVC,
-    SPP_IDX_SPP_DATA_RECV_VAL,
-    SPP_IDX_SPP_DATA_NTY_VAL,
-    SPP_IDX_SPP_DATA_NTF_CFG,
-    SPP_IDX_SPP_COMMAND_VAL,
-    SPP_IDX_SPP_STATUS_VAL,
-    SPP_IDX_SPP_STATUS_CFG,
-#ifdef SUPPORT_HEARTBEAT
-    SPP_IDX_SPP_HEARTBEAT_VAL,
-    SPP_IDX_SPP_HEARTBEAT_CFG,
-#endif
-    SPP_IDX_NB,
-};
-
 ///Declare static functions
-static void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
-static void esp_gattc_cb(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param);
-static void gattc_profile_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param);
 static void adc_send_task(void *pvParameters);
-static void log_rssi_task(void *pvParameters);
-
-/* One gatt-based profile one app_id and one gattc_if, this array will store the gattc_if returned by ESP_GATTS_REG_EVT */
-static struct gattc_profile_inst gl_profile_tab[PROFILE_NUM] = {
-    [PROFILE_APP_ID] = {
-        .gattc_cb = gattc_profile_event_handler,
-        .gattc_if = ESP_GATT_IF_NONE,       /* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
-    },
-};
-
-static esp_ble_scan_params_t ble_scan_params = {
-    .scan_type              = BLE_SCAN_TYPE_ACTIVE,
-    .own_addr_type          = BLE_ADDR_TYPE_PUBLIC,
-    .scan_filter_policy     = BLE_SCAN_FILTER_ALLOW_ALL,
-    .scan_interval          = 0x50,
-    .scan_window            = 0x30,
-    .scan_duplicate         = BLE_SCAN_DUPLICATE_DISABLE
-};
+static void link_stats_task(void *pvParameters);
 
 bool is_connect = false;
-static const char device_name[] = DEVICE_NAME;
-static uint16_t spp_conn_id = 0;
-static uint16_t spp_mtu_size = 23;
-static uint16_t cmd = 0;
-static uint16_t spp_srv_start_handle = 0;
-static uint16_t spp_srv_end_handle = 0;
-static uint16_t spp_gattc_if = 0xff;
-static char * notify_value_p = NULL;
-static int notify_value_offset = 0;
-static int notify_value_count = 0;
-static uint16_t count = SPP_IDX_NB;
-static esp_gattc_db_elem_t *db = NULL;
-static esp_ble_gap_cb_param_t scan_rst;
-static QueueHandle_t cmd_reg_queue = NULL;
 QueueHandle_t spp_uart_queue = NULL;
 
-#ifdef SUPPORT_HEARTBEAT
-static uint8_t  heartbeat_s[9] = {'E','s','p','r','e','s','s','i','f'};
-static QueueHandle_t cmd_heartbeat_queue = NULL;
-#endif
+// Merged snapshot behind the getters, all zero while disconnected
+static telemetry_snapshot_t latest = {0};
 
-static esp_bt_uuid_t spp_service_uuid = {
-    .len  = ESP_UUID_LEN_16,
-    .uuid = {.uuid16 = ESP_GATT_SPP_SERVICE_UUID,},
-};
+static int latest_rssi = 0;
+static uint8_t last_throttle_sent = 127;
+static uint32_t connect_count = 0;
+static uint32_t rejected_frame_count = 0;
+
+// Telemetry can arrive over BLE and ESP-NOW, one frame is handled at a time
+static SemaphoreHandle_t notify_mutex = NULL;
 
-static float latest_voltage = 0.0f;
-static int32_t latest_erpm = 0;
-static float latest_current_motor = 0.0f;
-static float latest_current_in = 0.0f;
+// Latest decoded frame of every source, merged into each published snapshot
+static telemetry_snapshot_t source_frames[TELEMETRY_SOURCE_COUNT];
+_Static_assert((int)TELEMETRY_SOURCE_COUNT == (int)BLE_MAX_LINKS, "telemetry sources follow the BLE links");
 
-static float bms_total_voltage = 0.0f;
-static float bms_current = 0.0f;
-static float bms_remaining_capacity = 0.0f;
-static float bms_nominal_capacity = 0.0f;
-static uint8_t bms_num_cells = 0;
-static float bms_cell_voltages[16] = {0};
+static const char *const link_names[BLE_MAX_LINKS] = { "primary", "secondary", "bms" };
+static ble_link_stats_t link_stats[BLE_MAX_LINKS];
+static int64_t link_last_rx_us[BLE_MAX_LINKS];
 
-static float latest_temp_mos = 0.0f;
-static float latest_temp_motor = 0.0f;
+// Key offered over BLE, kept until the receiver answers with its MAC
+static bool espnow_pairing_pending = false;
+static uint8_t espnow_pairing_key[ESPNOW_KEY_LEN];
+static uint8_t espnow_pairing_channel = 0;
 
 float get_latest_temp_mos(void)
 {
-    return latest_temp_mos;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_TEMP_MOS);
 }
 
 float get_latest_temp_motor(void)
 {
-    return latest_temp_motor;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_TEMP_MOTOR);
 }
 
-static void notify_event_handler(esp_ble_gattc_cb_param_t * p_data)
+static bool source_fresh(telemetry_source_t source, int64_t now)
 {
-    uint8_t handle = 0;
-
-    if(p_data->notify.is_notify == true){
-        ESP_LOGI(GATTC_TAG,"+NOTIFY:handle = %d,length = %d ", p_data->notify.handle, p_data->notify.value_len);
-    }else{
-        ESP_LOGI(GATTC_TAG,"+INDICATE:handle = %d,length = %d ", p_data->notify.handle, p_data->notify.value_len);
-    }
-
-    handle = p_data->notify.handle;
-    if(db == NULL) {
-        ESP_LOGE(GATTC_TAG, " %s db is NULL", __func__);
-        return;
-    }
-
-    if(handle == db[SPP_IDX_SPP_DATA_NTY_VAL].attribute_handle){
-        if(p_data->notify.value_len == 55) {  // Combined VESC (14) + BMS (41) data
-            // First process VESC data (first 14 bytes)
-            // temp_mos (bytes 0-1)
-            int16_t temp_mos = (p_data->notify.value[0] << 8) | p_data->notify.value[1];
-            latest_temp_mos = temp_mos / 100.0f;
-
-            // temp_motor (bytes 2-3)
-            int16_t temp_motor = (p_data->notify.value[2] << 8) | p_data->notify.value[3];
-            latest_temp_motor = temp_motor / 100.0f;
-
-            // current_motor (bytes 4-5)
-            int16_t current_motor = (p_data->notify.value[4] << 8) | p_data->notify.value[5];
-            latest_current_motor = current_motor / 100.0f;
-
-            // current_in (bytes 6-7)
-            int16_t current_in = (p_data->notify.value[6] << 8) | p_data->notify.value[7];
-            latest_current_in = current_in / 100.0f;
-
-            // rpm (bytes 8-11)
-            int32_t rpm_raw = ((int32_t)p_data->notify.value[8] << 24) |
-                             ((int32_t)p_data->notify.value[9] << 16) |
-                             ((int32_t)p_data->notify.value[10] << 8) |
-                             (int32_t)p_data->notify.value[11];
-
-
-            latest_erpm = rpm_raw;
-
-
-            // voltage (bytes 12-13)
-            int16_t voltage = (p_data->notify.value[12] << 8) | p_data->notify.value[13];
-            latest_voltage = voltage / 100.0f;
-
-            // total_voltage (bytes 14-15)
-            int16_t total_voltage = (p_data->notify.value[14] << 8) | p_data->notify.value[15];
-            bms_total_voltage = total_voltage / 100.0f;
-
-            // current (bytes 16-17)
-            int16_t bms_current_raw = (p_data->notify.value[16] << 8) | p_data->notify.value[17];
-            bms_current = bms_current_raw / 100.0f;
-
-            // remaining_capacity (bytes 18-19)
-            int16_t remaining_cap = (p_data->notify.value[18] << 8) | p_data->notify.value[19];
-            bms_remaining_capacity = remaining_cap / 100.0f;
-
-            // nominal_capacity (bytes 20-21)
-            int16_t nominal_cap = (p_data->notify.value[20] << 8) | p_data->notify.value[21];
-            bms_nominal_capacity = nominal_cap / 100.0f;
-
-            // num_cells (byte 22)
-            bms_num_cells = p_data->notify.value[22];
-
-            // cell_voltages (bytes 23-54, 16 cells * 2 bytes each)
-            for(int i = 0; i < bms_num_cells && i < 16; i++) {
-                int16_t cell_voltage = (p_data->notify.value[23 + i*2] << 8) | p_data->notify.value[24 + i*2];
-                bms_cell_voltages[i] = cell_voltage / 1000.0f;  // Convert to volts
-            }
-
-            ESP_LOGI(GATTC_TAG, "Combined Data Received:");
-            ESP_LOGI(GATTC_TAG, "VESC: V=%.2fV, RPM=%ld, Motor=%.2fA, In=%.2fA, TempMos=%.2f°C, TempMotor=%.2f°C",
-                    latest_voltage, latest_erpm, latest_current_motor, latest_current_in,
-                    latest_temp_mos, latest_temp_motor);
-            ESP_LOGI(GATTC_TAG, "BMS: Total V=%.2fV, Current=%.2fA, Remaining=%.2fAh, Cells=%d",
-                    bms_total_voltage, bms_current, bms_remaining_capacity, bms_num_cells);
-        } else {
-            ESP_LOGW(GATTC_TAG, "Unexpected data length: %d (expected 55)", p_data->notify.value_len);
-        }
-    }
+    int64_t rx_time = source_frames[source].rx_time_us;
+    return rx_time != 0 && now - rx_time <= TELEMETRY_SOURCE_STALE_US;
 }
 
-static void free_gattc_srv_db(void)
+static int16_t add_c100(int16_t a, int16_t b)
 {
-    is_connect = false;
-    spp_gattc_if = 0xff;
-    spp_conn_id = 0;
-    spp_mtu_size = 23;
-    cmd = 0;
-    spp_srv_start_handle = 0;
-    spp_srv_end_handle = 0;
-    notify_value_p = NULL;
-    notify_value_offset = 0;
-    notify_value_count = 0;
-    if(db){
-        free(db);
-        db = NULL;
-    }
+    int32_t sum = (int32_t)a + b;
+    return sum > INT16_MAX ? INT16_MAX : (sum < INT16_MIN ? INT16_MIN : (int16_t)sum);
 }
 
-static void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+// Frames from this source are published, the others are only merged in:
+// the primary, or while it is silent the second drive, then the BMS
+static telemetry_source_t pacing_source(int64_t now)
 {
-    uint8_t *adv_name = NULL;
-    uint8_t adv_name_len = 0;
-    esp_err_t err;
-
-    switch(event){
-    case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT: {
-        if((err = param->scan_param_cmpl.status) != ESP_BT_STATUS_SUCCESS){
-            ESP_LOGE(GATTC_TAG, "Scan param set failed: %s", esp_err_to_name(err));
-            break;
+    for (int source = 0; source < TELEMETRY_SOURCE_COUNT - 1; source++) {
+        if (source_fresh((telemetry_source_t)source, now)) {
+            return (telemetry_source_t)source;
         }
-        //the unit of the duration is second
-        uint32_t duration = 0xFFFF;
-        ESP_LOGI(GATTC_TAG, "Enable Ble Scan:during time %04" PRIx32 " minutes.",duration);
-        esp_ble_gap_start_scanning(duration);
-        break;
     }
-    case ESP_GAP_BLE_SCAN_START_COMPLETE_EVT:
-        //scan start complete event to indicate scan start successfully or failed
-        if ((err = param->scan_start_cmpl.status) != ESP_BT_STATUS_SUCCESS) {
-            ESP_LOGE(GATTC_TAG, "Scan start failed: %s", esp_err_to_name(err));
-            break;
-        }
-        ESP_LOGI(GATTC_TAG, "Scan start successfully");
-        break;
-    case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT:
-        if ((err = param->scan_stop_cmpl.status) != ESP_BT_STATUS_SUCCESS) {
-            ESP_LOGE(GATTC_TAG, "Scan stop failed: %s", esp_err_to_name(err));
-            break;
-        }
-        ESP_LOGI(GATTC_TAG, "Scan stop successfully");
-        if (is_connect == false) {
-            ESP_LOGI(GATTC_TAG, "Connect to the remote device.");
-            esp_ble_gattc_open(gl_profile_tab[PROFILE_APP_ID].gattc_if, scan_rst.scan_rst.bda, scan_rst.scan_rst.ble_addr_type, true);
+    return TELEMETRY_SOURCE_BMS;
+}
+
+// The primary frame is the base, or the received one while the primary is silent
+static void merge_sources(telemetry_source_t source, int64_t now, telemetry_snapshot_t *out)
+{
+    telemetry_source_t base = source_fresh(TELEMETRY_SOURCE_PRIMARY, now) ? TELEMETRY_SOURCE_PRIMARY : source;
+    *out = source_frames[base];
+    memset(out->source_time_us, 0, sizeof(out->source_time_us));
+    out->source_time_us[base] = source_frames[base].rx_time_us;
+
+    const telemetry_snapshot_t *second = &source_frames[TELEMETRY_SOURCE_SECONDARY];
+    if (base != TELEMETRY_SOURCE_SECONDARY && source_fresh(TELEMETRY_SOURCE_SECONDARY, now)) {
+        out->current_motor_c100 = add_c100(out->current_motor_c100, second->current_motor_c100);
+        out->current_in_c100 = add_c100(out->current_in_c100, second->current_in_c100);
+        if (second->temp_mos_c100 > out->temp_mos_c100) {
+            out->temp_mos_c100 = second->temp_mos_c100;
         }
-        break;
-    case ESP_GAP_BLE_SCAN_RESULT_EVT: {
-        esp_ble_gap_cb_param_t *scan_result = (esp_ble_gap_cb_param_t *)param;
-        switch (scan_result->scan_rst.search_evt) {
-        case ESP_GAP_SEARCH_INQ_RES_EVT:
-            adv_name = esp_ble_resolve_adv_data(scan_result->scan_rst.ble_adv, ESP_BLE_AD_TYPE_NAME_CMPL, &adv_name_len);
-
-            // Only print logs if the device name matches
-            if (adv_name != NULL && strncmp((char *)adv_name, device_name, adv_name_len) == 0) {
-                ESP_LOGI(GATTC_TAG, "Found device %s, RSSI: %d",
-                        device_name, scan_result->scan_rst.rssi);
-                memcpy(&scan_rst, scan_result, sizeof(esp_ble_gap_cb_param_t));
-                esp_ble_gap_stop_scanning();
-            }
-            break;
-        case ESP_GAP_SEARCH_INQ_CMPL_EVT:
-            break;
-        default:
-            break;
+        if (second->temp_motor_c100 > out->temp_motor_c100) {
+            out->temp_motor_c100 = second->temp_motor_c100;
         }
-        break;
+        out->source_time_us[TELEMETRY_SOURCE_SECONDARY] = second->rx_time_us;
     }
-    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
-        if ((err = param->adv_stop_cmpl.status) != ESP_BT_STATUS_SUCCESS){
-            ESP_LOGE(GATTC_TAG, "Adv stop failed: %s", esp_err_to_name(err));
-        }else {
-            ESP_LOGI(GATTC_TAG, "Stop adv successfully");
-        }
-        break;
-    case ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT:
-        if (param->read_rssi_cmpl.status == ESP_BT_STATUS_SUCCESS) {
-            int rssi = param->read_rssi_cmpl.rssi;
-            ui_update_connection_quality(rssi);
-            //printf("Connection Quality: %d%% (RSSI: %d dBm)\n", connection_quality, rssi);
-        } else {
-            ESP_LOGE(GATTC_TAG, "RSSI read failed: %d", param->read_rssi_cmpl.status);
-        }
-        break;
-    default:
-        break;
+
+    const telemetry_snapshot_t *bms = &source_frames[TELEMETRY_SOURCE_BMS];
+    if (base != TELEMETRY_SOURCE_BMS && source_fresh(TELEMETRY_SOURCE_BMS, now)) {
+        out->bms_voltage_c100 = bms->bms_voltage_c100;
+        out->bms_current_c100 = bms->bms_current_c100;
+        out->bms_remaining_c100 = bms->bms_remaining_c100;
+        out->bms_nominal_c100 = bms->bms_nominal_c100;
+        out->bms_num_cells = bms->bms_num_cells;
+        memcpy(out->cell_mv, bms->cell_mv, sizeof(out->cell_mv));
+        out->source_time_us[TELEMETRY_SOURCE_BMS] = bms->rx_time_us;
     }
+
+    out->rx_time_us = now;
+    out->source = source;
 }
 
-static void esp_gattc_cb(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param)
+static void handle_frame(telemetry_source_t source, const uint8_t *data, size_t len)
 {
-    ESP_LOGI(GATTC_TAG, "EVT %d, gattc if %d", event, gattc_if);
-
-    /* If event is register event, store the gattc_if for each profile */
-    if (event == ESP_GATTC_REG_EVT) {
-        if (param->reg.status == ESP_GATT_OK) {
-            gl_profile_tab[param->reg.app_id].gattc_if = gattc_if;
-        } else {
-            ESP_LOGI(GATTC_TAG, "Reg app failed, app_id %04x, status %d", param->reg.app_id, param->reg.status);
+    telemetry_snapshot_t frame = {0};
+    if(telemetry_decode_frame(data, len, &frame)) {
+        int64_t now = esp_timer_get_time();
+        frame.rx_time_us = now;
+        source_frames[source] = frame;
+        link_stats[source].rx_frames++;
+
+        // One snapshot per pacing frame, so consumers see the primary's rate
+        // rather than the sum of all links
+        if (source != pacing_source(now)) {
             return;
         }
-    }
-    /* If the gattc_if equal to profile A, call profile A cb handler,
-     * so here call each profile's callback */
-    do {
-        int idx;
-        for (idx = 0; idx < PROFILE_NUM; idx++) {
-            if (gattc_if == ESP_GATT_IF_NONE || /* ESP_GATT_IF_NONE, not specify a certain gatt_if, need to call every profile cb function */
-                    gattc_if == gl_profile_tab[idx].gattc_if) {
-                if (gl_profile_tab[idx].gattc_cb) {
-                    gl_profile_tab[idx].gattc_cb(event, gattc_if, param);
-                }
-            }
-        }
-    } while (0);
-}
 
-static void gattc_profile_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param)
-{
-    esp_ble_gattc_cb_param_t *p_data = (esp_ble_gattc_cb_param_t *)param;
+        telemetry_snapshot_t snapshot;
+        merge_sources(source, now, &snapshot);
 
-    switch (event) {
-    case ESP_GATTC_REG_EVT:
-        ESP_LOGI(GATTC_TAG, "REG EVT, set scan params");
-        esp_ble_gap_set_scan_params(&ble_scan_params);
-        break;
-    case ESP_GATTC_CONNECT_EVT:
-        ESP_LOGI(GATTC_TAG, "ESP_GATTC_CONNECT_EVT: conn_id=%d, gatt_if = %d", spp_conn_id, gattc_if);
-        ESP_LOGI(GATTC_TAG, "REMOTE BDA:");
-        esp_log_buffer_hex(GATTC_TAG, gl_profile_tab[PROFILE_APP_ID].remote_bda, sizeof(esp_bd_addr_t));
-        spp_gattc_if = gattc_if;
-        is_connect = true;
-        spp_conn_id = p_data->connect.conn_id;
-        memcpy(gl_profile_tab[PROFILE_APP_ID].remote_bda, p_data->connect.remote_bda, sizeof(esp_bd_addr_t));
-        esp_ble_gattc_search_service(spp_gattc_if, spp_conn_id, &spp_service_uuid);
-        break;
-    case ESP_GATTC_DISCONNECT_EVT:
-        ESP_LOGI(GATTC_TAG, "disconnect");
-
-        // Reset speed and battery values to 0 when disconnected
-        latest_erpm = 0;
-        latest_voltage = 0.0f;
-        latest_current_motor = 0.0f;
-        latest_current_in = 0.0f;
-        latest_temp_mos = 0.0f;
-        latest_temp_motor = 0.0f;
-
-        // Reset BMS battery values to 0
-        bms_total_voltage = 0.0f;
-        bms_current = 0.0f;
-        bms_remaining_capacity = 0.0f;
-        bms_nominal_capacity = 0.0f;
-        bms_num_cells = 0;
-
-        // Clear cell voltages array
-        memset(bms_cell_voltages, 0, sizeof(bms_cell_voltages));
-
-        ESP_LOGI(GATTC_TAG, "Speed and battery values reset to 0 due to disconnection");
-
-        // Trigger UI updates to show 0 values
-        ui_update_speed(0);
-        ui_update_skate_battery_percentage(0);
-
-        free_gattc_srv_db();
-        esp_ble_gap_start_scanning(SCAN_ALL_THE_TIME);
-        break;
-    case ESP_GATTC_SEARCH_RES_EVT:
-        ESP_LOGI(GATTC_TAG, "ESP_GATTC_SEARCH_RES_EVT: start_handle = %d, end_handle = %d, UUID:0x%04x",p_data->search_res.start_handle,p_data->search_res.end_handle,p_data->search_res.srvc_id.uuid.uuid.uuid16);
-        spp_srv_start_handle = p_data->search_res.start_handle;
-        spp_srv_end_handle = p_data->search_res.end_handle;
-        break;
-    case ESP_GATTC_SEARCH_CMPL_EVT:
-        ESP_LOGI(GATTC_TAG, "SEARCH_CMPL: conn_id = %x, status %d", spp_conn_id, p_data->search_cmpl.status);
-        esp_ble_gattc_send_mtu_req(gattc_if, spp_conn_id);
-        break;
-    case ESP_GATTC_REG_FOR_NOTIFY_EVT: {
-        ESP_LOGI(GATTC_TAG,"Index = %d,status = %d,handle = %d",cmd, p_data->reg_for_notify.status, p_data->reg_for_notify.handle);
-        if(p_data->reg_for_notify.status != ESP_GATT_OK){
-            ESP_LOGE(GATTC_TAG, "ESP_GATTC_REG_FOR_NOTIFY_EVT, status = %d", p_data->reg_for_notify.status);
-            break;
-        }
-        uint16_t notify_en = 1;
-        esp_ble_gattc_write_char_descr(
-                spp_gattc_if,
-                spp_conn_id,
-                (db+cmd+1)->attribute_handle,
-                sizeof(notify_en),
-                (uint8_t *)&notify_en,
-                ESP_GATT_WRITE_TYPE_NO_RSP,
-                ESP_GATT_AUTH_REQ_NONE);
-
-        break;
-    }
-    case ESP_GATTC_NOTIFY_EVT:
-        ESP_LOGI(GATTC_TAG,"ESP_GATTC_NOTIFY_EVT");
-        notify_event_handler(p_data);
-        break;
-    case ESP_GATTC_READ_CHAR_EVT:
-        ESP_LOGI(GATTC_TAG,"ESP_GATTC_READ_CHAR_EVT");
-        break;
-    case ESP_GATTC_WRITE_CHAR_EVT:
-        ESP_LOGI(GATTC_TAG,"ESP_GATTC_WRITE_CHAR_EVT:status = %d,handle = %d", param->write.status, param->write.handle);
-        if(param->write.status != ESP_GATT_OK){
-            ESP_LOGE(GATTC_TAG, "ESP_GATTC_WRITE_CHAR_EVT, error status = %d", p_data->write.status);
-            break;
-        }
-        break;
-    case ESP_GATTC_PREP_WRITE_EVT:
-        break;
-    case ESP_GATTC_EXEC_EVT:
-        break;
-    case ESP_GATTC_WRITE_DESCR_EVT:
-        ESP_LOGI(GATTC_TAG,"ESP_GATTC_WRITE_DESCR_EVT: status =%d,handle = %d", p_data->write.status, p_data->write.handle);
-        if(p_data->write.status != ESP_GATT_OK){
-            ESP_LOGE(GATTC_TAG, "ESP_GATTC_WRITE_DESCR_EVT, error status = %d", p_data->write.status);
-            break;
-        }
-        switch(cmd){
-        case SPP_IDX_SPP_DATA_NTY_VAL:
-            cmd = SPP_IDX_SPP_STATUS_VAL;
-            xQueueSend(cmd_reg_queue, &cmd,10/portTICK_PERIOD_MS);
-            break;
-        case SPP_IDX_SPP_STATUS_VAL:
-#ifdef SUPPORT_HEARTBEAT
-            cmd = SPP_IDX_SPP_HEARTBEAT_VAL;
-            xQueueSend(cmd_reg_queue, &cmd, 10/portTICK_PERIOD_MS);
-#endif
-            break;
-#ifdef SUPPORT_HEARTBEAT
-        case SPP_IDX_SPP_HEARTBEAT_VAL:
-            xQueueSend(cmd_heartbeat_queue, &cmd, 10/portTICK_PERIOD_MS);
-            break;
-#endif
-        default:
-            break;
-        };
-        break;
-    case ESP_GATTC_CFG_MTU_EVT:
-        if(p_data->cfg_mtu.status != ESP_OK){
-            break;
-        }
-        ESP_LOGI(GATTC_TAG,"+MTU:%d", p_data->cfg_mtu.mtu);
-        spp_mtu_size = p_data->cfg_mtu.mtu;
+        latest = snapshot;
+        telemetry_publish(&snapshot);
 
-        db = (esp_gattc_db_elem_t *)malloc(count*sizeof(esp_gattc_db_elem_t));
-        if(db == NULL){
-            ESP_LOGE(GATTC_TAG,"%s:malloc db failed",__func__);
-            break;
-        }
-        if(esp_ble_gattc_get_db(spp_gattc_if, spp_conn_id, spp_srv_start_handle, spp_srv_end_handle, db, &count) != ESP_GATT_OK){
-            ESP_LOGE(GATTC_TAG,"%s:get db failed",__func__);
-            break;
-        }
-        if(count != SPP_IDX_NB){
-            ESP_LOGE(GATTC_TAG,"%s:get db count != SPP_IDX_NB, count = %d, SPP_IDX_NB = %d",__func__,count,SPP_IDX_NB);
-            break;
+        // Formatting the line is not free, skip it at the default level
+        if (esp_log_level_get(GATTC_TAG) >= ESP_LOG_INFO) {
+            char line[TELEMETRY_LINE_LEN];
+            telemetry_format_line(line, sizeof(line), &snapshot);
+            ESP_LOGI(GATTC_TAG, "Combined data from %s: %s", link_names[source], line);
         }
-        for(int i = 0;i < SPP_IDX_NB;i++){
-            switch((db+i)->type){
-            case ESP_GATT_DB_PRIMARY_SERVICE:
-                ESP_LOGI(GATTC_TAG,"attr_type = PRIMARY_SERVICE,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
-                        (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
-                break;
-            case ESP_GATT_DB_SECONDARY_SERVICE:
-                ESP_LOGI(GATTC_TAG,"attr_type = SECONDARY_SERVICE,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
-                        (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
-                break;
-            case ESP_GATT_DB_CHARACTERISTIC:
-                ESP_LOGI(GATTC_TAG,"attr_type = CHARACTERISTIC,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
-                        (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
-                break;
-            case ESP_GATT_DB_DESCRIPTOR:
-                ESP_LOGI(GATTC_TAG,"attr_type = DESCRIPTOR,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
-                        (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
-                break;
-            case ESP_GATT_DB_INCLUDED_SERVICE:
-                ESP_LOGI(GATTC_TAG,"attr_type = INCLUDED_SERVICE,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
-                        (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
-                break;
-            case ESP_GATT_DB_ALL:
-                ESP_LOGI(GATTC_TAG,"attr_type = ESP_GATT_DB_ALL,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
-                        (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
-                break;
-            default:
-                break;
-            }
-        }
-        cmd = SPP_IDX_SPP_DATA_NTY_VAL;
-        xQueueSend(cmd_reg_queue, &cmd, 10/portTICK_PERIOD_MS);
-        break;
-    case ESP_GATTC_SRVC_CHG_EVT:
-        break;
-    default:
-        break;
+    } else {
+        rejected_frame_count++;
+        link_stats[source].rx_rejected++;
+        ESP_LOGW(GATTC_TAG, "Unexpected data length: %d (expected %d, or %d plus 2 per cell)",
+                 (int)len, TELEMETRY_FRAME_LEN, TELEMETRY_FRAME_CELLS_OFS);
     }
 }
 
-void spp_client_reg_task(void* arg)
+static void handle_notify(ble_link_t link, const uint8_t *data, size_t len)
 {
-    uint16_t cmd_id;
-    for(;;) {
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-        if(xQueueReceive(cmd_reg_queue, &cmd_id, portMAX_DELAY)) {
-            if(db != NULL) {
-                if(cmd_id == SPP_IDX_SPP_DATA_NTY_VAL){
-                    ESP_LOGI(GATTC_TAG,"Index = %d,UUID = 0x%04x, handle = %d", cmd_id, (db+SPP_IDX_SPP_DATA_NTY_VAL)->uuid.uuid.uuid16, (db+SPP_IDX_SPP_DATA_NTY_VAL)->attribute_handle);
-                    esp_ble_gattc_register_for_notify(spp_gattc_if, gl_profile_tab[PROFILE_APP_ID].remote_bda, (db+SPP_IDX_SPP_DATA_NTY_VAL)->attribute_handle);
-                }else if(cmd_id == SPP_IDX_SPP_STATUS_VAL){
-                    ESP_LOGI(GATTC_TAG,"Index = %d,UUID = 0x%04x, handle = %d", cmd_id, (db+SPP_IDX_SPP_STATUS_VAL)->uuid.uuid.uuid16, (db+SPP_IDX_SPP_STATUS_VAL)->attribute_handle);
-                    esp_ble_gattc_register_for_notify(spp_gattc_if, gl_profile_tab[PROFILE_APP_ID].remote_bda, (db+SPP_IDX_SPP_STATUS_VAL)->attribute_handle);
-                }
-#ifdef SUPPORT_HEARTBEAT
-                else if(cmd_id == SPP_IDX_SPP_HEARTBEAT_VAL){
-                    ESP_LOGI(GATTC_TAG,"Index = %d,UUID = 0x%04x, handle = %d", cmd_id, (db+SPP_IDX_SPP_HEARTBEAT_VAL)->uuid.uuid.uuid16, (db+SPP_IDX_SPP_HEARTBEAT_VAL)->attribute_handle);
-                    esp_ble_gattc_register_for_notify(spp_gattc_if, gl_profile_tab[PROFILE_APP_ID].remote_bda, (db+SPP_IDX_SPP_HEARTBEAT_VAL)->attribute_handle);
-                }
-#endif
-            }
-        }
-    }
-}
+    link_stats[link].rx_bytes += len;
+    link_last_rx_us[link] = esp_timer_get_time();
+    link_quality_on_notify(link);
 
-#ifdef SUPPORT_HEARTBEAT
-void spp_heart_beat_task(void * arg)
-{
-    uint16_t cmd_id;
-
-    for(;;) {
-        vTaskDelay(50 / portTICK_PERIOD_MS);
-        if(xQueueReceive(cmd_heartbeat_queue, &cmd_id, portMAX_DELAY)) {
-            while(1){
-                if((is_connect == true) && (db != NULL) && ((db+SPP_IDX_SPP_HEARTBEAT_VAL)->properties & (ESP_GATT_CHAR_PROP_BIT_WRITE_NR | ESP_GATT_CHAR_PROP_BIT_WRITE))){
-                    esp_ble_gattc_write_char( spp_gattc_if,
-                                              spp_conn_id,
-                                              (db+SPP_IDX_SPP_HEARTBEAT_VAL)->attribute_handle,
-                                              sizeof(heartbeat_s),
-                                              (uint8_t *)heartbeat_s,
-                                              ESP_GATT_WRITE_TYPE_NO_RSP,
-                                              ESP_GATT_AUTH_REQ_NONE);
-                    vTaskDelay(5000 / portTICK_PERIOD_MS);
-                }else{
-                    ESP_LOGI(GATTC_TAG,"disconnect");
-                    break;
-                }
-            }
-        }
+    // The receiver may notify on both links, ESP-NOW wins while it is up
+    if (link == BLE_LINK_PRIMARY && espnow_link_active()) {
+        return;
     }
+    xSemaphoreTake(notify_mutex, portMAX_DELAY);
+    handle_frame((telemetry_source_t)link, data, len);
+    xSemaphoreGive(notify_mutex);
 }
-#endif
 
-void ble_client_appRegister(void)
+static void handle_espnow_telemetry(const uint8_t *data, size_t len)
 {
-    esp_err_t status;
-    char err_msg[20];
+    xSemaphoreTake(notify_mutex, portMAX_DELAY);
+    handle_frame(TELEMETRY_SOURCE_PRIMARY, data, len);
+    xSemaphoreGive(notify_mutex);
+}
 
-    ESP_LOGI(GATTC_TAG, "register callback");
+static void handle_status(ble_link_t link, const uint8_t *data, size_t len)
+{
+    link_stats[link].rx_bytes += len;
+    link_last_rx_us[link] = esp_timer_get_time();
 
-    //register the scan callback function to the gap module
-    if ((status = esp_ble_gap_register_callback(esp_gap_cb)) != ESP_OK) {
-        ESP_LOGE(GATTC_TAG, "gap register error: %s", esp_err_to_name_r(status, err_msg, sizeof(err_msg)));
+    // Firmware updates and pairing only concern the primary receiver
+    if (link != BLE_LINK_PRIMARY) {
         return;
     }
-    //register the callback function to the gattc module
-    if ((status = esp_ble_gattc_register_callback(esp_gattc_cb)) != ESP_OK) {
-        ESP_LOGE(GATTC_TAG, "gattc register error: %s", esp_err_to_name_r(status, err_msg, sizeof(err_msg)));
+    if (len > 0 && data[0] == BLE_OTA_MAGIC) {
+        ble_ota_handle_message(data, len);
         return;
     }
-    esp_ble_gattc_app_register(PROFILE_APP_ID);
+    if (ble_bench_on_status(data, len)) {
+        return;
+    }
+
+    uint8_t peer_mac[ESPNOW_MAC_LEN];
+    if (!espnow_pairing_pending || !espnow_pair_answer_decode(data, len, peer_mac)) {
+        return;
+    }
+    esp_err_t ret = espnow_link_pair(peer_mac, espnow_pairing_key, espnow_pairing_channel);
+    memset(espnow_pairing_key, 0, sizeof(espnow_pairing_key));
+    espnow_pairing_pending = false;
+    if (ret != ESP_OK) {
+        ESP_LOGE(GATTC_TAG, "ESP-NOW pairing failed: %s", esp_err_to_name(ret));
+    }
+}
+
+static void handle_connected(ble_link_t link)
+{
+    ESP_LOGI(GATTC_TAG, "Connected to the %s peer over %s", link_names[link], ble_transport_name());
+    link_stats[link].connected = true;
+    link_stats[link].connects++;
+    link_quality_on_connected(link);
+    if (link == BLE_LINK_PRIMARY) {
+        is_connect = true;
+        connect_count++;
+    }
+}
 
-    esp_err_t local_mtu_ret = esp_ble_gatt_set_local_mtu(200);
-    if (local_mtu_ret){
-        ESP_LOGE(GATTC_TAG, "set local  MTU failed: %s", esp_err_to_name_r(local_mtu_ret, err_msg, sizeof(err_msg)));
+static void handle_disconnected(ble_link_t link)
+{
+    ESP_LOGI(GATTC_TAG, "disconnect %s", link_names[link]);
+    link_stats[link].connected = false;
+    link_quality_on_disconnected(link);
+
+    // Drops out of the merge, the next frame from another source shows it
+    xSemaphoreTake(notify_mutex, portMAX_DELAY);
+    memset(&source_frames[link], 0, sizeof(source_frames[link]));
+    xSemaphoreGive(notify_mutex);
+    if (link != BLE_LINK_PRIMARY) {
+        return;
     }
 
-    cmd_reg_queue = xQueueCreate(10, sizeof(uint32_t));
-    xTaskCreate(spp_client_reg_task, "spp_client_reg_task", 2048, NULL, 10, NULL);
+    is_connect = false;
+    espnow_pairing_pending = false;
+    ble_ota_link_lost();
 
-#ifdef SUPPORT_HEARTBEAT
-    cmd_heartbeat_queue = xQueueCreate(10, sizeof(uint32_t));
-    xTaskCreate(spp_heart_beat_task, "spp_heart_beat_task", 2048, NULL, 10, NULL);
-#endif
+    // Reset speed, battery and BMS values to 0 when disconnected
+    memset(&latest, 0, sizeof(latest));
+
+    ESP_LOGI(GATTC_TAG, "Speed and battery values reset to 0 due to disconnection");
+
+    // Trigger UI updates to show 0 values
+    ui_update_speed(0);
+    ui_update_skate_battery_percentage(0);
 }
 
+static void handle_rssi(ble_link_t link, int rssi)
+{
+    link_stats[link].rssi = rssi;
+    link_quality_on_rssi(link, rssi);
+    if (link == BLE_LINK_PRIMARY) {
+        latest_rssi = rssi;
+    }
+}
+
+static const ble_transport_callbacks_t transport_callbacks = {
+    .connected = handle_connected,
+    .disconnected = handle_disconnected,
+    .notify = handle_notify,
+    .rssi = handle_rssi,
+    .status = handle_status,
+};
+
 void uart_task(void *pvParameters)
 {
     uart_event_t event;
@@ -630,7 +297,7 @@ void uart_task(void *pvParameters)
             switch (event.type) {
             //Event of UART receiving data
             case UART_DATA:
-                if (event.size && (is_connect == true) && (db != NULL) && ((db+SPP_IDX_SPP_DATA_RECV_VAL)->properties & (ESP_GATT_CHAR_PROP_BIT_WRITE_NR | ESP_GATT_CHAR_PROP_BIT_WRITE))) {
+                if (event.size && ble_transport_ready(BLE_LINK_PRIMARY)) {
                     uint8_t * temp = NULL;
                     temp = (uint8_t *)malloc(sizeof(uint8_t)*event.size);
                     if(temp == NULL){
@@ -639,13 +306,7 @@ void uart_task(void *pvParameters)
                     }
                     memset(temp, 0x0, event.size);
                     uart_read_bytes(UART_NUM_0,temp,event.size,portMAX_DELAY);
-                    esp_ble_gattc_write_char( spp_gattc_if,
-                                              spp_conn_id,
-                                              (db+SPP_IDX_SPP_DATA_RECV_VAL)->attribute_handle,
-                                              event.size,
-                                              temp,
-                                              ESP_GATT_WRITE_TYPE_NO_RSP,
-                                              ESP_GATT_AUTH_REQ_NONE);
+                    ble_transport_write(BLE_LINK_PRIMARY, temp, event.size);
                     free(temp);
                 }
                 break;
@@ -694,55 +355,58 @@ static void spp_uart_init(void)
 
 }
 
-void spp_client_demo_init(void)
+// Deadline monitor, the throttle pipeline is late
+static bool send_neutral(void)
 {
-    esp_err_t ret;
-
-    esp_log_level_set(GATTC_TAG, ESP_LOG_WARN);
+    uint8_t data[2] = { THROTTLE_MAP_NEUTRAL, 0 };
 
-    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+    if (espnow_link_active()) {
+        return espnow_link_send_throttle(data, sizeof(data)) == ESP_OK;
+    }
+    if (!ble_transport_ready(BLE_LINK_PRIMARY)) {
+        return false;
+    }
+    last_throttle_sent = THROTTLE_MAP_NEUTRAL;
+    return ble_transport_write(BLE_LINK_PRIMARY, data, sizeof(data)) == ESP_OK;
+}
 
-    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+void spp_client_demo_init(void)
+{
+    esp_log_level_set(GATTC_TAG, ESP_LOG_WARN);
 
     nvs_flash_init();
-    ret = esp_bt_controller_init(&bt_cfg);
-    if (ret) {
-        ESP_LOGE(GATTC_TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
-        return;
+    notify_mutex = xSemaphoreCreateMutex();
+    if (ble_ota_init() != ESP_OK) {
+        ESP_LOGW(GATTC_TAG, "BLE firmware update unavailable");
     }
-
-    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
-    if (ret) {
-        ESP_LOGE(GATTC_TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
+    if (ble_transport_init(&transport_callbacks) != ESP_OK) {
         return;
     }
+    ESP_LOGI(GATTC_TAG, "BLE host: %s", ble_transport_name());
 
-    ESP_LOGI(GATTC_TAG, "%s init bluetooth", __func__);
-
-    ret = esp_bluedroid_init();
-    if (ret) {
-        ESP_LOGE(GATTC_TAG, "%s init bluetooth failed: %s", __func__, esp_err_to_name(ret));
-        return;
-    }
-    ret = esp_bluedroid_enable();
-    if (ret) {
-        ESP_LOGE(GATTC_TAG, "%s enable bluetooth failed: %s", __func__, esp_err_to_name(ret));
-        return;
+    // BLE stays up as the fallback when ESP-NOW is enabled
+    if (espnow_link_init(handle_espnow_telemetry) != ESP_OK) {
+        ESP_LOGW(GATTC_TAG, "ESP-NOW link unavailable, BLE only");
     }
 
-    ble_client_appRegister();
     spp_uart_init();
+    if (deadline_monitor_init(send_neutral) != ESP_OK) {
+        ESP_LOGE(GATTC_TAG, "Throttle deadline monitor unavailable");
+    }
     xTaskCreate(adc_send_task, "adc_send_task", 4096, NULL, 8, NULL);
-    xTaskCreate(log_rssi_task, "log_rssi_task", 2048, NULL, 4, NULL);
+    xTaskCreate(link_stats_task, "link_stats_task", 3072, NULL, 4, NULL);
 }
 
 static void adc_send_task(void *pvParameters) {
     uint8_t data_buffer[2];  // Just 2 bytes for a 12-bit ADC value
 
     while (1) {
-        if (is_connect && db != NULL &&
-            ((db+SPP_IDX_SPP_DATA_RECV_VAL)->properties &
-             (ESP_GATT_CHAR_PROP_BIT_WRITE_NR | ESP_GATT_CHAR_PROP_BIT_WRITE))){
+        deadline_monitor_kick(DEADLINE_UPLINK_SEND);
+        bool over_espnow = espnow_link_active();
+        bool can_write = over_espnow || ble_transport_ready(BLE_LINK_PRIMARY);
+
+        // The latency bench times the path up to the write, connected or not
+        if (can_write || latency_bench_is_active()) {
 
             uint32_t adc_value;
 
@@ -766,20 +430,42 @@ static void adc_send_task(void *pvParameters) {
                 }
             }
 #endif
+            // adc_task is late, its last reading is no longer the rider's hand
+            if (deadline_monitor_throttle_stale()) {
+                adc_value = THROTTLE_MAP_NEUTRAL;
+            }
+
+            latency_bench_on_write((uint8_t)adc_value);
+            if (!can_write) {
+                vTaskDelay(pdMS_TO_TICKS(50));
+                continue;
+            }
+
+            last_throttle_sent = (uint8_t)adc_value;
 
             // Pack the ADC value into 2 bytes (little-endian)
             data_buffer[0] = (uint8_t)(adc_value & 0xFF);         // Low byte
             data_buffer[1] = (uint8_t)((adc_value >> 8) & 0xFF);  // High byte
 
-            esp_ble_gattc_write_char(
-                spp_gattc_if,
-                spp_conn_id,
-                (db+SPP_IDX_SPP_DATA_RECV_VAL)->attribute_handle,
-                sizeof(data_buffer),  // 2 bytes
-                data_buffer,
-                ESP_GATT_WRITE_TYPE_NO_RSP,
-                ESP_GATT_AUTH_REQ_NONE
-            );
+            if (over_espnow) {
+                espnow_link_send_throttle(data_buffer, sizeof(data_buffer));
+            } else {
+                // Only the primary controller drives, a second one follows it over CAN
+                int64_t write_start = esp_timer_get_time();
+                esp_err_t ret = ble_transport_write(BLE_LINK_PRIMARY, data_buffer, sizeof(data_buffer));  // 2 bytes
+                ble_bench_on_write((uint32_t)(esp_timer_get_time() - write_start), ret == ESP_OK);
+                if (ret == ESP_OK) {
+                    link_stats[BLE_LINK_PRIMARY].tx_writes++;
+                    link_stats[BLE_LINK_PRIMARY].tx_bytes += sizeof(data_buffer);
+                } else {
+                    link_stats[BLE_LINK_PRIMARY].tx_failed++;
+                }
+                // A link that went down under the write is not congestion
+                if (ret != ESP_ERR_INVALID_STATE) {
+                    link_quality_on_write(BLE_LINK_PRIMARY, ret == ESP_OK);
+                }
+            }
+            stream_record_throttle(last_throttle_sent);
         }
         vTaskDelay(pdMS_TO_TICKS(50));
     }
@@ -787,73 +473,153 @@ static void adc_send_task(void *pvParameters) {
 
 float get_latest_voltage(void)
 {
-    return latest_voltage;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_VOLTAGE);
 }
 
 int32_t get_latest_erpm(void)
 {
-    return latest_erpm;
+    return latest.erpm;
 }
 
 float get_latest_current_motor(void)
 {
-    return latest_current_motor;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_CURRENT_MOTOR);
 }
 
 float get_latest_current_in(void)
 {
-    return latest_current_in;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_CURRENT_IN);
+}
+
+int get_latest_rssi(void)
+{
+    return is_connect ? latest_rssi : 0;
+}
+
+uint32_t get_connect_count(void)
+{
+    return connect_count;
+}
+
+uint32_t get_rejected_frame_count(void)
+{
+    return rejected_frame_count;
+}
+
+esp_err_t ble_start_espnow_pairing(void)
+{
+    // The offer carries the key, so never over a link a listener can read
+    if (!ble_transport_encrypted(BLE_LINK_PRIMARY)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint8_t own_mac[ESPNOW_MAC_LEN];
+    uint8_t offer[ESPNOW_PAIR_OFFER_LEN];
+    espnow_link_get_own_mac(own_mac);
+    esp_fill_random(espnow_pairing_key, sizeof(espnow_pairing_key));
+    espnow_pairing_channel = espnow_link_channel();
+    espnow_pair_offer_encode(own_mac, espnow_pairing_channel, espnow_pairing_key, offer, sizeof(offer));
+
+    espnow_pairing_pending = true;
+    esp_err_t ret = ble_transport_write_command(BLE_LINK_PRIMARY, offer, sizeof(offer));
+    memset(offer, 0, sizeof(offer));
+    if (ret != ESP_OK) {
+        espnow_pairing_pending = false;
+        memset(espnow_pairing_key, 0, sizeof(espnow_pairing_key));
+    }
+    return ret;
+}
+
+bool ble_espnow_pairing_pending(void)
+{
+    return espnow_pairing_pending;
+}
+
+uint8_t get_last_throttle_sent(void)
+{
+    return last_throttle_sent;
 }
 
 float get_bms_total_voltage(void)
 {
-    return bms_total_voltage;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_BMS_VOLTAGE);
 }
 
 float get_bms_current(void)
 {
-    return bms_current;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_BMS_CURRENT);
 }
 
 float get_bms_remaining_capacity(void)
 {
-    return bms_remaining_capacity;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_BMS_REMAINING);
 }
 
 float get_bms_nominal_capacity(void)
 {
-    return bms_nominal_capacity;
+    return telemetry_field_scaled(&latest, TELEMETRY_FIELD_BMS_NOMINAL);
 }
 
 uint8_t get_bms_num_cells(void)
 {
-    return bms_num_cells;
+    return latest.bms_num_cells;
 }
 
 float get_bms_cell_voltage(uint8_t cell_index)
 {
-    if(cell_index < bms_num_cells && cell_index < 16) {
-        return bms_cell_voltages[cell_index];
+    if(cell_index < latest.bms_num_cells && cell_index < TELEMETRY_MAX_CELLS) {
+        return (float)latest.cell_mv[cell_index] / TELEMETRY_SCHEMA_CELL_SCALE;
     }
     return 0.0f;
 }
 
-static void log_rssi_task(void *pvParameters) {
+const char *ble_link_name(ble_link_t link)
+{
+    return link < BLE_MAX_LINKS ? link_names[link] : "?";
+}
+
+void ble_get_link_stats(ble_link_t link, ble_link_stats_t *stats)
+{
+    *stats = link_stats[link];
+    stats->conn_interval = ble_transport_conn_interval(link);
+    int64_t last_rx = link_last_rx_us[link];
+    stats->last_rx_age_ms = last_rx == 0 ? UINT32_MAX : (uint32_t)((esp_timer_get_time() - last_rx) / 1000);
+}
+
+static void link_stats_task(void *pvParameters) {
+    uint32_t last_rx_frames[BLE_MAX_LINKS] = {0};
+    uint32_t last_rx_bytes[BLE_MAX_LINKS] = {0};
+    uint32_t last_tx_bytes[BLE_MAX_LINKS] = {0};
+
     while (1) {
-        if (is_connect && spp_gattc_if != 0xff) {
-            esp_err_t ret = esp_ble_gap_read_rssi(scan_rst.scan_rst.bda);
-            if (ret != ESP_OK) {
-                ESP_LOGE(GATTC_TAG, "Read RSSI failed: %s", esp_err_to_name(ret));
+        for (int i = 0; i < BLE_MAX_LINKS; i++) {
+            ble_link_stats_t *stats = &link_stats[i];
+            stats->rx_frames_per_s = stats->rx_frames - last_rx_frames[i];
+            stats->rx_bytes_per_s = stats->rx_bytes - last_rx_bytes[i];
+            stats->tx_bytes_per_s = stats->tx_bytes - last_tx_bytes[i];
+            last_rx_frames[i] = stats->rx_frames;
+            last_rx_bytes[i] = stats->rx_bytes;
+            last_tx_bytes[i] = stats->tx_bytes;
+
+            if (stats->connected) {
+                esp_err_t ret = ble_transport_request_rssi((ble_link_t)i);
+                if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+                    ESP_LOGE(GATTC_TAG, "Read RSSI of %s failed: %s", link_names[i], esp_err_to_name(ret));
+                }
             }
         }
-        vTaskDelay(pdMS_TO_TICKS(1000)); // Check RSSI every second
+
+        // Scores from the readings so far, the icon follows the primary
+        link_quality_update();
+        ui_update_connection_quality(link_quality_score(BLE_LINK_PRIMARY));
+        vTaskDelay(pdMS_TO_TICKS(1000)); // Rates and RSSI every second
     }
 }
 
 int get_bms_battery_percentage(void) {
-    if (bms_nominal_capacity <= 0.0f) return -1;
+    if (latest.bms_nominal_c100 <= 0) return -1;
 
-    float percentage = (bms_remaining_capacity / bms_nominal_capacity) * 100.0f;
+    float percentage = (latest.bms_remaining_c100 * 100.0f) / latest.bms_nominal_c100;
 
     if (percentage > 100.0f) percentage = 100.0f;
     if (percentage < 0.0f) percentage = 0.0f;
@@ -1,6 +1,29 @@
 #ifndef SPP_CLIENT_DEMO_H
 #define SPP_CLIENT_DEMO_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ble_transport.h"
+
+// Per link counters, rates refreshed once a second
+typedef struct {
+    bool connected;
+    uint16_t conn_interval;         // 1.25 ms units
+    int rssi;
+    uint32_t connects;
+    uint32_t rx_frames;             // Telemetry frames decoded
+    uint32_t rx_rejected;
+    uint32_t rx_bytes;              // Data and status notify payloads
+    uint32_t tx_writes;
+    uint32_t tx_failed;
+    uint32_t tx_bytes;
+    uint32_t rx_frames_per_s;
+    uint32_t rx_bytes_per_s;
+    uint32_t tx_bytes_per_s;
+    uint32_t last_rx_age_ms;        // UINT32_MAX before the first notify
+} ble_link_stats_t;
+
 extern bool is_connect;
 
 void spp_client_demo_init(void);
@@ -8,6 +31,8 @@ float get_latest_voltage(void);
 int32_t get_latest_erpm(void);
 float get_latest_current_motor(void);
 float get_latest_current_in(void);
+int get_latest_rssi(void);
+uint8_t get_last_throttle_sent(void);
 float get_bms_total_voltage(void);
 float get_bms_current(void);
 float get_bms_remaining_capacity(void);
@@ -17,5 +42,13 @@ float get_bms_cell_voltage(uint8_t cell_index);
 float get_latest_temp_mos(void);
 float get_latest_temp_motor(void);
 int get_bms_battery_percentage(void);
+uint32_t get_connect_count(void);
+uint32_t get_rejected_frame_count(void);  // Notifies that failed to decode
+const char *ble_link_name(ble_link_t link);
+void ble_get_link_stats(ble_link_t link, ble_link_stats_t *stats);
+// Offers a fresh ESP-NOW key to the connected receiver, which answers with its
+// MAC. Only over an encrypted link, ESP_ERR_INVALID_STATE otherwise
+esp_err_t ble_start_espnow_pairing(void);
+bool ble_espnow_pairing_pending(void);
 
 #endif // SPP_CLIENT_DEMO_H
\ No newline at end of file
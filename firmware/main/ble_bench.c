@@ -0,0 +1,173 @@
+#include "ble_bench.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "ble_transport.h"
+
+#define TAG "BLE_BENCH"
+
+// Under bench_lock
+static portMUX_TYPE bench_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t remaining = 0;
+static bool task_running = false;
+static uint32_t pings_sent = 0;
+static uint32_t pings_failed = 0;
+static uint32_t echoes = 0;
+static uint32_t rtt_us[BLE_BENCH_RTT_SAMPLES];
+static uint32_t rtt_count = 0;
+static uint32_t rtt_next = 0;
+static uint32_t writes = 0;
+static uint32_t writes_failed = 0;
+static uint64_t write_total_us = 0;
+static uint32_t write_max_us = 0;
+
+static void ble_bench_task(void *pvParameters)
+{
+    while (1) {
+        portENTER_CRITICAL(&bench_lock);
+        bool more = remaining > 0;
+        if (more) {
+            remaining--;
+        } else {
+            task_running = false;
+        }
+        portEXIT_CRITICAL(&bench_lock);
+        if (!more) {
+            break;
+        }
+
+        uint32_t now = (uint32_t)esp_timer_get_time();
+        uint8_t ping[BLE_BENCH_PING_LEN] = {
+            BLE_BENCH_PING_MAGIC, now & 0xFF, (now >> 8) & 0xFF, (now >> 16) & 0xFF, now >> 24,
+        };
+        esp_err_t ret = ble_transport_write_command(BLE_LINK_PRIMARY, ping, sizeof(ping));
+
+        portENTER_CRITICAL(&bench_lock);
+        if (ret == ESP_OK) {
+            pings_sent++;
+        } else {
+            pings_failed++;
+        }
+        // A link that went away ends the run
+        if (ret == ESP_ERR_INVALID_STATE) {
+            remaining = 0;
+        }
+        portEXIT_CRITICAL(&bench_lock);
+        vTaskDelay(pdMS_TO_TICKS(BLE_BENCH_PERIOD_MS));
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t ble_bench_start(uint32_t pings)
+{
+    if (pings == 0 || pings > BLE_BENCH_MAX_PINGS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!ble_transport_ready(BLE_LINK_PRIMARY)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&bench_lock);
+    bool start_task = !task_running;
+    task_running = true;
+    remaining = pings;
+    pings_sent = 0;
+    pings_failed = 0;
+    echoes = 0;
+    rtt_count = 0;
+    rtt_next = 0;
+    writes = 0;
+    writes_failed = 0;
+    write_total_us = 0;
+    write_max_us = 0;
+    portEXIT_CRITICAL(&bench_lock);
+
+    if (start_task && xTaskCreate(ble_bench_task, "ble_bench", 3072, NULL, 5, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Could not start the ping task");
+        portENTER_CRITICAL(&bench_lock);
+        remaining = 0;
+        task_running = false;
+        portEXIT_CRITICAL(&bench_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool ble_bench_is_active(void)
+{
+    portENTER_CRITICAL(&bench_lock);
+    bool active = task_running;
+    portEXIT_CRITICAL(&bench_lock);
+    return active;
+}
+
+bool ble_bench_on_status(const uint8_t *data, size_t len)
+{
+    if (len != BLE_BENCH_PING_LEN || data[0] != BLE_BENCH_PING_MAGIC) {
+        return false;
+    }
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    uint32_t sent = data[1] | ((uint32_t)data[2] << 8) | ((uint32_t)data[3] << 16) | ((uint32_t)data[4] << 24);
+
+    portENTER_CRITICAL(&bench_lock);
+    echoes++;
+    rtt_us[rtt_next] = now - sent;
+    rtt_next = (rtt_next + 1) % BLE_BENCH_RTT_SAMPLES;
+    if (rtt_count < BLE_BENCH_RTT_SAMPLES) {
+        rtt_count++;
+    }
+    portEXIT_CRITICAL(&bench_lock);
+    return true;
+}
+
+void ble_bench_on_write(uint32_t elapsed_us, bool ok)
+{
+    portENTER_CRITICAL(&bench_lock);
+    writes++;
+    writes_failed += !ok;
+    write_total_us += elapsed_us;
+    if (elapsed_us > write_max_us) {
+        write_max_us = elapsed_us;
+    }
+    portEXIT_CRITICAL(&bench_lock);
+}
+
+void ble_bench_get_result(ble_bench_result_t *result)
+{
+    uint32_t samples[BLE_BENCH_RTT_SAMPLES];
+
+    memset(result, 0, sizeof(*result));
+    portENTER_CRITICAL(&bench_lock);
+    result->active = task_running;
+    result->pings_sent = pings_sent;
+    result->pings_failed = pings_failed;
+    result->echoes = echoes;
+    result->writes = writes;
+    result->writes_failed = writes_failed;
+    result->write_avg_us = writes ? (uint32_t)(write_total_us / writes) : 0;
+    result->write_max_us = write_max_us;
+    uint32_t count = rtt_count;
+    memcpy(samples, rtt_us, count * sizeof(samples[0]));
+    portEXIT_CRITICAL(&bench_lock);
+
+    if (count == 0) {
+        return;
+    }
+    // Insertion sort, at most BLE_BENCH_RTT_SAMPLES entries
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t value = samples[i];
+        uint32_t j = i;
+        while (j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = value;
+    }
+    result->rtt_count = count;
+    result->rtt_min_us = samples[0];
+    result->rtt_p50_us = samples[count / 2];
+    result->rtt_p99_us = samples[(count * 99) / 100];
+    result->rtt_max_us = samples[count - 1];
+}
@@ -0,0 +1,57 @@
+#ifndef BLE_BENCH_H
+#define BLE_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// What the BLE host stack behind ble_transport.h costs, measured on the
+// device, to compare the Bluedroid and NimBLE builds.
+//
+// Notify latency: a run writes BLE_BENCH_PING_LEN bytes to the primary
+// receiver's command characteristic every BLE_BENCH_PERIOD_MS, the magic
+// and the esp_timer time in microseconds (little-endian u32). The receiver
+// sends them straight back on the status characteristic; fake_thumb.py
+// does. ble.c hands every status notify to ble_bench_on_status first, and
+// the echo closes the round trip: write, connection events both ways, and
+// the stack's dispatch of the notify to the callback, the part that differs
+// between the backends. Write cost: adc_send_task reports how long every
+// ble_transport_write kept it, run or not.
+//
+// Free heap and the image against its app slot come from ESP-IDF directly,
+// the console's ble_backend command prints all of it.
+
+#define BLE_BENCH_PING_MAGIC    'L'
+#define BLE_BENCH_PING_LEN      5
+#define BLE_BENCH_RTT_SAMPLES   128
+#define BLE_BENCH_PERIOD_MS     50      // Slower than the primary's interval, one ping in flight
+#define BLE_BENCH_MAX_PINGS     10000
+
+typedef struct {
+    bool active;
+    uint32_t pings_sent;
+    uint32_t pings_failed;          // Refused by the stack
+    uint32_t echoes;
+    uint32_t rtt_count;             // Samples in the percentiles, up to BLE_BENCH_RTT_SAMPLES
+    uint32_t rtt_min_us;
+    uint32_t rtt_p50_us;
+    uint32_t rtt_p99_us;
+    uint32_t rtt_max_us;
+    uint32_t writes;                // Throttle writes since the last start
+    uint32_t writes_failed;
+    uint32_t write_avg_us;
+    uint32_t write_max_us;
+} ble_bench_result_t;
+
+// Clears the results and pings the primary receiver, which must be connected
+esp_err_t ble_bench_start(uint32_t pings);
+bool ble_bench_is_active(void);
+void ble_bench_get_result(ble_bench_result_t *result);
+
+// Status hook: true if data was a ping echo, which is then consumed
+bool ble_bench_on_status(const uint8_t *data, size_t len);
+// Send hook: how long one ble_transport_write took
+void ble_bench_on_write(uint32_t elapsed_us, bool ok);
+
+#endif // BLE_BENCH_H
@@ -0,0 +1,857 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2024 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+// Bluedroid backend of ble_transport.h, based on the ESP-IDF SPP client demo.
+// One GATT client app serves every link; events are matched to their link by
+// conn_id or remote address, and each link keeps its own attribute table.
+
+#include "sdkconfig.h"
+#if CONFIG_BT_BLUEDROID_ENABLED
+
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <inttypes.h>
+
+#include "esp_bt.h"
+#include "esp_bt_device.h"
+#include "esp_gap_ble_api.h"
+#include "esp_gattc_api.h"
+#include "esp_gatt_defs.h"
+#include "esp_bt_main.h"
+#include "esp_system.h"
+#include "esp_gatt_common_api.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "ble_transport.h"
+
+#define GATTC_TAG                   "GATTC_SPP_DEMO"
+
+#define PROFILE_NUM                 1
+#define PROFILE_APP_ID              0
+#define SCAN_ALL_THE_TIME           0
+#define REG_FOR_NOTIFY_TIMEOUT_MS   1000
+
+struct gattc_profile_inst {
+    esp_gattc_cb_t gattc_cb;
+    uint16_t gattc_if;
+    uint16_t app_id;
+};
+
+enum {
+    SPP_IDX_SVC,
+    SPP_IDX_SPP_DATA_RECV_VAL,
+    SPP_IDX_SPP_DATA_NTY_VAL,
+    SPP_IDX_SPP_DATA_NTF_CFG,
+    SPP_IDX_SPP_COMMAND_VAL,
+    SPP_IDX_SPP_STATUS_VAL,
+    SPP_IDX_SPP_STATUS_CFG,
+#ifdef SUPPORT_HEARTBEAT
+    SPP_IDX_SPP_HEARTBEAT_VAL,
+    SPP_IDX_SPP_HEARTBEAT_CFG,
+#endif
+    SPP_IDX_NB,
+};
+
+// One connection to a peer, indexed by ble_link_t
+typedef struct {
+    bool in_use;                    // Connecting or connected
+    volatile bool link_up;
+    volatile bool encrypted;
+    uint16_t conn_id;
+    uint16_t conn_handle;           // Controller handle, not the GATT conn_id
+    esp_bd_addr_t remote_bda;
+    esp_ble_addr_type_t addr_type;
+    uint16_t mtu_size;
+    uint16_t conn_interval;
+    uint16_t srv_start_handle;
+    uint16_t srv_end_handle;
+    uint16_t cmd;                   // Attribute index being subscribed
+    esp_gattc_db_elem_t *db;
+} spp_link_t;
+
+///Declare static functions
+static void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param);
+static void esp_gattc_cb(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param);
+static void gattc_profile_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param);
+
+/* One gatt-based profile one app_id and one gattc_if, this array will store the gattc_if returned by ESP_GATTS_REG_EVT */
+static struct gattc_profile_inst gl_profile_tab[PROFILE_NUM] = {
+    [PROFILE_APP_ID] = {
+        .gattc_cb = gattc_profile_event_handler,
+        .gattc_if = ESP_GATT_IF_NONE,       /* Not get the gatt_if, so initial is ESP_GATT_IF_NONE */
+    },
+};
+
+static esp_ble_scan_params_t ble_scan_params = {
+    .scan_type              = BLE_SCAN_TYPE_ACTIVE,
+    .own_addr_type          = BLE_ADDR_TYPE_PUBLIC,
+    .scan_filter_policy     = BLE_SCAN_FILTER_ALLOW_ALL,
+    .scan_interval          = BLE_SCAN_INTERVAL,
+    .scan_window            = BLE_SCAN_WINDOW,
+    .scan_duplicate         = BLE_SCAN_DUPLICATE_DISABLE
+};
+
+static const char *const peer_names[BLE_MAX_LINKS] = BLE_PEER_NAMES;
+static const uint16_t conn_intervals[BLE_MAX_LINKS] = BLE_CONN_INTERVALS;
+
+static spp_link_t links[BLE_MAX_LINKS];
+static uint16_t spp_gattc_if = ESP_GATT_IF_NONE;
+static int connecting_link = -1;    // Scan stopped to open this link
+static bool scanning = false;
+static bool scan_params_set = false;
+static bool background_scan = false;
+static bool scan_stopping = false;      // Stopped to restart with other parameters
+static int registering_link = -1;   // REG_FOR_NOTIFY_EVT carries no conn_id
+static QueueHandle_t cmd_reg_queue = NULL;
+static SemaphoreHandle_t reg_done = NULL;
+
+#ifdef SUPPORT_HEARTBEAT
+static uint8_t  heartbeat_s[9] = {'E','s','p','r','e','s','s','i','f'};
+static QueueHandle_t cmd_heartbeat_queue = NULL;
+#endif
+
+static esp_bt_uuid_t spp_service_uuid = {
+    .len  = ESP_UUID_LEN_16,
+    .uuid = {.uuid16 = BLE_SPP_SERVICE_UUID,},
+};
+
+static const ble_transport_callbacks_t *callbacks = NULL;
+
+static int link_by_conn_id(uint16_t conn_id)
+{
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        if (links[i].link_up && links[i].conn_id == conn_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int link_by_bda(const esp_bd_addr_t bda)
+{
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        if (links[i].in_use && memcmp(links[i].remote_bda, bda, sizeof(esp_bd_addr_t)) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int link_by_name(const uint8_t *name, uint8_t name_len)
+{
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        if (name_len == strlen(peer_names[i]) && memcmp(name, peer_names[i], name_len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Queue entries carry the link in the upper half and the attribute index in the lower
+static void queue_reg(int idx, uint16_t cmd)
+{
+    uint32_t item = ((uint32_t)idx << 16) | cmd;
+    xQueueSend(cmd_reg_queue, &item, 10/portTICK_PERIOD_MS);
+}
+
+static void start_scan(void)
+{
+    if (connecting_link >= 0 || spp_gattc_if == ESP_GATT_IF_NONE) {
+        return;
+    }
+    bool missing = false;
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        missing |= !links[i].in_use;
+    }
+    // Scanning for optional peers must not crowd out the primary link
+    bool background = links[BLE_LINK_PRIMARY].in_use;
+    if (scanning) {
+        if ((missing && background == background_scan) || scan_stopping) {
+            return;
+        }
+        // Wrong duty cycle or nothing left to find; the stop event restarts
+        scan_stopping = true;
+        esp_ble_gap_stop_scanning();
+        return;
+    }
+    if (!missing) {
+        return;
+    }
+
+    scanning = true;
+    if (!scan_params_set || background != background_scan) {
+        ble_scan_params.scan_interval = background ? BLE_BACKGROUND_SCAN_INTERVAL : BLE_SCAN_INTERVAL;
+        ble_scan_params.scan_window = background ? BLE_BACKGROUND_SCAN_WINDOW : BLE_SCAN_WINDOW;
+        background_scan = background;
+        scan_params_set = true;
+        esp_ble_gap_set_scan_params(&ble_scan_params);  // Scanning starts once they are set
+        return;
+    }
+    esp_ble_gap_start_scanning(SCAN_ALL_THE_TIME);
+}
+
+static void notify_event_handler(int idx, esp_ble_gattc_cb_param_t * p_data)
+{
+    uint16_t handle = 0;
+    esp_gattc_db_elem_t *db = links[idx].db;
+
+    if(p_data->notify.is_notify == true){
+        ESP_LOGI(GATTC_TAG,"+NOTIFY:link = %d,handle = %d,length = %d ", idx, p_data->notify.handle, p_data->notify.value_len);
+    }else{
+        ESP_LOGI(GATTC_TAG,"+INDICATE:link = %d,handle = %d,length = %d ", idx, p_data->notify.handle, p_data->notify.value_len);
+    }
+
+    handle = p_data->notify.handle;
+    if(db == NULL) {
+        ESP_LOGE(GATTC_TAG, " %s db is NULL", __func__);
+        return;
+    }
+
+    if(handle == db[SPP_IDX_SPP_DATA_NTY_VAL].attribute_handle){
+        callbacks->notify((ble_link_t)idx, p_data->notify.value, p_data->notify.value_len);
+    } else if(handle == db[SPP_IDX_SPP_STATUS_VAL].attribute_handle){
+        callbacks->status((ble_link_t)idx, p_data->notify.value, p_data->notify.value_len);
+    }
+}
+
+static void free_link(int idx)
+{
+    spp_link_t *link = &links[idx];
+    esp_gattc_db_elem_t *db = link->db;
+
+    link->link_up = false;
+    link->db = NULL;
+    free(db);
+    memset(link, 0, sizeof(*link));
+    link->mtu_size = 23;
+}
+
+static void log_db(const esp_gattc_db_elem_t *db)
+{
+    for(int i = 0;i < SPP_IDX_NB;i++){
+        switch((db+i)->type){
+        case ESP_GATT_DB_PRIMARY_SERVICE:
+            ESP_LOGI(GATTC_TAG,"attr_type = PRIMARY_SERVICE,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
+                    (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
+            break;
+        case ESP_GATT_DB_SECONDARY_SERVICE:
+            ESP_LOGI(GATTC_TAG,"attr_type = SECONDARY_SERVICE,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
+                    (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
+            break;
+        case ESP_GATT_DB_CHARACTERISTIC:
+            ESP_LOGI(GATTC_TAG,"attr_type = CHARACTERISTIC,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
+                    (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
+            break;
+        case ESP_GATT_DB_DESCRIPTOR:
+            ESP_LOGI(GATTC_TAG,"attr_type = DESCRIPTOR,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
+                    (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
+            break;
+        case ESP_GATT_DB_INCLUDED_SERVICE:
+            ESP_LOGI(GATTC_TAG,"attr_type = INCLUDED_SERVICE,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
+                    (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
+            break;
+        case ESP_GATT_DB_ALL:
+            ESP_LOGI(GATTC_TAG,"attr_type = ESP_GATT_DB_ALL,attribute_handle=%d,start_handle=%d,end_handle=%d,properties=0x%x,uuid=0x%04x",\
+                    (db+i)->attribute_handle, (db+i)->start_handle, (db+i)->end_handle, (db+i)->properties, (db+i)->uuid.uuid.uuid16);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void esp_gap_cb(esp_gap_ble_cb_event_t event, esp_ble_gap_cb_param_t *param)
+{
+    uint8_t *adv_name = NULL;
+    uint8_t adv_name_len = 0;
+    esp_err_t err;
+    int idx;
+
+    switch(event){
+    case ESP_GAP_BLE_SCAN_PARAM_SET_COMPLETE_EVT: {
+        if((err = param->scan_param_cmpl.status) != ESP_BT_STATUS_SUCCESS){
+            ESP_LOGE(GATTC_TAG, "Scan param set failed: %s", esp_err_to_name(err));
+            scanning = false;
+            scan_params_set = false;
+            break;
+        }
+        ESP_LOGI(GATTC_TAG, "Enable Ble Scan, %s", background_scan ? "background" : "full");
+        esp_ble_gap_start_scanning(SCAN_ALL_THE_TIME);
+        break;
+    }
+    case ESP_GAP_BLE_SCAN_START_COMPLETE_EVT:
+        //scan start complete event to indicate scan start successfully or failed
+        if ((err = param->scan_start_cmpl.status) != ESP_BT_STATUS_SUCCESS) {
+            ESP_LOGE(GATTC_TAG, "Scan start failed: %s", esp_err_to_name(err));
+            scanning = false;
+            break;
+        }
+        ESP_LOGI(GATTC_TAG, "Scan start successfully");
+        break;
+    case ESP_GAP_BLE_SCAN_STOP_COMPLETE_EVT:
+        if ((err = param->scan_stop_cmpl.status) != ESP_BT_STATUS_SUCCESS) {
+            // Not scanning any more either way, go on with the connection
+            ESP_LOGE(GATTC_TAG, "Scan stop failed: %s", esp_err_to_name(err));
+        } else {
+            ESP_LOGI(GATTC_TAG, "Scan stop successfully");
+        }
+        scanning = false;
+        scan_stopping = false;
+        if (connecting_link >= 0) {
+            spp_link_t *link = &links[connecting_link];
+            ESP_LOGI(GATTC_TAG, "Connect to the remote device %s.", peer_names[connecting_link]);
+            esp_ble_gap_prefer_conn_params_set(link->remote_bda,
+                                               conn_intervals[connecting_link], conn_intervals[connecting_link],
+                                               0, BLE_CONN_SUPERVISION_TIMEOUT);
+            esp_ble_gattc_open(spp_gattc_if, link->remote_bda, link->addr_type, true);
+        } else {
+            start_scan();   // With the parameters for the links now up
+        }
+        break;
+    case ESP_GAP_BLE_SCAN_RESULT_EVT: {
+        esp_ble_gap_cb_param_t *scan_result = (esp_ble_gap_cb_param_t *)param;
+        switch (scan_result->scan_rst.search_evt) {
+        case ESP_GAP_SEARCH_INQ_RES_EVT:
+            if (connecting_link >= 0 || scan_stopping) {
+                break;
+            }
+            adv_name = esp_ble_resolve_adv_data(scan_result->scan_rst.ble_adv, ESP_BLE_AD_TYPE_NAME_CMPL, &adv_name_len);
+            if (adv_name == NULL || (idx = link_by_name(adv_name, adv_name_len)) < 0 || links[idx].in_use) {
+                break;
+            }
+            ESP_LOGI(GATTC_TAG, "Found device %s, RSSI: %d", peer_names[idx], scan_result->scan_rst.rssi);
+            links[idx].in_use = true;
+            memcpy(links[idx].remote_bda, scan_result->scan_rst.bda, sizeof(esp_bd_addr_t));
+            links[idx].addr_type = scan_result->scan_rst.ble_addr_type;
+            connecting_link = idx;
+            esp_ble_gap_stop_scanning();
+            break;
+        case ESP_GAP_SEARCH_INQ_CMPL_EVT:
+            scanning = false;
+            start_scan();
+            break;
+        default:
+            break;
+        }
+        break;
+    }
+    case ESP_GAP_BLE_ADV_STOP_COMPLETE_EVT:
+        if ((err = param->adv_stop_cmpl.status) != ESP_BT_STATUS_SUCCESS){
+            ESP_LOGE(GATTC_TAG, "Adv stop failed: %s", esp_err_to_name(err));
+        }else {
+            ESP_LOGI(GATTC_TAG, "Stop adv successfully");
+        }
+        break;
+    case ESP_GAP_BLE_UPDATE_CONN_PARAMS_EVT:
+        idx = link_by_bda(param->update_conn_params.bda);
+        if (idx >= 0 && param->update_conn_params.status == ESP_BT_STATUS_SUCCESS) {
+            links[idx].conn_interval = param->update_conn_params.conn_int;
+            ESP_LOGI(GATTC_TAG, "Link %d interval %d", idx, param->update_conn_params.conn_int);
+        }
+        break;
+    case ESP_GAP_BLE_SEC_REQ_EVT:
+        // The receiver asks for encryption first, go along with it
+        esp_ble_gap_security_rsp(param->ble_security.ble_req.bd_addr, true);
+        break;
+    case ESP_GAP_BLE_AUTH_CMPL_EVT:
+        idx = link_by_bda(param->ble_security.auth_cmpl.bd_addr);
+        if (idx < 0) {
+            break;
+        }
+        links[idx].encrypted = param->ble_security.auth_cmpl.success;
+        if (!param->ble_security.auth_cmpl.success) {
+            ESP_LOGE(GATTC_TAG, "Link %d pairing failed, reason 0x%x", idx, param->ble_security.auth_cmpl.fail_reason);
+        }
+        break;
+    case ESP_GAP_BLE_READ_RSSI_COMPLETE_EVT:
+        idx = link_by_bda(param->read_rssi_cmpl.remote_addr);
+        if (idx < 0) {
+            break;
+        }
+        if (param->read_rssi_cmpl.status == ESP_BT_STATUS_SUCCESS) {
+            callbacks->rssi((ble_link_t)idx, param->read_rssi_cmpl.rssi);
+        } else {
+            ESP_LOGE(GATTC_TAG, "RSSI read failed: %d", param->read_rssi_cmpl.status);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void esp_gattc_cb(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param)
+{
+    ESP_LOGI(GATTC_TAG, "EVT %d, gattc if %d", event, gattc_if);
+
+    /* If event is register event, store the gattc_if for each profile */
+    if (event == ESP_GATTC_REG_EVT) {
+        if (param->reg.status == ESP_GATT_OK) {
+            gl_profile_tab[param->reg.app_id].gattc_if = gattc_if;
+        } else {
+            ESP_LOGI(GATTC_TAG, "Reg app failed, app_id %04x, status %d", param->reg.app_id, param->reg.status);
+            return;
+        }
+    }
+    /* If the gattc_if equal to profile A, call profile A cb handler,
+     * so here call each profile's callback */
+    do {
+        int idx;
+        for (idx = 0; idx < PROFILE_NUM; idx++) {
+            if (gattc_if == ESP_GATT_IF_NONE || /* ESP_GATT_IF_NONE, not specify a certain gatt_if, need to call every profile cb function */
+                    gattc_if == gl_profile_tab[idx].gattc_if) {
+                if (gl_profile_tab[idx].gattc_cb) {
+                    gl_profile_tab[idx].gattc_cb(event, gattc_if, param);
+                }
+            }
+        }
+    } while (0);
+}
+
+// A failed step drops the link, like the NimBLE backend: the disconnect
+// event frees it and scanning finds the peer again
+static void drop_link(int idx, const char *step)
+{
+    ESP_LOGE(GATTC_TAG, "Link %d: %s failed, disconnecting", idx, step);
+    esp_ble_gap_disconnect(links[idx].remote_bda);
+}
+
+// Reads the SPP attributes once the MTU is settled; ready from here on
+static void read_db(int idx)
+{
+    spp_link_t *link = &links[idx];
+
+    esp_gattc_db_elem_t *db = (esp_gattc_db_elem_t *)malloc(SPP_IDX_NB*sizeof(esp_gattc_db_elem_t));
+    if(db == NULL){
+        ESP_LOGE(GATTC_TAG,"%s:malloc db failed",__func__);
+        drop_link(idx, "database read");
+        return;
+    }
+    uint16_t count = SPP_IDX_NB;
+    if(esp_ble_gattc_get_db(spp_gattc_if, link->conn_id, link->srv_start_handle, link->srv_end_handle, db, &count) != ESP_GATT_OK){
+        ESP_LOGE(GATTC_TAG,"%s:get db failed",__func__);
+        free(db);
+        drop_link(idx, "database read");
+        return;
+    }
+    if(count != SPP_IDX_NB){
+        ESP_LOGE(GATTC_TAG,"%s:get db count != SPP_IDX_NB, count = %d, SPP_IDX_NB = %d",__func__,count,SPP_IDX_NB);
+        free(db);
+        drop_link(idx, "SPP characteristics");
+        return;
+    }
+    if(!((db+SPP_IDX_SPP_DATA_RECV_VAL)->properties & (ESP_GATT_CHAR_PROP_BIT_WRITE_NR | ESP_GATT_CHAR_PROP_BIT_WRITE))){
+        free(db);
+        drop_link(idx, "SPP characteristics");
+        return;
+    }
+    log_db(db);
+    link->db = db;
+    link->cmd = SPP_IDX_SPP_DATA_NTY_VAL;
+    queue_reg(idx, link->cmd);
+}
+
+static void gattc_profile_event_handler(esp_gattc_cb_event_t event, esp_gatt_if_t gattc_if, esp_ble_gattc_cb_param_t *param)
+{
+    esp_ble_gattc_cb_param_t *p_data = (esp_ble_gattc_cb_param_t *)param;
+    int idx;
+
+    switch (event) {
+    case ESP_GATTC_REG_EVT:
+        ESP_LOGI(GATTC_TAG, "REG EVT, set scan params");
+        spp_gattc_if = gattc_if;
+        start_scan();
+        break;
+    case ESP_GATTC_OPEN_EVT:
+        if (p_data->open.status != ESP_GATT_OK && connecting_link >= 0) {
+            ESP_LOGW(GATTC_TAG, "Open %s failed, status %d", peer_names[connecting_link], p_data->open.status);
+            free_link(connecting_link);
+            connecting_link = -1;
+            start_scan();
+        }
+        break;
+    case ESP_GATTC_CONNECT_EVT:
+        idx = link_by_bda(p_data->connect.remote_bda);
+        if (idx < 0) {
+            ESP_LOGW(GATTC_TAG, "Connection from an unknown device, conn_id=%d", p_data->connect.conn_id);
+            break;
+        }
+        ESP_LOGI(GATTC_TAG, "ESP_GATTC_CONNECT_EVT: link=%d, conn_id=%d, gatt_if = %d", idx, p_data->connect.conn_id, gattc_if);
+        ESP_LOGI(GATTC_TAG, "REMOTE BDA:");
+        esp_log_buffer_hex(GATTC_TAG, p_data->connect.remote_bda, sizeof(esp_bd_addr_t));
+        links[idx].conn_id = p_data->connect.conn_id;
+        links[idx].conn_handle = p_data->connect.conn_handle;
+        links[idx].conn_interval = p_data->connect.conn_params.interval;
+        links[idx].link_up = true;
+        if (connecting_link == idx) {
+            connecting_link = -1;
+        }
+        callbacks->connected((ble_link_t)idx);
+        esp_ble_gattc_search_service(spp_gattc_if, links[idx].conn_id, &spp_service_uuid);
+        start_scan();
+        break;
+    case ESP_GATTC_DISCONNECT_EVT:
+        idx = link_by_bda(p_data->disconnect.remote_bda);
+        if (idx < 0) {
+            break;
+        }
+        ESP_LOGI(GATTC_TAG, "disconnect link %d, reason 0x%x", idx, p_data->disconnect.reason);
+
+        free_link(idx);
+        callbacks->disconnected((ble_link_t)idx);
+        start_scan();
+        break;
+    case ESP_GATTC_SEARCH_RES_EVT:
+        ESP_LOGI(GATTC_TAG, "ESP_GATTC_SEARCH_RES_EVT: start_handle = %d, end_handle = %d, UUID:0x%04x",p_data->search_res.start_handle,p_data->search_res.end_handle,p_data->search_res.srvc_id.uuid.uuid.uuid16);
+        if ((idx = link_by_conn_id(p_data->search_res.conn_id)) >= 0) {
+            links[idx].srv_start_handle = p_data->search_res.start_handle;
+            links[idx].srv_end_handle = p_data->search_res.end_handle;
+        }
+        break;
+    case ESP_GATTC_SEARCH_CMPL_EVT:
+        ESP_LOGI(GATTC_TAG, "SEARCH_CMPL: conn_id = %x, status %d", p_data->search_cmpl.conn_id, p_data->search_cmpl.status);
+        if ((idx = link_by_conn_id(p_data->search_cmpl.conn_id)) < 0) {
+            break;
+        }
+        if (p_data->search_cmpl.status != ESP_GATT_OK || links[idx].srv_start_handle == 0) {
+            drop_link(idx, "SPP service discovery");
+            break;
+        }
+        if (esp_ble_gattc_send_mtu_req(gattc_if, p_data->search_cmpl.conn_id) != ESP_OK) {
+            read_db(idx);
+        }
+        break;
+    case ESP_GATTC_REG_FOR_NOTIFY_EVT: {
+        idx = registering_link;
+        registering_link = -1;
+        xSemaphoreGive(reg_done);
+        ESP_LOGI(GATTC_TAG,"Link = %d,status = %d,handle = %d", idx, p_data->reg_for_notify.status, p_data->reg_for_notify.handle);
+        if (idx < 0 || links[idx].db == NULL) {
+            break;
+        }
+        if(p_data->reg_for_notify.status != ESP_GATT_OK){
+            ESP_LOGE(GATTC_TAG, "ESP_GATTC_REG_FOR_NOTIFY_EVT, status = %d", p_data->reg_for_notify.status);
+            drop_link(idx, "subscribe");
+            break;
+        }
+        uint16_t notify_en = 1;
+        if (esp_ble_gattc_write_char_descr(
+                spp_gattc_if,
+                links[idx].conn_id,
+                (links[idx].db+links[idx].cmd+1)->attribute_handle,
+                sizeof(notify_en),
+                (uint8_t *)&notify_en,
+                ESP_GATT_WRITE_TYPE_NO_RSP,
+                ESP_GATT_AUTH_REQ_NONE) != ESP_OK) {
+            drop_link(idx, "subscribe");
+        }
+        break;
+    }
+    case ESP_GATTC_NOTIFY_EVT:
+        ESP_LOGI(GATTC_TAG,"ESP_GATTC_NOTIFY_EVT");
+        if ((idx = link_by_conn_id(p_data->notify.conn_id)) >= 0) {
+            notify_event_handler(idx, p_data);
+        }
+        break;
+    case ESP_GATTC_READ_CHAR_EVT:
+        ESP_LOGI(GATTC_TAG,"ESP_GATTC_READ_CHAR_EVT");
+        break;
+    case ESP_GATTC_WRITE_CHAR_EVT:
+        ESP_LOGI(GATTC_TAG,"ESP_GATTC_WRITE_CHAR_EVT:status = %d,handle = %d", param->write.status, param->write.handle);
+        if(param->write.status != ESP_GATT_OK){
+            ESP_LOGE(GATTC_TAG, "ESP_GATTC_WRITE_CHAR_EVT, error status = %d", p_data->write.status);
+            break;
+        }
+        break;
+    case ESP_GATTC_PREP_WRITE_EVT:
+        break;
+    case ESP_GATTC_EXEC_EVT:
+        break;
+    case ESP_GATTC_WRITE_DESCR_EVT:
+        ESP_LOGI(GATTC_TAG,"ESP_GATTC_WRITE_DESCR_EVT: status =%d,handle = %d", p_data->write.status, p_data->write.handle);
+        if ((idx = link_by_conn_id(p_data->write.conn_id)) < 0) {
+            break;
+        }
+        if(p_data->write.status != ESP_GATT_OK){
+            ESP_LOGE(GATTC_TAG, "ESP_GATTC_WRITE_DESCR_EVT, error status = %d", p_data->write.status);
+            drop_link(idx, "subscribe");
+            break;
+        }
+        switch(links[idx].cmd){
+        case SPP_IDX_SPP_DATA_NTY_VAL:
+            links[idx].cmd = SPP_IDX_SPP_STATUS_VAL;
+            queue_reg(idx, links[idx].cmd);
+            break;
+        case SPP_IDX_SPP_STATUS_VAL:
+#ifdef SUPPORT_HEARTBEAT
+            if (idx == BLE_LINK_PRIMARY) {
+                links[idx].cmd = SPP_IDX_SPP_HEARTBEAT_VAL;
+                queue_reg(idx, links[idx].cmd);
+            }
+#endif
+            break;
+#ifdef SUPPORT_HEARTBEAT
+        case SPP_IDX_SPP_HEARTBEAT_VAL: {
+            uint32_t cmd = links[idx].cmd;
+            xQueueSend(cmd_heartbeat_queue, &cmd, 10/portTICK_PERIOD_MS);
+            break;
+        }
+#endif
+        default:
+            break;
+        };
+        break;
+    case ESP_GATTC_CFG_MTU_EVT:
+        if ((idx = link_by_conn_id(p_data->cfg_mtu.conn_id)) < 0 || links[idx].db != NULL) {
+            break;
+        }
+        // A refused exchange leaves the default MTU, discovery goes on
+        if(p_data->cfg_mtu.status == ESP_GATT_OK){
+            ESP_LOGI(GATTC_TAG,"+MTU:%d, link %d", p_data->cfg_mtu.mtu, idx);
+            links[idx].mtu_size = p_data->cfg_mtu.mtu;
+        }
+        read_db(idx);
+        break;
+    case ESP_GATTC_SRVC_CHG_EVT:
+        break;
+    default:
+        break;
+    }
+}
+
+// Registrations go one at a time, the completion event only has the handle
+static void spp_client_reg_task(void* arg)
+{
+    uint32_t item;
+    for(;;) {
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+        if(xQueueReceive(cmd_reg_queue, &item, portMAX_DELAY)) {
+            int idx = item >> 16;
+            uint16_t cmd_id = item & 0xFFFF;
+            esp_gattc_db_elem_t *db = links[idx].db;
+            if(db == NULL || cmd_id >= SPP_IDX_NB) {
+                continue;
+            }
+            ESP_LOGI(GATTC_TAG,"Link = %d,Index = %d,UUID = 0x%04x, handle = %d", idx, cmd_id, (db+cmd_id)->uuid.uuid.uuid16, (db+cmd_id)->attribute_handle);
+            xSemaphoreTake(reg_done, 0);
+            registering_link = idx;
+            esp_ble_gattc_register_for_notify(spp_gattc_if, links[idx].remote_bda, (db+cmd_id)->attribute_handle);
+            if (xSemaphoreTake(reg_done, pdMS_TO_TICKS(REG_FOR_NOTIFY_TIMEOUT_MS)) != pdTRUE) {
+                registering_link = -1;
+                drop_link(idx, "notify registration");
+            }
+        }
+    }
+}
+
+#ifdef SUPPORT_HEARTBEAT
+static void spp_heart_beat_task(void * arg)
+{
+    uint32_t cmd_id;
+    spp_link_t *link = &links[BLE_LINK_PRIMARY];
+
+    for(;;) {
+        vTaskDelay(50 / portTICK_PERIOD_MS);
+        if(xQueueReceive(cmd_heartbeat_queue, &cmd_id, portMAX_DELAY)) {
+            while(1){
+                if((link->link_up == true) && (link->db != NULL) && ((link->db+SPP_IDX_SPP_HEARTBEAT_VAL)->properties & (ESP_GATT_CHAR_PROP_BIT_WRITE_NR | ESP_GATT_CHAR_PROP_BIT_WRITE))){
+                    esp_ble_gattc_write_char( spp_gattc_if,
+                                              link->conn_id,
+                                              (link->db+SPP_IDX_SPP_HEARTBEAT_VAL)->attribute_handle,
+                                              sizeof(heartbeat_s),
+                                              (uint8_t *)heartbeat_s,
+                                              ESP_GATT_WRITE_TYPE_NO_RSP,
+                                              ESP_GATT_AUTH_REQ_NONE);
+                    vTaskDelay(5000 / portTICK_PERIOD_MS);
+                }else{
+                    ESP_LOGI(GATTC_TAG,"disconnect");
+                    break;
+                }
+            }
+        }
+    }
+}
+#endif
+
+static void ble_client_appRegister(void)
+{
+    esp_err_t status;
+    char err_msg[20];
+
+    ESP_LOGI(GATTC_TAG, "register callback");
+
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        free_link(i);
+    }
+    cmd_reg_queue = xQueueCreate(10, sizeof(uint32_t));
+    reg_done = xSemaphoreCreateBinary();
+
+    //register the scan callback function to the gap module
+    if ((status = esp_ble_gap_register_callback(esp_gap_cb)) != ESP_OK) {
+        ESP_LOGE(GATTC_TAG, "gap register error: %s", esp_err_to_name_r(status, err_msg, sizeof(err_msg)));
+        return;
+    }
+    //register the callback function to the gattc module
+    if ((status = esp_ble_gattc_register_callback(esp_gattc_cb)) != ESP_OK) {
+        ESP_LOGE(GATTC_TAG, "gattc register error: %s", esp_err_to_name_r(status, err_msg, sizeof(err_msg)));
+        return;
+    }
+    esp_ble_gattc_app_register(PROFILE_APP_ID);
+
+    // Just Works LE Secure Connections without a bond, see ble_transport.h
+    esp_ble_auth_req_t auth_req = ESP_LE_AUTH_REQ_SC_ONLY;
+    esp_ble_io_cap_t io_cap = ESP_IO_CAP_NONE;
+    uint8_t key_size = 16;
+    esp_ble_gap_set_security_param(ESP_BLE_SM_AUTHEN_REQ_MODE, &auth_req, sizeof(auth_req));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_IOCAP_MODE, &io_cap, sizeof(io_cap));
+    esp_ble_gap_set_security_param(ESP_BLE_SM_MAX_KEY_SIZE, &key_size, sizeof(key_size));
+
+    esp_err_t local_mtu_ret = esp_ble_gatt_set_local_mtu(BLE_PREFERRED_MTU);
+    if (local_mtu_ret){
+        ESP_LOGE(GATTC_TAG, "set local  MTU failed: %s", esp_err_to_name_r(local_mtu_ret, err_msg, sizeof(err_msg)));
+    }
+
+    xTaskCreate(spp_client_reg_task, "spp_client_reg_task", 2048, NULL, 10, NULL);
+
+#ifdef SUPPORT_HEARTBEAT
+    cmd_heartbeat_queue = xQueueCreate(10, sizeof(uint32_t));
+    xTaskCreate(spp_heart_beat_task, "spp_heart_beat_task", 2048, NULL, 10, NULL);
+#endif
+}
+
+esp_err_t ble_transport_init(const ble_transport_callbacks_t *cbs)
+{
+    esp_err_t ret;
+
+    callbacks = cbs;
+    esp_log_level_set(GATTC_TAG, ESP_LOG_WARN);
+
+    ESP_ERROR_CHECK(esp_bt_controller_mem_release(ESP_BT_MODE_CLASSIC_BT));
+
+    esp_bt_controller_config_t bt_cfg = BT_CONTROLLER_INIT_CONFIG_DEFAULT();
+
+    ret = esp_bt_controller_init(&bt_cfg);
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ret = esp_bt_controller_enable(ESP_BT_MODE_BLE);
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "%s enable controller failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(GATTC_TAG, "%s init bluetooth", __func__);
+
+    ret = esp_bluedroid_init();
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "%s init bluetooth failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+    ret = esp_bluedroid_enable();
+    if (ret) {
+        ESP_LOGE(GATTC_TAG, "%s enable bluetooth failed: %s", __func__, esp_err_to_name(ret));
+        return ret;
+    }
+
+    ble_client_appRegister();
+    return ESP_OK;
+}
+
+bool ble_transport_ready(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return false;
+    }
+    esp_gattc_db_elem_t *db = links[link].db;
+    return links[link].link_up && db != NULL &&
+        ((db+SPP_IDX_SPP_DATA_RECV_VAL)->properties &
+         (ESP_GATT_CHAR_PROP_BIT_WRITE_NR | ESP_GATT_CHAR_PROP_BIT_WRITE));
+}
+
+esp_err_t ble_transport_request_encryption(ble_link_t link)
+{
+    if (!ble_transport_ready(link)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (links[link].encrypted) {
+        return ESP_OK;
+    }
+    return esp_ble_set_encryption(links[link].remote_bda, ESP_BLE_SEC_ENCRYPT_NO_MITM);
+}
+
+bool ble_transport_encrypted(ble_link_t link)
+{
+    return ble_transport_ready(link) && links[link].encrypted;
+}
+
+esp_err_t ble_transport_write(ble_link_t link, const uint8_t *data, size_t len)
+{
+    if (!ble_transport_ready(link)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_ble_gattc_write_char(
+        spp_gattc_if,
+        links[link].conn_id,
+        (links[link].db+SPP_IDX_SPP_DATA_RECV_VAL)->attribute_handle,
+        len,
+        (uint8_t *)data,
+        ESP_GATT_WRITE_TYPE_NO_RSP,
+        ESP_GATT_AUTH_REQ_NONE
+    );
+}
+
+esp_err_t ble_transport_write_command(ble_link_t link, const uint8_t *data, size_t len)
+{
+    if (!ble_transport_ready(link) ||
+        !((links[link].db+SPP_IDX_SPP_COMMAND_VAL)->properties & ESP_GATT_CHAR_PROP_BIT_WRITE)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_ble_gattc_write_char(
+        spp_gattc_if,
+        links[link].conn_id,
+        (links[link].db+SPP_IDX_SPP_COMMAND_VAL)->attribute_handle,
+        len,
+        (uint8_t *)data,
+        ESP_GATT_WRITE_TYPE_RSP,
+        ESP_GATT_AUTH_REQ_NONE
+    );
+}
+
+uint16_t ble_transport_mtu(ble_link_t link)
+{
+    return link < BLE_MAX_LINKS ? links[link].mtu_size : 23;
+}
+
+uint16_t ble_transport_conn_interval(ble_link_t link)
+{
+    return link < BLE_MAX_LINKS && links[link].link_up ? links[link].conn_interval : 0;
+}
+
+int ble_transport_conn_handle(ble_link_t link)
+{
+    return link < BLE_MAX_LINKS && links[link].link_up ? links[link].conn_handle : -1;
+}
+
+esp_err_t ble_transport_request_rssi(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS || !links[link].link_up) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return esp_ble_gap_read_rssi(links[link].remote_bda);
+}
+
+const char *ble_transport_name(void)
+{
+    return "Bluedroid";
+}
+
+#endif // CONFIG_BT_BLUEDROID_ENABLED
@@ -0,0 +1,476 @@
+// NimBLE backend of ble_transport.h. Same steps as the Bluedroid backend:
+// scan for the peer names, connect, exchange MTU, discover the SPP service,
+// report ready once the data receive characteristic is found and writable,
+// then subscribe to the data and status notifies. Any failed step drops the
+// link, which is then found again by the scan. Each step is started from the
+// completion callback of the previous one, all in the NimBLE host task. The
+// link index rides along as the callback argument.
+
+#include "sdkconfig.h"
+#if CONFIG_BT_NIMBLE_ENABLED
+
+#include <stdint.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "ble_transport.h"
+
+#define TAG "BLE_NIMBLE"
+
+#define CONNECT_TIMEOUT_MS  30000
+
+#define LINK_ARG(idx)       ((void *)(intptr_t)(idx))
+#define ARG_LINK(arg)       ((int)(intptr_t)(arg))
+
+// One connection to a peer, indexed by ble_link_t
+typedef struct {
+    uint16_t conn_handle;
+    uint16_t service_start;
+    uint16_t service_end;
+    uint16_t data_recv_handle;
+    uint16_t data_notify_handle;
+    uint16_t command_handle;
+    uint16_t status_notify_handle;
+    uint16_t subscribing;           // Value handle whose CCCD write is pending
+    bool data_recv_writable;
+    volatile bool ready;            // Data receive found and writable, as in ble_bluedroid.c
+    volatile bool encrypted;
+} nimble_link_t;
+
+static const ble_transport_callbacks_t *callbacks = NULL;
+static uint8_t own_addr_type;
+static bool synced = false;
+static bool background_scan = false;
+
+static const char *const peer_names[BLE_MAX_LINKS] = BLE_PEER_NAMES;
+static const uint16_t conn_intervals[BLE_MAX_LINKS] = BLE_CONN_INTERVALS;
+static nimble_link_t links[BLE_MAX_LINKS];
+static int connecting_link = -1;
+
+// Largest notify accepted, anything longer is cut and then rejected by the decoder
+static uint8_t notify_buffer[BLE_PREFERRED_MTU];
+
+static int gap_event(struct ble_gap_event *event, void *arg);
+
+static void reset_link(int idx)
+{
+    memset(&links[idx], 0, sizeof(links[idx]));
+    links[idx].conn_handle = BLE_HS_CONN_HANDLE_NONE;
+}
+
+static void start_scan(void)
+{
+    if (!synced || connecting_link >= 0) {
+        return;
+    }
+    bool missing = false;
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        missing |= links[i].conn_handle == BLE_HS_CONN_HANDLE_NONE;
+    }
+    // Scanning for optional peers must not crowd out the primary link
+    bool background = links[BLE_LINK_PRIMARY].conn_handle != BLE_HS_CONN_HANDLE_NONE;
+    if (ble_gap_disc_active()) {
+        if (missing && background == background_scan) {
+            return;
+        }
+        ble_gap_disc_cancel();
+    }
+    if (!missing) {
+        return;
+    }
+
+    struct ble_gap_disc_params params = {
+        .itvl = background ? BLE_BACKGROUND_SCAN_INTERVAL : BLE_SCAN_INTERVAL,
+        .window = background ? BLE_BACKGROUND_SCAN_WINDOW : BLE_SCAN_WINDOW,
+        .filter_duplicates = 0,
+        .passive = 0,           // Active, the name is in the scan response
+    };
+    int rc = ble_gap_disc(own_addr_type, BLE_HS_FOREVER, &params, gap_event, NULL);
+    if (rc != 0 && rc != BLE_HS_EALREADY) {
+        ESP_LOGE(TAG, "Scan start failed: %d", rc);
+        return;
+    }
+    background_scan = background;
+}
+
+// Link waiting for the advertised name, -1 for none or one already connected
+static int peer_link(const struct ble_gap_disc_desc *disc)
+{
+    struct ble_hs_adv_fields fields;
+    if (ble_hs_adv_parse_fields(&fields, disc->data, disc->length_data) != 0 ||
+        fields.name == NULL || !fields.name_is_complete) {
+        return -1;
+    }
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        if (fields.name_len == strlen(peer_names[i]) &&
+            memcmp(fields.name, peer_names[i], fields.name_len) == 0) {
+            return links[i].conn_handle == BLE_HS_CONN_HANDLE_NONE ? i : -1;
+        }
+    }
+    return -1;
+}
+
+static void connect_peer(int idx, const ble_addr_t *addr)
+{
+    struct ble_gap_conn_params params = {
+        .scan_itvl = BLE_SCAN_INTERVAL,
+        .scan_window = BLE_SCAN_WINDOW,
+        .itvl_min = conn_intervals[idx],
+        .itvl_max = conn_intervals[idx],
+        .latency = 0,
+        .supervision_timeout = BLE_CONN_SUPERVISION_TIMEOUT,
+        .min_ce_len = 0,
+        .max_ce_len = 0,
+    };
+
+    ble_gap_disc_cancel();
+    int rc = ble_gap_connect(own_addr_type, addr, CONNECT_TIMEOUT_MS, &params, gap_event, LINK_ARG(idx));
+    if (rc != 0) {
+        ESP_LOGE(TAG, "Connect to %s failed: %d", peer_names[idx], rc);
+        start_scan();
+        return;
+    }
+    connecting_link = idx;
+}
+
+// A failed step drops the link, like the Bluedroid backend: the disconnect
+// event resets it and scanning finds the peer again
+static void drop_link(uint16_t conn, int idx, const char *step, int rc)
+{
+    ESP_LOGE(TAG, "Link %d: %s failed: %d, disconnecting", idx, step, rc);
+    links[idx].ready = false;
+    ble_gap_terminate(conn, BLE_ERR_REM_USER_CONN_TERM);
+}
+
+static int on_subscribed(uint16_t conn, const struct ble_gatt_error *error,
+                         struct ble_gatt_attr *attr, void *arg)
+{
+    int idx = ARG_LINK(arg);
+    nimble_link_t *link = &links[idx];
+
+    if (error->status != 0) {
+        drop_link(conn, idx, "subscribe", error->status);
+        return 0;
+    }
+
+    // Data notify first, then status, like the Bluedroid registration order
+    if (link->subscribing == link->data_notify_handle && link->status_notify_handle != 0) {
+        static const uint8_t enable[2] = {1, 0};
+        link->subscribing = link->status_notify_handle;
+        int rc = ble_gattc_write_flat(conn, link->status_notify_handle + 1, enable, sizeof(enable),
+                                      on_subscribed, arg);
+        if (rc != 0) {
+            drop_link(conn, idx, "subscribe", rc);
+        }
+        return 0;
+    }
+    link->subscribing = 0;
+    ESP_LOGI(TAG, "Link %d subscribed, MTU %d", idx, ble_att_mtu(conn));
+    return 0;
+}
+
+static int on_characteristic(uint16_t conn, const struct ble_gatt_error *error,
+                             const struct ble_gatt_chr *chr, void *arg)
+{
+    int idx = ARG_LINK(arg);
+    nimble_link_t *link = &links[idx];
+
+    if (error->status == 0) {
+        switch (ble_uuid_u16(&chr->uuid.u)) {
+            case BLE_SPP_DATA_RECV_UUID:
+                link->data_recv_handle = chr->val_handle;
+                link->data_recv_writable =
+                    (chr->properties & (BLE_GATT_CHR_PROP_WRITE_NO_RSP | BLE_GATT_CHR_PROP_WRITE)) != 0;
+                break;
+            case BLE_SPP_DATA_NOTIFY_UUID:
+                link->data_notify_handle = chr->val_handle;
+                break;
+            case BLE_SPP_COMMAND_UUID:
+                link->command_handle = chr->val_handle;
+                break;
+            case BLE_SPP_STATUS_UUID:
+                link->status_notify_handle = chr->val_handle;
+                break;
+            default:
+                break;
+        }
+        return 0;
+    }
+    if (error->status != BLE_HS_EDONE) {
+        drop_link(conn, idx, "characteristic discovery", error->status);
+        return 0;
+    }
+    if (link->data_recv_handle == 0 || !link->data_recv_writable || link->data_notify_handle == 0) {
+        drop_link(conn, idx, "SPP characteristics", BLE_HS_ENOENT);
+        return 0;
+    }
+
+    // Ready as soon as throttle writes can go out, as ble_bluedroid.c is
+    // once it has read the GATT database; subscriptions follow
+    link->ready = true;
+    ESP_LOGI(TAG, "Link %d ready, MTU %d", idx, ble_att_mtu(conn));
+
+    // The CCCD follows the value, the layout the Bluedroid backend relies on too
+    static const uint8_t enable[2] = {1, 0};
+    link->subscribing = link->data_notify_handle;
+    int rc = ble_gattc_write_flat(conn, link->data_notify_handle + 1, enable, sizeof(enable), on_subscribed, arg);
+    if (rc != 0) {
+        drop_link(conn, idx, "subscribe", rc);
+    }
+    return 0;
+}
+
+static int on_service(uint16_t conn, const struct ble_gatt_error *error,
+                      const struct ble_gatt_svc *service, void *arg)
+{
+    int idx = ARG_LINK(arg);
+    nimble_link_t *link = &links[idx];
+
+    if (error->status == 0) {
+        link->service_start = service->start_handle;
+        link->service_end = service->end_handle;
+        return 0;
+    }
+    if (error->status != BLE_HS_EDONE || link->service_start == 0) {
+        drop_link(conn, idx, "SPP service discovery", error->status);
+        return 0;
+    }
+    int rc = ble_gattc_disc_all_chrs(conn, link->service_start, link->service_end, on_characteristic, arg);
+    if (rc != 0) {
+        drop_link(conn, idx, "characteristic discovery", rc);
+    }
+    return 0;
+}
+
+static int on_mtu(uint16_t conn, const struct ble_gatt_error *error, uint16_t mtu, void *arg)
+{
+    // A refused exchange leaves the default MTU, discovery goes on
+    if (error->status == 0) {
+        ESP_LOGI(TAG, "+MTU:%d, link %d", mtu, ARG_LINK(arg));
+    }
+    static const ble_uuid16_t service_uuid = BLE_UUID16_INIT(BLE_SPP_SERVICE_UUID);
+    int rc = ble_gattc_disc_svc_by_uuid(conn, &service_uuid.u, on_service, arg);
+    if (rc != 0) {
+        drop_link(conn, ARG_LINK(arg), "SPP service discovery", rc);
+    }
+    return 0;
+}
+
+static int gap_event(struct ble_gap_event *event, void *arg)
+{
+    int idx = ARG_LINK(arg);    // 0 for scan events, which are not tied to a link
+    nimble_link_t *link = &links[idx];
+
+    switch (event->type) {
+        case BLE_GAP_EVENT_DISC: {
+            int peer = peer_link(&event->disc);
+            if (peer >= 0 && connecting_link < 0) {
+                ESP_LOGI(TAG, "Found device %s, RSSI: %d", peer_names[peer], event->disc.rssi);
+                connect_peer(peer, &event->disc.addr);
+            }
+            return 0;
+        }
+
+        case BLE_GAP_EVENT_CONNECT:
+            connecting_link = -1;
+            if (event->connect.status != 0) {
+                ESP_LOGW(TAG, "Connection to %s failed: %d", peer_names[idx], event->connect.status);
+                start_scan();
+                return 0;
+            }
+            link->conn_handle = event->connect.conn_handle;
+            callbacks->connected((ble_link_t)idx);
+            int rc = ble_gattc_exchange_mtu(link->conn_handle, on_mtu, arg);
+            if (rc != 0) {
+                drop_link(link->conn_handle, idx, "MTU exchange", rc);
+            }
+            start_scan();
+            return 0;
+
+        case BLE_GAP_EVENT_DISCONNECT:
+            ESP_LOGI(TAG, "disconnect link %d, reason %d", idx, event->disconnect.reason);
+            reset_link(idx);
+            callbacks->disconnected((ble_link_t)idx);
+            start_scan();
+            return 0;
+
+        case BLE_GAP_EVENT_ENC_CHANGE: {
+            struct ble_gap_conn_desc desc;
+            link->encrypted = event->enc_change.status == 0 &&
+                ble_gap_conn_find(event->enc_change.conn_handle, &desc) == 0 && desc.sec_state.encrypted;
+            if (event->enc_change.status != 0) {
+                ESP_LOGE(TAG, "Link %d pairing failed: %d", idx, event->enc_change.status);
+            }
+            return 0;
+        }
+
+        case BLE_GAP_EVENT_DISC_COMPLETE:
+            // Also reported when a scan is cancelled to connect or change parameters
+            if (event->disc_complete.reason != 0) {
+                start_scan();
+            }
+            return 0;
+
+        case BLE_GAP_EVENT_NOTIFY_RX:
+            if (event->notify_rx.attr_handle == link->data_notify_handle) {
+                uint16_t len = 0;
+                ble_hs_mbuf_to_flat(event->notify_rx.om, notify_buffer, sizeof(notify_buffer), &len);
+                callbacks->notify((ble_link_t)idx, notify_buffer, len);
+            } else if (link->status_notify_handle != 0 && event->notify_rx.attr_handle == link->status_notify_handle) {
+                uint16_t len = 0;
+                ble_hs_mbuf_to_flat(event->notify_rx.om, notify_buffer, sizeof(notify_buffer), &len);
+                callbacks->status((ble_link_t)idx, notify_buffer, len);
+            }
+            return 0;
+
+        default:
+            return 0;
+    }
+}
+
+static void on_sync(void)
+{
+    int rc = ble_hs_util_ensure_addr(0);
+    if (rc == 0) {
+        rc = ble_hs_id_infer_auto(0, &own_addr_type);
+    }
+    if (rc != 0) {
+        ESP_LOGE(TAG, "No usable address: %d", rc);
+        return;
+    }
+    synced = true;
+    start_scan();
+}
+
+static void on_reset(int reason)
+{
+    ESP_LOGW(TAG, "Host reset, reason %d", reason);
+    synced = false;
+    connecting_link = -1;
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        reset_link(i);
+    }
+}
+
+static void host_task(void *param)
+{
+    nimble_port_run();          // Returns only after nimble_port_stop()
+    nimble_port_freertos_deinit();
+}
+
+esp_err_t ble_transport_init(const ble_transport_callbacks_t *cbs)
+{
+    callbacks = cbs;
+    esp_log_level_set(TAG, ESP_LOG_WARN);
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        reset_link(i);
+    }
+
+    esp_err_t ret = nimble_port_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "NimBLE init failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ble_hs_cfg.sync_cb = on_sync;
+    ble_hs_cfg.reset_cb = on_reset;
+    // Just Works LE Secure Connections without a bond, see ble_transport.h
+    ble_hs_cfg.sm_io_cap = BLE_SM_IO_CAP_NO_IO;
+    ble_hs_cfg.sm_bonding = 0;
+    ble_hs_cfg.sm_mitm = 0;
+    ble_hs_cfg.sm_sc = 1;
+    ble_att_set_preferred_mtu(BLE_PREFERRED_MTU);
+
+    nimble_port_freertos_init(host_task);
+    return ESP_OK;
+}
+
+bool ble_transport_ready(ble_link_t link)
+{
+    return link < BLE_MAX_LINKS && links[link].ready;
+}
+
+esp_err_t ble_transport_request_encryption(ble_link_t link)
+{
+    if (!ble_transport_ready(link)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (links[link].encrypted) {
+        return ESP_OK;
+    }
+    int rc = ble_gap_security_initiate(links[link].conn_handle);
+    return rc == 0 || rc == BLE_HS_EALREADY ? ESP_OK : ESP_FAIL;
+}
+
+bool ble_transport_encrypted(ble_link_t link)
+{
+    return ble_transport_ready(link) && links[link].encrypted;
+}
+
+esp_err_t ble_transport_write(ble_link_t link, const uint8_t *data, size_t len)
+{
+    if (!ble_transport_ready(link)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int rc = ble_gattc_write_no_rsp_flat(links[link].conn_handle, links[link].data_recv_handle, data, len);
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t ble_transport_write_command(ble_link_t link, const uint8_t *data, size_t len)
+{
+    if (!ble_transport_ready(link) || links[link].command_handle == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int rc = ble_gattc_write_flat(links[link].conn_handle, links[link].command_handle, data, len, NULL, NULL);
+    return rc == 0 ? ESP_OK : ESP_FAIL;
+}
+
+uint16_t ble_transport_mtu(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS || links[link].conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+        return BLE_ATT_MTU_DFLT;
+    }
+    return ble_att_mtu(links[link].conn_handle);
+}
+
+int ble_transport_conn_handle(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS || links[link].conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+        return -1;
+    }
+    return links[link].conn_handle;
+}
+
+uint16_t ble_transport_conn_interval(ble_link_t link)
+{
+    struct ble_gap_conn_desc desc;
+    if (link >= BLE_MAX_LINKS || links[link].conn_handle == BLE_HS_CONN_HANDLE_NONE ||
+        ble_gap_conn_find(links[link].conn_handle, &desc) != 0) {
+        return 0;
+    }
+    return desc.conn_itvl;
+}
+
+esp_err_t ble_transport_request_rssi(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS || links[link].conn_handle == BLE_HS_CONN_HANDLE_NONE) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    int8_t rssi = 0;
+    if (ble_gap_conn_rssi(links[link].conn_handle, &rssi) != 0) {
+        return ESP_FAIL;
+    }
+    // Synchronous here, delivered like the Bluedroid completion event
+    callbacks->rssi(link, rssi);
+    return ESP_OK;
+}
+
+const char *ble_transport_name(void)
+{
+    return "NimBLE";
+}
+
+#endif // CONFIG_BT_NIMBLE_ENABLED
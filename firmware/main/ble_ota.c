@@ -0,0 +1,569 @@
+#include "ble_ota.h"
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "ble_transport.h"
+#include "ble.h"
+#include "odometer.h"
+#include "ride_recorder.h"
+
+// The hash alone lets any receiver install anything, see ble_ota.h
+#if !CONFIG_SECURE_SIGNED_ON_UPDATE
+#error "BLE updates need signed images: enable CONFIG_SECURE_SIGNED_APPS_NO_SECURE_BOOT"
+#endif
+
+#define TAG "BLE_OTA"
+
+#define WRITE_QUEUE_LEN     4
+#define WRITER_POLL_MS      500
+
+typedef enum {
+    JOB_BEGIN,
+    JOB_WRITE,
+    JOB_FINISH,
+    JOB_ABORT,
+} ota_job_type_t;
+
+typedef struct {
+    ota_job_type_t type;
+    uint8_t buffer;
+    uint16_t len;
+} ota_job_t;
+
+static QueueHandle_t job_queue = NULL;
+static portMUX_TYPE status_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Bluetooth task side. The buffers are allocated on the first update and
+// kept, so an abort and a new BEGIN never race over freeing them.
+static uint8_t *buffers[2] = {NULL, NULL};
+static volatile bool buffer_busy[2] = {false, false};
+static uint8_t fill_buffer = 0;
+static uint16_t fill_len = 0;
+static uint8_t expected_hash[32];
+
+// Writer task side
+static esp_ota_handle_t ota_handle = 0;
+static const esp_partition_t *ota_partition = NULL;
+static mbedtls_sha256_context sha_ctx;
+
+// Shared, under status_lock
+static ble_ota_state_t state = BLE_OTA_STATE_IDLE;
+static ble_ota_result_t last_result = BLE_OTA_OK;
+static uint32_t image_size = 0;
+static uint32_t received = 0;
+static uint32_t written = 0;
+static uint32_t naks = 0;
+static uint32_t last_nak = UINT32_MAX;     // One NAK per resume offset, not per chunk in flight
+static int64_t start_us = 0;
+static int64_t last_chunk_us = 0;
+static uint32_t elapsed_ms = 0;
+static uint32_t bytes_per_s = 0;
+static volatile bool pending_verify = false;
+
+static inline void put_u16_le(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static inline void put_u32_le(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static inline uint32_t get_u32_le(const uint8_t *p)
+{
+    return p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void reply(uint8_t opcode, const uint8_t *payload, size_t len)
+{
+    uint8_t message[2 + 8];
+    message[0] = BLE_OTA_MAGIC;
+    message[1] = opcode;
+    memcpy(&message[2], payload, len);
+    esp_err_t ret = ble_transport_write_command(BLE_LINK_PRIMARY, message, 2 + len);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Reply 0x%02x not sent: %s", opcode, esp_err_to_name(ret));
+    }
+}
+
+static void reply_offset(uint8_t opcode, uint32_t offset)
+{
+    uint8_t payload[4];
+    put_u32_le(payload, offset);
+    reply(opcode, payload, sizeof(payload));
+}
+
+static void reply_done(ble_ota_result_t result, uint32_t rate)
+{
+    uint8_t payload[5];
+    payload[0] = result;
+    put_u32_le(&payload[1], rate);
+    reply(BLE_OTA_DONE, payload, sizeof(payload));
+}
+
+static uint16_t max_chunk(void)
+{
+    uint16_t mtu = ble_transport_mtu(BLE_LINK_PRIMARY);
+    return mtu - BLE_OTA_ATT_OVERHEAD - BLE_OTA_DATA_HEADER_LEN;
+}
+
+static void release_buffers(void)
+{
+    buffer_busy[0] = false;
+    buffer_busy[1] = false;
+}
+
+static void set_failed(ble_ota_result_t result)
+{
+    portENTER_CRITICAL(&status_lock);
+    state = BLE_OTA_STATE_FAILED;
+    last_result = result;
+    portEXIT_CRITICAL(&status_lock);
+}
+
+// Bluetooth task: hands the fill buffer to the writer
+static bool queue_fill_buffer(ota_job_type_t type)
+{
+    ota_job_t job = {.type = type, .buffer = fill_buffer, .len = fill_len};
+    buffer_busy[fill_buffer] = fill_len > 0;
+    if (xQueueSend(job_queue, &job, 0) != pdTRUE) {
+        buffer_busy[fill_buffer] = false;
+        return false;
+    }
+    fill_buffer ^= 1;
+    fill_len = 0;
+    return true;
+}
+
+static void abort_update(ble_ota_result_t result)
+{
+    set_failed(result);
+    ota_job_t job = {.type = JOB_ABORT};
+    xQueueSend(job_queue, &job, 0);
+    ESP_LOGW(TAG, "Update aborted: %s", ble_ota_result_name(result));
+}
+
+static void handle_begin(const uint8_t *data, size_t len)
+{
+    if (len != 2 + 4 + sizeof(expected_hash)) {
+        return;
+    }
+
+    ble_ota_result_t result = BLE_OTA_OK;
+    uint32_t size = get_u32_le(&data[2]);
+    const esp_partition_t *next = esp_ota_get_next_update_partition(NULL);
+    portENTER_CRITICAL(&status_lock);
+    bool busy = state == BLE_OTA_STATE_RECEIVING || state == BLE_OTA_STATE_VERIFYING ||
+                state == BLE_OTA_STATE_DONE;
+    portEXIT_CRITICAL(&status_lock);
+
+    if (!ble_transport_encrypted(BLE_LINK_PRIMARY)) {
+        result = BLE_OTA_ERR_UNENCRYPTED;
+        ble_transport_request_encryption(BLE_LINK_PRIMARY);
+    } else if (busy || buffer_busy[0] || buffer_busy[1]) {
+        result = BLE_OTA_ERR_BUSY;
+    } else if (next == NULL || size == 0 || size > next->size) {
+        result = BLE_OTA_ERR_SIZE;
+    } else if (abs(get_latest_erpm()) > BLE_OTA_MAX_ERPM) {
+        result = BLE_OTA_ERR_MOVING;
+    } else {
+        for (int i = 0; i < 2; i++) {
+            if (buffers[i] == NULL) {
+                buffers[i] = malloc(BLE_OTA_BUFFER_SIZE);
+            }
+        }
+        if (buffers[0] == NULL || buffers[1] == NULL) {
+            result = BLE_OTA_ERR_BUSY;
+        }
+    }
+    if (result != BLE_OTA_OK) {
+        uint8_t payload[7] = {result};
+        reply(BLE_OTA_READY, payload, sizeof(payload));
+        return;
+    }
+
+    memcpy(expected_hash, &data[6], sizeof(expected_hash));
+    fill_buffer = 0;
+    fill_len = 0;
+    last_nak = UINT32_MAX;
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&status_lock);
+    state = BLE_OTA_STATE_RECEIVING;
+    image_size = size;
+    received = 0;
+    written = 0;
+    naks = 0;
+    start_us = now;
+    last_chunk_us = now;
+    elapsed_ms = 0;
+    bytes_per_s = 0;
+    portEXIT_CRITICAL(&status_lock);
+
+    // The writer opens the slot and sends READY
+    ota_job_t job = {.type = JOB_BEGIN};
+    xQueueSend(job_queue, &job, 0);
+}
+
+static void handle_data(const uint8_t *data, size_t len)
+{
+    if (len <= BLE_OTA_DATA_HEADER_LEN) {
+        return;
+    }
+    uint32_t offset = get_u32_le(&data[2]);
+    const uint8_t *chunk = &data[BLE_OTA_DATA_HEADER_LEN];
+    size_t chunk_len = len - BLE_OTA_DATA_HEADER_LEN;
+
+    portENTER_CRITICAL(&status_lock);
+    bool accept = state == BLE_OTA_STATE_RECEIVING && offset == received &&
+                  received + chunk_len <= image_size;
+    uint32_t resume = received;
+    portEXIT_CRITICAL(&status_lock);
+    if (state != BLE_OTA_STATE_RECEIVING) {
+        return;
+    }
+
+    // A chunk spilling into the other buffer needs it to be free already
+    size_t room = BLE_OTA_BUFFER_SIZE - fill_len;
+    if (accept && (buffer_busy[fill_buffer] || (chunk_len > room && buffer_busy[fill_buffer ^ 1]))) {
+        accept = false;
+    }
+    if (!accept) {
+        // Chunks still in flight behind a NAK are dropped quietly
+        if (last_nak != resume || offset == resume) {
+            last_nak = resume;
+            portENTER_CRITICAL(&status_lock);
+            naks++;
+            portEXIT_CRITICAL(&status_lock);
+            reply_offset(BLE_OTA_NAK, resume);
+        }
+        return;
+    }
+    last_nak = UINT32_MAX;
+
+    size_t first = chunk_len < room ? chunk_len : room;
+    memcpy(&buffers[fill_buffer][fill_len], chunk, first);
+    fill_len += first;
+    if (fill_len == BLE_OTA_BUFFER_SIZE) {
+        if (!queue_fill_buffer(JOB_WRITE)) {
+            abort_update(BLE_OTA_ERR_FLASH);
+            return;
+        }
+        memcpy(buffers[fill_buffer], chunk + first, chunk_len - first);
+        fill_len = chunk_len - first;
+    }
+
+    portENTER_CRITICAL(&status_lock);
+    received += chunk_len;
+    last_chunk_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&status_lock);
+}
+
+static void handle_end(void)
+{
+    portENTER_CRITICAL(&status_lock);
+    bool complete = state == BLE_OTA_STATE_RECEIVING && received == image_size;
+    bool receiving = state == BLE_OTA_STATE_RECEIVING;
+    uint32_t resume = received;
+    if (complete) {
+        state = BLE_OTA_STATE_VERIFYING;
+    } else if (receiving) {
+        naks++;
+    }
+    portEXIT_CRITICAL(&status_lock);
+
+    if (complete) {
+        if (!queue_fill_buffer(JOB_FINISH)) {
+            abort_update(BLE_OTA_ERR_FLASH);
+        }
+    } else if (receiving) {
+        // Chunks went missing at the tail, the receiver resends and ends again
+        reply_offset(BLE_OTA_NAK, resume);
+    }
+}
+
+void ble_ota_handle_message(const uint8_t *data, size_t len)
+{
+    if (job_queue == NULL || len < 2 || data[0] != BLE_OTA_MAGIC) {
+        return;
+    }
+    switch (data[1]) {
+        case BLE_OTA_BEGIN:
+            handle_begin(data, len);
+            break;
+        case BLE_OTA_DATA:
+            handle_data(data, len);
+            break;
+        case BLE_OTA_END:
+            handle_end();
+            break;
+        case BLE_OTA_ABORT:
+            if (state == BLE_OTA_STATE_RECEIVING) {
+                abort_update(BLE_OTA_ERR_ABORTED);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void ble_ota_link_lost(void)
+{
+    if (job_queue != NULL && state == BLE_OTA_STATE_RECEIVING) {
+        abort_update(BLE_OTA_ERR_ABORTED);
+    }
+}
+
+// Writer task: everything that touches flash or the OTA handle
+static void writer_begin(void)
+{
+    ota_partition = esp_ota_get_next_update_partition(NULL);
+    esp_err_t ret = ota_partition ? esp_ota_begin(ota_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle)
+                                  : ESP_ERR_NOT_FOUND;
+    uint8_t payload[7] = {BLE_OTA_OK};
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(ret));
+        set_failed(BLE_OTA_ERR_FLASH);
+        ota_handle = 0;
+        payload[0] = BLE_OTA_ERR_FLASH;
+        reply(BLE_OTA_READY, payload, sizeof(payload));
+        return;
+    }
+    mbedtls_sha256_init(&sha_ctx);
+    mbedtls_sha256_starts(&sha_ctx, 0);
+
+    put_u16_le(&payload[1], max_chunk());
+    put_u32_le(&payload[3], BLE_OTA_WINDOW);
+    reply(BLE_OTA_READY, payload, sizeof(payload));
+    ESP_LOGI(TAG, "Receiving %lu bytes into %s, chunks up to %u bytes",
+             image_size, ota_partition->label, max_chunk());
+}
+
+// The state is already failed when the Bluetooth task asked for the abort
+static void writer_abort(void)
+{
+    if (ota_handle != 0) {
+        esp_ota_abort(ota_handle);
+        ota_handle = 0;
+        mbedtls_sha256_free(&sha_ctx);
+    }
+    release_buffers();
+}
+
+static bool writer_write(uint8_t buffer, uint16_t len)
+{
+    if (ota_handle == 0) {
+        buffer_busy[buffer] = false;
+        return false;
+    }
+    if (len > 0) {
+        esp_err_t ret = esp_ota_write(ota_handle, buffers[buffer], len);
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "OTA write failed: %s", esp_err_to_name(ret));
+            writer_abort();
+            set_failed(BLE_OTA_ERR_FLASH);
+            reply_done(BLE_OTA_ERR_FLASH, 0);
+            return false;
+        }
+        mbedtls_sha256_update(&sha_ctx, buffers[buffer], len);
+    }
+    buffer_busy[buffer] = false;
+
+    portENTER_CRITICAL(&status_lock);
+    written += len;
+    uint32_t on_flash = written;
+    portEXIT_CRITICAL(&status_lock);
+    reply_offset(BLE_OTA_ACK, on_flash);
+    return true;
+}
+
+static void writer_finish(uint8_t buffer, uint16_t len)
+{
+    if (!writer_write(buffer, len)) {
+        return;
+    }
+
+    uint8_t hash[32];
+    mbedtls_sha256_finish(&sha_ctx, hash);
+    mbedtls_sha256_free(&sha_ctx);
+    release_buffers();
+
+    ble_ota_result_t result = BLE_OTA_OK;
+    esp_err_t ret = ESP_OK;
+    if (memcmp(hash, expected_hash, sizeof(hash)) != 0) {
+        result = BLE_OTA_ERR_HASH;
+        esp_ota_abort(ota_handle);
+    } else if ((ret = esp_ota_end(ota_handle)) != ESP_OK) {
+        ESP_LOGE(TAG, "Image rejected: %s", esp_err_to_name(ret));
+        result = BLE_OTA_ERR_IMAGE;
+    } else if ((ret = esp_ota_set_boot_partition(ota_partition)) != ESP_OK) {
+        ESP_LOGE(TAG, "Setting boot partition failed: %s", esp_err_to_name(ret));
+        result = BLE_OTA_ERR_FLASH;
+    }
+    ota_handle = 0;
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&status_lock);
+    elapsed_ms = (uint32_t)((now - start_us) / 1000);
+    bytes_per_s = (uint32_t)((uint64_t)image_size * 1000000 / (uint64_t)(now - start_us));
+    state = result == BLE_OTA_OK ? BLE_OTA_STATE_DONE : BLE_OTA_STATE_FAILED;
+    last_result = result;
+    uint32_t rate = bytes_per_s;
+    portEXIT_CRITICAL(&status_lock);
+
+    reply_done(result, rate);
+    if (result != BLE_OTA_OK) {
+        ESP_LOGE(TAG, "Update failed: %s", ble_ota_result_name(result));
+        return;
+    }
+
+    ESP_LOGI(TAG, "%lu bytes in %lu ms (%lu B/s), restarting into %s",
+             image_size, elapsed_ms, rate, ota_partition->label);
+    odometer_flush();
+    ride_recorder_flush();
+    vTaskDelay(pdMS_TO_TICKS(BLE_OTA_RESTART_DELAY_MS));
+    esp_restart();
+}
+
+static void ota_writer_task(void *pvParameters)
+{
+    ota_job_t job;
+
+    while (1) {
+        if (xQueueReceive(job_queue, &job, pdMS_TO_TICKS(WRITER_POLL_MS)) != pdTRUE) {
+            // A receiver that stops sending leaves the slot open, close it
+            int64_t now = esp_timer_get_time();
+            portENTER_CRITICAL(&status_lock);
+            bool stalled = state == BLE_OTA_STATE_RECEIVING &&
+                           now - last_chunk_us > (int64_t)BLE_OTA_IDLE_TIMEOUT_MS * 1000;
+            portEXIT_CRITICAL(&status_lock);
+            if (stalled) {
+                ESP_LOGW(TAG, "No data for %d ms", BLE_OTA_IDLE_TIMEOUT_MS);
+                writer_abort();
+                set_failed(BLE_OTA_ERR_TIMEOUT);
+                reply_done(BLE_OTA_ERR_TIMEOUT, 0);
+            }
+            continue;
+        }
+
+        switch (job.type) {
+            case JOB_BEGIN:
+                writer_begin();
+                break;
+            case JOB_WRITE:
+                writer_write(job.buffer, job.len);
+                break;
+            case JOB_FINISH:
+                writer_finish(job.buffer, job.len);
+                break;
+            case JOB_ABORT:
+                writer_abort();
+                break;
+        }
+    }
+}
+
+// New image: confirm once the link has been up for a while, else roll back
+static void ota_confirm_task(void *pvParameters)
+{
+    int64_t boot_us = esp_timer_get_time();
+    int64_t link_up_since = 0;
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        if (ble_transport_ready(BLE_LINK_PRIMARY)) {
+            if (link_up_since == 0) {
+                link_up_since = now;
+            } else if (now - link_up_since >= (int64_t)BLE_OTA_CONFIRM_MS * 1000) {
+                esp_ota_mark_app_valid_cancel_rollback();
+                pending_verify = false;
+                ESP_LOGI(TAG, "New firmware confirmed");
+                break;
+            }
+        } else {
+            link_up_since = 0;
+        }
+
+        if (now - boot_us >= (int64_t)BLE_OTA_CONFIRM_TIMEOUT_MS * 1000) {
+            ESP_LOGE(TAG, "New firmware never held a link, rolling back");
+            odometer_flush();
+            ride_recorder_flush();
+            esp_err_t err = esp_ota_mark_app_invalid_rollback_and_reboot();
+            // Only returns on failure. An image still pending verification
+            // is rolled back by the bootloader on any reset, so restart
+            ESP_LOGE(TAG, "Rollback failed (%s), restarting", esp_err_to_name(err));
+            esp_restart();
+        }
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+    vTaskDelete(NULL);
+}
+
+esp_err_t ble_ota_init(void)
+{
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t img_state;
+    if (esp_ota_get_state_partition(running, &img_state) == ESP_OK &&
+        img_state == ESP_OTA_IMG_PENDING_VERIFY) {
+        pending_verify = true;
+        ESP_LOGW(TAG, "Running %s pending verification", running->label);
+        if (xTaskCreate(ota_confirm_task, "ota_confirm", 3072, NULL, 3, NULL) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    job_queue = xQueueCreate(WRITE_QUEUE_LEN, sizeof(ota_job_t));
+    if (job_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(ota_writer_task, "ota_writer", 4096, NULL, 5, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void ble_ota_get_status(ble_ota_status_t *status)
+{
+    portENTER_CRITICAL(&status_lock);
+    status->state = state;
+    status->result = last_result;
+    status->image_size = image_size;
+    status->received = received;
+    status->written = written;
+    status->naks = naks;
+    status->elapsed_ms = state == BLE_OTA_STATE_RECEIVING ?
+        (uint32_t)((esp_timer_get_time() - start_us) / 1000) : elapsed_ms;
+    status->bytes_per_s = bytes_per_s;
+    portEXIT_CRITICAL(&status_lock);
+    status->pending_verify = pending_verify;
+    status->running_partition = esp_ota_get_running_partition()->label;
+}
+
+const char *ble_ota_result_name(ble_ota_result_t result)
+{
+    switch (result) {
+        case BLE_OTA_OK:            return "ok";
+        case BLE_OTA_ERR_BUSY:      return "busy";
+        case BLE_OTA_ERR_SIZE:      return "bad size";
+        case BLE_OTA_ERR_MOVING:    return "board moving";
+        case BLE_OTA_ERR_FLASH:     return "flash error";
+        case BLE_OTA_ERR_HASH:      return "hash mismatch";
+        case BLE_OTA_ERR_IMAGE:     return "invalid image";
+        case BLE_OTA_ERR_ABORTED:   return "aborted";
+        case BLE_OTA_ERR_TIMEOUT:   return "timeout";
+        case BLE_OTA_ERR_UNENCRYPTED: return "link not encrypted";
+        default:                    return "unknown";
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef BLE_OTA_H
+#define BLE_OTA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Firmware update pushed by the receiver over the BLE link. The receiver is
+// the GATT server, so the image comes in as status characteristic notifies
+// (the server side of write-without-response) and the remote answers by
+// writing to the command characteristic. Both directions start with 'O':
+//
+//   receiver -> remote (status notify)
+//     'O' BEGIN  size (u32) sha256 (32)     start, image size and hash
+//     'O' DATA   offset (u32) bytes...      next chunk, at most max_chunk
+//     'O' END                               all bytes sent
+//     'O' ABORT
+//   remote -> receiver (command write)
+//     'O' READY  result (u8) max_chunk (u16) window (u32)
+//     'O' ACK    offset (u32)               bytes written to flash so far
+//     'O' NAK    offset (u32)               chunk out of order or END too early,
+//                                           resend from offset
+//     'O' DONE   result (u8) bytes_per_s (u32)
+//
+// All integers little endian. The receiver keeps at most window bytes past
+// the last ACK in flight. Chunks are copied into one of two buffers in the
+// Bluetooth task; a full buffer goes to the writer task for esp_ota_write
+// and the hash while the other one fills, and its ACK goes out once it is
+// on flash. The window is both buffers, so a chunk always has room.
+//
+// The image is written to the next OTA slot. After END the SHA-256 must
+// match BEGIN and esp_ota_end must accept the image before the slot is made
+// the boot partition and the remote restarts. The new firmware boots
+// pending verification: it confirms itself once the BLE link has been up
+// for BLE_OTA_CONFIRM_MS, and rolls back to the previous slot if that has
+// not happened within BLE_OTA_CONFIRM_TIMEOUT_MS of boot.
+//
+// Threat model. Anything in BLE range can advertise as the receiver, so
+// the receiver is not trusted with what it sends:
+// - The SHA-256 in BEGIN only catches a transfer that went wrong. Whoever
+//   sends the image also sends its hash.
+// - What keeps out a foreign image is the signature. The build signs the
+//   app (CONFIG_SECURE_SIGNED_APPS_NO_SECURE_BOOT, key in
+//   CONFIG_SECURE_BOOT_SIGNING_KEY), and esp_ota_end refuses an image that
+//   the key of the running app did not sign (BLE_OTA_ERR_IMAGE).
+// - BEGIN is refused with BLE_OTA_ERR_UNENCRYPTED until the link is
+//   encrypted. The remote then starts pairing, and the receiver sends
+//   BEGIN again once it has. That keeps the image from a listener. Just
+//   Works pairing does not authenticate the receiver, so encryption adds
+//   nothing against a spoofed one; the signature covers that.
+// - Without secure boot the bootloader itself does not check signatures.
+//   Anyone with the board and a USB cable can still flash what they like.
+
+#define BLE_OTA_MAGIC               'O'
+#define BLE_OTA_BUFFER_SIZE         4096
+#define BLE_OTA_WINDOW              (2 * BLE_OTA_BUFFER_SIZE)
+#define BLE_OTA_DATA_HEADER_LEN     6       // 'O', DATA, offset
+#define BLE_OTA_ATT_OVERHEAD        3       // Notify opcode and handle
+#define BLE_OTA_IDLE_TIMEOUT_MS     5000    // No chunk for this long aborts
+#define BLE_OTA_RESTART_DELAY_MS    1500    // Lets DONE reach the receiver
+#define BLE_OTA_MAX_ERPM            100     // Refused while the board moves
+#define BLE_OTA_CONFIRM_MS          10000
+#define BLE_OTA_CONFIRM_TIMEOUT_MS  120000
+
+typedef enum {
+    BLE_OTA_BEGIN = 0x01,
+    BLE_OTA_DATA = 0x02,
+    BLE_OTA_END = 0x03,
+    BLE_OTA_ABORT = 0x04,
+    BLE_OTA_READY = 0x81,
+    BLE_OTA_ACK = 0x82,
+    BLE_OTA_NAK = 0x83,
+    BLE_OTA_DONE = 0x84,
+} ble_ota_opcode_t;
+
+typedef enum {
+    BLE_OTA_OK = 0,
+    BLE_OTA_ERR_BUSY = 1,
+    BLE_OTA_ERR_SIZE = 2,           // Empty or larger than the OTA slot
+    BLE_OTA_ERR_MOVING = 3,
+    BLE_OTA_ERR_FLASH = 4,
+    BLE_OTA_ERR_HASH = 5,
+    BLE_OTA_ERR_IMAGE = 6,          // Rejected by esp_ota_end
+    BLE_OTA_ERR_ABORTED = 7,
+    BLE_OTA_ERR_TIMEOUT = 8,
+    BLE_OTA_ERR_UNENCRYPTED = 9,    // Encryption requested, send BEGIN again
+} ble_ota_result_t;
+
+typedef enum {
+    BLE_OTA_STATE_IDLE,
+    BLE_OTA_STATE_RECEIVING,
+    BLE_OTA_STATE_VERIFYING,
+    BLE_OTA_STATE_DONE,             // Restarting into the new image
+    BLE_OTA_STATE_FAILED,
+} ble_ota_state_t;
+
+typedef struct {
+    ble_ota_state_t state;
+    ble_ota_result_t result;        // Of the last finished or failed update
+    uint32_t image_size;
+    uint32_t received;              // Contiguous bytes accepted
+    uint32_t written;               // Bytes on flash
+    uint32_t naks;
+    uint32_t elapsed_ms;
+    uint32_t bytes_per_s;
+    bool pending_verify;            // Running image not confirmed yet
+    const char *running_partition;
+} ble_ota_status_t;
+
+// Checks the running image and arms the rollback timer if it is new
+esp_err_t ble_ota_init(void);
+// Status characteristic notify starting with BLE_OTA_MAGIC, Bluetooth task
+void ble_ota_handle_message(const uint8_t *data, size_t len);
+// The link went down, an update in progress is abandoned
+void ble_ota_link_lost(void);
+void ble_ota_get_status(ble_ota_status_t *status);
+const char *ble_ota_result_name(ble_ota_result_t result);
+
+#endif // BLE_OTA_H
@@ -0,0 +1,99 @@
+#ifndef BLE_TRANSPORT_H
+#define BLE_TRANSPORT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Links to the GS-THUMB receiver and optional extra peripherals: scan,
+// connect, discover the SPP service, subscribe to the data notify
+// characteristic and write to the data receive characteristic. ble.c keeps
+// the protocol and application state and only talks to this interface. The
+// backend follows the Bluetooth host chosen in menuconfig (Component config >
+// Bluetooth > Host):
+//     Bluedroid  ble_bluedroid.c, the sdkconfig default
+//     NimBLE     ble_nimble.c, add sdkconfig.defaults.nimble
+// Both reconnect on their own after a disconnect. The console's ble_backend
+// command and tools/fake_thumb.py --backend-pings compare them on a device.
+//
+// Up to BLE_MAX_LINKS peers are connected at once, one per role, each found
+// by its advertised name. All of them serve the same SPP service and
+// telemetry frame: the second drive of a dual-drive board fills the VESC
+// part, a standalone BMS the BMS part. The throttle only goes to the primary
+// receiver. Every link gets a fixed connection interval that is a multiple
+// of the primary one, so the controller can place the extra links' events
+// between the primary's and they never push a throttle write back. Once the
+// primary is up, scanning for the missing optional peers continues at a low
+// duty cycle.
+
+typedef enum {
+    BLE_LINK_PRIMARY = 0,       // Receiver on the main controller, gets the throttle
+    BLE_LINK_SECONDARY,         // Second drive of a dual-drive board
+    BLE_LINK_BMS,               // Standalone BMS
+    BLE_MAX_LINKS,
+} ble_link_t;
+
+#define BLE_PEER_NAME               "GS-THUMB"
+#define BLE_SECONDARY_PEER_NAME     "GS-THUMB-2"
+#define BLE_BMS_PEER_NAME           "GS-BMS"
+#define BLE_PEER_NAMES              { BLE_PEER_NAME, BLE_SECONDARY_PEER_NAME, BLE_BMS_PEER_NAME }
+
+// Connection intervals in 1.25 ms units. The primary keeps the 30 ms the
+// hosts pick by default, the others are multiples of it.
+#define BLE_PRIMARY_CONN_INTERVAL   24          // 30 ms
+#define BLE_SECONDARY_CONN_INTERVAL 48          // 60 ms
+#define BLE_BMS_CONN_INTERVAL       96          // 120 ms
+#define BLE_CONN_INTERVALS          { BLE_PRIMARY_CONN_INTERVAL, BLE_SECONDARY_CONN_INTERVAL, BLE_BMS_CONN_INTERVAL }
+#define BLE_CONN_SUPERVISION_TIMEOUT 256        // 10 ms units
+
+// Scan parameters in 0.625 ms units, full while the primary is missing
+#define BLE_SCAN_INTERVAL           0x50
+#define BLE_SCAN_WINDOW             0x30
+#define BLE_BACKGROUND_SCAN_INTERVAL 0x320      // 500 ms
+#define BLE_BACKGROUND_SCAN_WINDOW  0x30        // 30 ms
+
+#define BLE_SPP_SERVICE_UUID        0xABF0
+#define BLE_SPP_DATA_RECV_UUID      0xABF1      // Throttle writes
+#define BLE_SPP_DATA_NOTIFY_UUID    0xABF2      // Telemetry notifies
+#define BLE_SPP_COMMAND_UUID        0xABF3
+#define BLE_SPP_STATUS_UUID         0xABF4
+#define BLE_PREFERRED_MTU           517         // Largest ATT MTU, for the OTA chunks
+
+// All callbacks run in the Bluetooth host task and must not block
+typedef struct {
+    void (*connected)(ble_link_t link);
+    void (*disconnected)(ble_link_t link);
+    void (*notify)(ble_link_t link, const uint8_t *data, size_t len);
+    void (*rssi)(ble_link_t link, int rssi);
+    void (*status)(ble_link_t link, const uint8_t *data, size_t len);   // Status characteristic notifies
+} ble_transport_callbacks_t;
+
+// Brings up the controller and host and starts scanning
+esp_err_t ble_transport_init(const ble_transport_callbacks_t *callbacks);
+// Connected and the data receive characteristic found and writable, on both
+// backends; a failed discovery or subscription step disconnects instead
+bool ble_transport_ready(ble_link_t link);
+// Pairs a ready link for encryption: LE Secure Connections, Just Works, no
+// bond, on both backends. ECDH keeps the session key from a listener, but
+// nothing authenticates the peer, so an attacker in the middle while the
+// link pairs is not caught. ESP_OK once started or already encrypted
+esp_err_t ble_transport_request_encryption(ble_link_t link);
+// Ready and encrypted; false again after a reconnect until paired again
+bool ble_transport_encrypted(ble_link_t link);
+// Write without response to the data receive characteristic
+esp_err_t ble_transport_write(ble_link_t link, const uint8_t *data, size_t len);
+// Write with response to the command characteristic
+esp_err_t ble_transport_write_command(ble_link_t link, const uint8_t *data, size_t len);
+// Negotiated ATT MTU, 23 until the exchange completes
+uint16_t ble_transport_mtu(ble_link_t link);
+// Connection interval in 1.25 ms units, 0 while not connected
+uint16_t ble_transport_conn_interval(ble_link_t link);
+// Controller connection handle, for per-connection controller settings
+// such as TX power; -1 while not connected
+int ble_transport_conn_handle(ble_link_t link);
+// Result arrives through the rssi callback
+esp_err_t ble_transport_request_rssi(ble_link_t link);
+const char *ble_transport_name(void);
+
+#endif // BLE_TRANSPORT_H
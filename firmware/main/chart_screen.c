@@ -0,0 +1,189 @@
+#include "chart_screen.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "ui.h"
+#include "fonts.h"
+#include "ui_updater.h"
+#include "history.h"
+
+#define TAG "CHART_SCREEN"
+
+#define CHART_MARGIN_X     8
+#define CHART_FIRST_Y      32
+#define CHART_LABEL_HEIGHT 16
+#define CHART_GAP          8
+
+// A column is drawn this long after it closes, so frames still in flight
+// land in the column they were received in
+#define CHART_LATE_MS      100
+
+typedef struct {
+    lv_obj_t *chart;
+    lv_chart_series_t *max_series;
+    lv_chart_series_t *min_series;
+    history_channel_t channel;
+} chart_t;
+
+chart_screen_objects_t chart_objects;
+
+static chart_t charts[3];
+static int chart_count = 0;
+static uint16_t point_count = 0;
+static uint32_t column_ms = 1;
+static uint32_t next_column = 0;        // Absolute index of the next column to draw
+static bool drawn = false;
+
+static void create_chart(lv_obj_t *parent, const char *name, history_channel_t channel,
+                         lv_coord_t y_min, lv_coord_t y_max, uint32_t color)
+{
+    lv_coord_t y = CHART_FIRST_Y + chart_count * (CHART_LABEL_HEIGHT + CHART_HEIGHT + CHART_GAP);
+    chart_t *c = &charts[chart_count++];
+    c->channel = channel;
+
+    lv_obj_t *label = lv_label_create(parent);
+    lv_obj_set_pos(label, CHART_MARGIN_X, y);
+    lv_obj_set_style_text_color(label, lv_color_hex(0xff808080), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(label, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_label_set_text(label, name);
+
+    lv_obj_t *chart = lv_chart_create(parent);
+    c->chart = chart;
+    lv_obj_set_pos(chart, CHART_MARGIN_X, y + CHART_LABEL_HEIGHT);
+    lv_obj_set_size(chart, point_count, CHART_HEIGHT);
+    lv_obj_set_style_pad_all(chart, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_border_width(chart, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_radius(chart, 0, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_bg_color(chart, lv_color_hex(0xff101010), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_line_color(chart, lv_color_hex(0xff303030), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_size(chart, 0, LV_PART_INDICATOR);    // No point markers
+    lv_chart_set_type(chart, LV_CHART_TYPE_LINE);
+    lv_chart_set_update_mode(chart, LV_CHART_UPDATE_MODE_CIRCULAR);
+    lv_chart_set_div_line_count(chart, 3, 0);
+    lv_chart_set_point_count(chart, point_count);
+    lv_chart_set_range(chart, LV_CHART_AXIS_PRIMARY_Y, y_min, y_max);
+
+    c->max_series = lv_chart_add_series(chart, lv_color_hex(color), LV_CHART_AXIS_PRIMARY_Y);
+    c->min_series = lv_chart_add_series(chart, lv_color_darken(lv_color_hex(color), LV_OPA_50),
+                                        LV_CHART_AXIS_PRIMARY_Y);
+    lv_chart_set_all_value(chart, c->max_series, LV_CHART_POINT_NONE);
+    lv_chart_set_all_value(chart, c->min_series, LV_CHART_POINT_NONE);
+}
+
+static void create_screen(void)
+{
+    lv_obj_t *obj = lv_obj_create(0);
+    chart_objects.screen = obj;
+    lv_obj_set_pos(obj, 0, 0);
+    lv_obj_set_size(obj, LV_HOR_RES, LV_VER_RES);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_bg_color(obj, lv_color_hex(0xff000000), LV_PART_MAIN | LV_STATE_DEFAULT);
+
+    lv_obj_t *title = lv_label_create(obj);
+    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 8);
+    lv_obj_set_style_text_color(title, lv_color_hex(0xffffffff), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(title, &ui_font_bebas20, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_label_set_text_fmt(title, "LAST %d S", CHART_WINDOW_S);
+
+    // One chart point per pixel column
+    point_count = LV_HOR_RES - 2 * CHART_MARGIN_X;
+    column_ms = (CHART_WINDOW_S * 1000) / point_count;
+    if (column_ms == 0) {
+        column_ms = 1;
+    }
+
+    chart_count = 0;
+    create_chart(obj, "SPEED", HISTORY_CH_SPEED, 0, CHART_SPEED_MAX_CM_S, 0xff00c0ff);
+    chart_objects.speed = charts[0].chart;
+    create_chart(obj, "MOTOR CURRENT", HISTORY_CH_CURRENT_MOTOR,
+                 CHART_CURRENT_MIN_C100, CHART_CURRENT_MAX_C100, 0xffffc000);
+    chart_objects.current = charts[1].chart;
+    create_chart(obj, "FET TEMP", HISTORY_CH_TEMP_MOS, 0, CHART_TEMP_MAX_C100, 0xffff4040);
+    chart_objects.temp = charts[2].chart;
+}
+
+// Writes the next circular point without invalidating, the caller
+// refreshes each chart once after a batch
+static void put_point(lv_chart_series_t *series, lv_coord_t value)
+{
+    series->y_points[series->start_point] = value;
+    series->start_point = (series->start_point + 1) % point_count;
+}
+
+static void put_empty_column(void)
+{
+    for (int i = 0; i < chart_count; i++) {
+        put_point(charts[i].max_series, LV_CHART_POINT_NONE);
+        put_point(charts[i].min_series, LV_CHART_POINT_NONE);
+    }
+}
+
+// Appends one column to every chart: the samples received during
+// [column * column_ms, (column + 1) * column_ms), empty if there were none
+static void push_column(uint32_t column)
+{
+    uint32_t first, end;
+    if (!history_find_time(column * column_ms, &first) ||
+        !history_find_time((column + 1) * column_ms, &end) || end <= first) {
+        put_empty_column();
+        return;
+    }
+
+    for (int i = 0; i < chart_count; i++) {
+        chart_t *c = &charts[i];
+        int16_t lo, hi;
+        if (history_read_range(c->channel, first, end - first, &lo, &hi)) {
+            put_point(c->max_series, hi);
+            put_point(c->min_series, lo);
+        } else {
+            put_point(c->max_series, LV_CHART_POINT_NONE);
+            put_point(c->min_series, LV_CHART_POINT_NONE);
+        }
+    }
+}
+
+void chart_screen_refresh(void)
+{
+    if (!chart_objects.screen || !history_is_available()) {
+        return;
+    }
+
+    // Only columns whose time has passed
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    uint32_t complete = now_ms > CHART_LATE_MS ? (now_ms - CHART_LATE_MS) / column_ms : 0;
+    if (drawn && complete == next_column) {
+        return;
+    }
+
+    if (take_lvgl_mutex()) {
+        if (!drawn || complete - next_column >= point_count) {
+            // First draw or away for longer than the window: fill every point
+            next_column = complete >= point_count ? complete - point_count : 0;
+            for (uint32_t i = complete; i < point_count; i++) {
+                put_empty_column();
+            }
+            drawn = true;
+        }
+        while (next_column < complete) {
+            push_column(next_column++);
+        }
+        for (int i = 0; i < chart_count; i++) {
+            lv_chart_refresh(charts[i].chart);
+        }
+        give_lvgl_mutex();
+    }
+}
+
+void chart_screen_init(void)
+{
+    if (take_lvgl_mutex_for_handler()) {
+        create_screen();
+        give_lvgl_mutex();
+    } else {
+        ESP_LOGE(TAG, "Failed to create chart screen");
+    }
+}
+
+bool chart_screen_is_active(void)
+{
+    return chart_objects.screen != NULL && lv_scr_act() == chart_objects.screen;
+}
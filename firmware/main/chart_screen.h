@@ -0,0 +1,35 @@
+#ifndef CHART_SCREEN_H
+#define CHART_SCREEN_H
+
+#include <stdbool.h>
+#include <lvgl.h>
+
+// Telemetry history charts: speed, motor current and FET temperature over
+// the last CHART_WINDOW_S seconds. Each pixel column is one chart point
+// covering a fixed slice of time, drawn as the min/max of the samples
+// received in it, or left empty if none were. Charts run in circular mode;
+// new columns are written in a batch and each chart redrawn once per pass.
+
+#define CHART_WINDOW_S          120
+#define CHART_HEIGHT            70
+
+// Y ranges in the history channel units
+#define CHART_SPEED_MAX_CM_S    2000    // 72 km/h
+#define CHART_CURRENT_MIN_C100  (-3000)
+#define CHART_CURRENT_MAX_C100  6000
+#define CHART_TEMP_MAX_C100     10000
+
+typedef struct {
+    lv_obj_t *screen;
+    lv_obj_t *speed;
+    lv_obj_t *current;
+    lv_obj_t *temp;
+} chart_screen_objects_t;
+
+extern chart_screen_objects_t chart_objects;
+
+void chart_screen_init(void);
+bool chart_screen_is_active(void);
+void chart_screen_refresh(void);
+
+#endif // CHART_SCREEN_H
@@ -0,0 +1,150 @@
+#include "console_parse.h"
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <limits.h>
+
+// Command strings
+static const char* CMD_STRINGS[] = {
+    "reset_odometer",
+    "set_motor_pulley",
+    "set_wheel_pulley",
+    "set_wheel_size",
+    "set_motor_poles",
+    "get_config",
+    "calibrate_throttle",
+    "get_calibration",
+    "get_firmware_version",
+    "set_speed_unit_kmh",
+    "set_speed_unit_mph",
+    "log_status",
+    "log_rate",
+    "log_export",
+    "log_erase",
+    "get_stats",
+    "set_pack_cells",
+    "set_pack_capacity",
+    "get_range",
+    "get_cells",
+    "stream",
+    "bench_latency",
+    "espnow",
+    "ota",
+    "links",
+    "residency",
+    "lvgl_heap",
+    "glass",
+    "deadline",
+    "telemetry",
+    "bench",
+    "ble_backend",
+    "help"
+};
+
+#define CMD_STRING_COUNT (sizeof(CMD_STRINGS) / sizeof(CMD_STRINGS[0]))
+
+// CMD_STRINGS indices in name order, for a binary search in console_parse_command
+static uint8_t sorted_commands[CMD_STRING_COUNT];
+
+usb_command_t console_parse_command(const char* input)
+{
+    // Skip leading whitespace
+    while (*input == ' ' || *input == '\t') input++;
+
+    // Find the first word (command)
+    char command[64];
+    int i = 0;
+    while (input[i] && input[i] != ' ' && input[i] != '\t' && i < (int)sizeof(command) - 1) {
+        command[i] = input[i];
+        i++;
+    }
+    command[i] = '\0';
+
+    // Convert to lowercase for case-insensitive comparison
+    for (int j = 0; j < i; j++) {
+        if (command[j] >= 'A' && command[j] <= 'Z') {
+            command[j] = command[j] + 32;
+        }
+    }
+
+    // Binary search over the sorted command names
+    int low = 0;
+    int high = CMD_STRING_COUNT - 1;
+    while (low <= high) {
+        int mid = (low + high) / 2;
+        int cmp = strcmp(command, CMD_STRINGS[sorted_commands[mid]]);
+        if (cmp == 0) {
+            return (usb_command_t)sorted_commands[mid];
+        }
+        if (cmp < 0) {
+            high = mid - 1;
+        } else {
+            low = mid + 1;
+        }
+    }
+
+    return CMD_UNKNOWN;
+}
+
+const char* console_argument(const char* command)
+{
+    while (*command == ' ' || *command == '\t') command++;
+    while (*command && *command != ' ' && *command != '\t') command++;
+    while (*command == ' ' || *command == '\t') command++;
+    return *command ? command : NULL;
+}
+
+int console_parse_int(const char* value_str)
+{
+    char* end;
+    errno = 0;
+    long value = strtol(value_str, &end, 10);
+    if (end == value_str || errno == ERANGE || value < INT_MIN + 1L || value > INT_MAX) {
+        return INT_MIN;
+    }
+    return (*end == '\0' || *end == ' ' || *end == '\t') ? (int)value : INT_MIN;
+}
+
+bool console_argument_is(const char* arg, const char* word)
+{
+    size_t len = strlen(word);
+    return strncmp(arg, word, len) == 0 && (arg[len] == '\0' || arg[len] == ' ' || arg[len] == '\t');
+}
+
+bool console_parse_hex_bytes(const char* str, uint8_t* out, size_t len, char separator)
+{
+    for (size_t i = 0; i < len; i++) {
+        if (i > 0 && separator != '\0' && *str++ != separator) {
+            return false;
+        }
+        uint8_t value = 0;
+        for (int digit = 0; digit < 2; digit++) {
+            char c = *str++;
+            value <<= 4;
+            if (c >= '0' && c <= '9') {
+                value |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        out[i] = value;
+    }
+    return *str == '\0' || *str == ' ' || *str == '\t';
+}
+
+static int compare_commands(const void *a, const void *b)
+{
+    return strcmp(CMD_STRINGS[*(const uint8_t *)a], CMD_STRINGS[*(const uint8_t *)b]);
+}
+
+void console_parse_init(void)
+{
+    for (int i = 0; i < CMD_STRING_COUNT; i++) {
+        sorted_commands[i] = i;
+    }
+    qsort(sorted_commands, CMD_STRING_COUNT, sizeof(sorted_commands[0]), compare_commands);
+}
@@ -0,0 +1,70 @@
+#ifndef CONSOLE_PARSE_H
+#define CONSOLE_PARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Console command line parsing, split from usb_serial_handler.c so it has
+// no ESP-IDF dependencies and builds unchanged on a host compiler for the
+// fuzzers. Every function takes a NUL-terminated line as typed.
+
+// Command types that can be received via USB
+typedef enum {
+    CMD_RESET_ODOMETER = 0,
+    CMD_SET_MOTOR_PULLEY,
+    CMD_SET_WHEEL_PULLEY,
+    CMD_SET_WHEEL_SIZE,
+    CMD_SET_MOTOR_POLES,
+    CMD_GET_CONFIG,
+    CMD_CALIBRATE_THROTTLE,
+    CMD_GET_CALIBRATION,
+    CMD_GET_FIRMWARE_VERSION,
+    CMD_SET_SPEED_UNIT_KMH,
+    CMD_SET_SPEED_UNIT_MPH,
+    CMD_LOG_STATUS,
+    CMD_LOG_RATE,
+    CMD_LOG_EXPORT,
+    CMD_LOG_ERASE,
+    CMD_GET_STATS,
+    CMD_SET_PACK_CELLS,
+    CMD_SET_PACK_CAPACITY,
+    CMD_GET_RANGE,
+    CMD_GET_CELLS,
+    CMD_STREAM,
+    CMD_BENCH_LATENCY,
+    CMD_ESPNOW,
+    CMD_OTA,
+    CMD_LINKS,
+    CMD_RESIDENCY,
+    CMD_LVGL_HEAP,
+    CMD_GLASS,
+    CMD_DEADLINE,
+    CMD_TELEMETRY,
+    CMD_BENCH,
+    CMD_BLE_BACKEND,
+    CMD_HELP,
+    CMD_UNKNOWN
+} usb_command_t;
+
+// Sorts the command table, before the first console_parse_command
+void console_parse_init(void);
+
+// Command named by the first word of input, case-insensitive
+usb_command_t console_parse_command(const char* input);
+
+// First argument after the command word, NULL if there is none
+const char* console_argument(const char* command);
+
+// Decimal integer up to the next whitespace. Returns INT_MIN for anything
+// else, including overflow, which every range check rejects.
+int console_parse_int(const char* value_str);
+
+// Argument equals word, up to the next whitespace
+bool console_argument_is(const char* arg, const char* word);
+
+// len bytes as two hex digits each, with the separator between bytes if
+// not '\0', up to the next whitespace. Nothing may follow the last byte.
+bool console_parse_hex_bytes(const char* str, uint8_t* out, size_t len, char separator);
+
+#endif // CONSOLE_PARSE_H
@@ -0,0 +1,405 @@
+#include "cycle_bench.h"
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lvgl.h"
+#include "lcd.h"
+#include "ble.h"
+#include "espnow_link.h"
+#include "telemetry.h"
+#include "telemetry_decode.h"
+#include "throttle_map.h"
+#include "vesc_config.h"
+#include "settings.h"
+#include "residency.h"
+#include "bench_pinned.h"
+#include "ui_updater.h"
+#include "fonts.h"
+#include "images.h"
+#include "screens.h"
+
+#define TAG "CYCLE_BENCH"
+
+#define BENCH_INPUTS        8       // Distinct inputs cycled through by the pure cases
+#define BAND_ROWS           (LV_VER_RES_MAX / 8)    // One draw buffer, as in lcd.c
+
+typedef enum {
+    CASE_PURE,                      // No locks, masked unless radio
+    CASE_DRAW,                      // Into the private band, under the LVGL mutex
+    CASE_REDRAW,                    // The screen itself, under the LVGL mutex
+    CASE_SYSTEM,                    // Takes its own locks
+} case_kind_t;
+
+typedef struct {
+    const char *name;
+    case_kind_t kind;
+    uint16_t ops;
+    void (*op)(uint32_t i);
+} bench_case_t;
+
+typedef struct {
+    bool radio;
+    uint32_t runs;
+    cycle_bench_report_t *report;
+} bench_job_t;
+
+static portMUX_TYPE bench_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile int32_t bench_sink;
+static uint32_t samples[CYCLE_BENCH_MAX_RUNS];
+
+// Inputs
+
+static uint8_t frames[BENCH_INPUTS][TELEMETRY_FRAME_LEN];
+static int32_t adc_samples[BENCH_INPUTS][THROTTLE_MAP_OVERSAMPLE];
+static telemetry_snapshot_t decoded;
+static vesc_config_t config;
+
+static uint32_t adc_input(uint32_t i)
+{
+    return (i * 397) & 0xFFF;
+}
+
+static void prepare_inputs(void)
+{
+    for (int f = 0; f < BENCH_INPUTS; f++) {
+        telemetry_snapshot_t s = {0};
+        s.temp_mos_c100 = 3500 + f * 25;
+        s.temp_motor_c100 = 4200 + f * 40;
+        s.current_motor_c100 = -1500 + f * 700;
+        s.current_in_c100 = -300 + f * 250;
+        s.erpm = f * 4100;
+        s.voltage_c100 = 4120 - f * 12;
+        s.bms_voltage_c100 = 4118 - f * 12;
+        s.bms_current_c100 = s.current_in_c100;
+        s.bms_remaining_c100 = 1200 - f * 3;
+        s.bms_nominal_c100 = 1500;
+        s.bms_num_cells = 10 + f % 3;
+        for (int i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+            s.cell_mv[i] = (int16_t)(3900 + i * 3 - f * 5);
+        }
+        telemetry_encode_frame(&s, frames[f]);
+
+        for (int i = 0; i < THROTTLE_MAP_OVERSAMPLE; i++) {
+            adc_samples[f][i] = (int32_t)adc_input(f * THROTTLE_MAP_OVERSAMPLE + i);
+        }
+    }
+    vesc_config_load(&config);
+}
+
+// Pure cases
+
+static void op_telemetry_decode(uint32_t i)
+{
+    telemetry_decode_frame(frames[i % BENCH_INPUTS], TELEMETRY_FRAME_LEN, &decoded);
+}
+
+static void op_throttle_filter(uint32_t i)
+{
+    bench_sink += throttle_map_mean(adc_samples[i % BENCH_INPUTS], THROTTLE_MAP_OVERSAMPLE);
+}
+
+static void op_throttle_map_linear(uint32_t i)
+{
+    bench_sink += throttle_map_linear(adc_input(i), 400, 3600);
+}
+
+static void op_throttle_map_combined(uint32_t i)
+{
+    bench_sink += throttle_map_combined((int32_t)adc_input(i), 400, 3600, (int32_t)adc_input(i + 3), 500, 3500);
+}
+
+static void op_speed(uint32_t i)
+{
+    bench_sink += vesc_config_get_speed(&config);
+}
+
+// Draw cases, into a band of the size and memory of a draw buffer through
+// the display's own draw context
+
+static lv_color_t *band;
+static lv_area_t band_area;
+static lv_draw_ctx_t *draw_ctx;
+static lv_draw_rect_dsc_t fill_dsc;
+static lv_draw_img_dsc_t img_dsc;
+static lv_draw_label_dsc_t small_glyph_dsc;
+static lv_draw_label_dsc_t large_glyph_dsc;
+static lv_area_t icon_area;
+static const lv_img_dsc_t *icon;
+
+static struct {
+    void *buf;
+    lv_area_t *buf_area;
+    const lv_area_t *clip_area;
+    lv_disp_t *refreshing;
+} saved;
+
+static void set_band(lv_coord_t y)
+{
+    band_area.x1 = 0;
+    band_area.y1 = y;
+    band_area.x2 = LV_HOR_RES_MAX - 1;
+    band_area.y2 = y + BAND_ROWS - 1;
+}
+
+static bool draw_begin(void)
+{
+    lv_disp_t *disp = lv_disp_get_default();
+    if (disp == NULL || disp->driver->draw_ctx == NULL) {
+        return false;
+    }
+    if (band == NULL) {
+        band = heap_caps_malloc(LV_HOR_RES_MAX * BAND_ROWS * sizeof(lv_color_t), MALLOC_CAP_DMA);
+        if (band == NULL) {
+            return false;
+        }
+    }
+
+    draw_ctx = disp->driver->draw_ctx;
+    saved.buf = draw_ctx->buf;
+    saved.buf_area = draw_ctx->buf_area;
+    saved.clip_area = draw_ctx->clip_area;
+    saved.refreshing = _lv_refr_get_disp_refreshing();
+
+    // The software renderer reads the resolution from the refreshing display
+    _lv_refr_set_disp_refreshing(disp);
+    set_band(0);
+    draw_ctx->buf = band;
+    draw_ctx->buf_area = &band_area;
+    draw_ctx->clip_area = &band_area;
+
+    lv_draw_rect_dsc_init(&fill_dsc);
+    fill_dsc.bg_color = lv_color_hex(0x202020);
+    fill_dsc.bg_opa = LV_OPA_COVER;
+
+    // What the home screen draws, resident copies included
+    icon = residency_img(&img_100_connection);
+    lv_draw_img_dsc_init(&img_dsc);
+    icon_area.x1 = 8;
+    icon_area.y1 = 0;
+    icon_area.x2 = icon_area.x1 + icon->header.w - 1;
+    icon_area.y2 = icon_area.y1 + icon->header.h - 1;
+
+    lv_draw_label_dsc_init(&small_glyph_dsc);
+    small_glyph_dsc.font = residency_font(&ui_font_bebas35);
+    small_glyph_dsc.color = lv_color_white();
+    lv_draw_label_dsc_init(&large_glyph_dsc);
+    large_glyph_dsc.font = residency_font(&ui_font_bebas150);
+    large_glyph_dsc.color = lv_color_white();
+    return true;
+}
+
+static void draw_end(void)
+{
+    draw_ctx->buf = saved.buf;
+    draw_ctx->buf_area = saved.buf_area;
+    draw_ctx->clip_area = saved.clip_area;
+    _lv_refr_set_disp_refreshing(saved.refreshing);
+}
+
+static void op_fill_band(uint32_t i)
+{
+    lv_draw_rect(draw_ctx, &fill_dsc, &band_area);
+}
+
+// Icons can be taller than a band, they are drawn band by band as the
+// refresh does
+static void op_fill_icon(uint32_t i)
+{
+    for (lv_coord_t y = 0; y <= icon_area.y2; y += BAND_ROWS) {
+        set_band(y);
+        lv_draw_rect(draw_ctx, &fill_dsc, &icon_area);
+    }
+    set_band(0);
+}
+
+static void op_blit_icon(uint32_t i)
+{
+    for (lv_coord_t y = 0; y <= icon_area.y2; y += BAND_ROWS) {
+        set_band(y);
+        lv_draw_img(draw_ctx, &img_dsc, &icon_area, icon);
+    }
+    set_band(0);
+}
+
+// One digit, band by band
+static void draw_glyph(const lv_draw_label_dsc_t *dsc, uint32_t i)
+{
+    lv_point_t pos = { .x = 8, .y = 0 };
+    lv_coord_t height = lv_font_get_line_height(dsc->font);
+    for (lv_coord_t y = 0; y < height; y += BAND_ROWS) {
+        set_band(y);
+        lv_draw_letter(draw_ctx, dsc, &pos, '0' + i % 10);
+    }
+    set_band(0);
+}
+
+static void op_glyph_small(uint32_t i)
+{
+    draw_glyph(&small_glyph_dsc, i);
+}
+
+static void op_glyph_large(uint32_t i)
+{
+    draw_glyph(&large_glyph_dsc, i);
+}
+
+static void op_home_redraw(uint32_t i)
+{
+    lv_obj_invalidate(lv_scr_act());
+    lv_refr_now(NULL);
+}
+
+// System cases
+
+static void op_settings_load(uint32_t i)
+{
+    settings_t settings;
+    bench_sink += settings_read_stored(&settings);
+}
+
+// The suite, in output order. Names are part of the output format.
+static const bench_case_t cases[] = {
+    { "telemetry_decode",      CASE_PURE,   64, op_telemetry_decode },
+    { "throttle_filter",       CASE_PURE,   64, op_throttle_filter },
+    { "throttle_map_linear",   CASE_PURE,   64, op_throttle_map_linear },
+    { "throttle_map_combined", CASE_PURE,   64, op_throttle_map_combined },
+    { "vesc_config_get_speed", CASE_PURE,   64, op_speed },
+    { "lv_fill_band",          CASE_DRAW,   4,  op_fill_band },
+    { "lv_fill_icon",          CASE_DRAW,   16, op_fill_icon },
+    { "lv_blit_icon",          CASE_DRAW,   16, op_blit_icon },
+    { "lv_glyph_4bpp_35",      CASE_DRAW,   16, op_glyph_small },
+    { "lv_glyph_4bpp_150",     CASE_DRAW,   4,  op_glyph_large },
+    { "home_redraw",           CASE_REDRAW, 1,  op_home_redraw },
+    { "settings_load_nvs",     CASE_SYSTEM, 1,  op_settings_load },
+};
+
+#define CASE_COUNT (sizeof(cases) / sizeof(cases[0]))
+_Static_assert(CASE_COUNT <= CYCLE_BENCH_MAX_CASES, "CYCLE_BENCH_MAX_CASES too small");
+
+static int compare_cycles(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run_case(const bench_job_t *job, const bench_case_t *c, cycle_bench_result_t *result)
+{
+    bool masked = c->kind == CASE_PURE && !job->radio;
+
+    // Untimed pass, so the first run is not just the code being fetched
+    c->op(0);
+
+    for (uint32_t run = 0; run < job->runs; run++) {
+        if (masked) {
+            portENTER_CRITICAL(&bench_lock);
+        }
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (uint32_t i = 0; i < c->ops; i++) {
+            c->op(run * c->ops + i);
+        }
+        uint32_t cycles = esp_cpu_get_cycle_count() - start;
+        if (masked) {
+            portEXIT_CRITICAL(&bench_lock);
+        }
+        samples[run] = cycles / c->ops;
+
+        // The long cases would starve the idle task of this core
+        if (c->kind == CASE_REDRAW || c->kind == CASE_SYSTEM) {
+            vTaskDelay(1);
+        }
+    }
+
+    qsort(samples, job->runs, sizeof(samples[0]), compare_cycles);
+    result->min_cycles = samples[0];
+    result->median_cycles = samples[job->runs / 2];
+    result->max_cycles = samples[job->runs - 1];
+}
+
+static void bench_case(const bench_job_t *job, const bench_case_t *c, cycle_bench_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    result->name = c->name;
+    result->ops = c->ops;
+
+    switch (c->kind) {
+        case CASE_DRAW:
+            if (!take_lvgl_mutex()) {
+                result->skipped = true;
+                return;
+            }
+            if (draw_begin()) {
+                run_case(job, c, result);
+                draw_end();
+            } else {
+                result->skipped = true;
+            }
+            give_lvgl_mutex();
+            break;
+        case CASE_REDRAW:
+            if (!take_lvgl_mutex()) {
+                result->skipped = true;
+                return;
+            }
+            if (lv_scr_act() == objects.home_screen) {
+                run_case(job, c, result);
+            } else {
+                result->skipped = true;
+            }
+            give_lvgl_mutex();
+            break;
+        default:
+            run_case(job, c, result);
+            break;
+    }
+}
+
+static void bench_task(void *arg)
+{
+    bench_job_t *job = arg;
+    cycle_bench_report_t *report = job->report;
+
+    prepare_inputs();
+    for (size_t i = 0; i < CASE_COUNT; i++) {
+        bench_case(job, &cases[i], &report->results[i]);
+    }
+    report->count = CASE_COUNT;
+}
+
+esp_err_t cycle_bench_run(bool radio, uint32_t runs, cycle_bench_report_t *report)
+{
+    if (report == NULL || runs == 0 || runs > CYCLE_BENCH_MAX_RUNS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (radio && !is_connect && !espnow_link_active()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    memset(report, 0, sizeof(*report));
+    report->radio = radio;
+    report->runs = runs;
+    report->cpu_mhz = esp_rom_get_cpu_ticks_per_us();
+
+    bench_job_t job = {
+        .radio = radio,
+        .runs = runs,
+        .report = report,
+    };
+
+    uint32_t frames_before = telemetry_get_frame_count();
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = bench_run_pinned("cycle_bench", bench_task, &job);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    report->elapsed_ms = (uint32_t)((esp_timer_get_time() - start_us) / 1000);
+    report->rx_frames = telemetry_get_frame_count() - frames_before;
+    return ESP_OK;
+}
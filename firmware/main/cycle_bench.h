@@ -0,0 +1,61 @@
+#ifndef CYCLE_BENCH_H
+#define CYCLE_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Fixed suite of microbenchmarks on the device, timed with the CPU cycle
+// counter, for comparing firmware versions on real hardware: the numbers
+// include what a host build cannot show, the flash and PSRAM cache, code
+// running from flash and the SPI display.
+//
+// Every case runs CYCLE_BENCH_DEFAULT_RUNS times. A run times ops
+// operations back to back and keeps the average, so the calls are not
+// dominated by the counter reads. The report has the minimum, median and
+// maximum run. The minimum is the cost of the code itself, the gap to the
+// maximum is interference from interrupts, the other core and the cache.
+//
+// The suite runs in a task pinned to the LVGL core above the LVGL handler.
+// Pure cases run with interrupts masked on that core unless the radio run
+// is asked for. The radio run needs a link that is up and leaves the
+// interrupts on, so the BLE or Wi-Fi controller and the telemetry notify
+// path get in during the runs. Comparing the two shows the interference.
+// LVGL, redraw and NVS cases always run with interrupts on, as they need
+// them.
+//
+// The LVGL draw cases draw into a private band the size of one draw buffer
+// with the display's draw context. The home redraw invalidates the whole
+// screen and refreshes it, flush included, and is skipped when another
+// screen is up.
+
+#define CYCLE_BENCH_DEFAULT_RUNS    32
+#define CYCLE_BENCH_MAX_RUNS        256
+#define CYCLE_BENCH_MAX_CASES       16
+#define CYCLE_BENCH_FORMAT_VERSION  1       // Bump when the output lines change
+
+typedef struct {
+    const char *name;
+    uint16_t ops;                   // Operations per run
+    bool skipped;
+    uint32_t min_cycles;            // Per operation
+    uint32_t median_cycles;
+    uint32_t max_cycles;
+} cycle_bench_result_t;
+
+typedef struct {
+    bool radio;
+    uint32_t runs;
+    uint32_t cpu_mhz;
+    uint32_t rx_frames;             // Telemetry frames received during the suite
+    uint32_t elapsed_ms;
+    size_t count;
+    cycle_bench_result_t results[CYCLE_BENCH_MAX_CASES];
+} cycle_bench_report_t;
+
+// Blocks for up to a few seconds. ESP_ERR_INVALID_STATE for a radio run
+// without a link, or while another run is going.
+esp_err_t cycle_bench_run(bool radio, uint32_t runs, cycle_bench_report_t *report);
+
+#endif // CYCLE_BENCH_H
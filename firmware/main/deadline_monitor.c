@@ -0,0 +1,372 @@
+#include "deadline_monitor.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "viber.h"
+
+#define TAG "DEADLINE"
+
+#define STORED_VERSION  1
+
+typedef struct __attribute__((packed)) {
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t misses[DEADLINE_SOURCE_COUNT];
+    uint32_t worst_overrun_ms[DEADLINE_SOURCE_COUNT];
+} stored_counters_t;
+
+typedef struct {
+    TaskHandle_t task;              // First task that kicked
+    int64_t last_kick_us;
+    bool late;
+    uint8_t event;                  // Log slot of the open event
+    bool announce_open;             // For the monitor task
+    bool announce_close;
+    deadline_event_t closed;        // Copy for the close announcement
+    uint32_t misses;
+} deadline_state_t;
+
+static const char *const source_names[DEADLINE_SOURCE_COUNT] = { "throttle_sample", "uplink_send" };
+static const uint32_t budgets_ms[DEADLINE_SOURCE_COUNT] = { DEADLINE_THROTTLE_BUDGET_MS, DEADLINE_SEND_BUDGET_MS };
+
+static portMUX_TYPE monitor_lock = portMUX_INITIALIZER_UNLOCKED;
+static deadline_state_t sources[DEADLINE_SOURCE_COUNT];
+static deadline_event_t events[DEADLINE_LOG_SIZE];
+static uint8_t event_next = 0;
+static uint8_t event_count = 0;
+static stored_counters_t stored;
+static bool stored_dirty = false;
+static int64_t last_close_us = 0;
+static uint32_t neutral_frames = 0;
+static uint32_t neutral_failed = 0;
+
+static deadline_neutral_fn_t neutral_fn = NULL;
+static TaskHandle_t monitor_task_handle = NULL;
+static esp_timer_handle_t check_timer = NULL;
+
+static void load_counters(void)
+{
+    nvs_handle_t nvs_handle;
+    size_t size = sizeof(stored);
+    bool ok = false;
+
+    if (nvs_open(DEADLINE_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        ok = nvs_get_blob(nvs_handle, DEADLINE_NVS_KEY, &stored, &size) == ESP_OK &&
+             size == sizeof(stored) && stored.version == STORED_VERSION;
+        nvs_close(nvs_handle);
+    }
+    if (!ok) {
+        memset(&stored, 0, sizeof(stored));
+        stored.version = STORED_VERSION;
+    }
+}
+
+static esp_err_t save_counters(const stored_counters_t *counters)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(DEADLINE_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, DEADLINE_NVS_KEY, counters, sizeof(*counters));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+void deadline_monitor_kick(deadline_source_t source)
+{
+    if (source >= DEADLINE_SOURCE_COUNT) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    bool wake = false;
+
+    portENTER_CRITICAL(&monitor_lock);
+    deadline_state_t *s = &sources[source];
+    if (s->task == NULL) {
+        s->task = xTaskGetCurrentTaskHandle();
+    }
+    if (s->late) {
+        deadline_event_t *event = &events[s->event];
+        event->open = false;
+        event->overrun_ms = (uint32_t)((now - event->start_us) / 1000);
+        if (event->overrun_ms > stored.worst_overrun_ms[source]) {
+            stored.worst_overrun_ms[source] = event->overrun_ms;
+        }
+        stored_dirty = true;
+        last_close_us = now;
+        s->closed = *event;
+        s->late = false;
+        s->announce_close = true;
+        wake = true;
+    }
+    s->last_kick_us = now;
+    portEXIT_CRITICAL(&monitor_lock);
+
+    if (wake && monitor_task_handle != NULL) {
+        xTaskNotifyGive(monitor_task_handle);
+    }
+}
+
+bool deadline_monitor_throttle_stale(void)
+{
+    return sources[DEADLINE_THROTTLE_SAMPLE].late;
+}
+
+// esp_timer task, every DEADLINE_CHECK_PERIOD_MS
+static void check_deadlines(void *arg)
+{
+    int64_t now = esp_timer_get_time();
+    TaskHandle_t opened[DEADLINE_SOURCE_COUNT] = { NULL };
+    bool wake = false;
+
+    portENTER_CRITICAL(&monitor_lock);
+    for (int i = 0; i < DEADLINE_SOURCE_COUNT; i++) {
+        deadline_state_t *s = &sources[i];
+        int64_t budget_us = (int64_t)budgets_ms[i] * 1000;
+        if (s->last_kick_us == 0) {
+            continue;
+        }
+        if (s->late) {
+            events[s->event].overrun_ms = (uint32_t)((now - events[s->event].start_us) / 1000);
+            continue;
+        }
+        if (now - s->last_kick_us <= budget_us) {
+            continue;
+        }
+
+        deadline_event_t *event = &events[event_next];
+        memset(event, 0, sizeof(*event));
+        event->source = (deadline_source_t)i;
+        event->open = true;
+        event->start_us = s->last_kick_us + budget_us;
+        event->overrun_ms = (uint32_t)((now - event->start_us) / 1000);
+        s->event = event_next;
+        event_next = (event_next + 1) % DEADLINE_LOG_SIZE;
+        if (event_count < DEADLINE_LOG_SIZE) {
+            event_count++;
+        }
+
+        s->late = true;
+        s->misses++;
+        s->announce_open = true;
+        stored.misses[i]++;
+        stored_dirty = true;
+        opened[i] = s->task;
+        wake = true;
+    }
+    portEXIT_CRITICAL(&monitor_lock);
+
+    if (!wake) {
+        return;
+    }
+
+    // Task details cannot be read inside the critical section
+    for (int i = 0; i < DEADLINE_SOURCE_COUNT; i++) {
+        if (opened[i] == NULL) {
+            continue;
+        }
+        const char *name = pcTaskGetName(opened[i]);
+        eTaskState state = eTaskGetState(opened[i]);
+        portENTER_CRITICAL(&monitor_lock);
+        deadline_event_t *event = &events[sources[i].event];
+        strncpy(event->task, name, sizeof(event->task) - 1);
+        event->task_state = (uint8_t)state;
+        portEXIT_CRITICAL(&monitor_lock);
+    }
+    xTaskNotifyGive(monitor_task_handle);
+}
+
+const char *deadline_task_state_name(uint8_t state)
+{
+    switch (state) {
+        case eRunning:   return "running";
+        case eReady:     return "ready";
+        case eBlocked:   return "blocked";
+        case eSuspended: return "suspended";
+        case eDeleted:   return "deleted";
+        default:         return "unknown";
+    }
+}
+
+static void monitor_task(void *pvParameters)
+{
+    TickType_t wait = portMAX_DELAY;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        bool stalled = false;
+        bool alert = false;
+        deadline_event_t opened[DEADLINE_SOURCE_COUNT];
+        deadline_event_t closed[DEADLINE_SOURCE_COUNT];
+        bool is_opened[DEADLINE_SOURCE_COUNT] = { false };
+        bool is_closed[DEADLINE_SOURCE_COUNT] = { false };
+
+        portENTER_CRITICAL(&monitor_lock);
+        for (int i = 0; i < DEADLINE_SOURCE_COUNT; i++) {
+            deadline_state_t *s = &sources[i];
+            stalled |= s->late;
+            if (s->announce_open) {
+                opened[i] = events[s->event];
+                is_opened[i] = true;
+                alert = true;
+                s->announce_open = false;
+            }
+            if (s->announce_close) {
+                closed[i] = s->closed;
+                is_closed[i] = true;
+                s->announce_close = false;
+            }
+        }
+        portEXIT_CRITICAL(&monitor_lock);
+
+        // Neutral first, the log can wait
+        if (stalled) {
+            bool sent = neutral_fn != NULL && neutral_fn();
+            portENTER_CRITICAL(&monitor_lock);
+            if (sent) {
+                neutral_frames++;
+            } else {
+                neutral_failed++;
+            }
+            for (int i = 0; i < DEADLINE_SOURCE_COUNT; i++) {
+                if (sources[i].late) {
+                    events[sources[i].event].neutral_sent |= sent;
+                }
+            }
+            portEXIT_CRITICAL(&monitor_lock);
+        }
+        if (alert) {
+            viber_play_pattern(VIBER_PATTERN_ERROR);
+        }
+
+        for (int i = 0; i < DEADLINE_SOURCE_COUNT; i++) {
+            if (is_opened[i]) {
+                ESP_LOGW(TAG, "%s missed its %lu ms deadline, task %s was %s, sending neutral",
+                         source_names[i], budgets_ms[i], opened[i].task[0] ? opened[i].task : "?",
+                         deadline_task_state_name(opened[i].task_state));
+            }
+            if (is_closed[i]) {
+                ESP_LOGW(TAG, "%s back after %lu ms over budget", source_names[i], closed[i].overrun_ms);
+            }
+        }
+
+        if (stalled) {
+            wait = pdMS_TO_TICKS(DEADLINE_NEUTRAL_REPEAT_MS);
+            continue;
+        }
+
+        // Store once the pipeline has been on time for a while
+        stored_counters_t copy;
+        bool save = false;
+        int64_t since_close = esp_timer_get_time() - last_close_us;
+        portENTER_CRITICAL(&monitor_lock);
+        if (stored_dirty && since_close >= (int64_t)DEADLINE_SAVE_DELAY_MS * 1000) {
+            copy = stored;
+            stored_dirty = false;
+            save = true;
+        }
+        bool dirty = stored_dirty;
+        portEXIT_CRITICAL(&monitor_lock);
+
+        if (save) {
+            esp_err_t err = save_counters(&copy);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Saving deadline counters failed: %s", esp_err_to_name(err));
+            }
+        }
+        if (dirty) {
+            int64_t left_us = (int64_t)DEADLINE_SAVE_DELAY_MS * 1000 - since_close;
+            wait = pdMS_TO_TICKS(left_us > 0 ? left_us / 1000 + 1 : 1);
+        } else {
+            wait = portMAX_DELAY;
+        }
+    }
+}
+
+esp_err_t deadline_monitor_init(deadline_neutral_fn_t send_neutral)
+{
+    if (check_timer != NULL) {
+        return ESP_OK;
+    }
+    neutral_fn = send_neutral;
+    load_counters();
+
+    if (xTaskCreate(monitor_task, "deadline_monitor", DEADLINE_TASK_STACK, NULL, DEADLINE_TASK_PRIORITY,
+                    &monitor_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the deadline monitor task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = &check_deadlines,
+        .name = "deadline_check"
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &check_timer);
+    if (err == ESP_OK) {
+        err = esp_timer_start_periodic(check_timer, DEADLINE_CHECK_PERIOD_MS * 1000);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start the deadline timer: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Throttle sample %d ms, uplink send %d ms, %lu + %lu misses stored",
+             DEADLINE_THROTTLE_BUDGET_MS, DEADLINE_SEND_BUDGET_MS,
+             stored.misses[DEADLINE_THROTTLE_SAMPLE], stored.misses[DEADLINE_UPLINK_SEND]);
+    return ESP_OK;
+}
+
+void deadline_monitor_get_stats(deadline_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&monitor_lock);
+    for (int i = 0; i < DEADLINE_SOURCE_COUNT; i++) {
+        deadline_source_stats_t *out = &stats->sources[i];
+        out->budget_ms = budgets_ms[i];
+        out->age_ms = sources[i].last_kick_us == 0 ? 0 : (uint32_t)((now - sources[i].last_kick_us) / 1000);
+        out->misses = sources[i].misses;
+        out->stored_misses = stored.misses[i];
+        out->worst_overrun_ms = stored.worst_overrun_ms[i];
+    }
+    stats->neutral_frames = neutral_frames;
+    stats->neutral_failed = neutral_failed;
+    stats->event_count = event_count;
+    for (uint8_t i = 0; i < event_count; i++) {
+        stats->events[i] = events[(event_next + DEADLINE_LOG_SIZE - event_count + i) % DEADLINE_LOG_SIZE];
+    }
+    portEXIT_CRITICAL(&monitor_lock);
+}
+
+esp_err_t deadline_monitor_reset(void)
+{
+    stored_counters_t copy;
+
+    portENTER_CRITICAL(&monitor_lock);
+    memset(&stored, 0, sizeof(stored));
+    stored.version = STORED_VERSION;
+    stored_dirty = false;
+    event_count = 0;
+    for (int i = 0; i < DEADLINE_SOURCE_COUNT; i++) {
+        sources[i].misses = 0;
+    }
+    copy = stored;
+    portEXIT_CRITICAL(&monitor_lock);
+
+    return save_counters(&copy);
+}
+
+const char *deadline_source_name(deadline_source_t source)
+{
+    return source < DEADLINE_SOURCE_COUNT ? source_names[source] : "unknown";
+}
@@ -0,0 +1,91 @@
+#ifndef DEADLINE_MONITOR_H
+#define DEADLINE_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Deadlines of the local throttle pipeline.
+//
+// adc_task kicks DEADLINE_THROTTLE_SAMPLE after every sample, adc_send_task
+// kicks DEADLINE_UPLINK_SEND once per loop. An esp_timer checks the age of
+// both every DEADLINE_CHECK_PERIOD_MS from the timer task, which runs above
+// every application task, so a long redraw, a flash write or a task stuck
+// on a lock does not hide the stall from it. A deadline starts counting on
+// its first kick.
+//
+// When a kick is older than its budget the miss opens an event and wakes
+// the monitor task. That task sends the neutral frame over the active
+// uplink, repeats it every DEADLINE_NEUTRAL_REPEAT_MS while the stall lasts
+// and plays the error pattern once. While the throttle sample is late,
+// adc_send_task also sends neutral instead of its last reading, so a send
+// task that resumes first cannot push the stale value back out.
+//
+// The next kick closes the event with the overrun past the budget. Events
+// keep the stalled task's name and its scheduler state when the miss was
+// seen: ready means it was starved, blocked means it was waiting on
+// something. Miss counts and the worst overrun are stored in NVS, written
+// by the monitor task DEADLINE_SAVE_DELAY_MS after the stall ends rather than
+// while the pipeline is behind.
+
+#define DEADLINE_CHECK_PERIOD_MS    10
+#define DEADLINE_THROTTLE_BUDGET_MS 100     // adc_task samples every 20 ms
+#define DEADLINE_SEND_BUDGET_MS     150     // adc_send_task writes every 50 ms
+#define DEADLINE_NEUTRAL_REPEAT_MS  50
+#define DEADLINE_SAVE_DELAY_MS      5000
+#define DEADLINE_LOG_SIZE           8
+#define DEADLINE_TASK_PRIORITY      15      // Above adc_task and adc_send_task
+#define DEADLINE_TASK_STACK         3072
+
+#define DEADLINE_NVS_NAMESPACE      "deadline"
+#define DEADLINE_NVS_KEY            "misses"
+
+typedef enum {
+    DEADLINE_THROTTLE_SAMPLE = 0,
+    DEADLINE_UPLINK_SEND,
+    DEADLINE_SOURCE_COUNT,
+} deadline_source_t;
+
+// Sends one neutral frame, false when no uplink is up
+typedef bool (*deadline_neutral_fn_t)(void);
+
+typedef struct {
+    deadline_source_t source;
+    char task[16];
+    uint8_t task_state;             // eTaskState when the miss was seen
+    bool open;                      // Still stalled
+    bool neutral_sent;
+    int64_t start_us;               // When the budget ran out
+    uint32_t overrun_ms;            // Past the budget, final once closed
+} deadline_event_t;
+
+typedef struct {
+    uint32_t budget_ms;
+    uint32_t age_ms;                // Since the last kick, 0 before the first
+    uint32_t misses;                // Since boot
+    uint32_t stored_misses;         // Kept in NVS, includes this boot
+    uint32_t worst_overrun_ms;      // Kept in NVS
+} deadline_source_stats_t;
+
+typedef struct {
+    deadline_source_stats_t sources[DEADLINE_SOURCE_COUNT];
+    uint32_t neutral_frames;
+    uint32_t neutral_failed;        // No uplink to send them on
+    uint8_t event_count;            // Newest last
+    deadline_event_t events[DEADLINE_LOG_SIZE];
+} deadline_stats_t;
+
+esp_err_t deadline_monitor_init(deadline_neutral_fn_t send_neutral);
+// From the task that meets the deadline
+void deadline_monitor_kick(deadline_source_t source);
+// The throttle sample has missed its deadline and is not to be sent
+bool deadline_monitor_throttle_stale(void);
+
+void deadline_monitor_get_stats(deadline_stats_t *stats);
+// Clears the event log and the stored counters
+esp_err_t deadline_monitor_reset(void);
+const char *deadline_source_name(deadline_source_t source);
+// Name of an eTaskState value as kept in deadline_event_t
+const char *deadline_task_state_name(uint8_t state);
+
+#endif // DEADLINE_MONITOR_H
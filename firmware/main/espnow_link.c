@@ -0,0 +1,479 @@
+#include "espnow_link.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_mac.h"
+#include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "esp_now.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "settings.h"
+#include "espnow_rx.h"
+
+#define TAG "ESPNOW_LINK"
+
+static SemaphoreHandle_t link_mutex = NULL;     // Start, stop and pairing
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool netif_ready = false;
+
+static volatile bool enabled = false;
+static volatile bool running = false;
+static bool paired = false;
+static uint8_t own_mac[ESPNOW_MAC_LEN];
+static uint8_t peer_mac[ESPNOW_MAC_LEN];
+static uint8_t channel = ESPNOW_LINK_DEFAULT_CHANNEL;
+
+// Under stats_lock
+static uint16_t tx_seq = 0;
+static uint32_t tx_packets = 0;
+static uint32_t tx_failed = 0;
+static espnow_seq_tracker_t rx_seq;
+static uint32_t rx_rejected = 0;
+static int rx_rssi = 0;
+static int64_t last_rx_us = 0;
+static bool was_active = false;
+static uint32_t switched_to_espnow = 0;
+static uint32_t fell_back_to_ble = 0;
+static uint32_t rtt_us[ESPNOW_LINK_RTT_SAMPLES];
+static uint32_t rtt_count = 0;
+static uint32_t rtt_next = 0;
+
+static volatile uint32_t bench_remaining = 0;
+
+static bool mac_is_zero(const uint8_t *mac)
+{
+    for (int i = 0; i < ESPNOW_MAC_LEN; i++) {
+        if (mac[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static esp_err_t send_packet(uint8_t type, const uint8_t *payload, size_t len)
+{
+    if (!running || !paired) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    uint16_t seq = tx_seq++;
+    portEXIT_CRITICAL(&stats_lock);
+
+    uint8_t packet[ESPNOW_PACKET_MAX_LEN];
+    size_t packet_len = espnow_packet_encode(type, seq, payload, len, packet, sizeof(packet));
+    if (packet_len == 0) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    esp_err_t ret = esp_now_send(peer_mac, packet, packet_len);
+    if (ret != ESP_OK) {
+        portENTER_CRITICAL(&stats_lock);
+        tx_failed++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    return ret;
+}
+
+static esp_err_t send_ping(void)
+{
+    uint32_t now = (uint32_t)esp_timer_get_time();
+    uint8_t payload[4] = {now & 0xFF, (now >> 8) & 0xFF, (now >> 16) & 0xFF, now >> 24};
+    return send_packet(ESPNOW_PACKET_PING, payload, sizeof(payload));
+}
+
+static void on_send(const uint8_t *mac, esp_now_send_status_t status)
+{
+    portENTER_CRITICAL(&stats_lock);
+    tx_packets++;
+    if (status != ESP_NOW_SEND_SUCCESS) {
+        tx_failed++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+static void on_receive(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    espnow_packet_t packet;
+    if (!paired || memcmp(info->src_addr, peer_mac, ESPNOW_MAC_LEN) != 0 ||
+        !espnow_packet_decode(data, (size_t)len, &packet)) {
+        portENTER_CRITICAL(&stats_lock);
+        rx_rejected++;
+        portEXIT_CRITICAL(&stats_lock);
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_lock);
+    bool in_order = espnow_seq_track(&rx_seq, packet.seq);
+    last_rx_us = now;
+    rx_rssi = info->rx_ctrl->rssi;
+    if (in_order && packet.type == ESPNOW_PACKET_PONG && packet.payload_len == 4) {
+        uint32_t sent = packet.payload[0] | ((uint32_t)packet.payload[1] << 8) |
+                        ((uint32_t)packet.payload[2] << 16) | ((uint32_t)packet.payload[3] << 24);
+        rtt_us[rtt_next] = (uint32_t)now - sent;
+        rtt_next = (rtt_next + 1) % ESPNOW_LINK_RTT_SAMPLES;
+        if (rtt_count < ESPNOW_LINK_RTT_SAMPLES) {
+            rtt_count++;
+        }
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (!in_order) {
+        return;
+    }
+    switch (packet.type) {
+        case ESPNOW_PACKET_TELEMETRY:
+            // Decoded in the espnow_rx task, not here in the Wi-Fi task
+            espnow_rx_post(packet.payload, packet.payload_len);
+            break;
+        case ESPNOW_PACKET_PING:
+            send_packet(ESPNOW_PACKET_PONG, packet.payload, packet.payload_len);
+            break;
+        default:
+            break;
+    }
+}
+
+// Caller holds link_mutex
+static esp_err_t start_locked(void)
+{
+    if (running) {
+        return ESP_OK;
+    }
+    if (!netif_ready) {
+        ESP_ERROR_CHECK(esp_netif_init());
+        esp_err_t ret = esp_event_loop_create_default();
+        if (ret != ESP_OK && ret != ESP_ERR_INVALID_STATE) {
+            return ret;
+        }
+        netif_ready = true;
+    }
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    esp_err_t ret = esp_wifi_init(&cfg);
+    if (ret == ESP_OK) ret = esp_wifi_set_storage(WIFI_STORAGE_RAM);
+    if (ret == ESP_OK) ret = esp_wifi_set_mode(WIFI_MODE_STA);
+    if (ret == ESP_OK) ret = esp_wifi_start();
+    if (ret == ESP_OK) ret = esp_wifi_set_channel(channel, WIFI_SECOND_CHAN_NONE);
+    if (ret == ESP_OK) ret = esp_now_init();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Wi-Fi start failed: %s", esp_err_to_name(ret));
+        esp_wifi_stop();
+        esp_wifi_deinit();
+        return ret;
+    }
+
+    esp_now_register_send_cb(on_send);
+    esp_now_register_recv_cb(on_receive);
+    esp_now_set_pmk((const uint8_t *)ESPNOW_LINK_PMK);
+
+    esp_now_peer_info_t peer = {
+        .channel = channel,
+        .ifidx = WIFI_IF_STA,
+        .encrypt = true,
+    };
+    memcpy(peer.peer_addr, peer_mac, ESPNOW_MAC_LEN);
+    settings_t settings;
+    settings_get(&settings);
+    memcpy(peer.lmk, settings.espnow_key, ESPNOW_KEY_LEN);
+    ret = esp_now_add_peer(&peer);
+    memset(peer.lmk, 0, sizeof(peer.lmk));
+    memset(settings.espnow_key, 0, sizeof(settings.espnow_key));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Adding peer failed: %s", esp_err_to_name(ret));
+        esp_now_deinit();
+        esp_wifi_stop();
+        esp_wifi_deinit();
+        return ret;
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    espnow_seq_reset(&rx_seq);
+    last_rx_us = 0;
+    portEXIT_CRITICAL(&stats_lock);
+
+    running = true;
+    ESP_LOGI(TAG, "Running on channel %d, peer " MACSTR, channel, MAC2STR(peer_mac));
+    return ESP_OK;
+}
+
+// Caller holds link_mutex
+static void stop_locked(void)
+{
+    if (!running) {
+        return;
+    }
+    running = false;
+    esp_now_deinit();
+    esp_wifi_stop();
+    esp_wifi_deinit();
+    ESP_LOGI(TAG, "Stopped");
+}
+
+// Caller holds link_mutex
+static void load_pairing_locked(void)
+{
+    settings_t settings;
+    settings_get(&settings);
+    enabled = settings.espnow_enabled != 0;
+    channel = settings.espnow_channel;
+    memcpy(peer_mac, settings.espnow_peer_mac, ESPNOW_MAC_LEN);
+    paired = !mac_is_zero(peer_mac);
+    memset(settings.espnow_key, 0, sizeof(settings.espnow_key));
+}
+
+static bool is_active(int64_t now)
+{
+    return enabled && running && last_rx_us != 0 &&
+        now - last_rx_us < (int64_t)ESPNOW_LINK_TIMEOUT_MS * 1000;
+}
+
+static void espnow_link_task(void *pvParameters)
+{
+    int64_t next_probe = 0;
+
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        if (running) {
+            if (bench_remaining > 0) {
+                if (now >= next_probe) {
+                    send_ping();
+                    bench_remaining--;
+                    next_probe = now + ESPNOW_LINK_BENCH_PERIOD_MS * 1000;
+                }
+            } else if (now >= next_probe) {
+                send_ping();
+                next_probe = now + ESPNOW_LINK_PROBE_MS * 1000;
+            }
+        }
+
+        portENTER_CRITICAL(&stats_lock);
+        bool active_now = is_active(now);
+        bool changed = active_now != was_active;
+        if (changed) {
+            if (active_now) {
+                switched_to_espnow++;
+            } else {
+                fell_back_to_ble++;
+            }
+            was_active = active_now;
+        }
+        portEXIT_CRITICAL(&stats_lock);
+
+        if (changed) {
+            if (active_now) {
+                ESP_LOGI(TAG, "Throttle over ESP-NOW");
+            } else {
+                ESP_LOGW(TAG, "No packet for %d ms, throttle back over BLE", ESPNOW_LINK_TIMEOUT_MS);
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(ESPNOW_LINK_TASK_PERIOD_MS));
+    }
+}
+
+esp_err_t espnow_link_init(espnow_link_telemetry_cb_t on_telemetry)
+{
+    esp_read_mac(own_mac, ESP_MAC_WIFI_STA);
+    esp_err_t ret = espnow_rx_init(on_telemetry);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    link_mutex = xSemaphoreCreateMutex();
+    if (link_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(espnow_link_task, "espnow_link", 3072, NULL, 7, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(link_mutex, portMAX_DELAY);
+    load_pairing_locked();
+    if (enabled && paired) {
+        ret = start_locked();
+    }
+    xSemaphoreGive(link_mutex);
+    return ret;
+}
+
+esp_err_t espnow_link_set_enabled(bool enable)
+{
+    settings_t settings;
+    settings_get(&settings);
+    settings.espnow_enabled = enable ? 1 : 0;
+    esp_err_t ret = settings_save(&settings);
+    memset(settings.espnow_key, 0, sizeof(settings.espnow_key));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    xSemaphoreTake(link_mutex, portMAX_DELAY);
+    enabled = enable;
+    if (enable && paired) {
+        ret = start_locked();
+    } else if (!enable) {
+        stop_locked();
+    }
+    xSemaphoreGive(link_mutex);
+    return ret;
+}
+
+bool espnow_link_active(void)
+{
+    portENTER_CRITICAL(&stats_lock);
+    bool active = is_active(esp_timer_get_time());
+    portEXIT_CRITICAL(&stats_lock);
+    return active;
+}
+
+esp_err_t espnow_link_send_throttle(const uint8_t *data, size_t len)
+{
+    return send_packet(ESPNOW_PACKET_THROTTLE, data, len);
+}
+
+esp_err_t espnow_link_pair(const uint8_t mac[ESPNOW_MAC_LEN], const uint8_t key[ESPNOW_KEY_LEN], uint8_t new_channel)
+{
+    if (mac_is_zero(mac) || (mac[0] & 0x01) || new_channel < 1 || new_channel > 13) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    settings_t settings;
+    settings_get(&settings);
+    memcpy(settings.espnow_peer_mac, mac, ESPNOW_MAC_LEN);
+    memcpy(settings.espnow_key, key, ESPNOW_KEY_LEN);
+    settings.espnow_channel = new_channel;
+    esp_err_t ret = settings_save(&settings);
+    memset(settings.espnow_key, 0, sizeof(settings.espnow_key));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    xSemaphoreTake(link_mutex, portMAX_DELAY);
+    stop_locked();
+    load_pairing_locked();
+    if (enabled) {
+        ret = start_locked();
+    }
+    xSemaphoreGive(link_mutex);
+    ESP_LOGI(TAG, "Paired with " MACSTR " on channel %d", MAC2STR(mac), new_channel);
+    return ret;
+}
+
+esp_err_t espnow_link_unpair(void)
+{
+    settings_t settings;
+    settings_get(&settings);
+    memset(settings.espnow_peer_mac, 0, sizeof(settings.espnow_peer_mac));
+    memset(settings.espnow_key, 0, sizeof(settings.espnow_key));
+    esp_err_t ret = settings_save(&settings);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    xSemaphoreTake(link_mutex, portMAX_DELAY);
+    stop_locked();
+    load_pairing_locked();
+    xSemaphoreGive(link_mutex);
+    return ESP_OK;
+}
+
+uint8_t espnow_link_channel(void)
+{
+    return channel;
+}
+
+void espnow_link_get_own_mac(uint8_t mac[ESPNOW_MAC_LEN])
+{
+    memcpy(mac, own_mac, ESPNOW_MAC_LEN);
+}
+
+esp_err_t espnow_link_bench_start(uint32_t pings)
+{
+    if (pings == 0 || pings > ESPNOW_LINK_BENCH_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    rtt_count = 0;
+    rtt_next = 0;
+    portEXIT_CRITICAL(&stats_lock);
+    bench_remaining = pings;
+    return ESP_OK;
+}
+
+bool espnow_link_bench_is_active(void)
+{
+    return bench_remaining > 0;
+}
+
+void espnow_link_reset_stats(void)
+{
+    portENTER_CRITICAL(&stats_lock);
+    tx_packets = 0;
+    tx_failed = 0;
+    uint16_t expected = rx_seq.expected;
+    bool started = rx_seq.started;
+    espnow_seq_reset(&rx_seq);
+    rx_seq.expected = expected;
+    rx_seq.started = started;
+    rx_rejected = 0;
+    switched_to_espnow = 0;
+    fell_back_to_ble = 0;
+    rtt_count = 0;
+    rtt_next = 0;
+    portEXIT_CRITICAL(&stats_lock);
+    espnow_rx_reset_stats();
+}
+
+void espnow_link_get_status(espnow_link_status_t *status)
+{
+    uint32_t samples[ESPNOW_LINK_RTT_SAMPLES];
+    int64_t now = esp_timer_get_time();
+
+    memset(status, 0, sizeof(*status));
+    status->enabled = enabled;
+    status->running = running;
+    status->paired = paired;
+    status->channel = channel;
+    memcpy(status->own_mac, own_mac, ESPNOW_MAC_LEN);
+    memcpy(status->peer_mac, peer_mac, ESPNOW_MAC_LEN);
+
+    portENTER_CRITICAL(&stats_lock);
+    status->active = is_active(now);
+    status->last_rx_age_ms = last_rx_us != 0 ? (uint32_t)((now - last_rx_us) / 1000) : UINT32_MAX;
+    status->tx_packets = tx_packets;
+    status->tx_failed = tx_failed;
+    status->rx = rx_seq;
+    status->rx_rejected = rx_rejected;
+    status->rx_rssi = rx_rssi;
+    status->switched_to_espnow = switched_to_espnow;
+    status->fell_back_to_ble = fell_back_to_ble;
+    uint32_t count = rtt_count;
+    memcpy(samples, rtt_us, count * sizeof(samples[0]));
+    portEXIT_CRITICAL(&stats_lock);
+    espnow_rx_get_stats(&status->rx_queue);
+
+    if (count == 0) {
+        return;
+    }
+    // Insertion sort, at most ESPNOW_LINK_RTT_SAMPLES entries
+    for (uint32_t i = 1; i < count; i++) {
+        uint32_t value = samples[i];
+        uint32_t j = i;
+        while (j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = value;
+    }
+    status->rtt_count = count;
+    status->rtt_min_us = samples[0];
+    status->rtt_p50_us = samples[count / 2];
+    status->rtt_p99_us = samples[(count * 99) / 100];
+    status->rtt_max_us = samples[count - 1];
+}
@@ -0,0 +1,81 @@
+#ifndef ESPNOW_LINK_H
+#define ESPNOW_LINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "espnow_packet.h"
+#include "espnow_rx.h"
+
+// Optional ESP-NOW link to the receiver, next to BLE. Once paired and
+// enabled, Wi-Fi is started in station mode on the paired channel and the
+// peer entry is encrypted with the pairing key. Pings go out every
+// ESPNOW_LINK_PROBE_MS; while packets keep arriving from the peer the link
+// is active and the throttle goes over ESP-NOW instead of BLE. After
+// ESPNOW_LINK_TIMEOUT_MS without one the throttle falls back to BLE, which
+// stays connected the whole time, and moves back on the next packet.
+//
+// Pairing stores the peer MAC and key in settings, either entered on the
+// console or exchanged over BLE (see espnow_packet.h and ble.h).
+
+#define ESPNOW_LINK_DEFAULT_CHANNEL 1
+#define ESPNOW_LINK_TIMEOUT_MS      300
+#define ESPNOW_LINK_PROBE_MS        100
+#define ESPNOW_LINK_TASK_PERIOD_MS  10
+#define ESPNOW_LINK_PMK             "GS-Remote-ESPNOW"  // 16 bytes, the LMK is the per-pair secret
+
+// Round trip samples kept for the percentiles
+#define ESPNOW_LINK_RTT_SAMPLES     128
+#define ESPNOW_LINK_BENCH_MAX       1000
+#define ESPNOW_LINK_BENCH_PERIOD_MS 20
+
+typedef struct {
+    bool enabled;
+    bool running;                   // Wi-Fi and ESP-NOW are up
+    bool paired;
+    bool active;                    // Carrying the throttle right now
+    uint8_t own_mac[ESPNOW_MAC_LEN];
+    uint8_t peer_mac[ESPNOW_MAC_LEN];
+    uint8_t channel;
+    uint32_t last_rx_age_ms;        // UINT32_MAX before the first packet
+
+    uint32_t tx_packets;
+    uint32_t tx_failed;             // Not acknowledged by the peer
+    espnow_seq_tracker_t rx;
+    uint32_t rx_rejected;           // Not decodable or from another sender
+    int rx_rssi;
+    espnow_rx_stats_t rx_queue;     // Telemetry on its way to the decoder
+
+    uint32_t switched_to_espnow;
+    uint32_t fell_back_to_ble;
+
+    uint32_t rtt_count;             // Samples in the percentiles, up to ESPNOW_LINK_RTT_SAMPLES
+    uint32_t rtt_min_us;
+    uint32_t rtt_p50_us;
+    uint32_t rtt_p99_us;
+    uint32_t rtt_max_us;
+} espnow_link_status_t;
+
+// Telemetry frames from the peer, called in the espnow_rx task
+typedef void (*espnow_link_telemetry_cb_t)(const uint8_t *data, size_t len);
+
+// Starts the radio right away if enabled and paired in settings
+esp_err_t espnow_link_init(espnow_link_telemetry_cb_t on_telemetry);
+esp_err_t espnow_link_set_enabled(bool enabled);
+bool espnow_link_active(void);
+esp_err_t espnow_link_send_throttle(const uint8_t *data, size_t len);
+
+// Saves the peer and restarts the link on the given channel
+esp_err_t espnow_link_pair(const uint8_t mac[ESPNOW_MAC_LEN], const uint8_t key[ESPNOW_KEY_LEN], uint8_t channel);
+esp_err_t espnow_link_unpair(void);
+uint8_t espnow_link_channel(void);
+void espnow_link_get_own_mac(uint8_t mac[ESPNOW_MAC_LEN]);
+
+// Pings back to back every ESPNOW_LINK_BENCH_PERIOD_MS, with fresh RTT samples
+esp_err_t espnow_link_bench_start(uint32_t pings);
+bool espnow_link_bench_is_active(void);
+void espnow_link_reset_stats(void);
+void espnow_link_get_status(espnow_link_status_t *status);
+
+#endif // ESPNOW_LINK_H
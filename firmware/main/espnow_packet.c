@@ -0,0 +1,86 @@
+#include "espnow_packet.h"
+#include <string.h>
+
+size_t espnow_packet_encode(uint8_t type, uint16_t seq, const uint8_t *payload, size_t payload_len,
+                            uint8_t *out, size_t out_size)
+{
+    if (payload_len > ESPNOW_PACKET_MAX_PAYLOAD || out_size < ESPNOW_PACKET_HEADER_LEN + payload_len) {
+        return 0;
+    }
+    out[0] = ESPNOW_PACKET_MAGIC;
+    out[1] = type;
+    out[2] = (uint8_t)(seq & 0xFF);
+    out[3] = (uint8_t)(seq >> 8);
+    if (payload_len > 0) {
+        memcpy(&out[ESPNOW_PACKET_HEADER_LEN], payload, payload_len);
+    }
+    return ESPNOW_PACKET_HEADER_LEN + payload_len;
+}
+
+bool espnow_packet_decode(const uint8_t *data, size_t len, espnow_packet_t *packet)
+{
+    if (data == NULL || len < ESPNOW_PACKET_HEADER_LEN || len > ESPNOW_PACKET_MAX_LEN ||
+        data[0] != ESPNOW_PACKET_MAGIC) {
+        return false;
+    }
+    if (data[1] < ESPNOW_PACKET_THROTTLE || data[1] > ESPNOW_PACKET_PONG) {
+        return false;
+    }
+    packet->type = data[1];
+    packet->seq = (uint16_t)(data[2] | ((uint16_t)data[3] << 8));
+    packet->payload = &data[ESPNOW_PACKET_HEADER_LEN];
+    packet->payload_len = len - ESPNOW_PACKET_HEADER_LEN;
+    return true;
+}
+
+void espnow_seq_reset(espnow_seq_tracker_t *tracker)
+{
+    memset(tracker, 0, sizeof(*tracker));
+}
+
+bool espnow_seq_track(espnow_seq_tracker_t *tracker, uint16_t seq)
+{
+    int16_t ahead = (int16_t)(seq - tracker->expected);
+
+    if (!tracker->started || ahead < -ESPNOW_SEQ_RESYNC_WINDOW) {
+        if (tracker->started) {
+            tracker->resyncs++;
+        }
+        tracker->started = true;
+        ahead = 0;
+    } else if (ahead < 0) {
+        // Counted as lost when it was skipped, it made it after all
+        tracker->late++;
+        if (tracker->lost > 0) {
+            tracker->lost--;
+        }
+        return false;
+    }
+
+    tracker->lost += (uint32_t)ahead;
+    tracker->received++;
+    tracker->expected = (uint16_t)(seq + 1);
+    return true;
+}
+
+size_t espnow_pair_offer_encode(const uint8_t mac[ESPNOW_MAC_LEN], uint8_t channel,
+                                const uint8_t key[ESPNOW_KEY_LEN], uint8_t *out, size_t out_size)
+{
+    if (out_size < ESPNOW_PAIR_OFFER_LEN) {
+        return 0;
+    }
+    out[0] = ESPNOW_PAIR_MAGIC;
+    memcpy(&out[1], mac, ESPNOW_MAC_LEN);
+    out[1 + ESPNOW_MAC_LEN] = channel;
+    memcpy(&out[2 + ESPNOW_MAC_LEN], key, ESPNOW_KEY_LEN);
+    return ESPNOW_PAIR_OFFER_LEN;
+}
+
+bool espnow_pair_answer_decode(const uint8_t *data, size_t len, uint8_t mac[ESPNOW_MAC_LEN])
+{
+    if (data == NULL || len != ESPNOW_PAIR_ANSWER_LEN || data[0] != ESPNOW_PAIR_MAGIC) {
+        return false;
+    }
+    memcpy(mac, &data[1], ESPNOW_MAC_LEN);
+    return true;
+}
@@ -0,0 +1,83 @@
+#ifndef ESPNOW_PACKET_H
+#define ESPNOW_PACKET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Packet format of the ESP-NOW link to the GS-THUMB receiver, and the
+// pairing messages sent over the BLE command/status characteristics. Pure
+// functions, no ESP-IDF or FreeRTOS calls, so the board side and host
+// tools can share it.
+//
+// ESP-NOW packet, 4 byte header then the payload:
+//     0  magic 'G'   1  type   2  sequence (u16, little endian)
+//     THROTTLE   remote -> board, the 2 byte value also written over BLE
+//     TELEMETRY  board -> remote, the 55 byte notify of telemetry_decode.h
+//     PING       either way, 4 byte timestamp echoed back unchanged
+//     PONG       the echo
+// Each side numbers its own packets, one counter for all types.
+//
+// Pairing over BLE, remote writes to the command characteristic:
+//     'P', remote MAC (6), channel (1), key (16)
+// and the board answers on the status characteristic:
+//     'P', board MAC (6)
+// The key is the ESP-NOW local master key of the peer entry on both sides.
+// The offer carries it as is, so the remote only sends it once the BLE link
+// is encrypted (ble_transport_request_encryption: LE Secure Connections,
+// Just Works). That keeps it from a listener, not from a device in the
+// middle while the link pairs; espnow pair <mac> on the console keeps the
+// key off the air altogether.
+
+#define ESPNOW_PACKET_MAGIC         'G'
+#define ESPNOW_PACKET_HEADER_LEN    4
+#define ESPNOW_PACKET_MAX_PAYLOAD   64
+#define ESPNOW_PACKET_MAX_LEN       (ESPNOW_PACKET_HEADER_LEN + ESPNOW_PACKET_MAX_PAYLOAD)
+
+#define ESPNOW_MAC_LEN              6
+#define ESPNOW_KEY_LEN              16
+#define ESPNOW_PAIR_MAGIC           'P'
+#define ESPNOW_PAIR_OFFER_LEN       (1 + ESPNOW_MAC_LEN + 1 + ESPNOW_KEY_LEN)
+#define ESPNOW_PAIR_ANSWER_LEN      (1 + ESPNOW_MAC_LEN)
+
+// A jump back further than this is a restarted peer, not a late packet
+#define ESPNOW_SEQ_RESYNC_WINDOW    256
+
+typedef enum {
+    ESPNOW_PACKET_THROTTLE = 1,
+    ESPNOW_PACKET_TELEMETRY = 2,
+    ESPNOW_PACKET_PING = 3,
+    ESPNOW_PACKET_PONG = 4,
+} espnow_packet_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint16_t seq;
+    const uint8_t *payload;         // Points into the decoded buffer
+    size_t payload_len;
+} espnow_packet_t;
+
+typedef struct {
+    bool started;
+    uint16_t expected;              // Next sequence number expected
+    uint32_t received;
+    uint32_t lost;                  // Skipped numbers, late arrivals are taken back off
+    uint32_t late;                  // Behind the expected number (reordered or duplicated)
+    uint32_t resyncs;
+} espnow_seq_tracker_t;
+
+// Returns the packet length, or 0 if it does not fit in out_size
+size_t espnow_packet_encode(uint8_t type, uint16_t seq, const uint8_t *payload, size_t payload_len,
+                            uint8_t *out, size_t out_size);
+// False for anything without the magic, a known type or a full header
+bool espnow_packet_decode(const uint8_t *data, size_t len, espnow_packet_t *packet);
+
+void espnow_seq_reset(espnow_seq_tracker_t *tracker);
+// Returns false for a late or duplicated packet, which should be dropped
+bool espnow_seq_track(espnow_seq_tracker_t *tracker, uint16_t seq);
+
+size_t espnow_pair_offer_encode(const uint8_t mac[ESPNOW_MAC_LEN], uint8_t channel,
+                                const uint8_t key[ESPNOW_KEY_LEN], uint8_t *out, size_t out_size);
+bool espnow_pair_answer_decode(const uint8_t *data, size_t len, uint8_t mac[ESPNOW_MAC_LEN]);
+
+#endif // ESPNOW_PACKET_H
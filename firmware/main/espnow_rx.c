@@ -0,0 +1,117 @@
+#include "espnow_rx.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define TAG "ESPNOW_RX"
+
+typedef struct {
+    int64_t posted_us;
+    uint8_t len;
+    uint8_t data[ESPNOW_PACKET_MAX_PAYLOAD];
+} rx_item_t;
+
+static espnow_rx_handler_t handler = NULL;
+static QueueHandle_t rx_queue = NULL;
+
+// Under stats_lock
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t posted = 0;
+static uint32_t dropped = 0;
+static uint32_t handled = 0;
+static uint32_t max_waiting = 0;
+static uint64_t handoff_total_us = 0;
+static uint32_t handoff_max_us = 0;
+static uint32_t handler_max_us = 0;
+
+static void espnow_rx_task(void *pvParameters)
+{
+    rx_item_t item;
+
+    while (1) {
+        if (xQueueReceive(rx_queue, &item, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        int64_t start = esp_timer_get_time();
+        handler(item.data, item.len);
+        int64_t end = esp_timer_get_time();
+
+        uint32_t handoff_us = (uint32_t)(start - item.posted_us);
+        uint32_t handler_us = (uint32_t)(end - start);
+        portENTER_CRITICAL(&stats_lock);
+        handled++;
+        handoff_total_us += handoff_us;
+        if (handoff_us > handoff_max_us) {
+            handoff_max_us = handoff_us;
+        }
+        if (handler_us > handler_max_us) {
+            handler_max_us = handler_us;
+        }
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+esp_err_t espnow_rx_init(espnow_rx_handler_t on_telemetry)
+{
+    handler = on_telemetry;
+    rx_queue = xQueueCreate(ESPNOW_RX_QUEUE_LEN, sizeof(rx_item_t));
+    if (rx_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(espnow_rx_task, "espnow_rx", 4096, NULL, ESPNOW_RX_TASK_PRIORITY, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Could not start the receive task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+bool espnow_rx_post(const uint8_t *data, size_t len)
+{
+    rx_item_t item;
+    bool queued = false;
+    if (rx_queue != NULL && len <= sizeof(item.data)) {
+        item.posted_us = esp_timer_get_time();
+        item.len = (uint8_t)len;
+        memcpy(item.data, data, len);
+        queued = xQueueSend(rx_queue, &item, 0) == pdTRUE;
+    }
+    uint32_t waiting = rx_queue != NULL ? uxQueueMessagesWaiting(rx_queue) : 0;
+
+    portENTER_CRITICAL(&stats_lock);
+    posted++;
+    dropped += !queued;
+    if (waiting > max_waiting) {
+        max_waiting = waiting;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    return queued;
+}
+
+void espnow_rx_get_stats(espnow_rx_stats_t *stats)
+{
+    portENTER_CRITICAL(&stats_lock);
+    stats->posted = posted;
+    stats->dropped = dropped;
+    stats->handled = handled;
+    stats->max_waiting = max_waiting;
+    stats->handoff_avg_us = handled ? (uint32_t)(handoff_total_us / handled) : 0;
+    stats->handoff_max_us = handoff_max_us;
+    stats->handler_max_us = handler_max_us;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void espnow_rx_reset_stats(void)
+{
+    portENTER_CRITICAL(&stats_lock);
+    posted = 0;
+    dropped = 0;
+    handled = 0;
+    max_waiting = 0;
+    handoff_total_us = 0;
+    handoff_max_us = 0;
+    handler_max_us = 0;
+    portEXIT_CRITICAL(&stats_lock);
+}
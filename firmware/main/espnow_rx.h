@@ -0,0 +1,41 @@
+#ifndef ESPNOW_RX_H
+#define ESPNOW_RX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "espnow_packet.h"
+
+// Telemetry from the ESP-NOW receive callback to a task of its own.
+//
+// esp_now calls the receive callback in the Wi-Fi task, which also runs
+// the radio: time spent there delays acknowledgements and the packets
+// behind it. Decoding a frame takes the telemetry mutex and runs every
+// telemetry listener, so the callback only copies the payload into a queue
+// with espnow_rx_post, which never blocks, and the espnow_rx task hands it
+// to the handler. A full queue drops the packet and counts it; the next
+// frame carries the same values a little newer.
+
+#define ESPNOW_RX_QUEUE_LEN     8
+#define ESPNOW_RX_TASK_PRIORITY 9       // Between adc_send_task and the ADC task
+
+typedef void (*espnow_rx_handler_t)(const uint8_t *data, size_t len);
+
+typedef struct {
+    uint32_t posted;
+    uint32_t dropped;               // Queue full or payload too long
+    uint32_t handled;
+    uint32_t max_waiting;           // Deepest the queue has been
+    uint32_t handoff_avg_us;        // Post to handler start
+    uint32_t handoff_max_us;
+    uint32_t handler_max_us;        // Longest the handler kept the task
+} espnow_rx_stats_t;
+
+esp_err_t espnow_rx_init(espnow_rx_handler_t handler);
+// From the Wi-Fi task: copies the payload, false if it was dropped
+bool espnow_rx_post(const uint8_t *data, size_t len);
+void espnow_rx_get_stats(espnow_rx_stats_t *stats);
+void espnow_rx_reset_stats(void);
+
+#endif // ESPNOW_RX_H
@@ -0,0 +1,191 @@
+#include "glass_trace.h"
+#include <string.h>
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+typedef struct {
+    lv_obj_t *obj;
+    // Marked, not drawn yet
+    int64_t pending_rx_us;
+    int64_t pending_mark_us;
+    // Rendered in the refresh being flushed, last stripe not queued yet
+    int64_t drawing_rx_us;
+    int64_t drawing_mark_us;
+    // Last stripe queued as flight_seq
+    int64_t flight_rx_us;
+    int64_t flight_mark_us;
+    uint32_t flight_seq;
+
+    uint32_t count;
+    uint32_t superseded;
+    uint32_t expired;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint64_t sum_ui_us;
+    uint32_t histogram[GLASS_TRACE_BUCKETS];
+} trace_widget_t;
+
+static const char *const widget_names[GLASS_TRACE_WIDGET_COUNT] = {
+    "speed", "trip", "skate_battery", "motor_current",
+};
+
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+static trace_widget_t widgets[GLASS_TRACE_WIDGET_COUNT];
+static uint32_t queued_seq = 0;
+static uint32_t done_seq = 0;
+
+void glass_trace_mark(glass_trace_widget_t widget, lv_obj_t *obj, int64_t rx_time_us)
+{
+    if (widget >= GLASS_TRACE_WIDGET_COUNT || obj == NULL || rx_time_us == 0) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&trace_lock);
+    trace_widget_t *w = &widgets[widget];
+    if (w->pending_rx_us != 0) {
+        w->superseded++;
+    }
+    w->obj = obj;
+    w->pending_rx_us = rx_time_us;
+    w->pending_mark_us = now;
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+void glass_trace_flush(const lv_area_t *area, bool last)
+{
+    int64_t now = esp_timer_get_time();
+    lv_obj_t *screen = lv_scr_act();
+
+    // Geometry first, it cannot be read inside the critical section
+    lv_area_t coords[GLASS_TRACE_WIDGET_COUNT];
+    bool visible[GLASS_TRACE_WIDGET_COUNT];
+    for (int i = 0; i < GLASS_TRACE_WIDGET_COUNT; i++) {
+        lv_obj_t *obj = widgets[i].obj;
+        visible[i] = obj != NULL && lv_obj_get_screen(obj) == screen;
+        if (visible[i]) {
+            lv_obj_get_coords(obj, &coords[i]);
+        }
+    }
+
+    portENTER_CRITICAL(&trace_lock);
+    uint32_t seq = ++queued_seq;
+    for (int i = 0; i < GLASS_TRACE_WIDGET_COUNT; i++) {
+        trace_widget_t *w = &widgets[i];
+        lv_area_t overlap;
+        bool hit = visible[i] && _lv_area_intersect(&overlap, area, &coords[i]);
+
+        if (w->pending_rx_us != 0 && w->drawing_rx_us == 0) {
+            if (hit) {
+                w->drawing_rx_us = w->pending_rx_us;
+                w->drawing_mark_us = w->pending_mark_us;
+                w->pending_rx_us = 0;
+            } else if (now - w->pending_mark_us > GLASS_TRACE_EXPIRE_US) {
+                w->expired++;
+                w->pending_rx_us = 0;
+            }
+        }
+
+        if (w->drawing_rx_us != 0 && ((hit && area->y2 >= coords[i].y2) || last)) {
+            w->flight_rx_us = w->drawing_rx_us;
+            w->flight_mark_us = w->drawing_mark_us;
+            w->flight_seq = seq;
+            w->drawing_rx_us = 0;
+        }
+    }
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+static void record(trace_widget_t *w, int64_t now)
+{
+    uint32_t latency_us = (uint32_t)(now - w->flight_rx_us);
+    uint32_t ui_us = (uint32_t)(w->flight_mark_us - w->flight_rx_us);
+    uint32_t bucket = latency_us / (GLASS_TRACE_BUCKET_MS * 1000);
+
+    if (w->count == 0 || latency_us < w->min_us) {
+        w->min_us = latency_us;
+    }
+    if (latency_us > w->max_us) {
+        w->max_us = latency_us;
+    }
+    w->count++;
+    w->sum_us += latency_us;
+    w->sum_ui_us += ui_us;
+    w->histogram[bucket < GLASS_TRACE_BUCKETS ? bucket : GLASS_TRACE_BUCKETS - 1]++;
+    w->flight_rx_us = 0;
+}
+
+void glass_trace_flush_done(void)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&trace_lock);
+    done_seq++;
+    for (int i = 0; i < GLASS_TRACE_WIDGET_COUNT; i++) {
+        trace_widget_t *w = &widgets[i];
+        if (w->flight_rx_us != 0 && (int32_t)(done_seq - w->flight_seq) >= 0) {
+            record(w, now);
+        }
+    }
+    portEXIT_CRITICAL_ISR(&trace_lock);
+}
+
+// Upper edge of the bucket holding the given share of the samples
+static uint32_t percentile_us(const uint32_t *histogram, uint32_t count, uint32_t percent)
+{
+    uint32_t target = (count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < GLASS_TRACE_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen >= target) {
+            return (uint32_t)(i + 1) * GLASS_TRACE_BUCKET_MS * 1000;
+        }
+    }
+    return GLASS_TRACE_BUCKETS * GLASS_TRACE_BUCKET_MS * 1000;
+}
+
+void glass_trace_get_stats(glass_trace_widget_t widget, glass_trace_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (widget >= GLASS_TRACE_WIDGET_COUNT) {
+        return;
+    }
+
+    portENTER_CRITICAL(&trace_lock);
+    const trace_widget_t *w = &widgets[widget];
+    stats->count = w->count;
+    stats->superseded = w->superseded;
+    stats->expired = w->expired;
+    stats->min_us = w->min_us;
+    stats->max_us = w->max_us;
+    if (w->count > 0) {
+        stats->mean_us = (uint32_t)(w->sum_us / w->count);
+        stats->mean_ui_us = (uint32_t)(w->sum_ui_us / w->count);
+        stats->mean_draw_us = stats->mean_us - stats->mean_ui_us;
+    }
+    memcpy(stats->histogram, w->histogram, sizeof(stats->histogram));
+    portEXIT_CRITICAL(&trace_lock);
+
+    if (stats->count > 0) {
+        stats->p50_us = percentile_us(stats->histogram, stats->count, 50);
+        stats->p99_us = percentile_us(stats->histogram, stats->count, 99);
+    }
+}
+
+void glass_trace_reset(void)
+{
+    portENTER_CRITICAL(&trace_lock);
+    for (int i = 0; i < GLASS_TRACE_WIDGET_COUNT; i++) {
+        trace_widget_t *w = &widgets[i];
+        lv_obj_t *obj = w->obj;
+        memset(w, 0, sizeof(*w));
+        w->obj = obj;
+    }
+    portEXIT_CRITICAL(&trace_lock);
+}
+
+const char *glass_trace_widget_name(glass_trace_widget_t widget)
+{
+    return widget < GLASS_TRACE_WIDGET_COUNT ? widget_names[widget] : "unknown";
+}
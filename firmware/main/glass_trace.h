@@ -0,0 +1,64 @@
+#ifndef GLASS_TRACE_H
+#define GLASS_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lvgl.h"
+
+// Notify-to-glass latency of the telemetry widgets.
+//
+// A UI update that draws telemetry marks its widget with the receive time
+// of the newest snapshot (telemetry_snapshot_t.rx_time_us) right after
+// setting the text, under the LVGL mutex. The mark waits until a refresh
+// flushes an area that overlaps the widget on the active screen. The stripe
+// that reaches the widget's bottom edge, or the refresh's last stripe,
+// carries the mark to the panel. The SPI transfer-done callback of that
+// stripe closes it, so the time taken includes:
+//   notify -> decode -> UI task poll -> LVGL mutex -> render -> SPI flush
+//
+// The speed tag is read before the speed is computed. The 1 Hz widgets read
+// theirs in the update function, after the caller sampled the value, so
+// their tag can be one frame newer than the data it shows.
+//
+// A newer mark replacing one that was never drawn counts as superseded.
+// A mark not drawn within GLASS_TRACE_EXPIRE_US counts as expired, for
+// example when its screen was not shown.
+
+#define GLASS_TRACE_BUCKET_MS   5
+#define GLASS_TRACE_BUCKETS     20      // Last bucket collects everything above
+#define GLASS_TRACE_EXPIRE_US   500000
+
+typedef enum {
+    GLASS_TRACE_SPEED = 0,
+    GLASS_TRACE_TRIP,
+    GLASS_TRACE_SKATE_BATTERY,
+    GLASS_TRACE_MOTOR_CURRENT,
+    GLASS_TRACE_WIDGET_COUNT,
+} glass_trace_widget_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t superseded;
+    uint32_t expired;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+    uint32_t mean_ui_us;            // Notify to the UI update
+    uint32_t mean_draw_us;          // UI update to the end of the flush
+    uint32_t p50_us;                // Upper edge of the bucket
+    uint32_t p99_us;
+    uint32_t histogram[GLASS_TRACE_BUCKETS];
+} glass_trace_stats_t;
+
+// After the widget's text was set, LVGL mutex held. rx_time_us 0 is ignored.
+void glass_trace_mark(glass_trace_widget_t widget, lv_obj_t *obj, int64_t rx_time_us);
+// From the flush callback, before the stripe is queued
+void glass_trace_flush(const lv_area_t *area, bool last);
+// From the transfer-done callback, once per flushed stripe in order
+void glass_trace_flush_done(void);
+
+void glass_trace_get_stats(glass_trace_widget_t widget, glass_trace_stats_t *stats);
+void glass_trace_reset(void);
+const char *glass_trace_widget_name(glass_trace_widget_t widget);
+
+#endif // GLASS_TRACE_H
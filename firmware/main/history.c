@@ -0,0 +1,214 @@
+#include "history.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "telemetry.h"
+#include "kinematics.h"
+
+#define TAG "HISTORY"
+
+#define L1_CAPACITY  (HISTORY_CAPACITY / HISTORY_L1_FACTOR)
+#define L2_CAPACITY  (HISTORY_CAPACITY / HISTORY_L2_FACTOR)
+
+// One allocation, split into a contiguous array per channel and level
+typedef struct {
+    int16_t *raw[HISTORY_CHANNEL_COUNT];
+    int16_t *l1_min[HISTORY_CHANNEL_COUNT];
+    int16_t *l1_max[HISTORY_CHANNEL_COUNT];
+    int16_t *l2_min[HISTORY_CHANNEL_COUNT];
+    int16_t *l2_max[HISTORY_CHANNEL_COUNT];
+} history_arrays_t;
+
+static history_arrays_t arrays;
+static uint32_t *times_ms;              // Receive time of each raw sample
+static int16_t *storage = NULL;
+
+// Written by the telemetry callback only; published after the sample data
+static volatile uint32_t sample_count = 0;
+
+// Partial pyramid groups, only touched from the telemetry callback
+static int16_t l1_acc_min[HISTORY_CHANNEL_COUNT];
+static int16_t l1_acc_max[HISTORY_CHANNEL_COUNT];
+static int16_t l2_acc_min[HISTORY_CHANNEL_COUNT];
+static int16_t l2_acc_max[HISTORY_CHANNEL_COUNT];
+
+static void on_telemetry(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    uint32_t speed_cm_s = kinematics_erpm_to_mm_s(snapshot->erpm) / 10;
+    int16_t values[HISTORY_CHANNEL_COUNT] = {
+        [HISTORY_CH_SPEED] = speed_cm_s > INT16_MAX ? INT16_MAX : (int16_t)speed_cm_s,
+        [HISTORY_CH_CURRENT_MOTOR] = snapshot->current_motor_c100,
+        [HISTORY_CH_CURRENT_IN] = snapshot->current_in_c100,
+        [HISTORY_CH_TEMP_MOS] = snapshot->temp_mos_c100,
+        [HISTORY_CH_TEMP_MOTOR] = snapshot->temp_motor_c100,
+    };
+
+    uint32_t n = sample_count;
+    times_ms[n % HISTORY_CAPACITY] = (uint32_t)(snapshot->rx_time_us / 1000);
+    bool l1_start = (n % HISTORY_L1_FACTOR) == 0;
+    bool l1_end = (n % HISTORY_L1_FACTOR) == HISTORY_L1_FACTOR - 1;
+    bool l2_start = (n % HISTORY_L2_FACTOR) == 0;
+    bool l2_end = (n % HISTORY_L2_FACTOR) == HISTORY_L2_FACTOR - 1;
+
+    for (int ch = 0; ch < HISTORY_CHANNEL_COUNT; ch++) {
+        int16_t v = values[ch];
+        arrays.raw[ch][n % HISTORY_CAPACITY] = v;
+
+        if (l1_start || v < l1_acc_min[ch]) {
+            l1_acc_min[ch] = v;
+        }
+        if (l1_start || v > l1_acc_max[ch]) {
+            l1_acc_max[ch] = v;
+        }
+        if (l1_end) {
+            uint32_t i1 = (n / HISTORY_L1_FACTOR) % L1_CAPACITY;
+            arrays.l1_min[ch][i1] = l1_acc_min[ch];
+            arrays.l1_max[ch][i1] = l1_acc_max[ch];
+        }
+
+        if (l2_start || v < l2_acc_min[ch]) {
+            l2_acc_min[ch] = v;
+        }
+        if (l2_start || v > l2_acc_max[ch]) {
+            l2_acc_max[ch] = v;
+        }
+        if (l2_end) {
+            uint32_t i2 = (n / HISTORY_L2_FACTOR) % L2_CAPACITY;
+            arrays.l2_min[ch][i2] = l2_acc_min[ch];
+            arrays.l2_max[ch][i2] = l2_acc_max[ch];
+        }
+    }
+
+    // Readers on the other core must see the samples before the new count
+    __atomic_store_n(&sample_count, n + 1, __ATOMIC_RELEASE);
+}
+
+esp_err_t history_init(void)
+{
+    storage = heap_caps_malloc(history_get_memory_bytes(), MALLOC_CAP_SPIRAM);
+    if (storage == NULL) {
+        ESP_LOGW(TAG, "No PSRAM for telemetry history, charts disabled");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Timestamps first so they stay 4-byte aligned
+    times_ms = (uint32_t *)storage;
+    int16_t *p = (int16_t *)(times_ms + HISTORY_CAPACITY);
+    for (int ch = 0; ch < HISTORY_CHANNEL_COUNT; ch++) {
+        arrays.raw[ch] = p;
+        p += HISTORY_CAPACITY;
+        arrays.l1_min[ch] = p;
+        p += L1_CAPACITY;
+        arrays.l1_max[ch] = p;
+        p += L1_CAPACITY;
+        arrays.l2_min[ch] = p;
+        p += L2_CAPACITY;
+        arrays.l2_max[ch] = p;
+        p += L2_CAPACITY;
+    }
+
+    ESP_LOGI(TAG, "History: %d samples x %d channels, %u bytes", HISTORY_CAPACITY,
+             HISTORY_CHANNEL_COUNT, (unsigned)history_get_memory_bytes());
+    return telemetry_register_callback(on_telemetry, NULL);
+}
+
+bool history_is_available(void)
+{
+    return storage != NULL;
+}
+
+uint32_t history_get_count(void)
+{
+    return __atomic_load_n(&sample_count, __ATOMIC_ACQUIRE);
+}
+
+// True while [first, end) is readable and clear of the writer
+static bool range_valid(uint32_t first, uint32_t end, uint32_t count)
+{
+    if (end > count) {
+        return false;
+    }
+    // Completed pyramid groups only, a partial group is read from raw samples
+    return count - first + HISTORY_READ_SLACK <= HISTORY_CAPACITY;
+}
+
+bool history_find_time(uint32_t time_ms, uint32_t *index)
+{
+    if (storage == NULL) {
+        return false;
+    }
+
+    uint32_t count = history_get_count();
+    uint32_t oldest = count > HISTORY_CAPACITY - HISTORY_READ_SLACK ? count - (HISTORY_CAPACITY - HISTORY_READ_SLACK) : 0;
+    uint32_t lo = oldest;
+    uint32_t hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if ((int32_t)(times_ms[mid % HISTORY_CAPACITY] - time_ms) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // Earlier samples are gone, or the writer lapped the search
+    if ((lo == oldest && oldest > 0) || !range_valid(oldest, oldest, history_get_count())) {
+        return false;
+    }
+    *index = lo;
+    return true;
+}
+
+bool history_read_range(history_channel_t channel, uint32_t first, uint32_t span,
+                        int16_t *min_out, int16_t *max_out)
+{
+    if (storage == NULL || channel >= HISTORY_CHANNEL_COUNT || span == 0) {
+        return false;
+    }
+
+    uint32_t end = first + span;
+    if (!range_valid(first, end, history_get_count())) {
+        return false;
+    }
+
+    int16_t lo = INT16_MAX;
+    int16_t hi = INT16_MIN;
+    uint32_t i = first;
+    while (i < end) {
+        int16_t a, b;
+        if (i % HISTORY_L2_FACTOR == 0 && i + HISTORY_L2_FACTOR <= end) {
+            uint32_t i2 = (i / HISTORY_L2_FACTOR) % L2_CAPACITY;
+            a = arrays.l2_min[channel][i2];
+            b = arrays.l2_max[channel][i2];
+            i += HISTORY_L2_FACTOR;
+        } else if (i % HISTORY_L1_FACTOR == 0 && i + HISTORY_L1_FACTOR <= end) {
+            uint32_t i1 = (i / HISTORY_L1_FACTOR) % L1_CAPACITY;
+            a = arrays.l1_min[channel][i1];
+            b = arrays.l1_max[channel][i1];
+            i += HISTORY_L1_FACTOR;
+        } else {
+            a = b = arrays.raw[channel][i % HISTORY_CAPACITY];
+            i++;
+        }
+        if (a < lo) {
+            lo = a;
+        }
+        if (b > hi) {
+            hi = b;
+        }
+    }
+
+    // The writer may have lapped the range while it was read
+    if (!range_valid(first, end, history_get_count())) {
+        return false;
+    }
+
+    *min_out = lo;
+    *max_out = hi;
+    return true;
+}
+
+size_t history_get_memory_bytes(void)
+{
+    return (HISTORY_CAPACITY + 2 * L1_CAPACITY + 2 * L2_CAPACITY) * HISTORY_CHANNEL_COUNT * sizeof(int16_t) +
+           HISTORY_CAPACITY * sizeof(uint32_t);
+}
@@ -0,0 +1,65 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Telemetry history for the on-screen charts.
+//
+// Every telemetry frame is stored as one sample per channel in a
+// struct-of-arrays ring in PSRAM, with its receive time in ms so readers
+// can bucket by time rather than by sample count when the frame rate
+// varies. Two min/max pyramids sit on top of it:
+// level 1 holds the min/max of each aligned group of 4 samples, level 2 of
+// each group of 16. A chart column spanning N samples is then built from
+// about N/16 level 2 entries plus a few edge entries, never a raw rescan.
+//
+// Memory: each sample costs 2 bytes raw, plus 4 bytes per 4 samples and
+// 4 bytes per 16 samples for the pyramids, 3.25 bytes per channel in total,
+// and 4 bytes for the timestamp. Per minute of history that is
+//     HISTORY_RATE_HZ * 60 * (HISTORY_CHANNEL_COUNT * 3.25 + 4) bytes
+// which is 24.3 KB/min at 20 Hz with the 5 channels below, 121.5 KB for the
+// default 5 minutes. Change HISTORY_SECONDS to trade PSRAM for length.
+
+#define HISTORY_SECONDS     300
+#define HISTORY_RATE_HZ     20      // Expected telemetry frame rate, used for sizing only
+#define HISTORY_L1_FACTOR   4
+#define HISTORY_L2_FACTOR   16
+// Samples the reader keeps away from the write position, so a column being
+// aggregated is not overwritten while it is read
+#define HISTORY_READ_SLACK  HISTORY_RATE_HZ
+
+// Rounded to whole level 2 groups
+#define HISTORY_CAPACITY    ((HISTORY_SECONDS * HISTORY_RATE_HZ / HISTORY_L2_FACTOR) * HISTORY_L2_FACTOR)
+
+typedef enum {
+    HISTORY_CH_SPEED = 0,           // cm/s
+    HISTORY_CH_CURRENT_MOTOR,       // 0.01 A
+    HISTORY_CH_CURRENT_IN,          // 0.01 A
+    HISTORY_CH_TEMP_MOS,            // 0.01 degC
+    HISTORY_CH_TEMP_MOTOR,          // 0.01 degC
+    HISTORY_CHANNEL_COUNT
+} history_channel_t;
+
+esp_err_t history_init(void);
+bool history_is_available(void);
+
+// Total samples written since boot; sample n lives in the ring while
+// n >= count - HISTORY_CAPACITY
+uint32_t history_get_count(void);
+
+// Index of the first sample received at or after time_ms (ms since boot),
+// history_get_count() if there is none yet. Returns false if samples from
+// before time_ms have already been overwritten.
+bool history_find_time(uint32_t time_ms, uint32_t *index);
+
+// Min/max of samples [first, first + span) of one channel. Returns false if
+// part of the range is not (or no longer) in the ring.
+bool history_read_range(history_channel_t channel, uint32_t first, uint32_t span,
+                        int16_t *min_out, int16_t *max_out);
+
+size_t history_get_memory_bytes(void);
+
+#endif // HISTORY_H
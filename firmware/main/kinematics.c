@@ -0,0 +1,101 @@
+#include "kinematics.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "telemetry.h"
+#include "odometer.h"
+
+#define TAG "KINEMATICS"
+
+#define NM_PER_MM       1000000ULL
+#define US_PER_S        1000000ULL
+#define MM_PER_KM       1000000ULL
+#define MM_PER_MILE     1609344ULL
+
+static volatile uint32_t nm_per_erpm_s = 0;
+static volatile uint32_t latest_speed_mm_s = 0;
+
+// Integrator state, only touched from the telemetry callback
+static int64_t last_frame_us = 0;
+static uint32_t last_abs_erpm = 0;
+static uint64_t residual_nm = 0;
+
+// distance_nm = erpm_us * factor / 1e6, split so no intermediate overflows
+// 64 bits for any factor and any gap below KINEMATICS_MAX_FRAME_GAP_MS
+static uint64_t erpm_us_to_nm(uint64_t erpm_us, uint32_t factor)
+{
+    uint64_t whole = erpm_us / US_PER_S;
+    uint64_t frac = erpm_us % US_PER_S;
+    return whole * factor + (frac * factor) / US_PER_S;
+}
+
+static void on_telemetry(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    uint32_t factor = nm_per_erpm_s;
+    uint32_t abs_erpm = snapshot->erpm < 0 ? (uint32_t)-(int64_t)snapshot->erpm : (uint32_t)snapshot->erpm;
+
+    latest_speed_mm_s = (uint32_t)(((uint64_t)abs_erpm * factor) / NM_PER_MM);
+
+    int64_t dt_us = snapshot->rx_time_us - last_frame_us;
+    if (last_frame_us != 0 && dt_us > 0 && dt_us <= (int64_t)KINEMATICS_MAX_FRAME_GAP_MS * 1000) {
+        // Trapezoid between the two frames; sum of the two ERPMs times dt / 2
+        uint64_t erpm_us = ((uint64_t)abs_erpm + last_abs_erpm) * (uint64_t)dt_us / 2;
+        residual_nm += erpm_us_to_nm(erpm_us, factor);
+        if (residual_nm >= NM_PER_MM) {
+            odometer_add_distance_mm((uint32_t)(residual_nm / NM_PER_MM));
+            residual_nm %= NM_PER_MM;
+        }
+    }
+
+    last_frame_us = snapshot->rx_time_us;
+    last_abs_erpm = abs_erpm;
+}
+
+void kinematics_apply_config(const vesc_config_t *config)
+{
+    if (config == NULL || config->motor_poles == 0 || config->wheel_pulley == 0) {
+        nm_per_erpm_s = 0;
+        return;
+    }
+
+    // wheel rpm = erpm / poles * motor_pulley / wheel_pulley
+    // nm per second per erpm = wheel rpm per erpm * pi * diameter / 60
+    const uint64_t pi_1e9 = 3141592654ULL;
+    uint64_t numerator = (uint64_t)config->motor_pulley * config->wheel_diameter_mm * pi_1e9;
+    uint64_t denominator = (uint64_t)config->motor_poles * config->wheel_pulley * 60 * 1000;
+    nm_per_erpm_s = (uint32_t)((numerator + denominator / 2) / denominator);
+
+    ESP_LOGI(TAG, "%lu nm per erpm-second", (uint32_t)nm_per_erpm_s);
+}
+
+esp_err_t kinematics_init(void)
+{
+    vesc_config_t config;
+    esp_err_t err = vesc_config_load(&config);
+    if (err != ESP_OK) {
+        return err;
+    }
+    kinematics_apply_config(&config);
+    return telemetry_register_callback(on_telemetry, NULL);
+}
+
+uint32_t kinematics_get_nm_per_erpm_s(void)
+{
+    return nm_per_erpm_s;
+}
+
+uint32_t kinematics_erpm_to_mm_s(int32_t erpm)
+{
+    uint32_t abs_erpm = erpm < 0 ? (uint32_t)-(int64_t)erpm : (uint32_t)erpm;
+    return (uint32_t)(((uint64_t)abs_erpm * nm_per_erpm_s) / NM_PER_MM);
+}
+
+uint32_t kinematics_get_speed_mm_s(void)
+{
+    return latest_speed_mm_s;
+}
+
+int32_t kinematics_get_speed(bool is_mph)
+{
+    uint64_t mm_per_hour = (uint64_t)latest_speed_mm_s * 3600;
+    return (int32_t)(is_mph ? mm_per_hour / MM_PER_MILE : mm_per_hour / MM_PER_KM);
+}
@@ -0,0 +1,27 @@
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "vesc_config.h"
+
+// Speed and distance from the VESC tachometer. The drivetrain is reduced to
+// one integer factor, nanometres travelled per ERPM per second, which is
+// recomputed only when the VESC configuration changes. Distance is
+// integrated on every telemetry frame from the frame receive timestamps and
+// handed to the odometer in whole millimetres.
+
+// Frames further apart than this are treated as a link gap, not integrated
+#define KINEMATICS_MAX_FRAME_GAP_MS  1000
+
+esp_err_t kinematics_init(void);
+void kinematics_apply_config(const vesc_config_t *config);
+uint32_t kinematics_get_nm_per_erpm_s(void);
+
+uint32_t kinematics_erpm_to_mm_s(int32_t erpm);
+uint32_t kinematics_get_speed_mm_s(void);
+// Whole km/h or mi/h, truncated like the speed display
+int32_t kinematics_get_speed(bool is_mph);
+
+#endif // KINEMATICS_H
@@ -0,0 +1,223 @@
+#include "latency_bench.h"
+#include <stdlib.h>
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "freertos/FreeRTOS.h"
+#include "throttle.h"
+#include "ble_transport.h"
+#include "espnow_link.h"
+
+#define TAG "LATENCY_BENCH"
+
+static portMUX_TYPE bench_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static bool active = false;
+static uint32_t target_steps = 0;
+static uint32_t step_period_us = 0;
+static int32_t level_low = 0;
+static int32_t level_high = 0;
+static int32_t brake_released = 0;
+
+// Generator and measurement state, under bench_lock
+static bool level_is_high = false;
+static int64_t next_step_us = 0;
+static int64_t step_time_us = 0;
+static bool step_pending = false;
+static uint8_t pre_step_value = 0;
+static uint8_t last_written = 0;
+static bool have_written = false;
+static uint32_t steps_done = 0;
+static uint32_t missed = 0;
+static uint32_t measured = 0;
+static bool aborted = false;
+static uint32_t *latencies_us = NULL;
+
+// Half to one and a half periods on, so steps land at any phase of the
+// tasks but never so close that one hides the previous one
+static int64_t schedule_step(int64_t after_us)
+{
+    return after_us + step_period_us / 2 + esp_random() % step_period_us;
+}
+
+// The virtual throttle must never reach a board
+static bool receiver_connected(void)
+{
+    return ble_transport_ready(BLE_LINK_PRIMARY) || espnow_link_active();
+}
+
+static void finish_locked(void)
+{
+    active = false;
+    step_pending = false;
+}
+
+// Advances the generator to now; caller holds bench_lock
+static void advance_locked(int64_t now)
+{
+    if (!active || now < next_step_us) {
+        return;
+    }
+    if (step_pending) {
+        missed++;
+    }
+    if (steps_done >= target_steps) {
+        finish_locked();
+        return;
+    }
+
+    level_is_high = !level_is_high;
+    step_time_us = next_step_us;
+    step_pending = true;
+    pre_step_value = last_written;
+    steps_done++;
+    next_step_us = schedule_step(step_time_us);
+}
+
+bool latency_bench_sample(latency_bench_channel_t channel, int32_t *raw)
+{
+    if (!active) {
+        return false;
+    }
+
+    bool connected = receiver_connected();
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&bench_lock);
+    if (connected && active) {
+        aborted = true;
+        finish_locked();
+    }
+    advance_locked(now);
+    bool running = active;
+    if (running) {
+        *raw = channel == LATENCY_BENCH_BRAKE ? brake_released :
+               (level_is_high ? level_high : level_low);
+    }
+    portEXIT_CRITICAL(&bench_lock);
+    return running;
+}
+
+void latency_bench_on_write(uint8_t value)
+{
+    if (!active) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&bench_lock);
+    if (active && step_pending && have_written &&
+        abs((int)value - (int)pre_step_value) >= LATENCY_BENCH_MOVE_THRESHOLD) {
+        latencies_us[measured++] = (uint32_t)(now - step_time_us);
+        step_pending = false;
+    }
+    last_written = value;
+    have_written = true;
+    portEXIT_CRITICAL(&bench_lock);
+}
+
+esp_err_t latency_bench_start(uint32_t steps, uint32_t period_ms)
+{
+    if (steps == 0 || steps > LATENCY_BENCH_MAX_STEPS ||
+        period_ms < LATENCY_BENCH_MIN_PERIOD_MS || period_ms > LATENCY_BENCH_MAX_PERIOD_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!throttle_is_calibrated()) {
+        ESP_LOGW(TAG, "Throttle not calibrated, the path sends neutral only");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (receiver_connected()) {
+        ESP_LOGW(TAG, "Receiver connected, the steps would drive the board");
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (latencies_us == NULL) {
+        latencies_us = malloc(LATENCY_BENCH_MAX_STEPS * sizeof(uint32_t));
+        if (latencies_us == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    uint32_t min_val = 0, max_val = 0;
+    throttle_get_calibration_values(&min_val, &max_val);
+
+    portENTER_CRITICAL(&bench_lock);
+    level_low = (int32_t)min_val;
+    level_high = (int32_t)max_val;
+#ifdef CONFIG_TARGET_DUAL_THROTTLE
+    brake_get_calibration_values(&min_val, &max_val);
+    brake_released = (int32_t)max_val;
+#endif
+    target_steps = steps;
+    step_period_us = period_ms * 1000;
+    level_is_high = false;
+    step_pending = false;
+    have_written = false;
+    steps_done = 0;
+    missed = 0;
+    measured = 0;
+    aborted = false;
+    // First period settles the path on the low level
+    next_step_us = schedule_step(esp_timer_get_time());
+    active = true;
+    portEXIT_CRITICAL(&bench_lock);
+
+    ESP_LOGI(TAG, "Started: %lu steps, %lu ms period", steps, period_ms);
+    return ESP_OK;
+}
+
+void latency_bench_stop(void)
+{
+    portENTER_CRITICAL(&bench_lock);
+    finish_locked();
+    portEXIT_CRITICAL(&bench_lock);
+}
+
+bool latency_bench_is_active(void)
+{
+    if (active) {
+        // Nobody may be sampling (ADC task stalled), time the run out here too
+        portENTER_CRITICAL(&bench_lock);
+        advance_locked(esp_timer_get_time());
+        portEXIT_CRITICAL(&bench_lock);
+    }
+    return active;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+void latency_bench_get_result(latency_bench_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+
+    portENTER_CRITICAL(&bench_lock);
+    result->active = active;
+    result->steps = target_steps;
+    result->period_ms = step_period_us / 1000;
+    result->measured = measured;
+    result->missed = missed;
+    result->aborted = aborted;
+    portEXIT_CRITICAL(&bench_lock);
+
+    if (result->active || result->measured == 0) {
+        return;
+    }
+
+    // The run is over, nothing writes the samples any more
+    qsort(latencies_us, measured, sizeof(uint32_t), compare_u32);
+    result->min_us = latencies_us[0];
+    result->p50_us = latencies_us[measured / 2];
+    result->p99_us = latencies_us[(measured * 99) / 100];
+    result->max_us = latencies_us[measured - 1];
+    for (uint32_t i = 0; i < measured; i++) {
+        uint32_t bucket = latencies_us[i] / (LATENCY_BENCH_BUCKET_MS * 1000);
+        result->histogram[bucket < LATENCY_BENCH_BUCKETS ? bucket : LATENCY_BENCH_BUCKETS - 1]++;
+    }
+}
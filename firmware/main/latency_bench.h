@@ -0,0 +1,58 @@
+#ifndef LATENCY_BENCH_H
+#define LATENCY_BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Input-to-air latency of the throttle path, measured on the device.
+//
+// While a run is active the ADC reads in throttle.c return a virtual
+// signal instead of the pin: the throttle steps between its calibrated
+// minimum and maximum, each step half to one and a half periods after the
+// previous one so it lands at a random phase of the ADC and send tasks. The
+// brake (dual throttle) stays released. adc_send_task reports every value it is about
+// to write; the first write that has moved away from the pre-step value
+// closes the step with the time since the step. The radio itself is not
+// included: a run only starts while no receiver is connected over BLE or
+// ESP-NOW and is aborted if one connects, so the steps never drive a board.
+
+#define LATENCY_BENCH_MAX_STEPS         500
+#define LATENCY_BENCH_DEFAULT_STEPS     100
+#define LATENCY_BENCH_DEFAULT_PERIOD_MS 250
+#define LATENCY_BENCH_MIN_PERIOD_MS     200     // Half of it must exceed one ADC plus one send period
+#define LATENCY_BENCH_MAX_PERIOD_MS     5000
+#define LATENCY_BENCH_MOVE_THRESHOLD    32      // Output counts a write must move to count
+#define LATENCY_BENCH_BUCKET_MS         10      // Histogram bucket width
+#define LATENCY_BENCH_BUCKETS           12      // Last bucket collects everything above
+
+typedef enum {
+    LATENCY_BENCH_THROTTLE = 0,
+    LATENCY_BENCH_BRAKE,
+} latency_bench_channel_t;
+
+typedef struct {
+    bool active;
+    uint32_t steps;                 // Requested
+    uint32_t period_ms;
+    uint32_t measured;              // Steps that reached a write
+    uint32_t missed;                // Steps superseded before any write moved
+    bool aborted;                   // A receiver connected during the run
+    uint32_t min_us;
+    uint32_t p50_us;
+    uint32_t p99_us;
+    uint32_t max_us;
+    uint32_t histogram[LATENCY_BENCH_BUCKETS];
+} latency_bench_result_t;
+
+esp_err_t latency_bench_start(uint32_t steps, uint32_t period_ms);
+void latency_bench_stop(void);
+bool latency_bench_is_active(void);
+void latency_bench_get_result(latency_bench_result_t *result);
+
+// ADC hook: true and *raw set while a run replaces the pin
+bool latency_bench_sample(latency_bench_channel_t channel, int32_t *raw);
+// Send hook, called with every value just before it is written
+void latency_bench_on_write(uint8_t value);
+
+#endif // LATENCY_BENCH_H
@@ -13,6 +13,7 @@
 #include "ui_updater.h"
 #include "battery.h"
 #include "esp_task_wdt.h"
+#include "glass_trace.h"
 
 // Backlight LEDC configuration
 #define LEDC_TIMER              LEDC_TIMER_0
@@ -33,6 +34,7 @@ static esp_timer_handle_t periodic_timer;
 #define LVGL_UPDATE_MS         10
 
 static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map);
+static bool flush_done_cb(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx);
 static void lv_tick_task(void *arg);
 static void lvgl_handler_task(void *pvParameters);
 
@@ -56,6 +58,9 @@ void lcd_init(void) {
         .trans_queue_depth = 10,
         .lcd_cmd_bits = 8,
         .lcd_param_bits = 8,
+        // The buffer is handed back to LVGL once it is on the panel
+        .on_color_trans_done = flush_done_cb,
+        .user_ctx = &disp_drv,
     };
 
     esp_lcd_panel_io_handle_t io_handle;
@@ -132,8 +137,15 @@ void lcd_init(void) {
 }
 
 static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map) {
+    glass_trace_flush(area, lv_disp_flush_is_last(drv));
     esp_lcd_panel_draw_bitmap(panel_handle, area->x1, area->y1, area->x2 + 1, area->y2 + 1, color_map);
-    lv_disp_flush_ready(drv);
+}
+
+// SPI transfer of one flushed stripe finished, interrupt context
+static bool flush_done_cb(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t *edata, void *user_ctx) {
+    glass_trace_flush_done();
+    lv_disp_flush_ready((lv_disp_drv_t *)user_ctx);
+    return false;
 }
 
 static void lv_tick_task(void *arg) {
@@ -0,0 +1,390 @@
+#include "link_quality.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_bt.h"
+#include "freertos/FreeRTOS.h"
+#include "viber.h"
+
+#define TAG "LINK_QUALITY"
+
+typedef struct {
+    bool connected;
+    bool rssi_seen;
+    int32_t rssi_x16;               // Filtered dBm * 16
+    uint32_t period_us;
+    uint32_t seed_count;
+    uint64_t seed_sum_us;
+    int64_t last_rx_us;
+    uint32_t silence_counted;       // Lost notifies already counted for the open gap
+    int32_t loss_x10;               // Filtered, 0.1 %
+    int32_t fail_x10;
+    uint8_t score;
+
+    // Since the last update
+    uint32_t window_rx;
+    uint32_t window_lost;
+    uint32_t window_writes;
+    uint32_t window_failed;
+
+    // Since the last connect
+    uint32_t notifies;
+    uint32_t lost;
+    uint32_t writes;
+    uint32_t failed;
+} link_state_t;
+
+typedef struct {
+    link_quality_callback_t callback;
+    void *user_data;
+} listener_t;
+
+// Levels ESP_PWR_LVL_N24 to ESP_PWR_LVL_P20 in dBm
+static const int8_t level_dbm[] = { -24, -21, -18, -15, -12, -9, -6, -3, 0, 3, 6, 9, 12, 15, 18, 20 };
+
+static portMUX_TYPE quality_lock = portMUX_INITIALIZER_UNLOCKED;
+static link_state_t links[BLE_MAX_LINKS];
+
+// Only touched from link_quality_update
+static link_quality_state_t primary_state = LINK_QUALITY_GOOD;
+static esp_power_level_t tx_level[BLE_MAX_LINKS];
+static int tx_handle[BLE_MAX_LINKS] = { -1, -1, -1 };   // Connection tx_level applies to
+static uint32_t strong_seconds[BLE_MAX_LINKS];
+static listener_t listeners[LINK_QUALITY_MAX_CALLBACKS];
+static uint8_t listener_count = 0;
+
+void link_quality_on_connected(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return;
+    }
+    portENTER_CRITICAL(&quality_lock);
+    memset(&links[link], 0, sizeof(links[link]));
+    links[link].connected = true;
+    portEXIT_CRITICAL(&quality_lock);
+}
+
+void link_quality_on_disconnected(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return;
+    }
+    portENTER_CRITICAL(&quality_lock);
+    links[link].connected = false;
+    portEXIT_CRITICAL(&quality_lock);
+}
+
+void link_quality_on_notify(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&quality_lock);
+    link_state_t *l = &links[link];
+    if (l->last_rx_us != 0) {
+        uint32_t gap_us = (uint32_t)(now - l->last_rx_us);
+        if (l->period_us == 0) {
+            // Learn the period before counting anything as lost
+            l->seed_sum_us += gap_us;
+            if (++l->seed_count >= LINK_QUALITY_PERIOD_SEED) {
+                l->period_us = (uint32_t)(l->seed_sum_us / l->seed_count);
+            }
+        } else if (gap_us < l->period_us + l->period_us / 2) {
+            l->period_us += ((int32_t)gap_us - (int32_t)l->period_us) >> LINK_QUALITY_PERIOD_SHIFT;
+        } else {
+            uint32_t periods = (gap_us + l->period_us / 2) / l->period_us;
+            if (periods > LINK_QUALITY_MAX_GAP_PERIODS) {
+                periods = LINK_QUALITY_MAX_GAP_PERIODS;
+            }
+            if (periods - 1 > l->silence_counted) {
+                uint32_t missing = periods - 1 - l->silence_counted;
+                l->window_lost += missing;
+                l->lost += missing;
+            }
+        }
+    }
+    l->last_rx_us = now;
+    l->silence_counted = 0;
+    l->window_rx++;
+    l->notifies++;
+    portEXIT_CRITICAL(&quality_lock);
+}
+
+void link_quality_on_rssi(ble_link_t link, int rssi)
+{
+    // 0 and above means no reading
+    if (link >= BLE_MAX_LINKS || rssi >= 0) {
+        return;
+    }
+    portENTER_CRITICAL(&quality_lock);
+    link_state_t *l = &links[link];
+    if (!l->rssi_seen) {
+        l->rssi_x16 = rssi * 16;
+        l->rssi_seen = true;
+    } else {
+        l->rssi_x16 += (rssi * 16 - l->rssi_x16) >> LINK_QUALITY_RSSI_SHIFT;
+    }
+    portEXIT_CRITICAL(&quality_lock);
+}
+
+void link_quality_on_write(ble_link_t link, bool ok)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return;
+    }
+    portENTER_CRITICAL(&quality_lock);
+    link_state_t *l = &links[link];
+    l->window_writes++;
+    l->writes++;
+    if (!ok) {
+        l->window_failed++;
+        l->failed++;
+    }
+    portEXIT_CRITICAL(&quality_lock);
+}
+
+static int32_t filter_ratio(int32_t filtered, uint32_t part, uint32_t total)
+{
+    if (total == 0) {
+        return filtered;
+    }
+    int32_t sample = (int32_t)((uint64_t)part * 1000 / total);
+    return filtered + ((sample - filtered) >> LINK_QUALITY_RATIO_SHIFT);
+}
+
+static uint8_t compute_score(const link_state_t *l)
+{
+    if (!l->rssi_seen) {
+        return 0;
+    }
+    int32_t rssi = l->rssi_x16 / 16;
+    int32_t score = (rssi + 100) * 100 / 70;
+    score -= (l->loss_x10 * LINK_QUALITY_LOSS_WEIGHT + l->fail_x10 * LINK_QUALITY_FAIL_WEIGHT) / 10;
+    if (score < 0) {
+        score = 0;
+    } else if (score > 100) {
+        score = 100;
+    }
+    return (uint8_t)score;
+}
+
+// Counts the notifies a silent link has missed so far
+static void count_silence(link_state_t *l, int64_t now)
+{
+    if (l->period_us == 0 || l->last_rx_us == 0) {
+        return;
+    }
+    uint32_t periods = (uint32_t)((now - l->last_rx_us) / l->period_us);
+    if (periods > LINK_QUALITY_MAX_GAP_PERIODS) {
+        periods = LINK_QUALITY_MAX_GAP_PERIODS;
+    }
+    if (periods >= 2 && periods - 1 > l->silence_counted) {
+        uint32_t missing = periods - 1 - l->silence_counted;
+        l->window_lost += missing;
+        l->lost += missing;
+        l->silence_counted = periods - 1;
+    }
+}
+
+static link_quality_state_t next_state(link_quality_state_t state, uint8_t score)
+{
+    switch (state) {
+        case LINK_QUALITY_GOOD:
+            if (score < LINK_QUALITY_CRITICAL_ENTER) return LINK_QUALITY_CRITICAL;
+            if (score < LINK_QUALITY_DEGRADED_ENTER) return LINK_QUALITY_DEGRADED;
+            return state;
+        case LINK_QUALITY_DEGRADED:
+            if (score < LINK_QUALITY_CRITICAL_ENTER) return LINK_QUALITY_CRITICAL;
+            if (score >= LINK_QUALITY_DEGRADED_EXIT) return LINK_QUALITY_GOOD;
+            return state;
+        case LINK_QUALITY_CRITICAL:
+        default:
+            if (score >= LINK_QUALITY_DEGRADED_EXIT) return LINK_QUALITY_GOOD;
+            if (score >= LINK_QUALITY_CRITICAL_EXIT) return LINK_QUALITY_DEGRADED;
+            return state;
+    }
+}
+
+static bool set_tx_level(ble_link_t link, int handle, esp_power_level_t level)
+{
+    if (handle > ESP_BLE_PWR_TYPE_CONN_HDL8 - ESP_BLE_PWR_TYPE_CONN_HDL0) {
+        return false;
+    }
+    esp_err_t ret = esp_ble_tx_power_set((esp_ble_power_type_t)(ESP_BLE_PWR_TYPE_CONN_HDL0 + handle), level);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "Setting link %d TX power to %d dBm failed: %s", link, level_dbm[level], esp_err_to_name(ret));
+        return false;
+    }
+    if (level != tx_level[link]) {
+        ESP_LOGI(TAG, "Link %d TX power %d -> %d dBm", link, level_dbm[tx_level[link]], level_dbm[level]);
+    }
+    tx_level[link] = level;
+    return true;
+}
+
+static void steer_tx_power(ble_link_t link, bool connected, bool rssi_seen, uint8_t score, bool critical)
+{
+    int handle = connected ? ble_transport_conn_handle(link) : -1;
+    if (handle < 0) {
+        tx_handle[link] = -1;
+        return;
+    }
+    if (handle != tx_handle[link]) {
+        // New connection, the handle may still carry the power of an old one
+        strong_seconds[link] = 0;
+        tx_level[link] = LINK_QUALITY_TX_DEFAULT_LEVEL;
+        if (!set_tx_level(link, handle, LINK_QUALITY_TX_DEFAULT_LEVEL)) {
+            return;
+        }
+        tx_handle[link] = handle;
+    }
+    if (!rssi_seen) {
+        return;
+    }
+
+    esp_power_level_t level = tx_level[link];
+    if (critical) {
+        strong_seconds[link] = 0;
+        level = LINK_QUALITY_TX_MAX_LEVEL;
+    } else if (score < LINK_QUALITY_TX_RAISE_BELOW) {
+        strong_seconds[link] = 0;
+        if (level < LINK_QUALITY_TX_MAX_LEVEL) {
+            level++;
+        }
+    } else if (score > LINK_QUALITY_TX_LOWER_ABOVE) {
+        if (++strong_seconds[link] >= LINK_QUALITY_TX_LOWER_HOLD_S && level > LINK_QUALITY_TX_MIN_LEVEL) {
+            strong_seconds[link] = 0;
+            level--;
+        }
+    } else {
+        strong_seconds[link] = 0;
+    }
+    if (level != tx_level[link]) {
+        set_tx_level(link, handle, level);
+    }
+}
+
+void link_quality_update(void)
+{
+    int64_t now = esp_timer_get_time();
+    bool primary_up;
+    bool connected[BLE_MAX_LINKS];
+    bool rssi_seen[BLE_MAX_LINKS];
+    uint8_t scores[BLE_MAX_LINKS];
+    link_quality_event_t event;
+
+    portENTER_CRITICAL(&quality_lock);
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        link_state_t *l = &links[i];
+        connected[i] = l->connected;
+        rssi_seen[i] = l->rssi_seen;
+        if (!l->connected) {
+            l->score = 0;
+            scores[i] = 0;
+            continue;
+        }
+        count_silence(l, now);
+        l->loss_x10 = filter_ratio(l->loss_x10, l->window_lost, l->window_rx + l->window_lost);
+        l->fail_x10 = filter_ratio(l->fail_x10, l->window_failed, l->window_writes);
+        l->window_rx = 0;
+        l->window_lost = 0;
+        l->window_writes = 0;
+        l->window_failed = 0;
+        l->score = compute_score(l);
+        scores[i] = l->score;
+    }
+    const link_state_t *primary = &links[BLE_LINK_PRIMARY];
+    primary_up = primary->connected;
+    event.previous = primary_state;
+    event.score = primary->score;
+    event.rssi = primary->rssi_x16 / 16;
+    if (!primary_up) {
+        event.state = LINK_QUALITY_GOOD;
+    } else if (primary->rssi_seen) {
+        event.state = next_state(primary_state, primary->score);
+    } else {
+        event.state = primary_state;
+    }
+    portEXIT_CRITICAL(&quality_lock);
+
+    primary_state = event.state;
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        bool critical = i == BLE_LINK_PRIMARY ? primary_state == LINK_QUALITY_CRITICAL :
+                        scores[i] < LINK_QUALITY_CRITICAL_ENTER;
+        steer_tx_power((ble_link_t)i, connected[i], rssi_seen[i], scores[i], critical);
+    }
+
+    if (event.state == event.previous) {
+        return;
+    }
+    ESP_LOGW(TAG, "Primary link %s -> %s, score %u, RSSI %d dBm", link_quality_state_name(event.previous),
+             link_quality_state_name(event.state), event.score, event.rssi);
+    if (primary_up && event.state > event.previous) {
+        viber_play_pattern(event.state == LINK_QUALITY_CRITICAL ? VIBER_PATTERN_ALERT : VIBER_PATTERN_DOUBLE_SHORT);
+    }
+    for (uint8_t i = 0; i < listener_count; i++) {
+        listeners[i].callback(&event, listeners[i].user_data);
+    }
+}
+
+esp_err_t link_quality_register_callback(link_quality_callback_t callback, void *user_data)
+{
+    if (callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (listener_count >= LINK_QUALITY_MAX_CALLBACKS) {
+        ESP_LOGE(TAG, "Too many link quality callbacks");
+        return ESP_ERR_NO_MEM;
+    }
+    listeners[listener_count].callback = callback;
+    listeners[listener_count].user_data = user_data;
+    listener_count++;
+    return ESP_OK;
+}
+
+void link_quality_get_stats(ble_link_t link, link_quality_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    if (link >= BLE_MAX_LINKS) {
+        return;
+    }
+    portENTER_CRITICAL(&quality_lock);
+    const link_state_t *l = &links[link];
+    stats->connected = l->connected;
+    stats->state = link == BLE_LINK_PRIMARY ? primary_state : LINK_QUALITY_GOOD;
+    stats->score = l->score;
+    stats->rssi = l->rssi_seen ? l->rssi_x16 / 16 : 0;
+    stats->period_us = l->period_us;
+    stats->loss_pct_x10 = (uint16_t)l->loss_x10;
+    stats->fail_pct_x10 = (uint16_t)l->fail_x10;
+    stats->notifies = l->notifies;
+    stats->lost = l->lost;
+    stats->writes = l->writes;
+    stats->failed = l->failed;
+    portEXIT_CRITICAL(&quality_lock);
+}
+
+uint8_t link_quality_score(ble_link_t link)
+{
+    return link < BLE_MAX_LINKS ? links[link].score : 0;
+}
+
+int link_quality_tx_power_dbm(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS || tx_handle[link] < 0) {
+        return level_dbm[LINK_QUALITY_TX_DEFAULT_LEVEL];
+    }
+    return level_dbm[tx_level[link]];
+}
+
+const char *link_quality_state_name(link_quality_state_t state)
+{
+    switch (state) {
+        case LINK_QUALITY_GOOD:     return "good";
+        case LINK_QUALITY_DEGRADED: return "degraded";
+        case LINK_QUALITY_CRITICAL: return "critical";
+        default:                    return "unknown";
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef LINK_QUALITY_H
+#define LINK_QUALITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "ble_transport.h"
+
+// One 0-100 quality score per BLE link, from three signals:
+//
+//   RSSI      the once-a-second reading, filtered. Mapped to 0-100 the way
+//             the connection icon always did, -100 dBm to -30 dBm.
+//   Loss      telemetry notifies that never arrived. Frames carry no
+//             sequence number, so each link learns its notify period from
+//             the arrival gaps and counts a gap of n periods as n - 1
+//             lost notifies. Silence while connected counts as it builds
+//             up, before the next notify closes the gap.
+//   Writes    throttle writes the host refused, which is how a full
+//             controller queue (congestion) shows up on both hosts.
+//
+// Loss and failed writes are filtered percentages. Each lost percent takes
+// LINK_QUALITY_LOSS_WEIGHT points off the RSSI score, each failed percent
+// LINK_QUALITY_FAIL_WEIGHT.
+//
+// link_quality_update() runs once a second from the link stats task. It
+// moves the primary link between good, degraded and critical with enter and
+// exit thresholds, plays a haptic pattern on the way down and calls the
+// registered listeners, so the rider hears about a weak link before the
+// supervision timeout drops it.
+//
+// The same update steers the TX power of each connection from its own
+// score: up a step every second while it is under
+// LINK_QUALITY_TX_RAISE_BELOW, which sits above the degraded threshold, and
+// down a step only after LINK_QUALITY_TX_LOWER_HOLD_S seconds above
+// LINK_QUALITY_TX_LOWER_ABOVE. A critical link goes straight to the
+// maximum. The controller keeps the power per connection handle, so a
+// close BMS does not pay for a far primary. A new connection starts at the
+// default, whatever the previous owner of its handle was set to.
+
+#define LINK_QUALITY_RSSI_SHIFT         2       // alpha = 1/4 per reading
+#define LINK_QUALITY_PERIOD_SHIFT       4       // alpha = 1/16 per notify
+#define LINK_QUALITY_RATIO_SHIFT        2       // alpha = 1/4 per second
+#define LINK_QUALITY_PERIOD_SEED        8       // Notifies that only learn the period
+#define LINK_QUALITY_MAX_GAP_PERIODS    50      // Longer gaps count as this many
+#define LINK_QUALITY_LOSS_WEIGHT        2
+#define LINK_QUALITY_FAIL_WEIGHT        2
+
+#define LINK_QUALITY_DEGRADED_ENTER     25
+#define LINK_QUALITY_DEGRADED_EXIT      32
+#define LINK_QUALITY_CRITICAL_ENTER     12
+#define LINK_QUALITY_CRITICAL_EXIT      18
+
+#define LINK_QUALITY_TX_RAISE_BELOW     40
+#define LINK_QUALITY_TX_LOWER_ABOVE     70
+#define LINK_QUALITY_TX_LOWER_HOLD_S    10
+#define LINK_QUALITY_TX_MIN_LEVEL       ESP_PWR_LVL_N0      // 0 dBm
+#define LINK_QUALITY_TX_DEFAULT_LEVEL   ESP_PWR_LVL_P9      // Controller default
+#define LINK_QUALITY_TX_MAX_LEVEL       ESP_PWR_LVL_P18
+
+#define LINK_QUALITY_MAX_CALLBACKS      4
+
+typedef enum {
+    LINK_QUALITY_GOOD = 0,
+    LINK_QUALITY_DEGRADED,
+    LINK_QUALITY_CRITICAL,
+} link_quality_state_t;
+
+typedef struct {
+    link_quality_state_t state;
+    link_quality_state_t previous;
+    uint8_t score;
+    int rssi;                       // Filtered, dBm
+} link_quality_event_t;
+
+typedef struct {
+    bool connected;
+    link_quality_state_t state;     // Tracked for the primary link only
+    uint8_t score;
+    int rssi;                       // Filtered, 0 before the first reading
+    uint32_t period_us;             // Learned notify period, 0 while seeding
+    uint16_t loss_pct_x10;          // Filtered
+    uint16_t fail_pct_x10;
+    uint32_t notifies;              // Since the last connect
+    uint32_t lost;
+    uint32_t writes;
+    uint32_t failed;
+} link_quality_stats_t;
+
+typedef void (*link_quality_callback_t)(const link_quality_event_t *event, void *user_data);
+
+// Feeds, callable from the Bluetooth host task
+void link_quality_on_connected(ble_link_t link);
+void link_quality_on_disconnected(ble_link_t link);
+void link_quality_on_notify(ble_link_t link);
+void link_quality_on_rssi(ble_link_t link, int rssi);
+void link_quality_on_write(ble_link_t link, bool ok);
+
+// Once a second, never from the Bluetooth host task
+void link_quality_update(void);
+
+esp_err_t link_quality_register_callback(link_quality_callback_t callback, void *user_data);
+void link_quality_get_stats(ble_link_t link, link_quality_stats_t *stats);
+uint8_t link_quality_score(ble_link_t link);
+// TX power of the link's connection in dBm, the default while it is down
+int link_quality_tx_power_dbm(ble_link_t link);
+const char *link_quality_state_name(link_quality_state_t state);
+
+#endif // LINK_QUALITY_H
@@ -0,0 +1,318 @@
+#include "lvgl_heap.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "multi_heap.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#define TAG "LVGL_HEAP"
+
+#define INTERNAL_CAPS   (MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT)
+#define PSRAM_CAPS      (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+
+#if CONFIG_LVGL_HEAP_MODE_PSRAM
+#define HEAP_MODE       LVGL_HEAP_MODE_PSRAM
+#elif CONFIG_LVGL_HEAP_MODE_SPLIT
+#define HEAP_MODE       LVGL_HEAP_MODE_SPLIT
+#else
+#define HEAP_MODE       LVGL_HEAP_MODE_INTERNAL
+#endif
+
+typedef struct {
+    const char *name;
+    bool psram;
+    multi_heap_handle_t heap;
+    uint8_t *start;
+    size_t size;
+} heap_pool_t;
+
+// In split mode pools[0] takes small requests and pools[1] large ones
+static heap_pool_t pools[LVGL_HEAP_MAX_POOLS];
+static uint8_t pool_count = 0;
+static lvgl_slab_t slab;
+static bool slab_ready = false;
+static bool slab_psram = false;
+static bool initialized = false;
+static bool init_failed = false;        // No pool; not tried again
+
+// pool_lock is handed to multi_heap, stats_lock covers the slab and counters
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t allocs = 0;
+static uint32_t frees = 0;
+static uint32_t reallocs = 0;
+static uint32_t slab_allocs = 0;
+static uint32_t spilled = 0;
+static uint32_t failed = 0;
+static int64_t window_start_us = 0;
+static uint32_t window_allocs = 0;
+static uint32_t allocs_per_s = 0;
+
+// Placement of the block, falling back to internal RAM without PSRAM
+static void *take_block(size_t size, bool psram, bool *placed_psram)
+{
+    void *block = NULL;
+    if (psram) {
+        block = heap_caps_malloc(size, PSRAM_CAPS);
+        if (block == NULL) {
+            ESP_LOGW(TAG, "No %u bytes of PSRAM, using internal RAM", size);
+        }
+    }
+    if (block == NULL) {
+        block = heap_caps_malloc(size, INTERNAL_CAPS);
+        psram = false;
+    }
+    *placed_psram = psram;
+    return block;
+}
+
+static void add_pool(const char *name, size_t size, bool psram)
+{
+    heap_pool_t *pool = &pools[pool_count];
+    pool->start = take_block(size, psram, &pool->psram);
+    if (pool->start == NULL) {
+        ESP_LOGE(TAG, "No memory for the %s pool (%u bytes)", name, size);
+        return;
+    }
+
+    pool->heap = multi_heap_register(pool->start, size);
+    if (pool->heap == NULL) {
+        heap_caps_free(pool->start);
+        ESP_LOGE(TAG, "Could not register the %s pool", name);
+        return;
+    }
+    multi_heap_set_lock(pool->heap, &pool_lock);
+    pool->name = name;
+    pool->size = size;
+    pool_count++;
+}
+
+// Runs on the first allocation, from lv_init, and only once: without a
+// pool the heap stays failed
+static bool heap_init(void)
+{
+    bool small_psram = HEAP_MODE == LVGL_HEAP_MODE_PSRAM;
+
+    void *slab_buffer = take_block(lvgl_slab_required_size(), small_psram, &slab_psram);
+    if (slab_buffer != NULL) {
+        lvgl_slab_init(&slab, slab_buffer);
+        slab_ready = true;
+    }
+
+    if (HEAP_MODE == LVGL_HEAP_MODE_PSRAM) {
+        add_pool("psram", CONFIG_LVGL_HEAP_PSRAM_KB * 1024, true);
+    } else {
+        add_pool("internal", CONFIG_LVGL_HEAP_INTERNAL_KB * 1024, false);
+    }
+#if CONFIG_LVGL_HEAP_MODE_SPLIT
+    add_pool("psram", CONFIG_LVGL_HEAP_PSRAM_KB * 1024, true);
+#endif
+
+    initialized = pool_count > 0;
+    if (!initialized) {
+        // The slab is of no use without a pool behind it
+        if (slab_ready) {
+            heap_caps_free(slab_buffer);
+            slab_ready = false;
+        }
+        init_failed = true;
+        ESP_LOGE(TAG, "No LVGL pool, every allocation will fail");
+        return false;
+    }
+    ESP_LOGI(TAG, "%s mode, %u pools, %u byte slab in %s", lvgl_heap_mode_name(HEAP_MODE), pool_count,
+             slab_ready ? lvgl_slab_required_size() : 0, slab_psram ? "PSRAM" : "internal RAM");
+    return initialized;
+}
+
+static heap_pool_t *pool_of(const void *ptr)
+{
+    const uint8_t *p = ptr;
+    for (uint8_t i = 0; i < pool_count; i++) {
+        if (p >= pools[i].start && p < pools[i].start + pools[i].size) {
+            return &pools[i];
+        }
+    }
+    return NULL;
+}
+
+// Small requests to the first pool, large ones to the last, either way
+// the other one when that is full
+static void *pool_alloc(size_t size, bool *spill)
+{
+    uint8_t first = size >= CONFIG_LVGL_HEAP_SPLIT_THRESHOLD ? pool_count - 1 : 0;
+    void *ptr = multi_heap_malloc(pools[first].heap, size);
+    *spill = false;
+    if (ptr == NULL && pool_count > 1) {
+        ptr = multi_heap_malloc(pools[1 - first].heap, size);
+        *spill = ptr != NULL;
+    }
+    return ptr;
+}
+
+static void count_alloc(bool ok, bool from_slab, bool spill)
+{
+    int64_t now = esp_timer_get_time();
+
+    portENTER_CRITICAL(&stats_lock);
+    if (!ok) {
+        failed++;
+    } else {
+        allocs++;
+        slab_allocs += from_slab;
+        spilled += spill;
+    }
+    if (now - window_start_us >= LVGL_HEAP_RATE_WINDOW_US) {
+        allocs_per_s = (uint32_t)((uint64_t)window_allocs * 1000000 / (uint64_t)(now - window_start_us));
+        window_start_us = now;
+        window_allocs = 0;
+    }
+    window_allocs += ok;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void *lvgl_heap_alloc(size_t size)
+{
+    if (!initialized && (init_failed || !heap_init())) {
+        count_alloc(false, false, false);
+        return NULL;
+    }
+
+    void *ptr = NULL;
+    bool spill = false;
+    if (slab_ready && size <= LVGL_SLAB_MAX_SIZE) {
+        portENTER_CRITICAL(&stats_lock);
+        ptr = lvgl_slab_alloc(&slab, size);
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    bool from_slab = ptr != NULL;
+    if (ptr == NULL) {
+        ptr = pool_alloc(size, &spill);
+    }
+
+    count_alloc(ptr != NULL, from_slab, spill);
+    return ptr;
+}
+
+void lvgl_heap_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (slab_ready && lvgl_slab_owns(&slab, ptr)) {
+        portENTER_CRITICAL(&stats_lock);
+        lvgl_slab_free(&slab, ptr);
+        frees++;
+        portEXIT_CRITICAL(&stats_lock);
+        return;
+    }
+
+    heap_pool_t *pool = pool_of(ptr);
+    if (pool == NULL) {
+        ESP_LOGE(TAG, "Free of %p, not from an LVGL pool", ptr);
+        return;
+    }
+    multi_heap_free(pool->heap, ptr);
+    portENTER_CRITICAL(&stats_lock);
+    frees++;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void *lvgl_heap_realloc(void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return lvgl_heap_alloc(size);
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    reallocs++;
+    portEXIT_CRITICAL(&stats_lock);
+
+    size_t old_size;
+    if (slab_ready && lvgl_slab_owns(&slab, ptr)) {
+        old_size = lvgl_slab_block_size(&slab, ptr);
+        // Label text changing length by a digit stays where it is
+        if (size <= old_size) {
+            return ptr;
+        }
+    } else {
+        heap_pool_t *pool = pool_of(ptr);
+        if (pool == NULL) {
+            ESP_LOGE(TAG, "Realloc of %p, not from an LVGL pool", ptr);
+            return NULL;
+        }
+        old_size = multi_heap_get_allocated_size(pool->heap, ptr);
+        bool stays = size > LVGL_SLAB_MAX_SIZE || !slab_ready;
+        if (stays && pool == &pools[size >= CONFIG_LVGL_HEAP_SPLIT_THRESHOLD ? pool_count - 1 : 0]) {
+            void *resized = multi_heap_realloc(pool->heap, ptr, size);
+            if (resized != NULL) {
+                return resized;
+            }
+        }
+    }
+
+    void *moved = lvgl_heap_alloc(size);
+    if (moved != NULL) {
+        memcpy(moved, ptr, old_size < size ? old_size : size);
+        lvgl_heap_free(ptr);
+    }
+    return moved;
+}
+
+void lvgl_heap_get_stats(lvgl_heap_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->mode = HEAP_MODE;
+    stats->pool_count = pool_count;
+
+    for (uint8_t i = 0; i < pool_count; i++) {
+        multi_heap_info_t info;
+        multi_heap_get_info(pools[i].heap, &info);
+        lvgl_heap_pool_stats_t *out = &stats->pools[i];
+        out->name = pools[i].name;
+        out->psram = pools[i].psram;
+        out->size = pools[i].size;
+        out->free = info.total_free_bytes;
+        out->min_free = info.minimum_free_bytes;
+        out->largest_free = info.largest_free_block;
+        out->fragmentation_pct = info.total_free_bytes == 0 ? 0 :
+            (uint8_t)(100 - info.largest_free_block * 100 / info.total_free_bytes);
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_lock);
+    stats->slab_psram = slab_psram;
+    for (int i = 0; slab_ready && i < LVGL_SLAB_CLASS_COUNT; i++) {
+        const lvgl_slab_class_t *cls = &slab.classes[i];
+        stats->slab[i].block_size = cls->block_size;
+        stats->slab[i].blocks = cls->blocks;
+        stats->slab[i].used = cls->used;
+        stats->slab[i].peak = cls->peak;
+        stats->slab[i].full = cls->full;
+    }
+    stats->allocs = allocs;
+    stats->frees = frees;
+    stats->reallocs = reallocs;
+    stats->slab_allocs = slab_allocs;
+    stats->spilled = spilled;
+    stats->failed = failed;
+    stats->allocs_per_s = allocs_per_s;
+    // No allocation has closed the window since, so it is the better figure
+    if (now - window_start_us >= LVGL_HEAP_RATE_WINDOW_US) {
+        stats->allocs_per_s = (uint32_t)((uint64_t)window_allocs * 1000000 / (uint64_t)(now - window_start_us));
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+const char *lvgl_heap_mode_name(lvgl_heap_mode_t mode)
+{
+    switch (mode) {
+        case LVGL_HEAP_MODE_INTERNAL: return "internal";
+        case LVGL_HEAP_MODE_PSRAM:    return "psram";
+        case LVGL_HEAP_MODE_SPLIT:    return "split";
+        default:                      return "unknown";
+    }
+}
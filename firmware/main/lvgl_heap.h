@@ -0,0 +1,85 @@
+#ifndef LVGL_HEAP_H
+#define LVGL_HEAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "lvgl_slab.h"
+
+// LVGL's allocator, on pools of its own instead of the built-in lv_mem.
+//
+// LVGL includes this header through CONFIG_LV_MEM_CUSTOM_INCLUDE and calls
+// the functions below for every lv_mem_alloc, lv_mem_free and lv_mem_realloc.
+// Requests up to LVGL_SLAB_MAX_SIZE go to the slab classes in lvgl_slab.c
+// first. Everything else, and whatever the slab cannot take, goes to a TLSF
+// pool (the ESP-IDF multi_heap) registered on a block taken once at the
+// first allocation. Where the pools live is set in menuconfig:
+//
+//   Internal  slab and one pool in internal RAM
+//   PSRAM     slab and one pool in PSRAM
+//   Split     slab and a small-object pool in internal RAM, a second pool
+//             in PSRAM for requests of LVGL_HEAP_SPLIT_THRESHOLD bytes and
+//             more. When one side is full the other one is tried.
+//
+// A PSRAM pool that cannot be created falls back to internal RAM.
+
+#define LVGL_HEAP_MAX_POOLS     2
+#define LVGL_HEAP_RATE_WINDOW_US 1000000
+
+typedef enum {
+    LVGL_HEAP_MODE_INTERNAL = 0,
+    LVGL_HEAP_MODE_PSRAM,
+    LVGL_HEAP_MODE_SPLIT,
+} lvgl_heap_mode_t;
+
+typedef struct {
+    const char *name;
+    bool psram;
+    size_t size;
+    size_t free;
+    size_t min_free;
+    size_t largest_free;
+    uint8_t fragmentation_pct;      // Free bytes not in the largest free block
+} lvgl_heap_pool_stats_t;
+
+typedef struct {
+    uint16_t block_size;
+    uint16_t blocks;
+    uint16_t used;
+    uint16_t peak;
+    uint32_t full;
+} lvgl_heap_slab_stats_t;
+
+typedef struct {
+    lvgl_heap_mode_t mode;
+    uint8_t pool_count;
+    lvgl_heap_pool_stats_t pools[LVGL_HEAP_MAX_POOLS];
+    bool slab_psram;
+    lvgl_heap_slab_stats_t slab[LVGL_SLAB_CLASS_COUNT];
+    uint32_t allocs;
+    uint32_t frees;
+    uint32_t reallocs;
+    uint32_t slab_allocs;           // Part of allocs served by the slab
+    uint32_t spilled;               // Split mode, served by the other pool
+    uint32_t failed;
+    uint32_t allocs_per_s;          // Over the last full window
+} lvgl_heap_stats_t;
+
+void *lvgl_heap_alloc(size_t size);
+void lvgl_heap_free(void *ptr);
+void *lvgl_heap_realloc(void *ptr, size_t size);
+
+void lvgl_heap_get_stats(lvgl_heap_stats_t *stats);
+const char *lvgl_heap_mode_name(lvgl_heap_mode_t mode);
+
+// lv_conf_internal.h has defaulted these to the C library by now
+#ifdef LV_MEM_CUSTOM_ALLOC
+#undef LV_MEM_CUSTOM_ALLOC
+#undef LV_MEM_CUSTOM_FREE
+#undef LV_MEM_CUSTOM_REALLOC
+#define LV_MEM_CUSTOM_ALLOC     lvgl_heap_alloc
+#define LV_MEM_CUSTOM_FREE      lvgl_heap_free
+#define LV_MEM_CUSTOM_REALLOC   lvgl_heap_realloc
+#endif
+
+#endif // LVGL_HEAP_H
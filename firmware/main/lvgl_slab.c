@@ -0,0 +1,93 @@
+#include "lvgl_slab.h"
+
+static const uint16_t block_sizes[LVGL_SLAB_CLASS_COUNT] = LVGL_SLAB_BLOCK_SIZES;
+static const uint16_t block_counts[LVGL_SLAB_CLASS_COUNT] = LVGL_SLAB_BLOCK_COUNTS;
+
+size_t lvgl_slab_required_size(void)
+{
+    size_t total = 0;
+    for (int i = 0; i < LVGL_SLAB_CLASS_COUNT; i++) {
+        total += (size_t)block_sizes[i] * block_counts[i];
+    }
+    return total;
+}
+
+void lvgl_slab_init(lvgl_slab_t *slab, void *buffer)
+{
+    uint8_t *next = buffer;
+    slab->start = next;
+
+    for (int i = 0; i < LVGL_SLAB_CLASS_COUNT; i++) {
+        lvgl_slab_class_t *cls = &slab->classes[i];
+        cls->block_size = block_sizes[i];
+        cls->blocks = block_counts[i];
+        cls->used = 0;
+        cls->peak = 0;
+        cls->full = 0;
+        cls->base = next;
+
+        // Free blocks hold the pointer to the next one, lowest address first
+        cls->free_list = NULL;
+        for (int b = cls->blocks - 1; b >= 0; b--) {
+            void **block = (void **)(cls->base + (size_t)b * cls->block_size);
+            *block = cls->free_list;
+            cls->free_list = block;
+        }
+        next += (size_t)cls->block_size * cls->blocks;
+    }
+    slab->end = next;
+}
+
+static lvgl_slab_class_t *class_of(const lvgl_slab_t *slab, const void *ptr)
+{
+    const uint8_t *p = ptr;
+    for (int i = LVGL_SLAB_CLASS_COUNT - 1; i >= 0; i--) {
+        if (p >= slab->classes[i].base) {
+            return (lvgl_slab_class_t *)&slab->classes[i];
+        }
+    }
+    return NULL;
+}
+
+void *lvgl_slab_alloc(lvgl_slab_t *slab, size_t size)
+{
+    for (int i = 0; i < LVGL_SLAB_CLASS_COUNT; i++) {
+        lvgl_slab_class_t *cls = &slab->classes[i];
+        if (size > cls->block_size) {
+            continue;
+        }
+        if (cls->free_list == NULL) {
+            cls->full++;
+            continue;
+        }
+
+        void **block = cls->free_list;
+        cls->free_list = *block;
+        cls->used++;
+        if (cls->used > cls->peak) {
+            cls->peak = cls->used;
+        }
+        return block;
+    }
+    return NULL;
+}
+
+bool lvgl_slab_owns(const lvgl_slab_t *slab, const void *ptr)
+{
+    const uint8_t *p = ptr;
+    return p >= slab->start && p < slab->end;
+}
+
+size_t lvgl_slab_block_size(const lvgl_slab_t *slab, const void *ptr)
+{
+    return class_of(slab, ptr)->block_size;
+}
+
+void lvgl_slab_free(lvgl_slab_t *slab, void *ptr)
+{
+    lvgl_slab_class_t *cls = class_of(slab, ptr);
+    void **block = ptr;
+    *block = cls->free_list;
+    cls->free_list = block;
+    cls->used--;
+}
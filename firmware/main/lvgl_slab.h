@@ -0,0 +1,55 @@
+#ifndef LVGL_SLAB_H
+#define LVGL_SLAB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Fixed-size block classes in front of the LVGL pool.
+//
+// Most LVGL allocations are a few dozen bytes: label text, style and
+// property arrays, timers, animations, event descriptors. Label text is
+// freed and allocated again at its new length on every set_text, and
+// interleaved with everything else that mixes small holes into the pool.
+// A request the slab can hold takes the first free block of the smallest
+// class that fits, or of the next larger one when that class is full, and
+// a resize that still fits its block keeps it. Blocks never move between
+// classes, so the small churn cannot fragment anything. Requests larger
+// than the largest class, or that find every fitting class full, return
+// NULL and go to the pool.
+//
+// Plain C on a caller-provided buffer with no locking, so it builds and
+// runs on the host as well.
+
+#define LVGL_SLAB_CLASS_COUNT   4
+#define LVGL_SLAB_BLOCK_SIZES   { 16, 32, 64, 128 }
+#define LVGL_SLAB_BLOCK_COUNTS  { 128, 256, 256, 64 }
+#define LVGL_SLAB_MAX_SIZE      128
+
+typedef struct {
+    uint16_t block_size;
+    uint16_t blocks;
+    uint16_t used;
+    uint16_t peak;
+    uint32_t full;                  // Allocations that found this class full
+    uint8_t *base;
+    void *free_list;
+} lvgl_slab_class_t;
+
+typedef struct {
+    lvgl_slab_class_t classes[LVGL_SLAB_CLASS_COUNT];
+    uint8_t *start;
+    uint8_t *end;
+} lvgl_slab_t;
+
+// Bytes the buffer given to lvgl_slab_init must have
+size_t lvgl_slab_required_size(void);
+// buffer must be aligned for any LVGL object
+void lvgl_slab_init(lvgl_slab_t *slab, void *buffer);
+void *lvgl_slab_alloc(lvgl_slab_t *slab, size_t size);
+bool lvgl_slab_owns(const lvgl_slab_t *slab, const void *ptr);
+// Usable size of a block the slab owns
+size_t lvgl_slab_block_size(const lvgl_slab_t *slab, const void *ptr);
+void lvgl_slab_free(lvgl_slab_t *slab, void *ptr);
+
+#endif // LVGL_SLAB_H
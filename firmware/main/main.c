@@ -19,6 +19,18 @@
 #include "version.h"
 #include "target_config.h"
 #include "viber.h"
+#include "settings.h"
+#include "kinematics.h"
+#include "ride_stats.h"
+#include "range.h"
+#include "pack_monitor.h"
+#include "stats_screen.h"
+#include "chart_screen.h"
+#include "history.h"
+#include "odometer.h"
+#include "ride_recorder.h"
+#include "stream.h"
+#include "residency.h"
 
 #define TAG "MAIN"
 
@@ -76,12 +88,40 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(ret);
 
-    // Initialize VESC configuration
-    ESP_ERROR_CHECK(vesc_config_init());
+    // Load persistent settings, migrating the old per-key layout on first boot
+    if (settings_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Settings could not be stored, running on defaults");
+    }
+
+    // Speed, distance and ride statistics, updated on every telemetry frame
+    ESP_ERROR_CHECK(kinematics_init());
+    ESP_ERROR_CHECK(ride_stats_init());
+
+    // Recover trip and lifetime distance from the odometer log
+    if (odometer_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Odometer log unavailable, trip distance will not be saved");
+    }
+    odometer_start_task();
+
+    // Range estimate, seeded from the recovered trip and ride statistics
+    ESP_ERROR_CHECK(range_init());
+
+    // Start recording telemetry to the ride log behind the odometer
+    if (ride_recorder_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Ride recorder unavailable");
+    }
+
+    // Keep the last minutes of telemetry in PSRAM for the charts
+    if (history_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Telemetry history unavailable");
+    }
 
     // Initialize viber
     ESP_ERROR_CHECK(viber_init());
 
+    // Cell and temperature alerts, played on the viber
+    ESP_ERROR_CHECK(pack_monitor_init());
+
     // Initialize ADC and start tasks
     ESP_ERROR_CHECK(adc_init());
     adc_start_task();
@@ -97,6 +137,11 @@ void app_main(void)
     usb_serial_init();
     usb_serial_start_task();
 
+    // Live telemetry over USB, idle until a host asks for it
+    if (stream_init() != ESP_OK) {
+        ESP_LOGW(TAG, "USB telemetry stream unavailable");
+    }
+
     spp_client_demo_init();
     ESP_LOGI(TAG, "BLE Initialization complete");
 
@@ -105,7 +150,15 @@ void app_main(void)
 
     button_start_monitoring();
 
+    // Hot glyphs and icons into internal RAM before the first frame
+    if (residency_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Asset residency unavailable, drawing from flash");
+    }
+
     ui_init();
+    stats_screen_init();
+    chart_screen_init();
+    residency_apply();
 
     // Set initial speed unit from saved configuration
     vesc_config_t config;
@@ -0,0 +1,387 @@
+#include "odometer.h"
+#include <string.h>
+#include <stddef.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "ride_stats.h"
+#include "settings.h"
+
+#define TAG "ODOMETER"
+
+#define ODO_RECORD_MAGIC    0x0D0E
+#define ODO_RECORD_VERSION  1
+#define MM_PER_KM           1000000.0
+#define MM_PER_MILE         1609344.0
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint32_t seq;
+    uint64_t trip_mm;
+    uint64_t total_mm;
+    uint32_t erase_count;
+    ride_stats_persist_t stats;
+    uint8_t reserved[32 - sizeof(ride_stats_persist_t)];
+    uint32_t crc;           // CRC32 of every byte before this field
+} odo_record_t;
+
+_Static_assert(sizeof(odo_record_t) == ODOMETER_RECORD_SIZE, "odometer record must fill one slot");
+
+static const esp_partition_t *partition = NULL;
+static SemaphoreHandle_t log_mutex = NULL;
+static portMUX_TYPE counter_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Live counters, updated from the distance integrator
+static uint64_t trip_mm = 0;
+static uint64_t total_mm = 0;
+
+// Log head, only touched with log_mutex held
+static uint32_t head_seq = 0;
+static uint32_t head_sector = 0;
+static uint32_t head_next_slot = 0;
+static uint32_t erase_count = 0;
+static uint64_t saved_trip_mm = 0;
+static uint64_t saved_total_mm = 0;
+static ride_stats_persist_t saved_stats = {0};
+static int64_t last_append_us = 0;
+
+static uint32_t record_crc(const odo_record_t *rec)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, offsetof(odo_record_t, crc));
+}
+
+static bool record_is_valid(const odo_record_t *rec)
+{
+    return rec->magic == ODO_RECORD_MAGIC &&
+           rec->version == ODO_RECORD_VERSION &&
+           rec->crc == record_crc(rec);
+}
+
+static bool record_is_erased(const odo_record_t *rec)
+{
+    const uint8_t *p = (const uint8_t *)rec;
+    for (size_t i = 0; i < sizeof(*rec); i++) {
+        if (p[i] != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static size_t slot_offset(uint32_t sector, uint32_t slot)
+{
+    return ODOMETER_LOG_OFFSET + sector * ODOMETER_SECTOR_SIZE + slot * ODOMETER_RECORD_SIZE;
+}
+
+static esp_err_t read_slot(uint32_t sector, uint32_t slot, odo_record_t *rec)
+{
+    return esp_partition_read(partition, slot_offset(sector, slot), rec, sizeof(*rec));
+}
+
+// Every sector starts with a valid record once it has been written, so the
+// newest sector is found from the first slot alone; only that sector is then
+// scanned record by record.
+static esp_err_t recover_head(bool *found)
+{
+    odo_record_t rec;
+    bool have_sector = false;
+    uint32_t newest_sector = 0;
+    uint32_t newest_seq = 0;
+
+    *found = false;
+
+    for (uint32_t sector = 0; sector < ODOMETER_LOG_SECTORS; sector++) {
+        esp_err_t err = read_slot(sector, 0, &rec);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (record_is_valid(&rec) && (!have_sector || (int32_t)(rec.seq - newest_seq) > 0)) {
+            have_sector = true;
+            newest_sector = sector;
+            newest_seq = rec.seq;
+        }
+    }
+
+    if (!have_sector) {
+        head_sector = 0;
+        head_next_slot = 0;
+        head_seq = 0;
+        erase_count = 0;
+        trip_mm = 0;
+        total_mm = 0;
+        memset(&saved_stats, 0, sizeof(saved_stats));
+        return ESP_OK;
+    }
+
+    odo_record_t newest = {0};
+    uint32_t next_slot = 0;
+    for (uint32_t slot = 0; slot < ODOMETER_RECORDS_PER_SECTOR; slot++) {
+        esp_err_t err = read_slot(newest_sector, slot, &rec);
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (record_is_erased(&rec)) {
+            continue;
+        }
+        // Torn or corrupt slots are stepped over, never rewritten
+        next_slot = slot + 1;
+        if (record_is_valid(&rec) && (int32_t)(rec.seq - newest.seq) >= 0) {
+            newest = rec;
+        }
+    }
+
+    head_sector = newest_sector;
+    head_next_slot = next_slot;
+    head_seq = newest.seq;
+    erase_count = newest.erase_count;
+    trip_mm = newest.trip_mm;
+    total_mm = newest.total_mm;
+    saved_stats = newest.stats;
+    *found = true;
+    return ESP_OK;
+}
+
+// The old counter integrated the displayed speed, so it holds miles when
+// the unit was set to mph. settings_init() has migrated the unit by now.
+static void migrate_legacy_trip(void)
+{
+    nvs_handle_t nvs_handle;
+    float trip = 0.0f;
+    size_t size = sizeof(trip);
+
+    if (nvs_open(ODOMETER_LEGACY_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs_handle, ODOMETER_LEGACY_NVS_KEY, &trip, &size) == ESP_OK &&
+        trip > 0.0f) {
+        settings_t settings;
+        settings_get(&settings);
+        bool mph = settings.speed_unit_mph != 0;
+        trip_mm = (uint64_t)((double)trip * (mph ? MM_PER_MILE : MM_PER_KM));
+        total_mm = trip_mm;
+        ESP_LOGI(TAG, "Migrated legacy trip distance: %.2f %s", trip, mph ? "mi" : "km");
+    }
+    nvs_close(nvs_handle);
+}
+
+// Caller holds log_mutex
+static esp_err_t append_record_locked(void)
+{
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint64_t trip, total;
+    portENTER_CRITICAL(&counter_lock);
+    trip = trip_mm;
+    total = total_mm;
+    portEXIT_CRITICAL(&counter_lock);
+
+    uint32_t sector = head_sector;
+    uint32_t slot = head_next_slot;
+    if (slot >= ODOMETER_RECORDS_PER_SECTOR) {
+        sector = (sector + 1) % ODOMETER_LOG_SECTORS;
+        slot = 0;
+    }
+
+    if (slot == 0) {
+        esp_err_t err = esp_partition_erase_range(partition,
+                                                  ODOMETER_LOG_OFFSET + sector * ODOMETER_SECTOR_SIZE,
+                                                  ODOMETER_SECTOR_SIZE);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase sector %lu: %s", sector, esp_err_to_name(err));
+            return err;
+        }
+        erase_count++;
+    }
+
+    odo_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = ODO_RECORD_MAGIC;
+    rec.version = ODO_RECORD_VERSION;
+    rec.seq = head_seq + 1;
+    rec.trip_mm = trip;
+    rec.total_mm = total;
+    rec.erase_count = erase_count;
+    ride_stats_get_persist(&rec.stats);
+    rec.crc = record_crc(&rec);
+
+    esp_err_t err = esp_partition_write(partition, slot_offset(sector, slot), &rec, sizeof(rec));
+    // The slot is consumed even if the write failed part way
+    head_sector = sector;
+    head_next_slot = slot + 1;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write record: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    head_seq = rec.seq;
+    saved_trip_mm = trip;
+    saved_total_mm = total;
+    saved_stats = rec.stats;
+    last_append_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+esp_err_t odometer_init(void)
+{
+    if (log_mutex == NULL) {
+        log_mutex = xSemaphoreCreateMutex();
+        if (log_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         ODOMETER_PARTITION_LABEL);
+    if (partition == NULL || partition->size < ODOMETER_LOG_OFFSET + ODOMETER_LOG_SIZE) {
+        ESP_LOGE(TAG, "No usable '%s' partition, trip data will not persist", ODOMETER_PARTITION_LABEL);
+        partition = NULL;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    bool found = false;
+    esp_err_t err = recover_head(&found);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to scan odometer log: %s", esp_err_to_name(err));
+        partition = NULL;
+        return err;
+    }
+
+    if (found) {
+        ride_stats_restore(&saved_stats);
+        ESP_LOGI(TAG, "Recovered seq %lu from sector %lu: trip %llu mm, total %llu mm",
+                 head_seq, head_sector, trip_mm, total_mm);
+    } else {
+        ESP_LOGI(TAG, "Odometer log empty, starting new log");
+        migrate_legacy_trip();
+        xSemaphoreTake(log_mutex, portMAX_DELAY);
+        // Force the first append to erase and start at sector 0
+        head_sector = ODOMETER_LOG_SECTORS - 1;
+        head_next_slot = ODOMETER_RECORDS_PER_SECTOR;
+        err = append_record_locked();
+        xSemaphoreGive(log_mutex);
+        if (err != ESP_OK) {
+            return err;
+        }
+    }
+
+    saved_trip_mm = trip_mm;
+    saved_total_mm = total_mm;
+    last_append_us = esp_timer_get_time();
+    return ESP_OK;
+}
+
+static void odometer_task(void *pvParameters)
+{
+    const uint64_t append_distance_mm = (uint64_t)ODOMETER_APPEND_DISTANCE_M * 1000;
+    const int64_t append_interval_us = (int64_t)ODOMETER_APPEND_INTERVAL_S * 1000000;
+
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(ODOMETER_TASK_PERIOD_MS));
+
+        if (partition == NULL) {
+            continue;
+        }
+
+        uint64_t total;
+        portENTER_CRITICAL(&counter_lock);
+        total = total_mm;
+        portEXIT_CRITICAL(&counter_lock);
+
+        xSemaphoreTake(log_mutex, portMAX_DELAY);
+        uint64_t unsaved_mm = total - saved_total_mm;
+        bool interval_elapsed = (esp_timer_get_time() - last_append_us) >= append_interval_us;
+        if (unsaved_mm >= append_distance_mm || (unsaved_mm > 0 && interval_elapsed)) {
+            append_record_locked();
+        }
+        xSemaphoreGive(log_mutex);
+    }
+}
+
+void odometer_start_task(void)
+{
+    xTaskCreate(odometer_task, "odometer", 3072, NULL, 3, NULL);
+}
+
+void odometer_add_distance_mm(uint32_t distance_mm)
+{
+    portENTER_CRITICAL(&counter_lock);
+    trip_mm += distance_mm;
+    total_mm += distance_mm;
+    portEXIT_CRITICAL(&counter_lock);
+}
+
+uint64_t odometer_get_trip_mm(void)
+{
+    portENTER_CRITICAL(&counter_lock);
+    uint64_t value = trip_mm;
+    portEXIT_CRITICAL(&counter_lock);
+    return value;
+}
+
+uint64_t odometer_get_total_mm(void)
+{
+    portENTER_CRITICAL(&counter_lock);
+    uint64_t value = total_mm;
+    portEXIT_CRITICAL(&counter_lock);
+    return value;
+}
+
+void odometer_reset_trip(void)
+{
+    portENTER_CRITICAL(&counter_lock);
+    trip_mm = 0;
+    portEXIT_CRITICAL(&counter_lock);
+    ride_stats_reset();
+
+    // Persist the reset right away so it survives a power cut
+    odometer_flush();
+}
+
+esp_err_t odometer_flush(void)
+{
+    if (partition == NULL || log_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    ride_stats_persist_t stats;
+    ride_stats_get_persist(&stats);
+    if (odometer_get_trip_mm() != saved_trip_mm || odometer_get_total_mm() != saved_total_mm ||
+        memcmp(&stats, &saved_stats, sizeof(stats)) != 0) {
+        err = append_record_locked();
+    }
+    xSemaphoreGive(log_mutex);
+    return err;
+}
+
+void odometer_get_status(odometer_status_t *status)
+{
+    if (status == NULL) {
+        return;
+    }
+    status->flash_ok = (partition != NULL);
+    if (log_mutex == NULL) {
+        status->seq = 0;
+        status->erase_count = 0;
+        status->sector = 0;
+        status->next_slot = 0;
+        return;
+    }
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    status->seq = head_seq;
+    status->erase_count = erase_count;
+    status->sector = head_sector;
+    status->next_slot = head_next_slot;
+    xSemaphoreGive(log_mutex);
+}
@@ -0,0 +1,57 @@
+#ifndef ODOMETER_H
+#define ODOMETER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Trip and lifetime distance are kept in an append-only record log at the
+// start of the "storage" partition. Every record carries a sequence number
+// and a CRC32, so a brownout mid-write only ever loses the record being
+// written. Records fill one 4 KB sector after another and the log wraps
+// around ODOMETER_LOG_SECTORS sectors, which spreads erases evenly. Records
+// also carry the trip statistics from ride_stats.
+//
+// Wear estimate (1 h of riding per day at ~20 km/h, one append per 100 m):
+//   ~200 records/h -> 73,000 records/year -> 73,000 / 64 = ~1,140 sector
+//   erases/year spread over 8 sectors = ~143 erases per sector per year,
+//   against the 100,000 cycle endurance of the SPI flash.
+
+#define ODOMETER_PARTITION_LABEL    "storage"
+#define ODOMETER_LOG_OFFSET         0x0
+#define ODOMETER_SECTOR_SIZE        4096
+#define ODOMETER_LOG_SECTORS        8
+#define ODOMETER_LOG_SIZE           (ODOMETER_LOG_SECTORS * ODOMETER_SECTOR_SIZE)
+#define ODOMETER_RECORD_SIZE        64
+#define ODOMETER_RECORDS_PER_SECTOR (ODOMETER_SECTOR_SIZE / ODOMETER_RECORD_SIZE)
+
+// Append policy: a new record is written once the trip has grown by
+// ODOMETER_APPEND_DISTANCE_M, or ODOMETER_APPEND_INTERVAL_S after the last
+// record if the board has moved at all in between.
+#define ODOMETER_APPEND_DISTANCE_M  100
+#define ODOMETER_APPEND_INTERVAL_S  30
+#define ODOMETER_TASK_PERIOD_MS     1000
+
+// Legacy trip storage, read once to migrate the old float trip counter. It
+// is in km or miles, whichever unit was selected.
+#define ODOMETER_LEGACY_NVS_NAMESPACE "trip_data"
+#define ODOMETER_LEGACY_NVS_KEY       "trip_km"
+
+typedef struct {
+    uint32_t seq;           // Sequence number of the newest record on flash
+    uint32_t erase_count;   // Sector erases performed since the log was created
+    uint32_t sector;        // Sector currently being appended to
+    uint32_t next_slot;     // Next free record slot in that sector
+    bool flash_ok;          // False when running RAM-only (no storage partition)
+} odometer_status_t;
+
+esp_err_t odometer_init(void);
+void odometer_start_task(void);
+void odometer_add_distance_mm(uint32_t distance_mm);
+uint64_t odometer_get_trip_mm(void);
+uint64_t odometer_get_total_mm(void);
+void odometer_reset_trip(void);
+esp_err_t odometer_flush(void);
+void odometer_get_status(odometer_status_t *status);
+
+#endif // ODOMETER_H
@@ -0,0 +1,234 @@
+#include "pack_monitor.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "viber.h"
+
+#define TAG "PACK_MONITOR"
+
+#define PACK_EVENT_QUEUE_LEN  8
+
+typedef struct {
+    pack_monitor_callback_t callback;
+    void *user_data;
+} pack_listener_t;
+
+static pack_listener_t listeners[PACK_MONITOR_MAX_CALLBACKS];
+static int listener_count = 0;
+
+static pack_status_t status = {0};
+static portMUX_TYPE status_lock = portMUX_INITIALIZER_UNLOCKED;
+static QueueHandle_t event_queue = NULL;
+
+// Debounce counters, only touched from the telemetry callback
+static uint8_t pending_frames[PACK_ALERT_COUNT] = {0};
+
+// Runs with status_lock held. Counts frames where the alert should change
+// state and flips it once the run is long enough; the transition is appended
+// to events and queued after the lock is released.
+static void evaluate_locked(pack_alert_t alert, bool enter, bool exit, int32_t value,
+                            pack_event_t *events, int *event_count)
+{
+    uint32_t bit = 1UL << alert;
+    bool active = (status.alerts & bit) != 0;
+
+    if (!(active ? exit : enter)) {
+        pending_frames[alert] = 0;
+        return;
+    }
+    if (++pending_frames[alert] < PACK_ALERT_DEBOUNCE_FRAMES) {
+        return;
+    }
+    pending_frames[alert] = 0;
+
+    status.alerts ^= bit;
+    events[*event_count].alert = alert;
+    events[*event_count].active = !active;
+    events[*event_count].value = value;
+    (*event_count)++;
+}
+
+// Runs with status_lock held. Drops an alert at once, for when what it
+// judges is gone rather than back in range.
+static void clear_locked(pack_alert_t alert, int32_t value, pack_event_t *events, int *event_count)
+{
+    uint32_t bit = 1UL << alert;
+    pending_frames[alert] = 0;
+    if ((status.alerts & bit) == 0) {
+        return;
+    }
+
+    status.alerts &= ~bit;
+    events[*event_count].alert = alert;
+    events[*event_count].active = false;
+    events[*event_count].value = value;
+    (*event_count)++;
+}
+
+static void update_cell(pack_cell_stats_t *cell, int16_t mv, int32_t current_c100)
+{
+    cell->mv = mv;
+    if (cell->min_mv == 0 || mv < cell->min_mv) {
+        cell->min_mv = mv;
+    }
+    if (mv > cell->max_mv) {
+        cell->max_mv = mv;
+    }
+
+    int32_t magnitude = current_c100 < 0 ? -current_c100 : current_c100;
+    if (magnitude < PACK_REST_CURRENT_C100) {
+        cell->rest_mv = cell->rest_mv == 0 ? mv : cell->rest_mv + ((mv - cell->rest_mv) >> PACK_CELL_FILTER_SHIFT);
+    } else if (current_c100 > PACK_LOAD_CURRENT_C100) {
+        cell->load_mv = cell->load_mv == 0 ? mv : cell->load_mv + ((mv - cell->load_mv) >> PACK_CELL_FILTER_SHIFT);
+    }
+}
+
+static void on_telemetry(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    uint8_t num_cells = snapshot->bms_num_cells;
+    if (num_cells > TELEMETRY_MAX_CELLS) {
+        num_cells = TELEMETRY_MAX_CELLS;
+    }
+    // Prefer the BMS current, it is measured at the cells
+    int32_t current_c100 = snapshot->bms_voltage_c100 > 0 ? snapshot->bms_current_c100 : snapshot->current_in_c100;
+    bool resting = current_c100 > -PACK_REST_CURRENT_C100 && current_c100 < PACK_REST_CURRENT_C100;
+    pack_event_t events[PACK_ALERT_COUNT];
+    int event_count = 0;
+
+    portENTER_CRITICAL(&status_lock);
+    status.num_cells = num_cells;
+
+    // A cell at 0 mV is one the BMS did not measure, not an empty cell
+    int min_cell = -1;
+    int max_cell = -1;
+    for (uint8_t i = 0; i < num_cells; i++) {
+        int16_t mv = snapshot->cell_mv[i];
+        status.cells[i].mv = mv;
+        if (mv <= 0) {
+            continue;
+        }
+        update_cell(&status.cells[i], mv, current_c100);
+        if (min_cell < 0 || mv < snapshot->cell_mv[min_cell]) {
+            min_cell = i;
+        }
+        if (max_cell < 0 || mv > snapshot->cell_mv[max_cell]) {
+            max_cell = i;
+        }
+    }
+
+    if (min_cell < 0) {
+        // The BMS went away or reports no cells: nothing left to judge
+        status.min_cell = 0;
+        status.max_cell = 0;
+        status.min_mv = 0;
+        status.max_mv = 0;
+        status.delta_mv = 0;
+        clear_locked(PACK_ALERT_LOW_CELL, 0, events, &event_count);
+        clear_locked(PACK_ALERT_IMBALANCE, 0, events, &event_count);
+    } else {
+        status.min_cell = min_cell;
+        status.max_cell = max_cell;
+        status.min_mv = snapshot->cell_mv[min_cell];
+        status.max_mv = snapshot->cell_mv[max_cell];
+        status.delta_mv = status.max_mv - status.min_mv;
+
+        evaluate_locked(PACK_ALERT_LOW_CELL, status.min_mv < PACK_LOW_CELL_ENTER_MV,
+                        status.min_mv > PACK_LOW_CELL_EXIT_MV, status.min_mv, events, &event_count);
+        // Sag spreads the cells apart under load, judge balance at rest only
+        if (resting) {
+            evaluate_locked(PACK_ALERT_IMBALANCE, status.delta_mv > PACK_IMBALANCE_ENTER_MV,
+                            status.delta_mv < PACK_IMBALANCE_EXIT_MV, status.delta_mv, events, &event_count);
+        }
+    }
+
+    evaluate_locked(PACK_ALERT_TEMP_MOS, snapshot->temp_mos_c100 > PACK_TEMP_MOS_ENTER_C100,
+                    snapshot->temp_mos_c100 < PACK_TEMP_MOS_EXIT_C100, snapshot->temp_mos_c100,
+                    events, &event_count);
+    evaluate_locked(PACK_ALERT_TEMP_MOTOR, snapshot->temp_motor_c100 > PACK_TEMP_MOTOR_ENTER_C100,
+                    snapshot->temp_motor_c100 < PACK_TEMP_MOTOR_EXIT_C100, snapshot->temp_motor_c100,
+                    events, &event_count);
+    portEXIT_CRITICAL(&status_lock);
+
+    // Never block the Bluetooth task, a full queue only drops the notification
+    for (int i = 0; i < event_count; i++) {
+        xQueueSend(event_queue, &events[i], 0);
+    }
+}
+
+static void pack_monitor_task(void *pvParameters)
+{
+    pack_event_t event;
+
+    while (1) {
+        if (xQueueReceive(event_queue, &event, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        if (event.active) {
+            ESP_LOGW(TAG, "%s alert raised (%ld)", pack_alert_name(event.alert), event.value);
+            viber_play_pattern(VIBER_PATTERN_ALERT);
+        } else {
+            ESP_LOGI(TAG, "%s alert cleared (%ld)", pack_alert_name(event.alert), event.value);
+        }
+
+        for (int i = 0; i < listener_count; i++) {
+            listeners[i].callback(&event, listeners[i].user_data);
+        }
+    }
+}
+
+esp_err_t pack_monitor_init(void)
+{
+    event_queue = xQueueCreate(PACK_EVENT_QUEUE_LEN, sizeof(pack_event_t));
+    if (event_queue == NULL) {
+        ESP_LOGE(TAG, "Failed to create event queue");
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(pack_monitor_task, "pack_monitor", 3072, NULL, 3, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create pack monitor task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return telemetry_register_callback(on_telemetry, NULL);
+}
+
+esp_err_t pack_monitor_register_callback(pack_monitor_callback_t callback, void *user_data)
+{
+    if (callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (listener_count >= PACK_MONITOR_MAX_CALLBACKS) {
+        ESP_LOGE(TAG, "Too many pack monitor callbacks");
+        return ESP_ERR_NO_MEM;
+    }
+
+    listeners[listener_count].callback = callback;
+    listeners[listener_count].user_data = user_data;
+    listener_count++;
+    return ESP_OK;
+}
+
+void pack_monitor_get_status(pack_status_t *out)
+{
+    portENTER_CRITICAL(&status_lock);
+    *out = status;
+    portEXIT_CRITICAL(&status_lock);
+}
+
+const char *pack_alert_name(pack_alert_t alert)
+{
+    switch (alert) {
+        case PACK_ALERT_LOW_CELL:
+            return "Low cell";
+        case PACK_ALERT_IMBALANCE:
+            return "Imbalance";
+        case PACK_ALERT_TEMP_MOS:
+            return "FET temperature";
+        case PACK_ALERT_TEMP_MOTOR:
+            return "Motor temperature";
+        default:
+            return "Unknown";
+    }
+}
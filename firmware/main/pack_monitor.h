@@ -0,0 +1,79 @@
+#ifndef PACK_MONITOR_H
+#define PACK_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "telemetry.h"
+
+// Cell-level pack health, updated in O(cells) from every telemetry frame.
+//
+// Each cell keeps its session min/max and two filtered voltages: one while
+// the pack is resting and one while it is under load. Their difference is
+// the cell's sag, which grows with internal resistance.
+//
+// Alerts use enter/exit thresholds plus a run of consecutive frames, so a
+// brief dip under acceleration does not trigger them. Only transitions are
+// reported: the frame callback queues an event and the monitor task plays
+// the haptic pattern and calls the registered listeners.
+//
+// Cells reading 0 mV were not measured and are left out. A frame without
+// any measured cell clears the cell alerts at once, without the debounce.
+
+#define PACK_LOW_CELL_ENTER_MV      3300
+#define PACK_LOW_CELL_EXIT_MV       3400
+#define PACK_IMBALANCE_ENTER_MV     100
+#define PACK_IMBALANCE_EXIT_MV      70
+#define PACK_TEMP_MOS_ENTER_C100    8000    // 80 degC
+#define PACK_TEMP_MOS_EXIT_C100     7000
+#define PACK_TEMP_MOTOR_ENTER_C100  10000   // 100 degC
+#define PACK_TEMP_MOTOR_EXIT_C100   8500
+#define PACK_ALERT_DEBOUNCE_FRAMES  20      // Consecutive frames before a state change
+
+#define PACK_REST_CURRENT_C100      100     // Below 1 A the pack counts as resting
+#define PACK_LOAD_CURRENT_C100      1000    // Above 10 A it counts as loaded
+#define PACK_CELL_FILTER_SHIFT      3       // alpha = 1/8 per frame
+
+#define PACK_MONITOR_MAX_CALLBACKS  4
+
+typedef enum {
+    PACK_ALERT_LOW_CELL = 0,
+    PACK_ALERT_IMBALANCE,
+    PACK_ALERT_TEMP_MOS,
+    PACK_ALERT_TEMP_MOTOR,
+    PACK_ALERT_COUNT
+} pack_alert_t;
+
+typedef struct {
+    pack_alert_t alert;
+    bool active;                    // Raised or cleared
+    int32_t value;                  // mV for cell alerts, 0.01 degC for temperatures
+} pack_event_t;
+
+typedef struct {
+    int16_t mv;                     // Latest reading
+    int16_t min_mv;                 // Since boot
+    int16_t max_mv;
+    int16_t rest_mv;                // Filtered, 0 until seen at rest
+    int16_t load_mv;                // Filtered, 0 until seen under load
+} pack_cell_stats_t;
+
+typedef struct {
+    uint8_t num_cells;              // 0 when no BMS reports cell voltages
+    uint8_t min_cell;               // Index of the lowest measured cell
+    uint8_t max_cell;
+    int16_t min_mv;                 // 0 without a measured cell
+    int16_t max_mv;
+    int16_t delta_mv;
+    uint32_t alerts;                // Bit per active pack_alert_t
+    pack_cell_stats_t cells[TELEMETRY_MAX_CELLS];
+} pack_status_t;
+
+typedef void (*pack_monitor_callback_t)(const pack_event_t *event, void *user_data);
+
+esp_err_t pack_monitor_init(void);
+esp_err_t pack_monitor_register_callback(pack_monitor_callback_t callback, void *user_data);
+void pack_monitor_get_status(pack_status_t *status);
+const char *pack_alert_name(pack_alert_t alert);
+
+#endif // PACK_MONITOR_H
@@ -10,6 +10,8 @@
 #include "driver/gpio.h"
 #include "button.h"
 #include "viber.h"
+#include "odometer.h"
+#include "ride_recorder.h"
 
 #define TAG "POWER"
 
@@ -135,11 +137,13 @@ void power_check_inactivity(bool is_ble_connected)
 void power_shutdown(void) {
     ESP_LOGI(TAG, "Preparing for shutdown");
     lcd_fade_backlight(LCD_BACKLIGHT_DEFAULT, LCD_BACKLIGHT_MIN, LCD_BACKLIGHT_FADE_DURATION_MS);
-    // Save trip distance
-    esp_err_t err = ui_save_trip_distance();
+    // Append a final odometer record
+    esp_err_t err = odometer_flush();
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save trip distance: %s", esp_err_to_name(err));
     }
+    // Write out the partially filled ride log block
+    ride_recorder_flush();
     vTaskDelay(pdMS_TO_TICKS(100));
     // Shut down by setting GPIO 4 to LOW
     gpio_set_level(POWER_HOLD_GPIO, 0);
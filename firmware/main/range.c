@@ -0,0 +1,185 @@
+#include "range.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "telemetry.h"
+#include "ride_stats.h"
+#include "odometer.h"
+#include "settings.h"
+
+#define TAG "RANGE"
+
+// Open-circuit voltage of one Li-ion cell against state of charge
+static const struct {
+    uint16_t mv;
+    uint16_t soc_permille;
+} ocv_curve[] = {
+    {3300, 0},   {3450, 50},  {3550, 100}, {3650, 200},
+    {3700, 300}, {3750, 400}, {3800, 500}, {3870, 600},
+    {3950, 700}, {4030, 800}, {4100, 900}, {4200, 1000},
+};
+#define OCV_POINTS (sizeof(ocv_curve) / sizeof(ocv_curve[0]))
+
+static range_estimate_t estimate = {0};
+static portMUX_TYPE estimate_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static volatile uint8_t pack_cells = RANGE_DEFAULT_PACK_CELLS;
+static volatile uint16_t pack_capacity_mah = RANGE_DEFAULT_PACK_CAPACITY_MAH;
+
+// Estimator state, only touched from the telemetry callback
+static int32_t cell_mv_q4 = 0;          // Filtered sag-compensated cell voltage, mV << 4
+static int32_t wh_per_km_x10 = RANGE_DEFAULT_WH_PER_KM_X10;
+static int32_t deviation_x10 = RANGE_DEFAULT_WH_PER_KM_X10 / 3;
+static uint32_t windows = 0;
+static uint64_t window_start_mm = 0;
+static int64_t window_start_mwh = 0;
+
+static uint16_t ocv_to_soc_permille(int32_t mv)
+{
+    if (mv <= ocv_curve[0].mv) {
+        return 0;
+    }
+    for (size_t i = 1; i < OCV_POINTS; i++) {
+        if (mv <= ocv_curve[i].mv) {
+            int32_t span_mv = ocv_curve[i].mv - ocv_curve[i - 1].mv;
+            int32_t span_soc = ocv_curve[i].soc_permille - ocv_curve[i - 1].soc_permille;
+            return ocv_curve[i - 1].soc_permille + (mv - ocv_curve[i - 1].mv) * span_soc / span_mv;
+        }
+    }
+    return 1000;
+}
+
+static void update_consumption(uint64_t trip_mm, int64_t net_mwh)
+{
+    // Trip reset, start a fresh window
+    if (trip_mm < window_start_mm) {
+        window_start_mm = trip_mm;
+        window_start_mwh = net_mwh;
+        return;
+    }
+
+    uint64_t distance_mm = trip_mm - window_start_mm;
+    if (distance_mm < (uint64_t)RANGE_WINDOW_M * 1000) {
+        return;
+    }
+
+    // mWh / mm * 1e4 = 0.1 Wh/km
+    int32_t sample = (int32_t)((net_mwh - window_start_mwh) * 10000 / (int64_t)distance_mm);
+    if (sample < RANGE_MIN_WH_PER_KM_X10) {
+        sample = RANGE_MIN_WH_PER_KM_X10;
+    }
+
+    if (windows == 0) {
+        // First real window replaces the default outright
+        wh_per_km_x10 = sample;
+    } else {
+        int32_t error = sample - wh_per_km_x10;
+        wh_per_km_x10 += error >> RANGE_EWMA_SHIFT;
+        deviation_x10 += ((error < 0 ? -error : error) - deviation_x10) >> RANGE_EWMA_SHIFT;
+    }
+    windows++;
+
+    window_start_mm = trip_mm;
+    window_start_mwh = net_mwh;
+}
+
+static void on_telemetry(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    ride_stats_persist_t totals;
+    ride_stats_get_persist(&totals);
+    update_consumption(odometer_get_trip_mm(),
+                       (int64_t)totals.energy_drawn_mwh - totals.energy_regen_mwh);
+
+    uint8_t cells = snapshot->bms_num_cells > 0 ? snapshot->bms_num_cells : pack_cells;
+    range_source_t source = RANGE_SOURCE_NONE;
+    uint32_t soc_permille = 0;
+    uint32_t remaining_wh_x10 = 0;
+
+    if (snapshot->bms_nominal_c100 > 0 && snapshot->bms_voltage_c100 > 0) {
+        source = RANGE_SOURCE_BMS;
+        int32_t remaining_c100 = snapshot->bms_remaining_c100 > 0 ? snapshot->bms_remaining_c100 : 0;
+        soc_permille = (uint32_t)remaining_c100 * 1000 / snapshot->bms_nominal_c100;
+        if (soc_permille > 1000) {
+            soc_permille = 1000;
+        }
+        // 0.01 Ah * cells * 3.6 V nominal -> 0.1 Wh
+        remaining_wh_x10 = (uint32_t)((uint64_t)remaining_c100 * cells * RANGE_CELL_NOMINAL_MV / 10000);
+    } else if (snapshot->voltage_c100 > 0 && cells > 0) {
+        source = RANGE_SOURCE_VOLTAGE;
+        // Open-circuit estimate: add back the sag of the current draw
+        int32_t pack_mv = snapshot->voltage_c100 * 10 +
+                          snapshot->current_in_c100 * RANGE_PACK_RESISTANCE_MOHM / 100;
+        int32_t sample_q4 = (pack_mv / cells) << 4;
+        if (cell_mv_q4 == 0) {
+            cell_mv_q4 = sample_q4;
+        } else {
+            cell_mv_q4 += (sample_q4 - cell_mv_q4) >> RANGE_VOLTAGE_FILTER_SHIFT;
+        }
+        soc_permille = ocv_to_soc_permille(cell_mv_q4 >> 4);
+        remaining_wh_x10 = (uint32_t)((uint64_t)soc_permille * pack_capacity_mah * cells *
+                                      RANGE_CELL_NOMINAL_MV / 100000000);
+    }
+
+    // Band from the consumption spread and the energy source uncertainty
+    uint32_t error_pct = source == RANGE_SOURCE_BMS ? RANGE_BMS_ENERGY_ERROR_PCT : RANGE_VOLTAGE_ENERGY_ERROR_PCT;
+    int32_t low_consumption = wh_per_km_x10 - 2 * deviation_x10;
+    if (low_consumption < RANGE_MIN_WH_PER_KM_X10) {
+        low_consumption = RANGE_MIN_WH_PER_KM_X10;
+    }
+    int32_t high_consumption = wh_per_km_x10 + 2 * deviation_x10;
+
+    uint64_t energy = (uint64_t)remaining_wh_x10 * 1000;
+    uint32_t range_m = (uint32_t)(energy / wh_per_km_x10);
+    uint32_t range_low_m = (uint32_t)(energy * (100 - error_pct) / 100 / high_consumption);
+    uint32_t range_high_m = (uint32_t)(energy * (100 + error_pct) / 100 / low_consumption);
+
+    portENTER_CRITICAL(&estimate_lock);
+    estimate.source = source;
+    estimate.soc_pct = soc_permille / 10;
+    estimate.remaining_wh_x10 = remaining_wh_x10;
+    estimate.wh_per_km_x10 = wh_per_km_x10;
+    estimate.windows = windows;
+    estimate.range_m = range_m;
+    estimate.range_low_m = range_low_m;
+    estimate.range_high_m = range_high_m;
+    portEXIT_CRITICAL(&estimate_lock);
+}
+
+esp_err_t range_init(void)
+{
+    settings_t settings;
+    settings_get(&settings);
+    range_set_pack(settings.pack_cells_series, settings.pack_capacity_mah);
+
+    ride_stats_persist_t totals;
+    ride_stats_get_persist(&totals);
+    window_start_mm = odometer_get_trip_mm();
+    window_start_mwh = (int64_t)totals.energy_drawn_mwh - totals.energy_regen_mwh;
+
+    return telemetry_register_callback(on_telemetry, NULL);
+}
+
+void range_set_pack(uint8_t cells_series, uint16_t capacity_mah)
+{
+    pack_cells = cells_series;
+    pack_capacity_mah = capacity_mah;
+    ESP_LOGI(TAG, "Pack: %uS, %u mAh", cells_series, capacity_mah);
+}
+
+void range_get_estimate(range_estimate_t *out)
+{
+    portENTER_CRITICAL(&estimate_lock);
+    *out = estimate;
+    portEXIT_CRITICAL(&estimate_lock);
+}
+
+const char *range_source_name(range_source_t source)
+{
+    switch (source) {
+        case RANGE_SOURCE_BMS:
+            return "BMS";
+        case RANGE_SOURCE_VOLTAGE:
+            return "voltage";
+        default:
+            return "none";
+    }
+}
@@ -0,0 +1,54 @@
+#ifndef RANGE_H
+#define RANGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Remaining range estimate, updated on every telemetry frame.
+//
+// Remaining energy comes from the BMS remaining capacity when a BMS reports
+// in. Without a BMS it comes from the VESC pack voltage: the voltage is
+// compensated for sag (V + I * R), filtered, and mapped through a Li-ion
+// open-circuit voltage curve to a state of charge of the configured pack.
+//
+// Consumption is an exponentially weighted average of net Wh/km over
+// RANGE_WINDOW_M distance windows. Its mean absolute deviation, together
+// with the uncertainty of the energy source, gives the confidence band.
+
+#define RANGE_WINDOW_M                  250
+#define RANGE_EWMA_SHIFT                2       // alpha = 1/4 per window
+#define RANGE_DEFAULT_WH_PER_KM_X10     150     // Until the first window closes
+#define RANGE_MIN_WH_PER_KM_X10         30      // Floor for downhill/regen windows
+#define RANGE_PACK_RESISTANCE_MOHM      150     // Sag compensation, whole pack
+#define RANGE_CELL_NOMINAL_MV           3600
+#define RANGE_VOLTAGE_FILTER_SHIFT      3       // alpha = 1/8 per frame
+#define RANGE_BMS_ENERGY_ERROR_PCT      5
+#define RANGE_VOLTAGE_ENERGY_ERROR_PCT  15
+
+#define RANGE_DEFAULT_PACK_CELLS        10
+#define RANGE_DEFAULT_PACK_CAPACITY_MAH 6000
+
+typedef enum {
+    RANGE_SOURCE_NONE = 0,
+    RANGE_SOURCE_BMS,
+    RANGE_SOURCE_VOLTAGE,
+} range_source_t;
+
+typedef struct {
+    range_source_t source;
+    uint8_t soc_pct;
+    uint32_t remaining_wh_x10;      // 0.1 Wh
+    int32_t wh_per_km_x10;          // Weighted recent consumption, 0.1 Wh/km
+    uint32_t windows;               // Consumption windows seen since boot
+    uint32_t range_m;
+    uint32_t range_low_m;
+    uint32_t range_high_m;
+} range_estimate_t;
+
+esp_err_t range_init(void);
+void range_set_pack(uint8_t cells_series, uint16_t capacity_mah);
+void range_get_estimate(range_estimate_t *estimate);
+const char *range_source_name(range_source_t source);
+
+#endif // RANGE_H
@@ -0,0 +1,559 @@
+#include "residency.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "perfmon.h"
+#include "bench_pinned.h"
+#include "ui_updater.h"
+#include "fonts.h"
+#include "images.h"
+
+#define TAG "RESIDENCY"
+
+#define PERF_CYCLES         0
+#define PERF_INSNS          1
+
+typedef enum {
+    ASSET_FONT,
+    ASSET_IMG,
+} asset_kind_t;
+
+typedef struct {
+    const char *name;
+    asset_kind_t kind;
+    const void *flash;              // lv_font_t or lv_img_dsc_t
+    const char *letters;            // Fonts: ASCII glyphs to copy
+    residency_tier_t tier;
+} residency_spec_t;
+
+// In priority order, an entry that does not fit its tier's remaining budget
+// stays in flash and the next one is tried
+static const residency_spec_t table[] = {
+    { "bebas150 digits",  ASSET_FONT, &ui_font_bebas150,     "0123456789", RESIDENCY_INTERNAL },
+    { "connection_0",     ASSET_IMG,  &img_connection_0,     NULL,         RESIDENCY_INTERNAL },
+    { "connection_33",    ASSET_IMG,  &img_33_connection,    NULL,         RESIDENCY_INTERNAL },
+    { "connection_66",    ASSET_IMG,  &img_66_connection,    NULL,         RESIDENCY_INTERNAL },
+    { "connection_100",   ASSET_IMG,  &img_100_connection,   NULL,         RESIDENCY_INTERNAL },
+    { "battery",          ASSET_IMG,  &img_battery,          NULL,         RESIDENCY_INTERNAL },
+    { "battery_charging", ASSET_IMG,  &img_battery_charging, NULL,         RESIDENCY_INTERNAL },
+};
+#define TABLE_SIZE (sizeof(table) / sizeof(table[0]))
+
+// The font must stay first, resident_glyph_bitmap gets it and casts back
+typedef struct {
+    lv_font_t font;
+    const lv_font_t *flash;
+    uint8_t count;
+    uint32_t letters[RESIDENCY_MAX_GLYPHS];
+    const uint8_t *bitmaps[RESIDENCY_MAX_GLYPHS];
+} resident_font_t;
+
+typedef struct {
+    residency_tier_t placed;
+    size_t bytes;
+    uint8_t *data;
+    resident_font_t *font;
+    lv_img_dsc_t *img;
+} residency_slot_t;
+
+static residency_slot_t slots[TABLE_SIZE];
+static residency_status_t status;
+static bool initialized = false;
+
+static const uint8_t *resident_glyph_bitmap(const lv_font_t *font, uint32_t letter)
+{
+    const resident_font_t *resident = (const resident_font_t *)font;
+    for (uint8_t i = 0; i < resident->count; i++) {
+        if (resident->letters[i] == letter) {
+            return resident->bitmaps[i];
+        }
+    }
+    return resident->flash->get_glyph_bitmap(resident->flash, letter);
+}
+
+// Flash bitmap and size of one glyph, 0 if the font has no such letter
+static size_t glyph_in_flash(const lv_font_t *font, uint32_t letter, const uint8_t **bitmap)
+{
+    lv_font_glyph_dsc_t dsc;
+    if (!lv_font_get_glyph_dsc_fmt_txt(font, &dsc, letter, 0)) {
+        return 0;
+    }
+    *bitmap = lv_font_get_bitmap_fmt_txt(font, letter);
+    if (*bitmap == NULL) {
+        return 0;
+    }
+    return ((size_t)dsc.box_w * dsc.box_h * dsc.bpp + 7) / 8;
+}
+
+// Bytes the entry needs in RAM, 0 if it cannot be made resident
+static size_t entry_bytes(const residency_spec_t *spec)
+{
+    if (spec->kind == ASSET_IMG) {
+        return ((const lv_img_dsc_t *)spec->flash)->data_size;
+    }
+
+    const lv_font_t *font = spec->flash;
+    const lv_font_fmt_txt_dsc_t *dsc = font->dsc;
+    // Compressed glyphs are decoded into a scratch buffer per draw, a copy
+    // would not save any flash reads
+    if (font->get_glyph_bitmap != lv_font_get_bitmap_fmt_txt ||
+        dsc->bitmap_format != LV_FONT_FMT_TXT_PLAIN ||
+        strlen(spec->letters) > RESIDENCY_MAX_GLYPHS) {
+        return 0;
+    }
+
+    size_t total = 0;
+    for (const char *c = spec->letters; *c; c++) {
+        const uint8_t *bitmap;
+        total += glyph_in_flash(font, (uint8_t)*c, &bitmap);
+    }
+    return total;
+}
+
+static uint32_t tier_caps(residency_tier_t tier)
+{
+    return tier == RESIDENCY_PSRAM ? MALLOC_CAP_SPIRAM : MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+}
+
+static void free_slot(residency_slot_t *slot)
+{
+    heap_caps_free(slot->data);
+    heap_caps_free(slot->font);
+    heap_caps_free(slot->img);
+    memset(slot, 0, sizeof(*slot));
+}
+
+static esp_err_t place_font(const residency_spec_t *spec, residency_slot_t *slot)
+{
+    const lv_font_t *flash = spec->flash;
+    slot->font = heap_caps_calloc(1, sizeof(resident_font_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (slot->font == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    resident_font_t *resident = slot->font;
+    resident->font = *flash;
+    resident->font.get_glyph_bitmap = resident_glyph_bitmap;
+    resident->flash = flash;
+
+    uint8_t *dest = slot->data;
+    for (const char *c = spec->letters; *c; c++) {
+        const uint8_t *bitmap;
+        size_t size = glyph_in_flash(flash, (uint8_t)*c, &bitmap);
+        if (size == 0) {
+            continue;
+        }
+        memcpy(dest, bitmap, size);
+        resident->letters[resident->count] = (uint8_t)*c;
+        resident->bitmaps[resident->count] = dest;
+        resident->count++;
+        dest += size;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t place_img(const residency_spec_t *spec, residency_slot_t *slot)
+{
+    const lv_img_dsc_t *flash = spec->flash;
+    slot->img = heap_caps_malloc(sizeof(lv_img_dsc_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (slot->img == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    *slot->img = *flash;
+    memcpy(slot->data, flash->data, flash->data_size);
+    slot->img->data = slot->data;
+    return ESP_OK;
+}
+
+esp_err_t residency_init(void)
+{
+    if (initialized) {
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    memset(&status, 0, sizeof(status));
+
+    for (size_t i = 0; i < TABLE_SIZE; i++) {
+        const residency_spec_t *spec = &table[i];
+        residency_slot_t *slot = &slots[i];
+        slot->bytes = entry_bytes(spec);
+        slot->placed = RESIDENCY_FLASH;
+        if (slot->bytes == 0 || spec->tier == RESIDENCY_FLASH) {
+            continue;
+        }
+
+        size_t *used = spec->tier == RESIDENCY_PSRAM ? &status.psram_used : &status.internal_used;
+        size_t budget = spec->tier == RESIDENCY_PSRAM ? RESIDENCY_PSRAM_BUDGET : RESIDENCY_INTERNAL_BUDGET;
+        if (*used + slot->bytes > budget) {
+            ESP_LOGI(TAG, "%s (%u bytes) over the %s budget, stays in flash",
+                     spec->name, slot->bytes, residency_tier_name(spec->tier));
+            continue;
+        }
+
+        slot->data = heap_caps_malloc(slot->bytes, tier_caps(spec->tier));
+        esp_err_t ret = slot->data == NULL ? ESP_ERR_NO_MEM :
+                        spec->kind == ASSET_FONT ? place_font(spec, slot) : place_img(spec, slot);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "%s: no %s memory, stays in flash", spec->name, residency_tier_name(spec->tier));
+            size_t bytes = slot->bytes;
+            free_slot(slot);
+            slot->bytes = bytes;
+            continue;
+        }
+
+        slot->placed = spec->tier;
+        *used += slot->bytes;
+    }
+
+    status.copy_us = (uint32_t)(esp_timer_get_time() - start);
+    status.entry_count = TABLE_SIZE;
+    initialized = true;
+    ESP_LOGI(TAG, "Resident: %u bytes internal, %u bytes PSRAM, copied in %lu us",
+             status.internal_used, status.psram_used, status.copy_us);
+    return ESP_OK;
+}
+
+const lv_font_t *residency_font(const lv_font_t *font)
+{
+    for (size_t i = 0; i < TABLE_SIZE; i++) {
+        if (table[i].flash == font && slots[i].font != NULL) {
+            return &slots[i].font->font;
+        }
+    }
+    return font;
+}
+
+const lv_img_dsc_t *residency_img(const lv_img_dsc_t *img)
+{
+    for (size_t i = 0; i < TABLE_SIZE; i++) {
+        if (table[i].flash == img && slots[i].img != NULL) {
+            return slots[i].img;
+        }
+    }
+    return img;
+}
+
+static lv_obj_tree_walk_res_t apply_cb(lv_obj_t *obj, void *user_data)
+{
+    uint32_t *swapped = user_data;
+    lv_style_value_t value;
+    lv_style_selector_t selector = LV_PART_MAIN | LV_STATE_DEFAULT;
+
+    if (lv_obj_get_local_style_prop(obj, LV_STYLE_TEXT_FONT, &value, selector) == LV_STYLE_RES_FOUND) {
+        const lv_font_t *font = residency_font(value.ptr);
+        if (font != value.ptr) {
+            lv_obj_set_style_text_font(obj, font, selector);
+            (*swapped)++;
+        }
+    }
+
+    if (lv_obj_check_type(obj, &lv_img_class)) {
+        const void *src = lv_img_get_src(obj);
+        if (src != NULL && lv_img_src_get_type(src) == LV_IMG_SRC_VARIABLE) {
+            const lv_img_dsc_t *img = residency_img(src);
+            if (img != src) {
+                lv_img_set_src(obj, img);
+                (*swapped)++;
+            }
+        }
+    }
+    return LV_OBJ_TREE_WALK_NEXT;
+}
+
+void residency_apply(void)
+{
+    if (!initialized || !take_lvgl_mutex()) {
+        return;
+    }
+
+    uint32_t swapped = 0;
+    lv_disp_t *disp = lv_disp_get_default();
+    for (uint32_t i = 0; disp != NULL && i < disp->screen_cnt; i++) {
+        lv_obj_tree_walk(disp->screens[i], apply_cb, &swapped);
+    }
+    give_lvgl_mutex();
+
+    ESP_LOGI(TAG, "Swapped %lu font and image references", swapped);
+}
+
+void residency_get_status(residency_status_t *out)
+{
+    *out = status;
+}
+
+bool residency_get_entry(size_t index, residency_entry_status_t *entry)
+{
+    if (index >= TABLE_SIZE) {
+        return false;
+    }
+    entry->name = table[index].name;
+    entry->wanted = table[index].tier;
+    entry->placed = slots[index].placed;
+    entry->bytes = slots[index].bytes;
+    return true;
+}
+
+const char *residency_tier_name(residency_tier_t tier)
+{
+    switch (tier) {
+        case RESIDENCY_FLASH:    return "flash";
+        case RESIDENCY_INTERNAL: return "internal";
+        case RESIDENCY_PSRAM:    return "psram";
+        default:                 return "unknown";
+    }
+}
+
+// Measurement
+
+typedef struct {
+    lv_obj_t *label;
+    residency_bench_result_t *results;
+    size_t max_results;
+    size_t count;
+    esp_err_t ret;
+} bench_job_t;
+
+static portMUX_TYPE bench_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint32_t bench_sink;
+
+static void counters_start(void)
+{
+    xtensa_perfmon_stop();
+    xtensa_perfmon_reset(PERF_CYCLES);
+    xtensa_perfmon_reset(PERF_INSNS);
+    xtensa_perfmon_start();
+}
+
+static void counters_stop(uint64_t *cycles, uint64_t *stalls)
+{
+    xtensa_perfmon_stop();
+    uint32_t c = xtensa_perfmon_value(PERF_CYCLES);
+    uint32_t n = xtensa_perfmon_value(PERF_INSNS);
+    *cycles += c;
+    *stalls += c > n ? c - n : 0;
+}
+
+static uint32_t read_bytes(const uint8_t *data, size_t len)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i < len; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+// Pushes earlier reads out of the data cache with a never resident asset
+static void evict_cache(void)
+{
+    size_t len = img_splash.data_size < RESIDENCY_EVICT_BYTES ? img_splash.data_size : RESIDENCY_EVICT_BYTES;
+    bench_sink += read_bytes(img_splash.data, len);
+}
+
+// The asset as drawing reads it: glyph by glyph from the flash font, or
+// the contiguous copy when copy is set
+static uint32_t read_asset(const residency_spec_t *spec, const uint8_t *copy, size_t bytes)
+{
+    if (copy != NULL) {
+        return read_bytes(copy, bytes);
+    }
+    if (spec->kind == ASSET_IMG) {
+        return read_bytes(((const lv_img_dsc_t *)spec->flash)->data, bytes);
+    }
+
+    uint32_t sum = 0;
+    for (const char *c = spec->letters; *c; c++) {
+        const uint8_t *bitmap;
+        size_t size = glyph_in_flash(spec->flash, (uint8_t)*c, &bitmap);
+        sum += read_bytes(bitmap, size);
+    }
+    return sum;
+}
+
+static void bench_reads(const residency_spec_t *spec, const uint8_t *copy, size_t bytes,
+                        residency_bench_result_t *result)
+{
+    uint64_t cold = 0, cold_stall = 0, warm = 0, warm_stall = 0;
+
+    for (int run = 0; run < RESIDENCY_BENCH_RUNS; run++) {
+        portENTER_CRITICAL(&bench_lock);
+        evict_cache();
+        counters_start();
+        bench_sink += read_asset(spec, copy, bytes);
+        counters_stop(&cold, &cold_stall);
+        counters_start();
+        bench_sink += read_asset(spec, copy, bytes);
+        counters_stop(&warm, &warm_stall);
+        portEXIT_CRITICAL(&bench_lock);
+    }
+
+    result->cold_cycles = cold / RESIDENCY_BENCH_RUNS;
+    result->cold_stall_cycles = cold_stall / RESIDENCY_BENCH_RUNS;
+    result->warm_cycles = warm / RESIDENCY_BENCH_RUNS;
+    result->warm_stall_cycles = warm_stall / RESIDENCY_BENCH_RUNS;
+}
+
+static residency_bench_result_t *next_result(bench_job_t *job, const char *name,
+                                             residency_tier_t tier, size_t bytes)
+{
+    if (job->count >= job->max_results) {
+        return NULL;
+    }
+    residency_bench_result_t *result = &job->results[job->count++];
+    memset(result, 0, sizeof(*result));
+    result->name = name;
+    result->tier = tier;
+    result->bytes = bytes;
+    return result;
+}
+
+// Every asset from all three tiers, with temporary copies where the boot
+// placement did not make one
+static void bench_assets(bench_job_t *job)
+{
+    for (size_t i = 0; i < TABLE_SIZE; i++) {
+        const residency_spec_t *spec = &table[i];
+        size_t bytes = slots[i].bytes;
+        if (bytes == 0) {
+            continue;
+        }
+
+        for (residency_tier_t tier = RESIDENCY_FLASH; tier <= RESIDENCY_PSRAM; tier++) {
+            uint8_t *copy = NULL;
+            bool temporary = false;
+            if (tier != RESIDENCY_FLASH) {
+                if (slots[i].placed == tier) {
+                    copy = slots[i].data;
+                } else {
+                    copy = heap_caps_malloc(bytes, tier_caps(tier));
+                    if (copy == NULL) {
+                        continue;
+                    }
+                    temporary = true;
+                    if (spec->kind == ASSET_IMG) {
+                        memcpy(copy, ((const lv_img_dsc_t *)spec->flash)->data, bytes);
+                    } else {
+                        uint8_t *dest = copy;
+                        for (const char *c = spec->letters; *c; c++) {
+                            const uint8_t *bitmap;
+                            size_t size = glyph_in_flash(spec->flash, (uint8_t)*c, &bitmap);
+                            memcpy(dest, bitmap, size);
+                            dest += size;
+                        }
+                    }
+                }
+            }
+
+            residency_bench_result_t *result = next_result(job, spec->name, tier, bytes);
+            if (result != NULL) {
+                bench_reads(spec, copy, bytes, result);
+            }
+            if (temporary) {
+                heap_caps_free(copy);
+            }
+        }
+    }
+}
+
+// Full refresh of the label's area with the given font, flush included
+static void bench_draw(lv_obj_t *label, const lv_font_t *font, residency_bench_result_t *result)
+{
+    uint64_t cold = 0, cold_stall = 0, warm = 0, warm_stall = 0;
+
+    lv_obj_set_style_text_font(label, font, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_refr_now(NULL);
+
+    for (int run = 0; run < RESIDENCY_BENCH_RUNS; run++) {
+        evict_cache();
+        lv_obj_invalidate(label);
+        counters_start();
+        lv_refr_now(NULL);
+        counters_stop(&cold, &cold_stall);
+
+        lv_obj_invalidate(label);
+        counters_start();
+        lv_refr_now(NULL);
+        counters_stop(&warm, &warm_stall);
+    }
+
+    result->cold_cycles = cold / RESIDENCY_BENCH_RUNS;
+    result->cold_stall_cycles = cold_stall / RESIDENCY_BENCH_RUNS;
+    result->warm_cycles = warm / RESIDENCY_BENCH_RUNS;
+    result->warm_stall_cycles = warm_stall / RESIDENCY_BENCH_RUNS;
+}
+
+static void bench_task(void *arg)
+{
+    bench_job_t *job = arg;
+
+    xtensa_perfmon_init(PERF_CYCLES, XTPERF_CNT_CYCLES, XTPERF_MASK_CYCLES, 0, -1);
+    xtensa_perfmon_init(PERF_INSNS, XTPERF_CNT_INSN, XTPERF_MASK_INSN_ALL, 0, -1);
+
+    bench_assets(job);
+
+    if (job->label != NULL && take_lvgl_mutex()) {
+        if (lv_obj_get_screen(job->label) != lv_scr_act()) {
+            job->ret = ESP_ERR_INVALID_STATE;
+        } else {
+            lv_style_value_t value;
+            const lv_font_t *original = lv_obj_get_style_text_font(job->label, LV_PART_MAIN);
+            bool local = lv_obj_get_local_style_prop(job->label, LV_STYLE_TEXT_FONT, &value,
+                                                     LV_PART_MAIN | LV_STATE_DEFAULT) == LV_STYLE_RES_FOUND;
+            const lv_font_t *flash = original;
+            for (size_t i = 0; i < TABLE_SIZE; i++) {
+                if (slots[i].font != NULL && original == &slots[i].font->font) {
+                    flash = slots[i].font->flash;
+                }
+            }
+            const lv_font_t *resident = residency_font(flash);
+
+            residency_bench_result_t *result = next_result(job, "label draw", RESIDENCY_FLASH, 0);
+            if (result != NULL) {
+                bench_draw(job->label, flash, result);
+            }
+            if (resident != flash) {
+                size_t i = 0;
+                while (table[i].flash != flash) {
+                    i++;
+                }
+                result = next_result(job, "label draw", slots[i].placed, 0);
+                if (result != NULL) {
+                    bench_draw(job->label, resident, result);
+                }
+            }
+
+            if (local) {
+                lv_obj_set_style_text_font(job->label, original, LV_PART_MAIN | LV_STATE_DEFAULT);
+            } else {
+                lv_obj_remove_local_style_prop(job->label, LV_STYLE_TEXT_FONT, LV_PART_MAIN | LV_STATE_DEFAULT);
+            }
+        }
+        give_lvgl_mutex();
+    }
+}
+
+esp_err_t residency_bench(lv_obj_t *label, residency_bench_result_t *results,
+                          size_t max_results, size_t *count)
+{
+    if (!initialized || results == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    bench_job_t job = {
+        .label = label,
+        .results = results,
+        .max_results = max_results,
+        .ret = ESP_OK,
+    };
+
+    esp_err_t err = bench_run_pinned("residency_bench", bench_task, &job);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    *count = job.count;
+    return job.ret;
+}
@@ -0,0 +1,95 @@
+#ifndef RESIDENCY_H
+#define RESIDENCY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+// Copies of hot UI assets in RAM, so LVGL stops drawing them through the
+// flash cache.
+//
+// Fonts and images are const arrays in flash, read through the 32 KB data
+// cache. A large speed digit is about 2.8 KB of 4 bpp glyph and a status
+// icon about 7 KB of RGB565 plus alpha, and every redraw misses on most of
+// those lines again after the cache has moved on. At boot the assets in
+// the table in residency.c are copied to internal RAM, or to PSRAM for
+// entries that ask for it, as long as the tier's budget allows. Anything
+// over budget stays in flash.
+//
+//   Fonts   only the listed glyphs are copied. The RAM font is a copy of
+//           the flash descriptor whose bitmap callback serves those glyphs
+//           from RAM and passes the rest to the flash font.
+//   Images  the whole pixel array is copied under a new descriptor.
+//
+// residency_apply() swaps the copies into the styles and image sources of
+// every screen. Code that sets a listed asset later should pass it through
+// residency_font() or residency_img() first.
+//
+// PSRAM (40 MHz quad) sits behind the same data cache as flash (80 MHz DIO)
+// and streams at about the same rate, so it only pays off for assets that
+// would not fit the internal budget anyway. residency_bench() measures all
+// three placements on the device.
+//
+// Hot code is placed in IRAM by linker.lf and CONFIG_LV_ATTRIBUTE_FAST_MEM_USE_IRAM.
+
+#define RESIDENCY_INTERNAL_BUDGET   (64 * 1024)
+#define RESIDENCY_PSRAM_BUDGET      (256 * 1024)
+#define RESIDENCY_MAX_GLYPHS        16
+// Bytes read from a flash asset that is never resident to push the
+// measured data out of the cache before a cold run
+#define RESIDENCY_EVICT_BYTES       (64 * 1024)
+#define RESIDENCY_BENCH_RUNS        16
+#define RESIDENCY_BENCH_MAX_RESULTS 32
+
+typedef enum {
+    RESIDENCY_FLASH = 0,            // Not copied, drawn from flash
+    RESIDENCY_INTERNAL,
+    RESIDENCY_PSRAM,
+} residency_tier_t;
+
+typedef struct {
+    const char *name;
+    residency_tier_t wanted;
+    residency_tier_t placed;        // RESIDENCY_FLASH if over budget or out of memory
+    size_t bytes;
+} residency_entry_status_t;
+
+typedef struct {
+    size_t internal_used;
+    size_t psram_used;
+    uint32_t copy_us;               // Time spent copying at boot
+    size_t entry_count;
+} residency_status_t;
+
+// One placement of one asset, cold runs start with an evicted cache
+typedef struct {
+    const char *name;
+    residency_tier_t tier;
+    size_t bytes;
+    uint32_t cold_cycles;           // Averages over RESIDENCY_BENCH_RUNS
+    uint32_t cold_stall_cycles;     // Cycles without a retired instruction, mostly cache misses
+    uint32_t warm_cycles;
+    uint32_t warm_stall_cycles;
+} residency_bench_result_t;
+
+// Copies the table, call before the UI is built
+esp_err_t residency_init(void);
+// Swaps resident copies into every screen, under the LVGL mutex
+void residency_apply(void);
+// Resident copy of a font or image from the table, else the argument
+const lv_font_t *residency_font(const lv_font_t *font);
+const lv_img_dsc_t *residency_img(const lv_img_dsc_t *img);
+
+void residency_get_status(residency_status_t *status);
+bool residency_get_entry(size_t index, residency_entry_status_t *entry);
+const char *residency_tier_name(residency_tier_t tier);
+
+// Reads every table asset from flash, internal RAM and PSRAM, then redraws
+// the label once with its flash font and once with its resident font.
+// Runs pinned to the LVGL core and blocks for up to a few seconds.
+esp_err_t residency_bench(lv_obj_t *label, residency_bench_result_t *results,
+                          size_t max_results, size_t *count);
+
+#endif // RESIDENCY_H
@@ -0,0 +1,454 @@
+#include "ride_recorder.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "throttle.h"
+#include "ble.h"
+
+#define TAG "RIDE_LOG"
+
+#define RIDE_LOG_HEADER_SIZE     sizeof(ride_log_block_header_t)
+#define RIDE_LOG_PAYLOAD_SIZE    (RIDE_LOG_BLOCK_SIZE - RIDE_LOG_HEADER_SIZE)
+// dt plus every channel at the 5-byte varint worst case
+#define RIDE_LOG_MAX_RECORD_SIZE ((RIDE_CH_COUNT + 1) * 5)
+
+static const esp_partition_t *partition = NULL;
+static uint32_t sector_count = 0;
+static uint32_t next_sector = 0;
+static uint32_t last_seq = 0;
+static uint32_t boot_id = 0;
+
+// PSRAM staging ring, RIDE_LOG_BUFFER_BLOCKS blocks of RIDE_LOG_BLOCK_SIZE
+static uint8_t *staging = NULL;
+static uint32_t staging_blocks = 0;
+static uint32_t fill_index = 0;
+static uint32_t flush_index = 0;
+static uint32_t pending_blocks = 0;
+
+// State of the block being filled, owned by whoever holds state_mutex
+static int32_t prev_values[RIDE_CH_COUNT];
+static int64_t last_record_us = 0;
+static int64_t period_us = 1000000 / RIDE_LOG_DEFAULT_RATE_HZ;
+static uint32_t rate_hz = RIDE_LOG_DEFAULT_RATE_HZ;
+
+static uint32_t records_total = 0;
+static uint32_t records_dropped = 0;
+static uint32_t blocks_written = 0;
+static uint32_t payload_bytes_written = 0;
+
+static SemaphoreHandle_t state_mutex = NULL;
+static SemaphoreHandle_t flash_mutex = NULL;
+static TaskHandle_t writer_task_handle = NULL;
+
+static inline uint8_t *block_ptr(uint32_t index)
+{
+    return staging + (size_t)index * RIDE_LOG_BLOCK_SIZE;
+}
+
+static inline ride_log_block_header_t *block_header(uint32_t index)
+{
+    return (ride_log_block_header_t *)block_ptr(index);
+}
+
+static size_t put_uvarint(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static size_t put_svarint(uint8_t *out, int32_t value)
+{
+    return put_uvarint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static void start_block(uint32_t index)
+{
+    uint8_t *block = block_ptr(index);
+    // Erased flash reads 0xFF, pad the same way so the whole sector is written once
+    memset(block, 0xFF, RIDE_LOG_BLOCK_SIZE);
+
+    ride_log_block_header_t *header = block_header(index);
+    memset(header, 0, RIDE_LOG_HEADER_SIZE);
+    header->magic = RIDE_LOG_BLOCK_MAGIC;
+    header->version = RIDE_LOG_BLOCK_VERSION;
+    header->boot_id = boot_id;
+
+    memset(prev_values, 0, sizeof(prev_values));
+}
+
+// Caller holds state_mutex
+static void close_fill_block(void)
+{
+    if (block_header(fill_index)->record_count == 0) {
+        return;
+    }
+    pending_blocks++;
+    fill_index = (fill_index + 1) % staging_blocks;
+    if (pending_blocks < staging_blocks) {
+        start_block(fill_index);
+    }
+    if (writer_task_handle != NULL) {
+        xTaskNotifyGive(writer_task_handle);
+    }
+}
+
+static void collect_values(const telemetry_snapshot_t *snapshot, int32_t *values)
+{
+#define RIDE_CH_VALUE(id) values[RIDE_CH_##id] = telemetry_field_get(snapshot, TELEMETRY_FIELD_##id);
+    RIDE_LOG_TELEMETRY_FIELDS(RIDE_CH_VALUE)
+#undef RIDE_CH_VALUE
+    values[RIDE_CH_THROTTLE_RAW] = throttle_get_latest_raw();
+    values[RIDE_CH_THROTTLE_MAPPED] = throttle_get_latest_mapped();
+    values[RIDE_CH_THROTTLE_SENT] = get_last_throttle_sent();
+    values[RIDE_CH_RSSI] = get_latest_rssi();
+    values[RIDE_CH_NUM_CELLS] = snapshot->bms_num_cells;
+    for (int i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+        values[RIDE_CH_CELL0 + i] = snapshot->cell_mv[i];
+    }
+}
+
+static void on_telemetry(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    if (staging == NULL || rate_hz == 0) {
+        return;
+    }
+    if (last_record_us != 0 && snapshot->rx_time_us - last_record_us < period_us) {
+        return;
+    }
+
+    // Never stall the Bluetooth stack on the recorder
+    if (xSemaphoreTake(state_mutex, 0) != pdTRUE) {
+        records_dropped++;
+        return;
+    }
+
+    if (pending_blocks >= staging_blocks) {
+        records_dropped++;
+        xSemaphoreGive(state_mutex);
+        return;
+    }
+
+    ride_log_block_header_t *header = block_header(fill_index);
+    if (header->payload_bytes + RIDE_LOG_MAX_RECORD_SIZE > RIDE_LOG_PAYLOAD_SIZE) {
+        close_fill_block();
+        if (pending_blocks >= staging_blocks) {
+            records_dropped++;
+            xSemaphoreGive(state_mutex);
+            return;
+        }
+        header = block_header(fill_index);
+    }
+
+    uint32_t now_ms = (uint32_t)(snapshot->rx_time_us / 1000);
+    uint32_t dt_ms = 0;
+    if (header->record_count == 0) {
+        header->start_time_ms = now_ms;
+    } else {
+        dt_ms = (uint32_t)((snapshot->rx_time_us - last_record_us) / 1000);
+    }
+
+    int32_t values[RIDE_CH_COUNT];
+    collect_values(snapshot, values);
+
+    uint8_t *out = block_ptr(fill_index) + RIDE_LOG_HEADER_SIZE + header->payload_bytes;
+    size_t n = put_uvarint(out, dt_ms);
+    for (int ch = 0; ch < RIDE_CH_CELL0 + values[RIDE_CH_NUM_CELLS]; ch++) {
+        n += put_svarint(out + n, values[ch] - prev_values[ch]);
+        prev_values[ch] = values[ch];
+    }
+
+    header->payload_bytes += n;
+    header->record_count++;
+    last_record_us = snapshot->rx_time_us;
+    records_total++;
+
+    xSemaphoreGive(state_mutex);
+}
+
+static uint32_t block_crc(const uint8_t *block)
+{
+    const ride_log_block_header_t *header = (const ride_log_block_header_t *)block;
+    uint32_t crc = esp_rom_crc32_le(0, block, offsetof(ride_log_block_header_t, crc));
+    return esp_rom_crc32_le(crc, block + RIDE_LOG_HEADER_SIZE, header->payload_bytes);
+}
+
+static size_t sector_offset(uint32_t sector)
+{
+    return RIDE_LOG_OFFSET + (size_t)sector * RIDE_LOG_BLOCK_SIZE;
+}
+
+static esp_err_t write_block(uint8_t *block)
+{
+    ride_log_block_header_t *header = (ride_log_block_header_t *)block;
+
+    xSemaphoreTake(flash_mutex, portMAX_DELAY);
+    header->seq = last_seq + 1;
+    header->crc = block_crc(block);
+
+    esp_err_t err = esp_partition_erase_range(partition, sector_offset(next_sector), RIDE_LOG_BLOCK_SIZE);
+    if (err == ESP_OK) {
+        err = esp_partition_write(partition, sector_offset(next_sector), block, RIDE_LOG_BLOCK_SIZE);
+    }
+    if (err == ESP_OK) {
+        last_seq = header->seq;
+        blocks_written++;
+        payload_bytes_written += header->payload_bytes;
+    } else {
+        ESP_LOGE(TAG, "Failed to write block to sector %lu: %s", next_sector, esp_err_to_name(err));
+    }
+    // A failed sector is skipped rather than retried forever
+    next_sector = (next_sector + 1) % sector_count;
+    xSemaphoreGive(flash_mutex);
+    return err;
+}
+
+static void writer_task(void *pvParameters)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));
+
+        // Close a partial block once telemetry has gone quiet
+        xSemaphoreTake(state_mutex, portMAX_DELAY);
+        if (pending_blocks < staging_blocks &&
+            block_header(fill_index)->record_count > 0 &&
+            (esp_timer_get_time() - last_record_us) / 1000 >= RIDE_LOG_IDLE_FLUSH_MS) {
+            close_fill_block();
+        }
+        xSemaphoreGive(state_mutex);
+
+        while (pending_blocks > 0) {
+            // Completed blocks are not touched by the producer until released below
+            if (partition != NULL) {
+                write_block(block_ptr(flush_index));
+            }
+
+            xSemaphoreTake(state_mutex, portMAX_DELAY);
+            bool was_full = (pending_blocks == staging_blocks);
+            flush_index = (flush_index + 1) % staging_blocks;
+            pending_blocks--;
+            if (was_full) {
+                start_block(fill_index);
+            }
+            xSemaphoreGive(state_mutex);
+        }
+    }
+}
+
+static esp_err_t scan_blocks(void)
+{
+    ride_log_block_header_t header;
+    bool found = false;
+    uint32_t newest_sector = 0;
+
+    for (uint32_t sector = 0; sector < sector_count; sector++) {
+        esp_err_t err = esp_partition_read(partition, sector_offset(sector), &header, sizeof(header));
+        if (err != ESP_OK) {
+            return err;
+        }
+        if (header.magic != RIDE_LOG_BLOCK_MAGIC || header.version != RIDE_LOG_BLOCK_VERSION) {
+            continue;
+        }
+        if (!found || (int32_t)(header.seq - last_seq) > 0) {
+            found = true;
+            last_seq = header.seq;
+            newest_sector = sector;
+        }
+        if ((int32_t)(header.boot_id - boot_id) > 0) {
+            boot_id = header.boot_id;
+        }
+    }
+
+    next_sector = found ? (newest_sector + 1) % sector_count : 0;
+    boot_id++;
+    return ESP_OK;
+}
+
+esp_err_t ride_recorder_init(void)
+{
+    state_mutex = xSemaphoreCreateMutex();
+    flash_mutex = xSemaphoreCreateMutex();
+    if (state_mutex == NULL || flash_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                         RIDE_LOG_PARTITION_LABEL);
+    if (partition == NULL || partition->size <= RIDE_LOG_OFFSET + RIDE_LOG_BLOCK_SIZE) {
+        ESP_LOGE(TAG, "No room for the ride log in '%s'", RIDE_LOG_PARTITION_LABEL);
+        partition = NULL;
+        return ESP_ERR_NOT_FOUND;
+    }
+    sector_count = (partition->size - RIDE_LOG_OFFSET) / RIDE_LOG_BLOCK_SIZE;
+
+    esp_err_t err = scan_blocks();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to scan ride log: %s", esp_err_to_name(err));
+        partition = NULL;
+        return err;
+    }
+
+    staging_blocks = RIDE_LOG_BUFFER_BLOCKS;
+    staging = heap_caps_malloc((size_t)staging_blocks * RIDE_LOG_BLOCK_SIZE, MALLOC_CAP_SPIRAM);
+    if (staging == NULL) {
+        ESP_LOGW(TAG, "No PSRAM for ride log staging, using two internal blocks");
+        staging_blocks = 2;
+        staging = heap_caps_malloc((size_t)staging_blocks * RIDE_LOG_BLOCK_SIZE, MALLOC_CAP_8BIT);
+        if (staging == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    start_block(fill_index);
+
+    xTaskCreate(writer_task, "ride_log_writer", 3072, NULL, 3, &writer_task_handle);
+
+    err = telemetry_register_callback(on_telemetry, NULL);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Ride log: %lu sectors, next %lu, last seq %lu, boot %lu",
+             sector_count, next_sector, last_seq, boot_id);
+    return ESP_OK;
+}
+
+esp_err_t ride_recorder_set_rate(uint32_t new_rate_hz)
+{
+    if (new_rate_hz > RIDE_LOG_MAX_RATE_HZ) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (new_rate_hz > 0) {
+        period_us = 1000000 / new_rate_hz;
+    }
+    rate_hz = new_rate_hz;
+    return ESP_OK;
+}
+
+void ride_recorder_get_status(ride_recorder_status_t *status)
+{
+    if (status == NULL) {
+        return;
+    }
+    status->flash_ok = (partition != NULL);
+    status->recording = (staging != NULL && rate_hz > 0);
+    status->rate_hz = rate_hz;
+    status->sector_count = sector_count;
+    status->next_sector = next_sector;
+    status->last_seq = last_seq;
+    status->boot_id = boot_id;
+    status->records = records_total;
+    status->dropped = records_dropped;
+    status->blocks_written = blocks_written;
+    status->payload_bytes_written = payload_bytes_written;
+}
+
+esp_err_t ride_recorder_flush(void)
+{
+    if (staging == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(state_mutex, portMAX_DELAY);
+    if (pending_blocks < staging_blocks) {
+        close_fill_block();
+    }
+    xSemaphoreGive(state_mutex);
+
+    // Wait for the writer to drain what is staged
+    for (int i = 0; i < 100 && pending_blocks > 0; i++) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    return pending_blocks == 0 ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
+typedef struct {
+    uint32_t seq;
+    uint16_t sector;
+} block_ref_t;
+
+static int compare_block_ref(const void *a, const void *b)
+{
+    int32_t diff = (int32_t)(((const block_ref_t *)a)->seq - ((const block_ref_t *)b)->seq);
+    return (diff > 0) - (diff < 0);
+}
+
+esp_err_t ride_recorder_export(ride_recorder_write_fn_t write_fn)
+{
+    if (partition == NULL || write_fn == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ride_recorder_flush();
+
+    block_ref_t *refs = malloc(sector_count * sizeof(block_ref_t));
+    uint8_t *block = malloc(RIDE_LOG_BLOCK_SIZE);
+    if (refs == NULL || block == NULL) {
+        free(refs);
+        free(block);
+        return ESP_ERR_NO_MEM;
+    }
+
+    xSemaphoreTake(flash_mutex, portMAX_DELAY);
+
+    uint32_t count = 0;
+    ride_log_block_header_t header;
+    for (uint32_t sector = 0; sector < sector_count; sector++) {
+        if (esp_partition_read(partition, sector_offset(sector), &header, sizeof(header)) == ESP_OK &&
+            header.magic == RIDE_LOG_BLOCK_MAGIC && header.version == RIDE_LOG_BLOCK_VERSION) {
+            refs[count].seq = header.seq;
+            refs[count].sector = sector;
+            count++;
+        }
+    }
+    qsort(refs, count, sizeof(block_ref_t), compare_block_ref);
+
+    char line[48];
+    int len = snprintf(line, sizeof(line), "RIDELOG %lu %d\n", count, RIDE_LOG_BLOCK_SIZE);
+    write_fn(line, len);
+
+    uint32_t sent = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        // Unreadable blocks are still sent so the count in the preamble holds;
+        // the host drops anything that fails its CRC
+        if (esp_partition_read(partition, sector_offset(refs[i].sector), block, RIDE_LOG_BLOCK_SIZE) != ESP_OK) {
+            memset(block, 0, RIDE_LOG_BLOCK_SIZE);
+        } else {
+            sent++;
+        }
+        write_fn(block, RIDE_LOG_BLOCK_SIZE);
+    }
+
+    write_fn("RIDELOG END\n", 12);
+    xSemaphoreGive(flash_mutex);
+
+    free(refs);
+    free(block);
+    ESP_LOGI(TAG, "Exported %lu of %lu blocks", sent, count);
+    return ESP_OK;
+}
+
+esp_err_t ride_recorder_erase(void)
+{
+    if (partition == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(flash_mutex, portMAX_DELAY);
+    esp_err_t err = esp_partition_erase_range(partition, RIDE_LOG_OFFSET,
+                                              (size_t)sector_count * RIDE_LOG_BLOCK_SIZE);
+    next_sector = 0;
+    xSemaphoreGive(flash_mutex);
+    return err;
+}
@@ -0,0 +1,99 @@
+#ifndef RIDE_RECORDER_H
+#define RIDE_RECORDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "odometer.h"
+#include "telemetry.h"
+#include "telemetry_schema.h"
+
+// The ride recorder samples every decoded telemetry frame plus the throttle
+// pipeline, encodes each sample as varint deltas against the previous one,
+// and packs samples into self-contained 4 KB blocks. Blocks are staged in
+// PSRAM and written to the storage partition one whole sector at a time,
+// behind the odometer log. When the region is full the oldest block is
+// overwritten.
+//
+// Write amplification: a block is only closed when less than one worst-case
+// record of space is left, so every sector erase carries at least
+// (4096 - header - max record) / 4096 = ~95% payload. The exception is the
+// partial block flushed after RIDE_LOG_IDLE_FLUSH_MS without telemetry.
+//
+// Retention: the ring gets what the storage partition leaves behind the
+// odometer log, 0x3E000 - 32 KB = 216 KB or 54 blocks with partitions.csv
+// as it is. fake_thumb.py's ride with a 12S pack encodes to about 28 bytes
+// a record (16 without cells, 32 with 16), 141 records to a block, so at
+// the default 10 Hz the log holds the last ~12 minutes of riding: ~2 hours
+// at 1 Hz, ~1.3 minutes at RIDE_LOG_MAX_RATE_HZ. Noisier real telemetry
+// needs more bytes a record; log_status prints the rate-based figure from
+// what was actually written.
+//
+// Block layout: ride_log_block_header_t, then records, then 0xFF padding.
+// Record layout: uvarint dt_ms, then one zigzag varint delta per channel
+// below, in order. The telemetry channels come first, in the order of
+// RIDE_LOG_TELEMETRY_FIELDS in telemetry_schema.h, raw as on the wire.
+// Cell channels are only present for the first num_cells cells. The first
+// record in a block is encoded against zero.
+
+#define RIDE_LOG_PARTITION_LABEL  ODOMETER_PARTITION_LABEL
+#define RIDE_LOG_OFFSET           (ODOMETER_LOG_OFFSET + ODOMETER_LOG_SIZE)
+#define RIDE_LOG_BLOCK_SIZE       4096
+#define RIDE_LOG_BUFFER_BLOCKS    8       // PSRAM staging, 32 KB
+#define RIDE_LOG_DEFAULT_RATE_HZ  10
+#define RIDE_LOG_MAX_RATE_HZ      100
+#define RIDE_LOG_IDLE_FLUSH_MS    5000
+
+#define RIDE_LOG_BLOCK_MAGIC      0x474F4C52  // "RLOG"
+#define RIDE_LOG_BLOCK_VERSION    1
+
+typedef enum {
+#define RIDE_CH_TELEMETRY(id) RIDE_CH_##id,
+    RIDE_LOG_TELEMETRY_FIELDS(RIDE_CH_TELEMETRY)
+#undef RIDE_CH_TELEMETRY
+    RIDE_CH_THROTTLE_RAW,       // ADC counts
+    RIDE_CH_THROTTLE_MAPPED,    // 0-255
+    RIDE_CH_THROTTLE_SENT,      // 0-255, value written over BLE
+    RIDE_CH_RSSI,               // dBm
+    RIDE_CH_NUM_CELLS,
+    RIDE_CH_CELL0,              // mV, followed by the remaining cells
+    RIDE_CH_COUNT = RIDE_CH_CELL0 + TELEMETRY_MAX_CELLS
+} ride_log_channel_t;
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_count;
+    uint32_t seq;               // Block sequence number, increases across the ring
+    uint32_t boot_id;           // Incremented on every boot that records
+    uint32_t start_time_ms;     // Time of the first record, ms since boot
+    uint16_t payload_bytes;
+    uint16_t reserved;
+    uint32_t crc;               // CRC32 of the header up to here, then the payload
+} ride_log_block_header_t;
+
+typedef struct {
+    bool flash_ok;
+    bool recording;
+    uint32_t rate_hz;
+    uint32_t sector_count;
+    uint32_t next_sector;
+    uint32_t last_seq;
+    uint32_t boot_id;
+    uint32_t records;           // Records encoded since boot
+    uint32_t dropped;           // Records dropped because staging was full
+    uint32_t blocks_written;
+    uint32_t payload_bytes_written;
+} ride_recorder_status_t;
+
+typedef void (*ride_recorder_write_fn_t)(const void *data, size_t len);
+
+esp_err_t ride_recorder_init(void);
+esp_err_t ride_recorder_set_rate(uint32_t rate_hz);
+void ride_recorder_get_status(ride_recorder_status_t *status);
+esp_err_t ride_recorder_flush(void);
+esp_err_t ride_recorder_export(ride_recorder_write_fn_t write_fn);
+esp_err_t ride_recorder_erase(void);
+
+#endif // RIDE_RECORDER_H
@@ -0,0 +1,143 @@
+#include "ride_stats.h"
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "telemetry.h"
+#include "kinematics.h"
+#include "odometer.h"
+
+#define TAG "RIDE_STATS"
+
+// Power is current_c100 * voltage_c100, in 1e-4 W; energy residuals are kept
+// in 1e-4 W * us until a whole mWh is reached
+#define ENERGY_UNITS_PER_MWH  36000000000ULL
+
+static ride_stats_t stats = {
+    .totals = {
+        .peak_temp_mos_c100 = RIDE_STATS_NO_TEMP,
+        .peak_temp_motor_c100 = RIDE_STATS_NO_TEMP,
+    },
+};
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Integrator state, only touched from the telemetry callback
+static int64_t last_frame_us = 0;
+static uint32_t last_speed_mm_s = 0;
+static int32_t last_power = 0;
+static uint64_t drawn_residual = 0;
+static uint64_t regen_residual = 0;
+static uint32_t ride_residual_us = 0;
+static uint32_t moving_residual_us = 0;
+
+static void update_derived_locked(uint64_t trip_mm)
+{
+    ride_stats_persist_t *t = &stats.totals;
+
+    stats.avg_speed_mm_s = t->moving_time_ms > 0 ? (uint32_t)(trip_mm * 1000 / t->moving_time_ms) : 0;
+
+    if (trip_mm >= (uint64_t)RIDE_STATS_MIN_WH_KM_DIST_M * 1000) {
+        // mWh / mm * 1e4 = 0.1 Wh/km
+        int64_t net_mwh = (int64_t)t->energy_drawn_mwh - t->energy_regen_mwh;
+        stats.wh_per_km_x10 = (int32_t)(net_mwh * 10000 / (int64_t)trip_mm);
+    } else {
+        stats.wh_per_km_x10 = 0;
+    }
+}
+
+static void on_telemetry(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    uint32_t speed_mm_s = kinematics_erpm_to_mm_s(snapshot->erpm);
+    int32_t power = (int32_t)snapshot->current_in_c100 * snapshot->voltage_c100;
+    uint64_t trip_mm = odometer_get_trip_mm();
+
+    int64_t dt_us = snapshot->rx_time_us - last_frame_us;
+    bool have_interval = last_frame_us != 0 && dt_us > 0 &&
+                         dt_us <= (int64_t)KINEMATICS_MAX_FRAME_GAP_MS * 1000;
+
+    uint64_t energy = have_interval ? (uint64_t)(last_power < 0 ? -(int64_t)last_power : last_power) * dt_us : 0;
+
+    portENTER_CRITICAL(&stats_lock);
+    ride_stats_persist_t *t = &stats.totals;
+
+    if (have_interval) {
+        ride_residual_us += dt_us;
+        t->ride_time_ms += ride_residual_us / 1000;
+        ride_residual_us %= 1000;
+
+        if (last_speed_mm_s >= RIDE_STATS_MOVING_MM_S) {
+            moving_residual_us += dt_us;
+            t->moving_time_ms += moving_residual_us / 1000;
+            moving_residual_us %= 1000;
+        }
+
+        if (last_power >= 0) {
+            drawn_residual += energy;
+            t->energy_drawn_mwh += drawn_residual / ENERGY_UNITS_PER_MWH;
+            drawn_residual %= ENERGY_UNITS_PER_MWH;
+        } else {
+            regen_residual += energy;
+            t->energy_regen_mwh += regen_residual / ENERGY_UNITS_PER_MWH;
+            regen_residual %= ENERGY_UNITS_PER_MWH;
+        }
+    }
+
+    if (speed_mm_s > t->max_speed_mm_s) {
+        t->max_speed_mm_s = speed_mm_s;
+    }
+    if (snapshot->temp_mos_c100 > t->peak_temp_mos_c100) {
+        t->peak_temp_mos_c100 = snapshot->temp_mos_c100;
+    }
+    if (snapshot->temp_motor_c100 > t->peak_temp_motor_c100) {
+        t->peak_temp_motor_c100 = snapshot->temp_motor_c100;
+    }
+
+    update_derived_locked(trip_mm);
+    portEXIT_CRITICAL(&stats_lock);
+
+    last_frame_us = snapshot->rx_time_us;
+    last_speed_mm_s = speed_mm_s;
+    last_power = power;
+}
+
+esp_err_t ride_stats_init(void)
+{
+    return telemetry_register_callback(on_telemetry, NULL);
+}
+
+void ride_stats_get(ride_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void ride_stats_reset(void)
+{
+    portENTER_CRITICAL(&stats_lock);
+    memset(&stats, 0, sizeof(stats));
+    stats.totals.peak_temp_mos_c100 = RIDE_STATS_NO_TEMP;
+    stats.totals.peak_temp_motor_c100 = RIDE_STATS_NO_TEMP;
+    drawn_residual = 0;
+    regen_residual = 0;
+    ride_residual_us = 0;
+    moving_residual_us = 0;
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGI(TAG, "Ride statistics reset");
+}
+
+void ride_stats_get_persist(ride_stats_persist_t *persist)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *persist = stats.totals;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void ride_stats_restore(const ride_stats_persist_t *persist)
+{
+    uint64_t trip_mm = odometer_get_trip_mm();
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.totals = *persist;
+    update_derived_locked(trip_mm);
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,43 @@
+#ifndef RIDE_STATS_H
+#define RIDE_STATS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Trip statistics, updated in O(1) from every telemetry frame. Each frame
+// closes the interval since the previous one using the previous frame's
+// values. Derived values (average speed, Wh/km) are refreshed once per frame,
+// so readers only copy a struct. The accumulators are part of the trip: they
+// are stored in the odometer record and reset with the trip distance.
+
+#define RIDE_STATS_MOVING_MM_S       1000    // ~3.6 km/h, slower counts as stopped
+#define RIDE_STATS_MIN_WH_KM_DIST_M  100     // Wh/km reads 0 until this far into the trip
+#define RIDE_STATS_NO_TEMP           INT16_MIN   // Peak temperature before the first frame
+
+// Persistent part, stored in the odometer record
+typedef struct __attribute__((packed)) {
+    uint32_t ride_time_ms;          // Time with telemetry flowing
+    uint32_t moving_time_ms;
+    uint32_t max_speed_mm_s;
+    uint32_t energy_drawn_mwh;
+    uint32_t energy_regen_mwh;
+    int16_t peak_temp_mos_c100;     // 0.01 degC, RIDE_STATS_NO_TEMP if none yet
+    int16_t peak_temp_motor_c100;   // 0.01 degC, RIDE_STATS_NO_TEMP if none yet
+} ride_stats_persist_t;
+
+typedef struct {
+    ride_stats_persist_t totals;
+    uint32_t avg_speed_mm_s;        // Trip distance over moving time
+    int32_t wh_per_km_x10;          // Net (drawn - regen) energy per trip km, 0.1 Wh/km
+} ride_stats_t;
+
+esp_err_t ride_stats_init(void);
+void ride_stats_get(ride_stats_t *stats);
+void ride_stats_reset(void);
+
+// Used by the odometer to store and recover the trip statistics
+void ride_stats_get_persist(ride_stats_persist_t *persist);
+void ride_stats_restore(const ride_stats_persist_t *persist);
+
+#endif // RIDE_STATS_H
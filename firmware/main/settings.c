@@ -0,0 +1,272 @@
+#include "settings.h"
+#include <string.h>
+#include <stddef.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "nvs_flash.h"
+#include "nvs.h"
+#include "vesc_config.h"
+#include "throttle.h"
+#include "range.h"
+#include "espnow_link.h"
+
+#define TAG "SETTINGS"
+
+// Large enough for blobs written by newer firmware with more fields
+#define SETTINGS_MAX_BLOB_SIZE  256
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;              // Payload size, sizeof(settings_t) of the writer
+    uint32_t seq;
+    uint32_t crc;               // CRC32 of the header up to here, then the payload
+} settings_header_t;
+
+static const settings_t default_settings = {
+    .motor_pulley = 15,         // 15T motor pulley
+    .wheel_pulley = 33,         // 33T wheel pulley
+    .wheel_diameter_mm = 115,   // 115mm wheels
+    .motor_poles = 14,          // 14 pole motor
+    .speed_unit_mph = 0,        // km/h
+    .invert_throttle = 0,
+    .throttle_calibrated = 0,
+    .throttle_min = ADC_INITIAL_MIN_VALUE,
+    .throttle_max = ADC_INITIAL_MAX_VALUE,
+    .brake_min = ADC_INITIAL_MIN_VALUE,
+    .brake_max = ADC_INITIAL_MAX_VALUE,
+    .pack_cells_series = RANGE_DEFAULT_PACK_CELLS,
+    .pack_capacity_mah = RANGE_DEFAULT_PACK_CAPACITY_MAH,
+    .espnow_enabled = 0,
+    .espnow_channel = ESPNOW_LINK_DEFAULT_CHANNEL,
+};
+
+static settings_t current = {0};
+static settings_status_t status = {0};
+static SemaphoreHandle_t settings_mutex = NULL;
+
+static uint32_t blob_crc(const settings_header_t *header, const uint8_t *payload)
+{
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)header, offsetof(settings_header_t, crc));
+    return esp_rom_crc32_le(crc, payload, header->size);
+}
+
+// Returns true and fills settings/seq if the slot holds a valid copy
+static bool read_slot(nvs_handle_t nvs_handle, const char *key, settings_t *settings, uint32_t *seq)
+{
+    uint8_t blob[SETTINGS_MAX_BLOB_SIZE];
+    size_t size = sizeof(blob);
+
+    if (nvs_get_blob(nvs_handle, key, blob, &size) != ESP_OK || size < sizeof(settings_header_t)) {
+        return false;
+    }
+
+    const settings_header_t *header = (const settings_header_t *)blob;
+    const uint8_t *payload = blob + sizeof(settings_header_t);
+    if (header->magic != SETTINGS_MAGIC ||
+        header->version > SETTINGS_VERSION ||
+        header->size != size - sizeof(settings_header_t) ||
+        header->crc != blob_crc(header, payload)) {
+        ESP_LOGW(TAG, "Ignoring invalid settings slot '%s'", key);
+        return false;
+    }
+
+    // Same layout version: fields were only appended, the known prefix is valid
+    *settings = default_settings;
+    memcpy(settings, payload, header->size < sizeof(settings_t) ? header->size : sizeof(settings_t));
+    *seq = header->seq;
+    return true;
+}
+
+static esp_err_t write_slot(const char *key, const settings_t *settings, uint32_t seq)
+{
+    uint8_t blob[sizeof(settings_header_t) + sizeof(settings_t)];
+    settings_header_t *header = (settings_header_t *)blob;
+
+    header->magic = SETTINGS_MAGIC;
+    header->version = SETTINGS_VERSION;
+    header->size = sizeof(settings_t);
+    header->seq = seq;
+    memcpy(blob + sizeof(settings_header_t), settings, sizeof(settings_t));
+    header->crc = blob_crc(header, blob + sizeof(settings_header_t));
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, key, blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    return err;
+}
+
+// Rebuild settings from the per-key layout used before the settings blob
+static bool migrate_legacy(settings_t *settings)
+{
+    nvs_handle_t nvs_handle;
+    bool found = false;
+    uint8_t u8;
+
+    *settings = default_settings;
+
+    if (nvs_open(VESC_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        if (nvs_get_u8(nvs_handle, NVS_KEY_MOTOR_PULLEY, &u8) == ESP_OK) {
+            settings->motor_pulley = u8;
+            found = true;
+        }
+        if (nvs_get_u8(nvs_handle, NVS_KEY_WHEEL_PULLEY, &u8) == ESP_OK) {
+            settings->wheel_pulley = u8;
+            found = true;
+        }
+        if (nvs_get_u8(nvs_handle, NVS_KEY_WHEEL_DIAM, &u8) == ESP_OK) {
+            settings->wheel_diameter_mm = u8;
+            found = true;
+        }
+        if (nvs_get_u8(nvs_handle, NVS_KEY_MOTOR_POLES, &u8) == ESP_OK) {
+            settings->motor_poles = u8;
+            found = true;
+        }
+        if (nvs_get_u8(nvs_handle, NVS_KEY_SPEED_UNIT, &u8) == ESP_OK) {
+            settings->speed_unit_mph = u8;
+            found = true;
+        }
+#ifdef CONFIG_TARGET_LITE
+        if (nvs_get_u8(nvs_handle, NVS_KEY_INVERT_THROTTLE, &u8) == ESP_OK) {
+            settings->invert_throttle = u8;
+            found = true;
+        }
+#endif
+        nvs_close(nvs_handle);
+    }
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        uint32_t min_val, max_val;
+        if (nvs_get_u8(nvs_handle, NVS_KEY_CALIBRATED, &u8) == ESP_OK && u8 &&
+            nvs_get_u32(nvs_handle, NVS_KEY_MIN, &min_val) == ESP_OK &&
+            nvs_get_u32(nvs_handle, NVS_KEY_MAX, &max_val) == ESP_OK) {
+            settings->throttle_calibrated = 1;
+            settings->throttle_min = min_val;
+            settings->throttle_max = max_val;
+            if (nvs_get_u32(nvs_handle, NVS_KEY_BRAKE_MIN, &min_val) == ESP_OK &&
+                nvs_get_u32(nvs_handle, NVS_KEY_BRAKE_MAX, &max_val) == ESP_OK) {
+                settings->brake_min = min_val;
+                settings->brake_max = max_val;
+            }
+            found = true;
+        }
+        nvs_close(nvs_handle);
+    }
+
+    return found;
+}
+
+// Newest valid copy in NVS, 0 in slot if there is none
+static void read_stored(settings_t *settings, uint32_t *seq, char *slot)
+{
+    settings_t slot_a, slot_b;
+    uint32_t seq_a = 0, seq_b = 0;
+    bool valid_a = false, valid_b = false;
+
+    nvs_handle_t nvs_handle;
+    if (nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
+        valid_a = read_slot(nvs_handle, SETTINGS_NVS_KEY_A, &slot_a, &seq_a);
+        valid_b = read_slot(nvs_handle, SETTINGS_NVS_KEY_B, &slot_b, &seq_b);
+        nvs_close(nvs_handle);
+    }
+
+    if (valid_a && (!valid_b || (int32_t)(seq_a - seq_b) > 0)) {
+        *settings = slot_a;
+        *seq = seq_a;
+        *slot = 'A';
+    } else if (valid_b) {
+        *settings = slot_b;
+        *seq = seq_b;
+        *slot = 'B';
+    } else {
+        *seq = 0;
+        *slot = 0;
+    }
+}
+
+esp_err_t settings_init(void)
+{
+    if (settings_mutex == NULL) {
+        settings_mutex = xSemaphoreCreateMutex();
+        if (settings_mutex == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    int64_t start_us = esp_timer_get_time();
+    read_stored(&current, &status.seq, &status.slot);
+    status.load_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    if (status.slot == 0) {
+        status.migrated = migrate_legacy(&current);
+        ESP_LOGI(TAG, "No settings blob found, %s",
+                 status.migrated ? "migrating old settings" : "saving defaults");
+        esp_err_t err = settings_save(&current);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to save settings: %s", esp_err_to_name(err));
+        }
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Loaded settings seq %lu from slot %c in %lu us",
+             status.seq, status.slot, status.load_us);
+    return ESP_OK;
+}
+
+void settings_get(settings_t *settings)
+{
+    xSemaphoreTake(settings_mutex, portMAX_DELAY);
+    *settings = current;
+    xSemaphoreGive(settings_mutex);
+}
+
+esp_err_t settings_save(const settings_t *settings)
+{
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(settings_mutex, portMAX_DELAY);
+    // Skip no-op changes once a copy has been stored
+    if (status.slot == 0 || memcmp(settings, &current, sizeof(settings_t)) != 0) {
+        char slot = (status.slot == 'A') ? 'B' : 'A';
+        err = write_slot(slot == 'A' ? SETTINGS_NVS_KEY_A : SETTINGS_NVS_KEY_B, settings, status.seq + 1);
+        if (err == ESP_OK) {
+            status.seq++;
+            status.slot = slot;
+        }
+        // Keep running on the new values even if they could not be stored
+        current = *settings;
+    }
+    xSemaphoreGive(settings_mutex);
+    return err;
+}
+
+void settings_get_status(settings_status_t *out)
+{
+    if (out == NULL) {
+        return;
+    }
+    xSemaphoreTake(settings_mutex, portMAX_DELAY);
+    *out = status;
+    xSemaphoreGive(settings_mutex);
+}
+
+esp_err_t settings_read_stored(settings_t *settings)
+{
+    if (settings == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint32_t seq;
+    char slot;
+    read_stored(settings, &seq, &slot);
+    return slot != 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
@@ -0,0 +1,73 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Every persistent setting lives in one CRC-protected blob. Two NVS keys hold
+// alternating copies (A/B); a save always overwrites the older copy, so a
+// power cut during a save leaves the previous complete settings in place.
+// The newest valid copy is read once at boot and served from RAM after that.
+
+#define SETTINGS_NVS_NAMESPACE  "settings"
+#define SETTINGS_NVS_KEY_A      "blob_a"
+#define SETTINGS_NVS_KEY_B      "blob_b"
+
+#define SETTINGS_MAGIC          0x54534247  // "GBST"
+#define SETTINGS_VERSION        1
+
+// Append new fields at the end only, and keep SETTINGS_VERSION for that: a
+// blob written by older firmware is shorter and the missing tail is filled
+// from the defaults on load, a blob from newer firmware is longer and only
+// the fields known here are read. The header's size carries this.
+//
+// SETTINGS_VERSION is the oldest layout a reader must understand to use the
+// blob. Bump it only when a field is moved, removed or retyped; older
+// firmware then ignores the new blobs, and read_slot needs a conversion
+// for the blobs of the previous version.
+typedef struct __attribute__((packed)) {
+    // VESC geometry and display
+    uint8_t motor_pulley;
+    uint8_t wheel_pulley;
+    uint8_t wheel_diameter_mm;
+    uint8_t motor_poles;
+    uint8_t speed_unit_mph;
+    uint8_t invert_throttle;        // Only used by the lite target
+
+    // Throttle calibration
+    uint8_t throttle_calibrated;
+    uint8_t reserved0;
+    uint32_t throttle_min;
+    uint32_t throttle_max;
+    uint32_t brake_min;             // Only used by the dual throttle target
+    uint32_t brake_max;
+
+    // Battery pack, used by the range estimate when no BMS reports in
+    uint8_t pack_cells_series;
+    uint8_t reserved1;
+    uint16_t pack_capacity_mah;
+
+    // ESP-NOW link to the receiver, see espnow_link.h
+    uint8_t espnow_enabled;
+    uint8_t espnow_channel;
+    uint8_t espnow_peer_mac[6];     // All zero while not paired
+    uint8_t espnow_key[16];         // Local master key of the peer entry
+} settings_t;
+
+typedef struct {
+    uint32_t seq;                   // Sequence number of the copy in use
+    char slot;                      // 'A', 'B', or 0 when running on defaults
+    bool migrated;                  // Settings were rebuilt from the old per-key NVS layout
+    uint32_t load_us;               // Time taken to read both slots at boot
+} settings_status_t;
+
+esp_err_t settings_init(void);
+void settings_get(settings_t *settings);
+esp_err_t settings_save(const settings_t *settings);
+void settings_get_status(settings_status_t *status);
+// Reads the newest stored copy from NVS the way boot does, without touching
+// the copy in RAM. Only for measuring the load.
+esp_err_t settings_read_stored(settings_t *settings);
+
+#endif // SETTINGS_H
@@ -0,0 +1,104 @@
+#include "stats_screen.h"
+#include "esp_log.h"
+#include "ui.h"
+#include "fonts.h"
+#include "button.h"
+#include "ui_updater.h"
+#include "chart_screen.h"
+
+#define TAG "STATS_SCREEN"
+
+#define STATS_ROW_HEIGHT   21
+#define STATS_FIRST_ROW_Y  36
+#define STATS_MARGIN_X     12
+
+stats_screen_objects_t stats_objects;
+
+static int row_count = 0;
+
+static lv_obj_t *create_row(lv_obj_t *parent, const char *name)
+{
+    lv_coord_t y = STATS_FIRST_ROW_Y + row_count * STATS_ROW_HEIGHT;
+    row_count++;
+
+    lv_obj_t *label = lv_label_create(parent);
+    lv_obj_set_pos(label, STATS_MARGIN_X, y);
+    lv_obj_set_style_text_color(label, lv_color_hex(0xff808080), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(label, &ui_font_bebas20, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_label_set_text(label, name);
+
+    lv_obj_t *value = lv_label_create(parent);
+    lv_obj_align(value, LV_ALIGN_TOP_RIGHT, -STATS_MARGIN_X, y);
+    lv_obj_set_style_text_color(value, lv_color_hex(0xffffffff), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(value, &ui_font_bebas20, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_label_set_text(value, "--");
+    return value;
+}
+
+static void create_screen(void)
+{
+    lv_obj_t *obj = lv_obj_create(0);
+    stats_objects.screen = obj;
+    lv_obj_set_pos(obj, 0, 0);
+    lv_obj_set_size(obj, LV_HOR_RES, LV_VER_RES);
+    lv_obj_clear_flag(obj, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_bg_color(obj, lv_color_hex(0xff000000), LV_PART_MAIN | LV_STATE_DEFAULT);
+
+    lv_obj_t *title = lv_label_create(obj);
+    lv_obj_align(title, LV_ALIGN_TOP_MID, 0, 8);
+    lv_obj_set_style_text_color(title, lv_color_hex(0xffffffff), LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_obj_set_style_text_font(title, &ui_font_bebas20, LV_PART_MAIN | LV_STATE_DEFAULT);
+    lv_label_set_text(title, "RIDE STATS");
+
+    row_count = 0;
+    stats_objects.ride_time = create_row(obj, "RIDE TIME");
+    stats_objects.moving_time = create_row(obj, "MOVING");
+    stats_objects.max_speed = create_row(obj, "MAX SPEED");
+    stats_objects.avg_speed = create_row(obj, "AVG SPEED");
+    stats_objects.energy = create_row(obj, "ENERGY");
+    stats_objects.regen = create_row(obj, "REGEN");
+    stats_objects.consumption = create_row(obj, "CONSUMPTION");
+    stats_objects.motor_current = create_row(obj, "MOTOR");
+    stats_objects.battery_current = create_row(obj, "BATTERY");
+    stats_objects.peak_temp_mos = create_row(obj, "PEAK FET");
+    stats_objects.peak_temp_motor = create_row(obj, "PEAK MOTOR");
+    stats_objects.range = create_row(obj, "RANGE");
+    stats_objects.cells = create_row(obj, "CELLS");
+}
+
+static void stats_button_callback(button_event_t event, void *user_data)
+{
+    if (event != BUTTON_EVENT_DOUBLE_PRESS) {
+        return;
+    }
+
+    if (take_lvgl_mutex_for_handler()) {
+        lv_obj_t *current = lv_scr_act();
+        // Cycle home -> stats -> charts -> home
+        if (current == objects.home_screen) {
+            lv_disp_load_scr(stats_objects.screen);
+        } else if (current == stats_objects.screen && chart_objects.screen != NULL) {
+            lv_disp_load_scr(chart_objects.screen);
+        } else if (current == stats_objects.screen || current == chart_objects.screen) {
+            lv_disp_load_scr(objects.home_screen);
+        }
+        give_lvgl_mutex();
+    }
+}
+
+void stats_screen_init(void)
+{
+    if (take_lvgl_mutex_for_handler()) {
+        create_screen();
+        give_lvgl_mutex();
+    } else {
+        ESP_LOGE(TAG, "Failed to create stats screen");
+        return;
+    }
+    button_register_callback(stats_button_callback, NULL);
+}
+
+bool stats_screen_is_active(void)
+{
+    return stats_objects.screen != NULL && lv_scr_act() == stats_objects.screen;
+}
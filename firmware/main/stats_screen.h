@@ -0,0 +1,32 @@
+#ifndef STATS_SCREEN_H
+#define STATS_SCREEN_H
+
+#include <stdbool.h>
+#include <lvgl.h>
+
+// Ride statistics screen, built in code next to the EEZ generated screens.
+// A double press on the main button cycles the home, stats and chart screens.
+
+typedef struct {
+    lv_obj_t *screen;
+    lv_obj_t *ride_time;
+    lv_obj_t *moving_time;
+    lv_obj_t *max_speed;
+    lv_obj_t *avg_speed;
+    lv_obj_t *energy;
+    lv_obj_t *regen;
+    lv_obj_t *consumption;
+    lv_obj_t *motor_current;
+    lv_obj_t *battery_current;
+    lv_obj_t *peak_temp_mos;
+    lv_obj_t *peak_temp_motor;
+    lv_obj_t *range;
+    lv_obj_t *cells;
+} stats_screen_objects_t;
+
+extern stats_screen_objects_t stats_objects;
+
+void stats_screen_init(void);
+bool stats_screen_is_active(void);
+
+#endif // STATS_SCREEN_H
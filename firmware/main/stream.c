@@ -0,0 +1,280 @@
+#include "stream.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "telemetry.h"
+#include "telemetry_schema.h"
+#include "throttle.h"
+#include "usb_proto.h"
+
+#define TAG "STREAM"
+
+// Largest encoded record: kind, dt and 9 fields at 5 bytes, cell count and cells at 3
+#define MAX_RECORD_BYTES  (1 + 5 + 9 * 5 + 1 + TELEMETRY_MAX_CELLS * 3)
+#define FRAME_HEADER_SIZE 9
+
+typedef struct {
+    int64_t time_us;
+    int32_t raw;
+    uint8_t mapped;
+    uint8_t sent;
+} throttle_record_t;
+
+// Single producer rings: the producer writes slot head % size, then
+// publishes head + 1. The reader copies a slot and keeps it only if the
+// producer has not come round to that slot again in the meantime.
+typedef struct {
+    volatile uint32_t head;
+    uint32_t tail;                  // Reader side only
+} ring_index_t;
+
+static telemetry_snapshot_t telemetry_ring[STREAM_RING_SIZE];
+static throttle_record_t throttle_ring[STREAM_RING_SIZE];
+static ring_index_t telemetry_index = {0};
+static ring_index_t throttle_index = {0};
+
+static volatile bool active = false;
+static volatile bool restart_pending = false;
+static volatile uint32_t rate_hz = 0;
+static volatile int64_t min_interval_us = 0;
+static int64_t last_telemetry_us = 0;      // Producer side only
+static int64_t last_throttle_us = 0;       // Producer side only
+
+static TaskHandle_t stream_task_handle = NULL;
+static uint32_t dropped = 0;
+static uint32_t records_sent = 0;
+static uint32_t frames_sent = 0;
+
+static size_t put_uvarint(uint8_t *out, uint32_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+static size_t put_svarint(uint8_t *out, int32_t value)
+{
+    return put_uvarint(out, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+static inline void ring_publish(ring_index_t *index)
+{
+    __atomic_store_n(&index->head, index->head + 1, __ATOMIC_RELEASE);
+}
+
+// Returns true if the reader's slot is readable; skips ahead over overruns
+static bool ring_peek(ring_index_t *index)
+{
+    uint32_t head = __atomic_load_n(&index->head, __ATOMIC_ACQUIRE);
+    if (head - index->tail > STREAM_RING_SIZE - 1) {
+        // Keep one slot of margin for the write in progress
+        uint32_t skip = head - index->tail - (STREAM_RING_SIZE - 1);
+        dropped += skip;
+        index->tail += skip;
+    }
+    return index->tail != head;
+}
+
+// After copying the slot: false if the producer may have overwritten it
+static bool ring_still_valid(ring_index_t *index)
+{
+    uint32_t head = __atomic_load_n(&index->head, __ATOMIC_ACQUIRE);
+    return head - index->tail < STREAM_RING_SIZE;
+}
+
+static void on_telemetry(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    if (!active || snapshot->rx_time_us - last_telemetry_us < min_interval_us) {
+        return;
+    }
+    last_telemetry_us = snapshot->rx_time_us;
+
+    telemetry_ring[telemetry_index.head % STREAM_RING_SIZE] = *snapshot;
+    ring_publish(&telemetry_index);
+}
+
+void stream_record_throttle(uint8_t sent)
+{
+    if (!active) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    if (now - last_throttle_us < min_interval_us) {
+        return;
+    }
+    last_throttle_us = now;
+
+    throttle_record_t *record = &throttle_ring[throttle_index.head % STREAM_RING_SIZE];
+    record->time_us = now;
+    record->raw = throttle_get_latest_raw();
+    record->mapped = throttle_get_latest_mapped();
+    record->sent = sent;
+    ring_publish(&throttle_index);
+}
+
+static size_t encode_telemetry(uint8_t *out, const telemetry_snapshot_t *t, uint32_t dt_ms)
+{
+    size_t n = 0;
+    out[n++] = STREAM_KIND_TELEMETRY;
+    n += put_uvarint(out + n, dt_ms);
+#define STREAM_PUT_FIELD(id) n += put_svarint(out + n, telemetry_field_get(t, TELEMETRY_FIELD_##id));
+    STREAM_TELEMETRY_FIELDS(STREAM_PUT_FIELD)
+#undef STREAM_PUT_FIELD
+
+    uint8_t cells = t->bms_num_cells > TELEMETRY_MAX_CELLS ? TELEMETRY_MAX_CELLS : t->bms_num_cells;
+    out[n++] = cells;
+    int32_t prev = 0;
+    for (uint8_t i = 0; i < cells; i++) {
+        n += put_svarint(out + n, t->cell_mv[i] - prev);
+        prev = t->cell_mv[i];
+    }
+    return n;
+}
+
+static size_t encode_throttle(uint8_t *out, const throttle_record_t *r, uint32_t dt_ms)
+{
+    size_t n = 0;
+    out[n++] = STREAM_KIND_THROTTLE;
+    n += put_uvarint(out + n, dt_ms);
+    n += put_svarint(out + n, r->raw);
+    out[n++] = r->mapped;
+    out[n++] = r->sent;
+    return n;
+}
+
+// Drains both rings in time order into as many frames as needed
+static void flush_records(void)
+{
+    static uint8_t payload[USB_PROTO_MAX_PAYLOAD];
+    size_t len = 0;
+    uint8_t count = 0;
+    uint32_t prev_ms = 0;
+
+    while (true) {
+        telemetry_snapshot_t telemetry;
+        throttle_record_t throttle = {0};
+        bool have_telemetry = false;
+        bool have_throttle = false;
+
+        if (ring_peek(&telemetry_index)) {
+            telemetry = telemetry_ring[telemetry_index.tail % STREAM_RING_SIZE];
+            have_telemetry = ring_still_valid(&telemetry_index);
+            if (!have_telemetry) {
+                continue;       // Overwritten while copied, ring_peek counts it
+            }
+        }
+        if (ring_peek(&throttle_index)) {
+            throttle = throttle_ring[throttle_index.tail % STREAM_RING_SIZE];
+            have_throttle = ring_still_valid(&throttle_index);
+            if (!have_throttle) {
+                continue;
+            }
+        }
+        if (!have_telemetry && !have_throttle) {
+            break;
+        }
+
+        bool take_telemetry = have_telemetry && (!have_throttle || telemetry.rx_time_us <= throttle.time_us);
+        uint32_t time_ms = (uint32_t)((take_telemetry ? telemetry.rx_time_us : throttle.time_us) / 1000);
+
+        if (len + MAX_RECORD_BYTES > sizeof(payload) || count == UINT8_MAX) {
+            payload[FRAME_HEADER_SIZE - 1] = count;
+            usb_proto_send(USB_MSG_STREAM_DATA | USB_PROTO_REPLY, (uint8_t)frames_sent, payload, len);
+            frames_sent++;
+            len = 0;
+        }
+        if (len == 0) {
+            memcpy(&payload[0], &dropped, sizeof(uint32_t));
+            memcpy(&payload[4], &time_ms, sizeof(uint32_t));
+            len = FRAME_HEADER_SIZE;
+            count = 0;
+            prev_ms = time_ms;
+        }
+
+        uint32_t dt_ms = time_ms - prev_ms;
+        prev_ms = time_ms;
+        if (take_telemetry) {
+            len += encode_telemetry(&payload[len], &telemetry, dt_ms);
+            telemetry_index.tail++;
+        } else {
+            len += encode_throttle(&payload[len], &throttle, dt_ms);
+            throttle_index.tail++;
+        }
+        count++;
+        records_sent++;
+    }
+
+    if (len > 0) {
+        payload[FRAME_HEADER_SIZE - 1] = count;
+        usb_proto_send(USB_MSG_STREAM_DATA | USB_PROTO_REPLY, (uint8_t)frames_sent, payload, len);
+        frames_sent++;
+    }
+}
+
+static void stream_task(void *pvParameters)
+{
+    while (1) {
+        if (!active) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        if (restart_pending) {
+            // Reader state belongs to this task, so the restart happens here
+            telemetry_index.tail = __atomic_load_n(&telemetry_index.head, __ATOMIC_ACQUIRE);
+            throttle_index.tail = __atomic_load_n(&throttle_index.head, __ATOMIC_ACQUIRE);
+            dropped = 0;
+            records_sent = 0;
+            frames_sent = 0;
+            restart_pending = false;
+        }
+        vTaskDelay(pdMS_TO_TICKS(STREAM_FLUSH_MS));
+        // A slow host blocks here, in this task only; the rings absorb or drop
+        flush_records();
+    }
+}
+
+esp_err_t stream_init(void)
+{
+    if (xTaskCreate(stream_task, "usb_stream", 3072, NULL, 2, &stream_task_handle) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create stream task");
+        return ESP_ERR_NO_MEM;
+    }
+    return telemetry_register_callback(on_telemetry, NULL);
+}
+
+esp_err_t stream_start(uint32_t rate)
+{
+    if (rate == 0 || rate > STREAM_MAX_RATE_HZ || stream_task_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Start from empty rings and fresh counters
+    restart_pending = true;
+    rate_hz = rate;
+    min_interval_us = 1000000 / rate;
+    active = true;
+    xTaskNotifyGive(stream_task_handle);
+    ESP_LOGI(TAG, "Streaming at %lu Hz", rate);
+    return ESP_OK;
+}
+
+void stream_stop(void)
+{
+    active = false;
+    rate_hz = 0;
+}
+
+void stream_get_status(stream_status_t *status)
+{
+    status->active = active;
+    status->rate_hz = rate_hz;
+    status->records_sent = records_sent;
+    status->frames_sent = frames_sent;
+    status->dropped = dropped;
+}
@@ -0,0 +1,51 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Live telemetry and throttle records over USB for bench tuning.
+//
+// Producers (the telemetry callback and the BLE throttle sender) copy one
+// record into a single-producer ring and publish the head index; they never
+// wait. The stream task drains both rings, packs the records into
+// USB_MSG_STREAM_DATA frames and writes them to the host. When the host
+// reads slowly the rings wrap, the oldest records are lost and counted.
+//
+// Frame payload, little endian:
+//     dropped (u32)   records lost to ring overruns since the stream started
+//     base_ms (u32)   esp_timer time of the first record
+//     count (u8)
+//     records: kind (u8), dt_ms (uvarint, from the previous record), fields
+// Telemetry (kind 1) fields are zigzag varints in the order of
+// STREAM_TELEMETRY_FIELDS in telemetry_schema.h: erpm, current_motor,
+// current_in, voltage, temp_mos, temp_motor, bms_voltage, bms_current,
+// bms_remaining, then cell count (u8) and the cells, each as the difference
+// to the previous cell. Throttle (kind 2): raw (zigzag varint), mapped (u8),
+// sent (u8). See tools/stream_dump.py.
+
+#define STREAM_RING_SIZE        64      // Records per ring, power of two
+#define STREAM_MAX_RATE_HZ      100
+#define STREAM_FLUSH_MS         20
+
+#define STREAM_KIND_TELEMETRY   1
+#define STREAM_KIND_THROTTLE    2
+
+typedef struct {
+    bool active;
+    uint32_t rate_hz;
+    uint32_t records_sent;
+    uint32_t frames_sent;
+    uint32_t dropped;
+} stream_status_t;
+
+esp_err_t stream_init(void);
+esp_err_t stream_start(uint32_t rate_hz);
+void stream_stop(void);
+void stream_get_status(stream_status_t *status);
+
+// Called by the BLE throttle sender after each write
+void stream_record_throttle(uint8_t sent);
+
+#endif // STREAM_H
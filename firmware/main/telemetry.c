@@ -0,0 +1,60 @@
+#include "telemetry.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+
+#define TAG "TELEMETRY"
+
+typedef struct {
+    telemetry_callback_t callback;
+    void *user_data;
+} telemetry_listener_t;
+
+static telemetry_listener_t listeners[TELEMETRY_MAX_CALLBACKS];
+static int listener_count = 0;
+
+static telemetry_snapshot_t latest_snapshot = {0};
+static uint32_t frame_count = 0;
+static portMUX_TYPE snapshot_lock = portMUX_INITIALIZER_UNLOCKED;
+
+esp_err_t telemetry_register_callback(telemetry_callback_t callback, void *user_data)
+{
+    if (callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (listener_count >= TELEMETRY_MAX_CALLBACKS) {
+        ESP_LOGE(TAG, "Too many telemetry callbacks");
+        return ESP_ERR_NO_MEM;
+    }
+
+    listeners[listener_count].callback = callback;
+    listeners[listener_count].user_data = user_data;
+    listener_count++;
+    return ESP_OK;
+}
+
+void telemetry_publish(const telemetry_snapshot_t *snapshot)
+{
+    telemetry_snapshot_t published = *snapshot;
+
+    portENTER_CRITICAL(&snapshot_lock);
+    published.frame_seq = ++frame_count;
+    latest_snapshot = published;
+    portEXIT_CRITICAL(&snapshot_lock);
+
+    for (int i = 0; i < listener_count; i++) {
+        listeners[i].callback(&published, listeners[i].user_data);
+    }
+}
+
+void telemetry_get_latest(telemetry_snapshot_t *snapshot)
+{
+    portENTER_CRITICAL(&snapshot_lock);
+    *snapshot = latest_snapshot;
+    portEXIT_CRITICAL(&snapshot_lock);
+}
+
+uint32_t telemetry_get_frame_count(void)
+{
+    return frame_count;
+}
@@ -0,0 +1,56 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#define TELEMETRY_MAX_CELLS      16
+#define TELEMETRY_MAX_CALLBACKS  8
+
+// Peers a snapshot is merged from, in the order of the BLE links
+typedef enum {
+    TELEMETRY_SOURCE_PRIMARY = 0,   // Main controller, over BLE or ESP-NOW
+    TELEMETRY_SOURCE_SECONDARY,     // Second drive of a dual-drive board
+    TELEMETRY_SOURCE_BMS,           // Standalone BMS
+    TELEMETRY_SOURCE_COUNT,
+} telemetry_source_t;
+
+// A source whose last frame is older than this drops out of the merge
+#define TELEMETRY_SOURCE_STALE_US 1000000
+
+// Telemetry in the fixed-point units used on the wire. Every frame of the
+// primary is merged with the latest frames of the other sources and
+// published: the primary gives speed and pack voltage, a second drive adds
+// its currents and the hotter of its temperatures, and a standalone BMS
+// replaces the BMS fields. Frames of the other sources are only stored for
+// the merge, unless the primary is silent; then the second drive, or else
+// the BMS, paces the snapshots.
+typedef struct {
+    int64_t rx_time_us;         // esp_timer time the notify was received
+    uint32_t frame_seq;         // Incremented for every decoded frame
+    int32_t erpm;
+    int16_t temp_mos_c100;      // 0.01 degC
+    int16_t temp_motor_c100;    // 0.01 degC
+    int16_t current_motor_c100; // 0.01 A
+    int16_t current_in_c100;    // 0.01 A
+    int16_t voltage_c100;       // 0.01 V
+    int16_t bms_voltage_c100;   // 0.01 V
+    int16_t bms_current_c100;   // 0.01 A
+    int16_t bms_remaining_c100; // 0.01 Ah
+    int16_t bms_nominal_c100;   // 0.01 Ah
+    uint8_t bms_num_cells;
+    int16_t cell_mv[TELEMETRY_MAX_CELLS];
+    uint8_t source;             // telemetry_source_t of the frame that was just received
+    int64_t source_time_us[TELEMETRY_SOURCE_COUNT];     // Last frame merged from each, 0 if none
+} telemetry_snapshot_t;
+
+// Callbacks run in the Bluetooth callback context, or the Wi-Fi task while
+// ESP-NOW carries the link, one frame at a time. They must not block.
+typedef void (*telemetry_callback_t)(const telemetry_snapshot_t *snapshot, void *user_data);
+
+esp_err_t telemetry_register_callback(telemetry_callback_t callback, void *user_data);
+void telemetry_publish(const telemetry_snapshot_t *snapshot);
+void telemetry_get_latest(telemetry_snapshot_t *snapshot);
+uint32_t telemetry_get_frame_count(void);
+
+#endif // TELEMETRY_H
@@ -0,0 +1,115 @@
+#include "telemetry_bench.h"
+#include <string.h>
+#include "esp_cpu.h"
+#include "telemetry_decode.h"
+
+#define BENCH_FRAMES    8       // Distinct frames cycled through
+
+static inline int16_t get_i16_be(const uint8_t *p)
+{
+    return (int16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static inline int32_t get_i32_be(const uint8_t *p)
+{
+    return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                     ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+}
+
+// The hand-written decoder as it was before telemetry_schema.h
+__attribute__((noinline))
+static bool reference_decode(const uint8_t *value, size_t len, telemetry_snapshot_t *snapshot)
+{
+    if (value == NULL || len != TELEMETRY_FRAME_LEN) {
+        return false;
+    }
+
+    snapshot->temp_mos_c100 = get_i16_be(&value[0]);
+    snapshot->temp_motor_c100 = get_i16_be(&value[2]);
+    snapshot->current_motor_c100 = get_i16_be(&value[4]);
+    snapshot->current_in_c100 = get_i16_be(&value[6]);
+    snapshot->erpm = get_i32_be(&value[8]);
+    snapshot->voltage_c100 = get_i16_be(&value[12]);
+
+    snapshot->bms_voltage_c100 = get_i16_be(&value[14]);
+    snapshot->bms_current_c100 = get_i16_be(&value[16]);
+    snapshot->bms_remaining_c100 = get_i16_be(&value[18]);
+    snapshot->bms_nominal_c100 = get_i16_be(&value[20]);
+
+    uint8_t cells = value[22] < TELEMETRY_MAX_CELLS ? value[22] : TELEMETRY_MAX_CELLS;
+    snapshot->bms_num_cells = cells;
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+        snapshot->cell_mv[i] = i < cells ? get_i16_be(&value[TELEMETRY_FRAME_CELLS_OFS + i * 2]) : 0;
+    }
+    return true;
+}
+
+static void build_frames(uint8_t frames[BENCH_FRAMES][TELEMETRY_FRAME_LEN])
+{
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        telemetry_snapshot_t s = {0};
+        s.temp_mos_c100 = 3500 + f * 25;
+        s.temp_motor_c100 = 4200 + f * 40;
+        s.current_motor_c100 = -1500 + f * 700;
+        s.current_in_c100 = -300 + f * 250;
+        s.erpm = -2000 + f * 4100;
+        s.voltage_c100 = 4120 - f * 12;
+        s.bms_voltage_c100 = 4118 - f * 12;
+        s.bms_current_c100 = s.current_in_c100;
+        s.bms_remaining_c100 = 1200 - f * 3;
+        s.bms_nominal_c100 = 1500;
+        s.bms_num_cells = f == 0 ? 10 : TELEMETRY_MAX_CELLS;
+        for (int i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+            s.cell_mv[i] = (int16_t)(3900 + i * 3 - f * 5);
+        }
+        telemetry_encode_frame(&s, frames[f]);
+    }
+}
+
+esp_err_t telemetry_bench_run(uint32_t rounds, telemetry_bench_result_t *result)
+{
+    if (result == NULL || rounds == 0 || rounds > TELEMETRY_BENCH_MAX_ROUNDS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(result, 0, sizeof(*result));
+    result->rounds = rounds;
+
+    static uint8_t frames[BENCH_FRAMES][TELEMETRY_FRAME_LEN];
+    build_frames(frames);
+
+    for (int f = 0; f < BENCH_FRAMES; f++) {
+        telemetry_snapshot_t a = {0};
+        telemetry_snapshot_t b = {0};
+        telemetry_decode_frame(frames[f], TELEMETRY_FRAME_LEN, &a);
+        reference_decode(frames[f], TELEMETRY_FRAME_LEN, &b);
+        result->mismatches += memcmp(&a, &b, sizeof(a)) != 0;
+    }
+
+    uint32_t best_schema = UINT32_MAX;
+    uint32_t best_reference = UINT32_MAX;
+    telemetry_snapshot_t out;
+    for (uint32_t r = 0; r < rounds; r++) {
+        uint32_t start = esp_cpu_get_cycle_count();
+        for (int i = 0; i < TELEMETRY_BENCH_ROUND; i++) {
+            telemetry_decode_frame(frames[i % BENCH_FRAMES], TELEMETRY_FRAME_LEN, &out);
+        }
+        uint32_t schema = esp_cpu_get_cycle_count() - start;
+
+        start = esp_cpu_get_cycle_count();
+        for (int i = 0; i < TELEMETRY_BENCH_ROUND; i++) {
+            reference_decode(frames[i % BENCH_FRAMES], TELEMETRY_FRAME_LEN, &out);
+        }
+        uint32_t reference = esp_cpu_get_cycle_count() - start;
+
+        if (schema < best_schema) {
+            best_schema = schema;
+        }
+        if (reference < best_reference) {
+            best_reference = reference;
+        }
+    }
+
+    result->schema_cycles = best_schema / TELEMETRY_BENCH_ROUND;
+    result->reference_cycles = best_reference / TELEMETRY_BENCH_ROUND;
+    return ESP_OK;
+}
@@ -0,0 +1,88 @@
+#include "telemetry_decode.h"
+#include <string.h>
+
+_Static_assert(TELEMETRY_FRAME_LEN == 55, "the receiver sends 55 byte frames");
+
+enum {
+#define TELEMETRY_FIELD_OFFSET(id, name, member, type, offset, scale, unit) TELEMETRY_OFS_##id = offset,
+    TELEMETRY_SCHEMA(TELEMETRY_FIELD_OFFSET)
+#undef TELEMETRY_FIELD_OFFSET
+};
+
+static inline int32_t get_U8(const uint8_t *p)
+{
+    return p[0];
+}
+
+static inline int32_t get_I16(const uint8_t *p)
+{
+    return (int16_t)(((uint16_t)p[0] << 8) | p[1]);
+}
+
+static inline int32_t get_I32(const uint8_t *p)
+{
+    return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+                     ((uint32_t)p[2] << 8) | (uint32_t)p[3]);
+}
+
+static inline void put_U8(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t)v;
+}
+
+static inline void put_I16(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t)((uint32_t)v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+static inline void put_I32(uint8_t *p, int32_t v)
+{
+    p[0] = (uint8_t)((uint32_t)v >> 24);
+    p[1] = (uint8_t)((uint32_t)v >> 16);
+    p[2] = (uint8_t)((uint32_t)v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+bool telemetry_decode_frame(const uint8_t *value, size_t len, telemetry_snapshot_t *snapshot)
+{
+    if (value == NULL) {
+        return false;
+    }
+    uint8_t padded[TELEMETRY_FRAME_LEN];
+    if (len != TELEMETRY_FRAME_LEN) {
+        // v2, the length has to match the cell count it carries
+        if (len <= TELEMETRY_OFS_NUM_CELLS || value[TELEMETRY_OFS_NUM_CELLS] >= TELEMETRY_MAX_CELLS ||
+            len != TELEMETRY_SCHEMA_V2_LEN(value[TELEMETRY_OFS_NUM_CELLS])) {
+            return false;
+        }
+        memcpy(padded, value, len);
+        memset(padded + len, 0, sizeof(padded) - len);
+        value = padded;
+    }
+
+#define TELEMETRY_DECODE_FIELD(id, name, member, type, offset, scale, unit) \
+    snapshot->member = (__typeof__(snapshot->member))get_##type(&value[offset]);
+    TELEMETRY_SCHEMA(TELEMETRY_DECODE_FIELD)
+#undef TELEMETRY_DECODE_FIELD
+
+    uint8_t cells = snapshot->bms_num_cells < TELEMETRY_MAX_CELLS ? snapshot->bms_num_cells : TELEMETRY_MAX_CELLS;
+    snapshot->bms_num_cells = cells;
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+        int32_t keep = -(int32_t)(i < cells);
+        snapshot->cell_mv[i] = (int16_t)(get_I16(&value[TELEMETRY_FRAME_CELLS_OFS + i * 2]) & keep);
+    }
+    return true;
+}
+
+void telemetry_encode_frame(const telemetry_snapshot_t *snapshot, uint8_t *out)
+{
+#define TELEMETRY_ENCODE_FIELD(id, name, member, type, offset, scale, unit) \
+    put_##type(&out[offset], snapshot->member);
+    TELEMETRY_SCHEMA(TELEMETRY_ENCODE_FIELD)
+#undef TELEMETRY_ENCODE_FIELD
+
+    for (uint8_t i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+        put_I16(&out[TELEMETRY_FRAME_CELLS_OFS + i * 2], i < snapshot->bms_num_cells ? snapshot->cell_mv[i] : 0);
+    }
+}
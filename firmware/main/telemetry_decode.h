@@ -0,0 +1,31 @@
+#ifndef TELEMETRY_DECODE_H
+#define TELEMETRY_DECODE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "telemetry.h"
+#include "telemetry_schema.h"
+
+// Decoder for the combined VESC + BMS notify from the GS-THUMB receiver, and
+// the matching encoder for simulators and benchmarks. Both are generated
+// from TELEMETRY_SCHEMA in telemetry_schema.h, which holds the layout. Pure
+// functions of their input, no ESP-IDF or FreeRTOS calls, so they build
+// unchanged on a host compiler.
+//
+// The decoder has no branch per field: every field is one load at a fixed
+// offset, and all TELEMETRY_MAX_CELLS cells are read and masked by the cell
+// count. A v2 frame, which only carries the valid cells, is padded to the
+// full length first.
+
+#define TELEMETRY_FRAME_LEN         TELEMETRY_SCHEMA_FRAME_LEN
+#define TELEMETRY_FRAME_CELLS_OFS   TELEMETRY_SCHEMA_CELLS_OFS
+
+// Fills everything but rx_time_us and frame_seq. Takes the full frame or a
+// v2 frame; returns false and leaves the snapshot untouched if the length
+// matches neither.
+bool telemetry_decode_frame(const uint8_t *value, size_t len, telemetry_snapshot_t *snapshot);
+// Writes TELEMETRY_FRAME_LEN bytes. Cells past bms_num_cells are sent as 0.
+void telemetry_encode_frame(const telemetry_snapshot_t *snapshot, uint8_t *out);
+
+#endif // TELEMETRY_DECODE_H
@@ -0,0 +1,128 @@
+#include "telemetry_schema.h"
+
+const telemetry_field_info_t telemetry_fields[TELEMETRY_FIELD_COUNT] = {
+#define TELEMETRY_FIELD_INFO(id, name, member, type, offset, scale, unit) \
+    [TELEMETRY_FIELD_##id] = { name, #member, unit, TELEMETRY_WIRE_##type, offset, scale },
+    TELEMETRY_SCHEMA(TELEMETRY_FIELD_INFO)
+#undef TELEMETRY_FIELD_INFO
+};
+
+int32_t telemetry_field_get(const telemetry_snapshot_t *snapshot, telemetry_field_t field)
+{
+    switch (field) {
+#define TELEMETRY_FIELD_GET(id, name, member, type, offset, scale, unit) \
+        case TELEMETRY_FIELD_##id: return snapshot->member;
+        TELEMETRY_SCHEMA(TELEMETRY_FIELD_GET)
+#undef TELEMETRY_FIELD_GET
+        default: return 0;
+    }
+}
+
+void telemetry_field_set(telemetry_snapshot_t *snapshot, telemetry_field_t field, int32_t value)
+{
+    switch (field) {
+#define TELEMETRY_FIELD_SET(id, name, member, type, offset, scale, unit) \
+        case TELEMETRY_FIELD_##id: snapshot->member = (__typeof__(snapshot->member))value; break;
+        TELEMETRY_SCHEMA(TELEMETRY_FIELD_SET)
+#undef TELEMETRY_FIELD_SET
+        default: break;
+    }
+}
+
+float telemetry_field_scaled(const telemetry_snapshot_t *snapshot, telemetry_field_t field)
+{
+    if (field >= TELEMETRY_FIELD_COUNT) {
+        return 0.0f;
+    }
+    return (float)telemetry_field_get(snapshot, field) / telemetry_fields[field].scale;
+}
+
+static int format_scaled(char *buf, size_t size, int32_t value, uint16_t scale)
+{
+    if (scale <= 1) {
+        return snprintf(buf, size, "%ld", (long)value);
+    }
+    int decimals = 0;
+    for (uint16_t s = scale; s > 1; s /= 10) {
+        decimals++;
+    }
+    uint32_t magnitude = value < 0 ? (uint32_t)(-(int64_t)value) : (uint32_t)value;
+    return snprintf(buf, size, "%s%lu.%0*lu", value < 0 ? "-" : "", (unsigned long)(magnitude / scale),
+                    decimals, (unsigned long)(magnitude % scale));
+}
+
+int telemetry_format_field(char *buf, size_t size, const telemetry_snapshot_t *snapshot, telemetry_field_t field)
+{
+    if (field >= TELEMETRY_FIELD_COUNT) {
+        return snprintf(buf, size, "?");
+    }
+    return format_scaled(buf, size, telemetry_field_get(snapshot, field), telemetry_fields[field].scale);
+}
+
+int telemetry_format_line(char *buf, size_t size, const telemetry_snapshot_t *snapshot)
+{
+    size_t n = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT && n < size; i++) {
+        char value[16];
+        telemetry_format_field(value, sizeof(value), snapshot, (telemetry_field_t)i);
+        const char *unit = telemetry_fields[i].unit;
+        n += snprintf(buf + n, size - n, "%s%s=%s%s%s", i > 0 ? " " : "", telemetry_fields[i].name, value,
+                      unit[0] != '\0' ? " " : "", unit);
+    }
+    return n < size ? (int)n : (int)size - 1;
+}
+
+static uint8_t valid_cells(const telemetry_snapshot_t *snapshot)
+{
+    return snapshot->bms_num_cells < TELEMETRY_MAX_CELLS ? snapshot->bms_num_cells : TELEMETRY_MAX_CELLS;
+}
+
+int telemetry_cell_name(char *buf, size_t size, int cell)
+{
+    return snprintf(buf, size, TELEMETRY_SCHEMA_CELL_NAME, cell + 1);
+}
+
+void telemetry_print(FILE *out, const telemetry_snapshot_t *snapshot)
+{
+    char value[16];
+    char name[16];
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        telemetry_format_field(value, sizeof(value), snapshot, (telemetry_field_t)i);
+        fprintf(out, "%-20s %10s %s\n", telemetry_fields[i].name, value, telemetry_fields[i].unit);
+    }
+    for (uint8_t i = 0; i < valid_cells(snapshot); i++) {
+        format_scaled(value, sizeof(value), snapshot->cell_mv[i], TELEMETRY_SCHEMA_CELL_SCALE);
+        telemetry_cell_name(name, sizeof(name), i);
+        fprintf(out, "%-20s %10s V\n", name, value);
+    }
+}
+
+void telemetry_print_csv_header(FILE *out)
+{
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        fprintf(out, "%s,", telemetry_fields[i].name);
+    }
+    char name[16];
+    for (int i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+        telemetry_cell_name(name, sizeof(name), i);
+        fprintf(out, "%s%s", name, i < TELEMETRY_MAX_CELLS - 1 ? "," : "\n");
+    }
+}
+
+void telemetry_print_csv_row(FILE *out, const telemetry_snapshot_t *snapshot)
+{
+    char value[16];
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        telemetry_format_field(value, sizeof(value), snapshot, (telemetry_field_t)i);
+        fprintf(out, "%s,", value);
+    }
+    // Cells past num_cells stay empty
+    for (int i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+        if (i < valid_cells(snapshot)) {
+            format_scaled(value, sizeof(value), snapshot->cell_mv[i], TELEMETRY_SCHEMA_CELL_SCALE);
+            fputs(value, out);
+        }
+        fputc(i < TELEMETRY_MAX_CELLS - 1 ? ',' : '\n', out);
+    }
+}
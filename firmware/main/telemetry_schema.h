@@ -0,0 +1,109 @@
+#ifndef TELEMETRY_SCHEMA_H
+#define TELEMETRY_SCHEMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "telemetry.h"
+
+// The one place that knows the telemetry fields. Everything that walks them
+// is generated from TELEMETRY_SCHEMA: the frame decoder and encoder in
+// telemetry_decode.c, the field table, getters and printers in
+// telemetry_schema.c, the channels of the ride log and the USB stream. The
+// host tools read this table out of the header (tools/telemetry_schema.py),
+// so fake_thumb.py encodes frames from it as well.
+//
+// X(ID, name, member, wire type, offset, scale, unit)
+//   ID        TELEMETRY_FIELD_<ID>, also the ride log channel name
+//   name      printed name of the scaled value, also the CSV column
+//   member    telemetry_snapshot_t member holding the raw value
+//   wire type I16, I32 or U8, big endian on the wire
+//   offset    byte offset in the notify
+//   scale     raw units per unit, 100 for the 0.01 fields
+//   unit      printed after the scaled value
+//
+// Wire order is by offset. Cell voltages follow the fixed fields as
+// TELEMETRY_MAX_CELLS big endian I16 in mV, NUM_CELLS of them valid.
+//
+// Add a field here, at a free offset, and every consumer picks it up. The
+// ride log and the stream keep their own field lists below because their
+// order is part of a stored or wire format.
+
+#define TELEMETRY_SCHEMA(X) \
+    X(TEMP_MOS,      "temp_mos",      temp_mos_c100,       I16,  0, 100, "degC") \
+    X(TEMP_MOTOR,    "temp_motor",    temp_motor_c100,     I16,  2, 100, "degC") \
+    X(CURRENT_MOTOR, "current_motor", current_motor_c100,  I16,  4, 100, "A"   ) \
+    X(CURRENT_IN,    "current_in",    current_in_c100,     I16,  6, 100, "A"   ) \
+    X(ERPM,          "erpm",          erpm,                I32,  8,   1, "ERPM") \
+    X(VOLTAGE,       "voltage",       voltage_c100,        I16, 12, 100, "V"   ) \
+    X(BMS_VOLTAGE,   "bms_voltage",   bms_voltage_c100,    I16, 14, 100, "V"   ) \
+    X(BMS_CURRENT,   "bms_current",   bms_current_c100,    I16, 16, 100, "A"   ) \
+    X(BMS_REMAINING, "bms_remaining", bms_remaining_c100,  I16, 18, 100, "Ah"  ) \
+    X(BMS_NOMINAL,   "bms_nominal",   bms_nominal_c100,    I16, 20, 100, "Ah"  ) \
+    X(NUM_CELLS,     "num_cells",     bms_num_cells,       U8,  22,   1, ""    )
+
+#define TELEMETRY_SCHEMA_CELLS_OFS  23
+#define TELEMETRY_SCHEMA_CELL_SCALE 1000    // mV
+// Column name of cell i, counted from 1 and in V: "cell1_v". The CSV
+// printers here and the tools/ scripts all take it from this line.
+#define TELEMETRY_SCHEMA_CELL_NAME  "cell%d_v"
+#define TELEMETRY_SCHEMA_FRAME_LEN  (TELEMETRY_SCHEMA_CELLS_OFS + TELEMETRY_MAX_CELLS * 2)
+// Frame v2 leaves out the cells past NUM_CELLS, so its length follows the
+// cell count: 23 bytes without a BMS, the full frame with all 16 cells
+#define TELEMETRY_SCHEMA_V2_LEN(cells) (TELEMETRY_SCHEMA_CELLS_OFS + (cells) * 2)
+#define TELEMETRY_LINE_LEN          256     // Fits telemetry_format_line
+
+// Ride log channels taken from the snapshot, in record order
+#define RIDE_LOG_TELEMETRY_FIELDS(X) \
+    X(ERPM) X(CURRENT_MOTOR) X(CURRENT_IN) X(TEMP_MOS) X(TEMP_MOTOR) \
+    X(VOLTAGE) X(BMS_VOLTAGE) X(BMS_CURRENT) X(BMS_REMAINING)
+
+// Stream telemetry record fields, in wire order
+#define STREAM_TELEMETRY_FIELDS(X) \
+    X(ERPM) X(CURRENT_MOTOR) X(CURRENT_IN) X(VOLTAGE) X(TEMP_MOS) \
+    X(TEMP_MOTOR) X(BMS_VOLTAGE) X(BMS_CURRENT) X(BMS_REMAINING)
+
+typedef enum {
+    TELEMETRY_WIRE_U8 = 1,
+    TELEMETRY_WIRE_I16 = 2,
+    TELEMETRY_WIRE_I32 = 4,         // Value is the size in bytes
+} telemetry_wire_type_t;
+
+typedef enum {
+#define TELEMETRY_FIELD_ENUM(id, name, member, type, offset, scale, unit) TELEMETRY_FIELD_##id,
+    TELEMETRY_SCHEMA(TELEMETRY_FIELD_ENUM)
+#undef TELEMETRY_FIELD_ENUM
+    TELEMETRY_FIELD_COUNT,
+} telemetry_field_t;
+
+typedef struct {
+    const char *name;
+    const char *member;             // Snapshot member with the raw value
+    const char *unit;
+    telemetry_wire_type_t type;
+    uint8_t offset;
+    uint16_t scale;
+} telemetry_field_info_t;
+
+extern const telemetry_field_info_t telemetry_fields[TELEMETRY_FIELD_COUNT];
+
+int32_t telemetry_field_get(const telemetry_snapshot_t *snapshot, telemetry_field_t field);
+void telemetry_field_set(telemetry_snapshot_t *snapshot, telemetry_field_t field, int32_t value);
+// Raw value divided by the scale
+float telemetry_field_scaled(const telemetry_snapshot_t *snapshot, telemetry_field_t field);
+
+// "12.34" with as many decimals as the scale has, no unit. Returns the length.
+int telemetry_format_field(char *buf, size_t size, const telemetry_snapshot_t *snapshot, telemetry_field_t field);
+// "name=value unit" for every field on one line, cells left out, e.g.
+// "erpm=-1234 ERPM voltage=41.20 V num_cells=10"
+int telemetry_format_line(char *buf, size_t size, const telemetry_snapshot_t *snapshot);
+// One "name value unit" line per field, then the valid cells
+void telemetry_print(FILE *out, const telemetry_snapshot_t *snapshot);
+// TELEMETRY_SCHEMA_CELL_NAME of the 0-based cell. Returns the length.
+int telemetry_cell_name(char *buf, size_t size, int cell);
+// Fields in schema order, then cell1_v..cellN_v, scaled
+void telemetry_print_csv_header(FILE *out);
+void telemetry_print_csv_row(FILE *out, const telemetry_snapshot_t *snapshot);
+
+#endif // TELEMETRY_SCHEMA_H
@@ -5,12 +5,15 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include <string.h>
+#include <stdarg.h>
 #include <stdint.h>
-#include "nvs_flash.h"
-#include "nvs.h"
+#include "settings.h"
 #include "target_config.h"
 #include "ble.h"
 #include "power.h"
+#include "throttle_map.h"
+#include "latency_bench.h"
+#include "deadline_monitor.h"
 
 static const char *TAG = "ADC";
 static adc_oneshot_unit_handle_t adc1_handle;
@@ -18,6 +21,8 @@ static adc_oneshot_unit_init_cfg_t init_config1;
 static adc_oneshot_chan_cfg_t config;
 static QueueHandle_t adc_display_queue = NULL;
 static uint32_t latest_adc_value = 0;
+static int32_t latest_throttle_raw = 0;
+static uint8_t latest_throttle_mapped = 0;
 static bool adc_initialized = false;
 static int error_count = 0;
 static const int MAX_ERRORS = 5;
@@ -29,7 +34,7 @@ static uint32_t brake_input_min_value = ADC_INITIAL_MIN_VALUE;
 #endif
 static bool calibration_done = false;
 static bool calibration_in_progress = false;
-static esp_err_t load_calibration_from_nvs(void);
+static esp_err_t load_calibration(void);
 
 void adc_deinit(void);
 
@@ -43,7 +48,7 @@ esp_err_t adc_init(void)
     esp_err_t ret;
 
     // Create queue first
-    adc_display_queue = xQueueCreate(10, sizeof(uint32_t));
+    adc_display_queue = xQueueCreate(10, sizeof(uint8_t));
     if (adc_display_queue == NULL) {
         ESP_LOGE(TAG, "Failed to create queue");
         return ESP_FAIL;
@@ -88,24 +93,28 @@ int32_t throttle_read_value(void)
     }
 
     // Take multiple readings and average
-    const int NUM_SAMPLES = 5;
-    int32_t sum = 0;
+    int32_t samples[THROTTLE_MAP_OVERSAMPLE];
     int valid_samples = 0;
 
-    for (int i = 0; i < NUM_SAMPLES; i++) {
+    for (int i = 0; i < THROTTLE_MAP_OVERSAMPLE; i++) {
         int adc_raw = 0;
         esp_err_t ret = adc_oneshot_read(adc1_handle, THROTTLE_PIN, &adc_raw);
 
+        // The latency bench swaps the pin for its signal, the timing stays
+        int32_t virtual_raw;
+        if (latency_bench_sample(LATENCY_BENCH_THROTTLE, &virtual_raw)) {
+            adc_raw = virtual_raw;
+        }
+
         if (ret == ESP_OK) {
-            sum += adc_raw;
-            valid_samples++;
+            samples[valid_samples++] = adc_raw;
         }
 
         // Small delay between samples
         vTaskDelay(pdMS_TO_TICKS(1));
     }
 
-    return valid_samples > 0 ? (sum / valid_samples) : -1;
+    return throttle_map_mean(samples, valid_samples);
 }
 
 #ifdef CONFIG_TARGET_DUAL_THROTTLE
@@ -117,24 +126,27 @@ int32_t brake_read_value(void)
     }
 
     // Take multiple readings and average
-    const int NUM_SAMPLES = 5;
-    int32_t sum = 0;
+    int32_t samples[THROTTLE_MAP_OVERSAMPLE];
     int valid_samples = 0;
 
-    for (int i = 0; i < NUM_SAMPLES; i++) {
+    for (int i = 0; i < THROTTLE_MAP_OVERSAMPLE; i++) {
         int adc_raw = 0;
         esp_err_t ret = adc_oneshot_read(adc1_handle, BREAK_PIN, &adc_raw);
 
+        int32_t virtual_raw;
+        if (latency_bench_sample(LATENCY_BENCH_BRAKE, &virtual_raw)) {
+            adc_raw = virtual_raw;
+        }
+
         if (ret == ESP_OK) {
-            sum += adc_raw;
-            valid_samples++;
+            samples[valid_samples++] = adc_raw;
         }
 
         // Small delay between samples
         vTaskDelay(pdMS_TO_TICKS(1));
     }
 
-    return valid_samples > 0 ? (sum / valid_samples) : -1;
+    return throttle_map_mean(samples, valid_samples);
 }
 #endif
 
@@ -173,7 +185,11 @@ static void adc_task(void *pvParameters) {
         // Single throttle mapping (lite mode)
         uint8_t mapped_value = map_adc_value(adc_value);
 #endif
-        
+        latest_throttle_raw = adc_raw;
+        latest_throttle_mapped = mapped_value;
+        latest_adc_value = mapped_value;
+        deadline_monitor_kick(DEADLINE_THROTTLE_SAMPLE);
+
         if(!is_connect){
             // Only monitor value changes and reset timer when BLE is not connected
             if (abs((int32_t)mapped_value - (int32_t)last_value) > CHANGE_THRESHOLD) {
@@ -198,18 +214,11 @@ void adc_start_task(void) {
 
 #if CALIBRATE_THROTTLE
     ESP_LOGI(TAG, "Force calibration flag set, performing calibration");
-    // Clear existing calibration
-    nvs_handle_t nvs_handle;
-    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
-        nvs_erase_key(nvs_handle, NVS_KEY_CALIBRATED);
-        nvs_commit(nvs_handle);
-        nvs_close(nvs_handle);
-    }
-    throttle_calibrate();
+    throttle_calibrate(true);
 #else
     // Only calibrate if no valid calibration exists
-    if (load_calibration_from_nvs() != ESP_OK) {
-        throttle_calibrate();
+    if (load_calibration() != ESP_OK) {
+        throttle_calibrate(true);
     }
 #endif
 
@@ -221,6 +230,14 @@ uint32_t adc_get_latest_value(void) {
     return latest_adc_value;
 }
 
+int32_t throttle_get_latest_raw(void) {
+    return latest_throttle_raw;
+}
+
+uint8_t throttle_get_latest_mapped(void) {
+    return latest_throttle_mapped;
+}
+
 void adc_deinit(void)
 {
     if (!adc_initialized) {
@@ -240,107 +257,51 @@ void adc_deinit(void)
     adc_initialized = false;
 }
 
-static esp_err_t load_calibration_from_nvs(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
-
-    // Open NVS
-    err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        return err;
-    }
+static esp_err_t load_calibration(void) {
+    settings_t settings;
+    settings_get(&settings);
 
-    // Try to read calibration flag
-    uint8_t is_calibrated = 0;
-    err = nvs_get_u8(nvs_handle, NVS_KEY_CALIBRATED, &is_calibrated);
-    if (err != ESP_OK || !is_calibrated) {
-        nvs_close(nvs_handle);
+    if (!settings.throttle_calibrated) {
         return ESP_ERR_NOT_FOUND;
     }
 
-    // Read throttle calibration values
-    err = nvs_get_u32(nvs_handle, NVS_KEY_MIN, &adc_input_min_value);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
-    }
-
-    err = nvs_get_u32(nvs_handle, NVS_KEY_MAX, &adc_input_max_value);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
-    }
-
+    adc_input_min_value = settings.throttle_min;
+    adc_input_max_value = settings.throttle_max;
 #ifdef CONFIG_TARGET_DUAL_THROTTLE
-    // Read brake calibration values (if available, use defaults otherwise)
-    err = nvs_get_u32(nvs_handle, NVS_KEY_BRAKE_MIN, &brake_input_min_value);
-    if (err != ESP_OK) {
-        brake_input_min_value = ADC_INITIAL_MIN_VALUE;
-    }
-
-    err = nvs_get_u32(nvs_handle, NVS_KEY_BRAKE_MAX, &brake_input_max_value);
-    if (err != ESP_OK) {
-        brake_input_max_value = ADC_INITIAL_MAX_VALUE;
-    }
+    brake_input_min_value = settings.brake_min;
+    brake_input_max_value = settings.brake_max;
 #endif
 
-    nvs_close(nvs_handle);
     calibration_done = true;
     return ESP_OK;
 }
 
-static esp_err_t save_calibration_to_nvs(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
-
-    // Open NVS
-    err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        return err;
-    }
-
-    // Save throttle calibration values
-    err = nvs_set_u32(nvs_handle, NVS_KEY_MIN, adc_input_min_value);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
-    }
-
-    err = nvs_set_u32(nvs_handle, NVS_KEY_MAX, adc_input_max_value);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
-    }
+static esp_err_t save_calibration(void) {
+    settings_t settings;
+    settings_get(&settings);
 
+    settings.throttle_calibrated = calibration_done;
+    settings.throttle_min = adc_input_min_value;
+    settings.throttle_max = adc_input_max_value;
 #ifdef CONFIG_TARGET_DUAL_THROTTLE
-    // Save brake calibration values
-    err = nvs_set_u32(nvs_handle, NVS_KEY_BRAKE_MIN, brake_input_min_value);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
-    }
-
-    err = nvs_set_u32(nvs_handle, NVS_KEY_BRAKE_MAX, brake_input_max_value);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
-    }
+    settings.brake_min = brake_input_min_value;
+    settings.brake_max = brake_input_max_value;
 #endif
 
-    // Set calibration flag
-    err = nvs_set_u8(nvs_handle, NVS_KEY_CALIBRATED, 1);
-    if (err != ESP_OK) {
-        nvs_close(nvs_handle);
-        return err;
-    }
+    return settings_save(&settings);
+}
 
-    // Commit changes
-    err = nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
-    return err;
+static void calibration_print(bool verbose, const char *format, ...)
+{
+    if (verbose) {
+        va_list args;
+        va_start(args, format);
+        vprintf(format, args);
+        va_end(args);
+    }
 }
 
-void throttle_calibrate(void) {
+void throttle_calibrate(bool verbose) {
     ESP_LOGI(TAG, "Starting ADC calibration...");
 #ifdef CONFIG_TARGET_DUAL_THROTTLE
     ESP_LOGI(TAG, "Please move throttle and brake through full range during the next 6 seconds");
@@ -351,14 +312,6 @@ void throttle_calibrate(void) {
     // Set calibration in progress flag BEFORE any early returns
     calibration_in_progress = true;
 
-    // Clear existing calibration from NVS to force new calibration
-    nvs_handle_t nvs_handle;
-    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
-        nvs_erase_key(nvs_handle, NVS_KEY_CALIBRATED);
-        nvs_commit(nvs_handle);
-        nvs_close(nvs_handle);
-    }
-
     uint32_t throttle_min = UINT32_MAX;
     uint32_t throttle_max = 0;
 #ifdef CONFIG_TARGET_DUAL_THROTTLE
@@ -395,7 +348,7 @@ void throttle_calibrate(void) {
         progress = (i * 100) / ADC_CALIBRATION_SAMPLES;
         if (progress % 10 == 0 && progress != last_reported_progress) {
             ESP_LOGI(TAG, "Calibration progress: %d%%", progress);
-            printf("Calibration progress: %d%%\n", progress);
+            calibration_print(verbose, "Calibration progress: %d%%\n", progress);
             last_reported_progress = progress;
         }
 
@@ -418,7 +371,7 @@ void throttle_calibrate(void) {
         // Check if the range is sufficient (at least 150 ADC units)
         if (throttle_range < 150) {
             ESP_LOGE(TAG, "Throttle calibration failed - insufficient range: %lu (minimum required: 150)", throttle_range);
-            printf("Throttle calibration failed - insufficient movement detected!\n");
+            calibration_print(verbose, "Throttle calibration failed - insufficient movement detected!\n");
         } else {
             // Add small margins to prevent edge cases (5% margin)
             adc_input_min_value = throttle_min + (throttle_range * 0.05);
@@ -442,7 +395,7 @@ void throttle_calibrate(void) {
         // Check if the range is sufficient (at least 150 ADC units)
         if (brake_range < 150) {
             ESP_LOGE(TAG, "Brake calibration failed - insufficient range: %lu (minimum required: 150)", brake_range);
-            printf("Brake calibration failed - insufficient movement detected!\n");
+            calibration_print(verbose, "Brake calibration failed - insufficient movement detected!\n");
         } else {
             // Add small margins to prevent edge cases (5% margin)
             brake_input_min_value = brake_min + (brake_range * 0.05);
@@ -462,36 +415,30 @@ void throttle_calibrate(void) {
     // Mark calibration as done if at least throttle is valid
     if (throttle_valid) {
         calibration_done = true;
-        printf("Calibration complete!\n");
+        calibration_print(verbose, "Calibration complete!\n");
         if (throttle_valid) {
-            printf("Throttle range: %lu - %lu\n", throttle_min, throttle_max);
+            calibration_print(verbose, "Throttle range: %lu - %lu\n", throttle_min, throttle_max);
         }
 #ifdef CONFIG_TARGET_DUAL_THROTTLE
         if (brake_valid) {
-            printf("Brake range: %lu - %lu\n", brake_min, brake_max);
+            calibration_print(verbose, "Brake range: %lu - %lu\n", brake_min, brake_max);
         }
 #endif
     } else {
         calibration_done = false;
         ESP_LOGE(TAG, "ADC calibration failed");
-        printf("Calibration failed - no valid readings detected\n");
-    }
-
-    // Save calibration to NVS
-    if (save_calibration_to_nvs() != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to save calibration to NVS");
-        printf("Warning: Failed to save calibration to memory\n");
+        calibration_print(verbose, "Calibration failed - no valid readings detected\n");
     }
 
-    // After successful calibration, save to NVS
-    if (calibration_done) {
-        if (save_calibration_to_nvs() == ESP_OK) {
-            ESP_LOGI(TAG, "Calibration saved to NVS");
-            printf("Calibration saved to memory successfully\n");
-        } else {
-            ESP_LOGE(TAG, "Failed to save calibration to NVS");
-            printf("Warning: Failed to save calibration to memory\n");
+    // Store the result, a failed calibration is stored as not calibrated
+    if (save_calibration() == ESP_OK) {
+        if (calibration_done) {
+            ESP_LOGI(TAG, "Calibration saved");
+            calibration_print(verbose, "Calibration saved to memory successfully\n");
         }
+    } else {
+        ESP_LOGE(TAG, "Failed to save calibration");
+        calibration_print(verbose, "Warning: Failed to save calibration to memory\n");
     }
 }
 
@@ -516,40 +463,12 @@ bool throttle_should_use_neutral(void) {
 }
 
 uint8_t map_throttle_value(uint32_t adc_value) {
-    // Constrain input value to the calibrated range
-    if (adc_value < adc_input_min_value) {
-        adc_value = adc_input_min_value;
-    }
-    if (adc_value > adc_input_max_value) {
-        adc_value = adc_input_max_value;
-    }
-
-    // Perform the mapping
-    uint8_t mapped = (uint8_t)((adc_value - adc_input_min_value) *
-           (ADC_OUTPUT_MAX_VALUE - ADC_OUTPUT_MIN_VALUE) /
-           (adc_input_max_value - adc_input_min_value) +
-           ADC_OUTPUT_MIN_VALUE);
-
-    return mapped;
+    return throttle_map_linear(adc_value, adc_input_min_value, adc_input_max_value);
 }
 
 #ifdef CONFIG_TARGET_DUAL_THROTTLE
 uint8_t map_brake_value(uint32_t adc_value) {
-    // Constrain input value to the calibrated range
-    if (adc_value < brake_input_min_value) {
-        adc_value = brake_input_min_value;
-    }
-    if (adc_value > brake_input_max_value) {
-        adc_value = brake_input_max_value;
-    }
-
-    // Perform the mapping (no offset for brake)
-    uint8_t mapped = (uint8_t)((adc_value - brake_input_min_value) *
-           (ADC_OUTPUT_MAX_VALUE - ADC_OUTPUT_MIN_VALUE) /
-           (brake_input_max_value - brake_input_min_value) +
-           ADC_OUTPUT_MIN_VALUE);
-
-    return mapped;
+    return throttle_map_linear(adc_value, brake_input_min_value, brake_input_max_value);
 }
 #endif
 
@@ -557,7 +476,7 @@ uint8_t map_brake_value(uint32_t adc_value) {
 uint8_t get_throttle_brake_ble_value(void) {
     // Neutral value when not calibrated
     if (!calibration_done || calibration_in_progress) {
-        return 127;
+        return THROTTLE_MAP_NEUTRAL;
     }
 
     // Read current throttle and brake values
@@ -565,52 +484,11 @@ uint8_t get_throttle_brake_ble_value(void) {
     int32_t brake_raw = brake_read_value();
 
     if (throttle_raw < 0 || brake_raw < 0) {
-        return 127;  // Return neutral on error
-    }
-
-    // Constrain values to calibrated ranges
-    if (throttle_raw < adc_input_min_value) throttle_raw = adc_input_min_value;
-    if (throttle_raw > adc_input_max_value) throttle_raw = adc_input_max_value;
-    if (brake_raw < brake_input_min_value) brake_raw = brake_input_min_value;
-    if (brake_raw > brake_input_max_value) brake_raw = brake_input_max_value;
-
-    uint32_t brake_range = brake_input_max_value - brake_input_min_value;
-    uint32_t throttle_range = adc_input_max_value - adc_input_min_value;
-
-    if (brake_range == 0 || throttle_range == 0) {
-        return 127;  // Avoid division by zero
-    }
-
-    // Calculate brake factor: 0.0 at MIN, 1.0 at MAX
-    float brake_factor = (float)(brake_raw - brake_input_min_value) / (float)brake_range;
-
-    // Brake overrides throttle: when brake is at MIN, BLE = 0
-    // When brake is at MIN (factor=0): brake forces BLE to 0
-    // When brake is at MAX (factor=1): brake allows throttle control
-    if (brake_factor < 0.01f) {
-        // Brake at MIN: brake overrides, BLE = 0
-        return 0;
-    }
-
-    // Brake is at MAX (or close to MAX): throttle controls BLE value
-    // When throttle at MAX: BLE = 127
-    // When throttle at MIN: BLE = 255
-    float throttle_factor = (float)(throttle_raw - adc_input_min_value) / (float)throttle_range;
-
-    // Invert throttle mapping: throttle MAX (factor=1.0) = 127, throttle MIN (factor=0.0) = 255
-    uint8_t ble_value = 127 + (uint8_t)((1.0f - throttle_factor) * 128.0f);
-
-    // If brake is not fully at MAX, interpolate between brake override (0-127) and throttle control (127-255)
-    if (brake_factor < 1.0f) {
-        // When brake moves from MIN to MAX, it transitions from override (0) to allowing throttle
-        // Brake at MAX: use throttle value (127-255)
-        // Brake between MIN and MAX: interpolate between 0 and throttle value
-        uint8_t brake_override_value = 0;  // When brake at MIN
-        float interpolated = brake_override_value + (brake_factor * (float)ble_value);
-        ble_value = (uint8_t)interpolated;
+        return THROTTLE_MAP_NEUTRAL;  // Return neutral on error
     }
 
-    return ble_value;
+    return throttle_map_combined(throttle_raw, adc_input_min_value, adc_input_max_value,
+                                 brake_raw, brake_input_min_value, brake_input_max_value);
 }
 #endif
 
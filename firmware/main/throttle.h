@@ -26,6 +26,7 @@
 #define ADC_CALIBRATION_SAMPLES 600  // 600 samples over 6 seconds = 1 sample every 10ms
 #define ADC_CALIBRATION_DELAY_MS 10  // 10ms between samples for more accurate timing
 
+// Per-key NVS layout used before the settings blob, only read for migration
 #define NVS_NAMESPACE "adc_cal"
 #define NVS_KEY_MIN "min_val"
 #define NVS_KEY_MAX "max_val"
@@ -37,8 +38,13 @@ esp_err_t adc_init(void);
 int32_t throttle_read_value(void);
 void adc_start_task(void);
 uint32_t adc_get_latest_value(void);
+int32_t throttle_get_latest_raw(void);
+uint8_t throttle_get_latest_mapped(void);
 uint8_t map_throttle_value(uint32_t adc_value);
-void throttle_calibrate(void);
+// Samples the full travel for 6 s and stores the range. verbose prints
+// progress to the console; the binary protocol passes false so no text
+// lands between its frames.
+void throttle_calibrate(bool verbose);
 bool throttle_is_calibrated(void);
 void adc_deinit(void);
 void throttle_get_calibration_values(uint32_t *min_val, uint32_t *max_val);
@@ -0,0 +1,69 @@
+#include "throttle_map.h"
+
+#define OUTPUT_MIN 0
+#define OUTPUT_MAX 255
+
+int32_t throttle_map_mean(const int32_t *samples, int count)
+{
+    if (count <= 0) {
+        return -1;
+    }
+    int32_t sum = 0;
+    for (int i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+    return sum / count;
+}
+
+uint8_t throttle_map_linear(uint32_t adc_value, uint32_t in_min, uint32_t in_max)
+{
+    if (in_max <= in_min) {
+        return OUTPUT_MIN;
+    }
+
+    // Constrain input value to the calibrated range
+    if (adc_value < in_min) {
+        adc_value = in_min;
+    }
+    if (adc_value > in_max) {
+        adc_value = in_max;
+    }
+
+    return (uint8_t)((adc_value - in_min) * (OUTPUT_MAX - OUTPUT_MIN) / (in_max - in_min) + OUTPUT_MIN);
+}
+
+uint8_t throttle_map_combined(int32_t throttle_raw, uint32_t throttle_min, uint32_t throttle_max,
+                              int32_t brake_raw, uint32_t brake_min, uint32_t brake_max)
+{
+    // Constrain values to calibrated ranges
+    if (throttle_raw < (int32_t)throttle_min) throttle_raw = throttle_min;
+    if (throttle_raw > (int32_t)throttle_max) throttle_raw = throttle_max;
+    if (brake_raw < (int32_t)brake_min) brake_raw = brake_min;
+    if (brake_raw > (int32_t)brake_max) brake_raw = brake_max;
+
+    uint32_t brake_range = brake_max - brake_min;
+    uint32_t throttle_range = throttle_max - throttle_min;
+
+    if (brake_max <= brake_min || throttle_max <= throttle_min) {
+        return THROTTLE_MAP_NEUTRAL;  // Avoid division by zero
+    }
+
+    // Calculate brake factor: 0.0 at MIN, 1.0 at MAX
+    float brake_factor = (float)(brake_raw - brake_min) / (float)brake_range;
+
+    // Brake at MIN: brake overrides, BLE = 0
+    if (brake_factor < 0.01f) {
+        return 0;
+    }
+
+    // Invert throttle mapping: throttle MAX (factor=1.0) = 127, throttle MIN (factor=0.0) = 255
+    float throttle_factor = (float)(throttle_raw - throttle_min) / (float)throttle_range;
+    uint8_t ble_value = THROTTLE_MAP_NEUTRAL + (uint8_t)((1.0f - throttle_factor) * 128.0f);
+
+    // Brake between MIN and MAX: interpolate between the override (0) and the throttle value
+    if (brake_factor < 1.0f) {
+        ble_value = (uint8_t)(brake_factor * (float)ble_value);
+    }
+
+    return ble_value;
+}
@@ -0,0 +1,25 @@
+#ifndef THROTTLE_MAP_H
+#define THROTTLE_MAP_H
+
+#include <stdint.h>
+
+// ADC to BLE value mapping, split from throttle.c so the per-sample math
+// has no ESP-IDF dependencies and builds unchanged on a host compiler.
+// throttle.c owns the calibration and passes it in.
+
+#define THROTTLE_MAP_NEUTRAL    127
+#define THROTTLE_MAP_OVERSAMPLE 5       // ADC reads averaged per sample
+
+// Mean of the valid oversamples of one reading, -1 if there are none
+int32_t throttle_map_mean(const int32_t *samples, int count);
+
+// Linear map of adc_value clamped to [in_min, in_max] onto 0..255
+uint8_t throttle_map_linear(uint32_t adc_value, uint32_t in_min, uint32_t in_max);
+
+// Dual throttle BLE value: brake at its minimum forces 0, brake at its
+// maximum hands control to the (inverted) throttle in 127..255, in between
+// the two are interpolated. Neutral if either range is empty.
+uint8_t throttle_map_combined(int32_t throttle_raw, uint32_t throttle_min, uint32_t throttle_max,
+                              int32_t brake_raw, uint32_t brake_min, uint32_t brake_max);
+
+#endif // THROTTLE_MAP_H
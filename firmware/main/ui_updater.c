@@ -9,14 +9,22 @@
 #include "esp_err.h"
 #include "freertos/semphr.h"
 #include "vesc_config.h"
+#include "odometer.h"
+#include "ride_stats.h"
+#include "stats_screen.h"
+#include "chart_screen.h"
+#include "range.h"
+#include "pack_monitor.h"
 #include "hw_config.h"
 #include "driver/gpio.h"
+#include "residency.h"
+#include "telemetry.h"
+#include "glass_trace.h"
+#include "link_quality.h"
 #include <stdio.h>
 #include <string.h>
 
 #define TAG "UI_UPDATER"
-#define TRIP_NVS_NAMESPACE "trip_data"
-#define NVS_KEY_TRIP_KM "trip_km"
 
 static SemaphoreHandle_t lvgl_mutex = NULL;
 static const TickType_t LVGL_MUTEX_TIMEOUT = pdMS_TO_TICKS(10);
@@ -24,8 +32,6 @@ static const TickType_t LVGL_MUTEX_TIMEOUT = pdMS_TO_TICKS(10);
 static volatile bool force_config_reload = false;
 
 static uint8_t connection_quality = 0;
-static float total_trip_km = 0.0f;
-static uint32_t last_update_time = 0;
 
 extern volatile bool entering_power_off_mode;
 
@@ -33,6 +39,7 @@ extern volatile bool entering_power_off_mode;
 #define TRIP_UPDATE_MS       1000    // 1Hz for distance
 #define BATTERY_UPDATE_MS    1000    // 1Hz for battery
 #define CONNECTION_UPDATE_MS 5000    // 0.2Hz for connection
+#define STATS_UPDATE_MS      1000    // 1Hz for the stats screen
 
 static lv_obj_t* get_current_screen(void) {
     return lv_scr_act();
@@ -45,18 +52,6 @@ void ui_updater_init(void) {
     } else {
         ESP_LOGI(TAG, "LVGL mutex created with priority inheritance");
     }
-
-    // Initialize NVS for trip data
-    esp_err_t err = ui_init_trip_nvs();
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Failed to initialize trip NVS, trip data may not be saved");
-    }
-
-    // Initialize with current time
-    last_update_time = esp_timer_get_time() / 1000;
-
-    // Load trip distance from NVS
-    ui_load_trip_distance();
 }
 
 bool take_lvgl_mutex(void) {
@@ -79,7 +74,14 @@ void give_lvgl_mutex(void) {
     }
 }
 
-void ui_update_speed(int32_t value) {
+// Receive time of the newest telemetry frame, the tag for glass_trace
+static int64_t telemetry_rx_time(void) {
+    telemetry_snapshot_t snapshot;
+    telemetry_get_latest(&snapshot);
+    return snapshot.rx_time_us;
+}
+
+static void show_speed(int32_t value, int64_t rx_time_us) {
     if (entering_power_off_mode || !objects.speedlabel) return;
 
     static int32_t last_value = -1;
@@ -89,6 +91,7 @@ void ui_update_speed(int32_t value) {
         if (take_lvgl_mutex()) {
             if (get_current_screen() == objects.home_screen) {
                 lv_label_set_text_fmt(objects.speedlabel, "%ld", value);
+                glass_trace_mark(GLASS_TRACE_SPEED, objects.speedlabel, rx_time_us);
             }
             give_lvgl_mutex();
             last_value = value;
@@ -96,6 +99,10 @@ void ui_update_speed(int32_t value) {
     }
 }
 
+void ui_update_speed(int32_t value) {
+    show_speed(value, 0);
+}
+
 void ui_update_battery_percentage(int percentage) {
     if (entering_power_off_mode) return;
 
@@ -110,11 +117,11 @@ void ui_update_battery_percentage(int percentage) {
 
     if (get_current_screen() == objects.home_screen) {
         if (is_charging) {
-            lv_img_set_src(objects.controller_battery, &img_battery_charging);
+            lv_img_set_src(objects.controller_battery, residency_img(&img_battery_charging));
             lv_label_set_text_fmt(objects.controller_battery_text, "%d", percentage);
             lv_obj_set_style_text_color(objects.controller_battery_text, lv_color_hex(0xFFFFFF), LV_PART_MAIN | LV_STATE_DEFAULT);
         } else {
-            lv_img_set_src(objects.controller_battery, &img_battery);
+            lv_img_set_src(objects.controller_battery, residency_img(&img_battery));
             lv_label_set_text_fmt(objects.controller_battery_text, "%d", percentage);
             lv_obj_set_style_text_color(objects.controller_battery_text, lv_color_hex(0x000000), LV_PART_MAIN | LV_STATE_DEFAULT);
         }
@@ -144,10 +151,12 @@ void ui_update_skate_battery_percentage(int percentage) {
     if (entering_power_off_mode) return;
 
     if (objects.skate_battery_text == NULL) return;
+    int64_t rx_time_us = telemetry_rx_time();
 
     if (take_lvgl_mutex()) {
         if (get_current_screen() == objects.home_screen) {
             lv_label_set_text_fmt(objects.skate_battery_text, "%d", percentage);
+            glass_trace_mark(GLASS_TRACE_SKATE_BATTERY, objects.skate_battery_text, rx_time_us);
         }
         give_lvgl_mutex();
     }
@@ -157,6 +166,7 @@ void ui_update_skate_battery_voltage_display(float voltage) {
     if (entering_power_off_mode) return;
 
     if (objects.skate_battery_text == NULL) return;
+    int64_t rx_time_us = telemetry_rx_time();
     char voltage_str[16];
     int volts = (int)voltage;
     int tenths = (int)((voltage - volts) * 10 + 0.5f);
@@ -169,6 +179,7 @@ void ui_update_skate_battery_voltage_display(float voltage) {
     if (take_lvgl_mutex()) {
         if (get_current_screen() == objects.home_screen) {
             lv_label_set_text(objects.skate_battery_text, voltage_str);
+            glass_trace_mark(GLASS_TRACE_SKATE_BATTERY, objects.skate_battery_text, rx_time_us);
         }
         give_lvgl_mutex();
     }
@@ -178,15 +189,11 @@ int get_connection_quality(void) {
     return connection_quality;
 }
 
-void ui_update_connection_quality(int rssi) {
-    if (rssi >= 0) {
-        connection_quality = 0;
-    } else {
-        connection_quality = ((rssi + 100) * 100) / 70;
-
-        if (connection_quality > 100) connection_quality = 100;
+void ui_update_connection_quality(int quality) {
+    if (quality < 0) quality = 0;
+    if (quality > 100) quality = 100;
 
-    }
+    connection_quality = (uint8_t)quality;
     ui_update_connection_icon();
 }
 
@@ -197,7 +204,7 @@ void ui_update_connection_icon(void) {
 
     if (take_lvgl_mutex()) {
         if (get_current_screen() == objects.home_screen) {
-            const void* icon_src = NULL;
+            const lv_img_dsc_t* icon_src = NULL;
             if (!is_connect) {
                 icon_src = &img_connection_0;
             } else if (connection_quality >= 30) {
@@ -210,46 +217,37 @@ void ui_update_connection_icon(void) {
                 icon_src = &img_connection_0;
             }
 
-            lv_img_set_src(objects.connection_icon, icon_src);
+            lv_img_set_src(objects.connection_icon, residency_img(icon_src));
         }
         give_lvgl_mutex();
     }
 }
 
-void ui_update_trip_distance(int32_t speed_kmh) {
+void ui_update_trip_distance(bool is_mph) {
     if (entering_power_off_mode) return;
 
     if (objects.odometer == NULL) return;
 
-    uint32_t current_time = esp_timer_get_time() / 1000;
-
-    if (last_update_time > 0) {
-        float elapsed_hours = (current_time - last_update_time) / 3600000.0f;
-        float distance = (speed_kmh * elapsed_hours);
-
-        total_trip_km += distance;
-        if (total_trip_km > 999.0f) {
-            ESP_LOGI(TAG, "Trip distance exceeded 999 units, resetting to 0");
-            total_trip_km = 0.0f;
-        }
-    }
-
-    last_update_time = current_time;
+    int64_t rx_time_us = telemetry_rx_time();
+    uint64_t trip_mm = odometer_get_trip_mm();
+    // Tenths of a kilometre or a mile
+    uint32_t tenths = is_mph ? (uint32_t)(trip_mm / 160934) : (uint32_t)(trip_mm / 100000);
 
     char buf[16];
-    snprintf(buf, sizeof(buf), "%.1f", total_trip_km);
+    snprintf(buf, sizeof(buf), "%lu.%lu", tenths / 10, tenths % 10);
 
     if (take_lvgl_mutex()) {
         if (get_current_screen() == objects.home_screen) {
             lv_label_set_text(objects.odometer, buf);
             lv_obj_invalidate(objects.odometer);
+            glass_trace_mark(GLASS_TRACE_TRIP, objects.odometer, rx_time_us);
         }
         give_lvgl_mutex();
     }
 }
 
 void ui_reset_trip_distance(void) {
-    total_trip_km = 0.0f;
+    odometer_reset_trip();
 
     if (!take_lvgl_mutex()) {
         ESP_LOGW(TAG, "Failed to take LVGL mutex for trip reset");
@@ -264,112 +262,264 @@ void ui_reset_trip_distance(void) {
     give_lvgl_mutex();
 }
 
-esp_err_t ui_save_trip_distance(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+void ui_check_mutex_health(void) {
+    static uint32_t last_check_time = 0;
+    uint32_t current_time = esp_timer_get_time() / 1000000;
 
-    err = nvs_open(TRIP_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS for trip data: %s", esp_err_to_name(err));
-        return err;
-    }
+    if (current_time - last_check_time >= 30) {
+        if (lvgl_mutex != NULL && xSemaphoreTake(lvgl_mutex, pdMS_TO_TICKS(1)) != pdTRUE) {
+            ESP_LOGW(TAG, "LVGL mutex appears to be stuck, recreating");
 
-    err = nvs_set_blob(nvs_handle, NVS_KEY_TRIP_KM, &total_trip_km, sizeof(float));
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error saving trip distance: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        return err;
+            SemaphoreHandle_t new_mutex = xSemaphoreCreateMutex();
+            if (new_mutex != NULL) {
+                lvgl_mutex = new_mutex;
+
+                ESP_LOGW(TAG, "LVGL mutex replaced");
+            } else {
+                ESP_LOGE(TAG, "Failed to create new LVGL mutex");
+            }
+        } else if (lvgl_mutex != NULL) {
+            xSemaphoreGive(lvgl_mutex);
+        }
+
+        last_check_time = current_time;
     }
+}
 
-    err = nvs_commit(nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing NVS: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Trip distance saved: %.2f km", total_trip_km);
+void ui_update_speed_unit(bool is_mph) {
+    if (entering_power_off_mode || !objects.static_speed) return;
+
+    if (take_lvgl_mutex()) {
+        if (get_current_screen() == objects.home_screen) {
+            lv_label_set_text(objects.static_speed, is_mph ? "mi/h" : "km/h");
+        }
+        give_lvgl_mutex();
     }
+}
 
-    nvs_close(nvs_handle);
-    return err;
+void ui_update_motor_current(float current) {
+    if (entering_power_off_mode || !stats_objects.motor_current) return;
+
+    int64_t rx_time_us = telemetry_rx_time();
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%.1f A", current);
+
+    if (take_lvgl_mutex()) {
+        if (stats_screen_is_active()) {
+            lv_label_set_text(stats_objects.motor_current, buf);
+            glass_trace_mark(GLASS_TRACE_MOTOR_CURRENT, stats_objects.motor_current, rx_time_us);
+        }
+        give_lvgl_mutex();
+    }
 }
 
-esp_err_t ui_load_trip_distance(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err;
+void ui_update_battery_current(float current) {
+    if (entering_power_off_mode || !stats_objects.battery_current) return;
+
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%.1f A", current);
 
-    err = nvs_open(TRIP_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        if (err == ESP_ERR_NVS_NOT_FOUND) {
-            ESP_LOGI(TAG, "No trip data found, starting from 0");
-            total_trip_km = 0.0f;
-            return ESP_OK;
+    if (take_lvgl_mutex()) {
+        if (stats_screen_is_active()) {
+            lv_label_set_text(stats_objects.battery_current, buf);
         }
-        ESP_LOGE(TAG, "Error opening NVS for trip data: %s", esp_err_to_name(err));
-        return err;
+        give_lvgl_mutex();
     }
+}
 
-    size_t required_size = sizeof(float);
-    err = nvs_get_blob(nvs_handle, NVS_KEY_TRIP_KM, &total_trip_km, &required_size);
-    if (err != ESP_OK) {
-        if (err == ESP_ERR_NVS_NOT_FOUND) {
-            ESP_LOGI(TAG, "No trip data found, starting from 0");
-            total_trip_km = 0.0f;
-            err = ESP_OK;
-        } else {
-            ESP_LOGE(TAG, "Error loading trip distance: %s", esp_err_to_name(err));
+void ui_update_consumption(float consumption) {
+    if (entering_power_off_mode || !stats_objects.consumption) return;
+
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%.1f WH/KM", consumption);
+
+    if (take_lvgl_mutex()) {
+        if (stats_screen_is_active()) {
+            lv_label_set_text(stats_objects.consumption, buf);
         }
-    } else {
-        ESP_LOGI(TAG, "Trip distance loaded: %.2f km", total_trip_km);
+        give_lvgl_mutex();
     }
+}
 
-    nvs_close(nvs_handle);
-    return err;
+static void format_duration(char *buf, size_t len, uint32_t ms) {
+    uint32_t s = ms / 1000;
+    snprintf(buf, len, "%lu:%02lu:%02lu", s / 3600, (s / 60) % 60, s % 60);
 }
 
-esp_err_t ui_init_trip_nvs(void) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(TRIP_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to open NVS namespace: %s", esp_err_to_name(err));
-        return err;
+static void format_speed(char *buf, size_t len, uint32_t mm_s, bool is_mph) {
+    // Tenths of km/h or mi/h
+    uint32_t tenths = is_mph ? (uint32_t)((uint64_t)mm_s * 36000 / 1609344)
+                             : (uint32_t)((uint64_t)mm_s * 36 / 1000);
+    snprintf(buf, len, "%lu.%lu %s", tenths / 10, tenths % 10, is_mph ? "MI/H" : "KM/H");
+}
+
+static void format_range(char *buf, size_t len, const range_estimate_t *estimate, bool is_mph) {
+    if (estimate->source == RANGE_SOURCE_NONE) {
+        snprintf(buf, len, "--");
+        return;
     }
+    uint32_t divisor = is_mph ? 1609 : 1000;
+    snprintf(buf, len, "%lu-%lu %s", estimate->range_low_m / divisor,
+             estimate->range_high_m / divisor, is_mph ? "MI" : "KM");
+}
 
-    nvs_close(nvs_handle);
-    return ESP_OK;
+static void format_temp(char *buf, size_t len, int16_t temp_c100) {
+    if (temp_c100 == RIDE_STATS_NO_TEMP) {
+        snprintf(buf, len, "--");
+        return;
+    }
+    // Whole degrees, rounded away from zero past .5
+    int whole = (temp_c100 + (temp_c100 < 0 ? -50 : 50)) / 100;
+    snprintf(buf, len, "%d C", whole);
 }
 
-void ui_check_mutex_health(void) {
-    static uint32_t last_check_time = 0;
-    uint32_t current_time = esp_timer_get_time() / 1000000;
+// Range line at the bottom of the home screen, created on first use
+static lv_obj_t *range_label = NULL;
 
-    if (current_time - last_check_time >= 30) {
-        if (lvgl_mutex != NULL && xSemaphoreTake(lvgl_mutex, pdMS_TO_TICKS(1)) != pdTRUE) {
-            ESP_LOGW(TAG, "LVGL mutex appears to be stuck, recreating");
+void ui_update_range(bool is_mph) {
+    if (entering_power_off_mode || objects.home_screen == NULL) return;
 
-            SemaphoreHandle_t new_mutex = xSemaphoreCreateMutex();
-            if (new_mutex != NULL) {
-                lvgl_mutex = new_mutex;
+    range_estimate_t estimate;
+    range_get_estimate(&estimate);
 
-                ESP_LOGW(TAG, "LVGL mutex replaced");
-            } else {
-                ESP_LOGE(TAG, "Failed to create new LVGL mutex");
+    char range[24];
+    format_range(range, sizeof(range), &estimate, is_mph);
+
+    if (take_lvgl_mutex()) {
+        if (range_label == NULL) {
+            range_label = lv_label_create(objects.home_screen);
+            lv_obj_align(range_label, LV_ALIGN_BOTTOM_MID, 0, -4);
+            lv_obj_set_style_text_color(range_label, lv_color_hex(0xff808080), LV_PART_MAIN | LV_STATE_DEFAULT);
+            lv_obj_set_style_text_font(range_label, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
+        }
+        if (get_current_screen() == objects.home_screen) {
+            lv_label_set_text_fmt(range_label, "RANGE %s", range);
+        }
+        give_lvgl_mutex();
+    }
+}
+
+// Pack alert line on the home screen, shows the latest active alert
+static lv_obj_t *pack_alert_label = NULL;
+
+static void pack_alert_callback(const pack_event_t *event, void *user_data) {
+    if (entering_power_off_mode || objects.home_screen == NULL) return;
+
+    pack_status_t status;
+    pack_monitor_get_status(&status);
+
+    char text[32] = "";
+    if (event->active) {
+        switch (event->alert) {
+            case PACK_ALERT_LOW_CELL:
+                snprintf(text, sizeof(text), "LOW CELL %ld.%02ld V", event->value / 1000, (event->value % 1000) / 10);
+                break;
+            case PACK_ALERT_IMBALANCE:
+                snprintf(text, sizeof(text), "CELL DELTA %ld MV", event->value);
+                break;
+            case PACK_ALERT_TEMP_MOS:
+                snprintf(text, sizeof(text), "FET HOT %ld C", event->value / 100);
+                break;
+            case PACK_ALERT_TEMP_MOTOR:
+                snprintf(text, sizeof(text), "MOTOR HOT %ld C", event->value / 100);
+                break;
+            default:
+                break;
+        }
+    } else if (status.alerts != 0) {
+        // Another alert is still active, keep the line up
+        for (int i = 0; i < PACK_ALERT_COUNT; i++) {
+            if (status.alerts & (1UL << i)) {
+                snprintf(text, sizeof(text), "%s", pack_alert_name((pack_alert_t)i));
+                break;
             }
-        } else if (lvgl_mutex != NULL) {
-            xSemaphoreGive(lvgl_mutex);
         }
+    }
 
-        last_check_time = current_time;
+    if (take_lvgl_mutex()) {
+        if (pack_alert_label == NULL) {
+            pack_alert_label = lv_label_create(objects.home_screen);
+            lv_obj_align(pack_alert_label, LV_ALIGN_BOTTOM_MID, 0, -22);
+            lv_obj_set_style_text_color(pack_alert_label, lv_color_hex(0xffff4040), LV_PART_MAIN | LV_STATE_DEFAULT);
+            lv_obj_set_style_text_font(pack_alert_label, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
+        }
+        lv_label_set_text(pack_alert_label, text);
+        give_lvgl_mutex();
     }
 }
 
-void ui_update_speed_unit(bool is_mph) {
-    if (entering_power_off_mode || !objects.static_speed) return;
+// Weak link warning on the home screen, before the link drops
+static lv_obj_t *link_alert_label = NULL;
+
+static void link_quality_callback(const link_quality_event_t *event, void *user_data) {
+    if (entering_power_off_mode || objects.home_screen == NULL) return;
+
+    const char *text = "";
+    if (event->state == LINK_QUALITY_CRITICAL) {
+        text = "LINK CRITICAL";
+    } else if (event->state == LINK_QUALITY_DEGRADED) {
+        text = "WEAK LINK";
+    }
 
     if (take_lvgl_mutex()) {
-        if (get_current_screen() == objects.home_screen) {
-            lv_label_set_text(objects.static_speed, is_mph ? "mi/h" : "km/h");
+        if (link_alert_label == NULL) {
+            link_alert_label = lv_label_create(objects.home_screen);
+            lv_obj_align(link_alert_label, LV_ALIGN_BOTTOM_MID, 0, -40);
+            lv_obj_set_style_text_color(link_alert_label, lv_color_hex(0xffffa000), LV_PART_MAIN | LV_STATE_DEFAULT);
+            lv_obj_set_style_text_font(link_alert_label, &lv_font_montserrat_14, LV_PART_MAIN | LV_STATE_DEFAULT);
+        }
+        lv_label_set_text(link_alert_label, text);
+        give_lvgl_mutex();
+    }
+}
+
+void ui_update_ride_stats(bool is_mph) {
+    if (entering_power_off_mode || !stats_objects.screen) return;
+
+    ride_stats_t stats;
+    ride_stats_get(&stats);
+    const ride_stats_persist_t *t = &stats.totals;
+
+    range_estimate_t estimate;
+    range_get_estimate(&estimate);
+    pack_status_t pack;
+    pack_monitor_get_status(&pack);
+
+    char ride_time[16], moving_time[16], max_speed[20], avg_speed[20], range[24], cells[24];
+    char temp_mos[12], temp_motor[12];
+    format_duration(ride_time, sizeof(ride_time), t->ride_time_ms);
+    format_duration(moving_time, sizeof(moving_time), t->moving_time_ms);
+    format_speed(max_speed, sizeof(max_speed), t->max_speed_mm_s, is_mph);
+    format_speed(avg_speed, sizeof(avg_speed), stats.avg_speed_mm_s, is_mph);
+    format_range(range, sizeof(range), &estimate, is_mph);
+    format_temp(temp_mos, sizeof(temp_mos), t->peak_temp_mos_c100);
+    format_temp(temp_motor, sizeof(temp_motor), t->peak_temp_motor_c100);
+    if (pack.num_cells > 0) {
+        snprintf(cells, sizeof(cells), "%d.%02d-%d.%02d V", pack.min_mv / 1000, (pack.min_mv % 1000) / 10,
+                 pack.max_mv / 1000, (pack.max_mv % 1000) / 10);
+    } else {
+        snprintf(cells, sizeof(cells), "--");
+    }
+
+    if (take_lvgl_mutex()) {
+        if (stats_screen_is_active()) {
+            lv_label_set_text(stats_objects.ride_time, ride_time);
+            lv_label_set_text(stats_objects.moving_time, moving_time);
+            lv_label_set_text(stats_objects.max_speed, max_speed);
+            lv_label_set_text(stats_objects.avg_speed, avg_speed);
+            lv_label_set_text_fmt(stats_objects.energy, "%lu.%01lu WH",
+                                  t->energy_drawn_mwh / 1000, (t->energy_drawn_mwh % 1000) / 100);
+            lv_label_set_text_fmt(stats_objects.regen, "%lu.%01lu WH",
+                                  t->energy_regen_mwh / 1000, (t->energy_regen_mwh % 1000) / 100);
+            lv_label_set_text(stats_objects.peak_temp_mos, temp_mos);
+            lv_label_set_text(stats_objects.peak_temp_motor, temp_motor);
+            lv_label_set_text(stats_objects.range, range);
+            lv_label_set_text(stats_objects.cells, cells);
         }
         give_lvgl_mutex();
     }
+
+    ui_update_consumption(stats.wh_per_km_x10 / 10.0f);
 }
 
 static void speed_update_task(void *pvParameters) {
@@ -395,9 +545,11 @@ static void speed_update_task(void *pvParameters) {
         }
 
         if (is_connect) {
+            // Tag first, the speed is then at least as new as the tag
+            int64_t rx_time_us = telemetry_rx_time();
             int32_t speed = vesc_config_get_speed(&config);
             if (speed >= 0 && speed <= 100) {
-                ui_update_speed(speed);
+                show_speed(speed, rx_time_us);
                 ui_update_speed_unit(config.speed_unit_mph);
             }
         }
@@ -422,8 +574,9 @@ static void trip_distance_update_task(void *pvParameters) {
             force_config_reload = false;
         }
 
-        int32_t speed = vesc_config_get_speed(&config);
-        ui_update_trip_distance(speed);
+        // Distance is integrated per telemetry frame by the kinematics model
+        ui_update_trip_distance(config.speed_unit_mph);
+        ui_update_range(config.speed_unit_mph);
         vTaskDelay(pdMS_TO_TICKS(TRIP_UPDATE_MS));
     }
 }
@@ -488,6 +641,23 @@ static void battery_update_task(void *pvParameters) {
     }
 }
 
+static void stats_update_task(void *pvParameters) {
+    vesc_config_t config;
+
+    while (1) {
+        if (stats_screen_is_active()) {
+            if (vesc_config_load(&config) == ESP_OK) {
+                ui_update_ride_stats(config.speed_unit_mph);
+            }
+            ui_update_motor_current(get_latest_current_motor());
+            ui_update_battery_current(get_latest_current_in());
+        } else if (chart_screen_is_active()) {
+            chart_screen_refresh();
+        }
+        vTaskDelay(pdMS_TO_TICKS(STATS_UPDATE_MS));
+    }
+}
+
 static void connection_update_task(void *pvParameters) {
     while (1) {
         ui_update_connection_icon();
@@ -496,6 +666,8 @@ static void connection_update_task(void *pvParameters) {
 }
 
 void ui_start_update_tasks(void) {
+    pack_monitor_register_callback(pack_alert_callback, NULL);
+    link_quality_register_callback(link_quality_callback, NULL);
     vTaskDelay(pdMS_TO_TICKS(100));
     xTaskCreate(speed_update_task, "speed_update", 4096, NULL, 4, NULL);
     vTaskDelay(pdMS_TO_TICKS(100));
@@ -504,6 +676,8 @@ void ui_start_update_tasks(void) {
     xTaskCreate(battery_update_task, "battery_update", 4096, NULL, 2, NULL);
     vTaskDelay(pdMS_TO_TICKS(100));
     xTaskCreate(connection_update_task, "conn_update", 4096, NULL, 2, NULL);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    xTaskCreate(stats_update_task, "stats_update", 4096, NULL, 2, NULL);
 }
 
 void ui_force_config_reload(void) {
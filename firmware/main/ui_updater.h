@@ -21,22 +21,20 @@ void ui_update_battery_percentage(int percentage);
 void ui_update_motor_current(float current);
 void ui_update_battery_current(float current);
 void ui_update_consumption(float consumption);
-void ui_update_connection_quality(int rssi);
+void ui_update_ride_stats(bool is_mph);
+void ui_update_connection_quality(int quality);   // 0-100, from link_quality.h
 void ui_update_connection_icon(void);
-void ui_update_trip_distance(int32_t speed_kmh);
+void ui_update_trip_distance(bool is_mph);
+void ui_update_range(bool is_mph);
 void ui_reset_trip_distance(void);
 void ui_update_skate_battery_percentage(int percentage);
 void ui_update_skate_battery_voltage_display(float voltage);
 
-esp_err_t ui_save_trip_distance(void);
-esp_err_t ui_load_trip_distance(void);
-
 bool take_lvgl_mutex(void);
 bool take_lvgl_mutex_for_handler(void);
 void give_lvgl_mutex(void);
 SemaphoreHandle_t get_lvgl_mutex_handle(void);
 void ui_check_mutex_health(void);
-esp_err_t ui_init_trip_nvs(void);
 void ui_start_update_tasks(void);
 void ui_force_config_reload(void);
 void ui_update_speed_unit(bool is_mph);
@@ -0,0 +1,381 @@
+#include "usb_proto.h"
+#include <string.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "settings.h"
+#include "vesc_config.h"
+#include "kinematics.h"
+#include "range.h"
+#include "throttle.h"
+#include "ble.h"
+#include "odometer.h"
+#include "ride_stats.h"
+#include "ride_recorder.h"
+#include "stream.h"
+#include "ui_updater.h"
+#include "version.h"
+
+#define TAG "USB_PROTO"
+
+static usb_proto_write_fn_t write_out = NULL;
+static SemaphoreHandle_t tx_mutex = NULL;
+
+static uint8_t rx_frame[USB_PROTO_MAX_FRAME];
+static uint8_t tx_frame[USB_PROTO_MAX_FRAME];
+static uint8_t tx_encoded[USB_PROTO_MAX_ENCODED];
+
+// Log export state, the recorder's write callback has no context pointer
+static uint8_t export_seq = 0;
+static uint32_t export_offset = 0;
+
+size_t usb_proto_cobs_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t code_pos = 0;
+    size_t out_pos = 1;
+    uint8_t code = 1;
+
+    for (size_t i = 0; i < len; i++) {
+        if (in[i] == 0) {
+            out[code_pos] = code;
+            code_pos = out_pos++;
+            code = 1;
+        } else {
+            out[out_pos++] = in[i];
+            if (++code == 0xFF) {
+                out[code_pos] = code;
+                code_pos = out_pos++;
+                code = 1;
+            }
+        }
+    }
+    out[code_pos] = code;
+    return out_pos;
+}
+
+// Returns the decoded length, or 0 if the input is not valid COBS
+size_t usb_proto_cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size)
+{
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+
+    while (in_pos < len) {
+        uint8_t code = in[in_pos++];
+        if (code == 0 || in_pos + code - 1 > len) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            if (out_pos >= out_size) {
+                return 0;
+            }
+            out[out_pos++] = in[in_pos++];
+        }
+        // A full 254-byte run has no implied zero, nor does the last group
+        if (code != 0xFF && in_pos < len) {
+            if (out_pos >= out_size) {
+                return 0;
+            }
+            out[out_pos++] = 0;
+        }
+    }
+    return out_pos;
+}
+
+esp_err_t usb_proto_send(uint8_t type, uint8_t seq, const void *payload, size_t len)
+{
+    if (write_out == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len > USB_PROTO_MAX_PAYLOAD) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // The stream task sends next to the USB serial task, frames must not mix
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    tx_frame[0] = type;
+    tx_frame[1] = seq;
+    if (len > 0) {
+        memcpy(&tx_frame[2], payload, len);
+    }
+    uint32_t crc = esp_rom_crc32_le(0, tx_frame, len + 2);
+    memcpy(&tx_frame[len + 2], &crc, sizeof(crc));
+
+    tx_encoded[0] = 0;
+    size_t encoded_len = usb_proto_cobs_encode(tx_frame, len + USB_PROTO_OVERHEAD, &tx_encoded[1]);
+    tx_encoded[encoded_len + 1] = 0;
+    write_out(tx_encoded, encoded_len + 2);
+    xSemaphoreGive(tx_mutex);
+    return ESP_OK;
+}
+
+static void send_status(uint8_t seq, esp_err_t err)
+{
+    int32_t status = err;
+    usb_proto_send(USB_MSG_STATUS | USB_PROTO_REPLY, seq, &status, sizeof(status));
+}
+
+static void send_calibration(uint8_t seq)
+{
+    usb_proto_calibration_t cal = {
+        .calibrated = throttle_is_calibrated(),
+    };
+    uint32_t min_val = 0, max_val = 0;
+    throttle_get_calibration_values(&min_val, &max_val);
+    cal.min = min_val;
+    cal.max = max_val;
+    usb_proto_send(USB_MSG_GET_CALIBRATION | USB_PROTO_REPLY, seq, &cal, sizeof(cal));
+}
+
+static bool handle_set_settings(uint8_t seq, const uint8_t *payload, size_t len)
+{
+    if (len != sizeof(settings_t)) {
+        send_status(seq, ESP_ERR_INVALID_SIZE);
+        return false;
+    }
+
+    settings_t current;
+    settings_get(&current);
+    settings_t settings;
+    memcpy(&settings, payload, sizeof(settings));
+
+    // Calibration only changes through CALIBRATE, it has to match the hardware
+    settings.throttle_calibrated = current.throttle_calibrated;
+    settings.throttle_min = current.throttle_min;
+    settings.throttle_max = current.throttle_max;
+    settings.brake_min = current.brake_min;
+    settings.brake_max = current.brake_max;
+
+    esp_err_t err = settings_save(&settings);
+    if (err == ESP_OK) {
+        vesc_config_t config;
+        vesc_config_load(&config);
+        kinematics_apply_config(&config);
+        range_set_pack(settings.pack_cells_series, settings.pack_capacity_mah);
+        ui_update_speed_unit(config.speed_unit_mph);
+        ui_force_config_reload();
+    }
+    send_status(seq, err);
+    return err == ESP_OK;
+}
+
+static void handle_get_stats(uint8_t seq)
+{
+    ride_stats_t stats;
+    ride_stats_get(&stats);
+
+    usb_proto_stats_t out = {
+        .trip_mm = odometer_get_trip_mm(),
+        .total_mm = odometer_get_total_mm(),
+        .ride_time_ms = stats.totals.ride_time_ms,
+        .moving_time_ms = stats.totals.moving_time_ms,
+        .max_speed_mm_s = stats.totals.max_speed_mm_s,
+        .avg_speed_mm_s = stats.avg_speed_mm_s,
+        .energy_drawn_mwh = stats.totals.energy_drawn_mwh,
+        .energy_regen_mwh = stats.totals.energy_regen_mwh,
+        .wh_per_km_x10 = stats.wh_per_km_x10,
+        .peak_temp_mos_c100 = stats.totals.peak_temp_mos_c100,
+        .peak_temp_motor_c100 = stats.totals.peak_temp_motor_c100,
+    };
+    usb_proto_send(USB_MSG_GET_STATS | USB_PROTO_REPLY, seq, &out, sizeof(out));
+}
+
+static void handle_get_telemetry(uint8_t seq)
+{
+    telemetry_snapshot_t snapshot;
+    telemetry_get_latest(&snapshot);
+
+    usb_proto_telemetry_t out = {
+        .rx_time_us = snapshot.rx_time_us,
+        .frame_seq = snapshot.frame_seq,
+        .erpm = snapshot.erpm,
+        .temp_mos_c100 = snapshot.temp_mos_c100,
+        .temp_motor_c100 = snapshot.temp_motor_c100,
+        .current_motor_c100 = snapshot.current_motor_c100,
+        .current_in_c100 = snapshot.current_in_c100,
+        .voltage_c100 = snapshot.voltage_c100,
+        .bms_voltage_c100 = snapshot.bms_voltage_c100,
+        .bms_current_c100 = snapshot.bms_current_c100,
+        .bms_remaining_c100 = snapshot.bms_remaining_c100,
+        .bms_nominal_c100 = snapshot.bms_nominal_c100,
+        .bms_num_cells = snapshot.bms_num_cells,
+        .throttle_raw = throttle_get_latest_raw(),
+        .throttle_mapped = throttle_get_latest_mapped(),
+        .throttle_sent = get_last_throttle_sent(),
+        .rssi = (int8_t)get_latest_rssi(),
+    };
+    memcpy(out.cell_mv, snapshot.cell_mv, sizeof(out.cell_mv));
+    usb_proto_send(USB_MSG_GET_TELEMETRY | USB_PROTO_REPLY, seq, &out, sizeof(out));
+}
+
+static void handle_get_system(uint8_t seq)
+{
+    usb_proto_system_t out = {
+        .uptime_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .free_heap = esp_get_free_heap_size(),
+        .min_free_heap = esp_get_minimum_free_heap_size(),
+        .free_internal = heap_caps_get_free_size(MALLOC_CAP_INTERNAL),
+        .frames_decoded = telemetry_get_frame_count(),
+        .frames_rejected = get_rejected_frame_count(),
+        .connects = get_connect_count(),
+    };
+    usb_proto_send(USB_MSG_GET_SYSTEM | USB_PROTO_REPLY, seq, &out, sizeof(out));
+}
+
+// Wraps the text export stream (preamble, blocks, trailer) in LOG_DATA frames
+static void export_write(const void *data, size_t len)
+{
+    static uint8_t chunk[USB_PROTO_MAX_PAYLOAD];
+    const uint8_t *p = data;
+    const size_t max_data = USB_PROTO_MAX_PAYLOAD - sizeof(uint32_t);
+
+    while (len > 0) {
+        size_t n = len < max_data ? len : max_data;
+        memcpy(chunk, &export_offset, sizeof(uint32_t));
+        memcpy(&chunk[sizeof(uint32_t)], p, n);
+        usb_proto_send(USB_MSG_LOG_DATA | USB_PROTO_REPLY, export_seq, chunk, n + sizeof(uint32_t));
+        export_offset += n;
+        p += n;
+        len -= n;
+    }
+}
+
+static void handle_log_export(uint8_t seq)
+{
+    export_seq = seq;
+    export_offset = 0;
+
+    // Keep log output from landing between the data frames
+    esp_log_level_set("*", ESP_LOG_NONE);
+    esp_err_t err = ride_recorder_export(export_write);
+    esp_log_level_set("*", CONFIG_LOG_DEFAULT_LEVEL);
+
+    send_status(seq, err);
+}
+
+static void handle_bulk_read(uint8_t seq, const uint8_t *payload, size_t len)
+{
+    static uint8_t chunk[USB_PROTO_MAX_PAYLOAD];
+    uint32_t total;
+    if (len != sizeof(total)) {
+        send_status(seq, ESP_ERR_INVALID_SIZE);
+        return;
+    }
+    memcpy(&total, payload, sizeof(total));
+
+    // Non-zero pattern, so the COBS overhead matches real data
+    for (size_t i = 0; i < sizeof(chunk); i++) {
+        chunk[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    esp_log_level_set("*", ESP_LOG_NONE);
+    while (total > 0) {
+        size_t n = total < sizeof(chunk) ? total : sizeof(chunk);
+        usb_proto_send(USB_MSG_BULK_DATA | USB_PROTO_REPLY, seq, chunk, n);
+        total -= n;
+    }
+    esp_log_level_set("*", CONFIG_LOG_DEFAULT_LEVEL);
+
+    send_status(seq, ESP_OK);
+}
+
+bool usb_proto_handle_frame(const uint8_t *encoded, size_t len)
+{
+    if (len == 0) {
+        return false;   // Back-to-back delimiters, used by hosts to resync
+    }
+
+    size_t frame_len = usb_proto_cobs_decode(encoded, len, rx_frame, sizeof(rx_frame));
+    if (frame_len < USB_PROTO_OVERHEAD) {
+        ESP_LOGD(TAG, "Dropped malformed frame (%u bytes)", (unsigned)len);
+        return false;
+    }
+
+    uint32_t crc;
+    memcpy(&crc, &rx_frame[frame_len - sizeof(crc)], sizeof(crc));
+    if (crc != esp_rom_crc32_le(0, rx_frame, frame_len - sizeof(crc))) {
+        ESP_LOGD(TAG, "Dropped frame with bad CRC");
+        return false;
+    }
+
+    uint8_t type = rx_frame[0];
+    uint8_t seq = rx_frame[1];
+    const uint8_t *payload = &rx_frame[2];
+    size_t payload_len = frame_len - USB_PROTO_OVERHEAD;
+    bool changed = false;
+
+    switch (type) {
+        case USB_MSG_PING: {
+            uint8_t reply[1 + sizeof(APP_VERSION_STRING)];
+            reply[0] = USB_PROTO_VERSION;
+            memcpy(&reply[1], APP_VERSION_STRING, sizeof(APP_VERSION_STRING));
+            usb_proto_send(USB_MSG_PING | USB_PROTO_REPLY, seq, reply, sizeof(reply));
+            break;
+        }
+        case USB_MSG_GET_SETTINGS: {
+            settings_t settings;
+            settings_get(&settings);
+            usb_proto_send(USB_MSG_GET_SETTINGS | USB_PROTO_REPLY, seq, &settings, sizeof(settings));
+            break;
+        }
+        case USB_MSG_SET_SETTINGS:
+            changed = handle_set_settings(seq, payload, payload_len);
+            break;
+        case USB_MSG_CALIBRATE:
+            throttle_calibrate(false);
+            send_calibration(seq);
+            break;
+        case USB_MSG_GET_CALIBRATION:
+            send_calibration(seq);
+            break;
+        case USB_MSG_GET_STATS:
+            handle_get_stats(seq);
+            break;
+        case USB_MSG_LOG_EXPORT:
+            handle_log_export(seq);
+            break;
+        case USB_MSG_GET_TELEMETRY:
+            handle_get_telemetry(seq);
+            break;
+        case USB_MSG_GET_SYSTEM:
+            handle_get_system(seq);
+            break;
+        case USB_MSG_ECHO:
+            usb_proto_send(USB_MSG_ECHO | USB_PROTO_REPLY, seq, payload, payload_len);
+            break;
+        case USB_MSG_DISCARD:
+            send_status(seq, ESP_OK);
+            break;
+        case USB_MSG_BULK_READ:
+            handle_bulk_read(seq, payload, payload_len);
+            break;
+        case USB_MSG_STREAM: {
+            uint16_t rate = 0;
+            if (payload_len != sizeof(rate)) {
+                send_status(seq, ESP_ERR_INVALID_SIZE);
+                break;
+            }
+            memcpy(&rate, payload, sizeof(rate));
+            if (rate == 0) {
+                stream_stop();
+                send_status(seq, ESP_OK);
+            } else {
+                send_status(seq, stream_start(rate));
+            }
+            break;
+        }
+        default:
+            send_status(seq, ESP_ERR_NOT_SUPPORTED);
+            break;
+    }
+    return changed;
+}
+
+void usb_proto_init(usb_proto_write_fn_t write_fn)
+{
+    tx_mutex = xSemaphoreCreateMutex();
+    write_out = write_fn;
+}
@@ -0,0 +1,117 @@
+#ifndef USB_PROTO_H
+#define USB_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "telemetry.h"
+
+// Binary protocol on the USB serial link, next to the text console.
+//
+// A frame on the wire is 0x00, the COBS encoding of
+//     type (u8) | seq (u8) | payload | crc32 (u32 LE over type..payload)
+// and a closing 0x00. The console never sees a 0x00 byte from a terminal,
+// so a zero switches the reader to frame mode until the next zero and the
+// two can share the port. Frames that fail COBS or the CRC are dropped.
+//
+// Replies carry the request type with USB_PROTO_REPLY set and the request
+// seq. All multi-byte fields are little endian. See tools/usbproto.py for
+// the host side. Frames may be sent from several tasks, usb_proto_send()
+// serialises them.
+
+#define USB_PROTO_VERSION       1
+#define USB_PROTO_MAX_PAYLOAD   512
+#define USB_PROTO_OVERHEAD      6       // type, seq, crc32
+#define USB_PROTO_MAX_FRAME     (USB_PROTO_MAX_PAYLOAD + USB_PROTO_OVERHEAD)
+// COBS adds one byte per 254 plus one, and the two delimiters
+#define USB_PROTO_MAX_ENCODED   (USB_PROTO_MAX_FRAME + USB_PROTO_MAX_FRAME / 254 + 3)
+
+#define USB_PROTO_REPLY         0x80
+
+typedef enum {
+    USB_MSG_PING = 0x01,            // -> version (u8), firmware version string
+    USB_MSG_GET_SETTINGS = 0x02,    // -> settings_t
+    USB_MSG_SET_SETTINGS = 0x03,    // settings_t -> status; calibration fields are kept
+    USB_MSG_CALIBRATE = 0x04,       // -> usb_proto_calibration_t once finished
+    USB_MSG_GET_CALIBRATION = 0x05, // -> usb_proto_calibration_t
+    USB_MSG_GET_STATS = 0x06,       // -> usb_proto_stats_t
+    USB_MSG_LOG_EXPORT = 0x07,      // -> LOG_DATA frames, then status
+    USB_MSG_LOG_DATA = 0x08,        // Device only: offset (u32), export stream bytes
+    USB_MSG_GET_TELEMETRY = 0x09,   // -> usb_proto_telemetry_t
+    USB_MSG_ECHO = 0x0A,            // payload -> same payload
+    USB_MSG_DISCARD = 0x0B,         // payload -> status, for upload throughput
+    USB_MSG_BULK_READ = 0x0C,       // total (u32) -> BULK_DATA frames, then status
+    USB_MSG_BULK_DATA = 0x0D,       // Device only
+    USB_MSG_STREAM = 0x0E,          // rate_hz (u16), 0 stops -> status
+    USB_MSG_STREAM_DATA = 0x0F,     // Device only, seq counts frames; format in stream.h
+    USB_MSG_GET_SYSTEM = 0x10,      // -> usb_proto_system_t
+    USB_MSG_STATUS = 0x7F,          // Device only: esp_err_t (i32)
+} usb_proto_msg_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t calibrated;
+    uint32_t min;
+    uint32_t max;
+} usb_proto_calibration_t;
+
+typedef struct __attribute__((packed)) {
+    uint64_t trip_mm;
+    uint64_t total_mm;
+    uint32_t ride_time_ms;
+    uint32_t moving_time_ms;
+    uint32_t max_speed_mm_s;
+    uint32_t avg_speed_mm_s;
+    uint32_t energy_drawn_mwh;
+    uint32_t energy_regen_mwh;
+    int32_t wh_per_km_x10;
+    int16_t peak_temp_mos_c100;     // RIDE_STATS_NO_TEMP before the first frame
+    int16_t peak_temp_motor_c100;   // Same
+} usb_proto_stats_t;
+
+typedef struct __attribute__((packed)) {
+    int64_t rx_time_us;
+    uint32_t frame_seq;
+    int32_t erpm;
+    int16_t temp_mos_c100;
+    int16_t temp_motor_c100;
+    int16_t current_motor_c100;
+    int16_t current_in_c100;
+    int16_t voltage_c100;
+    int16_t bms_voltage_c100;
+    int16_t bms_current_c100;
+    int16_t bms_remaining_c100;
+    int16_t bms_nominal_c100;
+    uint8_t bms_num_cells;
+    int16_t cell_mv[TELEMETRY_MAX_CELLS];
+    int32_t throttle_raw;
+    uint8_t throttle_mapped;
+    uint8_t throttle_sent;
+    int8_t rssi;
+} usb_proto_telemetry_t;
+
+// Counters for soak runs, see tools/fake_thumb.py
+typedef struct __attribute__((packed)) {
+    uint32_t uptime_ms;
+    uint32_t free_heap;
+    uint32_t min_free_heap;
+    uint32_t free_internal;
+    uint32_t frames_decoded;
+    uint32_t frames_rejected;
+    uint32_t connects;
+} usb_proto_system_t;
+
+typedef void (*usb_proto_write_fn_t)(const void *data, size_t len);
+
+void usb_proto_init(usb_proto_write_fn_t write_fn);
+
+// Handles the bytes between two 0x00 delimiters, still COBS encoded.
+// Returns true if the frame changed the stored settings.
+bool usb_proto_handle_frame(const uint8_t *encoded, size_t len);
+
+esp_err_t usb_proto_send(uint8_t type, uint8_t seq, const void *payload, size_t len);
+
+size_t usb_proto_cobs_encode(const uint8_t *in, size_t len, uint8_t *out);
+size_t usb_proto_cobs_decode(const uint8_t *in, size_t len, uint8_t *out, size_t out_size);
+
+#endif // USB_PROTO_H
@@ -12,6 +12,35 @@
 #include "ui_updater.h"
 #include "throttle.h"
 #include "version.h"
+#include "odometer.h"
+#include "settings.h"
+#include "kinematics.h"
+#include "ride_stats.h"
+#include "ride_recorder.h"
+#include "range.h"
+#include "pack_monitor.h"
+#include "usb_proto.h"
+#include "stream.h"
+#include "latency_bench.h"
+#include "espnow_link.h"
+#include "ble_ota.h"
+#include "ble_bench.h"
+#include "telemetry.h"
+#include "residency.h"
+#include "lvgl_heap.h"
+#include "glass_trace.h"
+#include "link_quality.h"
+#include "deadline_monitor.h"
+#include "telemetry_schema.h"
+#include "telemetry_bench.h"
+#include "cycle_bench.h"
+#include "esp_random.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
 
 #define TAG "USB_SERIAL"
 #define MAX_COMMAND_LENGTH 256
@@ -20,27 +49,17 @@ static TaskHandle_t usb_task_handle = NULL;
 static char command_buffer[MAX_COMMAND_LENGTH];
 static int command_buffer_pos = 0;
 
-// Command strings
-static const char* CMD_STRINGS[] = {
-    "reset_odometer",
-    "set_motor_pulley",
-    "set_wheel_pulley",
-    "set_wheel_size",
-    "set_motor_poles",
-    "get_config",
-    "calibrate_throttle",
-    "get_calibration",
-    "get_firmware_version",
-    "set_speed_unit_kmh",
-    "set_speed_unit_mph",
-    "help"
-};
+// Binary frame being received, between two 0x00 delimiters
+static uint8_t frame_buffer[USB_PROTO_MAX_ENCODED];
+static size_t frame_buffer_pos = 0;
+static bool in_frame = false;
+static bool frame_overflow = false;
 
 // Configuration storage using vesc_config_t structure
 static vesc_config_t hand_controller_config;
 
 static void usb_serial_task(void *pvParameters);
-static usb_command_t parse_command(const char* input);
+static void usb_serial_write(const void *data, size_t len);
 static void handle_reset_odometer(const char* command);
 static void handle_set_motor_pulley(const char* command);
 static void handle_set_wheel_pulley(const char* command);
@@ -52,6 +71,27 @@ static void handle_get_calibration(const char* command);
 static void handle_get_firmware_version(const char* command);
 static void handle_set_speed_unit_kmh(const char* command);
 static void handle_set_speed_unit_mph(const char* command);
+static void handle_log_status(const char* command);
+static void handle_log_rate(const char* command);
+static void handle_log_export(const char* command);
+static void handle_log_erase(const char* command);
+static void handle_get_stats(const char* command);
+static void handle_set_pack_cells(const char* command);
+static void handle_set_pack_capacity(const char* command);
+static void handle_get_range(const char* command);
+static void handle_get_cells(const char* command);
+static void handle_stream(const char* command);
+static void handle_bench_latency(const char* command);
+static void handle_espnow(const char* command);
+static void handle_ota(const char* command);
+static void handle_links(const char* command);
+static void handle_residency(const char* command);
+static void handle_lvgl_heap(const char* command);
+static void handle_glass(const char* command);
+static void handle_deadline(const char* command);
+static void handle_telemetry(const char* command);
+static void handle_bench(const char* command);
+static void handle_ble_backend(const char* command);
 
 void usb_serial_init(void)
 {
@@ -69,6 +109,8 @@ void usb_serial_init(void)
 
 
     usb_serial_init_esp32s3();
+    console_parse_init();
+    usb_proto_init(usb_serial_write);
 
     // Load configuration from NVS
     esp_err_t err = vesc_config_load(&hand_controller_config);
@@ -131,45 +173,108 @@ void usb_serial_init_esp32s3(void)
     ESP_LOGI(TAG, "USB Serial JTAG initialized successfully for ESP32-S3");
 }
 
+static void usb_serial_write(const void *data, size_t len)
+{
+    // Straight to the driver, the VFS would turn '\n' bytes into CRLF
+    usb_serial_jtag_write_bytes(data, len, portMAX_DELAY);
+}
+
+static void handle_frame_byte(uint8_t ch)
+{
+    if (ch == 0x00) {
+        if (frame_buffer_pos == 0 || frame_overflow) {
+            // Opening delimiter (or a resync pair); stay in frame mode
+            frame_buffer_pos = 0;
+            frame_overflow = false;
+            return;
+        }
+        bool changed = usb_proto_handle_frame(frame_buffer, frame_buffer_pos);
+        frame_buffer_pos = 0;
+        in_frame = false;
+
+        // The binary side changed the settings behind our copy
+        if (changed) {
+            vesc_config_load(&hand_controller_config);
+        }
+        return;
+    }
+
+    if (frame_buffer_pos < sizeof(frame_buffer)) {
+        frame_buffer[frame_buffer_pos++] = ch;
+    } else {
+        frame_overflow = true;
+    }
+}
+
+static void handle_text_byte(uint8_t ch)
+{
+    ESP_LOGD(TAG, "Received character: 0x%02X (%c)", ch, (ch >= 32 && ch <= 126) ? ch : '?');
+
+    if (ch == '\r' || ch == '\n') {
+        // End of command, process it
+        if (command_buffer_pos > 0) {
+            command_buffer[command_buffer_pos] = '\0';
+            ESP_LOGI(TAG, "Processing command: %s", command_buffer);
+            usb_serial_process_command(command_buffer);
+            command_buffer_pos = 0;
+        }
+        printf("\n> ");
+        fflush(stdout);
+    } else if (ch == '\b' || ch == 127) {
+        // Backspace
+        if (command_buffer_pos > 0) {
+            command_buffer_pos--;
+            printf("\b \b");
+            fflush(stdout);
+        }
+    } else if (command_buffer_pos < MAX_COMMAND_LENGTH - 1) {
+        // Add character to buffer
+        command_buffer[command_buffer_pos++] = ch;
+    }
+}
+
 static void usb_serial_task(void *pvParameters)
 {
+    static uint8_t rx_chunk[USB_CDC_READ_CHUNK];
+
     ESP_LOGI(TAG, "USB Serial task started");
 
     for (;;) {
-        int ch = fgetc(stdin);
-
-        if (ch != EOF && ch != 0xFF) {
-            ESP_LOGD(TAG, "Received character: 0x%02X (%c)", ch, (ch >= 32 && ch <= 126) ? ch : '?');
-
-            if (ch == '\r' || ch == '\n') {
-                // End of command, process it
-                if (command_buffer_pos > 0) {
-                    command_buffer[command_buffer_pos] = '\0';
-                    ESP_LOGI(TAG, "Processing command: %s", command_buffer);
-                    usb_serial_process_command(command_buffer);
-                    command_buffer_pos = 0;
-                }
-                printf("\n> ");
-            } else if (ch == '\b' || ch == 127) {
-                // Backspace
-                if (command_buffer_pos > 0) {
-                    command_buffer_pos--;
-                    printf("\b \b");
-                }
-            } else if (command_buffer_pos < MAX_COMMAND_LENGTH - 1) {
-                // Add character to buffer
-                command_buffer[command_buffer_pos++] = ch;
+        // Blocks until data arrives, a paste or a frame comes in with one read
+        int len = usb_serial_jtag_read_bytes(rx_chunk, sizeof(rx_chunk), pdMS_TO_TICKS(USB_CDC_FRAME_TIMEOUT_MS));
+
+        if (len <= 0) {
+            if (in_frame) {
+                // Host went quiet mid-frame, give the port back to the console
+                ESP_LOGW(TAG, "Dropped incomplete binary frame (%u bytes)", (unsigned)frame_buffer_pos);
+                in_frame = false;
+                frame_buffer_pos = 0;
+                frame_overflow = false;
             }
+            continue;
         }
 
-        vTaskDelay(USB_CDC_TASK_DELAY_MS / portTICK_PERIOD_MS);
+        for (int i = 0; i < len; i++) {
+            uint8_t ch = rx_chunk[i];
+            if (in_frame) {
+                handle_frame_byte(ch);
+            } else if (ch == 0x00) {
+                // A terminal never sends NUL, it starts a binary frame
+                in_frame = true;
+                frame_buffer_pos = 0;
+                frame_overflow = false;
+                command_buffer_pos = 0;
+            } else if (ch != 0xFF) {
+                handle_text_byte(ch);
+            }
+        }
     }
 }
 
 void usb_serial_process_command(const char* command)
 {
     ESP_LOGI(TAG, "Processing command: '%s' (length: %d)", command, strlen(command));
-    usb_command_t cmd = parse_command(command);
+    usb_command_t cmd = console_parse_command(command);
     ESP_LOGI(TAG, "Parsed command type: %d", cmd);
 
     switch (cmd) {
@@ -206,6 +311,69 @@ void usb_serial_process_command(const char* command)
         case CMD_SET_SPEED_UNIT_MPH:
             handle_set_speed_unit_mph(command);
             break;
+        case CMD_LOG_STATUS:
+            handle_log_status(command);
+            break;
+        case CMD_LOG_RATE:
+            handle_log_rate(command);
+            break;
+        case CMD_LOG_EXPORT:
+            handle_log_export(command);
+            break;
+        case CMD_LOG_ERASE:
+            handle_log_erase(command);
+            break;
+        case CMD_GET_STATS:
+            handle_get_stats(command);
+            break;
+        case CMD_SET_PACK_CELLS:
+            handle_set_pack_cells(command);
+            break;
+        case CMD_SET_PACK_CAPACITY:
+            handle_set_pack_capacity(command);
+            break;
+        case CMD_GET_RANGE:
+            handle_get_range(command);
+            break;
+        case CMD_GET_CELLS:
+            handle_get_cells(command);
+            break;
+        case CMD_STREAM:
+            handle_stream(command);
+            break;
+        case CMD_BENCH_LATENCY:
+            handle_bench_latency(command);
+            break;
+        case CMD_ESPNOW:
+            handle_espnow(command);
+            break;
+        case CMD_OTA:
+            handle_ota(command);
+            break;
+        case CMD_LINKS:
+            handle_links(command);
+            break;
+        case CMD_RESIDENCY:
+            handle_residency(command);
+            break;
+        case CMD_LVGL_HEAP:
+            handle_lvgl_heap(command);
+            break;
+        case CMD_GLASS:
+            handle_glass(command);
+            break;
+        case CMD_DEADLINE:
+            handle_deadline(command);
+            break;
+        case CMD_TELEMETRY:
+            handle_telemetry(command);
+            break;
+        case CMD_BENCH:
+            handle_bench(command);
+            break;
+        case CMD_BLE_BACKEND:
+            handle_ble_backend(command);
+            break;
         case CMD_UNKNOWN:
         default:
             printf("Unknown command: %s\n", command);
@@ -214,37 +382,6 @@ void usb_serial_process_command(const char* command)
     }
 }
 
-static usb_command_t parse_command(const char* input)
-{
-    // Skip leading whitespace
-    while (*input == ' ' || *input == '\t') input++;
-
-    // Find the first word (command)
-    char command[64];
-    int i = 0;
-    while (input[i] && input[i] != ' ' && input[i] != '\t' && i < 63) {
-        command[i] = input[i];
-        i++;
-    }
-    command[i] = '\0';
-
-    // Convert to lowercase for case-insensitive comparison
-    for (int j = 0; j < i; j++) {
-        if (command[j] >= 'A' && command[j] <= 'Z') {
-            command[j] = command[j] + 32;
-        }
-    }
-
-    // Compare with known commands
-    for (int cmd = 0; cmd < sizeof(CMD_STRINGS) / sizeof(CMD_STRINGS[0]); cmd++) {
-        if (strcmp(command, CMD_STRINGS[cmd]) == 0) {
-            return (usb_command_t)cmd;
-        }
-    }
-
-    return CMD_UNKNOWN;
-}
-
 static void handle_reset_odometer(const char* command)
 {
     printf("Odometer reset command received\n");
@@ -259,10 +396,9 @@ static void handle_reset_odometer(const char* command)
 
 static void handle_set_motor_pulley(const char* command)
 {
-    const char* value_str = strchr(command, ' ');
+    const char* value_str = console_argument(command);
     if (value_str) {
-        value_str++; // Skip the space
-        int teeth = atoi(value_str);
+        int teeth = console_parse_int(value_str);
         if (teeth > 0 && teeth <= 255) {
             hand_controller_config.motor_pulley = (uint8_t)teeth;
             printf("Motor pulley teeth set to: %d\n", teeth);
@@ -287,10 +423,9 @@ static void handle_set_motor_pulley(const char* command)
 
 static void handle_set_wheel_pulley(const char* command)
 {
-    const char* value_str = strchr(command, ' ');
+    const char* value_str = console_argument(command);
     if (value_str) {
-        value_str++; // Skip the space
-        int teeth = atoi(value_str);
+        int teeth = console_parse_int(value_str);
         if (teeth > 0 && teeth <= 255) {
             hand_controller_config.wheel_pulley = (uint8_t)teeth;
             printf("Wheel pulley teeth set to: %d\n", teeth);
@@ -315,10 +450,9 @@ static void handle_set_wheel_pulley(const char* command)
 
 static void handle_set_wheel_size(const char* command)
 {
-    const char* value_str = strchr(command, ' ');
+    const char* value_str = console_argument(command);
     if (value_str) {
-        value_str++; // Skip the space
-        int size_mm = atoi(value_str);
+        int size_mm = console_parse_int(value_str);
         if (size_mm > 0 && size_mm <= 255) {
             hand_controller_config.wheel_diameter_mm = (uint8_t)size_mm;
             printf("Wheel diameter set to: %d mm\n", size_mm);
@@ -343,10 +477,9 @@ static void handle_set_wheel_size(const char* command)
 
 static void handle_set_motor_poles(const char* command)
 {
-    const char* value_str = strchr(command, ' ');
+    const char* value_str = console_argument(command);
     if (value_str) {
-        value_str++; // Skip the space
-        int poles = atoi(value_str);
+        int poles = console_parse_int(value_str);
         if (poles > 0 && poles <= 255) {
             hand_controller_config.motor_poles = (uint8_t)poles;
             printf("Motor poles set to: %d\n", poles);
@@ -386,8 +519,22 @@ static void handle_get_config(const char* command)
     printf("Wheel Pulley Teeth: %d\n", hand_controller_config.wheel_pulley);
     printf("Wheel Diameter: %d mm\n", hand_controller_config.wheel_diameter_mm);
     printf("Motor Poles: %d\n", hand_controller_config.motor_poles);
+    printf("Distance Factor: %lu nm per ERPM-second\n", kinematics_get_nm_per_erpm_s());
     printf("BLE Connected: %s\n", is_connect ? "Yes" : "No");
 
+    settings_status_t settings_status;
+    settings_get_status(&settings_status);
+    printf("Settings: seq %lu, slot %c, loaded in %lu us%s\n",
+           settings_status.seq, settings_status.slot ? settings_status.slot : '-',
+           settings_status.load_us, settings_status.migrated ? " (migrated)" : "");
+
+    odometer_status_t odo_status;
+    odometer_get_status(&odo_status);
+    printf("Trip Distance: %llu m\n", odometer_get_trip_mm() / 1000);
+    printf("Lifetime Distance: %llu m\n", odometer_get_total_mm() / 1000);
+    printf("Odometer Log: %s, seq %lu, %lu sector erases\n",
+           odo_status.flash_ok ? "OK" : "unavailable", odo_status.seq, odo_status.erase_count);
+
     // Calculate and display current speed if connected
     if (is_connect) {
         int32_t speed = vesc_config_get_speed(&hand_controller_config);
@@ -405,7 +552,7 @@ static void handle_calibrate_throttle(const char* command)
     printf("Progress: ");
 
     // Trigger the throttle calibration
-    throttle_calibrate();
+    throttle_calibrate(true);
 
     // Check if calibration was successful
     if (throttle_is_calibrated()) {
@@ -495,4 +642,827 @@ static void handle_set_speed_unit_mph(const char* command)
     ui_update_speed_unit(hand_controller_config.speed_unit_mph);
 
     ui_force_config_reload(); // Force UI to reload config
-}
\ No newline at end of file
+}
+
+static void handle_log_status(const char* command)
+{
+    ride_recorder_status_t status;
+    ride_recorder_get_status(&status);
+
+    printf("Ride log:\n");
+    printf("  Flash: %s\n", status.flash_ok ? "OK" : "unavailable");
+    printf("  Recording: %s at %lu Hz\n", status.recording ? "yes" : "no", status.rate_hz);
+    printf("  Sectors: %lu (next %lu)\n", status.sector_count, status.next_sector);
+    printf("  Last block seq: %lu, boot id: %lu\n", status.last_seq, status.boot_id);
+    printf("  Records this boot: %lu (dropped %lu)\n", status.records, status.dropped);
+    printf("  Blocks written: %lu (%lu payload bytes)\n", status.blocks_written, status.payload_bytes_written);
+    if (status.blocks_written > 0 && status.rate_hz > 0) {
+        uint32_t records_per_block = status.records / status.blocks_written;
+        uint32_t retention_s = status.sector_count * records_per_block / status.rate_hz;
+        printf("  Holds about %lu min at this rate (%lu records a block)\n", retention_s / 60, records_per_block);
+    }
+}
+
+static void handle_log_rate(const char* command)
+{
+    const char* value_str = console_argument(command);
+    if (value_str) {
+        int rate = console_parse_int(value_str);
+        if (rate >= 0 && ride_recorder_set_rate((uint32_t)rate) == ESP_OK) {
+            printf("Ride log rate set to: %d Hz\n", rate);
+        } else {
+            printf("Error: Invalid rate. Must be between 0 and %d Hz\n", RIDE_LOG_MAX_RATE_HZ);
+        }
+    } else {
+        printf("Error: No value provided\n");
+        printf("Usage: log_rate <hz>\n");
+        printf("Example: log_rate 10\n");
+    }
+}
+
+static void handle_log_export(const char* command)
+{
+    fflush(stdout);
+
+    // Keep log output from landing in the middle of the binary blocks
+    esp_log_level_set("*", ESP_LOG_NONE);
+    esp_err_t err = ride_recorder_export(usb_serial_write);
+    esp_log_level_set("*", CONFIG_LOG_DEFAULT_LEVEL);
+
+    if (err != ESP_OK) {
+        printf("Error: Ride log export failed: %s\n", esp_err_to_name(err));
+    }
+}
+
+static void handle_log_erase(const char* command)
+{
+    esp_err_t err = ride_recorder_erase();
+    if (err != ESP_OK) {
+        printf("Error: Failed to erase ride log: %s\n", esp_err_to_name(err));
+    } else {
+        printf("Ride log erased\n");
+    }
+}
+
+static void print_peak_temp(const char* name, int16_t temp_c100)
+{
+    if (temp_c100 == RIDE_STATS_NO_TEMP) {
+        printf("%s: --\n", name);
+        return;
+    }
+    int magnitude = abs(temp_c100);
+    printf("%s: %s%d.%02d C\n", name, temp_c100 < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+}
+
+static void handle_get_stats(const char* command)
+{
+    ride_stats_t stats;
+    ride_stats_get(&stats);
+    const ride_stats_persist_t *t = &stats.totals;
+
+    printf("\n=== Ride Statistics ===\n");
+    printf("Trip Distance: %llu m\n", odometer_get_trip_mm() / 1000);
+    printf("Ride Time: %lu s\n", t->ride_time_ms / 1000);
+    printf("Moving Time: %lu s\n", t->moving_time_ms / 1000);
+    printf("Max Speed: %lu.%02lu km/h\n", t->max_speed_mm_s * 36 / 10000, (t->max_speed_mm_s * 36 / 100) % 100);
+    printf("Avg Speed: %lu.%02lu km/h\n", stats.avg_speed_mm_s * 36 / 10000, (stats.avg_speed_mm_s * 36 / 100) % 100);
+    printf("Energy Drawn: %lu mWh\n", t->energy_drawn_mwh);
+    printf("Energy Regenerated: %lu mWh\n", t->energy_regen_mwh);
+    printf("Consumption: %s%ld.%ld Wh/km\n", stats.wh_per_km_x10 < 0 ? "-" : "",
+           labs(stats.wh_per_km_x10) / 10, labs(stats.wh_per_km_x10) % 10);
+    print_peak_temp("Peak FET Temp", t->peak_temp_mos_c100);
+    print_peak_temp("Peak Motor Temp", t->peak_temp_motor_c100);
+    printf("\n");
+}
+
+static void save_pack(uint8_t cells_series, uint16_t capacity_mah)
+{
+    settings_t settings;
+    settings_get(&settings);
+    settings.pack_cells_series = cells_series;
+    settings.pack_capacity_mah = capacity_mah;
+
+    esp_err_t err = settings_save(&settings);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save pack setting: %s", esp_err_to_name(err));
+        printf("Warning: Failed to save setting to memory\n");
+    }
+    range_set_pack(cells_series, capacity_mah);
+}
+
+static void handle_set_pack_cells(const char* command)
+{
+    const char* value_str = console_argument(command);
+    if (value_str) {
+        int cells = console_parse_int(value_str);
+        if (cells > 0 && cells <= 30) {
+            settings_t settings;
+            settings_get(&settings);
+            save_pack((uint8_t)cells, settings.pack_capacity_mah);
+            printf("Pack cells in series set to: %d\n", cells);
+        } else {
+            printf("Error: Invalid cell count. Must be between 1 and 30\n");
+        }
+    } else {
+        printf("Error: No value provided\n");
+        printf("Usage: set_pack_cells <cells>\n");
+        printf("Example: set_pack_cells 10\n");
+    }
+}
+
+static void handle_set_pack_capacity(const char* command)
+{
+    const char* value_str = console_argument(command);
+    if (value_str) {
+        int capacity = console_parse_int(value_str);
+        if (capacity > 0 && capacity <= 65535) {
+            settings_t settings;
+            settings_get(&settings);
+            save_pack(settings.pack_cells_series, (uint16_t)capacity);
+            printf("Pack capacity set to: %d mAh\n", capacity);
+        } else {
+            printf("Error: Invalid capacity. Must be between 1 and 65535 mAh\n");
+        }
+    } else {
+        printf("Error: No value provided\n");
+        printf("Usage: set_pack_capacity <mAh>\n");
+        printf("Example: set_pack_capacity 6000\n");
+    }
+}
+
+static void handle_get_range(const char* command)
+{
+    range_estimate_t estimate;
+    range_get_estimate(&estimate);
+    settings_t settings;
+    settings_get(&settings);
+
+    printf("\n=== Range Estimate ===\n");
+    printf("Pack: %uS %u mAh\n", settings.pack_cells_series, settings.pack_capacity_mah);
+    printf("Energy Source: %s\n", range_source_name(estimate.source));
+    printf("State of Charge: %u%%\n", estimate.soc_pct);
+    printf("Remaining Energy: %lu.%lu Wh\n", estimate.remaining_wh_x10 / 10, estimate.remaining_wh_x10 % 10);
+    printf("Consumption: %ld.%ld Wh/km (%lu windows of %d m)\n", estimate.wh_per_km_x10 / 10,
+           estimate.wh_per_km_x10 % 10, estimate.windows, RANGE_WINDOW_M);
+    printf("Range: %lu.%02lu km (%lu.%02lu - %lu.%02lu km)\n",
+           estimate.range_m / 1000, (estimate.range_m % 1000) / 10,
+           estimate.range_low_m / 1000, (estimate.range_low_m % 1000) / 10,
+           estimate.range_high_m / 1000, (estimate.range_high_m % 1000) / 10);
+    printf("\n");
+}
+
+static void handle_get_cells(const char* command)
+{
+    pack_status_t status;
+    pack_monitor_get_status(&status);
+
+    printf("\n=== Pack Health ===\n");
+    if (status.num_cells == 0) {
+        printf("No cell voltages reported by the BMS\n");
+    } else {
+        printf("Cells: %u\n", status.num_cells);
+        printf("Min Cell: %d mV (cell %u)\n", status.min_mv, status.min_cell + 1);
+        printf("Max Cell: %d mV (cell %u)\n", status.max_mv, status.max_cell + 1);
+        printf("Delta: %d mV\n", status.delta_mv);
+        printf("\nCell    Now    Min    Max   Rest   Load    Sag\n");
+        for (int i = 0; i < status.num_cells; i++) {
+            const pack_cell_stats_t *cell = &status.cells[i];
+            // Sag needs both a rest and a load reading
+            int sag = cell->rest_mv > 0 && cell->load_mv > 0 ? cell->rest_mv - cell->load_mv : 0;
+            printf("%4d %6d %6d %6d %6d %6d %6d\n", i + 1, cell->mv, cell->min_mv, cell->max_mv,
+                   cell->rest_mv, cell->load_mv, sag);
+        }
+    }
+
+    printf("\nActive Alerts:");
+    if (status.alerts == 0) {
+        printf(" none");
+    }
+    for (int i = 0; i < PACK_ALERT_COUNT; i++) {
+        if (status.alerts & (1UL << i)) {
+            printf(" [%s]", pack_alert_name((pack_alert_t)i));
+        }
+    }
+    printf("\n\n");
+}
+
+static void handle_stream(const char* command)
+{
+    const char* value_str = console_argument(command);
+    if (value_str) {
+        int rate = console_parse_int(value_str);
+        if (rate == 0) {
+            stream_stop();
+            printf("Stream stopped\n");
+        } else if (rate > 0 && stream_start((uint32_t)rate) == ESP_OK) {
+            printf("Streaming at %d Hz as binary frames, 'stream 0' stops\n", rate);
+        } else {
+            printf("Error: Invalid rate. Must be between 1 and %d Hz\n", STREAM_MAX_RATE_HZ);
+        }
+        fflush(stdout);
+        return;
+    }
+
+    stream_status_t status;
+    stream_get_status(&status);
+    printf("Stream: %s", status.active ? "active" : "stopped");
+    if (status.active) {
+        printf(" at %lu Hz", status.rate_hz);
+    }
+    printf("\n");
+    printf("  Records sent: %lu in %lu frames\n", status.records_sent, status.frames_sent);
+    printf("  Dropped: %lu\n", status.dropped);
+    printf("Usage: stream <hz> to start, stream 0 to stop\n");
+}
+
+static void handle_bench_latency(const char* command)
+{
+    int steps = LATENCY_BENCH_DEFAULT_STEPS;
+    int period_ms = LATENCY_BENCH_DEFAULT_PERIOD_MS;
+    const char* value_str = console_argument(command);
+    if (value_str) {
+        steps = console_parse_int(value_str);
+        const char* period_str = console_argument(value_str);
+        if (period_str) {
+            period_ms = console_parse_int(period_str);
+        }
+    }
+
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    if (steps > 0 && period_ms > 0) {
+        err = latency_bench_start((uint32_t)steps, (uint32_t)period_ms);
+    }
+    if (err == ESP_ERR_INVALID_STATE) {
+        printf("Error: Needs a calibrated throttle and no receiver connected (BLE or ESP-NOW)\n");
+        return;
+    }
+    if (err != ESP_OK) {
+        printf("Error: Needs 1-%d steps and a %d-%d ms period\n",
+               LATENCY_BENCH_MAX_STEPS, LATENCY_BENCH_MIN_PERIOD_MS, LATENCY_BENCH_MAX_PERIOD_MS);
+        printf("Usage: bench_latency [steps] [period_ms]\n");
+        printf("Example: bench_latency 100 250\n");
+        return;
+    }
+
+    printf("Stepping the virtual throttle %d times, every %d ms at a random phase...\n", steps, period_ms);
+    fflush(stdout);
+    // Steps are at most one and a half periods apart, plus a margin
+    uint32_t timeout_ms = (uint32_t)(steps + 2) * (uint32_t)period_ms * 3 / 2 + 1000;
+    for (uint32_t waited = 0; latency_bench_is_active() && waited < timeout_ms; waited += 100) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
+    latency_bench_stop();
+
+    latency_bench_result_t result;
+    latency_bench_get_result(&result);
+    printf("\n=== Input-to-write latency (%s) ===\n", TARGET_NAME);
+    printf("Steps: %lu measured, %lu missed of %lu, period %lu ms\n",
+           result.measured, result.missed, result.steps, result.period_ms);
+    if (result.aborted) {
+        printf("Aborted: a receiver connected during the run\n");
+    }
+    if (result.measured == 0) {
+        printf("No step reached a write\n\n");
+        return;
+    }
+    printf("Min: %lu.%01lu ms  P50: %lu.%01lu ms  P99: %lu.%01lu ms  Max: %lu.%01lu ms\n",
+           result.min_us / 1000, (result.min_us % 1000) / 100,
+           result.p50_us / 1000, (result.p50_us % 1000) / 100,
+           result.p99_us / 1000, (result.p99_us % 1000) / 100,
+           result.max_us / 1000, (result.max_us % 1000) / 100);
+    for (int i = 0; i < LATENCY_BENCH_BUCKETS; i++) {
+        if (i < LATENCY_BENCH_BUCKETS - 1) {
+            printf("  %3d-%3d ms %4lu ", i * LATENCY_BENCH_BUCKET_MS, (i + 1) * LATENCY_BENCH_BUCKET_MS,
+                   result.histogram[i]);
+        } else {
+            printf("  %3d+    ms %4lu ", i * LATENCY_BENCH_BUCKET_MS, result.histogram[i]);
+        }
+        uint32_t bar = result.histogram[i] * 40 / result.measured;
+        for (uint32_t j = 0; j < bar; j++) {
+            printf("#");
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+static void print_espnow_status(void)
+{
+    espnow_link_status_t status;
+    espnow_link_get_status(&status);
+
+    printf("\n=== ESP-NOW link ===\n");
+    printf("State: %s, %s, %s\n", status.enabled ? "enabled" : "disabled",
+           status.paired ? "paired" : "not paired",
+           status.active ? "carrying the throttle" : "throttle over BLE");
+    printf("Own MAC: " MACSTR "\n", MAC2STR(status.own_mac));
+    if (status.paired) {
+        printf("Peer MAC: " MACSTR ", channel %u\n", MAC2STR(status.peer_mac), status.channel);
+    }
+    if (status.last_rx_age_ms != UINT32_MAX) {
+        printf("Last packet: %lu ms ago, RSSI %d dBm\n", status.last_rx_age_ms, status.rx_rssi);
+    }
+    printf("TX: %lu packets, %lu failed\n", status.tx_packets, status.tx_failed);
+    uint32_t expected = status.rx.received + status.rx.lost;
+    printf("RX: %lu packets, %lu lost (%lu.%02lu%%), %lu late, %lu rejected, %lu resyncs\n",
+           status.rx.received, status.rx.lost,
+           expected ? status.rx.lost * 100 / expected : 0,
+           expected ? (status.rx.lost * 10000 / expected) % 100 : 0,
+           status.rx.late, status.rx_rejected, status.rx.resyncs);
+    printf("Telemetry queue: %lu handled, %lu dropped, %lu deep at most, hand-off avg %lu us max %lu us, "
+           "decode max %lu us\n",
+           status.rx_queue.handled, status.rx_queue.dropped, status.rx_queue.max_waiting,
+           status.rx_queue.handoff_avg_us, status.rx_queue.handoff_max_us, status.rx_queue.handler_max_us);
+    printf("Switches: %lu to ESP-NOW, %lu back to BLE\n", status.switched_to_espnow, status.fell_back_to_ble);
+    if (status.rtt_count > 0) {
+        printf("Round trip (last %lu pings): min %lu us, p50 %lu us, p99 %lu us, max %lu us\n",
+               status.rtt_count, status.rtt_min_us, status.rtt_p50_us, status.rtt_p99_us, status.rtt_max_us);
+    }
+    printf("\n");
+}
+
+static void handle_espnow(const char* command)
+{
+    const char* arg = console_argument(command);
+    if (arg == NULL) {
+        print_espnow_status();
+        printf("Usage: espnow [on|off|reset|unpair|bench [pings]|pair ble|pair <mac> [key]]\n");
+        return;
+    }
+
+    if (console_argument_is(arg, "on") || console_argument_is(arg, "off")) {
+        bool enable = console_argument_is(arg, "on");
+        if (espnow_link_set_enabled(enable) != ESP_OK) {
+            printf("Error: Could not %s ESP-NOW\n", enable ? "start" : "stop");
+            return;
+        }
+        espnow_link_status_t status;
+        espnow_link_get_status(&status);
+        printf("ESP-NOW %s%s\n", enable ? "enabled" : "disabled",
+               enable && !status.paired ? ", pair to start it" : "");
+    } else if (console_argument_is(arg, "reset")) {
+        espnow_link_reset_stats();
+        printf("ESP-NOW counters cleared\n");
+    } else if (console_argument_is(arg, "unpair")) {
+        printf(espnow_link_unpair() == ESP_OK ? "ESP-NOW peer removed\n" : "Error: Could not save settings\n");
+    } else if (console_argument_is(arg, "bench")) {
+        int pings = 200;
+        const char* value_str = console_argument(arg);
+        if (value_str) {
+            pings = console_parse_int(value_str);
+        }
+        if (pings <= 0 || espnow_link_bench_start((uint32_t)pings) != ESP_OK) {
+            printf("Error: Needs a running link and 1-%d pings\n", ESPNOW_LINK_BENCH_MAX);
+            return;
+        }
+        printf("Pinging the peer %d times, every %d ms...\n", pings, ESPNOW_LINK_BENCH_PERIOD_MS);
+        fflush(stdout);
+        uint32_t timeout_ms = (uint32_t)pings * ESPNOW_LINK_BENCH_PERIOD_MS + 1000;
+        for (uint32_t waited = 0; espnow_link_bench_is_active() && waited < timeout_ms; waited += 100) {
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+        vTaskDelay(pdMS_TO_TICKS(ESPNOW_LINK_TIMEOUT_MS));   // Let the last pongs in
+        print_espnow_status();
+    } else if (console_argument_is(arg, "pair")) {
+        const char* target = console_argument(arg);
+        if (target && console_argument_is(target, "ble")) {
+            // The offer carries the key, so the link is encrypted first
+            if (ble_transport_request_encryption(BLE_LINK_PRIMARY) != ESP_OK) {
+                printf("Error: Needs a BLE connection to the receiver\n");
+                return;
+            }
+            for (uint32_t waited = 0; !ble_transport_encrypted(BLE_LINK_PRIMARY) && waited < 5000; waited += 100) {
+                vTaskDelay(pdMS_TO_TICKS(100));
+            }
+            if (ble_start_espnow_pairing() != ESP_OK) {
+                printf("Error: The receiver did not encrypt the link, pair with espnow pair <mac> instead\n");
+                return;
+            }
+            printf("Key offered over BLE, waiting for the receiver...\n");
+            fflush(stdout);
+            for (uint32_t waited = 0; ble_espnow_pairing_pending() && waited < 5000; waited += 100) {
+                vTaskDelay(pdMS_TO_TICKS(100));
+            }
+            print_espnow_status();
+            return;
+        }
+
+        uint8_t mac[ESPNOW_MAC_LEN];
+        uint8_t key[ESPNOW_KEY_LEN];
+        if (target == NULL || !console_parse_hex_bytes(target, mac, sizeof(mac), ':')) {
+            printf("Usage: espnow pair ble, or espnow pair <aa:bb:cc:dd:ee:ff> [32 hex digit key]\n");
+            return;
+        }
+        const char* key_str = console_argument(target);
+        bool generated = key_str == NULL;
+        if (generated) {
+            esp_fill_random(key, sizeof(key));
+        } else if (!console_parse_hex_bytes(key_str, key, sizeof(key), '\0')) {
+            printf("Error: The key is 32 hex digits\n");
+            return;
+        }
+        esp_err_t err = espnow_link_pair(mac, key, espnow_link_channel());
+        if (err == ESP_OK && generated) {
+            // The receiver needs the same key for its peer entry
+            printf("Key: ");
+            for (int i = 0; i < ESPNOW_KEY_LEN; i++) {
+                printf("%02x", key[i]);
+            }
+            printf("\n");
+        }
+        memset(key, 0, sizeof(key));
+        if (err != ESP_OK) {
+            printf("Error: Could not pair (%s)\n", esp_err_to_name(err));
+            return;
+        }
+        print_espnow_status();
+    } else {
+        printf("Unknown espnow option, type 'espnow' for usage\n");
+    }
+}
+
+static void handle_ota(const char* command)
+{
+    static const char* state_names[] = {"idle", "receiving", "verifying", "done, restarting", "failed"};
+    ble_ota_status_t status;
+    ble_ota_get_status(&status);
+
+    printf("\n=== BLE firmware update ===\n");
+    printf("Running: %s%s\n", status.running_partition, status.pending_verify ? " (pending verification)" : "");
+    printf("State: %s\n", state_names[status.state]);
+    if (status.image_size == 0) {
+        printf("\n");
+        return;
+    }
+    printf("Image: %lu of %lu bytes received, %lu on flash, %lu NAKs\n",
+           status.received, status.image_size, status.written, status.naks);
+    if (status.state == BLE_OTA_STATE_RECEIVING && status.elapsed_ms > 0) {
+        printf("Rate so far: %lu B/s\n", (uint32_t)((uint64_t)status.received * 1000 / status.elapsed_ms));
+    } else if (status.state == BLE_OTA_STATE_FAILED) {
+        printf("Result: %s\n", ble_ota_result_name(status.result));
+    }
+    if (status.bytes_per_s > 0) {
+        printf("Last transfer: %lu ms, %lu B/s sustained\n", status.elapsed_ms, status.bytes_per_s);
+    }
+    printf("\n");
+}
+
+static void handle_links(const char* command)
+{
+    printf("\n=== BLE links (%s) ===\n", ble_transport_name());
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        ble_link_stats_t stats;
+        ble_get_link_stats((ble_link_t)i, &stats);
+        if (!stats.connected) {
+            printf("%-9s  down, %lu connects\n", ble_link_name((ble_link_t)i), stats.connects);
+            continue;
+        }
+        printf("%-9s  up, interval %u.%02u ms, RSSI %d dBm, TX %d dBm, %lu connects\n",
+               ble_link_name((ble_link_t)i), stats.conn_interval * 125 / 100, stats.conn_interval * 125 % 100,
+               stats.rssi, link_quality_tx_power_dbm((ble_link_t)i), stats.connects);
+        printf("           rx %lu frames/s, %lu B/s (%lu frames, %lu rejected), last %lu ms ago\n",
+               stats.rx_frames_per_s, stats.rx_bytes_per_s, stats.rx_frames, stats.rx_rejected,
+               stats.last_rx_age_ms);
+        if (stats.tx_writes > 0 || stats.tx_failed > 0) {
+            printf("           tx %lu B/s (%lu writes, %lu failed)\n",
+                   stats.tx_bytes_per_s, stats.tx_writes, stats.tx_failed);
+        }
+
+        link_quality_stats_t quality;
+        link_quality_get_stats((ble_link_t)i, &quality);
+        printf("           quality %u (%s), RSSI avg %d dBm, period %lu.%lu ms\n",
+               quality.score, link_quality_state_name(quality.state), quality.rssi,
+               quality.period_us / 1000, (quality.period_us % 1000) / 100);
+        printf("           lost %u.%u%% (%lu of %lu), failed writes %u.%u%% (%lu of %lu)\n",
+               quality.loss_pct_x10 / 10, quality.loss_pct_x10 % 10, quality.lost, quality.notifies + quality.lost,
+               quality.fail_pct_x10 / 10, quality.fail_pct_x10 % 10, quality.failed, quality.writes);
+    }
+
+    telemetry_snapshot_t snapshot;
+    telemetry_get_latest(&snapshot);
+    if (snapshot.rx_time_us != 0) {
+        int64_t now = esp_timer_get_time();
+        printf("Telemetry merged from:");
+        for (int i = 0; i < TELEMETRY_SOURCE_COUNT; i++) {
+            if (snapshot.source_time_us[i] != 0) {
+                printf(" %s (%lld ms)", ble_link_name((ble_link_t)i), (now - snapshot.source_time_us[i]) / 1000);
+            }
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+static void handle_residency(const char* command)
+{
+    const char* arg = console_argument(command);
+    residency_status_t status;
+    residency_get_status(&status);
+
+    printf("\n=== Asset residency ===\n");
+    printf("Internal: %u / %u bytes, PSRAM: %u / %u bytes, copied in %lu us\n",
+           status.internal_used, RESIDENCY_INTERNAL_BUDGET, status.psram_used, RESIDENCY_PSRAM_BUDGET,
+           status.copy_us);
+    residency_entry_status_t entry;
+    for (size_t i = 0; residency_get_entry(i, &entry); i++) {
+        printf("  %-18s %6u bytes  %-8s (wanted %s)\n", entry.name, entry.bytes,
+               residency_tier_name(entry.placed), residency_tier_name(entry.wanted));
+    }
+
+    if (!arg) {
+        printf("Usage: residency bench to compare flash, internal and PSRAM reads\n\n");
+        return;
+    }
+    if (!console_argument_is(arg, "bench")) {
+        printf("Error: Unknown argument\n");
+        printf("Usage: residency [bench]\n");
+        return;
+    }
+
+    static residency_bench_result_t results[RESIDENCY_BENCH_MAX_RESULTS];
+    size_t count = 0;
+    printf("Measuring %d cold and warm runs each...\n", RESIDENCY_BENCH_RUNS);
+    fflush(stdout);
+    esp_err_t ret = residency_bench(objects.speedlabel, results, RESIDENCY_BENCH_MAX_RESULTS, &count);
+
+    // Stall cycles retire no instruction, on flash and PSRAM they are mostly cache refills
+    printf("\n%-18s %-8s %6s %10s %10s %10s %10s\n",
+           "asset", "from", "bytes", "cold cyc", "cold stall", "warm cyc", "warm stall");
+    for (size_t i = 0; i < count; i++) {
+        printf("%-18s %-8s %6u %10lu %10lu %10lu %10lu\n", results[i].name,
+               residency_tier_name(results[i].tier), results[i].bytes,
+               results[i].cold_cycles, results[i].cold_stall_cycles,
+               results[i].warm_cycles, results[i].warm_stall_cycles);
+    }
+    if (ret == ESP_ERR_INVALID_STATE) {
+        printf("Speed label not on screen, draw not measured\n");
+    } else if (ret != ESP_OK) {
+        printf("Error: %s\n", esp_err_to_name(ret));
+    }
+    printf("\n");
+}
+
+static void handle_lvgl_heap(const char* command)
+{
+    lvgl_heap_stats_t stats;
+    lvgl_heap_get_stats(&stats);
+
+    printf("\n=== LVGL heap (%s) ===\n", lvgl_heap_mode_name(stats.mode));
+    for (int i = 0; i < stats.pool_count; i++) {
+        const lvgl_heap_pool_stats_t* pool = &stats.pools[i];
+        printf("%-8s pool (%s): %u / %u bytes free, low %u, largest block %u, %u%% fragmented\n",
+               pool->name, pool->psram ? "PSRAM" : "internal", pool->free, pool->size,
+               pool->min_free, pool->largest_free, pool->fragmentation_pct);
+    }
+    printf("Slab (%s):\n", stats.slab_psram ? "PSRAM" : "internal");
+    for (int i = 0; i < LVGL_SLAB_CLASS_COUNT; i++) {
+        const lvgl_heap_slab_stats_t* cls = &stats.slab[i];
+        printf("  %4u B  %4u / %4u used, peak %4u, found full %lu times\n",
+               cls->block_size, cls->used, cls->blocks, cls->peak, cls->full);
+    }
+    printf("Allocations: %lu (%lu from the slab), %lu frees, %lu reallocs, %lu failed\n",
+           stats.allocs, stats.slab_allocs, stats.frees, stats.reallocs, stats.failed);
+    if (stats.pool_count > 1) {
+        printf("Served by the other pool: %lu\n", stats.spilled);
+    }
+    printf("Rate: %lu allocations/s\n\n", stats.allocs_per_s);
+}
+
+static void handle_glass(const char* command)
+{
+    const char* arg = console_argument(command);
+    if (arg) {
+        if (!console_argument_is(arg, "reset")) {
+            printf("Error: Unknown argument\n");
+            printf("Usage: glass [reset]\n");
+            return;
+        }
+        glass_trace_reset();
+        printf("Notify-to-glass traces cleared\n");
+        return;
+    }
+
+    printf("\n=== Notify-to-glass latency ===\n");
+    for (int i = 0; i < GLASS_TRACE_WIDGET_COUNT; i++) {
+        glass_trace_stats_t stats;
+        glass_trace_get_stats((glass_trace_widget_t)i, &stats);
+        printf("%-14s %lu drawn, %lu superseded, %lu expired\n", glass_trace_widget_name((glass_trace_widget_t)i),
+               stats.count, stats.superseded, stats.expired);
+        if (stats.count == 0) {
+            continue;
+        }
+        printf("  min %lu.%lu ms, mean %lu.%lu ms (%lu.%lu to the UI, %lu.%lu draw and flush), max %lu.%lu ms\n",
+               stats.min_us / 1000, stats.min_us % 1000 / 100, stats.mean_us / 1000, stats.mean_us % 1000 / 100,
+               stats.mean_ui_us / 1000, stats.mean_ui_us % 1000 / 100,
+               stats.mean_draw_us / 1000, stats.mean_draw_us % 1000 / 100,
+               stats.max_us / 1000, stats.max_us % 1000 / 100);
+        printf("  p50 <= %lu ms, p99 <= %lu ms\n", stats.p50_us / 1000, stats.p99_us / 1000);
+        for (int b = 0; b < GLASS_TRACE_BUCKETS; b++) {
+            if (stats.histogram[b] == 0) {
+                continue;
+            }
+            if (b < GLASS_TRACE_BUCKETS - 1) {
+                printf("  %3d-%3d ms %6lu\n", b * GLASS_TRACE_BUCKET_MS, (b + 1) * GLASS_TRACE_BUCKET_MS,
+                       stats.histogram[b]);
+            } else {
+                printf("  %3d+    ms %6lu\n", b * GLASS_TRACE_BUCKET_MS, stats.histogram[b]);
+            }
+        }
+    }
+    printf("Usage: glass reset to start over\n\n");
+}
+
+static void handle_deadline(const char* command)
+{
+    const char* arg = console_argument(command);
+    if (arg) {
+        if (!console_argument_is(arg, "reset")) {
+            printf("Error: Unknown argument\n");
+            printf("Usage: deadline [reset]\n");
+            return;
+        }
+        esp_err_t err = deadline_monitor_reset();
+        if (err != ESP_OK) {
+            printf("Error: Clearing the stored counters failed: %s\n", esp_err_to_name(err));
+            return;
+        }
+        printf("Deadline misses cleared\n");
+        return;
+    }
+
+    deadline_stats_t stats;
+    deadline_monitor_get_stats(&stats);
+
+    printf("\n=== Throttle pipeline deadlines ===\n");
+    for (int i = 0; i < DEADLINE_SOURCE_COUNT; i++) {
+        const deadline_source_stats_t* source = &stats.sources[i];
+        printf("%-16s budget %lu ms, last kick %lu ms ago, %lu misses (%lu stored), worst overrun %lu ms\n",
+               deadline_source_name((deadline_source_t)i), source->budget_ms, source->age_ms,
+               source->misses, source->stored_misses, source->worst_overrun_ms);
+    }
+    printf("Neutral frames: %lu sent, %lu without an uplink\n", stats.neutral_frames, stats.neutral_failed);
+
+    if (stats.event_count > 0) {
+        int64_t now = esp_timer_get_time();
+        printf("Recent misses:\n");
+        for (int i = 0; i < stats.event_count; i++) {
+            const deadline_event_t* event = &stats.events[i];
+            printf("  %6lld s ago  %-16s task %-16s %-9s %lu ms over%s%s\n",
+                   (now - event->start_us) / 1000000, deadline_source_name(event->source),
+                   event->task[0] ? event->task : "?", deadline_task_state_name(event->task_state), event->overrun_ms,
+                   event->open ? " so far" : "", event->neutral_sent ? ", neutral sent" : "");
+        }
+    }
+    printf("Usage: deadline reset to clear the stored counters\n\n");
+}
+
+static void handle_telemetry(const char* command)
+{
+    const char* arg = console_argument(command);
+    telemetry_snapshot_t snapshot;
+
+    if (arg && console_argument_is(arg, "csv")) {
+        telemetry_get_latest(&snapshot);
+        telemetry_print_csv_header(stdout);
+        telemetry_print_csv_row(stdout, &snapshot);
+        return;
+    }
+
+    if (arg && console_argument_is(arg, "bench")) {
+        int rounds = TELEMETRY_BENCH_DEFAULT_ROUNDS;
+        const char* rounds_str = console_argument(arg);
+        if (rounds_str) {
+            rounds = console_parse_int(rounds_str);
+        }
+        telemetry_bench_result_t result;
+        if (rounds <= 0 || telemetry_bench_run((uint32_t)rounds, &result) != ESP_OK) {
+            printf("Error: Rounds must be 1-%d\n", TELEMETRY_BENCH_MAX_ROUNDS);
+            printf("Usage: telemetry bench [rounds]\n");
+            return;
+        }
+        printf("\n=== Telemetry decode, best of %lu rounds of %d frames ===\n", result.rounds,
+               TELEMETRY_BENCH_ROUND);
+        printf("Schema decoder:    %5lu cycles/frame\n", result.schema_cycles);
+        printf("Reference decoder: %5lu cycles/frame\n", result.reference_cycles);
+        printf("Mismatches: %lu\n\n", result.mismatches);
+        return;
+    }
+
+    if (arg) {
+        printf("Error: Unknown argument\n");
+        printf("Usage: telemetry [csv|bench [rounds]]\n");
+        return;
+    }
+
+    telemetry_get_latest(&snapshot);
+    printf("\n=== Latest telemetry, %lu frames received ===\n", telemetry_get_frame_count());
+    telemetry_print(stdout, &snapshot);
+    printf("Usage: telemetry csv for a CSV row, telemetry bench [rounds] to time the decoder\n\n");
+}
+
+static void handle_bench(const char* command)
+{
+    bool radio = false;
+    int runs = CYCLE_BENCH_DEFAULT_RUNS;
+    const char* arg = console_argument(command);
+    if (arg && console_argument_is(arg, "radio")) {
+        radio = true;
+        arg = console_argument(arg);
+    }
+    if (arg) {
+        runs = console_parse_int(arg);
+    }
+    if (runs <= 0 || runs > CYCLE_BENCH_MAX_RUNS) {
+        printf("Error: Runs must be 1-%d\n", CYCLE_BENCH_MAX_RUNS);
+        printf("Usage: bench [radio] [runs]\n");
+        return;
+    }
+
+    static cycle_bench_report_t report;
+    printf("Running the benchmark suite%s...\n", radio ? " with the radio active" : "");
+    fflush(stdout);
+    esp_err_t err = cycle_bench_run(radio, (uint32_t)runs, &report);
+    if (err == ESP_ERR_INVALID_STATE) {
+        printf("Error: %s\n", radio ? "The radio run needs a connected link" : "Benchmark already running");
+        return;
+    }
+    if (err != ESP_OK) {
+        printf("Error: Benchmark failed: %s\n", esp_err_to_name(err));
+        return;
+    }
+
+    // One line per case, keep the format stable for diffing between versions
+    printf("BENCH v%d target=%s fw=%s cpu_mhz=%lu radio=%s runs=%lu\n", CYCLE_BENCH_FORMAT_VERSION, TARGET_NAME,
+           APP_VERSION_STRING, report.cpu_mhz, report.radio ? "on" : "off", report.runs);
+    for (size_t i = 0; i < report.count; i++) {
+        const cycle_bench_result_t* result = &report.results[i];
+        if (result->skipped) {
+            printf("BENCH %s ops=%u skipped\n", result->name, result->ops);
+        } else {
+            printf("BENCH %s ops=%u min=%lu median=%lu max=%lu\n", result->name, result->ops,
+                   result->min_cycles, result->median_cycles, result->max_cycles);
+        }
+    }
+    printf("BENCH END elapsed_ms=%lu rx_frames=%lu\n", report.elapsed_ms, report.rx_frames);
+}
+
+static void print_ble_backend(void)
+{
+    printf("\n=== BLE backend (%s) ===\n", ble_transport_name());
+    printf("Heap: %lu bytes free, %lu lowest, internal %u free, largest internal block %u\n",
+           esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+           heap_caps_get_free_size(MALLOC_CAP_INTERNAL), heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+
+    const esp_partition_t* running = esp_ota_get_running_partition();
+    esp_image_metadata_t image;
+    const esp_partition_pos_t pos = { .offset = running->address, .size = running->size };
+    if (esp_image_get_metadata(&pos, &image) == ESP_OK) {
+        printf("Image: %lu of %lu bytes in %s (%lu%%), %lu free\n", image.image_len, running->size,
+               running->label, image.image_len * 100 / running->size, running->size - image.image_len);
+    }
+
+    ble_bench_result_t result;
+    ble_bench_get_result(&result);
+    if (result.pings_sent > 0) {
+        printf("Pings: %lu sent, %lu echoed, %lu refused%s\n", result.pings_sent, result.echoes,
+               result.pings_failed, result.active ? ", running" : "");
+    }
+    if (result.rtt_count > 0) {
+        printf("Notify round trip (last %lu): min %lu us, p50 %lu us, p99 %lu us, max %lu us\n",
+               result.rtt_count, result.rtt_min_us, result.rtt_p50_us, result.rtt_p99_us, result.rtt_max_us);
+    }
+
+    ble_link_stats_t stats;
+    ble_get_link_stats(BLE_LINK_PRIMARY, &stats);
+    printf("Throttle writes: %lu (%lu failed), avg %lu us, max %lu us in the stack, %lu B/s now\n",
+           result.writes, result.writes_failed, result.write_avg_us, result.write_max_us, stats.tx_bytes_per_s);
+    printf("\n");
+}
+
+static void handle_ble_backend(const char* command)
+{
+    const char* arg = console_argument(command);
+    if (arg == NULL) {
+        print_ble_backend();
+        printf("Usage: ble_backend ping [count] to time echoes from the receiver, clears the counters\n\n");
+        return;
+    }
+    if (!console_argument_is(arg, "ping")) {
+        printf("Error: Unknown argument\n");
+        printf("Usage: ble_backend [ping [count]]\n");
+        return;
+    }
+
+    int pings = 200;
+    const char* value_str = console_argument(arg);
+    if (value_str) {
+        pings = console_parse_int(value_str);
+    }
+    if (pings <= 0 || ble_bench_start((uint32_t)pings) != ESP_OK) {
+        printf("Error: Needs the primary receiver connected and 1-%d pings\n", BLE_BENCH_MAX_PINGS);
+        return;
+    }
+    // Runs alongside a soak, the console and usb_proto stay free meanwhile
+    printf("Pinging the receiver %d times, every %d ms, ble_backend for the results\n",
+           pings, BLE_BENCH_PERIOD_MS);
+}
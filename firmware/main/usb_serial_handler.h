@@ -3,6 +3,7 @@
 #include <stdint.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "console_parse.h"
 
 
 // ESP32-S3 specific USB CDC settings
@@ -10,25 +11,10 @@
 #define USB_CDC_USE_PRIMARY_CONSOLE 1
 #define USB_CDC_USE_SECONDARY_CONSOLE 0
 #define USB_CDC_INIT_DELAY_MS 100
-#define USB_CDC_TASK_DELAY_MS 50
-#define USB_CDC_BUFFER_SIZE 1024
-
-// Command types that can be received via USB
-typedef enum {
-    CMD_RESET_ODOMETER = 0,
-    CMD_SET_MOTOR_PULLEY,
-    CMD_SET_WHEEL_PULLEY,
-    CMD_SET_WHEEL_SIZE,
-    CMD_SET_MOTOR_POLES,
-    CMD_GET_CONFIG,
-    CMD_CALIBRATE_THROTTLE,
-    CMD_GET_CALIBRATION,
-    CMD_GET_FIRMWARE_VERSION,
-    CMD_SET_SPEED_UNIT_KMH,
-    CMD_SET_SPEED_UNIT_MPH,
-    CMD_HELP,
-    CMD_UNKNOWN
-} usb_command_t;
+#define USB_CDC_FRAME_TIMEOUT_MS 500   // An unfinished binary frame is dropped after this idle time
+#define USB_CDC_READ_CHUNK 256
+#define USB_CDC_BUFFER_SIZE 4096
+
 
 // Function prototypes
 void usb_serial_init(void);
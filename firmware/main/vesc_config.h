@@ -6,7 +6,7 @@
 #include "esp_err.h"
 #include "sdkconfig.h"
 
-// NVS Storage keys
+// Per-key NVS layout used before the settings blob, only read for migration
 #define VESC_NVS_NAMESPACE "vesc_cfg"
 #define NVS_KEY_MOTOR_PULLEY "mot_pulley"
 #define NVS_KEY_WHEEL_PULLEY "wheel_pulley"
@@ -28,7 +28,6 @@ typedef struct {
 #endif
 } vesc_config_t;
 
-esp_err_t vesc_config_init(void);
 esp_err_t vesc_config_load(vesc_config_t *config);
 esp_err_t vesc_config_save(const vesc_config_t *config);
 int32_t vesc_config_get_speed(const vesc_config_t *config);
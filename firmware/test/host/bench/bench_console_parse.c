@@ -0,0 +1,43 @@
+#include "host_bench.h"
+#include "console_parse.h"
+#include "espnow_packet.h"
+
+// Console lines as typed, known commands and a miss
+static const char *const lines[] = {
+    "get_config",
+    "set_motor_poles 14",
+    "stream 20",
+    "espnow pair aa:bb:cc:dd:ee:ff",
+    "telemetry",
+    "no_such_command 1",
+    "  HELP",
+    "log_rate 50",
+};
+#define LINE_COUNT (sizeof(lines) / sizeof(lines[0]))
+
+static void parse_command(uint32_t i)
+{
+    host_bench_sink += console_parse_command(lines[i % LINE_COUNT]);
+}
+
+static void parse_int_argument(uint32_t i)
+{
+    const char *arg = console_argument(lines[1 + (i & 1)]);
+    host_bench_sink += (uint32_t)console_parse_int(arg);
+}
+
+static void parse_mac(uint32_t i)
+{
+    uint8_t mac[ESPNOW_MAC_LEN];
+    const char *arg = console_argument(console_argument(lines[3]));
+    host_bench_sink += console_parse_hex_bytes(arg, mac, sizeof(mac), ':') ? mac[i % ESPNOW_MAC_LEN] : 0;
+}
+
+int main(void)
+{
+    console_parse_init();
+    host_bench_report("console_parse_command", host_bench_ns(parse_command));
+    host_bench_report("console_argument + parse_int", host_bench_ns(parse_int_argument));
+    host_bench_report("console_parse_hex_bytes (MAC)", host_bench_ns(parse_mac));
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host_bench.h"
+#include "host_drivers.h"
+#include "ble.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "telemetry_decode.h"
+#include "espnow_link.h"
+#include "espnow_rx.h"
+
+// How long the ESP-NOW receive callback keeps the Wi-Fi task per telemetry
+// packet: decoding in the callback, as before espnow_rx, against posting to
+// the espnow_rx task. Once with the firmware's own listeners and once with
+// one that stalls every tenth frame, as a listener waiting on flash or a
+// contended mutex would. Real clock, frames 2 ms apart; the host stands in
+// for the target, so the ratios are what carries over, not the numbers.
+
+#define FRAMES              500
+#define FRAME_GAP_US        2000
+#define STALL_EVERY         10
+#define STALL_US            3000
+
+static volatile bool stall = false;
+static uint32_t listener_frames = 0;
+static uint16_t tx_seq = 0;
+
+static void stalling_listener(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    (void)snapshot;
+    (void)user_data;
+    if (stall && ++listener_frames % STALL_EVERY == 0) {
+        usleep(STALL_US);
+    }
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run(const char *name, bool queued)
+{
+    espnow_link_telemetry_cb_t handler = host_espnow_telemetry_handler();
+    static uint64_t callback_ns[FRAMES];
+
+    espnow_link_reset_stats();
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        telemetry_snapshot_t s = {0};
+        s.erpm = (int32_t)(i * 37);
+        s.voltage_c100 = 4000;
+        s.current_in_c100 = (int16_t)(i % 300);
+        uint8_t frame[TELEMETRY_FRAME_LEN];
+        telemetry_encode_frame(&s, frame);
+        uint8_t packet[ESPNOW_PACKET_MAX_LEN];
+        size_t len = espnow_packet_encode(ESPNOW_PACKET_TELEMETRY, tx_seq++, frame, sizeof(frame),
+                                          packet, sizeof(packet));
+
+        uint64_t start = host_time_ns();
+        if (queued) {
+            host_espnow_receive(packet, len);
+        } else {
+            espnow_packet_t decoded;
+            espnow_packet_decode(packet, len, &decoded);
+            handler(decoded.payload, decoded.payload_len);
+        }
+        callback_ns[i] = host_time_ns() - start;
+        usleep(FRAME_GAP_US);
+    }
+    qsort(callback_ns, FRAMES, sizeof(callback_ns[0]), compare_u64);
+
+    printf("%-28s in callback p50 %6.1f us, p99 %7.1f us, max %7.1f us", name,
+           callback_ns[FRAMES / 2] / 1000.0, callback_ns[FRAMES * 99 / 100] / 1000.0,
+           callback_ns[FRAMES - 1] / 1000.0);
+    if (queued) {
+        espnow_rx_stats_t stats;
+        espnow_rx_get_stats(&stats);
+        printf("; hand-off avg %lu us, max %lu us, %lu dropped",
+               (unsigned long)stats.handoff_avg_us, (unsigned long)stats.handoff_max_us,
+               (unsigned long)stats.dropped);
+    }
+    printf("\n");
+}
+
+int main(void)
+{
+    host_nvs_reset();
+    settings_init();
+    telemetry_register_callback(stalling_listener, NULL);
+    spp_client_demo_init();
+    usleep(100000);
+
+    run("decode in callback", false);
+    run("espnow_rx_post", true);
+    stall = true;
+    run("decode in callback, stalls", false);
+    run("espnow_rx_post, stalls", true);
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "host_bench.h"
+#include "settings.h"
+#include "vesc_config.h"
+#include "kinematics.h"
+#include "telemetry.h"
+
+static vesc_config_t config;
+static telemetry_snapshot_t snapshot;
+
+static void erpm_to_mm_s(uint32_t i)
+{
+    host_bench_sink += kinematics_erpm_to_mm_s((int32_t)(i * 37) - 20000);
+}
+
+static void get_speed(uint32_t i)
+{
+    host_bench_sink += (uint32_t)vesc_config_get_speed(&config) + i;
+}
+
+// A published frame with the distance integration behind it
+static void frame(uint32_t i)
+{
+    snapshot.rx_time_us += 50000;
+    snapshot.erpm = (int32_t)(i * 37);
+    telemetry_publish(&snapshot);
+    host_bench_sink += kinematics_get_speed_mm_s();
+}
+
+static void apply_config(uint32_t i)
+{
+    config.wheel_diameter_mm = (uint8_t)(80 + i % 40);
+    kinematics_apply_config(&config);
+    host_bench_sink += kinematics_get_nm_per_erpm_s();
+}
+
+int main(void)
+{
+    host_nvs_reset();
+    settings_init();
+    kinematics_init();
+    vesc_config_load(&config);
+
+    host_bench_report("kinematics_erpm_to_mm_s", host_bench_ns(erpm_to_mm_s));
+    host_bench_report("vesc_config_get_speed", host_bench_ns(get_speed));
+    host_bench_report("telemetry_publish + integration", host_bench_ns(frame));
+    host_bench_report("kinematics_apply_config", host_bench_ns(apply_config));
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include <string.h>
+#include "host_bench.h"
+#include "telemetry_decode.h"
+#include "telemetry_schema.h"
+#include "telemetry_bench.h"
+
+// Frames of a synthetic ride, every fourth one without a BMS
+#define FRAMES 256
+
+static uint8_t frames[FRAMES][TELEMETRY_FRAME_LEN];
+static size_t v2_len[FRAMES];
+static telemetry_snapshot_t decoded;
+
+static void make_frames(void)
+{
+    for (uint32_t i = 0; i < FRAMES; i++) {
+        telemetry_snapshot_t s = {0};
+        s.erpm = (int32_t)(i * 211) - 20000;
+        s.voltage_c100 = (int16_t)(4200 - i);
+        s.current_motor_c100 = (int16_t)(i * 13);
+        s.current_in_c100 = (int16_t)(i * 7);
+        s.temp_mos_c100 = (int16_t)(3000 + i);
+        s.bms_num_cells = i % 4 == 0 ? 0 : 10 + i % 6;
+        for (uint8_t c = 0; c < s.bms_num_cells; c++) {
+            s.cell_mv[c] = (int16_t)(3700 + c + i % 50);
+        }
+        telemetry_encode_frame(&s, frames[i]);
+        v2_len[i] = TELEMETRY_SCHEMA_V2_LEN(s.bms_num_cells);
+    }
+}
+
+static void decode_full(uint32_t i)
+{
+    telemetry_decode_frame(frames[i % FRAMES], TELEMETRY_FRAME_LEN, &decoded);
+    host_bench_sink += (uint32_t)decoded.erpm;
+}
+
+static void decode_v2(uint32_t i)
+{
+    telemetry_decode_frame(frames[i % FRAMES], v2_len[i % FRAMES], &decoded);
+    host_bench_sink += (uint32_t)decoded.erpm;
+}
+
+static void encode(uint32_t i)
+{
+    decoded.erpm = (int32_t)i;
+    telemetry_encode_frame(&decoded, frames[i % FRAMES]);
+    host_bench_sink += frames[i % FRAMES][11];
+}
+
+int main(void)
+{
+    make_frames();
+    host_bench_report("telemetry_decode_frame (55 B)", host_bench_ns(decode_full));
+    host_bench_report("telemetry_decode_frame (v2)", host_bench_ns(decode_v2));
+    host_bench_report("telemetry_encode_frame", host_bench_ns(encode));
+
+    // The on-target bench, against the hand-written reference decoder. The
+    // cycle counter is nanoseconds on the host.
+    telemetry_bench_result_t result;
+    if (telemetry_bench_run(TELEMETRY_BENCH_DEFAULT_ROUNDS, &result) != ESP_OK) {
+        return 1;
+    }
+    host_bench_report("telemetry_bench schema", result.schema_cycles);
+    host_bench_report("telemetry_bench reference", result.reference_cycles);
+    return result.mismatches == 0 ? 0 : 1;
+}
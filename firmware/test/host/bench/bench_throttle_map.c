@@ -0,0 +1,40 @@
+#include "host_bench.h"
+#include "throttle_map.h"
+
+#define SAMPLES 4096
+
+static int32_t raw[SAMPLES];
+
+static void make_samples(void)
+{
+    // Slow sweep with a little noise, like a thumb on the wheel
+    uint32_t noise = 1;
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+        noise = noise * 1103515245u + 12345u;
+        raw[i] = (int32_t)(300 + (i * 3500) / SAMPLES + (noise >> 28));
+    }
+}
+
+static void mean(uint32_t i)
+{
+    host_bench_sink += (uint32_t)throttle_map_mean(&raw[i % (SAMPLES - THROTTLE_MAP_OVERSAMPLE)], THROTTLE_MAP_OVERSAMPLE);
+}
+
+static void linear(uint32_t i)
+{
+    host_bench_sink += throttle_map_linear((uint32_t)raw[i % SAMPLES], 475, 3625);
+}
+
+static void combined(uint32_t i)
+{
+    host_bench_sink += throttle_map_combined(raw[i % SAMPLES], 475, 3625, raw[(SAMPLES - 1) - i % SAMPLES], 500, 3500);
+}
+
+int main(void)
+{
+    make_samples();
+    host_bench_report("throttle_map_mean", host_bench_ns(mean));
+    host_bench_report("throttle_map_linear", host_bench_ns(linear));
+    host_bench_report("throttle_map_combined", host_bench_ns(combined));
+    return 0;
+}
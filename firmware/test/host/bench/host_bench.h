@@ -0,0 +1,42 @@
+#ifndef HOST_BENCH_H
+#define HOST_BENCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "host_shim.h"
+
+// Timing for the host benchmarks, the way the firmware benches time on
+// target: rounds of HOST_BENCH_ROUND calls, the best round counts, which
+// leaves out rounds hit by a preemption or a page fault. Results go to
+// stdout one per line as "<name>: <ns> ns/op".
+
+#define HOST_BENCH_ROUND    1024
+#define HOST_BENCH_ROUNDS   2000
+
+// Call i of a round; results go to host_bench_sink so they are not optimised out
+typedef void (*host_bench_fn_t)(uint32_t i);
+
+static volatile uint32_t host_bench_sink;
+
+static inline double host_bench_ns(host_bench_fn_t fn)
+{
+    uint64_t best = UINT64_MAX;
+    for (uint32_t round = 0; round < HOST_BENCH_ROUNDS; round++) {
+        uint64_t start = host_time_ns();
+        for (uint32_t i = 0; i < HOST_BENCH_ROUND; i++) {
+            fn(i);
+        }
+        uint64_t elapsed = host_time_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return (double)best / HOST_BENCH_ROUND;
+}
+
+static inline void host_bench_report(const char *name, double ns)
+{
+    printf("%-32s %8.2f ns/op\n", name, ns);
+}
+
+#endif // HOST_BENCH_H
@@ -0,0 +1,277 @@
+#include <string.h>
+#include "host_ble.h"
+#include "freertos/FreeRTOS.h"
+
+#define HOST_BLE_MAX_WRITE 64
+#define HOST_BLE_HANDLES   8         // Controller connection slots
+
+typedef struct {
+    bool connected;
+    bool encrypted;
+    uint32_t encryption_requests;
+    uint16_t mtu;
+    uint16_t handle;
+    uint32_t writes;
+    uint32_t commands;
+    uint8_t last_write[HOST_BLE_MAX_WRITE];
+    size_t last_write_len;
+    uint8_t last_command[HOST_BLE_MAX_WRITE];
+    size_t last_command_len;
+} host_link_t;
+
+static const uint16_t conn_intervals[BLE_MAX_LINKS] = BLE_CONN_INTERVALS;
+
+static portMUX_TYPE link_lock = portMUX_INITIALIZER_UNLOCKED;
+static host_link_t links[BLE_MAX_LINKS];
+static const ble_transport_callbacks_t *callbacks = NULL;
+static host_ble_write_hook_t write_hook = NULL;
+static void *write_hook_ctx = NULL;
+static uint16_t next_handle = 0;
+
+esp_err_t ble_transport_init(const ble_transport_callbacks_t *cbs)
+{
+    callbacks = cbs;
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        links[i].mtu = 23;
+    }
+    return ESP_OK;
+}
+
+const char *ble_transport_name(void)
+{
+    return "host";
+}
+
+bool ble_transport_ready(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return false;
+    }
+    portENTER_CRITICAL(&link_lock);
+    bool ready = links[link].connected;
+    portEXIT_CRITICAL(&link_lock);
+    return ready;
+}
+
+static esp_err_t record_write(ble_link_t link, const uint8_t *data, size_t len, bool command)
+{
+    if (link >= BLE_MAX_LINKS || data == NULL || len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&link_lock);
+    host_link_t *l = &links[link];
+    if (!l->connected) {
+        portEXIT_CRITICAL(&link_lock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len > (size_t)(l->mtu - 3)) {
+        portEXIT_CRITICAL(&link_lock);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (command) {
+        l->commands++;
+        l->last_command_len = len < HOST_BLE_MAX_WRITE ? len : HOST_BLE_MAX_WRITE;
+        memcpy(l->last_command, data, l->last_command_len);
+    } else {
+        l->writes++;
+        l->last_write_len = len < HOST_BLE_MAX_WRITE ? len : HOST_BLE_MAX_WRITE;
+        memcpy(l->last_write, data, l->last_write_len);
+    }
+    host_ble_write_hook_t hook = command ? NULL : write_hook;
+    void *ctx = write_hook_ctx;
+    portEXIT_CRITICAL(&link_lock);
+
+    if (hook != NULL) {
+        hook(link, data, len, ctx);
+    }
+    return ESP_OK;
+}
+
+esp_err_t ble_transport_request_encryption(ble_link_t link)
+{
+    if (!ble_transport_ready(link)) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    portENTER_CRITICAL(&link_lock);
+    links[link].encryption_requests++;
+    portEXIT_CRITICAL(&link_lock);
+    return ESP_OK;
+}
+
+bool ble_transport_encrypted(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return false;
+    }
+    portENTER_CRITICAL(&link_lock);
+    bool encrypted = links[link].connected && links[link].encrypted;
+    portEXIT_CRITICAL(&link_lock);
+    return encrypted;
+}
+
+esp_err_t ble_transport_write(ble_link_t link, const uint8_t *data, size_t len)
+{
+    return record_write(link, data, len, false);
+}
+
+esp_err_t ble_transport_write_command(ble_link_t link, const uint8_t *data, size_t len)
+{
+    return record_write(link, data, len, true);
+}
+
+uint16_t ble_transport_mtu(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return 23;
+    }
+    portENTER_CRITICAL(&link_lock);
+    uint16_t mtu = links[link].mtu;
+    portEXIT_CRITICAL(&link_lock);
+    return mtu;
+}
+
+uint16_t ble_transport_conn_interval(ble_link_t link)
+{
+    return ble_transport_ready(link) ? conn_intervals[link] : 0;
+}
+
+int ble_transport_conn_handle(ble_link_t link)
+{
+    if (link >= BLE_MAX_LINKS) {
+        return -1;
+    }
+    portENTER_CRITICAL(&link_lock);
+    int handle = links[link].connected ? links[link].handle : -1;
+    portEXIT_CRITICAL(&link_lock);
+    return handle;
+}
+
+esp_err_t ble_transport_request_rssi(ble_link_t link)
+{
+    return ble_transport_ready(link) ? ESP_OK : ESP_ERR_INVALID_STATE;
+}
+
+void host_ble_connect(ble_link_t link)
+{
+    portENTER_CRITICAL(&link_lock);
+    links[link].connected = true;
+    links[link].encrypted = false;
+    links[link].mtu = BLE_PREFERRED_MTU;
+    // Handles are not reused right away, as with the controller
+    links[link].handle = next_handle;
+    next_handle = (next_handle + 1) % HOST_BLE_HANDLES;
+    portEXIT_CRITICAL(&link_lock);
+    if (callbacks != NULL && callbacks->connected != NULL) {
+        callbacks->connected(link);
+    }
+}
+
+void host_ble_disconnect(ble_link_t link)
+{
+    portENTER_CRITICAL(&link_lock);
+    bool was_connected = links[link].connected;
+    links[link].connected = false;
+    links[link].encrypted = false;
+    links[link].mtu = 23;
+    portEXIT_CRITICAL(&link_lock);
+    if (was_connected && callbacks != NULL && callbacks->disconnected != NULL) {
+        callbacks->disconnected(link);
+    }
+}
+
+void host_ble_notify(ble_link_t link, const uint8_t *data, size_t len)
+{
+    if (ble_transport_ready(link) && callbacks != NULL && callbacks->notify != NULL) {
+        callbacks->notify(link, data, len);
+    }
+}
+
+void host_ble_status(ble_link_t link, const uint8_t *data, size_t len)
+{
+    if (ble_transport_ready(link) && callbacks != NULL && callbacks->status != NULL) {
+        callbacks->status(link, data, len);
+    }
+}
+
+void host_ble_finish_encryption(ble_link_t link, bool success)
+{
+    portENTER_CRITICAL(&link_lock);
+    links[link].encrypted = links[link].connected && success;
+    portEXIT_CRITICAL(&link_lock);
+}
+
+uint32_t host_ble_encryption_requests(ble_link_t link)
+{
+    portENTER_CRITICAL(&link_lock);
+    uint32_t requests = links[link].encryption_requests;
+    portEXIT_CRITICAL(&link_lock);
+    return requests;
+}
+
+void host_ble_rssi(ble_link_t link, int rssi)
+{
+    if (ble_transport_ready(link) && callbacks != NULL && callbacks->rssi != NULL) {
+        callbacks->rssi(link, rssi);
+    }
+}
+
+void host_ble_set_mtu(ble_link_t link, uint16_t mtu)
+{
+    portENTER_CRITICAL(&link_lock);
+    links[link].mtu = mtu;
+    portEXIT_CRITICAL(&link_lock);
+}
+
+void host_ble_set_write_hook(host_ble_write_hook_t hook, void *ctx)
+{
+    portENTER_CRITICAL(&link_lock);
+    write_hook = hook;
+    write_hook_ctx = ctx;
+    portEXIT_CRITICAL(&link_lock);
+}
+
+uint32_t host_ble_write_count(ble_link_t link)
+{
+    portENTER_CRITICAL(&link_lock);
+    uint32_t writes = links[link].writes;
+    portEXIT_CRITICAL(&link_lock);
+    return writes;
+}
+
+uint32_t host_ble_command_count(ble_link_t link)
+{
+    portENTER_CRITICAL(&link_lock);
+    uint32_t commands = links[link].commands;
+    portEXIT_CRITICAL(&link_lock);
+    return commands;
+}
+
+size_t host_ble_last_write(ble_link_t link, uint8_t *out, size_t size)
+{
+    portENTER_CRITICAL(&link_lock);
+    size_t len = links[link].last_write_len < size ? links[link].last_write_len : size;
+    memcpy(out, links[link].last_write, len);
+    portEXIT_CRITICAL(&link_lock);
+    return len;
+}
+
+size_t host_ble_last_command(ble_link_t link, uint8_t *out, size_t size)
+{
+    portENTER_CRITICAL(&link_lock);
+    size_t len = links[link].last_command_len < size ? links[link].last_command_len : size;
+    memcpy(out, links[link].last_command, len);
+    portEXIT_CRITICAL(&link_lock);
+    return len;
+}
+
+void host_ble_reset_counts(void)
+{
+    portENTER_CRITICAL(&link_lock);
+    for (int i = 0; i < BLE_MAX_LINKS; i++) {
+        links[i].writes = 0;
+        links[i].commands = 0;
+        links[i].last_write_len = 0;
+        links[i].last_command_len = 0;
+    }
+    portEXIT_CRITICAL(&link_lock);
+}
@@ -0,0 +1,40 @@
+#ifndef HOST_BLE_H
+#define HOST_BLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ble_transport.h"
+
+// Fake ble_transport for the host build. Instead of the Bluedroid GATTC
+// and GAP events, a test injects what ble_bluedroid.c would report: a
+// link coming up with its characteristics discovered, a notify, an RSSI
+// reading, an MTU exchange, a disconnect. The callbacks ble.c registered
+// run in the calling thread, where on target they run in the Bluetooth
+// host task. Writes are counted per link and handed to a hook.
+
+typedef void (*host_ble_write_hook_t)(ble_link_t link, const uint8_t *data, size_t len, void *ctx);
+
+// Connect, negotiate the preferred MTU and discover; the link is ready, not
+// yet encrypted
+void host_ble_connect(ble_link_t link);
+void host_ble_disconnect(ble_link_t link);
+void host_ble_notify(ble_link_t link, const uint8_t *data, size_t len);
+void host_ble_status(ble_link_t link, const uint8_t *data, size_t len);
+// Completes the pairing a ble_transport_request_encryption started, or
+// reports a refused one
+void host_ble_finish_encryption(ble_link_t link, bool success);
+uint32_t host_ble_encryption_requests(ble_link_t link);
+// Reports an RSSI reading, as after ble_transport_request_rssi
+void host_ble_rssi(ble_link_t link, int rssi);
+void host_ble_set_mtu(ble_link_t link, uint16_t mtu);
+
+void host_ble_set_write_hook(host_ble_write_hook_t hook, void *ctx);
+uint32_t host_ble_write_count(ble_link_t link);
+uint32_t host_ble_command_count(ble_link_t link);
+// Copies the last data write, returns its length
+size_t host_ble_last_write(ble_link_t link, uint8_t *out, size_t size);
+// Same for the command characteristic
+size_t host_ble_last_command(ble_link_t link, uint8_t *out, size_t size);
+void host_ble_reset_counts(void);
+
+#endif // HOST_BLE_H
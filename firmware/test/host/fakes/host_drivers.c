@@ -0,0 +1,243 @@
+#include <string.h>
+#include "host_drivers.h"
+#include "espnow_link.h"
+#include "ble_ota.h"
+#include "lcd.h"
+#include "freertos/FreeRTOS.h"
+
+// ESP-NOW link, never running. Packets a test delivers take the path of
+// the receive callback in espnow_link.c, telemetry through espnow_rx.
+
+static portMUX_TYPE espnow_lock = portMUX_INITIALIZER_UNLOCKED;
+static espnow_link_telemetry_cb_t espnow_telemetry_cb = NULL;
+static espnow_seq_tracker_t espnow_rx_seq;
+static bool espnow_enabled = false;
+static bool espnow_paired = false;
+static uint8_t espnow_peer[ESPNOW_MAC_LEN];
+static uint8_t espnow_channel = ESPNOW_LINK_DEFAULT_CHANNEL;
+static const uint8_t own_mac[ESPNOW_MAC_LEN] = { 0x02, 0x48, 0x4f, 0x53, 0x54, 0x01 };
+
+esp_err_t espnow_link_init(espnow_link_telemetry_cb_t on_telemetry)
+{
+    espnow_telemetry_cb = on_telemetry;
+    return espnow_rx_init(on_telemetry);
+}
+
+bool host_espnow_receive(const uint8_t *data, size_t len)
+{
+    espnow_packet_t packet;
+    if (!espnow_packet_decode(data, len, &packet)) {
+        return false;
+    }
+    portENTER_CRITICAL(&espnow_lock);
+    bool in_order = espnow_seq_track(&espnow_rx_seq, packet.seq);
+    portEXIT_CRITICAL(&espnow_lock);
+    if (!in_order || packet.type != ESPNOW_PACKET_TELEMETRY) {
+        return false;
+    }
+    return espnow_rx_post(packet.payload, packet.payload_len);
+}
+
+espnow_link_telemetry_cb_t host_espnow_telemetry_handler(void)
+{
+    return espnow_telemetry_cb;
+}
+
+esp_err_t espnow_link_set_enabled(bool enabled)
+{
+    portENTER_CRITICAL(&espnow_lock);
+    espnow_enabled = enabled;
+    portEXIT_CRITICAL(&espnow_lock);
+    return ESP_OK;
+}
+
+bool espnow_link_active(void)
+{
+    return false;
+}
+
+esp_err_t espnow_link_send_throttle(const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    return ESP_ERR_INVALID_STATE;
+}
+
+esp_err_t espnow_link_pair(const uint8_t mac[ESPNOW_MAC_LEN], const uint8_t key[ESPNOW_KEY_LEN], uint8_t channel)
+{
+    (void)key;
+    if (channel < 1 || channel > 13) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    portENTER_CRITICAL(&espnow_lock);
+    memcpy(espnow_peer, mac, ESPNOW_MAC_LEN);
+    espnow_channel = channel;
+    espnow_paired = true;
+    portEXIT_CRITICAL(&espnow_lock);
+    return ESP_OK;
+}
+
+esp_err_t espnow_link_unpair(void)
+{
+    portENTER_CRITICAL(&espnow_lock);
+    espnow_paired = false;
+    memset(espnow_peer, 0, sizeof(espnow_peer));
+    portEXIT_CRITICAL(&espnow_lock);
+    return ESP_OK;
+}
+
+uint8_t espnow_link_channel(void)
+{
+    portENTER_CRITICAL(&espnow_lock);
+    uint8_t channel = espnow_channel;
+    portEXIT_CRITICAL(&espnow_lock);
+    return channel;
+}
+
+void espnow_link_get_own_mac(uint8_t mac[ESPNOW_MAC_LEN])
+{
+    memcpy(mac, own_mac, ESPNOW_MAC_LEN);
+}
+
+esp_err_t espnow_link_bench_start(uint32_t pings)
+{
+    (void)pings;
+    return ESP_ERR_INVALID_STATE;
+}
+
+bool espnow_link_bench_is_active(void)
+{
+    return false;
+}
+
+void espnow_link_reset_stats(void)
+{
+    espnow_rx_reset_stats();
+}
+
+void espnow_link_get_status(espnow_link_status_t *status)
+{
+    memset(status, 0, sizeof(*status));
+    portENTER_CRITICAL(&espnow_lock);
+    status->rx = espnow_rx_seq;
+    status->enabled = espnow_enabled;
+    status->paired = espnow_paired;
+    memcpy(status->peer_mac, espnow_peer, ESPNOW_MAC_LEN);
+    status->channel = espnow_channel;
+    portEXIT_CRITICAL(&espnow_lock);
+    memcpy(status->own_mac, own_mac, ESPNOW_MAC_LEN);
+    status->last_rx_age_ms = UINT32_MAX;
+    espnow_rx_get_stats(&status->rx_queue);
+}
+
+// BLE OTA, messages counted and dropped
+
+static portMUX_TYPE ota_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t ota_messages = 0;
+static uint32_t ota_links_lost = 0;
+
+esp_err_t ble_ota_init(void)
+{
+    return ESP_OK;
+}
+
+void ble_ota_handle_message(const uint8_t *data, size_t len)
+{
+    (void)data;
+    (void)len;
+    portENTER_CRITICAL(&ota_lock);
+    ota_messages++;
+    portEXIT_CRITICAL(&ota_lock);
+}
+
+void ble_ota_link_lost(void)
+{
+    portENTER_CRITICAL(&ota_lock);
+    ota_links_lost++;
+    portEXIT_CRITICAL(&ota_lock);
+}
+
+void ble_ota_get_status(ble_ota_status_t *status)
+{
+    memset(status, 0, sizeof(*status));
+    status->state = BLE_OTA_STATE_IDLE;
+    status->result = BLE_OTA_OK;
+}
+
+const char *ble_ota_result_name(ble_ota_result_t result)
+{
+    switch (result) {
+        case BLE_OTA_OK:            return "ok";
+        case BLE_OTA_ERR_BUSY:      return "busy";
+        case BLE_OTA_ERR_SIZE:      return "bad size";
+        case BLE_OTA_ERR_MOVING:    return "board moving";
+        case BLE_OTA_ERR_FLASH:     return "flash error";
+        case BLE_OTA_ERR_HASH:      return "hash mismatch";
+        case BLE_OTA_ERR_IMAGE:     return "invalid image";
+        case BLE_OTA_ERR_ABORTED:   return "aborted";
+        case BLE_OTA_ERR_TIMEOUT:   return "timeout";
+        case BLE_OTA_ERR_UNENCRYPTED: return "link not encrypted";
+        default:                    return "unknown";
+    }
+}
+
+uint32_t host_ota_messages(void)
+{
+    portENTER_CRITICAL(&ota_lock);
+    uint32_t messages = ota_messages;
+    portEXIT_CRITICAL(&ota_lock);
+    return messages;
+}
+
+uint32_t host_ota_links_lost(void)
+{
+    portENTER_CRITICAL(&ota_lock);
+    uint32_t lost = ota_links_lost;
+    portEXIT_CRITICAL(&ota_lock);
+    return lost;
+}
+
+// LCD, no panel; labels live on the active screen of whatever display
+// the test registered
+
+static uint8_t backlight = 0;
+
+void lcd_init(void)
+{
+}
+
+lv_obj_t *lcd_create_label(const char *initial_text)
+{
+    lv_obj_t *label = lv_label_create(lv_scr_act());
+    lv_label_set_text(label, initial_text);
+    return label;
+}
+
+void lcd_start_tasks(void)
+{
+}
+
+void lcd_enable_update(void)
+{
+}
+
+void lcd_disable_update(void)
+{
+}
+
+void lcd_set_backlight(uint8_t brightness)
+{
+    backlight = brightness;
+}
+
+void lcd_fade_backlight(uint8_t start, uint8_t end, uint16_t duration_ms)
+{
+    (void)start;
+    (void)duration_ms;
+    backlight = end;
+}
+
+uint8_t host_lcd_backlight(void)
+{
+    return backlight;
+}
@@ -0,0 +1,23 @@
+#ifndef HOST_DRIVERS_H
+#define HOST_DRIVERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "espnow_link.h"
+
+// Fakes for the drivers the host build leaves out: the ESP-NOW link stays
+// paired-or-not but never goes active, so the throttle always takes BLE;
+// BLE OTA messages are only counted; the LCD keeps its backlight level.
+
+// An ESP-NOW packet from the peer, as the Wi-Fi task would hand it over:
+// telemetry is posted to espnow_rx, true if it was queued
+bool host_espnow_receive(const uint8_t *data, size_t len);
+// The handler ble.c gave espnow_link_init, to call it the pre-queue way
+espnow_link_telemetry_cb_t host_espnow_telemetry_handler(void);
+
+uint32_t host_ota_messages(void);
+uint32_t host_ota_links_lost(void);
+uint8_t host_lcd_backlight(void);
+
+#endif // HOST_DRIVERS_H
@@ -0,0 +1,488 @@
+#include <string.h>
+#include "host_nimble.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+
+#define CONN_HANDLE         1
+#define SERVICE_START       0x10
+#define PEER_MTU            247
+#define MAX_PENDING         16
+#define HCI_LOCAL_HOST_TERM 0x16
+
+// Characteristic i is declared at SERVICE_START + 1 + 3 * i, its value and
+// CCCD follow
+#define CHR_DEF(i)          (SERVICE_START + 1 + 3 * (i))
+#define CHR_VAL(i)          (CHR_DEF(i) + 1)
+
+typedef enum {
+    OP_CONNECT,
+    OP_DISCONNECT,
+    OP_MTU,
+    OP_DISC_SVC,
+    OP_DISC_CHRS,
+    OP_WRITE,
+    OP_ENCRYPT,
+} op_type_t;
+
+typedef struct {
+    op_type_t type;
+    void *cb;
+    void *arg;
+    uint16_t handle;
+    int status;
+} pending_op_t;
+
+struct ble_hs_cfg ble_hs_cfg;
+
+static host_nimble_chr_t chrs[HOST_NIMBLE_MAX_CHRS];
+static size_t chr_count;
+static int fail_rc[HOST_NIMBLE_STEPS];
+static int fail_status[HOST_NIMBLE_STEPS];
+
+static pending_op_t pending[MAX_PENDING];
+static int pending_head;
+static int pending_count;
+
+static bool scanning;
+static ble_gap_event_fn *scan_cb;
+static void *scan_arg;
+static bool connecting;
+static bool connected;
+static bool encrypted;
+static ble_gap_event_fn *conn_cb;
+static void *conn_arg;
+static uint16_t mtu = BLE_ATT_MTU_DFLT;
+
+static uint32_t terminates;
+static uint8_t terminate_reason;
+static uint32_t subscribes;
+static uint32_t writes;
+
+static void queue_op(op_type_t type, void *cb, void *arg, uint16_t handle, int status)
+{
+    if (pending_count == MAX_PENDING) {
+        return;
+    }
+    pending[(pending_head + pending_count) % MAX_PENDING] = (pending_op_t){type, cb, arg, handle, status};
+    pending_count++;
+}
+
+// Returns the scripted rc of the step and clears it
+static int take(int *table, host_nimble_step_t step)
+{
+    int value = table[step];
+    table[step] = 0;
+    return value;
+}
+
+uint16_t ble_uuid_u16(const ble_uuid_t *uuid)
+{
+    return uuid->type == BLE_UUID_TYPE_16 ? ((const ble_uuid16_t *)uuid)->value : 0;
+}
+
+int ble_hs_adv_parse_fields(struct ble_hs_adv_fields *fields, const uint8_t *src, uint8_t src_len)
+{
+    memset(fields, 0, sizeof(*fields));
+    for (uint8_t i = 0; i + 1 < src_len; i += src[i] + 1) {
+        if (src[i] == 0 || i + 1 + src[i] > src_len) {
+            return BLE_HS_ENOENT;
+        }
+        if (src[i + 1] == BLE_HS_ADV_TYPE_COMP_NAME) {
+            fields->name = &src[i + 2];
+            fields->name_len = src[i] - 1;
+            fields->name_is_complete = 1;
+        }
+    }
+    return 0;
+}
+
+int ble_gap_disc(uint8_t own_addr_type, int32_t duration_ms, const struct ble_gap_disc_params *params,
+                 ble_gap_event_fn *cb, void *cb_arg)
+{
+    if (scanning) {
+        return BLE_HS_EALREADY;
+    }
+    scanning = true;
+    scan_cb = cb;
+    scan_arg = cb_arg;
+    return 0;
+}
+
+int ble_gap_disc_active(void)
+{
+    return scanning;
+}
+
+int ble_gap_disc_cancel(void)
+{
+    scanning = false;
+    return 0;
+}
+
+int ble_gap_connect(uint8_t own_addr_type, const ble_addr_t *peer_addr, int32_t duration_ms,
+                    const struct ble_gap_conn_params *params, ble_gap_event_fn *cb, void *cb_arg)
+{
+    if (connecting || connected) {
+        return BLE_HS_EALREADY;
+    }
+    connecting = true;
+    conn_cb = cb;
+    conn_arg = cb_arg;
+    queue_op(OP_CONNECT, NULL, NULL, 0, 0);
+    return 0;
+}
+
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason)
+{
+    if (!connected || conn_handle != CONN_HANDLE) {
+        return BLE_HS_ENOTCONN;
+    }
+    terminates++;
+    terminate_reason = hci_reason;
+    // GATT procedures still queued die with the link
+    pending_count = 0;
+    queue_op(OP_DISCONNECT, NULL, NULL, 0, BLE_HS_ERR_HCI_BASE + HCI_LOCAL_HOST_TERM);
+    return 0;
+}
+
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc)
+{
+    if (!connected || handle != CONN_HANDLE) {
+        return BLE_HS_ENOTCONN;
+    }
+    memset(out_desc, 0, sizeof(*out_desc));
+    out_desc->conn_handle = handle;
+    out_desc->conn_itvl = 6;
+    out_desc->sec_state.encrypted = encrypted;
+    return 0;
+}
+
+int ble_gap_conn_rssi(uint16_t conn_handle, int8_t *out_rssi)
+{
+    if (!connected || conn_handle != CONN_HANDLE) {
+        return BLE_HS_ENOTCONN;
+    }
+    *out_rssi = -60;
+    return 0;
+}
+
+int ble_gap_security_initiate(uint16_t conn_handle)
+{
+    if (!connected || conn_handle != CONN_HANDLE) {
+        return BLE_HS_ENOTCONN;
+    }
+    int rc = take(fail_rc, HOST_NIMBLE_ENCRYPT);
+    if (rc == 0) {
+        queue_op(OP_ENCRYPT, NULL, NULL, 0, take(fail_status, HOST_NIMBLE_ENCRYPT));
+    }
+    return rc;
+}
+
+int ble_gattc_exchange_mtu(uint16_t conn_handle, ble_gatt_mtu_fn *cb, void *cb_arg)
+{
+    int rc = take(fail_rc, HOST_NIMBLE_MTU);
+    if (rc == 0) {
+        queue_op(OP_MTU, cb, cb_arg, 0, take(fail_status, HOST_NIMBLE_MTU));
+    }
+    return rc;
+}
+
+int ble_gattc_disc_svc_by_uuid(uint16_t conn_handle, const ble_uuid_t *uuid, ble_gatt_disc_svc_fn *cb, void *cb_arg)
+{
+    int rc = take(fail_rc, HOST_NIMBLE_DISC_SVC);
+    if (rc == 0) {
+        queue_op(OP_DISC_SVC, cb, cb_arg, 0, take(fail_status, HOST_NIMBLE_DISC_SVC));
+    }
+    return rc;
+}
+
+int ble_gattc_disc_all_chrs(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle,
+                            ble_gatt_chr_fn *cb, void *cb_arg)
+{
+    int rc = take(fail_rc, HOST_NIMBLE_DISC_CHRS);
+    if (rc == 0) {
+        queue_op(OP_DISC_CHRS, cb, cb_arg, 0, take(fail_status, HOST_NIMBLE_DISC_CHRS));
+    }
+    return rc;
+}
+
+int ble_gattc_write_flat(uint16_t conn_handle, uint16_t attr_handle, const void *data, uint16_t data_len,
+                         ble_gatt_attr_fn *cb, void *cb_arg)
+{
+    if (!connected) {
+        return BLE_HS_ENOTCONN;
+    }
+    bool cccd = false;
+    for (size_t i = 0; i < chr_count; i++) {
+        cccd |= attr_handle == CHR_VAL(i) + 1;
+    }
+    if (!cccd) {
+        writes++;
+        return 0;
+    }
+    int rc = take(fail_rc, HOST_NIMBLE_SUBSCRIBE);
+    if (rc == 0) {
+        subscribes++;
+        if (cb != NULL) {
+            queue_op(OP_WRITE, cb, cb_arg, attr_handle, take(fail_status, HOST_NIMBLE_SUBSCRIBE));
+        }
+    }
+    return rc;
+}
+
+int ble_gattc_write_no_rsp_flat(uint16_t conn_handle, uint16_t attr_handle, const void *data, uint16_t data_len)
+{
+    if (!connected) {
+        return BLE_HS_ENOTCONN;
+    }
+    writes++;
+    return 0;
+}
+
+uint16_t ble_att_mtu(uint16_t conn_handle)
+{
+    return connected ? mtu : 0;
+}
+
+int ble_att_set_preferred_mtu(uint16_t preferred)
+{
+    return 0;
+}
+
+int ble_hs_mbuf_to_flat(const struct os_mbuf *om, void *flat, uint16_t max_len, uint16_t *out_copy_len)
+{
+    uint16_t len = om->len < max_len ? om->len : max_len;
+    memcpy(flat, om->data, len);
+    *out_copy_len = len;
+    return len < om->len ? BLE_HS_ENOENT : 0;
+}
+
+int ble_hs_id_infer_auto(int privacy, uint8_t *out_addr_type)
+{
+    *out_addr_type = 0;
+    return 0;
+}
+
+int ble_hs_util_ensure_addr(int prefer_random)
+{
+    return 0;
+}
+
+esp_err_t nimble_port_init(void)
+{
+    return ESP_OK;
+}
+
+void nimble_port_run(void)
+{
+}
+
+void nimble_port_freertos_init(TaskFunction_t host_task_fn)
+{
+}
+
+void nimble_port_freertos_deinit(void)
+{
+}
+
+static void run_op(const pending_op_t *op)
+{
+    struct ble_gap_event event;
+    struct ble_gatt_error error = { .status = (uint16_t)op->status };
+
+    memset(&event, 0, sizeof(event));
+    switch (op->type) {
+        case OP_CONNECT:
+            connecting = false;
+            connected = true;
+            encrypted = false;
+            mtu = BLE_ATT_MTU_DFLT;
+            event.type = BLE_GAP_EVENT_CONNECT;
+            event.connect.conn_handle = CONN_HANDLE;
+            conn_cb(&event, conn_arg);
+            break;
+
+        case OP_DISCONNECT:
+            connected = false;
+            encrypted = false;
+            event.type = BLE_GAP_EVENT_DISCONNECT;
+            event.disconnect.reason = op->status;
+            event.disconnect.conn.conn_handle = CONN_HANDLE;
+            conn_cb(&event, conn_arg);
+            break;
+
+        case OP_MTU:
+            if (op->status == 0) {
+                mtu = PEER_MTU;
+            }
+            ((ble_gatt_mtu_fn *)op->cb)(CONN_HANDLE, &error, mtu, op->arg);
+            break;
+
+        case OP_DISC_SVC: {
+            ble_gatt_disc_svc_fn *cb = op->cb;
+            if (op->status == 0 && chr_count > 0) {
+                struct ble_gatt_svc service = {
+                    .start_handle = SERVICE_START,
+                    .end_handle = CHR_VAL(chr_count - 1) + 1,
+                };
+                cb(CONN_HANDLE, &error, &service, op->arg);
+            }
+            error.status = op->status != 0 ? op->status : BLE_HS_EDONE;
+            cb(CONN_HANDLE, &error, NULL, op->arg);
+            break;
+        }
+
+        case OP_DISC_CHRS: {
+            ble_gatt_chr_fn *cb = op->cb;
+            for (size_t i = 0; op->status == 0 && i < chr_count; i++) {
+                struct ble_gatt_chr chr = {
+                    .def_handle = CHR_DEF(i),
+                    .val_handle = CHR_VAL(i),
+                    .properties = chrs[i].properties,
+                    .uuid.u16 = BLE_UUID16_INIT(chrs[i].uuid),
+                };
+                cb(CONN_HANDLE, &error, &chr, op->arg);
+            }
+            error.status = op->status != 0 ? op->status : BLE_HS_EDONE;
+            cb(CONN_HANDLE, &error, NULL, op->arg);
+            break;
+        }
+
+        case OP_ENCRYPT:
+            encrypted = op->status == 0;
+            event.type = BLE_GAP_EVENT_ENC_CHANGE;
+            event.enc_change.status = op->status;
+            event.enc_change.conn_handle = CONN_HANDLE;
+            conn_cb(&event, conn_arg);
+            break;
+
+        case OP_WRITE: {
+            struct ble_gatt_attr attr = { .handle = op->handle };
+            error.att_handle = op->handle;
+            ((ble_gatt_attr_fn *)op->cb)(CONN_HANDLE, &error, &attr, op->arg);
+            break;
+        }
+    }
+}
+
+bool host_nimble_run_one(void)
+{
+    if (pending_count == 0) {
+        return false;
+    }
+    pending_op_t op = pending[pending_head];
+    pending_head = (pending_head + 1) % MAX_PENDING;
+    pending_count--;
+    run_op(&op);
+    return true;
+}
+
+int host_nimble_run(void)
+{
+    int count = 0;
+    while (host_nimble_run_one()) {
+        count++;
+    }
+    return count;
+}
+
+bool host_nimble_advertise(const char *name)
+{
+    if (!scanning) {
+        return false;
+    }
+    uint8_t adv[31];
+    size_t len = strlen(name);
+    if (len > sizeof(adv) - 2) {
+        len = sizeof(adv) - 2;
+    }
+    adv[0] = (uint8_t)(len + 1);
+    adv[1] = BLE_HS_ADV_TYPE_COMP_NAME;
+    memcpy(&adv[2], name, len);
+
+    struct ble_gap_event event;
+    memset(&event, 0, sizeof(event));
+    event.type = BLE_GAP_EVENT_DISC;
+    event.disc.addr.val[0] = 0x42;
+    event.disc.rssi = -60;
+    event.disc.data = adv;
+    event.disc.length_data = (uint8_t)(len + 2);
+    scan_cb(&event, scan_arg);
+    return true;
+}
+
+void host_nimble_set_chrs(const host_nimble_chr_t *list, size_t count)
+{
+    chr_count = count < HOST_NIMBLE_MAX_CHRS ? count : HOST_NIMBLE_MAX_CHRS;
+    memcpy(chrs, list, chr_count * sizeof(chrs[0]));
+}
+
+void host_nimble_fail_call(host_nimble_step_t step, int rc)
+{
+    fail_rc[step] = rc;
+}
+
+void host_nimble_fail_status(host_nimble_step_t step, int status)
+{
+    fail_status[step] = status;
+}
+
+void host_nimble_reset(void)
+{
+    chr_count = 0;
+    memset(fail_rc, 0, sizeof(fail_rc));
+    memset(fail_status, 0, sizeof(fail_status));
+    pending_count = 0;
+    scanning = false;
+    connecting = false;
+    connected = false;
+    encrypted = false;
+    mtu = BLE_ATT_MTU_DFLT;
+    terminates = 0;
+    terminate_reason = 0;
+    subscribes = 0;
+    writes = 0;
+    if (ble_hs_cfg.reset_cb != NULL) {
+        ble_hs_cfg.reset_cb(0);
+    }
+    if (ble_hs_cfg.sync_cb != NULL) {
+        ble_hs_cfg.sync_cb();
+    }
+}
+
+bool host_nimble_connected(void)
+{
+    return connected;
+}
+
+bool host_nimble_encrypted(void)
+{
+    return encrypted;
+}
+
+bool host_nimble_scanning(void)
+{
+    return scanning;
+}
+
+uint32_t host_nimble_terminate_count(void)
+{
+    return terminates;
+}
+
+uint8_t host_nimble_terminate_reason(void)
+{
+    return terminate_reason;
+}
+
+uint32_t host_nimble_subscribe_count(void)
+{
+    return subscribes;
+}
+
+uint32_t host_nimble_write_count(void)
+{
+    return writes;
+}
@@ -0,0 +1,53 @@
+#ifndef HOST_NIMBLE_H
+#define HOST_NIMBLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Fake NimBLE host for ble_nimble.c. A test scripts one peer: the SPP
+// characteristics it has and which steps fail, either as a non-zero
+// return from the call or as an error status in the completion. Calls
+// only queue their completion; host_nimble_run() delivers them in order
+// in the calling thread, where on target the NimBLE host task does.
+
+#define HOST_NIMBLE_MAX_CHRS    8
+
+typedef enum {
+    HOST_NIMBLE_MTU,
+    HOST_NIMBLE_DISC_SVC,
+    HOST_NIMBLE_DISC_CHRS,
+    HOST_NIMBLE_SUBSCRIBE,      // CCCD writes, in order
+    HOST_NIMBLE_ENCRYPT,        // Pairing started by ble_gap_security_initiate
+    HOST_NIMBLE_STEPS,
+} host_nimble_step_t;
+
+typedef struct {
+    uint16_t uuid;
+    uint8_t properties;
+} host_nimble_chr_t;
+
+// Forgets the peer and the failures, resets and syncs the host
+void host_nimble_reset(void);
+void host_nimble_set_chrs(const host_nimble_chr_t *chrs, size_t count);
+// Next call of the step returns rc instead of queueing a completion
+void host_nimble_fail_call(host_nimble_step_t step, int rc);
+// Next completion of the step reports status
+void host_nimble_fail_status(host_nimble_step_t step, int status);
+
+// Advertises name to a running scan; false if nothing was scanning
+bool host_nimble_advertise(const char *name);
+// Delivers the queued completions, including those they queue; returns how many
+int host_nimble_run(void);
+// Same, one completion at a time
+bool host_nimble_run_one(void);
+
+bool host_nimble_connected(void);
+bool host_nimble_encrypted(void);
+bool host_nimble_scanning(void);
+uint32_t host_nimble_terminate_count(void);
+uint8_t host_nimble_terminate_reason(void);
+uint32_t host_nimble_subscribe_count(void);
+uint32_t host_nimble_write_count(void);
+
+#endif // HOST_NIMBLE_H
@@ -0,0 +1,223 @@
+#ifndef HOST_FAKE_BLE_HS_H
+#define HOST_FAKE_BLE_HS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// The part of the NimBLE host API ble_nimble.c uses, declared as in
+// NimBLE and implemented by host_nimble.c against a scripted peer.
+
+#define BLE_HS_EALREADY             2
+#define BLE_HS_ENOENT               5
+#define BLE_HS_ENOTCONN             7
+#define BLE_HS_ETIMEOUT             13
+#define BLE_HS_EDONE                14
+#define BLE_HS_ERR_ATT_BASE         0x100
+#define BLE_HS_ERR_HCI_BASE         0x200
+#define BLE_HS_FOREVER              INT32_MAX
+#define BLE_HS_CONN_HANDLE_NONE     0xffff
+
+#define BLE_ERR_REM_USER_CONN_TERM  0x13
+#define BLE_ATT_ERR_WRITE_NOT_PERMITTED 0x03
+#define BLE_ATT_MTU_DFLT            23
+
+#define BLE_GATT_CHR_PROP_READ          0x02
+#define BLE_GATT_CHR_PROP_WRITE_NO_RSP  0x04
+#define BLE_GATT_CHR_PROP_WRITE         0x08
+#define BLE_GATT_CHR_PROP_NOTIFY        0x10
+
+#define BLE_GAP_EVENT_CONNECT           0
+#define BLE_GAP_EVENT_DISCONNECT        1
+#define BLE_GAP_EVENT_DISC              7
+#define BLE_GAP_EVENT_DISC_COMPLETE     8
+#define BLE_GAP_EVENT_ENC_CHANGE        10
+#define BLE_GAP_EVENT_NOTIFY_RX         12
+
+#define BLE_SM_IO_CAP_NO_IO             0x03
+#define BLE_SM_ERR_PAIR_NOT_SUPP        0x05
+#define BLE_HS_ERR_SM_PEER_BASE         0x500
+
+#define BLE_UUID_TYPE_16                16
+#define BLE_HS_ADV_TYPE_COMP_NAME       0x09
+
+typedef struct {
+    uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+    ble_uuid_t u;
+    uint16_t value;
+} ble_uuid16_t;
+
+typedef union {
+    ble_uuid_t u;
+    ble_uuid16_t u16;
+} ble_uuid_any_t;
+
+#define BLE_UUID16_INIT(uuid16) { .u = { .type = BLE_UUID_TYPE_16 }, .value = (uuid16) }
+
+uint16_t ble_uuid_u16(const ble_uuid_t *uuid);
+
+typedef struct {
+    uint8_t type;
+    uint8_t val[6];
+} ble_addr_t;
+
+struct os_mbuf {
+    const uint8_t *data;
+    uint16_t len;
+};
+
+struct ble_hs_adv_fields {
+    const uint8_t *name;
+    uint8_t name_len;
+    unsigned name_is_complete:1;
+};
+
+int ble_hs_adv_parse_fields(struct ble_hs_adv_fields *fields, const uint8_t *src, uint8_t src_len);
+
+struct ble_gap_disc_desc {
+    uint8_t event_type;
+    uint8_t length_data;
+    ble_addr_t addr;
+    int8_t rssi;
+    const uint8_t *data;
+};
+
+struct ble_gap_disc_params {
+    uint16_t itvl;
+    uint16_t window;
+    uint8_t filter_policy;
+    uint8_t limited:1;
+    uint8_t passive:1;
+    uint8_t filter_duplicates:1;
+};
+
+struct ble_gap_conn_params {
+    uint16_t scan_itvl;
+    uint16_t scan_window;
+    uint16_t itvl_min;
+    uint16_t itvl_max;
+    uint16_t latency;
+    uint16_t supervision_timeout;
+    uint16_t min_ce_len;
+    uint16_t max_ce_len;
+};
+
+struct ble_gap_sec_state {
+    unsigned encrypted:1;
+    unsigned authenticated:1;
+    unsigned bonded:1;
+};
+
+struct ble_gap_conn_desc {
+    struct ble_gap_sec_state sec_state;
+    uint16_t conn_handle;
+    uint16_t conn_itvl;
+    uint16_t conn_latency;
+    uint16_t supervision_timeout;
+};
+
+struct ble_gap_event {
+    uint8_t type;
+    union {
+        struct ble_gap_disc_desc disc;
+        struct {
+            int status;
+            uint16_t conn_handle;
+        } connect;
+        struct {
+            int reason;
+            struct ble_gap_conn_desc conn;
+        } disconnect;
+        struct {
+            int reason;
+        } disc_complete;
+        struct {
+            int status;
+            uint16_t conn_handle;
+        } enc_change;
+        struct {
+            struct os_mbuf *om;
+            uint16_t attr_handle;
+            uint16_t conn_handle;
+            uint8_t indication:1;
+        } notify_rx;
+    };
+};
+
+typedef int ble_gap_event_fn(struct ble_gap_event *event, void *arg);
+
+int ble_gap_disc(uint8_t own_addr_type, int32_t duration_ms, const struct ble_gap_disc_params *params,
+                 ble_gap_event_fn *cb, void *cb_arg);
+int ble_gap_disc_active(void);
+int ble_gap_disc_cancel(void);
+int ble_gap_connect(uint8_t own_addr_type, const ble_addr_t *peer_addr, int32_t duration_ms,
+                    const struct ble_gap_conn_params *params, ble_gap_event_fn *cb, void *cb_arg);
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason);
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc);
+int ble_gap_conn_rssi(uint16_t conn_handle, int8_t *out_rssi);
+int ble_gap_security_initiate(uint16_t conn_handle);
+
+struct ble_gatt_error {
+    uint16_t status;
+    uint16_t att_handle;
+};
+
+struct ble_gatt_svc {
+    uint16_t start_handle;
+    uint16_t end_handle;
+    ble_uuid_any_t uuid;
+};
+
+struct ble_gatt_chr {
+    uint16_t def_handle;
+    uint16_t val_handle;
+    uint8_t properties;
+    ble_uuid_any_t uuid;
+};
+
+struct ble_gatt_attr {
+    uint16_t handle;
+    uint16_t offset;
+    struct os_mbuf *om;
+};
+
+typedef int ble_gatt_mtu_fn(uint16_t conn_handle, const struct ble_gatt_error *error, uint16_t mtu, void *arg);
+typedef int ble_gatt_disc_svc_fn(uint16_t conn_handle, const struct ble_gatt_error *error,
+                                 const struct ble_gatt_svc *service, void *arg);
+typedef int ble_gatt_chr_fn(uint16_t conn_handle, const struct ble_gatt_error *error,
+                            const struct ble_gatt_chr *chr, void *arg);
+typedef int ble_gatt_attr_fn(uint16_t conn_handle, const struct ble_gatt_error *error,
+                             struct ble_gatt_attr *attr, void *arg);
+
+int ble_gattc_exchange_mtu(uint16_t conn_handle, ble_gatt_mtu_fn *cb, void *cb_arg);
+int ble_gattc_disc_svc_by_uuid(uint16_t conn_handle, const ble_uuid_t *uuid, ble_gatt_disc_svc_fn *cb, void *cb_arg);
+int ble_gattc_disc_all_chrs(uint16_t conn_handle, uint16_t start_handle, uint16_t end_handle,
+                            ble_gatt_chr_fn *cb, void *cb_arg);
+int ble_gattc_write_flat(uint16_t conn_handle, uint16_t attr_handle, const void *data, uint16_t data_len,
+                         ble_gatt_attr_fn *cb, void *cb_arg);
+int ble_gattc_write_no_rsp_flat(uint16_t conn_handle, uint16_t attr_handle, const void *data, uint16_t data_len);
+
+uint16_t ble_att_mtu(uint16_t conn_handle);
+int ble_att_set_preferred_mtu(uint16_t mtu);
+int ble_hs_mbuf_to_flat(const struct os_mbuf *om, void *flat, uint16_t max_len, uint16_t *out_copy_len);
+int ble_hs_id_infer_auto(int privacy, uint8_t *out_addr_type);
+
+typedef void ble_hs_sync_fn(void);
+typedef void ble_hs_reset_fn(int reason);
+
+struct ble_hs_cfg {
+    ble_hs_sync_fn *sync_cb;
+    ble_hs_reset_fn *reset_cb;
+    uint8_t sm_io_cap;
+    unsigned sm_oob_data_flag:1;
+    unsigned sm_bonding:1;
+    unsigned sm_mitm:1;
+    unsigned sm_sc:1;
+};
+
+extern struct ble_hs_cfg ble_hs_cfg;
+
+#endif // HOST_FAKE_BLE_HS_H
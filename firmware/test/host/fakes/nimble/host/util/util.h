@@ -0,0 +1,8 @@
+#ifndef HOST_FAKE_BLE_HS_UTIL_H
+#define HOST_FAKE_BLE_HS_UTIL_H
+
+#include "host/ble_hs.h"
+
+int ble_hs_util_ensure_addr(int prefer_random);
+
+#endif // HOST_FAKE_BLE_HS_UTIL_H
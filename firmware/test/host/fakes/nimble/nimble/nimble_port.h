@@ -0,0 +1,9 @@
+#ifndef HOST_FAKE_NIMBLE_PORT_H
+#define HOST_FAKE_NIMBLE_PORT_H
+
+#include "esp_err.h"
+
+esp_err_t nimble_port_init(void);
+void nimble_port_run(void);
+
+#endif // HOST_FAKE_NIMBLE_PORT_H
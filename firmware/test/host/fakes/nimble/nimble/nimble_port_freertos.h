@@ -0,0 +1,11 @@
+#ifndef HOST_FAKE_NIMBLE_PORT_FREERTOS_H
+#define HOST_FAKE_NIMBLE_PORT_FREERTOS_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// The host task is not started; host_nimble_run() stands in for it
+void nimble_port_freertos_init(TaskFunction_t host_task_fn);
+void nimble_port_freertos_deinit(void);
+
+#endif // HOST_FAKE_NIMBLE_PORT_FREERTOS_H
@@ -0,0 +1,52 @@
+#include <stdlib.h>
+#include <string.h>
+#include "console_parse.h"
+#include "espnow_packet.h"
+
+// A console line as usb_serial_handler.c gets it, NUL-terminated, run
+// through the calls the handlers make on their arguments: the command
+// word, an integer, keywords, and the MAC and key of "espnow pair".
+
+// Longest line the USB task hands over, longer input is cut there
+#define FUZZ_LINE_MAX   512
+
+static char line[FUZZ_LINE_MAX + 1];
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    static bool initialized;
+    if (!initialized) {
+        console_parse_init();
+        initialized = true;
+    }
+
+    if (size > FUZZ_LINE_MAX) {
+        size = FUZZ_LINE_MAX;
+    }
+    memcpy(line, data, size);
+    line[size] = '\0';
+    const char *end = line + strlen(line);
+
+    usb_command_t cmd = console_parse_command(line);
+    if (cmd < CMD_RESET_ODOMETER || cmd > CMD_UNKNOWN) {
+        abort();
+    }
+
+    const char *arg = console_argument(line);
+    for (int depth = 0; arg != NULL && depth < 3; depth++) {
+        if (arg <= line || arg >= end) {
+            abort();
+        }
+        (void)console_parse_int(arg);
+        (void)console_argument_is(arg, "on");
+        (void)console_argument_is(arg, "reset");
+
+        uint8_t mac[ESPNOW_MAC_LEN];
+        uint8_t key[ESPNOW_KEY_LEN];
+        (void)console_parse_hex_bytes(arg, mac, sizeof(mac), ':');
+        (void)console_parse_hex_bytes(arg, key, sizeof(key), '\0');
+
+        arg = console_argument(arg);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// main() for a fuzz harness built without libFuzzer (gcc, or HOST_FUZZ
+// off): runs LLVMFuzzerTestOneInput once per file, for files and corpus
+// directories given on the command line, the way libFuzzer does with
+// -runs=0. With HOST_SANITIZE this is the corpus regression run.
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static unsigned long inputs;
+
+static int run_file(const char *path)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    // Exactly the input size, so ASan sees a read past the end. One byte
+    // for an empty input, which still needs a valid pointer.
+    uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+    if (data == NULL || fread(data, 1, (size_t)size, f) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", path);
+        fclose(f);
+        free(data);
+        return -1;
+    }
+    fclose(f);
+
+    LLVMFuzzerTestOneInput(data, (size_t)size);
+    free(data);
+    inputs++;
+    return 0;
+}
+
+static int run_path(const char *path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        perror(path);
+        return -1;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return run_file(path);
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        perror(path);
+        return -1;
+    }
+    int result = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        char child[4096];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (run_path(child) != 0) {
+            result = -1;
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    int result = 0;
+    for (int i = 1; i < argc; i++) {
+        if (run_path(argv[i]) != 0) {
+            result = 1;
+        }
+    }
+    printf("%lu inputs run\n", inputs);
+    return inputs > 0 ? result : 1;
+}
@@ -0,0 +1,54 @@
+#include <stdlib.h>
+#include <string.h>
+#include "telemetry_decode.h"
+#include "espnow_packet.h"
+
+// Telemetry as it comes off the air: the input is taken both as a BLE
+// notify (full or v2 frame) and as an ESP-NOW packet, whose TELEMETRY
+// payload goes to the same decoder like in espnow_link.c. An accepted frame
+// has to respect the cell count and survive an encode/decode round trip.
+
+static void check_frame(const uint8_t *data, size_t size)
+{
+    telemetry_snapshot_t first;
+    memset(&first, 0, sizeof(first));
+    if (!telemetry_decode_frame(data, size, &first)) {
+        return;
+    }
+    if (size != TELEMETRY_FRAME_LEN && size != TELEMETRY_SCHEMA_V2_LEN(first.bms_num_cells)) {
+        abort();
+    }
+    if (first.bms_num_cells > TELEMETRY_MAX_CELLS) {
+        abort();
+    }
+    for (int i = first.bms_num_cells; i < TELEMETRY_MAX_CELLS; i++) {
+        if (first.cell_mv[i] != 0) {
+            abort();
+        }
+    }
+
+    uint8_t frame[TELEMETRY_FRAME_LEN];
+    telemetry_snapshot_t second;
+    memset(&second, 0, sizeof(second));
+    telemetry_encode_frame(&first, frame);
+    if (!telemetry_decode_frame(frame, sizeof(frame), &second) || memcmp(&first, &second, sizeof(first)) != 0) {
+        abort();
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    check_frame(data, size);
+
+    espnow_packet_t packet;
+    if (espnow_packet_decode(data, size, &packet)) {
+        if (packet.payload_len > ESPNOW_PACKET_MAX_PAYLOAD ||
+            packet.payload + packet.payload_len != data + size) {
+            abort();
+        }
+        if (packet.type == ESPNOW_PACKET_TELEMETRY) {
+            check_frame(packet.payload, packet.payload_len);
+        }
+    }
+    return 0;
+}
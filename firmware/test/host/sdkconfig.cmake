@@ -0,0 +1,44 @@
+# Writes the sdkconfig.h of one firmware variant the way the IDF build
+# would: the project sdkconfig with the variant's defaults files laid on
+# top in order. "=y" becomes 1, "=n" and "is not set" leave the option
+# undefined, numbers and strings are copied as they are.
+function(host_sdkconfig_header output)
+    set(names "")
+    foreach(input ${ARGN})
+        file(STRINGS "${input}" lines)
+        foreach(line IN LISTS lines)
+            if(line MATCHES "^(CONFIG_[A-Za-z0-9_]+)=(.*)$")
+                set(name "${CMAKE_MATCH_1}")
+                set(value "${CMAKE_MATCH_2}")
+                if(value STREQUAL "y")
+                    set(value 1)
+                elseif(value STREQUAL "n")
+                    set(value "")
+                endif()
+            elseif(line MATCHES "^# (CONFIG_[A-Za-z0-9_]+) is not set")
+                set(name "${CMAKE_MATCH_1}")
+                set(value "")
+            else()
+                continue()
+            endif()
+            list(REMOVE_ITEM names "${name}")
+            if(NOT value STREQUAL "")
+                list(APPEND names "${name}")
+            endif()
+            set("value_${name}" "${value}")
+        endforeach()
+    endforeach()
+
+    set(sources "")
+    foreach(input ${ARGN})
+        get_filename_component(input_name "${input}" NAME)
+        string(APPEND sources " ${input_name}")
+    endforeach()
+    set(content "/* Generated by sdkconfig.cmake from${sources} */\n#pragma once\n")
+    foreach(name IN LISTS names)
+        string(APPEND content "#define ${name} ${value_${name}}\n")
+    endforeach()
+    file(WRITE "${output}.tmp" "${content}")
+    configure_file("${output}.tmp" "${output}" COPYONLY)
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${ARGN})
+endfunction()
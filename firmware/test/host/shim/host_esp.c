@@ -0,0 +1,558 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_heap_caps.h"
+#include "esp_system.h"
+#include "esp_bt.h"
+#include "esp_adc/adc_oneshot.h"
+#include "driver/gpio.h"
+#include "driver/uart.h"
+#include "esp_rom_sys.h"
+#include "perfmon.h"
+#include "host_shim.h"
+
+// Errors and logging
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                        return "ESP_OK";
+        case ESP_FAIL:                      return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:                return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:           return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE:         return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:          return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:             return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED:         return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT:               return "ESP_ERR_TIMEOUT";
+        case ESP_ERR_INVALID_RESPONSE:      return "ESP_ERR_INVALID_RESPONSE";
+        case ESP_ERR_INVALID_CRC:           return "ESP_ERR_INVALID_CRC";
+        case ESP_ERR_NVS_NOT_INITIALIZED:   return "ESP_ERR_NVS_NOT_INITIALIZED";
+        case ESP_ERR_NVS_NOT_FOUND:         return "ESP_ERR_NVS_NOT_FOUND";
+        case ESP_ERR_NVS_TYPE_MISMATCH:     return "ESP_ERR_NVS_TYPE_MISMATCH";
+        case ESP_ERR_NVS_INVALID_HANDLE:    return "ESP_ERR_NVS_INVALID_HANDLE";
+        case ESP_ERR_NVS_INVALID_LENGTH:    return "ESP_ERR_NVS_INVALID_LENGTH";
+        case ESP_ERR_NVS_NO_FREE_PAGES:     return "ESP_ERR_NVS_NO_FREE_PAGES";
+        case ESP_ERR_NVS_NEW_VERSION_FOUND: return "ESP_ERR_NVS_NEW_VERSION_FOUND";
+        default:                            return "UNKNOWN ERROR";
+    }
+}
+
+void host_error_check_failed(esp_err_t rc, const char *file, int line, const char *expression)
+{
+    fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\nexpression: %s\n",
+            rc, esp_err_to_name(rc), file, line, expression);
+    abort();
+}
+
+#define LOG_MAX_TAGS 32
+
+typedef struct {
+    const char *tag;
+    esp_log_level_t level;
+} log_tag_level_t;
+
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static log_tag_level_t tag_levels[LOG_MAX_TAGS];
+static int tag_level_count = 0;
+static int default_level = -1;
+
+static esp_log_level_t level_of(const char *tag)
+{
+    if (default_level < 0) {
+        const char *env = getenv("HOST_LOG_LEVEL");
+        default_level = env != NULL ? atoi(env) : ESP_LOG_WARN;
+    }
+    for (int i = 0; i < tag_level_count; i++) {
+        if (strcmp(tag_levels[i].tag, tag) == 0) {
+            return tag_levels[i].level;
+        }
+    }
+    return (esp_log_level_t)default_level;
+}
+
+void esp_log_level_set(const char *tag, esp_log_level_t level)
+{
+    pthread_mutex_lock(&log_lock);
+    if (strcmp(tag, "*") == 0) {
+        default_level = level;
+        tag_level_count = 0;
+    } else {
+        int i = 0;
+        while (i < tag_level_count && strcmp(tag_levels[i].tag, tag) != 0) {
+            i++;
+        }
+        if (i < LOG_MAX_TAGS) {
+            tag_levels[i].tag = tag;
+            tag_levels[i].level = level;
+            tag_level_count += i == tag_level_count;
+        }
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+esp_log_level_t esp_log_level_get(const char *tag)
+{
+    pthread_mutex_lock(&log_lock);
+    esp_log_level_t level = level_of(tag);
+    pthread_mutex_unlock(&log_lock);
+    return level;
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    pthread_mutex_lock(&log_lock);
+    if (level <= level_of(tag)) {
+        va_list args;
+        va_start(args, format);
+        vfprintf(stderr, format, args);
+        va_end(args);
+    }
+    pthread_mutex_unlock(&log_lock);
+}
+
+// Random numbers, xorshift32 so a seed repeats a run
+
+static uint32_t random_state = 0x2545F491;
+static pthread_mutex_t random_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void host_random_seed(uint32_t seed)
+{
+    pthread_mutex_lock(&random_lock);
+    random_state = seed != 0 ? seed : 0x2545F491;
+    pthread_mutex_unlock(&random_lock);
+}
+
+uint32_t esp_random(void)
+{
+    pthread_mutex_lock(&random_lock);
+    uint32_t x = random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random_state = x;
+    pthread_mutex_unlock(&random_lock);
+    return x;
+}
+
+void esp_fill_random(void *buffer, size_t length)
+{
+    uint8_t *out = buffer;
+    while (length > 0) {
+        uint32_t word = esp_random();
+        size_t n = length < sizeof(word) ? length : sizeof(word);
+        memcpy(out, &word, n);
+        out += n;
+        length -= n;
+    }
+}
+
+// ROM CRC. The _le variants take and return the CRC inverted, like the ROM.
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buffer, uint32_t length)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= buffer[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t *buffer, uint32_t length)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= buffer[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0x8408 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+// Heap capabilities, all on the C heap
+
+#define HOST_FREE_HEAP      (300 * 1024)
+#define HOST_FREE_PSRAM     (8 * 1024 * 1024)
+
+static bool fail_psram = false;
+static size_t largest_block = 0;
+static uint32_t live_blocks = 0;
+
+void host_heap_caps_fail_psram(bool fail)
+{
+    fail_psram = fail;
+}
+
+void host_heap_caps_set_largest_block(size_t bytes)
+{
+    largest_block = bytes;
+}
+
+uint32_t host_heap_caps_live_blocks(void)
+{
+    return live_blocks;
+}
+
+static bool refused(size_t size, uint32_t caps)
+{
+    return (fail_psram && (caps & MALLOC_CAP_SPIRAM)) || (largest_block != 0 && size > largest_block);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+    if (refused(size, caps)) {
+        return NULL;
+    }
+    void *ptr = malloc(size);
+    live_blocks += ptr != NULL;
+    return ptr;
+}
+
+void *heap_caps_calloc(size_t count, size_t size, uint32_t caps)
+{
+    if (refused(count * size, caps)) {
+        return NULL;
+    }
+    void *ptr = calloc(count, size);
+    live_blocks += ptr != NULL;
+    return ptr;
+}
+
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps)
+{
+    if (refused(size, caps)) {
+        return NULL;
+    }
+    void *resized = realloc(ptr, size);
+    live_blocks += ptr == NULL && resized != NULL;
+    return resized;
+}
+
+void heap_caps_free(void *ptr)
+{
+    live_blocks -= ptr != NULL;
+    free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+    if (caps & MALLOC_CAP_SPIRAM) {
+        return fail_psram ? 0 : HOST_FREE_PSRAM;
+    }
+    return HOST_FREE_HEAP;
+}
+
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+    return heap_caps_get_free_size(caps);
+}
+
+// System
+
+static uint32_t restarts = 0;
+static void (*restart_hook)(void) = NULL;
+
+void esp_restart(void)
+{
+    __atomic_add_fetch(&restarts, 1, __ATOMIC_RELAXED);
+    if (restart_hook != NULL) {
+        restart_hook();
+    }
+}
+
+uint32_t host_restart_count(void)
+{
+    return __atomic_load_n(&restarts, __ATOMIC_RELAXED);
+}
+
+void host_set_restart_hook(void (*hook)(void))
+{
+    restart_hook = hook;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return HOST_FREE_HEAP;
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+    return HOST_FREE_HEAP;
+}
+
+// Bluetooth controller TX power
+
+static esp_power_level_t tx_power[ESP_BLE_PWR_TYPE_NUM] = {
+    [0 ... ESP_BLE_PWR_TYPE_NUM - 1] = ESP_PWR_LVL_INVALID,
+};
+
+esp_err_t esp_ble_tx_power_set(esp_ble_power_type_t power_type, esp_power_level_t power_level)
+{
+    if (power_type >= ESP_BLE_PWR_TYPE_NUM || power_level > ESP_PWR_LVL_P20) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_store_n(&tx_power[power_type], power_level, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_power_level_t esp_ble_tx_power_get(esp_ble_power_type_t power_type)
+{
+    if (power_type >= ESP_BLE_PWR_TYPE_NUM) {
+        return ESP_PWR_LVL_INVALID;
+    }
+    esp_power_level_t level = __atomic_load_n(&tx_power[power_type], __ATOMIC_RELAXED);
+    return level == ESP_PWR_LVL_INVALID ? ESP_PWR_LVL_P9 : level;
+}
+
+esp_power_level_t host_bt_tx_power(esp_ble_power_type_t power_type)
+{
+    return power_type < ESP_BLE_PWR_TYPE_NUM ? __atomic_load_n(&tx_power[power_type], __ATOMIC_RELAXED)
+                                             : ESP_PWR_LVL_INVALID;
+}
+
+// GPIO
+
+static int gpio_inputs[GPIO_NUM_MAX];
+static int gpio_outputs[GPIO_NUM_MAX];
+
+esp_err_t gpio_config(const gpio_config_t *config)
+{
+    if (config == NULL || config->pin_bit_mask == 0 || (config->pin_bit_mask >> GPIO_NUM_MAX) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_store_n(&gpio_outputs[gpio_num], level != 0, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num)
+{
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) {
+        return 0;
+    }
+    return __atomic_load_n(&gpio_inputs[gpio_num], __ATOMIC_RELAXED);
+}
+
+esp_err_t gpio_hold_en(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t gpio_hold_dis(gpio_num_t gpio_num)
+{
+    return gpio_hold_en(gpio_num);
+}
+
+void host_gpio_set_input(gpio_num_t gpio_num, int level)
+{
+    if (gpio_num >= 0 && gpio_num < GPIO_NUM_MAX) {
+        __atomic_store_n(&gpio_inputs[gpio_num], level != 0, __ATOMIC_RELAXED);
+    }
+}
+
+int host_gpio_output(gpio_num_t gpio_num)
+{
+    return gpio_num >= 0 && gpio_num < GPIO_NUM_MAX ? __atomic_load_n(&gpio_outputs[gpio_num], __ATOMIC_RELAXED) : 0;
+}
+
+// ADC one-shot
+
+struct host_adc_unit {
+    adc_unit_t unit;
+};
+
+static int adc_raw[ADC_CHANNEL_COUNT];
+static uint32_t adc_read_count[ADC_CHANNEL_COUNT];
+static host_adc_source_t adc_source = NULL;
+static void *adc_source_ctx = NULL;
+
+void host_adc_set_raw(adc_channel_t channel, int raw)
+{
+    if (channel < ADC_CHANNEL_COUNT) {
+        __atomic_store_n(&adc_raw[channel], raw, __ATOMIC_RELAXED);
+    }
+}
+
+void host_adc_set_source(host_adc_source_t source, void *ctx)
+{
+    adc_source_ctx = ctx;
+    __atomic_store_n(&adc_source, source, __ATOMIC_RELEASE);
+}
+
+uint32_t host_adc_reads(adc_channel_t channel)
+{
+    return channel < ADC_CHANNEL_COUNT ? __atomic_load_n(&adc_read_count[channel], __ATOMIC_RELAXED) : 0;
+}
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *config, adc_oneshot_unit_handle_t *out_handle)
+{
+    if (config == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct host_adc_unit *unit = calloc(1, sizeof(*unit));
+    if (unit == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    unit->unit = config->unit_id;
+    *out_handle = unit;
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel,
+                                     const adc_oneshot_chan_cfg_t *config)
+{
+    if (handle == NULL || channel >= ADC_CHANNEL_COUNT || config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t channel, int *out_raw)
+{
+    if (handle == NULL || channel >= ADC_CHANNEL_COUNT || out_raw == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    __atomic_add_fetch(&adc_read_count[channel], 1, __ATOMIC_RELAXED);
+    host_adc_source_t source = __atomic_load_n(&adc_source, __ATOMIC_ACQUIRE);
+    *out_raw = source != NULL ? source(channel, adc_source_ctx) : __atomic_load_n(&adc_raw[channel], __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle)
+{
+    if (handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    free(handle);
+    return ESP_OK;
+}
+
+// UART, installed but silent
+
+esp_err_t uart_driver_install(uart_port_t port, int rx_buffer_size, int tx_buffer_size, int queue_size,
+                              QueueHandle_t *out_queue, int intr_alloc_flags)
+{
+    (void)port;
+    (void)rx_buffer_size;
+    (void)tx_buffer_size;
+    (void)intr_alloc_flags;
+    if (out_queue != NULL) {
+        *out_queue = xQueueCreate(queue_size > 0 ? queue_size : 1, sizeof(uart_event_t));
+    }
+    return ESP_OK;
+}
+
+esp_err_t uart_param_config(uart_port_t port, const uart_config_t *config)
+{
+    (void)port;
+    return config != NULL ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t uart_set_pin(uart_port_t port, int tx, int rx, int rts, int cts)
+{
+    (void)port;
+    (void)tx;
+    (void)rx;
+    (void)rts;
+    (void)cts;
+    return ESP_OK;
+}
+
+int uart_read_bytes(uart_port_t port, void *buffer, uint32_t length, TickType_t ticks)
+{
+    (void)port;
+    (void)buffer;
+    (void)length;
+    (void)ticks;
+    return 0;
+}
+
+// ROM delay: sleeps with the real clock, returns at once with the virtual
+// one where nothing would ever move the time it spins on
+
+void esp_rom_delay_us(uint32_t us)
+{
+    if (host_clock_mode() == HOST_CLOCK_REAL) {
+        struct timespec ts = { .tv_sec = us / 1000000, .tv_nsec = (long)(us % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+// Performance counters, nanoseconds of CLOCK_MONOTONIC while started
+
+#define PERFMON_COUNTERS 4
+
+static uint64_t perfmon_total_ns[PERFMON_COUNTERS];
+static uint64_t perfmon_started_ns;
+static bool perfmon_running;
+
+esp_err_t xtensa_perfmon_init(int id, uint16_t select, uint16_t mask, int kernelcnt, int tracelevel)
+{
+    (void)select; (void)mask; (void)kernelcnt; (void)tracelevel;
+    return id >= 0 && id < PERFMON_COUNTERS ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t xtensa_perfmon_reset(int id)
+{
+    if (id < 0 || id >= PERFMON_COUNTERS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    perfmon_total_ns[id] = 0;
+    if (perfmon_running) {
+        perfmon_started_ns = host_time_ns();
+    }
+    return ESP_OK;
+}
+
+void xtensa_perfmon_start(void)
+{
+    perfmon_started_ns = host_time_ns();
+    perfmon_running = true;
+}
+
+void xtensa_perfmon_stop(void)
+{
+    if (!perfmon_running) {
+        return;
+    }
+    uint64_t elapsed = host_time_ns() - perfmon_started_ns;
+    for (int i = 0; i < PERFMON_COUNTERS; i++) {
+        perfmon_total_ns[i] += elapsed;
+    }
+    perfmon_running = false;
+}
+
+uint32_t xtensa_perfmon_value(int id)
+{
+    if (id < 0 || id >= PERFMON_COUNTERS) {
+        return 0;
+    }
+    uint64_t value = perfmon_total_ns[id];
+    if (perfmon_running) {
+        value += host_time_ns() - perfmon_started_ns;
+    }
+    return (uint32_t)value;
+}
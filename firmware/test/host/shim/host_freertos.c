@@ -0,0 +1,719 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "host_shim.h"
+
+#define TAG "HOST_RTOS"
+
+#define TICK_US         (1000000 / configTICK_RATE_HZ)
+#define NO_DEADLINE     INT64_MAX
+
+// Every shim object is guarded by sched_lock. A task that cannot go on
+// puts a waiter on the list and sleeps on wake_cond; whoever changes state
+// re-evaluates the waiters and marks the ready ones woken before
+// broadcasting, so a woken task counts as running from that moment. That
+// count is what host_clock_advance_us waits on in the virtual mode.
+
+typedef bool (*ready_fn_t)(void *ctx);
+
+typedef struct waiter {
+    ready_fn_t ready;               // NULL for a plain delay
+    void *ctx;
+    int64_t deadline_us;
+    bool task;                      // Counted in running
+    bool woken;
+    bool timed_out;
+    struct waiter *next;
+} waiter_t;
+
+struct host_task {
+    TaskFunction_t function;
+    void *arg;
+    char name[16];
+    uint32_t notify;
+    eTaskState state;
+    struct host_task *next;         // All tasks ever created, see tasks
+};
+
+struct host_queue {
+    uint8_t *items;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct host_semaphore {
+    UBaseType_t count;
+    UBaseType_t max_count;
+};
+
+struct host_esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    uint64_t period_us;
+    int64_t next_us;
+    bool active;
+    bool task_started;
+};
+
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake_cond;
+static pthread_cond_t idle_cond = PTHREAD_COND_INITIALIZER;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static waiter_t *waiters = NULL;
+static int running = 0;
+
+static host_clock_mode_t clock_mode = HOST_CLOCK_REAL;
+static int64_t virtual_now_us = 0;
+static struct timespec real_start;
+
+static __thread struct host_task *current_task = NULL;
+// Stands in for the task handle of threads the shim did not start
+static struct host_task outside_task = { .name = "main" };
+// Handles are never freed, other tasks may still hold them after a delete
+static struct host_task *tasks;
+
+static void init(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wake_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    clock_gettime(CLOCK_MONOTONIC, &real_start);
+}
+
+static void lock(void)
+{
+    pthread_once(&init_once, init);
+    pthread_mutex_lock(&sched_lock);
+}
+
+static void unlock(void)
+{
+    pthread_mutex_unlock(&sched_lock);
+}
+
+uint64_t host_time_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static int64_t now_us(void)
+{
+    if (clock_mode == HOST_CLOCK_VIRTUAL) {
+        return __atomic_load_n(&virtual_now_us, __ATOMIC_ACQUIRE);
+    }
+    pthread_once(&init_once, init);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)(now.tv_sec - real_start.tv_sec) * 1000000 + (now.tv_nsec - real_start.tv_nsec) / 1000;
+}
+
+static struct timespec real_deadline(int64_t deadline_us)
+{
+    struct timespec ts = real_start;
+    ts.tv_sec += deadline_us / 1000000;
+    ts.tv_nsec += (deadline_us % 1000000) * 1000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+static int64_t deadline_after(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? NO_DEADLINE : now_us() + (int64_t)ticks * TICK_US;
+}
+
+static void set_running(int delta)
+{
+    running += delta;
+    if (running == 0) {
+        pthread_cond_broadcast(&idle_cond);
+    }
+}
+
+static void unlink_waiter(waiter_t *w)
+{
+    for (waiter_t **p = &waiters; *p != NULL; p = &(*p)->next) {
+        if (*p == w) {
+            *p = w->next;
+            return;
+        }
+    }
+}
+
+static void wake_waiter(waiter_t *w, bool timed_out)
+{
+    unlink_waiter(w);
+    w->woken = true;
+    w->timed_out = timed_out;
+    if (w->task) {
+        set_running(1);
+    }
+}
+
+// Locked. Called after anything a waiter may be waiting for changed.
+static void wake_ready(void)
+{
+    int64_t now = now_us();
+    waiter_t *w = waiters;
+    while (w != NULL) {
+        waiter_t *next = w->next;
+        if (w->ready != NULL && w->ready(w->ctx)) {
+            wake_waiter(w, false);
+        } else if (clock_mode == HOST_CLOCK_VIRTUAL && now >= w->deadline_us) {
+            wake_waiter(w, true);
+        }
+        w = next;
+    }
+    pthread_cond_broadcast(&wake_cond);
+}
+
+// Locked. True once ready, false when the deadline passes first.
+static bool wait_until(ready_fn_t ready, void *ctx, int64_t deadline_us)
+{
+    while (ready == NULL || !ready(ctx)) {
+        if (now_us() >= deadline_us) {
+            return false;
+        }
+
+        waiter_t w = {
+            .ready = ready,
+            .ctx = ctx,
+            .deadline_us = deadline_us,
+            .task = current_task != NULL,
+        };
+        w.next = waiters;
+        waiters = &w;
+        if (w.task) {
+            current_task->state = eBlocked;
+            set_running(-1);
+        }
+
+        while (!w.woken) {
+            if (clock_mode == HOST_CLOCK_REAL && deadline_us != NO_DEADLINE) {
+                struct timespec ts = real_deadline(deadline_us);
+                if (pthread_cond_timedwait(&wake_cond, &sched_lock, &ts) == ETIMEDOUT && !w.woken) {
+                    wake_waiter(&w, true);
+                }
+            } else {
+                pthread_cond_wait(&wake_cond, &sched_lock);
+            }
+        }
+        if (w.task) {
+            current_task->state = eRunning;
+        }
+        if (w.timed_out) {
+            return ready != NULL && ready(ctx);
+        }
+    }
+    return true;
+}
+
+void host_clock_set_mode(host_clock_mode_t mode)
+{
+    lock();
+    clock_mode = mode;
+    __atomic_store_n(&virtual_now_us, 0, __ATOMIC_RELEASE);
+    unlock();
+}
+
+host_clock_mode_t host_clock_mode(void)
+{
+    return clock_mode;
+}
+
+static void wait_idle_locked(void)
+{
+    while (running > 0) {
+        pthread_cond_wait(&idle_cond, &sched_lock);
+    }
+}
+
+void host_wait_idle(void)
+{
+    lock();
+    if (clock_mode == HOST_CLOCK_VIRTUAL) {
+        wait_idle_locked();
+    }
+    unlock();
+}
+
+void host_clock_advance_us(int64_t us)
+{
+    lock();
+    if (clock_mode != HOST_CLOCK_VIRTUAL) {
+        unlock();
+        ESP_LOGE(TAG, "host_clock_advance_us needs the virtual clock");
+        abort();
+    }
+
+    wait_idle_locked();
+    int64_t target = virtual_now_us + us;
+    for (;;) {
+        int64_t next = target;
+        for (waiter_t *w = waiters; w != NULL; w = w->next) {
+            if (w->deadline_us < next) {
+                next = w->deadline_us;
+            }
+        }
+        if (next > virtual_now_us) {
+            __atomic_store_n(&virtual_now_us, next, __ATOMIC_RELEASE);
+        }
+        wake_ready();
+        wait_idle_locked();
+        if (next >= target) {
+            break;
+        }
+    }
+    unlock();
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us();
+}
+
+// Tasks
+
+static void *task_entry(void *arg)
+{
+    struct host_task *task = arg;
+    current_task = task;
+    task->function(task->arg);
+    // Returning from a task function is a bug on target, here it ends the task
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *out_handle,
+                                   BaseType_t core)
+{
+    (void)stack_depth;
+    (void)priority;
+    (void)core;
+
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->function = function;
+    task->arg = arg;
+    strncpy(task->name, name != NULL ? name : "", sizeof(task->name) - 1);
+
+    lock();
+    set_running(1);
+    task->next = tasks;
+    tasks = task;
+    unlock();
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    pthread_t thread;
+    int err = pthread_create(&thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        lock();
+        set_running(-1);
+        for (struct host_task **link = &tasks; *link != NULL; link = &(*link)->next) {
+            if (*link == task) {
+                *link = task->next;
+                break;
+            }
+        }
+        unlock();
+        free(task);
+        return pdFAIL;
+    }
+
+    if (out_handle != NULL) {
+        *out_handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *out_handle)
+{
+    return xTaskCreatePinnedToCore(function, name, stack_depth, arg, priority, out_handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task != NULL && task != current_task) {
+        ESP_LOGE(TAG, "Deleting another task is not supported on the host");
+        abort();
+    }
+    if (current_task == NULL) {
+        ESP_LOGE(TAG, "vTaskDelete(NULL) outside a task");
+        abort();
+    }
+
+    lock();
+    current_task->state = eDeleted;
+    set_running(-1);
+    unlock();
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    lock();
+    wait_until(NULL, NULL, now_us() + (int64_t)ticks * TICK_US);
+    unlock();
+}
+
+void vTaskDelayUntil(TickType_t *previous_wake, TickType_t increment)
+{
+    *previous_wake += increment;
+    lock();
+    wait_until(NULL, NULL, (int64_t)*previous_wake * TICK_US);
+    unlock();
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us() / TICK_US);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task != NULL ? current_task : &outside_task;
+}
+
+const char *pcTaskGetName(TaskHandle_t task)
+{
+    return (task != NULL ? task : xTaskGetCurrentTaskHandle())->name;
+}
+
+// Running for the caller, blocked or deleted as last seen, else ready
+eTaskState eTaskGetState(TaskHandle_t task)
+{
+    if (task == xTaskGetCurrentTaskHandle()) {
+        return eRunning;
+    }
+    lock();
+    eTaskState state = task->state == eRunning ? eReady : task->state;
+    unlock();
+    return state;
+}
+
+static bool notified(void *ctx)
+{
+    return ((struct host_task *)ctx)->notify > 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    lock();
+    task->notify++;
+    wake_ready();
+    unlock();
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    lock();
+    wait_until(notified, task, deadline_after(ticks));
+    uint32_t value = task->notify;
+    if (value > 0) {
+        task->notify = clear_on_exit ? 0 : value - 1;
+    }
+    unlock();
+    return value;
+}
+
+// Queues
+
+static bool queue_has_item(void *ctx)
+{
+    return ((struct host_queue *)ctx)->count > 0;
+}
+
+static bool queue_has_space(void *ctx)
+{
+    struct host_queue *queue = ctx;
+    return queue->count < queue->length;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+    if (queue == NULL) {
+        return NULL;
+    }
+    queue->items = calloc(length, item_size);
+    if (queue->items == NULL) {
+        free(queue);
+        return NULL;
+    }
+    queue->length = length;
+    queue->item_size = item_size;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    if (queue != NULL) {
+        free(queue->items);
+        free(queue);
+    }
+}
+
+static BaseType_t queue_send(QueueHandle_t queue, const void *item, TickType_t ticks, bool front)
+{
+    lock();
+    if (!wait_until(queue_has_space, queue, deadline_after(ticks))) {
+        unlock();
+        return errQUEUE_FULL;
+    }
+    UBaseType_t slot;
+    if (front) {
+        queue->head = (queue->head + queue->length - 1) % queue->length;
+        slot = queue->head;
+    } else {
+        slot = (queue->head + queue->count) % queue->length;
+    }
+    memcpy(queue->items + slot * queue->item_size, item, queue->item_size);
+    queue->count++;
+    wake_ready();
+    unlock();
+    return pdPASS;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, false);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+    return queue_send(queue, item, ticks, true);
+}
+
+static BaseType_t queue_receive(QueueHandle_t queue, void *item, TickType_t ticks, bool remove)
+{
+    lock();
+    if (!wait_until(queue_has_item, queue, deadline_after(ticks))) {
+        unlock();
+        return pdFALSE;
+    }
+    memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+    if (remove) {
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        wake_ready();
+    }
+    unlock();
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queue_receive(queue, item, ticks, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+    return queue_receive(queue, item, ticks, false);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item)
+{
+    lock();
+    if (queue->count == 0) {
+        queue->count = 1;
+    }
+    memcpy(queue->items + queue->head * queue->item_size, item, queue->item_size);
+    wake_ready();
+    unlock();
+    return pdPASS;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+    lock();
+    queue->head = 0;
+    queue->count = 0;
+    wake_ready();
+    unlock();
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    lock();
+    UBaseType_t count = queue->count;
+    unlock();
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue)
+{
+    lock();
+    UBaseType_t spaces = queue->length - queue->count;
+    unlock();
+    return spaces;
+}
+
+// Semaphores
+
+static bool semaphore_available(void *ctx)
+{
+    return ((struct host_semaphore *)ctx)->count > 0;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    struct host_semaphore *semaphore = calloc(1, sizeof(*semaphore));
+    if (semaphore != NULL) {
+        semaphore->max_count = max_count;
+        semaphore->count = initial_count;
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xSemaphoreCreateCounting(1, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore)
+{
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks)
+{
+    lock();
+    bool taken = wait_until(semaphore_available, semaphore, deadline_after(ticks));
+    if (taken) {
+        semaphore->count--;
+    }
+    unlock();
+    return taken ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    lock();
+    if (semaphore->count >= semaphore->max_count) {
+        unlock();
+        return pdFALSE;
+    }
+    semaphore->count++;
+    wake_ready();
+    unlock();
+    return pdTRUE;
+}
+
+// esp_timer, each timer on a task of its own
+
+static bool timer_active(void *ctx)
+{
+    return ((struct host_esp_timer *)ctx)->active;
+}
+
+static bool timer_stopped(void *ctx)
+{
+    return !timer_active(ctx);
+}
+
+static void timer_task(void *arg)
+{
+    struct host_esp_timer *timer = arg;
+    lock();
+    for (;;) {
+        if (!timer->active) {
+            wait_until(timer_active, timer, NO_DEADLINE);
+            continue;
+        }
+        // Stopped before the deadline: back to waiting for a start
+        if (wait_until(timer_stopped, timer, timer->next_us)) {
+            continue;
+        }
+        timer->next_us += (int64_t)timer->period_us;
+        unlock();
+        timer->callback(timer->arg);
+        lock();
+    }
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    if (args == NULL || args->callback == NULL || out_handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    struct host_esp_timer *timer = calloc(1, sizeof(*timer));
+    if (timer == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->name = args->name;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    if (timer == NULL || period_us == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    lock();
+    if (timer->active) {
+        unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->period_us = period_us;
+    timer->next_us = now_us() + (int64_t)period_us;
+    timer->active = true;
+    bool start_task = !timer->task_started;
+    timer->task_started = true;
+    wake_ready();
+    unlock();
+
+    if (start_task && xTaskCreate(timer_task, timer->name, 4096, timer, 20, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (timer == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    lock();
+    if (!timer->active) {
+        unlock();
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    wake_ready();
+    unlock();
+    return ESP_OK;
+}
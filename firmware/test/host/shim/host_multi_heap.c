@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <string.h>
+#include "multi_heap.h"
+#include "freertos/FreeRTOS.h"
+
+// Blocks tile the heap from start to end, each behind an 8-byte header
+// with its size and the size of the block before it, so a free can merge
+// with both neighbours. Sizes are multiples of 8 and bit 0 marks a block
+// in use.
+
+#define ALIGN           8
+#define HEADER_SIZE     sizeof(block_header_t)
+#define MIN_BLOCK       (HEADER_SIZE + ALIGN)
+#define USED            1u
+
+typedef struct {
+    uint32_t size;                  // Header included, USED in bit 0
+    uint32_t prev_size;             // 0 for the first block
+} block_header_t;
+
+struct host_multi_heap {
+    uint8_t *start;
+    uint8_t *end;
+    portMUX_TYPE *lock;
+    size_t free_bytes;
+    size_t minimum_free_bytes;
+};
+
+static uint32_t block_size(const block_header_t *block)
+{
+    return block->size & ~USED;
+}
+
+static bool block_used(const block_header_t *block)
+{
+    return block->size & USED;
+}
+
+static block_header_t *next_block(struct host_multi_heap *heap, block_header_t *block)
+{
+    uint8_t *next = (uint8_t *)block + block_size(block);
+    return next < heap->end ? (block_header_t *)next : NULL;
+}
+
+static block_header_t *prev_block(block_header_t *block)
+{
+    return block->prev_size != 0 ? (block_header_t *)((uint8_t *)block - block->prev_size) : NULL;
+}
+
+static void lock(struct host_multi_heap *heap)
+{
+    if (heap->lock != NULL) {
+        portENTER_CRITICAL(heap->lock);
+    }
+}
+
+static void unlock(struct host_multi_heap *heap)
+{
+    if (heap->lock != NULL) {
+        portEXIT_CRITICAL(heap->lock);
+    }
+}
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size)
+{
+    uintptr_t first = ((uintptr_t)start + ALIGN - 1) & ~(uintptr_t)(ALIGN - 1);
+    uintptr_t heap_start = (first + sizeof(struct host_multi_heap) + ALIGN - 1) & ~(uintptr_t)(ALIGN - 1);
+    uintptr_t end = ((uintptr_t)start + size) & ~(uintptr_t)(ALIGN - 1);
+    if (start == NULL || end <= heap_start + MIN_BLOCK || end - heap_start > UINT32_MAX) {
+        return NULL;
+    }
+
+    struct host_multi_heap *heap = (struct host_multi_heap *)first;
+    heap->start = (uint8_t *)heap_start;
+    heap->end = (uint8_t *)end;
+    heap->lock = NULL;
+
+    block_header_t *block = (block_header_t *)heap->start;
+    block->size = (uint32_t)(end - heap_start);
+    block->prev_size = 0;
+    heap->free_bytes = block_size(block) - HEADER_SIZE;
+    heap->minimum_free_bytes = heap->free_bytes;
+    return heap;
+}
+
+void multi_heap_set_lock(multi_heap_handle_t heap, void *lock)
+{
+    heap->lock = lock;
+}
+
+// Locked. Folds next into block, both free.
+static void merge_next(struct host_multi_heap *heap, block_header_t *block)
+{
+    block_header_t *next = next_block(heap, block);
+    if (next == NULL || block_used(next)) {
+        return;
+    }
+    block->size += block_size(next);
+    block_header_t *after = next_block(heap, block);
+    if (after != NULL) {
+        after->prev_size = block_size(block);
+    }
+    heap->free_bytes += HEADER_SIZE;
+}
+
+// Locked. Cuts the tail of a block off as a free block when it is big
+// enough to hold one.
+static void split(struct host_multi_heap *heap, block_header_t *block, uint32_t size)
+{
+    uint32_t rest = block_size(block) - size;
+    if (rest < MIN_BLOCK) {
+        return;
+    }
+    bool used = block_used(block);
+    block->size = size | (used ? USED : 0);
+    if (used) {
+        heap->free_bytes += rest - HEADER_SIZE;
+    } else {
+        heap->free_bytes -= HEADER_SIZE;
+    }
+
+    block_header_t *tail = (block_header_t *)((uint8_t *)block + size);
+    tail->size = rest;
+    tail->prev_size = size;
+    block_header_t *after = next_block(heap, tail);
+    if (after != NULL) {
+        after->prev_size = rest;
+        merge_next(heap, tail);
+    }
+}
+
+static uint32_t needed_size(size_t size)
+{
+    if (size == 0 || size > UINT32_MAX - HEADER_SIZE - ALIGN) {
+        return 0;
+    }
+    uint32_t total = (uint32_t)((size + HEADER_SIZE + ALIGN - 1) & ~(size_t)(ALIGN - 1));
+    return total < MIN_BLOCK ? MIN_BLOCK : total;
+}
+
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size)
+{
+    uint32_t need = needed_size(size);
+    if (heap == NULL || need == 0) {
+        return NULL;
+    }
+
+    lock(heap);
+    for (block_header_t *block = (block_header_t *)heap->start; block != NULL; block = next_block(heap, block)) {
+        if (block_used(block) || block_size(block) < need) {
+            continue;
+        }
+        split(heap, block, need);
+        block->size |= USED;
+        heap->free_bytes -= block_size(block) - HEADER_SIZE;
+        if (heap->free_bytes < heap->minimum_free_bytes) {
+            heap->minimum_free_bytes = heap->free_bytes;
+        }
+        unlock(heap);
+        return (uint8_t *)block + HEADER_SIZE;
+    }
+    unlock(heap);
+    return NULL;
+}
+
+void multi_heap_free(multi_heap_handle_t heap, void *ptr)
+{
+    if (heap == NULL || ptr == NULL) {
+        return;
+    }
+
+    lock(heap);
+    block_header_t *block = (block_header_t *)((uint8_t *)ptr - HEADER_SIZE);
+    block->size &= ~USED;
+    heap->free_bytes += block_size(block) - HEADER_SIZE;
+    merge_next(heap, block);
+    block_header_t *prev = prev_block(block);
+    if (prev != NULL && !block_used(prev)) {
+        merge_next(heap, prev);
+    }
+    unlock(heap);
+}
+
+size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *ptr)
+{
+    (void)heap;
+    if (ptr == NULL) {
+        return 0;
+    }
+    const block_header_t *block = (const block_header_t *)((uint8_t *)ptr - HEADER_SIZE);
+    return block_size(block) - HEADER_SIZE;
+}
+
+void *multi_heap_realloc(multi_heap_handle_t heap, void *ptr, size_t size)
+{
+    if (ptr == NULL) {
+        return multi_heap_malloc(heap, size);
+    }
+    if (size == 0) {
+        multi_heap_free(heap, ptr);
+        return NULL;
+    }
+    uint32_t need = needed_size(size);
+    if (need == 0) {
+        return NULL;
+    }
+
+    lock(heap);
+    block_header_t *block = (block_header_t *)((uint8_t *)ptr - HEADER_SIZE);
+    block_header_t *next = next_block(heap, block);
+    uint32_t available = block_size(block);
+    if (next != NULL && !block_used(next)) {
+        available += block_size(next);
+    }
+    if (available >= need) {
+        // In place, taking in the free block after it if needed
+        if (block_size(block) < need) {
+            heap->free_bytes -= block_size(next) - HEADER_SIZE;
+            block->size += block_size(next);
+            block_header_t *after = next_block(heap, block);
+            if (after != NULL) {
+                after->prev_size = block_size(block);
+            }
+        }
+        split(heap, block, need);
+        if (heap->free_bytes < heap->minimum_free_bytes) {
+            heap->minimum_free_bytes = heap->free_bytes;
+        }
+        unlock(heap);
+        return ptr;
+    }
+    unlock(heap);
+
+    void *moved = multi_heap_malloc(heap, size);
+    if (moved != NULL) {
+        memcpy(moved, ptr, block_size(block) - HEADER_SIZE);
+        multi_heap_free(heap, ptr);
+    }
+    return moved;
+}
+
+size_t multi_heap_free_size(multi_heap_handle_t heap)
+{
+    return heap->free_bytes;
+}
+
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap)
+{
+    return heap->minimum_free_bytes;
+}
+
+void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    lock(heap);
+    for (block_header_t *block = (block_header_t *)heap->start; block != NULL; block = next_block(heap, block)) {
+        size_t payload = block_size(block) - HEADER_SIZE;
+        info->total_blocks++;
+        if (block_used(block)) {
+            info->allocated_blocks++;
+            info->total_allocated_bytes += payload;
+        } else {
+            info->free_blocks++;
+            info->total_free_bytes += payload;
+            if (payload > info->largest_free_block) {
+                info->largest_free_block = payload;
+            }
+        }
+    }
+    info->minimum_free_bytes = heap->minimum_free_bytes;
+    unlock(heap);
+}
+
+bool multi_heap_check(multi_heap_handle_t heap, bool print_errors)
+{
+    bool ok = true;
+    size_t free_bytes = 0;
+    uint32_t prev_size = 0;
+    bool prev_free = false;
+
+    lock(heap);
+    block_header_t *block = (block_header_t *)heap->start;
+    uint8_t *p = heap->start;
+    while (p < heap->end) {
+        block = (block_header_t *)p;
+        uint32_t size = block_size(block);
+        if (size < MIN_BLOCK || size % ALIGN != 0 || p + size > heap->end || block->prev_size != prev_size) {
+            ok = false;
+            break;
+        }
+        if (!block_used(block)) {
+            // Two free blocks in a row should have been merged
+            ok = ok && !prev_free;
+            free_bytes += size - HEADER_SIZE;
+        }
+        prev_free = !block_used(block);
+        prev_size = size;
+        p += size;
+    }
+    ok = ok && p == heap->end && free_bytes == heap->free_bytes;
+    unlock(heap);
+
+    if (!ok && print_errors) {
+        fprintf(stderr, "multi_heap_check: corrupt heap %p near %p\n", (void *)heap, (void *)p);
+    }
+    return ok;
+}
@@ -0,0 +1,374 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "esp_partition.h"
+#include "host_shim.h"
+
+// NVS entries in a flat list. Handles are namespace indices plus one, with
+// the open mode in the top bit.
+
+#define NVS_MAX_NAMESPACES  16
+#define NVS_MAX_ENTRIES     128
+#define NVS_MAX_VALUE       4000        // Largest blob NVS takes in one page
+#define HANDLE_WRITABLE     0x80000000u
+
+typedef enum {
+    ENTRY_U8, ENTRY_I8, ENTRY_U16, ENTRY_I16, ENTRY_U32, ENTRY_I32, ENTRY_U64, ENTRY_STR, ENTRY_BLOB,
+} entry_type_t;
+
+typedef struct {
+    bool used;
+    uint8_t name_space;
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    entry_type_t type;
+    size_t length;
+    uint8_t *value;
+} nvs_entry_t;
+
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static char namespaces[NVS_MAX_NAMESPACES][NVS_KEY_NAME_MAX_SIZE];
+static uint8_t namespace_count = 0;
+static nvs_entry_t entries[NVS_MAX_ENTRIES];
+
+void host_nvs_reset(void)
+{
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        free(entries[i].value);
+    }
+    memset(entries, 0, sizeof(entries));
+    memset(namespaces, 0, sizeof(namespaces));
+    namespace_count = 0;
+    pthread_mutex_unlock(&nvs_lock);
+}
+
+esp_err_t nvs_flash_init(void)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+    host_nvs_reset();
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name_space, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (name_space == NULL || out_handle == NULL || strlen(name_space) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    pthread_mutex_lock(&nvs_lock);
+    uint8_t i = 0;
+    while (i < namespace_count && strcmp(namespaces[i], name_space) != 0) {
+        i++;
+    }
+    if (i == namespace_count) {
+        // Like on target, a read-only open does not create the namespace
+        if (open_mode == NVS_READONLY || namespace_count == NVS_MAX_NAMESPACES) {
+            pthread_mutex_unlock(&nvs_lock);
+            return open_mode == NVS_READONLY ? ESP_ERR_NVS_NOT_FOUND : ESP_ERR_NVS_NO_FREE_PAGES;
+        }
+        strcpy(namespaces[i], name_space);
+        namespace_count++;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+
+    *out_handle = (i + 1) | (open_mode == NVS_READWRITE ? HANDLE_WRITABLE : 0);
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return (handle & ~HANDLE_WRITABLE) != 0 ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+// Locked
+static nvs_entry_t *find_entry(nvs_handle_t handle, const char *key)
+{
+    uint8_t name_space = (uint8_t)(handle & ~HANDLE_WRITABLE);
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (entries[i].used && entries[i].name_space == name_space && strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t check_handle(nvs_handle_t handle, const char *key, bool write)
+{
+    uint32_t index = handle & ~HANDLE_WRITABLE;
+    if (index == 0 || index > namespace_count) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    if (key == NULL || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (write && !(handle & HANDLE_WRITABLE)) {
+        return ESP_ERR_NVS_INVALID_HANDLE;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t set_entry(nvs_handle_t handle, const char *key, entry_type_t type, const void *value, size_t length)
+{
+    if (length > NVS_MAX_VALUE) {
+        return ESP_ERR_NVS_INVALID_LENGTH;
+    }
+
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t err = check_handle(handle, key, true);
+    if (err != ESP_OK) {
+        pthread_mutex_unlock(&nvs_lock);
+        return err;
+    }
+
+    nvs_entry_t *entry = find_entry(handle, key);
+    for (int i = 0; entry == NULL && i < NVS_MAX_ENTRIES; i++) {
+        if (!entries[i].used) {
+            entry = &entries[i];
+            entry->used = true;
+            entry->name_space = (uint8_t)(handle & ~HANDLE_WRITABLE);
+            strcpy(entry->key, key);
+        }
+    }
+    if (entry == NULL) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NVS_NO_FREE_PAGES;
+    }
+
+    uint8_t *copy = malloc(length > 0 ? length : 1);
+    if (copy == NULL) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+    free(entry->value);
+    entry->value = copy;
+    entry->type = type;
+    entry->length = length;
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+// Fixed-size values: length is exact. Strings and blobs: *length is the
+// buffer on entry and the stored length on return.
+static esp_err_t get_entry(nvs_handle_t handle, const char *key, entry_type_t type, void *out, size_t *length,
+                           bool variable)
+{
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t err = check_handle(handle, key, false);
+    nvs_entry_t *entry = err == ESP_OK ? find_entry(handle, key) : NULL;
+    if (err == ESP_OK && entry == NULL) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (err == ESP_OK && entry->type != type) {
+        err = ESP_ERR_NVS_TYPE_MISMATCH;
+    } else if (err == ESP_OK && variable) {
+        if (out != NULL && *length < entry->length) {
+            err = ESP_ERR_NVS_INVALID_LENGTH;
+        } else if (out != NULL) {
+            memcpy(out, entry->value, entry->length);
+        }
+        *length = entry->length;
+    } else if (err == ESP_OK) {
+        memcpy(out, entry->value, *length);
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t err = check_handle(handle, key, true);
+    nvs_entry_t *entry = err == ESP_OK ? find_entry(handle, key) : NULL;
+    if (err == ESP_OK && entry == NULL) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (entry != NULL) {
+        free(entry->value);
+        memset(entry, 0, sizeof(*entry));
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t err = check_handle(handle, "", true);
+    uint8_t name_space = (uint8_t)(handle & ~HANDLE_WRITABLE);
+    for (int i = 0; err == ESP_OK && i < NVS_MAX_ENTRIES; i++) {
+        if (entries[i].used && entries[i].name_space == name_space) {
+            free(entries[i].value);
+            memset(&entries[i], 0, sizeof(entries[i]));
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+#define NVS_SCALAR(suffix, type, entry_type)                                            \
+    esp_err_t nvs_set_##suffix(nvs_handle_t handle, const char *key, type value)       \
+    {                                                                                   \
+        return set_entry(handle, key, entry_type, &value, sizeof(value));               \
+    }                                                                                   \
+    esp_err_t nvs_get_##suffix(nvs_handle_t handle, const char *key, type *out_value)  \
+    {                                                                                   \
+        size_t length = sizeof(*out_value);                                             \
+        return get_entry(handle, key, entry_type, out_value, &length, false);           \
+    }
+
+NVS_SCALAR(u8, uint8_t, ENTRY_U8)
+NVS_SCALAR(i8, int8_t, ENTRY_I8)
+NVS_SCALAR(u16, uint16_t, ENTRY_U16)
+NVS_SCALAR(i16, int16_t, ENTRY_I16)
+NVS_SCALAR(u32, uint32_t, ENTRY_U32)
+NVS_SCALAR(i32, int32_t, ENTRY_I32)
+NVS_SCALAR(u64, uint64_t, ENTRY_U64)
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return set_entry(handle, key, ENTRY_STR, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return get_entry(handle, key, ENTRY_STR, out_value, length, true);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return set_entry(handle, key, ENTRY_BLOB, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return get_entry(handle, key, ENTRY_BLOB, out_value, length, true);
+}
+
+// Partitions: the data entries of partitions.csv
+
+typedef struct {
+    esp_partition_t partition;
+    uint8_t *data;
+} host_partition_t;
+
+static host_partition_t partitions[] = {
+    { .partition = { ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, 0x9000, 0x6000, SPI_FLASH_SEC_SIZE, "nvs" } },
+    { .partition = { ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x3B2000, 0x03E000, SPI_FLASH_SEC_SIZE, "storage" } },
+    { .partition = { ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_COREDUMP, 0x3F0000, 0x010000, SPI_FLASH_SEC_SIZE, "coredump" } },
+};
+
+#define PARTITION_COUNT (sizeof(partitions) / sizeof(partitions[0]))
+
+static pthread_mutex_t flash_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Locked
+static void erase_all(void)
+{
+    for (size_t i = 0; i < PARTITION_COUNT; i++) {
+        if (partitions[i].data == NULL) {
+            partitions[i].data = malloc(partitions[i].partition.size);
+            if (partitions[i].data == NULL) {
+                abort();
+            }
+        }
+        memset(partitions[i].data, 0xFF, partitions[i].partition.size);
+    }
+}
+
+void host_partition_reset(void)
+{
+    pthread_mutex_lock(&flash_lock);
+    erase_all();
+    pthread_mutex_unlock(&flash_lock);
+}
+
+static host_partition_t *host_partition(const esp_partition_t *partition)
+{
+    for (size_t i = 0; i < PARTITION_COUNT; i++) {
+        if (&partitions[i].partition == partition) {
+            return &partitions[i];
+        }
+    }
+    return NULL;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    pthread_mutex_lock(&flash_lock);
+    if (partitions[0].data == NULL) {
+        erase_all();
+    }
+    pthread_mutex_unlock(&flash_lock);
+
+    for (size_t i = 0; i < PARTITION_COUNT; i++) {
+        const esp_partition_t *p = &partitions[i].partition;
+        if ((type == ESP_PARTITION_TYPE_ANY || p->type == type) &&
+            (subtype == ESP_PARTITION_SUBTYPE_ANY || p->subtype == subtype) &&
+            (label == NULL || strcmp(p->label, label) == 0)) {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    host_partition_t *p = host_partition(partition);
+    if (p == NULL || dst == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (src_offset > partition->size || size > partition->size - src_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&flash_lock);
+    memcpy(dst, p->data + src_offset, size);
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    host_partition_t *p = host_partition(partition);
+    if (p == NULL || src == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (dst_offset > partition->size || size > partition->size - dst_offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t *in = src;
+    pthread_mutex_lock(&flash_lock);
+    for (size_t i = 0; i < size; i++) {
+        p->data[dst_offset + i] &= in[i];
+    }
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    host_partition_t *p = host_partition(partition);
+    if (p == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (offset > partition->size || size > partition->size - offset) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    pthread_mutex_lock(&flash_lock);
+    memset(p->data + offset, 0xFF, size);
+    pthread_mutex_unlock(&flash_lock);
+    return ESP_OK;
+}
@@ -0,0 +1,9 @@
+#ifndef ESP_ADC_CALI_H
+#define ESP_ADC_CALI_H
+
+#include "esp_err.h"
+#include "hal/adc_types.h"
+
+typedef struct host_adc_cali *adc_cali_handle_t;
+
+#endif // ESP_ADC_CALI_H
@@ -0,0 +1,6 @@
+#ifndef ESP_ADC_CALI_SCHEME_H
+#define ESP_ADC_CALI_SCHEME_H
+
+#include "esp_adc/adc_cali.h"
+
+#endif // ESP_ADC_CALI_SCHEME_H
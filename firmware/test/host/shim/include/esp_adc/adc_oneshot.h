@@ -0,0 +1,29 @@
+#ifndef ESP_ADC_ONESHOT_H
+#define ESP_ADC_ONESHOT_H
+
+#include "esp_err.h"
+#include "hal/adc_types.h"
+
+// Host shim: reads return what the test set with host_adc_set_raw or its
+// host_adc_set_source generator (host_shim.h)
+
+typedef struct host_adc_unit *adc_oneshot_unit_handle_t;
+
+typedef struct {
+    adc_unit_t unit_id;
+    int clk_src;
+    adc_ulp_mode_t ulp_mode;
+} adc_oneshot_unit_init_cfg_t;
+
+typedef struct {
+    adc_atten_t atten;
+    adc_bitwidth_t bitwidth;
+} adc_oneshot_chan_cfg_t;
+
+esp_err_t adc_oneshot_new_unit(const adc_oneshot_unit_init_cfg_t *config, adc_oneshot_unit_handle_t *out_handle);
+esp_err_t adc_oneshot_config_channel(adc_oneshot_unit_handle_t handle, adc_channel_t channel,
+                                     const adc_oneshot_chan_cfg_t *config);
+esp_err_t adc_oneshot_read(adc_oneshot_unit_handle_t handle, adc_channel_t channel, int *out_raw);
+esp_err_t adc_oneshot_del_unit(adc_oneshot_unit_handle_t handle);
+
+#endif // ESP_ADC_ONESHOT_H
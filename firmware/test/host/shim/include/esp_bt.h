@@ -0,0 +1,48 @@
+#ifndef ESP_BT_H
+#define ESP_BT_H
+
+#include "esp_err.h"
+
+// Host shim: controller TX power, kept per power type so tests can read
+// back what link_quality.c steered (host_bt_tx_power in host_shim.h)
+
+typedef enum {
+    ESP_BLE_PWR_TYPE_CONN_HDL0 = 0,
+    ESP_BLE_PWR_TYPE_CONN_HDL1,
+    ESP_BLE_PWR_TYPE_CONN_HDL2,
+    ESP_BLE_PWR_TYPE_CONN_HDL3,
+    ESP_BLE_PWR_TYPE_CONN_HDL4,
+    ESP_BLE_PWR_TYPE_CONN_HDL5,
+    ESP_BLE_PWR_TYPE_CONN_HDL6,
+    ESP_BLE_PWR_TYPE_CONN_HDL7,
+    ESP_BLE_PWR_TYPE_CONN_HDL8,
+    ESP_BLE_PWR_TYPE_ADV,
+    ESP_BLE_PWR_TYPE_SCAN,
+    ESP_BLE_PWR_TYPE_DEFAULT,
+    ESP_BLE_PWR_TYPE_NUM,
+} esp_ble_power_type_t;
+
+typedef enum {
+    ESP_PWR_LVL_N24 = 0,
+    ESP_PWR_LVL_N21,
+    ESP_PWR_LVL_N18,
+    ESP_PWR_LVL_N15,
+    ESP_PWR_LVL_N12,
+    ESP_PWR_LVL_N9,
+    ESP_PWR_LVL_N6,
+    ESP_PWR_LVL_N3,
+    ESP_PWR_LVL_N0,
+    ESP_PWR_LVL_P3,
+    ESP_PWR_LVL_P6,
+    ESP_PWR_LVL_P9,
+    ESP_PWR_LVL_P12,
+    ESP_PWR_LVL_P15,
+    ESP_PWR_LVL_P18,
+    ESP_PWR_LVL_P20,
+    ESP_PWR_LVL_INVALID = 0xFF,
+} esp_power_level_t;
+
+esp_err_t esp_ble_tx_power_set(esp_ble_power_type_t power_type, esp_power_level_t power_level);
+esp_power_level_t esp_ble_tx_power_get(esp_ble_power_type_t power_type);
+
+#endif // ESP_BT_H
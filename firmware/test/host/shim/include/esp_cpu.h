@@ -0,0 +1,16 @@
+#ifndef ESP_CPU_H
+#define ESP_CPU_H
+
+#include <stdint.h>
+
+// Host shim: the cycle counter reads nanoseconds of CLOCK_MONOTONIC, so
+// the on-target cycle benches report nanoseconds on the host
+
+uint64_t host_time_ns(void);
+
+static inline uint32_t esp_cpu_get_cycle_count(void)
+{
+    return (uint32_t)host_time_ns();
+}
+
+#endif // ESP_CPU_H
@@ -0,0 +1,9 @@
+#ifndef ESP_LCD_PANEL_VENDOR_H
+#define ESP_LCD_PANEL_VENDOR_H
+
+#include "esp_err.h"
+
+// Host shim: lcd.h includes it, the LCD driver itself does not build on
+// the host (see fakes/host_drivers.c)
+
+#endif // ESP_LCD_PANEL_VENDOR_H
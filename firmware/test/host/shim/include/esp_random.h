@@ -0,0 +1,12 @@
+#ifndef ESP_RANDOM_H
+#define ESP_RANDOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Host shim: a seeded PRNG so runs repeat, see host_random_seed
+
+uint32_t esp_random(void);
+void esp_fill_random(void *buffer, size_t length);
+
+#endif // ESP_RANDOM_H
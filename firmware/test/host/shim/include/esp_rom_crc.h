@@ -0,0 +1,11 @@
+#ifndef ESP_ROM_CRC_H
+#define ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// Host shim: the ROM CRC routines, same polynomials and conventions
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buffer, uint32_t length);
+uint16_t esp_rom_crc16_le(uint16_t crc, const uint8_t *buffer, uint32_t length);
+
+#endif // ESP_ROM_CRC_H
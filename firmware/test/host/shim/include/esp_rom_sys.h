@@ -0,0 +1,16 @@
+#ifndef ESP_ROM_SYS_H
+#define ESP_ROM_SYS_H
+
+#include <stdint.h>
+
+// Host shim: the cycle counters count nanoseconds, so one "MHz" of CPU
+// makes cycles per microsecond come out right
+
+static inline uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+    return 1000;
+}
+
+void esp_rom_delay_us(uint32_t us);
+
+#endif // ESP_ROM_SYS_H
@@ -0,0 +1,8 @@
+#ifndef ESP_SLEEP_H
+#define ESP_SLEEP_H
+
+#include "esp_err.h"
+
+// Host shim: nothing to configure, the host does not sleep
+
+#endif // ESP_SLEEP_H
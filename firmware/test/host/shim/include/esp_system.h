@@ -0,0 +1,14 @@
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Host shim: esp_restart is counted and returns into a test hook instead
+// of rebooting, see host_shim.h
+
+void esp_restart(void);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#endif // ESP_SYSTEM_H
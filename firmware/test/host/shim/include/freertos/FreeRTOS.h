@@ -0,0 +1,51 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+// Host shim: the FreeRTOS subset the firmware uses, on pthreads. Every
+// blocking call goes through the scheduler in host_freertos.c so that,
+// with the virtual clock, time only moves when a test advances it and
+// every task has blocked again (see host_shim.h). stdio and stdlib come
+// along as they do through portmacro.h on target.
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdFALSE                 0
+#define pdTRUE                  1
+#define pdFAIL                  pdFALSE
+#define pdPASS                  pdTRUE
+#define errQUEUE_FULL           0
+
+#define configTICK_RATE_HZ      CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS      ((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY           ((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000U))
+#define tskNO_AFFINITY          0x7FFFFFFF
+
+// Critical sections are a recursive mutex, ISR variants included
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP }
+
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define portENTER_CRITICAL_SAFE(mux)    portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_SAFE(mux)     portEXIT_CRITICAL(mux)
+#define spinlock_initialize(mux)        pthread_mutex_init(&(mux)->mutex, NULL)
+
+#define portYIELD_FROM_ISR(x)           ((void)(x))
+
+#endif // FREERTOS_H
@@ -0,0 +1,70 @@
+#ifndef HOST_SHIM_H
+#define HOST_SHIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "hal/adc_types.h"
+#include "driver/gpio.h"
+#include "esp_bt.h"
+
+// Test-side controls of the ESP-IDF and FreeRTOS shim. Firmware sources
+// never include this header.
+//
+// Clock. In the real mode esp_timer_get_time and the tick count follow
+// CLOCK_MONOTONIC and delays sleep. In the virtual mode time starts at 0
+// and only moves in host_clock_advance_us, which steps from one task
+// deadline to the next and, at each, waits until every shim task has
+// blocked again before going on. A run with the virtual clock is
+// repeatable and takes no wall time; set the mode before any task starts.
+// Only shim tasks count towards the idle wait, and a timeout only passes
+// while someone advances the clock: a firmware call that may block with a
+// timeout has to run in a task, not on the test thread.
+
+typedef enum {
+    HOST_CLOCK_REAL,
+    HOST_CLOCK_VIRTUAL,
+} host_clock_mode_t;
+
+void host_clock_set_mode(host_clock_mode_t mode);
+host_clock_mode_t host_clock_mode(void);
+void host_clock_advance_us(int64_t us);
+static inline void host_clock_advance_ms(uint32_t ms) { host_clock_advance_us((int64_t)ms * 1000); }
+// Virtual mode: returns once every shim task is blocked
+void host_wait_idle(void);
+// Nanoseconds of CLOCK_MONOTONIC, for the benchmarks
+uint64_t host_time_ns(void);
+
+// ADC. Reads of a channel return the source's value if one is set, else
+// the last host_adc_set_raw, else 0. The source runs in the reading task.
+typedef int (*host_adc_source_t)(adc_channel_t channel, void *ctx);
+
+void host_adc_set_raw(adc_channel_t channel, int raw);
+void host_adc_set_source(host_adc_source_t source, void *ctx);
+uint32_t host_adc_reads(adc_channel_t channel);
+
+// GPIO inputs, and what the firmware drove on outputs
+void host_gpio_set_input(gpio_num_t gpio_num, int level);
+int host_gpio_output(gpio_num_t gpio_num);
+
+// Flash: NVS entries and partition contents back to erased
+void host_nvs_reset(void);
+void host_partition_reset(void);
+
+// PSRAM missing: SPIRAM heap_caps requests return NULL
+void host_heap_caps_fail_psram(bool fail);
+// Short of memory: heap_caps requests above bytes return NULL, 0 for no limit
+void host_heap_caps_set_largest_block(size_t bytes);
+// heap_caps blocks allocated and not freed yet
+uint32_t host_heap_caps_live_blocks(void);
+
+void host_random_seed(uint32_t seed);
+
+// Calls to esp_restart so far; the hook, if set, runs on each
+uint32_t host_restart_count(void);
+void host_set_restart_hook(void (*hook)(void));
+
+// Last level set for a power type, ESP_PWR_LVL_INVALID if never
+esp_power_level_t host_bt_tx_power(esp_ble_power_type_t power_type);
+
+#endif // HOST_SHIM_H
@@ -0,0 +1,36 @@
+#ifndef MULTI_HEAP_H
+#define MULTI_HEAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host shim: heaps on a caller's block with the multi_heap API. The
+// allocator is an address-ordered first fit with coalescing, not the TLSF
+// of ESP-IDF: allocation cost differs, the bounds on fragmentation under
+// one workload are comparable. 8-byte aligned, 8 bytes of header a block.
+
+typedef struct host_multi_heap *multi_heap_handle_t;
+
+typedef struct {
+    size_t total_free_bytes;
+    size_t total_allocated_bytes;
+    size_t largest_free_block;
+    size_t minimum_free_bytes;
+    size_t allocated_blocks;
+    size_t free_blocks;
+    size_t total_blocks;
+} multi_heap_info_t;
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size);
+void multi_heap_set_lock(multi_heap_handle_t heap, void *lock);
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size);
+void multi_heap_free(multi_heap_handle_t heap, void *ptr);
+void *multi_heap_realloc(multi_heap_handle_t heap, void *ptr, size_t size);
+size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *ptr);
+size_t multi_heap_free_size(multi_heap_handle_t heap);
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap);
+void multi_heap_get_info(multi_heap_handle_t heap, multi_heap_info_t *info);
+bool multi_heap_check(multi_heap_handle_t heap, bool print_errors);
+
+#endif // MULTI_HEAP_H
@@ -0,0 +1,21 @@
+#ifndef PERFMON_H
+#define PERFMON_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// Host shim: every counter counts nanoseconds of CLOCK_MONOTONIC while
+// started, so cycle and instruction figures read as nanoseconds
+
+#define XTPERF_CNT_CYCLES       0
+#define XTPERF_CNT_INSN         2
+#define XTPERF_MASK_CYCLES      1
+#define XTPERF_MASK_INSN_ALL    0x8dff
+
+esp_err_t xtensa_perfmon_init(int id, uint16_t select, uint16_t mask, int kernelcnt, int tracelevel);
+esp_err_t xtensa_perfmon_reset(int id);
+void xtensa_perfmon_start(void);
+void xtensa_perfmon_stop(void);
+uint32_t xtensa_perfmon_value(int id);
+
+#endif // PERFMON_H
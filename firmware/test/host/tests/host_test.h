@@ -0,0 +1,68 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+// Checks for the host tests. A failed check prints where and goes on, so
+// one run shows every failure; main returns host_test_result().
+
+extern int host_test_failures;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+        long long a_ = (long long)(actual); \
+        long long e_ = (long long)(expected); \
+        if (a_ != e_) { \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(actual, expected, tolerance) do { \
+        double a_ = (double)(actual); \
+        double e_ = (double)(expected); \
+        if (a_ < e_ - (tolerance) || a_ > e_ + (tolerance)) { \
+            fprintf(stderr, "%s:%d: %s is %g, expected %g +- %g\n", __FILE__, __LINE__, #actual, a_, e_, \
+                    (double)(tolerance)); \
+            host_test_failures++; \
+        } \
+    } while (0)
+
+// Runs one test function and reports it
+#define RUN_TEST(fn) do { \
+        int before_ = host_test_failures; \
+        fn(); \
+        printf("%s %s\n", host_test_failures == before_ ? "PASS" : "FAIL", #fn); \
+    } while (0)
+
+#define HOST_TEST_DEFINE int host_test_failures = 0;
+
+// Firmware calls that block on FreeRTOS have to run in a shim task when
+// the clock is virtual; the test thread moves the time meanwhile
+static void host_test_task_entry(void *arg)
+{
+    ((void (*)(void))arg)();
+    vTaskDelete(NULL);
+}
+
+static inline void host_test_run_in_task(void (*fn)(void))
+{
+    xTaskCreate(host_test_task_entry, "host_test", 4096, (void *)fn, 5, NULL);
+}
+
+static inline int host_test_result(void)
+{
+    return host_test_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif // HOST_TEST_H
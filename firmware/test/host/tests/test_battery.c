@@ -0,0 +1,95 @@
+#include "host_test.h"
+#include "host_shim.h"
+#include "battery.h"
+#include "throttle.h"
+#include "hw_config.h"
+
+HOST_TEST_DEFINE
+
+static int probe_high_reads = 0;
+static int probe_low_reads = 0;
+
+// The divider only carries the cell voltage while the probe pin is high
+static int battery_source(adc_channel_t channel, void *ctx)
+{
+    int raw = *(const int *)ctx;
+    if (channel != BATTERY_VOLTAGE_PIN) {
+        return 0;
+    }
+    if (host_gpio_output(BATTERY_PROBE_PIN)) {
+        probe_high_reads++;
+        return raw;
+    }
+    probe_low_reads++;
+    return 0;
+}
+
+static float volts(int raw)
+{
+    return (float)raw / ADC_RESOLUTION * ADC_REFERENCE_VOLTAGE * VOLTAGE_DIVIDER_RATIO * BATTERY_VOLTAGE_SCALE;
+}
+
+// Raw reading for a cell voltage
+static int raw_for(float cell_v)
+{
+    return (int)(cell_v / (ADC_REFERENCE_VOLTAGE * VOLTAGE_DIVIDER_RATIO * BATTERY_VOLTAGE_SCALE) * ADC_RESOLUTION + 0.5f);
+}
+
+static int raw = 0;
+
+static void test_no_reading_before_monitoring(void)
+{
+    CHECK_EQ(battery_get_percentage(), -1);
+    CHECK_EQ(battery_get_voltage(), 0.0f);
+}
+
+static void test_voltage_and_percentage(void)
+{
+    raw = raw_for(3.80f);
+    battery_start_monitoring();
+    host_clock_advance_ms(700);
+
+    CHECK_NEAR(battery_get_voltage(), volts(raw), 1e-4);
+    CHECK_EQ(battery_get_percentage(), 60);
+    CHECK_EQ(probe_low_reads, 0);
+    CHECK(probe_high_reads >= 10);
+    CHECK_EQ(host_gpio_output(BATTERY_PROBE_PIN), 0);
+
+    // Interpolated between the 3.85 V (70 %) and 3.80 V (60 %) points
+    raw = raw_for(3.825f);
+    host_clock_advance_ms(500);
+    CHECK_NEAR(battery_get_percentage(), 65, 1);
+
+    // Clamped at both ends
+    raw = raw_for(4.30f);
+    host_clock_advance_ms(500);
+    CHECK_EQ(battery_get_percentage(), 100);
+    raw = raw_for(2.60f);
+    host_clock_advance_ms(500);
+    CHECK_EQ(battery_get_percentage(), 0);
+}
+
+static void test_voltage_is_averaged(void)
+{
+    // Ten readings, one every 500 ms
+    raw = raw_for(3.70f);
+    host_clock_advance_ms(BATTERY_VOLTAGE_SAMPLES * 500);
+    CHECK_NEAR(battery_get_voltage(), volts(raw), 1e-3);
+
+    raw = raw_for(3.90f);
+    host_clock_advance_ms(BATTERY_VOLTAGE_SAMPLES / 2 * 500);
+    CHECK_NEAR(battery_get_voltage(), (volts(raw_for(3.70f)) + volts(raw)) / 2, 0.01);
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    host_adc_set_source(battery_source, &raw);
+    CHECK_EQ(adc_init(), ESP_OK);
+    CHECK_EQ(battery_init(), ESP_OK);
+
+    RUN_TEST(test_no_reading_before_monitoring);
+    RUN_TEST(test_voltage_and_percentage);
+    RUN_TEST(test_voltage_is_averaged);
+    return host_test_result();
+}
@@ -0,0 +1,247 @@
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "host_ble.h"
+#include "host_drivers.h"
+#include "ble.h"
+#include "ble_ota.h"
+#include "ble_bench.h"
+#include "espnow_packet.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "telemetry_decode.h"
+#include "telemetry_schema.h"
+#include "throttle_map.h"
+
+HOST_TEST_DEFINE
+
+static uint32_t hooked_writes[BLE_MAX_LINKS];
+
+static void on_write(ble_link_t link, const uint8_t *data, size_t len, void *ctx)
+{
+    (void)data;
+    (void)len;
+    (void)ctx;
+    hooked_writes[link]++;
+}
+
+static void notify_frame(ble_link_t link, const telemetry_snapshot_t *snapshot, size_t len)
+{
+    uint8_t frame[TELEMETRY_FRAME_LEN];
+    telemetry_encode_frame(snapshot, frame);
+    host_ble_notify(link, frame, len);
+}
+
+static void test_connect_and_neutral_writes(void)
+{
+    CHECK(!is_connect);
+    host_ble_connect(BLE_LINK_PRIMARY);
+    CHECK(is_connect);
+    CHECK_EQ(get_connect_count(), 1);
+
+    // Not calibrated, so the 50 ms send loop holds neutral
+    host_ble_reset_counts();
+    host_clock_advance_ms(1000);
+    CHECK_NEAR(host_ble_write_count(BLE_LINK_PRIMARY), 20, 1);
+    CHECK_EQ(hooked_writes[BLE_LINK_PRIMARY], host_ble_write_count(BLE_LINK_PRIMARY));
+    uint8_t data[8];
+    CHECK_EQ(host_ble_last_write(BLE_LINK_PRIMARY, data, sizeof(data)), 2);
+    CHECK_EQ(data[0], THROTTLE_MAP_NEUTRAL);
+    CHECK_EQ(data[1], 0);
+    CHECK_EQ(get_last_throttle_sent(), THROTTLE_MAP_NEUTRAL);
+
+    ble_link_stats_t stats;
+    ble_get_link_stats(BLE_LINK_PRIMARY, &stats);
+    CHECK(stats.connected);
+    CHECK_EQ(stats.tx_bytes, stats.tx_writes * 2);
+    CHECK_EQ(stats.tx_failed, 0);
+}
+
+static void test_frames_reach_the_getters(void)
+{
+    telemetry_snapshot_t s = {0};
+    s.erpm = 31000;
+    s.voltage_c100 = 4188;
+    s.current_motor_c100 = 1250;
+    s.bms_num_cells = 4;
+    for (int i = 0; i < 4; i++) {
+        s.cell_mv[i] = (int16_t)(3900 + i);
+    }
+
+    uint32_t frames = telemetry_get_frame_count();
+    notify_frame(BLE_LINK_PRIMARY, &s, TELEMETRY_FRAME_LEN);
+    CHECK_EQ(telemetry_get_frame_count(), frames + 1);
+    CHECK_EQ(get_latest_erpm(), 31000);
+    CHECK_NEAR(get_latest_voltage(), 41.88, 1e-4);
+    CHECK_EQ(get_bms_num_cells(), 4);
+    CHECK_NEAR(get_bms_cell_voltage(3), 3.903, 1e-4);
+
+    // v2 with only the valid cells
+    s.erpm = 32000;
+    notify_frame(BLE_LINK_PRIMARY, &s, TELEMETRY_SCHEMA_V2_LEN(4));
+    CHECK_EQ(get_latest_erpm(), 32000);
+    CHECK_EQ(telemetry_get_frame_count(), frames + 2);
+
+    notify_frame(BLE_LINK_PRIMARY, &s, TELEMETRY_SCHEMA_V2_LEN(4) + 1);
+    CHECK_EQ(get_rejected_frame_count(), 1);
+    CHECK_EQ(get_latest_erpm(), 32000);
+}
+
+static void test_secondary_drive_is_merged(void)
+{
+    host_ble_connect(BLE_LINK_SECONDARY);
+
+    telemetry_snapshot_t second = {0};
+    second.erpm = 29000;
+    second.current_motor_c100 = 1100;
+    second.temp_mos_c100 = 6000;
+    uint32_t frames = telemetry_get_frame_count();
+    notify_frame(BLE_LINK_SECONDARY, &second, TELEMETRY_SCHEMA_V2_LEN(0));
+    // Stored only, the primary paces the snapshots
+    CHECK_EQ(telemetry_get_frame_count(), frames);
+
+    telemetry_snapshot_t primary = {0};
+    primary.erpm = 30000;
+    primary.current_motor_c100 = 1250;
+    primary.temp_mos_c100 = 4000;
+    notify_frame(BLE_LINK_PRIMARY, &primary, TELEMETRY_SCHEMA_V2_LEN(0));
+    CHECK_EQ(telemetry_get_frame_count(), frames + 1);
+    CHECK_EQ(get_latest_erpm(), 30000);
+    CHECK_NEAR(get_latest_current_motor(), 23.5, 1e-4);
+    CHECK_NEAR(get_latest_temp_mos(), 60.0, 1e-4);
+
+    // A silent primary hands the pacing to the second drive
+    host_clock_advance_us(TELEMETRY_SOURCE_STALE_US + 1000);
+    notify_frame(BLE_LINK_SECONDARY, &second, TELEMETRY_SCHEMA_V2_LEN(0));
+    CHECK_EQ(telemetry_get_frame_count(), frames + 2);
+    CHECK_EQ(get_latest_erpm(), 29000);
+
+    host_ble_disconnect(BLE_LINK_SECONDARY);
+    CHECK(is_connect);
+}
+
+static void test_status_goes_to_ota(void)
+{
+    uint8_t message[] = { BLE_OTA_MAGIC, 0x01, 0x02 };
+    host_ble_status(BLE_LINK_PRIMARY, message, sizeof(message));
+    CHECK_EQ(host_ota_messages(), 1);
+    // Only the primary carries updates
+    host_ble_connect(BLE_LINK_BMS);
+    host_ble_status(BLE_LINK_BMS, message, sizeof(message));
+    CHECK_EQ(host_ota_messages(), 1);
+    host_ble_disconnect(BLE_LINK_BMS);
+}
+
+static void test_pairing_offer_needs_encryption(void)
+{
+    // Not sent over a link a listener can read
+    uint32_t commands = host_ble_command_count(BLE_LINK_PRIMARY);
+    CHECK_EQ(ble_start_espnow_pairing(), ESP_ERR_INVALID_STATE);
+    CHECK(!ble_espnow_pairing_pending());
+    CHECK_EQ(host_ble_command_count(BLE_LINK_PRIMARY), commands);
+
+    CHECK_EQ(ble_transport_request_encryption(BLE_LINK_PRIMARY), ESP_OK);
+    CHECK_EQ(host_ble_encryption_requests(BLE_LINK_PRIMARY), 1);
+    host_ble_finish_encryption(BLE_LINK_PRIMARY, false);
+    CHECK_EQ(ble_start_espnow_pairing(), ESP_ERR_INVALID_STATE);
+    host_ble_finish_encryption(BLE_LINK_PRIMARY, true);
+    CHECK_EQ(ble_start_espnow_pairing(), ESP_OK);
+    CHECK(ble_espnow_pairing_pending());
+
+    uint8_t offer[ESPNOW_PAIR_OFFER_LEN + 1];
+    CHECK_EQ(host_ble_last_command(BLE_LINK_PRIMARY, offer, sizeof(offer)), ESPNOW_PAIR_OFFER_LEN);
+    CHECK_EQ(offer[0], ESPNOW_PAIR_MAGIC);
+    const uint8_t answer[ESPNOW_PAIR_ANSWER_LEN] = { ESPNOW_PAIR_MAGIC, 0x02, 0x11, 0x22, 0x33, 0x44, 0x55 };
+    host_ble_status(BLE_LINK_PRIMARY, answer, sizeof(answer));
+    CHECK(!ble_espnow_pairing_pending());
+}
+
+static void test_ping_echoes_close_a_round_trip(void)
+{
+    CHECK_EQ(ble_bench_start(0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(ble_bench_start(10), ESP_OK);
+    CHECK(ble_bench_is_active());
+    host_ble_reset_counts();
+
+    // The receiver echoes each ping 7 ms later, as fake_thumb.py would
+    uint8_t ping[8];
+    for (int i = 0; i < 10; i++) {
+        host_wait_idle();
+        CHECK_EQ(host_ble_last_command(BLE_LINK_PRIMARY, ping, sizeof(ping)), BLE_BENCH_PING_LEN);
+        CHECK_EQ(ping[0], BLE_BENCH_PING_MAGIC);
+        host_clock_advance_ms(7);
+        host_ble_status(BLE_LINK_PRIMARY, ping, BLE_BENCH_PING_LEN);
+        host_clock_advance_ms(BLE_BENCH_PERIOD_MS - 7);
+    }
+    host_wait_idle();
+    CHECK(!ble_bench_is_active());
+    CHECK_EQ(host_ble_command_count(BLE_LINK_PRIMARY), 10);
+
+    ble_bench_result_t result;
+    ble_bench_get_result(&result);
+    CHECK_EQ(result.pings_sent, 10);
+    CHECK_EQ(result.pings_failed, 0);
+    CHECK_EQ(result.echoes, 10);
+    CHECK_EQ(result.rtt_count, 10);
+    CHECK_EQ(result.rtt_min_us, 7000);
+    CHECK_EQ(result.rtt_max_us, 7000);
+    // The throttle kept going and every write was timed
+    CHECK_NEAR(result.writes, 10 * BLE_BENCH_PERIOD_MS / 50, 1);
+    CHECK_EQ(result.writes_failed, 0);
+    // Echoes are not taken for an OTA message
+    CHECK_EQ(host_ota_messages(), 1);
+}
+
+static void test_pings_stop_with_the_link(void)
+{
+    CHECK_EQ(ble_bench_start(100), ESP_OK);
+    host_clock_advance_ms(3 * BLE_BENCH_PERIOD_MS);
+    host_ble_disconnect(BLE_LINK_PRIMARY);
+    host_clock_advance_ms(2 * BLE_BENCH_PERIOD_MS);
+    host_wait_idle();
+    CHECK(!ble_bench_is_active());
+
+    ble_bench_result_t result;
+    ble_bench_get_result(&result);
+    CHECK(result.pings_sent >= 3 && result.pings_sent < 100);
+    CHECK_EQ(result.pings_failed, 1);
+    CHECK_EQ(ble_bench_start(10), ESP_ERR_INVALID_STATE);
+}
+
+static void test_disconnect_clears_telemetry(void)
+{
+    host_ble_disconnect(BLE_LINK_PRIMARY);
+    CHECK(!is_connect);
+    CHECK_EQ(get_latest_erpm(), 0);
+    CHECK_EQ(host_ota_links_lost(), 1);
+
+    // Nothing is written while down
+    host_ble_reset_counts();
+    host_clock_advance_ms(500);
+    CHECK_EQ(host_ble_write_count(BLE_LINK_PRIMARY), 0);
+
+    host_ble_connect(BLE_LINK_PRIMARY);
+    CHECK_EQ(get_connect_count(), 2);
+    // Encryption went with the old link
+    CHECK(!ble_transport_encrypted(BLE_LINK_PRIMARY));
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    host_nvs_reset();
+    settings_init();
+    host_ble_set_write_hook(on_write, NULL);
+    spp_client_demo_init();
+    host_clock_advance_ms(100);
+
+    RUN_TEST(test_connect_and_neutral_writes);
+    RUN_TEST(test_frames_reach_the_getters);
+    RUN_TEST(test_secondary_drive_is_merged);
+    RUN_TEST(test_status_goes_to_ota);
+    RUN_TEST(test_pairing_offer_needs_encryption);
+    RUN_TEST(test_ping_echoes_close_a_round_trip);
+    RUN_TEST(test_disconnect_clears_telemetry);
+    RUN_TEST(test_pings_stop_with_the_link);
+    return host_test_result();
+}
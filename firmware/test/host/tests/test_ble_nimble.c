@@ -0,0 +1,226 @@
+#include <string.h>
+#include "host_test.h"
+#include "host_nimble.h"
+#include "host/ble_hs.h"
+#include "ble_transport.h"
+
+// ble_nimble.c against the fake NimBLE host: a link that cannot be made
+// ready is dropped and found again, and ready means what it means on the
+// Bluedroid backend, the data receive characteristic found and writable.
+
+HOST_TEST_DEFINE
+
+static const char *const peer_names[BLE_MAX_LINKS] = BLE_PEER_NAMES;
+
+static const host_nimble_chr_t spp_chrs[] = {
+    { BLE_SPP_DATA_RECV_UUID, BLE_GATT_CHR_PROP_READ | BLE_GATT_CHR_PROP_WRITE_NO_RSP },
+    { BLE_SPP_DATA_NOTIFY_UUID, BLE_GATT_CHR_PROP_READ | BLE_GATT_CHR_PROP_NOTIFY },
+    { BLE_SPP_COMMAND_UUID, BLE_GATT_CHR_PROP_WRITE },
+    { BLE_SPP_STATUS_UUID, BLE_GATT_CHR_PROP_READ | BLE_GATT_CHR_PROP_NOTIFY },
+};
+
+static uint32_t connects;
+static uint32_t disconnects;
+
+static void on_connected(ble_link_t link)
+{
+    connects++;
+}
+
+static void on_disconnected(ble_link_t link)
+{
+    disconnects++;
+}
+
+static void on_notify(ble_link_t link, const uint8_t *data, size_t len)
+{
+}
+
+static void on_rssi(ble_link_t link, int rssi)
+{
+}
+
+static const ble_transport_callbacks_t callbacks = {
+    .connected = on_connected,
+    .disconnected = on_disconnected,
+    .notify = on_notify,
+    .rssi = on_rssi,
+    .status = on_notify,
+};
+
+// Fresh host with the peer exposing chrs, counters cleared
+static void start_peer(const host_nimble_chr_t *chrs, size_t count)
+{
+    host_nimble_reset();
+    host_nimble_set_chrs(chrs, count);
+    connects = 0;
+    disconnects = 0;
+}
+
+// Advertises the primary and runs the host until it is idle, checking
+// that the link never reports ready when ready_ok is false
+static void connect_primary(bool ready_ok)
+{
+    CHECK(host_nimble_advertise(peer_names[BLE_LINK_PRIMARY]));
+    while (host_nimble_run_one()) {
+        if (!ready_ok) {
+            CHECK(!ble_transport_ready(BLE_LINK_PRIMARY));
+        }
+    }
+}
+
+static void check_dropped(void)
+{
+    CHECK_EQ(connects, 1);
+    CHECK_EQ(disconnects, 1);
+    CHECK_EQ(host_nimble_terminate_count(), 1);
+    CHECK_EQ(host_nimble_terminate_reason(), BLE_ERR_REM_USER_CONN_TERM);
+    CHECK(!host_nimble_connected());
+    CHECK(!ble_transport_ready(BLE_LINK_PRIMARY));
+    CHECK_EQ(ble_transport_conn_handle(BLE_LINK_PRIMARY), -1);
+    // Scanning again, so the peer is found once more
+    CHECK(host_nimble_scanning());
+}
+
+static void test_ready_once_writable(void)
+{
+    start_peer(spp_chrs, 4);
+    connect_primary(true);
+    CHECK(host_nimble_connected());
+    CHECK(ble_transport_ready(BLE_LINK_PRIMARY));
+    CHECK_EQ(ble_transport_mtu(BLE_LINK_PRIMARY), 247);
+    CHECK_EQ(host_nimble_subscribe_count(), 2);
+    CHECK_EQ(host_nimble_terminate_count(), 0);
+
+    const uint8_t throttle[2] = {128, 0};
+    CHECK_EQ(ble_transport_write(BLE_LINK_PRIMARY, throttle, sizeof(throttle)), ESP_OK);
+    CHECK_EQ(ble_transport_write_command(BLE_LINK_PRIMARY, throttle, sizeof(throttle)), ESP_OK);
+    CHECK_EQ(host_nimble_write_count(), 2);
+}
+
+static void test_encryption_follows_the_pairing(void)
+{
+    start_peer(spp_chrs, 4);
+    CHECK_EQ(ble_transport_request_encryption(BLE_LINK_PRIMARY), ESP_ERR_INVALID_STATE);
+    connect_primary(true);
+    CHECK(!ble_transport_encrypted(BLE_LINK_PRIMARY));
+
+    host_nimble_fail_status(HOST_NIMBLE_ENCRYPT, BLE_HS_ERR_SM_PEER_BASE + BLE_SM_ERR_PAIR_NOT_SUPP);
+    CHECK_EQ(ble_transport_request_encryption(BLE_LINK_PRIMARY), ESP_OK);
+    host_nimble_run();
+    CHECK(!ble_transport_encrypted(BLE_LINK_PRIMARY));
+    // A refused pairing leaves the link up, only unencrypted
+    CHECK(ble_transport_ready(BLE_LINK_PRIMARY));
+
+    CHECK_EQ(ble_transport_request_encryption(BLE_LINK_PRIMARY), ESP_OK);
+    host_nimble_run();
+    CHECK(host_nimble_encrypted());
+    CHECK(ble_transport_encrypted(BLE_LINK_PRIMARY));
+
+    // Gone with the link
+    CHECK_EQ(ble_gap_terminate(ble_transport_conn_handle(BLE_LINK_PRIMARY), BLE_ERR_REM_USER_CONN_TERM), 0);
+    host_nimble_run();
+    CHECK(!ble_transport_encrypted(BLE_LINK_PRIMARY));
+}
+
+static void test_refused_mtu_still_ready(void)
+{
+    // Bluedroid goes on with the default MTU as well
+    start_peer(spp_chrs, 4);
+    host_nimble_fail_status(HOST_NIMBLE_MTU, BLE_HS_ETIMEOUT);
+    connect_primary(true);
+    CHECK(ble_transport_ready(BLE_LINK_PRIMARY));
+    CHECK_EQ(ble_transport_mtu(BLE_LINK_PRIMARY), BLE_ATT_MTU_DFLT);
+    CHECK_EQ(host_nimble_terminate_count(), 0);
+}
+
+static void test_read_only_data_recv_is_dropped(void)
+{
+    host_nimble_chr_t chrs[4];
+    memcpy(chrs, spp_chrs, sizeof(chrs));
+    chrs[0].properties = BLE_GATT_CHR_PROP_READ | BLE_GATT_CHR_PROP_NOTIFY;
+    start_peer(chrs, 4);
+    connect_primary(false);
+    check_dropped();
+    CHECK_EQ(host_nimble_subscribe_count(), 0);
+}
+
+static void test_missing_service_is_dropped(void)
+{
+    start_peer(NULL, 0);
+    connect_primary(false);
+    check_dropped();
+}
+
+static void test_missing_notify_is_dropped(void)
+{
+    const host_nimble_chr_t chrs[] = { spp_chrs[0], spp_chrs[2] };
+    start_peer(chrs, 2);
+    connect_primary(false);
+    check_dropped();
+}
+
+static void test_characteristic_call_failure_is_dropped(void)
+{
+    start_peer(spp_chrs, 4);
+    host_nimble_fail_call(HOST_NIMBLE_DISC_CHRS, BLE_HS_ENOTCONN + 1);
+    connect_primary(false);
+    check_dropped();
+}
+
+static void test_characteristic_status_failure_is_dropped(void)
+{
+    start_peer(spp_chrs, 4);
+    host_nimble_fail_status(HOST_NIMBLE_DISC_CHRS, BLE_HS_ETIMEOUT);
+    connect_primary(false);
+    check_dropped();
+}
+
+static void test_subscribe_call_failure_is_dropped(void)
+{
+    start_peer(spp_chrs, 4);
+    host_nimble_fail_call(HOST_NIMBLE_SUBSCRIBE, BLE_HS_ENOTCONN + 1);
+    connect_primary(true);
+    check_dropped();
+}
+
+static void test_subscribe_status_failure_is_dropped(void)
+{
+    start_peer(spp_chrs, 4);
+    host_nimble_fail_status(HOST_NIMBLE_SUBSCRIBE, BLE_HS_ERR_ATT_BASE + BLE_ATT_ERR_WRITE_NOT_PERMITTED);
+    connect_primary(true);
+    check_dropped();
+}
+
+static void test_dropped_link_comes_back(void)
+{
+    start_peer(spp_chrs, 4);
+    host_nimble_fail_status(HOST_NIMBLE_SUBSCRIBE, BLE_HS_ETIMEOUT);
+    connect_primary(true);
+    CHECK(!ble_transport_ready(BLE_LINK_PRIMARY));
+
+    // The failure was one-off; the next advertisement makes it ready
+    connect_primary(true);
+    CHECK_EQ(connects, 2);
+    CHECK(ble_transport_ready(BLE_LINK_PRIMARY));
+    CHECK_EQ(host_nimble_terminate_count(), 1);
+}
+
+int main(void)
+{
+    CHECK_EQ(ble_transport_init(&callbacks), ESP_OK);
+    CHECK(strcmp(ble_transport_name(), "NimBLE") == 0);
+
+    RUN_TEST(test_ready_once_writable);
+    RUN_TEST(test_encryption_follows_the_pairing);
+    RUN_TEST(test_refused_mtu_still_ready);
+    RUN_TEST(test_read_only_data_recv_is_dropped);
+    RUN_TEST(test_missing_service_is_dropped);
+    RUN_TEST(test_missing_notify_is_dropped);
+    RUN_TEST(test_characteristic_call_failure_is_dropped);
+    RUN_TEST(test_characteristic_status_failure_is_dropped);
+    RUN_TEST(test_subscribe_call_failure_is_dropped);
+    RUN_TEST(test_subscribe_status_failure_is_dropped);
+    RUN_TEST(test_dropped_link_comes_back);
+    return host_test_result();
+}
@@ -0,0 +1,84 @@
+#include <limits.h>
+#include <string.h>
+#include "host_test.h"
+#include "console_parse.h"
+
+HOST_TEST_DEFINE
+
+static void test_commands_are_found(void)
+{
+    CHECK_EQ(console_parse_command("reset_odometer"), CMD_RESET_ODOMETER);
+    CHECK_EQ(console_parse_command("help"), CMD_HELP);
+    CHECK_EQ(console_parse_command("bench"), CMD_BENCH);
+    CHECK_EQ(console_parse_command("bench_latency"), CMD_BENCH_LATENCY);
+    CHECK_EQ(console_parse_command("ble_backend ping 500"), CMD_BLE_BACKEND);
+    CHECK_EQ(console_parse_command("  \tGet_Config"), CMD_GET_CONFIG);
+    CHECK_EQ(console_parse_command("set_motor_poles 14"), CMD_SET_MOTOR_POLES);
+    CHECK_EQ(console_parse_command("stream\t20"), CMD_STREAM);
+}
+
+static void test_unknown_commands(void)
+{
+    char long_word[200];
+    memset(long_word, 'a', sizeof(long_word) - 1);
+    long_word[sizeof(long_word) - 1] = '\0';
+
+    CHECK_EQ(console_parse_command(""), CMD_UNKNOWN);
+    CHECK_EQ(console_parse_command("   "), CMD_UNKNOWN);
+    CHECK_EQ(console_parse_command("benchx"), CMD_UNKNOWN);
+    CHECK_EQ(console_parse_command("bench_"), CMD_UNKNOWN);
+    CHECK_EQ(console_parse_command(long_word), CMD_UNKNOWN);
+}
+
+static void test_argument(void)
+{
+    CHECK(console_argument("help") == NULL);
+    CHECK(console_argument("help   ") == NULL);
+    CHECK(strcmp(console_argument("  stream \t 20"), "20") == 0);
+    const char *arg = console_argument("espnow pair ble");
+    CHECK(console_argument_is(arg, "pair"));
+    CHECK(!console_argument_is(arg, "pai"));
+    CHECK(console_argument_is(console_argument(arg), "ble"));
+}
+
+static void test_parse_int(void)
+{
+    CHECK_EQ(console_parse_int("42"), 42);
+    CHECK_EQ(console_parse_int("-7 more"), -7);
+    CHECK_EQ(console_parse_int("0\t"), 0);
+    CHECK_EQ(console_parse_int(""), INT_MIN);
+    CHECK_EQ(console_parse_int("x"), INT_MIN);
+    CHECK_EQ(console_parse_int("14x"), INT_MIN);
+    CHECK_EQ(console_parse_int("99999999999999999999"), INT_MIN);
+    CHECK_EQ(console_parse_int("-2147483648"), INT_MIN);
+}
+
+static void test_parse_hex_bytes(void)
+{
+    uint8_t mac[6];
+    CHECK(console_parse_hex_bytes("aa:BB:0c:dd:ee:ff", mac, sizeof(mac), ':'));
+    CHECK_EQ(mac[0], 0xaa);
+    CHECK_EQ(mac[1], 0xbb);
+    CHECK_EQ(mac[5], 0xff);
+    CHECK(console_parse_hex_bytes("aa:bb:cc:dd:ee:ff key", mac, sizeof(mac), ':'));
+    CHECK(!console_parse_hex_bytes("aa:bb:cc:dd:ee", mac, sizeof(mac), ':'));
+    CHECK(!console_parse_hex_bytes("aa:bb:cc:dd:ee:ff:00", mac, sizeof(mac), ':'));
+    CHECK(!console_parse_hex_bytes("aa-bb-cc-dd-ee-ff", mac, sizeof(mac), ':'));
+    CHECK(!console_parse_hex_bytes("aa:bb:cc:dd:ee:fg", mac, sizeof(mac), ':'));
+
+    uint8_t key[4];
+    CHECK(console_parse_hex_bytes("0011aaff", key, sizeof(key), '\0'));
+    CHECK_EQ(key[3], 0xff);
+    CHECK(!console_parse_hex_bytes("0011aa", key, sizeof(key), '\0'));
+}
+
+int main(void)
+{
+    console_parse_init();
+    RUN_TEST(test_commands_are_found);
+    RUN_TEST(test_unknown_commands);
+    RUN_TEST(test_argument);
+    RUN_TEST(test_parse_int);
+    RUN_TEST(test_parse_hex_bytes);
+    return host_test_result();
+}
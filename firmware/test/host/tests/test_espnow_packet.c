@@ -0,0 +1,184 @@
+#include <string.h>
+#include "host_test.h"
+#include "espnow_packet.h"
+
+HOST_TEST_DEFINE
+
+static const uint8_t mac[ESPNOW_MAC_LEN] = { 0x24, 0x6f, 0x28, 0x01, 0x02, 0x03 };
+
+static void test_encode_decode(void)
+{
+    uint8_t payload[ESPNOW_PACKET_MAX_PAYLOAD];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)(i * 3);
+    }
+
+    uint8_t packet[ESPNOW_PACKET_MAX_LEN];
+    size_t len = espnow_packet_encode(ESPNOW_PACKET_TELEMETRY, 0xBEEF, payload, 55, packet, sizeof(packet));
+    CHECK_EQ(len, ESPNOW_PACKET_HEADER_LEN + 55);
+    CHECK_EQ(packet[0], ESPNOW_PACKET_MAGIC);
+    CHECK_EQ(packet[2], 0xEF);
+    CHECK_EQ(packet[3], 0xBE);
+
+    espnow_packet_t decoded;
+    CHECK(espnow_packet_decode(packet, len, &decoded));
+    CHECK_EQ(decoded.type, ESPNOW_PACKET_TELEMETRY);
+    CHECK_EQ(decoded.seq, 0xBEEF);
+    CHECK_EQ(decoded.payload_len, 55);
+    CHECK(decoded.payload == &packet[ESPNOW_PACKET_HEADER_LEN]);
+    CHECK(memcmp(decoded.payload, payload, 55) == 0);
+
+    // Header only, and the largest payload
+    len = espnow_packet_encode(ESPNOW_PACKET_PONG, 1, NULL, 0, packet, sizeof(packet));
+    CHECK_EQ(len, ESPNOW_PACKET_HEADER_LEN);
+    CHECK(espnow_packet_decode(packet, len, &decoded));
+    CHECK_EQ(decoded.payload_len, 0);
+    len = espnow_packet_encode(ESPNOW_PACKET_THROTTLE, 2, payload, sizeof(payload), packet, sizeof(packet));
+    CHECK_EQ(len, ESPNOW_PACKET_MAX_LEN);
+}
+
+static void test_encode_refuses_what_does_not_fit(void)
+{
+    uint8_t payload[ESPNOW_PACKET_MAX_PAYLOAD + 1] = {0};
+    uint8_t packet[ESPNOW_PACKET_MAX_LEN + 1];
+    CHECK_EQ(espnow_packet_encode(ESPNOW_PACKET_TELEMETRY, 0, payload, sizeof(payload), packet, sizeof(packet)), 0);
+    CHECK_EQ(espnow_packet_encode(ESPNOW_PACKET_PING, 0, payload, 4, packet, ESPNOW_PACKET_HEADER_LEN + 3), 0);
+}
+
+static void test_decode_rejects(void)
+{
+    uint8_t packet[ESPNOW_PACKET_MAX_LEN + 1];
+    size_t len = espnow_packet_encode(ESPNOW_PACKET_PING, 7, (const uint8_t *)"abcd", 4, packet, sizeof(packet));
+    espnow_packet_t decoded;
+
+    CHECK(!espnow_packet_decode(NULL, len, &decoded));
+    CHECK(!espnow_packet_decode(packet, ESPNOW_PACKET_HEADER_LEN - 1, &decoded));
+    CHECK(!espnow_packet_decode(packet, ESPNOW_PACKET_MAX_LEN + 1, &decoded));
+
+    packet[0] = 'X';
+    CHECK(!espnow_packet_decode(packet, len, &decoded));
+    packet[0] = ESPNOW_PACKET_MAGIC;
+    packet[1] = 0;
+    CHECK(!espnow_packet_decode(packet, len, &decoded));
+    packet[1] = ESPNOW_PACKET_PONG + 1;
+    CHECK(!espnow_packet_decode(packet, len, &decoded));
+    packet[1] = ESPNOW_PACKET_PING;
+    CHECK(espnow_packet_decode(packet, len, &decoded));
+}
+
+static void test_seq_in_order_and_lost(void)
+{
+    espnow_seq_tracker_t tracker;
+    espnow_seq_reset(&tracker);
+
+    // The first packet starts the count wherever the peer is
+    CHECK(espnow_seq_track(&tracker, 1000));
+    CHECK(tracker.started);
+    CHECK_EQ(tracker.lost, 0);
+    for (uint16_t seq = 1001; seq < 1100; seq++) {
+        CHECK(espnow_seq_track(&tracker, seq));
+    }
+    CHECK_EQ(tracker.received, 100);
+    CHECK_EQ(tracker.lost, 0);
+
+    // Three missing, then one more
+    CHECK(espnow_seq_track(&tracker, 1103));
+    CHECK(espnow_seq_track(&tracker, 1105));
+    CHECK_EQ(tracker.received, 102);
+    CHECK_EQ(tracker.lost, 4);
+    CHECK_EQ(tracker.expected, 1106);
+}
+
+static void test_seq_late_and_duplicate(void)
+{
+    espnow_seq_tracker_t tracker;
+    espnow_seq_reset(&tracker);
+    CHECK(espnow_seq_track(&tracker, 10));
+    CHECK(espnow_seq_track(&tracker, 12));
+    CHECK_EQ(tracker.lost, 1);
+
+    // 11 arrives after 12: dropped, and no longer lost
+    CHECK(!espnow_seq_track(&tracker, 11));
+    CHECK_EQ(tracker.late, 1);
+    CHECK_EQ(tracker.lost, 0);
+
+    // A duplicate of 12 is late too, lost does not go below zero
+    CHECK(!espnow_seq_track(&tracker, 12));
+    CHECK_EQ(tracker.late, 2);
+    CHECK_EQ(tracker.lost, 0);
+    CHECK_EQ(tracker.received, 2);
+    CHECK_EQ(tracker.expected, 13);
+}
+
+static void test_seq_wraps(void)
+{
+    espnow_seq_tracker_t tracker;
+    espnow_seq_reset(&tracker);
+    CHECK(espnow_seq_track(&tracker, 0xFFFE));
+    CHECK(espnow_seq_track(&tracker, 0xFFFF));
+    CHECK(espnow_seq_track(&tracker, 0));
+    CHECK(espnow_seq_track(&tracker, 2));
+    CHECK_EQ(tracker.lost, 1);
+    CHECK_EQ(tracker.resyncs, 0);
+    CHECK(!espnow_seq_track(&tracker, 0xFFFF));
+    CHECK_EQ(tracker.late, 1);
+}
+
+static void test_seq_resyncs_on_restart(void)
+{
+    espnow_seq_tracker_t tracker;
+    espnow_seq_reset(&tracker);
+    CHECK(espnow_seq_track(&tracker, 5000));
+
+    // A jump back within the window is a late packet...
+    CHECK(!espnow_seq_track(&tracker, 5001 - ESPNOW_SEQ_RESYNC_WINDOW));
+    CHECK_EQ(tracker.resyncs, 0);
+
+    // ...further back the peer restarted, nothing counts as lost
+    CHECK(espnow_seq_track(&tracker, 3));
+    CHECK_EQ(tracker.resyncs, 1);
+    CHECK_EQ(tracker.lost, 0);
+    CHECK_EQ(tracker.expected, 4);
+    CHECK(espnow_seq_track(&tracker, 4));
+    CHECK_EQ(tracker.received, 3);
+}
+
+static void test_pairing_messages(void)
+{
+    uint8_t key[ESPNOW_KEY_LEN];
+    for (int i = 0; i < ESPNOW_KEY_LEN; i++) {
+        key[i] = (uint8_t)(0xA0 + i);
+    }
+
+    uint8_t offer[ESPNOW_PAIR_OFFER_LEN];
+    CHECK_EQ(espnow_pair_offer_encode(mac, 6, key, offer, sizeof(offer) - 1), 0);
+    CHECK_EQ(espnow_pair_offer_encode(mac, 6, key, offer, sizeof(offer)), ESPNOW_PAIR_OFFER_LEN);
+    CHECK_EQ(offer[0], ESPNOW_PAIR_MAGIC);
+    CHECK(memcmp(&offer[1], mac, ESPNOW_MAC_LEN) == 0);
+    CHECK_EQ(offer[1 + ESPNOW_MAC_LEN], 6);
+    CHECK(memcmp(&offer[2 + ESPNOW_MAC_LEN], key, ESPNOW_KEY_LEN) == 0);
+
+    uint8_t answer[ESPNOW_PAIR_ANSWER_LEN + 1] = { ESPNOW_PAIR_MAGIC };
+    memcpy(&answer[1], mac, ESPNOW_MAC_LEN);
+    uint8_t peer[ESPNOW_MAC_LEN] = {0};
+    CHECK(espnow_pair_answer_decode(answer, ESPNOW_PAIR_ANSWER_LEN, peer));
+    CHECK(memcmp(peer, mac, ESPNOW_MAC_LEN) == 0);
+    CHECK(!espnow_pair_answer_decode(answer, ESPNOW_PAIR_ANSWER_LEN - 1, peer));
+    CHECK(!espnow_pair_answer_decode(answer, ESPNOW_PAIR_ANSWER_LEN + 1, peer));
+    CHECK(!espnow_pair_answer_decode(NULL, ESPNOW_PAIR_ANSWER_LEN, peer));
+    answer[0] = ESPNOW_PACKET_MAGIC;
+    CHECK(!espnow_pair_answer_decode(answer, ESPNOW_PAIR_ANSWER_LEN, peer));
+}
+
+int main(void)
+{
+    RUN_TEST(test_encode_decode);
+    RUN_TEST(test_encode_refuses_what_does_not_fit);
+    RUN_TEST(test_decode_rejects);
+    RUN_TEST(test_seq_in_order_and_lost);
+    RUN_TEST(test_seq_late_and_duplicate);
+    RUN_TEST(test_seq_wraps);
+    RUN_TEST(test_seq_resyncs_on_restart);
+    RUN_TEST(test_pairing_messages);
+    return host_test_result();
+}
@@ -0,0 +1,152 @@
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "host_drivers.h"
+#include "freertos/semphr.h"
+#include "ble.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "telemetry_decode.h"
+#include "espnow_link.h"
+#include "espnow_rx.h"
+
+HOST_TEST_DEFINE
+
+// ESP-NOW telemetry from the receive callback (the test thread standing in
+// for the Wi-Fi task) through espnow_rx and ble.c to the telemetry
+// listeners, which may block without holding the callback up.
+
+#define MAX_CALLS   64
+
+static SemaphoreHandle_t release;
+static volatile bool hold_listener = false;
+static uint32_t listener_calls = 0;
+static int32_t seen_erpm[MAX_CALLS];
+static const char *listener_task = NULL;
+static uint16_t tx_seq = 0;
+
+static void on_telemetry(const telemetry_snapshot_t *snapshot, void *user_data)
+{
+    (void)user_data;
+    if (listener_calls < MAX_CALLS) {
+        seen_erpm[listener_calls] = snapshot->erpm;
+    }
+    listener_calls++;
+    listener_task = pcTaskGetName(NULL);
+    if (hold_listener) {
+        xSemaphoreTake(release, portMAX_DELAY);
+    }
+}
+
+// One telemetry packet from the peer, with the next sequence number
+static bool receive_telemetry(int32_t erpm)
+{
+    telemetry_snapshot_t s = {0};
+    s.erpm = erpm;
+    s.voltage_c100 = 4000;
+    uint8_t frame[TELEMETRY_FRAME_LEN];
+    telemetry_encode_frame(&s, frame);
+
+    uint8_t packet[ESPNOW_PACKET_MAX_LEN];
+    size_t len = espnow_packet_encode(ESPNOW_PACKET_TELEMETRY, tx_seq++, frame, sizeof(frame),
+                                      packet, sizeof(packet));
+    return host_espnow_receive(packet, len);
+}
+
+static void test_frames_reach_the_listeners(void)
+{
+    uint32_t calls = listener_calls;
+    CHECK(receive_telemetry(12000));
+    host_wait_idle();
+
+    CHECK_EQ(listener_calls, calls + 1);
+    CHECK(listener_task != NULL && strcmp(listener_task, "espnow_rx") == 0);
+    CHECK_EQ(get_latest_erpm(), 12000);
+
+    espnow_rx_stats_t stats;
+    espnow_rx_get_stats(&stats);
+    CHECK_EQ(stats.posted, 1);
+    CHECK_EQ(stats.handled, 1);
+    CHECK_EQ(stats.dropped, 0);
+}
+
+static void test_receive_does_not_wait_for_the_listeners(void)
+{
+    espnow_link_reset_stats();
+    uint32_t calls = listener_calls;
+
+    // The first frame takes the listener, which then hangs
+    hold_listener = true;
+    CHECK(receive_telemetry(20000));
+    host_wait_idle();
+    CHECK_EQ(listener_calls, calls + 1);
+
+    // Meanwhile the callback keeps returning: the queue fills, then drops
+    int queued = 0;
+    for (int i = 1; i <= 20; i++) {
+        queued += receive_telemetry(20000 + i);
+    }
+    CHECK_EQ(queued, ESPNOW_RX_QUEUE_LEN);
+    host_clock_advance_ms(30);
+
+    // Let go: the queued frames follow, oldest first
+    hold_listener = false;
+    xSemaphoreGive(release);
+    host_wait_idle();
+    CHECK_EQ(listener_calls, calls + 1 + ESPNOW_RX_QUEUE_LEN);
+    for (int i = 0; i < ESPNOW_RX_QUEUE_LEN; i++) {
+        CHECK_EQ(seen_erpm[calls + 1 + i], 20001 + i);
+    }
+
+    espnow_link_status_t status;
+    espnow_link_get_status(&status);
+    CHECK_EQ(status.rx_queue.posted, 21);
+    CHECK_EQ(status.rx_queue.dropped, 20 - ESPNOW_RX_QUEUE_LEN);
+    CHECK_EQ(status.rx_queue.handled, 1 + ESPNOW_RX_QUEUE_LEN);
+    CHECK_EQ(status.rx_queue.max_waiting, ESPNOW_RX_QUEUE_LEN);
+    // The stuck listener shows up on the decode side only
+    CHECK(status.rx_queue.handler_max_us >= 30000);
+    CHECK(status.rx_queue.handoff_max_us >= 30000);
+}
+
+static void test_only_new_telemetry_is_posted(void)
+{
+    espnow_link_reset_stats();
+    uint32_t calls = listener_calls;
+
+    uint8_t frame[TELEMETRY_FRAME_LEN] = {0};
+    uint8_t packet[ESPNOW_PACKET_MAX_LEN];
+    size_t len = espnow_packet_encode(ESPNOW_PACKET_TELEMETRY, (uint16_t)(tx_seq - 1), frame, sizeof(frame),
+                                      packet, sizeof(packet));
+    CHECK(!host_espnow_receive(packet, len));          // Repeat of the last one
+    len = espnow_packet_encode(ESPNOW_PACKET_PING, tx_seq++, frame, 4, packet, sizeof(packet));
+    CHECK(!host_espnow_receive(packet, len));          // Not telemetry
+    packet[0] = 'X';
+    CHECK(!host_espnow_receive(packet, len));          // Not a packet
+    tx_seq += 3;
+    CHECK(receive_telemetry(30000));
+    host_wait_idle();
+
+    CHECK_EQ(listener_calls, calls + 1);
+    espnow_link_status_t status;
+    espnow_link_get_status(&status);
+    CHECK_EQ(status.rx_queue.posted, 1);
+    CHECK(status.rx.late >= 1);
+    CHECK(status.rx.lost >= 3);
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    host_nvs_reset();
+    settings_init();
+    release = xSemaphoreCreateBinary();
+    CHECK_EQ(telemetry_register_callback(on_telemetry, NULL), ESP_OK);
+    spp_client_demo_init();
+    host_clock_advance_ms(100);
+
+    RUN_TEST(test_frames_reach_the_listeners);
+    RUN_TEST(test_receive_does_not_wait_for_the_listeners);
+    RUN_TEST(test_only_new_telemetry_is_posted);
+    return host_test_result();
+}
@@ -0,0 +1,193 @@
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "settings.h"
+#include "kinematics.h"
+#include "telemetry.h"
+#include "history.h"
+
+// The min/max pyramids of history.c against a plain rescan of the samples
+// that went in, before and after the ring wraps: chart columns built the
+// way chart_screen.c's push_column builds them, and ranges at every offset
+// around the pyramid groups and the wrap. Frames arrive 30-70 ms apart with
+// the odd link gap, so columns hold different sample counts.
+
+HOST_TEST_DEFINE
+
+#define TOTAL_SAMPLES   (HISTORY_CAPACITY * 5 / 2)
+#define COLUMN_MS       500     // 240 columns over CHART_WINDOW_S
+#define READABLE        (HISTORY_CAPACITY - HISTORY_READ_SLACK)
+
+static int16_t samples[HISTORY_CHANNEL_COUNT][TOTAL_SAMPLES];
+static uint32_t times_ms[TOTAL_SAMPLES];
+static uint32_t published;
+static uint32_t next_ms = 1000;
+static uint32_t rng = 12345;
+
+static uint32_t next_random(void)
+{
+    rng = rng * 1103515245 + 12345;
+    return rng >> 8;
+}
+
+static int16_t random_value(void)
+{
+    // Mostly small steps, now and then a spike for min/max to catch
+    int32_t v = (int32_t)(next_random() % 2001) - 1000;
+    return (int16_t)(next_random() % 37 == 0 ? v * 30 : v);
+}
+
+static void publish_until(uint32_t count)
+{
+    while (published < count) {
+        telemetry_snapshot_t s;
+        memset(&s, 0, sizeof(s));
+        next_ms += 30 + next_random() % 41 + (next_random() % 500 == 0 ? 1500 : 0);
+        s.rx_time_us = (int64_t)next_ms * 1000;
+        s.erpm = (int32_t)(next_random() % 60000);
+        s.current_motor_c100 = random_value();
+        s.current_in_c100 = random_value();
+        s.temp_mos_c100 = random_value();
+        s.temp_motor_c100 = random_value();
+        telemetry_publish(&s);
+
+        uint32_t speed_cm_s = kinematics_erpm_to_mm_s(s.erpm) / 10;
+        samples[HISTORY_CH_SPEED][published] = speed_cm_s > INT16_MAX ? INT16_MAX : (int16_t)speed_cm_s;
+        samples[HISTORY_CH_CURRENT_MOTOR][published] = s.current_motor_c100;
+        samples[HISTORY_CH_CURRENT_IN][published] = s.current_in_c100;
+        samples[HISTORY_CH_TEMP_MOS][published] = s.temp_mos_c100;
+        samples[HISTORY_CH_TEMP_MOTOR][published] = s.temp_motor_c100;
+        times_ms[published] = next_ms;
+        published++;
+    }
+    CHECK_EQ(history_get_count(), published);
+}
+
+static uint32_t oldest_readable(void)
+{
+    return published > READABLE ? published - READABLE : 0;
+}
+
+static void check_range(history_channel_t ch, uint32_t first, uint32_t span)
+{
+    int16_t lo = INT16_MAX;
+    int16_t hi = INT16_MIN;
+    for (uint32_t i = first; i < first + span; i++) {
+        lo = samples[ch][i] < lo ? samples[ch][i] : lo;
+        hi = samples[ch][i] > hi ? samples[ch][i] : hi;
+    }
+
+    int16_t min_out = 0;
+    int16_t max_out = 0;
+    CHECK(history_read_range(ch, first, span, &min_out, &max_out));
+    CHECK_EQ(min_out, lo);
+    CHECK_EQ(max_out, hi);
+}
+
+// First sample at or after time_ms, by a linear scan
+static uint32_t scan_time(uint32_t time_ms)
+{
+    uint32_t i = oldest_readable();
+    while (i < published && times_ms[i] < time_ms) {
+        i++;
+    }
+    return i;
+}
+
+// Every chart column over the readable window, as push_column reads them
+static void check_columns(void)
+{
+    uint32_t first_column = times_ms[oldest_readable()] / COLUMN_MS + 1;
+    uint32_t last_column = times_ms[published - 1] / COLUMN_MS;
+    uint32_t columns = 0;
+    for (uint32_t column = first_column; column < last_column; column++) {
+        uint32_t first, end;
+        CHECK(history_find_time(column * COLUMN_MS, &first));
+        CHECK(history_find_time((column + 1) * COLUMN_MS, &end));
+        CHECK_EQ(first, scan_time(column * COLUMN_MS));
+        CHECK_EQ(end, scan_time((column + 1) * COLUMN_MS));
+        if (end <= first) {
+            continue;   // A link gap, drawn empty
+        }
+        for (int ch = 0; ch < HISTORY_CHANNEL_COUNT; ch++) {
+            check_range(ch, first, end - first);
+        }
+        columns++;
+    }
+    CHECK(columns > 100);
+}
+
+static void test_columns_before_the_wrap(void)
+{
+    publish_until(HISTORY_CAPACITY / 2 + 7);
+    check_columns();
+}
+
+static void test_columns_across_the_wrap(void)
+{
+    publish_until(TOTAL_SAMPLES);
+    // The readable window holds a multiple of the capacity, where the ring wraps
+    uint32_t wrap = (published / HISTORY_CAPACITY) * HISTORY_CAPACITY;
+    CHECK(wrap > oldest_readable() && wrap < published);
+    check_columns();
+}
+
+static void test_ranges_around_groups_and_the_wrap(void)
+{
+    uint32_t wrap = (published / HISTORY_CAPACITY) * HISTORY_CAPACITY;
+    for (uint32_t first = wrap - 2 * HISTORY_L2_FACTOR; first < wrap + HISTORY_L2_FACTOR; first++) {
+        for (uint32_t span = 1; span <= 3 * HISTORY_L2_FACTOR + 1; span++) {
+            check_range(HISTORY_CH_CURRENT_MOTOR, first, span);
+        }
+    }
+    // The whole readable window in one read
+    check_range(HISTORY_CH_TEMP_MOS, oldest_readable(), READABLE);
+}
+
+static void test_unreadable_ranges_are_refused(void)
+{
+    int16_t lo, hi;
+    uint32_t oldest = oldest_readable();
+    CHECK(!history_read_range(HISTORY_CH_SPEED, oldest - 1, 10, &lo, &hi));
+    CHECK(!history_read_range(HISTORY_CH_SPEED, published - 5, 6, &lo, &hi));
+    CHECK(!history_read_range(HISTORY_CH_SPEED, oldest, 0, &lo, &hi));
+    CHECK(!history_read_range(HISTORY_CHANNEL_COUNT, oldest, 10, &lo, &hi));
+    CHECK(history_read_range(HISTORY_CH_SPEED, published - 5, 5, &lo, &hi));
+}
+
+static void test_find_time(void)
+{
+    uint32_t oldest = oldest_readable();
+    uint32_t index = 0;
+
+    // Exact receive times and the gaps between them
+    for (uint32_t i = oldest + 1; i < published; i += 97) {
+        CHECK(history_find_time(times_ms[i], &index));
+        CHECK_EQ(index, i);
+        CHECK(history_find_time(times_ms[i - 1] + 1, &index));
+        CHECK_EQ(index, i);
+    }
+
+    // Past the newest sample there is none yet
+    CHECK(history_find_time(times_ms[published - 1] + 1, &index));
+    CHECK_EQ(index, published);
+
+    // Samples from before the oldest readable one are gone
+    CHECK(!history_find_time(times_ms[oldest], &index));
+    CHECK(!history_find_time(1000, &index));
+}
+
+int main(void)
+{
+    host_nvs_reset();
+    settings_init();
+    CHECK_EQ(kinematics_init(), ESP_OK);
+    CHECK_EQ(history_init(), ESP_OK);
+
+    RUN_TEST(test_columns_before_the_wrap);
+    RUN_TEST(test_columns_across_the_wrap);
+    RUN_TEST(test_ranges_around_groups_and_the_wrap);
+    RUN_TEST(test_unreadable_ranges_are_refused);
+    RUN_TEST(test_find_time);
+    return host_test_result();
+}
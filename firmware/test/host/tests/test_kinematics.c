@@ -0,0 +1,152 @@
+#include <math.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "settings.h"
+#include "vesc_config.h"
+#include "kinematics.h"
+#include "telemetry.h"
+#include "odometer.h"
+
+HOST_TEST_DEFINE
+
+// Wheel surface speed in mm/s, in double precision
+static double reference_mm_s(const vesc_config_t *config, int32_t erpm)
+{
+    double wheel_rpm = fabs((double)erpm) / config->motor_poles * config->motor_pulley / config->wheel_pulley;
+    return wheel_rpm * M_PI * config->wheel_diameter_mm / 60.0;
+}
+
+static void publish(int64_t rx_time_us, int32_t erpm)
+{
+    telemetry_snapshot_t snapshot = {0};
+    snapshot.rx_time_us = rx_time_us;
+    snapshot.erpm = erpm;
+    telemetry_publish(&snapshot);
+}
+
+static void test_factor_tracks_saved_config(void)
+{
+    vesc_config_t config;
+    vesc_config_load(&config);
+    // 15/33 pulleys, 115 mm wheels, 14 poles: 115 pi / 60 * 15 / 33 / 14 mm
+    CHECK_NEAR(kinematics_get_nm_per_erpm_s(), 1e6 * reference_mm_s(&config, 1), 1);
+
+    config.wheel_diameter_mm = 90;
+    config.motor_poles = 28;
+    CHECK_EQ(vesc_config_save(&config), ESP_OK);
+    CHECK_NEAR(kinematics_get_nm_per_erpm_s(), 1e6 * reference_mm_s(&config, 1), 1);
+
+    // Unusable geometry stops the speed instead of dividing by zero
+    config.motor_poles = 0;
+    kinematics_apply_config(&config);
+    CHECK_EQ(kinematics_get_nm_per_erpm_s(), 0);
+    CHECK_EQ(kinematics_erpm_to_mm_s(30000), 0);
+
+    config.motor_poles = 28;
+    kinematics_apply_config(&config);
+}
+
+static void test_speed_matches_reference(void)
+{
+    vesc_config_t config;
+    vesc_config_load(&config);
+    for (int32_t erpm = -60000; erpm <= 60000; erpm += 777) {
+        CHECK_NEAR(kinematics_erpm_to_mm_s(erpm), reference_mm_s(&config, erpm), 1.0);
+    }
+
+    publish(1000000, 40000);
+    double kmh = reference_mm_s(&config, 40000) * 3600 / 1e6;
+    CHECK_EQ(kinematics_get_speed(false), (int32_t)kmh);
+    CHECK_EQ(kinematics_get_speed(true), (int32_t)(kmh / 1.609344));
+    CHECK_EQ(vesc_config_get_speed(&config), config.speed_unit_mph ? (int32_t)(kmh / 1.609344) : (int32_t)kmh);
+}
+
+static void test_distance_integration(void)
+{
+    vesc_config_t config;
+    vesc_config_load(&config);
+
+    // One minute at constant speed, 20 frames a second
+    uint64_t start_mm = odometer_get_trip_mm();
+    int64_t t = 10000000;
+    publish(t, 0);
+    for (int i = 0; i < 20 * 60; i++) {
+        t += 50000;
+        publish(t, 25000);
+    }
+    double expected_mm = reference_mm_s(&config, 25000) * (60.0 - 0.025);   // First gap is a ramp
+    CHECK_NEAR(odometer_get_trip_mm() - start_mm, expected_mm, 2.0);
+
+    // A gap longer than the limit is a link loss, not distance
+    start_mm = odometer_get_trip_mm();
+    t += (KINEMATICS_MAX_FRAME_GAP_MS + 1) * 1000;
+    publish(t, 25000);
+    CHECK_EQ(odometer_get_trip_mm() - start_mm, 0);
+}
+
+// A ride of accelerating, cruising with some variation and braking
+static int32_t trace_erpm(double t_s)
+{
+    if (t_s < 60) {
+        return (int32_t)(t_s / 60 * 40000);
+    }
+    if (t_s < 540) {
+        return (int32_t)(35000 + 5000 * sin((t_s - 60) / 7));
+    }
+    return t_s < 600 ? (int32_t)((600 - t_s) / 60 * 35000) : 0;
+}
+
+// The same trace through the per-frame integration and through the 1 Hz
+// task it replaced: whole km/h from vesc_config_get_speed once a second,
+// summed into a float trip in km. Truncating to whole km/h loses up to
+// 1 km/h at any speed, always short: ~6% with the 90 mm, 28 pole setup
+// left by test_factor_tracks_saved_config.
+static void test_per_frame_beats_1hz_integration(void)
+{
+    vesc_config_t config;
+    vesc_config_load(&config);
+    vesc_config_t config_kmh = config;
+    config_kmh.speed_unit_mph = false;
+
+    uint64_t start_mm = odometer_get_trip_mm();
+    int64_t t_us = 100000000;
+    double prev_mm_s = reference_mm_s(&config, 0);
+    double expected_mm = 0;
+    float old_trip_km = 0;
+    publish(t_us, 0);
+    for (int i = 1; i <= 20 * 600; i++) {
+        t_us += 50000;
+        int32_t erpm = trace_erpm(i / 20.0);
+        publish(t_us, erpm);
+        double mm_s = reference_mm_s(&config, erpm);
+        expected_mm += (prev_mm_s + mm_s) / 2 * 0.05;
+        prev_mm_s = mm_s;
+        if (i % 20 == 0) {
+            int32_t speed_kmh = vesc_config_get_speed(&config_kmh);
+            if (speed_kmh > 0) {
+                old_trip_km += speed_kmh / 3600.0f;
+            }
+        }
+    }
+
+    double new_error = fabs((double)(odometer_get_trip_mm() - start_mm) - expected_mm) / expected_mm;
+    double old_error = fabs(old_trip_km * 1e6 - expected_mm) / expected_mm;
+    printf("  %.0f m: per frame off by %.4f%%, 1 Hz whole km/h by %.2f%%\n",
+           expected_mm / 1000, new_error * 100, old_error * 100);
+    CHECK(new_error < 0.0001);
+    CHECK(old_error > 0.01);
+    CHECK(old_trip_km * 1e6 < expected_mm);
+}
+
+int main(void)
+{
+    host_nvs_reset();
+    settings_init();
+    CHECK_EQ(kinematics_init(), ESP_OK);
+
+    RUN_TEST(test_factor_tracks_saved_config);
+    RUN_TEST(test_speed_matches_reference);
+    RUN_TEST(test_distance_integration);
+    RUN_TEST(test_per_frame_beats_1hz_integration);
+    return host_test_result();
+}
@@ -0,0 +1,118 @@
+#include "host_test.h"
+#include "host_shim.h"
+#include "host_ble.h"
+#include "ble.h"
+#include "settings.h"
+#include "throttle.h"
+#include "latency_bench.h"
+
+HOST_TEST_DEFINE
+
+#define CAL_LOW     500
+#define CAL_HIGH    3500
+
+// One ADC loop plus one send period, with room for a step that lands just
+// after a read. On the virtual clock every ADC read takes 1 ms.
+#define WORST_CASE_US   150000
+
+static void run_to_completion(uint32_t steps, uint32_t period_ms, latency_bench_result_t *result)
+{
+    CHECK_EQ(latency_bench_start(steps, period_ms), ESP_OK);
+    uint32_t timeout_ms = (steps + 2) * period_ms * 3 / 2 + 1000;
+    for (uint32_t waited = 0; latency_bench_is_active() && waited < timeout_ms; waited += 100) {
+        host_clock_advance_ms(100);
+    }
+    CHECK(!latency_bench_is_active());
+    latency_bench_get_result(result);
+}
+
+// One line per configuration, the numbers bench_latency prints on target
+static void print_result(const latency_bench_result_t *result)
+{
+    printf("  period %4lu ms: %3lu measured, %lu missed, min %lu.%lu p50 %lu.%lu p99 %lu.%lu max %lu.%lu ms\n",
+           (unsigned long)result->period_ms, (unsigned long)result->measured, (unsigned long)result->missed,
+           (unsigned long)result->min_us / 1000, (unsigned long)(result->min_us % 1000) / 100,
+           (unsigned long)result->p50_us / 1000, (unsigned long)(result->p50_us % 1000) / 100,
+           (unsigned long)result->p99_us / 1000, (unsigned long)(result->p99_us % 1000) / 100,
+           (unsigned long)result->max_us / 1000, (unsigned long)(result->max_us % 1000) / 100);
+}
+
+static void test_refuses_bad_arguments(void)
+{
+    CHECK_EQ(latency_bench_start(0, LATENCY_BENCH_DEFAULT_PERIOD_MS), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(latency_bench_start(LATENCY_BENCH_MAX_STEPS + 1, LATENCY_BENCH_DEFAULT_PERIOD_MS), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(latency_bench_start(10, LATENCY_BENCH_MIN_PERIOD_MS - 1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(latency_bench_start(10, LATENCY_BENCH_MAX_PERIOD_MS + 1), ESP_ERR_INVALID_ARG);
+}
+
+static void test_histogram_per_period(void)
+{
+    static const uint32_t periods_ms[] = { LATENCY_BENCH_MIN_PERIOD_MS, LATENCY_BENCH_DEFAULT_PERIOD_MS, 1000 };
+    for (size_t p = 0; p < sizeof(periods_ms) / sizeof(periods_ms[0]); p++) {
+        latency_bench_result_t result;
+        run_to_completion(LATENCY_BENCH_DEFAULT_STEPS, periods_ms[p], &result);
+        print_result(&result);
+
+        CHECK(!result.aborted);
+        CHECK_EQ(result.steps, LATENCY_BENCH_DEFAULT_STEPS);
+        CHECK_EQ(result.measured + result.missed, LATENCY_BENCH_DEFAULT_STEPS);
+        CHECK_EQ(result.missed, 0);
+        CHECK(result.min_us > 0);
+        CHECK(result.min_us <= result.p50_us);
+        CHECK(result.p50_us <= result.p99_us);
+        CHECK(result.p99_us <= result.max_us);
+        CHECK(result.max_us < WORST_CASE_US);
+
+        uint32_t total = 0;
+        for (int i = 0; i < LATENCY_BENCH_BUCKETS; i++) {
+            total += result.histogram[i];
+        }
+        CHECK_EQ(total, result.measured);
+    }
+}
+
+static void test_connect_aborts_the_run(void)
+{
+    CHECK_EQ(latency_bench_start(LATENCY_BENCH_DEFAULT_STEPS, LATENCY_BENCH_DEFAULT_PERIOD_MS), ESP_OK);
+    host_clock_advance_ms(2000);
+    host_ble_connect(BLE_LINK_PRIMARY);
+    host_clock_advance_ms(200);
+    CHECK(!latency_bench_is_active());
+
+    latency_bench_result_t result;
+    latency_bench_get_result(&result);
+    CHECK(result.aborted);
+    CHECK(result.measured < LATENCY_BENCH_DEFAULT_STEPS);
+
+    // And no run starts while the receiver is there
+    CHECK_EQ(latency_bench_start(10, LATENCY_BENCH_DEFAULT_PERIOD_MS), ESP_ERR_INVALID_STATE);
+    host_ble_disconnect(BLE_LINK_PRIMARY);
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    host_random_seed(64);
+    host_nvs_reset();
+    settings_init();
+
+    // A calibrated hand controller, as after calibrate_throttle
+    settings_t settings;
+    settings_get(&settings);
+    settings.throttle_calibrated = 1;
+    settings.throttle_min = CAL_LOW;
+    settings.throttle_max = CAL_HIGH;
+    settings.brake_min = CAL_LOW;
+    settings.brake_max = CAL_HIGH;
+    CHECK_EQ(settings_save(&settings), ESP_OK);
+
+    host_test_run_in_task(adc_start_task);
+    spp_client_demo_init();
+    host_clock_advance_ms(500);
+    CHECK(throttle_is_calibrated());
+
+    RUN_TEST(test_refuses_bad_arguments);
+    RUN_TEST(test_histogram_per_period);
+    RUN_TEST(test_connect_aborts_the_run);
+    return host_test_result();
+}
@@ -0,0 +1,127 @@
+#include "host_test.h"
+#include "host_shim.h"
+#include "host_ble.h"
+#include "link_quality.h"
+#include "esp_bt.h"
+
+HOST_TEST_DEFINE
+
+#define NOTIFY_MS   30
+
+static link_quality_event_t last_event;
+static int events = 0;
+
+static void on_event(const link_quality_event_t *event, void *user_data)
+{
+    (void)user_data;
+    last_event = *event;
+    events++;
+}
+
+// Seconds of a link with a notify every NOTIFY_MS, the RSSI read once a
+// second and the update after it, like the link stats task. Every
+// drop_every-th notify is lost, 0 for none.
+static void run(ble_link_t link, int seconds, int rssi, int drop_every)
+{
+    int n = 0;
+    for (int s = 0; s < seconds; s++) {
+        for (int t = 0; t < 1000; t += NOTIFY_MS) {
+            host_clock_advance_ms(NOTIFY_MS);
+            if (drop_every == 0 || ++n % drop_every != 0) {
+                link_quality_on_notify(link);
+            }
+        }
+        link_quality_on_rssi(link, rssi);
+        link_quality_update();
+    }
+}
+
+static esp_power_level_t tx_level(ble_link_t link)
+{
+    return host_bt_tx_power((esp_ble_power_type_t)(ESP_BLE_PWR_TYPE_CONN_HDL0 + ble_transport_conn_handle(link)));
+}
+
+static void test_strong_link_scores_and_lowers_power(void)
+{
+    host_ble_connect(BLE_LINK_PRIMARY);
+    link_quality_on_connected(BLE_LINK_PRIMARY);
+    run(BLE_LINK_PRIMARY, 2, -44, 0);
+
+    link_quality_stats_t stats;
+    link_quality_get_stats(BLE_LINK_PRIMARY, &stats);
+    CHECK(stats.connected);
+    CHECK_EQ(stats.state, LINK_QUALITY_GOOD);
+    CHECK_EQ(stats.score, (-44 + 100) * 100 / 70);
+    CHECK_NEAR(stats.period_us, NOTIFY_MS * 1000, 100);
+    CHECK_EQ(stats.lost, 0);
+    CHECK_EQ(link_quality_tx_power_dbm(BLE_LINK_PRIMARY), 9);
+    CHECK_EQ(tx_level(BLE_LINK_PRIMARY), LINK_QUALITY_TX_DEFAULT_LEVEL);
+
+    // One step down per hold time above the lower threshold
+    run(BLE_LINK_PRIMARY, LINK_QUALITY_TX_LOWER_HOLD_S, -44, 0);
+    CHECK_EQ(tx_level(BLE_LINK_PRIMARY), LINK_QUALITY_TX_DEFAULT_LEVEL - 1);
+    CHECK_EQ(link_quality_tx_power_dbm(BLE_LINK_PRIMARY), 6);
+    CHECK_EQ(events, 0);
+}
+
+static void test_lost_notifies_are_counted(void)
+{
+    link_quality_stats_t before, after;
+    link_quality_get_stats(BLE_LINK_PRIMARY, &before);
+    run(BLE_LINK_PRIMARY, 3, -44, 4);
+    link_quality_get_stats(BLE_LINK_PRIMARY, &after);
+
+    uint32_t sent = 3 * ((1000 + NOTIFY_MS - 1) / NOTIFY_MS);
+    CHECK_NEAR(after.lost - before.lost, sent / 4, 2);
+    CHECK(after.loss_pct_x10 > 100);
+    CHECK(after.score < before.score);
+}
+
+static void test_weak_link_degrades_and_raises_power(void)
+{
+    // Filtered RSSI falls over a few readings
+    run(BLE_LINK_PRIMARY, 12, -88, 0);
+    CHECK(events >= 1);
+    CHECK_EQ(last_event.state, LINK_QUALITY_DEGRADED);
+    CHECK_EQ(last_event.previous, LINK_QUALITY_GOOD);
+    CHECK(tx_level(BLE_LINK_PRIMARY) > LINK_QUALITY_TX_DEFAULT_LEVEL);
+
+    run(BLE_LINK_PRIMARY, 6, -97, 0);
+    CHECK_EQ(last_event.state, LINK_QUALITY_CRITICAL);
+    CHECK_EQ(tx_level(BLE_LINK_PRIMARY), LINK_QUALITY_TX_MAX_LEVEL);
+
+    // Recovery needs the exit threshold, not just the enter one
+    run(BLE_LINK_PRIMARY, 10, -40, 0);
+    CHECK_EQ(last_event.state, LINK_QUALITY_GOOD);
+}
+
+static void test_new_connection_starts_at_default_power(void)
+{
+    host_ble_disconnect(BLE_LINK_PRIMARY);
+    link_quality_on_disconnected(BLE_LINK_PRIMARY);
+    link_quality_update();
+    CHECK_EQ(link_quality_score(BLE_LINK_PRIMARY), 0);
+
+    // The BMS link gets the handle the primary had, then the primary a new one
+    host_ble_connect(BLE_LINK_BMS);
+    link_quality_on_connected(BLE_LINK_BMS);
+    host_ble_connect(BLE_LINK_PRIMARY);
+    link_quality_on_connected(BLE_LINK_PRIMARY);
+    run(BLE_LINK_BMS, 1, -60, 0);
+    CHECK_EQ(tx_level(BLE_LINK_BMS), LINK_QUALITY_TX_DEFAULT_LEVEL);
+    CHECK_EQ(tx_level(BLE_LINK_PRIMARY), LINK_QUALITY_TX_DEFAULT_LEVEL);
+    CHECK(ble_transport_conn_handle(BLE_LINK_BMS) != ble_transport_conn_handle(BLE_LINK_PRIMARY));
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    host_clock_advance_ms(1000);
+    link_quality_register_callback(on_event, NULL);
+
+    RUN_TEST(test_strong_link_scores_and_lowers_power);
+    RUN_TEST(test_lost_notifies_are_counted);
+    RUN_TEST(test_weak_link_degrades_and_raises_power);
+    RUN_TEST(test_new_connection_starts_at_default_power);
+    return host_test_result();
+}
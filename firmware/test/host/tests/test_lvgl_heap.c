@@ -0,0 +1,211 @@
+#include <string.h>
+#include <stdlib.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "lvgl.h"
+#include "lcd.h"
+#include "ui.h"
+#include "screens.h"
+#include "lvgl_heap.h"
+
+HOST_TEST_DEFINE
+
+// The LVGL heap under the home screen's update pattern, one case per run
+// since the heap is set up once per boot:
+//
+//   churn         hours of 50 Hz label updates and 1 Hz stats, with a
+//                 notice popping up now and then, on the virtual clock
+//   init_failure  no pool fits, every allocation fails without retrying
+
+#define FRAME_MS            20
+#define WARMUP_S            60
+#define RIDE_S              (3 * 3600)
+#define RENDER_EVERY_S      10
+#define NOTICE_EVERY_S      37
+
+// Room for text length and object count to wobble between two snapshots
+#define USED_SLACK_BYTES    512
+
+static lv_disp_draw_buf_t draw_buf;
+static lv_disp_drv_t disp_drv;
+
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    (void)area;
+    (void)color_map;
+    lv_disp_flush_ready(drv);
+}
+
+static void display_init(void)
+{
+    lv_init();
+    size_t pixels = LV_HOR_RES_MAX * (LV_VER_RES_MAX / 8);
+    lv_disp_draw_buf_init(&draw_buf, malloc(pixels * sizeof(lv_color_t)), NULL, pixels);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.flush_cb = flush_cb;
+    disp_drv.draw_buf = &draw_buf;
+    disp_drv.hor_res = LV_HOR_RES_MAX;
+    disp_drv.ver_res = LV_VER_RES_MAX;
+    lv_disp_drv_register(&disp_drv);
+}
+
+static size_t pool_used(const lvgl_heap_stats_t *stats, int pool)
+{
+    return stats->pools[pool].size - stats->pools[pool].free;
+}
+
+static void print_stats(const char *label, const lvgl_heap_stats_t *stats)
+{
+    printf("  %-8s %lu allocs, %lu reallocs, %lu from the slab, %lu failed\n", label,
+           (unsigned long)stats->allocs, (unsigned long)stats->reallocs,
+           (unsigned long)stats->slab_allocs, (unsigned long)stats->failed);
+    for (int i = 0; i < stats->pool_count; i++) {
+        const lvgl_heap_pool_stats_t *pool = &stats->pools[i];
+        printf("           %-8s %6lu used, peak %6lu, largest free %6lu, fragmentation %u%%\n", pool->name,
+               (unsigned long)pool_used(stats, i), (unsigned long)(pool->size - pool->min_free),
+               (unsigned long)pool->largest_free, pool->fragmentation_pct);
+    }
+    for (int i = 0; i < LVGL_SLAB_CLASS_COUNT; i++) {
+        printf("           slab %3u: %3u of %3u used, peak %3u\n", stats->slab[i].block_size,
+               stats->slab[i].used, stats->slab[i].blocks, stats->slab[i].peak);
+    }
+}
+
+// What the updater and the stats page write, lengths changing as they go
+static void update_fast_labels(uint32_t frame)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%lu", (unsigned long)(frame / 7 % 120));
+    lv_label_set_text(objects.speedlabel, text);
+    snprintf(text, sizeof(text), "%lu.%luV", (unsigned long)(36 + frame / 50 % 14), (unsigned long)(frame % 10));
+    lv_label_set_text(objects.display_voltage, text);
+}
+
+static void update_slow_labels(lv_obj_t *stats_label, uint32_t second)
+{
+    char text[16];
+    snprintf(text, sizeof(text), "%lu.%lu", (unsigned long)(second / 90), (unsigned long)(second / 9 % 10));
+    lv_label_set_text(objects.odometer, text);
+    snprintf(text, sizeof(text), "%lu%%", (unsigned long)(100 - second * 100 / RIDE_S));
+    lv_label_set_text(objects.skate_battery_text, text);
+
+    // Several lines, too long for the slab
+    char stats[256];
+    int len = snprintf(stats, sizeof(stats), "Trip %lu.%lu km\nAvg %lu km/h\nMax %lu km/h\nEnergy %lu Wh\n",
+                       (unsigned long)(second / 90), (unsigned long)(second / 9 % 10),
+                       (unsigned long)(15 + second % 11), (unsigned long)(30 + second % 23),
+                       (unsigned long)(second / 20));
+    for (uint32_t i = 0; i < second % 5 && len < (int)sizeof(stats) - 24; i++) {
+        len += snprintf(stats + len, sizeof(stats) - len, "Cell %lu 3.%03lu V\n",
+                        (unsigned long)i, (unsigned long)(second * 7 % 1000));
+    }
+    lv_label_set_text(stats_label, stats);
+}
+
+static void test_churn(void)
+{
+    display_init();
+    ui_init();
+    lv_scr_load(objects.home_screen);
+    lv_obj_t *stats_label = lv_label_create(objects.home_screen);
+    lv_obj_t *notice = NULL;
+
+    lvgl_heap_stats_t warm;
+    memset(&warm, 0, sizeof(warm));
+    uint32_t frames_per_s = 1000 / FRAME_MS;
+    for (uint32_t frame = 0; frame < RIDE_S * frames_per_s; frame++) {
+        update_fast_labels(frame);
+        if (frame % frames_per_s == 0) {
+            uint32_t second = frame / frames_per_s;
+            update_slow_labels(stats_label, second);
+            // A notice stays up for a few seconds, made and dropped whole
+            if (second % NOTICE_EVERY_S == 0) {
+                notice = lv_label_create(objects.home_screen);
+                lv_label_set_text_fmt(notice, "Low battery: %lu%% left", (unsigned long)(second % 100));
+            } else if (second % NOTICE_EVERY_S == 5 && notice != NULL) {
+                lv_obj_del(notice);
+                notice = NULL;
+            }
+            if (second % RENDER_EVERY_S == 0) {
+                lv_refr_now(NULL);
+            }
+            if (second == WARMUP_S) {
+                lvgl_heap_get_stats(&warm);
+            }
+        }
+        host_clock_advance_ms(FRAME_MS);
+    }
+
+    lvgl_heap_stats_t end;
+    lvgl_heap_get_stats(&end);
+    print_stats("warm", &warm);
+    print_stats("end", &end);
+
+    // The churn really went through the heap; set_text frees the old text
+    // and allocates the new one rather than resizing it
+    CHECK(end.allocs - warm.allocs > (RIDE_S - WARMUP_S) * frames_per_s * 2);
+    CHECK_EQ(end.allocs - end.frees, warm.allocs - warm.frees);
+    CHECK(end.allocs_per_s > frames_per_s);
+    CHECK_EQ(end.failed, 0);
+
+    for (int i = 0; i < end.pool_count; i++) {
+        // Nothing builds up over the hours...
+        CHECK(pool_used(&end, i) <= pool_used(&warm, i) + USED_SLACK_BYTES);
+        // ...the peak is the one of the first minute, bar a notice...
+        CHECK(end.pools[i].min_free + USED_SLACK_BYTES >= warm.pools[i].min_free);
+        // ...and the free space stays in one piece
+        CHECK(end.pools[i].fragmentation_pct <= 10);
+    }
+    for (int i = 0; i < LVGL_SLAB_CLASS_COUNT; i++) {
+        CHECK(end.slab[i].peak < end.slab[i].blocks);
+        CHECK_EQ(end.slab[i].full, 0);
+        CHECK(end.slab[i].peak <= warm.slab[i].peak + 2);
+    }
+}
+
+static void test_init_failure(void)
+{
+    // The slab still fits, no pool does
+    host_heap_caps_set_largest_block(lvgl_slab_required_size());
+    uint32_t blocks_before = host_heap_caps_live_blocks();
+
+    CHECK(lvgl_heap_alloc(32) == NULL);
+    CHECK_EQ(host_heap_caps_live_blocks(), blocks_before);
+
+    // Memory coming back later does not bring the heap up mid-run
+    host_heap_caps_set_largest_block(0);
+    for (int i = 0; i < 100; i++) {
+        CHECK(lvgl_heap_alloc(32 + i) == NULL);
+        CHECK(lvgl_heap_realloc(NULL, 2000) == NULL);
+    }
+    CHECK_EQ(host_heap_caps_live_blocks(), blocks_before);
+
+    lvgl_heap_stats_t stats;
+    lvgl_heap_get_stats(&stats);
+    CHECK_EQ(stats.pool_count, 0);
+    CHECK_EQ(stats.allocs, 0);
+    CHECK_EQ(stats.failed, 201);
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(void);
+} cases[] = {
+    { "churn", test_churn },
+    { "init_failure", test_init_failure },
+};
+
+int main(int argc, char **argv)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (argc > 1 && strcmp(argv[1], cases[i].name) == 0) {
+            int before = host_test_failures;
+            cases[i].fn();
+            printf("%s %s\n", host_test_failures == before ? "PASS" : "FAIL", cases[i].name);
+            return host_test_result();
+        }
+    }
+    fprintf(stderr, "usage: %s churn|init_failure\n", argv[0]);
+    return EXIT_FAILURE;
+}
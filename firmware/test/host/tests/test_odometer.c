@@ -0,0 +1,263 @@
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "odometer.h"
+#include "settings.h"
+
+// The record log of odometer.c on the shim's storage partition: recovery
+// after a write torn by a brownout, the wrap over ODOMETER_LOG_SECTORS,
+// the erase count across restarts, and the migration of the old float
+// trip counter. odometer_init is called again to stand in for a restart;
+// it reads everything back from flash.
+
+HOST_TEST_DEFINE
+
+#define MM_PER_KM   1000000ULL
+
+static const esp_partition_t *storage(void)
+{
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                    ODOMETER_PARTITION_LABEL);
+}
+
+static void fresh_log(void)
+{
+    host_partition_reset();
+    host_nvs_reset();
+    CHECK_EQ(settings_init(), ESP_OK);
+    CHECK_EQ(odometer_init(), ESP_OK);
+    odometer_reset_trip();
+}
+
+// Appends one record, 1 m further than the last
+static void append(void)
+{
+    odometer_add_distance_mm(1000);
+    CHECK_EQ(odometer_flush(), ESP_OK);
+}
+
+static odometer_status_t status(void)
+{
+    odometer_status_t s;
+    odometer_get_status(&s);
+    return s;
+}
+
+// What a brownout leaves: the first bytes of a record programmed, the rest
+// still erased
+static void tear_slot(uint32_t sector, uint32_t slot, uint32_t seq)
+{
+    const uint8_t head[12] = {
+        0x0E, 0x0D, 1, 0, seq & 0xFF, (seq >> 8) & 0xFF, (seq >> 16) & 0xFF, seq >> 24, 0x10, 0x27, 0, 0,
+    };
+    size_t offset = ODOMETER_LOG_OFFSET + sector * ODOMETER_SECTOR_SIZE + slot * ODOMETER_RECORD_SIZE;
+    CHECK_EQ(esp_partition_write(storage(), offset, head, sizeof(head)), ESP_OK);
+}
+
+static void restart(void)
+{
+    CHECK_EQ(odometer_init(), ESP_OK);
+}
+
+static void store_legacy_trip(float trip)
+{
+    nvs_handle_t handle;
+    CHECK_EQ(nvs_open(ODOMETER_LEGACY_NVS_NAMESPACE, NVS_READWRITE, &handle), ESP_OK);
+    CHECK_EQ(nvs_set_blob(handle, ODOMETER_LEGACY_NVS_KEY, &trip, sizeof(trip)), ESP_OK);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static void set_mph(bool mph)
+{
+    settings_t settings;
+    settings_get(&settings);
+    settings.speed_unit_mph = mph;
+    CHECK_EQ(settings_save(&settings), ESP_OK);
+}
+
+static void test_legacy_trip_in_km(void)
+{
+    host_partition_reset();
+    host_nvs_reset();
+    CHECK_EQ(settings_init(), ESP_OK);
+    store_legacy_trip(12.5f);
+    CHECK_EQ(odometer_init(), ESP_OK);
+    CHECK_EQ(odometer_get_trip_mm(), 12500000);
+    CHECK_EQ(odometer_get_total_mm(), 12500000);
+    CHECK_EQ(status().seq, 1);
+
+    // Written to the log, so it is not migrated a second time
+    store_legacy_trip(99.0f);
+    restart();
+    CHECK_EQ(odometer_get_trip_mm(), 12500000);
+}
+
+static void test_legacy_trip_in_miles(void)
+{
+    host_partition_reset();
+    host_nvs_reset();
+    CHECK_EQ(settings_init(), ESP_OK);
+    set_mph(true);
+    store_legacy_trip(10.0f);
+    CHECK_EQ(odometer_init(), ESP_OK);
+    CHECK_EQ(odometer_get_trip_mm(), 16093440);
+    CHECK_EQ(odometer_get_total_mm(), 16093440);
+    restart();
+    CHECK_EQ(odometer_get_total_mm(), 16093440);
+}
+
+static void test_no_legacy_trip_starts_at_zero(void)
+{
+    host_partition_reset();
+    host_nvs_reset();
+    CHECK_EQ(settings_init(), ESP_OK);
+    store_legacy_trip(0.0f);
+    CHECK_EQ(odometer_init(), ESP_OK);
+    CHECK_EQ(odometer_get_total_mm(), 0);
+    odometer_status_t s = status();
+    CHECK_EQ(s.seq, 1);
+    CHECK_EQ(s.sector, 0);
+    CHECK_EQ(s.next_slot, 1);
+    CHECK_EQ(s.erase_count, 1);
+    CHECK(s.flash_ok);
+}
+
+static void test_torn_write_in_slot_n(void)
+{
+    fresh_log();
+    uint64_t total = odometer_get_total_mm();
+    for (int i = 0; i < 8; i++) {
+        append();
+    }
+    odometer_status_t before = status();
+    CHECK_EQ(before.sector, 0);
+
+    // The next record was being written when the power went
+    tear_slot(0, before.next_slot, before.seq + 1);
+    odometer_add_distance_mm(5000);     // Lost with the record
+    restart();
+    odometer_status_t after = status();
+    CHECK_EQ(after.seq, before.seq);
+    CHECK_EQ(after.sector, 0);
+    // The torn slot is stepped over, never written again
+    CHECK_EQ(after.next_slot, before.next_slot + 1);
+    CHECK_EQ(odometer_get_total_mm(), total + 8000);
+
+    append();
+    CHECK_EQ(status().seq, before.seq + 1);
+    CHECK_EQ(status().next_slot, before.next_slot + 2);
+    restart();
+    CHECK_EQ(status().seq, before.seq + 1);
+    CHECK_EQ(odometer_get_total_mm(), total + 9000);
+}
+
+static void test_torn_write_in_slot_0(void)
+{
+    fresh_log();
+    while (status().next_slot < ODOMETER_RECORDS_PER_SECTOR) {
+        append();
+    }
+    odometer_status_t before = status();
+    CHECK_EQ(before.sector, 0);
+    uint64_t total = odometer_get_total_mm();
+
+    // Sector 1 was erased for the next record, which was then torn
+    CHECK_EQ(esp_partition_erase_range(storage(), ODOMETER_LOG_OFFSET + ODOMETER_SECTOR_SIZE,
+                                       ODOMETER_SECTOR_SIZE), ESP_OK);
+    tear_slot(1, 0, before.seq + 1);
+    restart();
+    odometer_status_t after = status();
+    CHECK_EQ(after.seq, before.seq);
+    CHECK_EQ(after.sector, 0);
+    CHECK_EQ(after.next_slot, ODOMETER_RECORDS_PER_SECTOR);
+    CHECK_EQ(after.erase_count, before.erase_count);
+    CHECK_EQ(odometer_get_total_mm(), total);
+
+    // The next append erases sector 1 again and starts over in slot 0
+    append();
+    after = status();
+    CHECK_EQ(after.sector, 1);
+    CHECK_EQ(after.next_slot, 1);
+    CHECK_EQ(after.seq, before.seq + 1);
+    CHECK_EQ(after.erase_count, before.erase_count + 1);
+    restart();
+    CHECK_EQ(status().sector, 1);
+    CHECK_EQ(status().seq, before.seq + 1);
+    CHECK_EQ(odometer_get_total_mm(), total + 1000);
+}
+
+static void test_recovery_across_the_wrap(void)
+{
+    fresh_log();
+    uint64_t total = odometer_get_total_mm();
+    uint32_t start_seq = status().seq;
+    uint32_t start_erases = status().erase_count;
+
+    // Around every sector once, then 10 records into sector 0 again
+    uint32_t records = ODOMETER_LOG_SECTORS * ODOMETER_RECORDS_PER_SECTOR + 10 - start_seq;
+    for (uint32_t i = 0; i < records; i++) {
+        append();
+    }
+    odometer_status_t before = status();
+    CHECK_EQ(before.sector, 0);
+    CHECK_EQ(before.next_slot, 10);
+    CHECK_EQ(before.seq, start_seq + records);
+    CHECK_EQ(before.erase_count, start_erases + ODOMETER_LOG_SECTORS);
+
+    // Sector 1 still holds older records; sector 0's slot 0 is newer
+    restart();
+    odometer_status_t after = status();
+    CHECK_EQ(after.sector, 0);
+    CHECK_EQ(after.next_slot, 10);
+    CHECK_EQ(after.seq, before.seq);
+    CHECK_EQ(odometer_get_total_mm(), total + (uint64_t)records * 1000);
+}
+
+static void test_erase_count_persists(void)
+{
+    fresh_log();
+    for (int i = 0; i < 3 * ODOMETER_RECORDS_PER_SECTOR; i++) {
+        append();
+    }
+    uint32_t erases = status().erase_count;
+    CHECK_EQ(erases, 1 + 3);
+
+    restart();
+    CHECK_EQ(status().erase_count, erases);
+    // And goes on from there rather than from the sector count
+    while (status().next_slot < ODOMETER_RECORDS_PER_SECTOR) {
+        append();
+    }
+    append();
+    CHECK_EQ(status().erase_count, erases + 1);
+    restart();
+    CHECK_EQ(status().erase_count, erases + 1);
+}
+
+static void test_trip_reset_survives_a_restart(void)
+{
+    fresh_log();
+    odometer_add_distance_mm(3 * MM_PER_KM);
+    CHECK_EQ(odometer_flush(), ESP_OK);
+    uint64_t total = odometer_get_total_mm();
+    odometer_reset_trip();
+    restart();
+    CHECK_EQ(odometer_get_trip_mm(), 0);
+    CHECK_EQ(odometer_get_total_mm(), total);
+}
+
+int main(void)
+{
+    RUN_TEST(test_legacy_trip_in_km);
+    RUN_TEST(test_legacy_trip_in_miles);
+    RUN_TEST(test_no_legacy_trip_starts_at_zero);
+    RUN_TEST(test_torn_write_in_slot_n);
+    RUN_TEST(test_torn_write_in_slot_0);
+    RUN_TEST(test_recovery_across_the_wrap);
+    RUN_TEST(test_erase_count_persists);
+    RUN_TEST(test_trip_reset_survives_a_restart);
+    return host_test_result();
+}
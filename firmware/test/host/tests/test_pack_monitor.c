@@ -0,0 +1,118 @@
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "pack_monitor.h"
+#include "telemetry.h"
+
+// Cell alerts of pack_monitor.c: raised after the debounce, cleared at
+// once when the frames stop carrying cells, and unmeasured 0 mV cells left
+// out of the min/max.
+
+HOST_TEST_DEFINE
+
+#define CELLS   4
+
+static pack_event_t events[16];
+static int event_count;
+
+static void on_event(const pack_event_t *event, void *user_data)
+{
+    if (event_count < (int)(sizeof(events) / sizeof(events[0]))) {
+        events[event_count] = *event;
+    }
+    event_count++;
+}
+
+static void publish_cells(uint8_t num_cells, const int16_t *cell_mv, int frames)
+{
+    telemetry_snapshot_t s;
+    memset(&s, 0, sizeof(s));
+    s.temp_mos_c100 = 3000;
+    s.temp_motor_c100 = 3000;
+    s.bms_num_cells = num_cells;
+    memcpy(s.cell_mv, cell_mv, num_cells * sizeof(int16_t));
+    for (int i = 0; i < frames; i++) {
+        telemetry_publish(&s);
+    }
+    host_wait_idle();
+}
+
+static pack_status_t status(void)
+{
+    pack_status_t s;
+    pack_monitor_get_status(&s);
+    return s;
+}
+
+static void raise_both_alerts(void)
+{
+    // Low and 200 mV apart, at rest
+    const int16_t cells[CELLS] = { 3250, 3450, 3450, 3450 };
+    event_count = 0;
+    publish_cells(CELLS, cells, PACK_ALERT_DEBOUNCE_FRAMES);
+    CHECK_EQ(status().alerts, (1UL << PACK_ALERT_LOW_CELL) | (1UL << PACK_ALERT_IMBALANCE));
+    CHECK_EQ(event_count, 2);
+}
+
+static void test_no_cells_clears_cell_alerts(void)
+{
+    raise_both_alerts();
+
+    event_count = 0;
+    publish_cells(0, NULL, 1);
+    pack_status_t s = status();
+    CHECK_EQ(s.alerts, 0);
+    CHECK_EQ(s.num_cells, 0);
+    CHECK_EQ(s.min_mv, 0);
+    CHECK_EQ(s.delta_mv, 0);
+    CHECK_EQ(event_count, 2);
+    for (int i = 0; i < event_count && i < 2; i++) {
+        CHECK(!events[i].active);
+        CHECK(events[i].alert == PACK_ALERT_LOW_CELL || events[i].alert == PACK_ALERT_IMBALANCE);
+    }
+
+    // Only the transition is reported
+    publish_cells(0, NULL, PACK_ALERT_DEBOUNCE_FRAMES);
+    CHECK_EQ(event_count, 2);
+}
+
+static void test_unmeasured_cells_are_skipped(void)
+{
+    const int16_t cells[CELLS] = { 3700, 0, 3710, 3690 };
+    event_count = 0;
+    publish_cells(CELLS, cells, PACK_ALERT_DEBOUNCE_FRAMES);
+    pack_status_t s = status();
+    CHECK_EQ(s.min_mv, 3690);
+    CHECK_EQ(s.min_cell, 3);
+    CHECK_EQ(s.max_mv, 3710);
+    CHECK_EQ(s.max_cell, 2);
+    CHECK_EQ(s.delta_mv, 20);
+    CHECK_EQ(s.alerts, 0);
+    CHECK_EQ(event_count, 0);
+    // The session minimum keeps the last measured reading
+    CHECK_EQ(s.cells[1].mv, 0);
+    CHECK_EQ(s.cells[1].min_mv, 3450);
+}
+
+static void test_all_cells_unmeasured_clears_cell_alerts(void)
+{
+    raise_both_alerts();
+
+    const int16_t cells[CELLS] = { 0, 0, 0, 0 };
+    event_count = 0;
+    publish_cells(CELLS, cells, 1);
+    CHECK_EQ(status().alerts, 0);
+    CHECK_EQ(event_count, 2);
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    CHECK_EQ(pack_monitor_init(), ESP_OK);
+    CHECK_EQ(pack_monitor_register_callback(on_event, NULL), ESP_OK);
+
+    RUN_TEST(test_no_cells_clears_cell_alerts);
+    RUN_TEST(test_unmeasured_cells_are_skipped);
+    RUN_TEST(test_all_cells_unmeasured_clears_cell_alerts);
+    return host_test_result();
+}
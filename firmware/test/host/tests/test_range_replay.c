@@ -0,0 +1,299 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "telemetry_schema.h"
+#include "kinematics.h"
+#include "odometer.h"
+#include "ride_stats.h"
+#include "range.h"
+
+HOST_TEST_DEFINE
+
+// Replays a recorded ride (ride_log_to_csv.py output, made by
+// tools/make_test_rides.py) through kinematics, ride_stats and range, the
+// listeners the range estimate is built from, one case per run:
+//
+//   bms      cruise.csv as recorded, with the BMS
+//   voltage  cruise.csv with the BMS columns dropped, voltage-only fallback
+//   sag      climb.csv with the BMS dropped, across a 2 kW climb
+//
+// The BMS columns hold the true remaining charge either way. The truth for
+// the range is that charge at the nominal cell voltage over the Wh/km the
+// ride actually used so far.
+
+#define PACK_CELLS          12
+#define PACK_CAPACITY_MAH   10000
+#define MAX_COLUMNS         64
+#define LINE_LEN            1024
+
+// A telemetry frame built from one CSV record, and the truth next to it
+typedef struct {
+    telemetry_snapshot_t snapshot;
+    double true_soc_pct;
+} ride_record_t;
+
+typedef struct {
+    FILE *file;
+    int field_of[MAX_COLUMNS];      // Schema field of a column, -1 if none
+    int cell_of[MAX_COLUMNS];       // Cell index of a cellN_v column, -1 if none
+    int time_column;
+    int columns;
+} ride_reader_t;
+
+typedef struct {
+    uint32_t records;
+    double drawn_wh;                // Net V * I over the ride
+    double true_soc_pct;
+    double true_wh_per_km;
+    double true_range_m;
+    range_estimate_t estimate;
+} ride_state_t;
+
+static bool ride_open(ride_reader_t *reader, const char *name)
+{
+    char path[512];
+    char line[LINE_LEN];
+    snprintf(path, sizeof(path), "%s/%s", HOST_RIDES_DIR, name);
+    reader->file = fopen(path, "r");
+    if (reader->file == NULL || fgets(line, sizeof(line), reader->file) == NULL) {
+        fprintf(stderr, "cannot read %s\n", path);
+        return false;
+    }
+
+    reader->time_column = -1;
+    reader->columns = 0;
+    for (char *column = strtok(line, ",\r\n"); column && reader->columns < MAX_COLUMNS;
+         column = strtok(NULL, ",\r\n")) {
+        int c = reader->columns++;
+        reader->field_of[c] = -1;
+        reader->cell_of[c] = -1;
+        if (strcmp(column, "time_ms") == 0) {
+            reader->time_column = c;
+        } else if (strncmp(column, "cell", 4) == 0) {
+            reader->cell_of[c] = atoi(column + 4) - 1;
+        }
+        for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+            if (strcmp(column, telemetry_fields[f].name) == 0) {
+                reader->field_of[c] = f;
+            }
+        }
+    }
+    return reader->time_column >= 0;
+}
+
+static bool ride_next(ride_reader_t *reader, bool with_bms, ride_record_t *record)
+{
+    char line[LINE_LEN];
+    if (fgets(line, sizeof(line), reader->file) == NULL) {
+        return false;
+    }
+
+    telemetry_snapshot_t *s = &record->snapshot;
+    memset(s, 0, sizeof(*s));
+    char *value = strtok(line, ",\r\n");
+    for (int c = 0; c < reader->columns && value; c++, value = strtok(NULL, ",\r\n")) {
+        double v = atof(value);
+        if (c == reader->time_column) {
+            // A frame at 0 would read as no previous frame
+            s->rx_time_us = (int64_t)llround(v * 1000) + 1000000;
+        } else if (reader->field_of[c] >= 0) {
+            int f = reader->field_of[c];
+            telemetry_field_set(s, f, (int32_t)lround(v * telemetry_fields[f].scale));
+        } else if (reader->cell_of[c] >= 0 && reader->cell_of[c] < TELEMETRY_MAX_CELLS) {
+            s->cell_mv[reader->cell_of[c]] = (int16_t)lround(v * TELEMETRY_SCHEMA_CELL_SCALE);
+        }
+    }
+
+    // The ride log does not keep the BMS nominal capacity, it is the pack's
+    record->true_soc_pct = s->bms_remaining_c100 * 100.0 / (PACK_CAPACITY_MAH / 10);
+    if (with_bms) {
+        s->bms_nominal_c100 = PACK_CAPACITY_MAH / 10;
+    } else {
+        s->bms_voltage_c100 = 0;
+        s->bms_current_c100 = 0;
+        s->bms_remaining_c100 = 0;
+        s->bms_num_cells = 0;
+        memset(s->cell_mv, 0, sizeof(s->cell_mv));
+    }
+    return true;
+}
+
+// Publishes one record and brings the truth and the estimate up to date
+static void replay_record(ride_state_t *state, const ride_record_t *record, int64_t dt_us)
+{
+    const telemetry_snapshot_t *s = &record->snapshot;
+    telemetry_publish(s);
+
+    state->records++;
+    state->drawn_wh += s->voltage_c100 / 100.0 * s->current_in_c100 / 100.0 * dt_us / 3.6e9;
+    state->true_soc_pct = record->true_soc_pct;
+    double km = odometer_get_trip_mm() / 1e6;
+    state->true_wh_per_km = km > 0 ? state->drawn_wh / km : 0;
+    double remaining_wh = record->true_soc_pct / 100.0 * PACK_CAPACITY_MAH / 1000.0 * PACK_CELLS *
+                          RANGE_CELL_NOMINAL_MV / 1000.0;
+    state->true_range_m = state->true_wh_per_km > 0 ? remaining_wh / state->true_wh_per_km * 1000 : 0;
+    range_get_estimate(&state->estimate);
+}
+
+static void print_state(const char *label, const ride_state_t *state)
+{
+    const range_estimate_t *e = &state->estimate;
+    printf("  %-12s %s soc %u%% (true %.1f%%), %ld.%ld Wh/km (true %.1f), range %.2f km [%.2f, %.2f] (true %.2f)\n",
+           label, range_source_name(e->source), e->soc_pct, state->true_soc_pct,
+           (long)e->wh_per_km_x10 / 10, (long)e->wh_per_km_x10 % 10, state->true_wh_per_km,
+           e->range_m / 1000.0, e->range_low_m / 1000.0, e->range_high_m / 1000.0, state->true_range_m / 1000.0);
+}
+
+static void check_band(const ride_state_t *state, double range_tolerance)
+{
+    const range_estimate_t *e = &state->estimate;
+    CHECK(e->range_low_m <= e->range_m);
+    CHECK(e->range_m <= e->range_high_m);
+    CHECK(e->range_low_m <= state->true_range_m);
+    CHECK(state->true_range_m <= e->range_high_m);
+    CHECK_NEAR(e->range_m, state->true_range_m, state->true_range_m * range_tolerance);
+}
+
+// Replays a whole ride; the estimate has to hold once a few consumption
+// windows have closed
+static void replay_ride(const char *name, bool with_bms, ride_state_t *state,
+                        void (*on_record)(const ride_record_t *record, const ride_state_t *state))
+{
+    ride_reader_t reader = {0};
+    CHECK(ride_open(&reader, name));
+    if (reader.file == NULL) {
+        return;
+    }
+
+    memset(state, 0, sizeof(*state));
+    ride_record_t record;
+    int64_t last_us = 0;
+    while (ride_next(&reader, with_bms, &record)) {
+        int64_t dt_us = last_us ? record.snapshot.rx_time_us - last_us : 0;
+        last_us = record.snapshot.rx_time_us;
+        replay_record(state, &record, dt_us);
+        if (on_record) {
+            on_record(&record, state);
+        }
+    }
+    fclose(reader.file);
+    CHECK(state->records > 1000);
+    CHECK(state->estimate.windows >= 10);
+}
+
+static void test_with_bms(void)
+{
+    ride_state_t state;
+    replay_ride("cruise.csv", true, &state, NULL);
+    print_state("end of ride", &state);
+
+    CHECK_EQ(state.estimate.source, RANGE_SOURCE_BMS);
+    CHECK_NEAR(state.estimate.soc_pct, state.true_soc_pct, 1);
+    CHECK_NEAR(state.estimate.wh_per_km_x10 / 10.0, state.true_wh_per_km, state.true_wh_per_km * 0.1);
+    check_band(&state, 0.1);
+    // On a steady ride the band has to say something
+    CHECK(state.estimate.range_high_m - state.estimate.range_low_m < state.estimate.range_m);
+}
+
+static void test_voltage_fallback(void)
+{
+    ride_state_t state;
+    replay_ride("cruise.csv", false, &state, NULL);
+    print_state("end of ride", &state);
+
+    CHECK_EQ(state.estimate.source, RANGE_SOURCE_VOLTAGE);
+    CHECK_NEAR(state.estimate.soc_pct, state.true_soc_pct, 8);
+    CHECK_NEAR(state.estimate.wh_per_km_x10 / 10.0, state.true_wh_per_km, state.true_wh_per_km * 0.1);
+    check_band(&state, 0.2);
+    CHECK(state.estimate.range_high_m - state.estimate.range_low_m < state.estimate.range_m);
+}
+
+// Climb records, where the pack sags by several volts
+#define CLIMB_CURRENT_C100  3000
+
+static uint32_t climb_records;
+static int32_t rest_voltage_c100;
+static int32_t max_sag_c100;
+static double soc_error_before_climb;   // Voltage model offset going into the climb
+static double worst_climb_soc_dip;      // How far the estimate fell below that offset
+
+static void watch_climb(const ride_record_t *record, const ride_state_t *state)
+{
+    const telemetry_snapshot_t *s = &record->snapshot;
+    double soc_error = state->estimate.soc_pct - state->true_soc_pct;
+    if (s->current_in_c100 < CLIMB_CURRENT_C100) {
+        rest_voltage_c100 = s->voltage_c100;
+        if (climb_records == 0) {
+            soc_error_before_climb = soc_error;
+        }
+        return;
+    }
+    climb_records++;
+    if (rest_voltage_c100 - s->voltage_c100 > max_sag_c100) {
+        max_sag_c100 = rest_voltage_c100 - s->voltage_c100;
+    }
+    if (soc_error_before_climb - soc_error > worst_climb_soc_dip) {
+        worst_climb_soc_dip = soc_error_before_climb - soc_error;
+    }
+}
+
+static void test_sag_heavy_segment(void)
+{
+    ride_state_t state;
+    replay_ride("climb.csv", false, &state, watch_climb);
+    printf("  climb: %lu records, sag up to %ld.%02ld V, SoC %+.1f points off before, dips %.1f more\n",
+           (unsigned long)climb_records, (long)max_sag_c100 / 100, (long)max_sag_c100 % 100,
+           soc_error_before_climb, worst_climb_soc_dip);
+    print_state("end of ride", &state);
+
+    // The ride has to be what this case claims: uncompensated, this sag
+    // reads as a pack more than half empty
+    CHECK(climb_records > 200);
+    CHECK(max_sag_c100 > 600);
+    // Sag compensation keeps the voltage SoC from collapsing on the climb
+    CHECK(worst_climb_soc_dip < 8);
+
+    // And it is back once the climb is over
+    CHECK_EQ(state.estimate.source, RANGE_SOURCE_VOLTAGE);
+    CHECK_NEAR(state.estimate.soc_pct, state.true_soc_pct, 8);
+    check_band(&state, 0.25);
+    // The climb windows widen the band rather than dragging the estimate
+    CHECK(state.estimate.range_high_m - state.estimate.range_low_m > state.estimate.range_m);
+}
+
+static const struct {
+    const char *name;
+    void (*fn)(void);
+} cases[] = {
+    { "bms", test_with_bms },
+    { "voltage", test_voltage_fallback },
+    { "sag", test_sag_heavy_segment },
+};
+
+int main(int argc, char **argv)
+{
+    host_nvs_reset();
+    settings_init();
+    // Listeners run in registration order; range reads what the others left
+    CHECK_EQ(kinematics_init(), ESP_OK);
+    CHECK_EQ(ride_stats_init(), ESP_OK);
+    CHECK_EQ(range_init(), ESP_OK);
+    range_set_pack(PACK_CELLS, PACK_CAPACITY_MAH);
+
+    // The estimator keeps its filters for the life of the firmware, so
+    // each case runs in its own process
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (argc > 1 && strcmp(argv[1], cases[i].name) == 0) {
+            int before = host_test_failures;
+            cases[i].fn();
+            printf("%s %s\n", host_test_failures == before ? "PASS" : "FAIL", cases[i].name);
+            return host_test_result();
+        }
+    }
+    fprintf(stderr, "usage: %s bms|voltage|sag\n", argv[0]);
+    return EXIT_FAILURE;
+}
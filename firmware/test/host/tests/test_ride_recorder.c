@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "ride_recorder.h"
+#include "telemetry.h"
+
+// The ride log ring of ride_recorder.c on the shim's storage partition:
+// recorded past its end, the export holds only the newest sector_count
+// blocks, oldest first, and tools/ride_log_to_csv.py decodes it back to
+// the samples that went in. The decode is skipped if CMake found no
+// Python.
+
+HOST_TEST_DEFINE
+
+#define RATE_HZ     RIDE_LOG_MAX_RATE_HZ
+#define PERIOD_MS   (1000 / RATE_HZ)
+#define START_MS    1000    // A frame at 0 would read as no previous frame
+#define NUM_CELLS   4
+#define MAX_COLUMNS 48
+
+static uint8_t *export_data;
+static size_t export_len;
+static volatile bool export_done;
+
+static uint32_t records;        // Published, all of them recorded
+static uint32_t first_kept;     // Index of the oldest record in the export
+
+static uint32_t erpm_of(uint32_t i)       { return 2000 + i; }
+static int16_t cell1_of(uint32_t i)       { return (int16_t)(3700 + i % 50); }
+static uint32_t time_ms_of(uint32_t i)    { return START_MS + i * PERIOD_MS; }
+
+static void publish(uint32_t i)
+{
+    telemetry_snapshot_t s;
+    memset(&s, 0, sizeof(s));
+    s.rx_time_us = (int64_t)time_ms_of(i) * 1000;
+    telemetry_field_set(&s, TELEMETRY_FIELD_ERPM, (int32_t)erpm_of(i));
+    telemetry_field_set(&s, TELEMETRY_FIELD_VOLTAGE, 4800 - (int32_t)(i % 7));
+    s.bms_num_cells = NUM_CELLS;
+    s.cell_mv[0] = cell1_of(i);
+    for (int c = 1; c < NUM_CELLS; c++) {
+        s.cell_mv[c] = 3650;
+    }
+    telemetry_publish(&s);
+}
+
+static ride_recorder_status_t status(void)
+{
+    ride_recorder_status_t s;
+    ride_recorder_get_status(&s);
+    return s;
+}
+
+static void append_export(const void *data, size_t len)
+{
+    export_data = realloc(export_data, export_len + len);
+    memcpy(export_data + export_len, data, len);
+    export_len += len;
+}
+
+static void export_task(void)
+{
+    CHECK_EQ(ride_recorder_export(append_export), ESP_OK);
+    export_done = true;
+}
+
+static void run_export(void)
+{
+    free(export_data);
+    export_data = NULL;
+    export_len = 0;
+    export_done = false;
+    host_test_run_in_task(export_task);
+    for (int waited = 0; !export_done && waited < 5000; waited += 10) {
+        host_clock_advance_ms(10);
+    }
+    CHECK(export_done);
+}
+
+static void test_ring_drops_the_oldest_blocks(void)
+{
+    ride_recorder_status_t s = status();
+    CHECK(s.flash_ok);
+    CHECK(s.sector_count > 0);
+
+    // A few blocks more than the ring holds, the writer drained as it goes
+    while (status().blocks_written < s.sector_count + 4 && records < 100000) {
+        publish(records++);
+        if (records % 50 == 0) {
+            host_wait_idle();
+        }
+    }
+    run_export();
+
+    s = status();
+    CHECK_EQ(s.records, records);
+    CHECK_EQ(s.dropped, 0);
+    CHECK(s.last_seq > s.sector_count);
+
+    char preamble[48];
+    int len = snprintf(preamble, sizeof(preamble), "RIDELOG %lu %d\n",
+                       (unsigned long)s.sector_count, RIDE_LOG_BLOCK_SIZE);
+    CHECK_EQ(export_len, (size_t)len + s.sector_count * RIDE_LOG_BLOCK_SIZE + 12);
+    if (export_len != (size_t)len + s.sector_count * RIDE_LOG_BLOCK_SIZE + 12) {
+        return;
+    }
+    CHECK(memcmp(export_data, preamble, len) == 0);
+    CHECK(memcmp(export_data + export_len - 12, "RIDELOG END\n", 12) == 0);
+
+    // The newest sector_count blocks, oldest first and without gaps
+    uint32_t kept = 0;
+    for (uint32_t b = 0; b < s.sector_count; b++) {
+        ride_log_block_header_t header;
+        memcpy(&header, export_data + len + b * RIDE_LOG_BLOCK_SIZE, sizeof(header));
+        CHECK_EQ(header.magic, RIDE_LOG_BLOCK_MAGIC);
+        CHECK_EQ(header.seq, s.last_seq - s.sector_count + 1 + b);
+        kept += header.record_count;
+    }
+    CHECK(kept < records);
+    first_kept = records - kept;
+
+    ride_log_block_header_t oldest;
+    memcpy(&oldest, export_data + len, sizeof(oldest));
+    CHECK_EQ(oldest.start_time_ms, time_ms_of(first_kept));
+}
+
+static int split_columns(char *line, char **columns)
+{
+    int n = 0;
+    for (char *p = line; n < MAX_COLUMNS; n++) {
+        columns[n] = p;
+        p = strpbrk(p, ",\r\n");
+        if (p == NULL || *p != ',') {
+            if (p != NULL) {
+                *p = '\0';
+            }
+            return n + 1;
+        }
+        *p++ = '\0';
+    }
+    return n;
+}
+
+static int find_column(char **columns, int count, const char *name)
+{
+    for (int c = 0; c < count; c++) {
+        if (strcmp(columns[c], name) == 0) {
+            return c;
+        }
+    }
+    CHECK(!"column missing");
+    return 0;
+}
+
+static void test_csv_decodes_the_export(void)
+{
+#ifndef HOST_PYTHON
+    printf("  skipped, no Python\n");
+#else
+    char bin_path[64];
+    char csv_path[64];
+    snprintf(bin_path, sizeof(bin_path), "ride_recorder_%d.bin", (int)getpid());
+    snprintf(csv_path, sizeof(csv_path), "ride_recorder_%d.csv", (int)getpid());
+
+    FILE *bin = fopen(bin_path, "wb");
+    CHECK(bin != NULL);
+    if (bin == NULL) {
+        return;
+    }
+    // Console text ahead of the preamble is skipped, as over the port
+    fputs("log_export\r\n", bin);
+    fwrite(export_data, 1, export_len, bin);
+    fclose(bin);
+
+    char command[512];
+    snprintf(command, sizeof(command), "'%s' '%s/ride_log_to_csv.py' --input '%s' -o '%s'",
+             HOST_PYTHON, HOST_TOOLS_DIR, bin_path, csv_path);
+    CHECK_EQ(system(command), 0);
+
+    FILE *csv = fopen(csv_path, "r");
+    CHECK(csv != NULL);
+    if (csv == NULL) {
+        remove(bin_path);
+        return;
+    }
+
+    char line[1024];
+    char *columns[MAX_COLUMNS];
+    CHECK(fgets(line, sizeof(line), csv) != NULL);
+    int count = split_columns(line, columns);
+    int time_column = find_column(columns, count, "time_ms");
+    int erpm_column = find_column(columns, count, "erpm");
+    int voltage_column = find_column(columns, count, "voltage");
+    int num_cells_column = find_column(columns, count, "num_cells");
+    int cell1_column = find_column(columns, count, "cell1_v");
+    int cell5_column = find_column(columns, count, "cell5_v");
+
+    uint32_t rows = 0;
+    while (fgets(line, sizeof(line), csv) != NULL) {
+        uint32_t i = first_kept + rows++;
+        CHECK_EQ(split_columns(line, columns), count);
+        CHECK_EQ(strtoul(columns[time_column], NULL, 10), time_ms_of(i));
+        CHECK_EQ(strtoul(columns[erpm_column], NULL, 10), erpm_of(i));
+        CHECK_NEAR(strtod(columns[voltage_column], NULL), (4800 - (int)(i % 7)) / 100.0, 0.001);
+        CHECK_EQ(strtoul(columns[num_cells_column], NULL, 10), NUM_CELLS);
+        CHECK_NEAR(strtod(columns[cell1_column], NULL) * 1000, cell1_of(i), 0.01);
+        CHECK_NEAR(strtod(columns[cell5_column], NULL), 0, 0.0001);
+    }
+    fclose(csv);
+    CHECK_EQ(rows, records - first_kept);
+
+    remove(bin_path);
+    remove(csv_path);
+#endif
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    host_partition_reset();
+    CHECK_EQ(ride_recorder_init(), ESP_OK);
+    CHECK_EQ(ride_recorder_set_rate(RATE_HZ), ESP_OK);
+
+    RUN_TEST(test_ring_drops_the_oldest_blocks);
+    RUN_TEST(test_csv_decodes_the_export);
+    free(export_data);
+    return host_test_result();
+}
@@ -0,0 +1,250 @@
+#include <string.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "settings.h"
+#include "vesc_config.h"
+#include "throttle.h"
+#include "range.h"
+#include "nvs.h"
+#include "esp_rom_crc.h"
+
+HOST_TEST_DEFINE
+
+// Blob header as settings.c writes it
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    uint32_t seq;
+    uint32_t crc;
+} blob_header_t;
+
+static void store_blob(const char *key, const void *blob, size_t size)
+{
+    nvs_handle_t handle;
+    CHECK_EQ(nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READWRITE, &handle), ESP_OK);
+    CHECK_EQ(nvs_set_blob(handle, key, blob, size), ESP_OK);
+    nvs_commit(handle);
+    nvs_close(handle);
+}
+
+static void test_first_boot_stores_defaults(void)
+{
+    host_nvs_reset();
+    CHECK_EQ(settings_init(), ESP_OK);
+
+    settings_status_t status;
+    settings_get_status(&status);
+    CHECK_EQ(status.slot, 'A');
+    CHECK_EQ(status.seq, 1);
+    CHECK(!status.migrated);
+
+    settings_t settings;
+    settings_get(&settings);
+    CHECK_EQ(settings.motor_pulley, 15);
+    CHECK_EQ(settings.wheel_pulley, 33);
+    CHECK_EQ(settings.wheel_diameter_mm, 115);
+    CHECK_EQ(settings.motor_poles, 14);
+    CHECK_EQ(settings.throttle_calibrated, 0);
+    CHECK_EQ(settings.throttle_max, ADC_INITIAL_MAX_VALUE);
+}
+
+static void test_saves_alternate_and_survive_reboot(void)
+{
+    host_nvs_reset();
+    settings_init();
+
+    settings_t settings;
+    settings_get(&settings);
+    settings.wheel_diameter_mm = 97;
+    settings.throttle_calibrated = 1;
+    settings.throttle_min = 812;
+    settings.throttle_max = 3301;
+    CHECK_EQ(settings_save(&settings), ESP_OK);
+
+    settings_status_t status;
+    settings_get_status(&status);
+    CHECK_EQ(status.slot, 'B');
+    CHECK_EQ(status.seq, 2);
+
+    // No change, no write
+    CHECK_EQ(settings_save(&settings), ESP_OK);
+    settings_get_status(&status);
+    CHECK_EQ(status.seq, 2);
+
+    // Reboot
+    settings_init();
+    settings_get_status(&status);
+    CHECK_EQ(status.slot, 'B');
+    settings_t loaded;
+    settings_get(&loaded);
+    CHECK(memcmp(&loaded, &settings, sizeof(settings)) == 0);
+
+    settings.wheel_diameter_mm = 90;
+    settings_save(&settings);
+    settings_get_status(&status);
+    CHECK_EQ(status.slot, 'A');
+    CHECK_EQ(status.seq, 3);
+}
+
+static void test_corrupt_newest_slot_falls_back(void)
+{
+    host_nvs_reset();
+    settings_init();                    // Defaults in A, seq 1
+
+    settings_t settings;
+    settings_get(&settings);
+    settings.motor_poles = 22;
+    settings_save(&settings);           // B, seq 2
+
+    // Flip a payload byte of B, as a cut write would leave it
+    nvs_handle_t handle;
+    uint8_t blob[256];
+    size_t size = sizeof(blob);
+    nvs_open(SETTINGS_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    CHECK_EQ(nvs_get_blob(handle, SETTINGS_NVS_KEY_B, blob, &size), ESP_OK);
+    nvs_close(handle);
+    blob[sizeof(blob_header_t) + 3] ^= 0x40;
+    store_blob(SETTINGS_NVS_KEY_B, blob, size);
+
+    settings_init();
+    settings_status_t status;
+    settings_get_status(&status);
+    CHECK_EQ(status.slot, 'A');
+    CHECK_EQ(status.seq, 1);
+    settings_get(&settings);
+    CHECK_EQ(settings.motor_poles, 14);
+}
+
+static void test_longer_blob_from_newer_firmware(void)
+{
+    host_nvs_reset();
+
+    uint8_t blob[sizeof(blob_header_t) + sizeof(settings_t) + 8];
+    memset(blob, 0xee, sizeof(blob));
+    blob_header_t *header = (blob_header_t *)blob;
+    header->magic = SETTINGS_MAGIC;
+    header->version = SETTINGS_VERSION;         // Appends keep the version
+    header->size = sizeof(settings_t) + 8;
+    header->seq = 7;
+    settings_t *payload = (settings_t *)(blob + sizeof(blob_header_t));
+    memset(payload, 0, sizeof(*payload));
+    payload->motor_pulley = 18;
+    payload->wheel_pulley = 40;
+    uint32_t crc = esp_rom_crc32_le(0, blob, offsetof(blob_header_t, crc));
+    header->crc = esp_rom_crc32_le(crc, (const uint8_t *)payload, header->size);
+    store_blob(SETTINGS_NVS_KEY_A, blob, sizeof(blob));
+
+    settings_init();
+    settings_status_t status;
+    settings_get_status(&status);
+    CHECK_EQ(status.slot, 'A');
+    CHECK_EQ(status.seq, 7);
+    settings_t settings;
+    settings_get(&settings);
+    CHECK_EQ(settings.motor_pulley, 18);
+    CHECK_EQ(settings.wheel_pulley, 40);
+}
+
+// Blob of size payload bytes in slot A, from a settings_t with motor_poles
+// and pack_cells_series changed
+static void store_versioned_blob(uint16_t version, uint16_t size)
+{
+    uint8_t blob[sizeof(blob_header_t) + sizeof(settings_t)];
+    blob_header_t *header = (blob_header_t *)blob;
+    header->magic = SETTINGS_MAGIC;
+    header->version = version;
+    header->size = size;
+    header->seq = 3;
+    settings_t *payload = (settings_t *)(blob + sizeof(blob_header_t));
+    memset(payload, 0, sizeof(*payload));
+    payload->motor_pulley = 15;
+    payload->wheel_pulley = 33;
+    payload->wheel_diameter_mm = 115;
+    payload->motor_poles = 22;
+    payload->pack_cells_series = 13;
+    uint32_t crc = esp_rom_crc32_le(0, blob, offsetof(blob_header_t, crc));
+    header->crc = esp_rom_crc32_le(crc, (const uint8_t *)payload, header->size);
+    store_blob(SETTINGS_NVS_KEY_A, blob, sizeof(blob_header_t) + size);
+}
+
+static void test_shorter_blob_from_older_firmware(void)
+{
+    host_nvs_reset();
+    // Written before the pack fields were appended, same version
+    store_versioned_blob(SETTINGS_VERSION, offsetof(settings_t, pack_cells_series));
+
+    settings_init();
+    settings_status_t status;
+    settings_get_status(&status);
+    CHECK_EQ(status.slot, 'A');
+    CHECK_EQ(status.seq, 3);
+    settings_t settings;
+    settings_get(&settings);
+    CHECK_EQ(settings.motor_poles, 22);
+    CHECK_EQ(settings.pack_cells_series, RANGE_DEFAULT_PACK_CELLS);
+    CHECK_EQ(settings.pack_capacity_mah, RANGE_DEFAULT_PACK_CAPACITY_MAH);
+}
+
+static void test_incompatible_layout_is_ignored(void)
+{
+    host_nvs_reset();
+    store_versioned_blob(SETTINGS_VERSION + 1, sizeof(settings_t));
+
+    settings_init();
+    settings_status_t status;
+    settings_get_status(&status);
+    CHECK(status.seq != 3);
+    settings_t settings;
+    settings_get(&settings);
+    CHECK_EQ(settings.motor_poles, 14);
+}
+
+static void test_legacy_keys_are_migrated(void)
+{
+    host_nvs_reset();
+
+    nvs_handle_t handle;
+    nvs_open(VESC_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    nvs_set_u8(handle, NVS_KEY_MOTOR_PULLEY, 16);
+    nvs_set_u8(handle, NVS_KEY_WHEEL_DIAM, 100);
+    nvs_set_u8(handle, NVS_KEY_SPEED_UNIT, 1);
+    nvs_commit(handle);
+    nvs_close(handle);
+    nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
+    nvs_set_u8(handle, NVS_KEY_CALIBRATED, 1);
+    nvs_set_u32(handle, NVS_KEY_MIN, 640);
+    nvs_set_u32(handle, NVS_KEY_MAX, 3390);
+    nvs_commit(handle);
+    nvs_close(handle);
+
+    CHECK_EQ(settings_init(), ESP_OK);
+    settings_status_t status;
+    settings_get_status(&status);
+    CHECK(status.migrated);
+
+    vesc_config_t config;
+    CHECK_EQ(vesc_config_load(&config), ESP_OK);
+    CHECK_EQ(config.motor_pulley, 16);
+    CHECK_EQ(config.wheel_pulley, 33);          // Not stored, default
+    CHECK_EQ(config.wheel_diameter_mm, 100);
+    CHECK(config.speed_unit_mph);
+
+    settings_t settings;
+    settings_get(&settings);
+    CHECK_EQ(settings.throttle_calibrated, 1);
+    CHECK_EQ(settings.throttle_min, 640);
+    CHECK_EQ(settings.throttle_max, 3390);
+}
+
+int main(void)
+{
+    RUN_TEST(test_first_boot_stores_defaults);
+    RUN_TEST(test_saves_alternate_and_survive_reboot);
+    RUN_TEST(test_corrupt_newest_slot_falls_back);
+    RUN_TEST(test_longer_blob_from_newer_firmware);
+    RUN_TEST(test_shorter_blob_from_older_firmware);
+    RUN_TEST(test_incompatible_layout_is_ignored);
+    RUN_TEST(test_legacy_keys_are_migrated);
+    return host_test_result();
+}
@@ -0,0 +1,165 @@
+#include <string.h>
+#include "host_test.h"
+#include "telemetry_decode.h"
+#include "telemetry_schema.h"
+
+HOST_TEST_DEFINE
+
+static telemetry_snapshot_t sample_snapshot(uint8_t cells)
+{
+    telemetry_snapshot_t s = {0};
+    s.temp_mos_c100 = 4512;
+    s.temp_motor_c100 = -250;
+    s.current_motor_c100 = -3120;
+    s.current_in_c100 = 1875;
+    s.erpm = -123456;
+    s.voltage_c100 = 4188;
+    s.bms_voltage_c100 = 4179;
+    s.bms_current_c100 = -1520;
+    s.bms_remaining_c100 = 812;
+    s.bms_nominal_c100 = 1200;
+    s.bms_num_cells = cells;
+    for (uint8_t i = 0; i < cells; i++) {
+        s.cell_mv[i] = (int16_t)(3600 + i * 7);
+    }
+    return s;
+}
+
+static void check_same(const telemetry_snapshot_t *a, const telemetry_snapshot_t *b)
+{
+    for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+        CHECK_EQ(telemetry_field_get(a, f), telemetry_field_get(b, f));
+    }
+    for (int i = 0; i < TELEMETRY_MAX_CELLS; i++) {
+        CHECK_EQ(a->cell_mv[i], b->cell_mv[i]);
+    }
+}
+
+static void test_round_trip_full_frame(void)
+{
+    telemetry_snapshot_t in = sample_snapshot(12);
+    uint8_t frame[TELEMETRY_FRAME_LEN];
+    telemetry_encode_frame(&in, frame);
+
+    telemetry_snapshot_t out;
+    memset(&out, 0xa5, sizeof(out));
+    CHECK(telemetry_decode_frame(frame, sizeof(frame), &out));
+    check_same(&in, &out);
+}
+
+static void test_wire_layout_is_big_endian(void)
+{
+    telemetry_snapshot_t in = {0};
+    in.erpm = 0x01020304;
+    in.voltage_c100 = 0x0a0b;
+    uint8_t frame[TELEMETRY_FRAME_LEN];
+    telemetry_encode_frame(&in, frame);
+
+    CHECK_EQ(frame[8], 0x01);
+    CHECK_EQ(frame[11], 0x04);
+    CHECK_EQ(frame[12], 0x0a);
+    CHECK_EQ(frame[13], 0x0b);
+}
+
+static void test_v2_frame_carries_only_valid_cells(void)
+{
+    for (uint8_t cells = 0; cells < TELEMETRY_MAX_CELLS; cells++) {
+        telemetry_snapshot_t in = sample_snapshot(cells);
+        uint8_t frame[TELEMETRY_FRAME_LEN];
+        telemetry_encode_frame(&in, frame);
+
+        telemetry_snapshot_t out;
+        memset(&out, 0xa5, sizeof(out));
+        CHECK(telemetry_decode_frame(frame, TELEMETRY_SCHEMA_V2_LEN(cells), &out));
+        check_same(&in, &out);
+    }
+}
+
+static void test_cells_past_count_are_masked(void)
+{
+    telemetry_snapshot_t in = sample_snapshot(TELEMETRY_MAX_CELLS);
+    uint8_t frame[TELEMETRY_FRAME_LEN];
+    telemetry_encode_frame(&in, frame);
+    frame[TELEMETRY_SCHEMA_CELLS_OFS - 1] = 3;      // Count says 3, the frame carries 16
+
+    telemetry_snapshot_t out;
+    CHECK(telemetry_decode_frame(frame, sizeof(frame), &out));
+    CHECK_EQ(out.bms_num_cells, 3);
+    CHECK_EQ(out.cell_mv[2], in.cell_mv[2]);
+    CHECK_EQ(out.cell_mv[3], 0);
+    CHECK_EQ(out.cell_mv[15], 0);
+
+    // More cells than fit is clamped
+    frame[TELEMETRY_SCHEMA_CELLS_OFS - 1] = 200;
+    CHECK(telemetry_decode_frame(frame, sizeof(frame), &out));
+    CHECK_EQ(out.bms_num_cells, TELEMETRY_MAX_CELLS);
+}
+
+static void test_bad_lengths_are_rejected(void)
+{
+    telemetry_snapshot_t in = sample_snapshot(4);
+    uint8_t frame[TELEMETRY_FRAME_LEN + 1];
+    telemetry_encode_frame(&in, frame);
+
+    telemetry_snapshot_t out;
+    memset(&out, 0x5a, sizeof(out));
+    telemetry_snapshot_t untouched = out;
+
+    CHECK(!telemetry_decode_frame(NULL, TELEMETRY_FRAME_LEN, &out));
+    CHECK(!telemetry_decode_frame(frame, 0, &out));
+    CHECK(!telemetry_decode_frame(frame, TELEMETRY_SCHEMA_CELLS_OFS - 1, &out));
+    CHECK(!telemetry_decode_frame(frame, TELEMETRY_FRAME_LEN + 1, &out));
+    // A v2 length that does not match the cell count it carries
+    CHECK(!telemetry_decode_frame(frame, TELEMETRY_SCHEMA_V2_LEN(5), &out));
+    CHECK(!telemetry_decode_frame(frame, TELEMETRY_SCHEMA_V2_LEN(4) + 1, &out));
+    CHECK(memcmp(&out, &untouched, sizeof(out)) == 0);
+}
+
+static void test_scaled_fields(void)
+{
+    telemetry_snapshot_t s = sample_snapshot(0);
+    CHECK_NEAR(telemetry_field_scaled(&s, TELEMETRY_FIELD_VOLTAGE), 41.88, 1e-4);
+    CHECK_NEAR(telemetry_field_scaled(&s, TELEMETRY_FIELD_CURRENT_MOTOR), -31.2, 1e-4);
+    CHECK_NEAR(telemetry_field_scaled(&s, TELEMETRY_FIELD_ERPM), -123456, 1e-3);
+}
+
+// The cell columns carry the same names as in ride_log_to_csv.py and the
+// test rides, and a row has as many columns as the header
+static void test_csv_cell_columns(void)
+{
+    char *text = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&text, &len);
+    telemetry_snapshot_t s = sample_snapshot(3);
+    telemetry_print_csv_header(out);
+    telemetry_print_csv_row(out, &s);
+    fclose(out);
+
+    char *row = strchr(text, '\n') + 1;
+    CHECK(strstr(text, ",num_cells,cell1_v,cell2_v,") != NULL);
+    CHECK(strstr(text, ",cell16_v\n") == row - strlen(",cell16_v\n"));
+    CHECK(strstr(row, ",3.600,3.607,3.614,,") != NULL);
+
+    int header_columns = 1;
+    int row_columns = 1;
+    for (char *p = text; *p != '\0'; p++) {
+        if (*p == ',') {
+            *(p < row ? &header_columns : &row_columns) += 1;
+        }
+    }
+    CHECK_EQ(header_columns, TELEMETRY_FIELD_COUNT + TELEMETRY_MAX_CELLS);
+    CHECK_EQ(row_columns, header_columns);
+    free(text);
+}
+
+int main(void)
+{
+    RUN_TEST(test_round_trip_full_frame);
+    RUN_TEST(test_wire_layout_is_big_endian);
+    RUN_TEST(test_v2_frame_carries_only_valid_cells);
+    RUN_TEST(test_cells_past_count_are_masked);
+    RUN_TEST(test_bad_lengths_are_rejected);
+    RUN_TEST(test_scaled_fields);
+    RUN_TEST(test_csv_cell_columns);
+    return host_test_result();
+}
@@ -0,0 +1,135 @@
+#include "host_test.h"
+#include "host_shim.h"
+#include "esp_timer.h"
+#include "settings.h"
+#include "throttle.h"
+#include "throttle_map.h"
+#include "hw_config.h"
+
+HOST_TEST_DEFINE
+
+#define SWEEP_LOW   300
+#define SWEEP_HIGH  3800
+#define SWEEP_US    2000000
+
+// Rider working the throttle end to end every two seconds during the
+// calibration, the brake the other way round
+static int sweep(adc_channel_t channel, void *ctx)
+{
+    (void)ctx;
+    int64_t phase = esp_timer_get_time() % SWEEP_US;
+    int64_t up = phase < SWEEP_US / 2 ? phase : SWEEP_US - phase;
+    int value = SWEEP_LOW + (int)(up * (SWEEP_HIGH - SWEEP_LOW) / (SWEEP_US / 2));
+    return channel == THROTTLE_PIN ? value : SWEEP_LOW + SWEEP_HIGH - value;
+}
+
+static int held_throttle = 0;
+static int held_brake = 0;
+
+static int held(adc_channel_t channel, void *ctx)
+{
+    (void)ctx;
+    return channel == THROTTLE_PIN ? held_throttle : held_brake;
+}
+
+static void calibrate(void)
+{
+    throttle_calibrate(false);
+}
+
+static void test_calibration_from_a_sweep(void)
+{
+    CHECK_EQ(adc_init(), ESP_OK);
+    CHECK(throttle_should_use_neutral());
+
+    host_adc_set_source(sweep, NULL);
+    host_test_run_in_task(calibrate);
+    host_clock_advance_ms(20000);
+
+    CHECK(throttle_is_calibrated());
+    CHECK(!throttle_should_use_neutral());
+    uint32_t min_val, max_val;
+    throttle_get_calibration_values(&min_val, &max_val);
+    // 5% margins inside the swept range
+    uint32_t margin = (SWEEP_HIGH - SWEEP_LOW) / 20;
+    CHECK_NEAR(min_val, SWEEP_LOW + margin, 30);
+    CHECK_NEAR(max_val, SWEEP_HIGH - margin, 30);
+
+    // Stored for the next boot
+    settings_t settings;
+    settings_get(&settings);
+    CHECK_EQ(settings.throttle_calibrated, 1);
+    CHECK_EQ(settings.throttle_min, min_val);
+    CHECK_EQ(settings.throttle_max, max_val);
+}
+
+static void test_sampling_task_maps_the_hand(void)
+{
+    host_adc_set_source(held, NULL);
+    host_test_run_in_task(adc_start_task);
+    host_clock_advance_ms(200);
+
+    uint32_t min_val, max_val;
+    throttle_get_calibration_values(&min_val, &max_val);
+
+#ifdef CONFIG_TARGET_DUAL_THROTTLE
+    // Brake squeezed to its stop, throttle released
+    held_brake = SWEEP_LOW;
+    held_throttle = SWEEP_HIGH;
+    host_clock_advance_ms(100);
+    CHECK_EQ(throttle_get_latest_mapped(), 0);
+
+    // Brake released, throttle released: neutral
+    held_brake = SWEEP_HIGH;
+    held_throttle = SWEEP_HIGH;
+    host_clock_advance_ms(100);
+    CHECK_EQ(throttle_get_latest_mapped(), THROTTLE_MAP_NEUTRAL);
+
+    // Full throttle
+    held_throttle = SWEEP_LOW;
+    host_clock_advance_ms(100);
+    CHECK_EQ(throttle_get_latest_mapped(), 255);
+#else
+    held_throttle = SWEEP_LOW;
+    host_clock_advance_ms(100);
+    CHECK_EQ(throttle_get_latest_mapped(), 0);
+
+    held_throttle = (int)(min_val + max_val) / 2;
+    host_clock_advance_ms(100);
+    CHECK_NEAR(throttle_get_latest_mapped(), 127, 1);
+
+    held_throttle = SWEEP_HIGH;
+    host_clock_advance_ms(100);
+    CHECK_EQ(throttle_get_latest_mapped(), 255);
+    CHECK_EQ(throttle_get_latest_raw(), SWEEP_HIGH);
+#endif
+}
+
+static void test_sampling_rate(void)
+{
+    // Every read takes 1 ms, then ADC_SAMPLING_TICKS of rest
+#ifdef CONFIG_TARGET_DUAL_THROTTLE
+    // The loop reads the throttle, then both again for the combined value
+    const uint32_t throttle_reads = 2 * THROTTLE_MAP_OVERSAMPLE;
+    const uint32_t loop_ms = 3 * THROTTLE_MAP_OVERSAMPLE + ADC_SAMPLING_TICKS;
+#else
+    const uint32_t throttle_reads = THROTTLE_MAP_OVERSAMPLE;
+    const uint32_t loop_ms = THROTTLE_MAP_OVERSAMPLE + ADC_SAMPLING_TICKS;
+#endif
+    uint32_t before = host_adc_reads(THROTTLE_PIN);
+    host_clock_advance_ms(10000);
+    uint32_t reads = host_adc_reads(THROTTLE_PIN) - before;
+    CHECK_NEAR(reads, 10000 * throttle_reads / loop_ms, throttle_reads);
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    host_nvs_reset();
+    settings_init();
+
+    RUN_TEST(test_calibration_from_a_sweep);
+    RUN_TEST(test_sampling_task_maps_the_hand);
+    RUN_TEST(test_sampling_rate);
+    return host_test_result();
+}
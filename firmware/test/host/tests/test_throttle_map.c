@@ -0,0 +1,64 @@
+#include "host_test.h"
+#include "throttle_map.h"
+
+HOST_TEST_DEFINE
+
+static void test_mean(void)
+{
+    int32_t samples[THROTTLE_MAP_OVERSAMPLE] = { 1000, 1002, 1004, 1006, 1008 };
+    CHECK_EQ(throttle_map_mean(samples, THROTTLE_MAP_OVERSAMPLE), 1004);
+    CHECK_EQ(throttle_map_mean(samples, 1), 1000);
+    CHECK_EQ(throttle_map_mean(samples, 0), -1);
+}
+
+static void test_linear_endpoints_and_clamp(void)
+{
+    CHECK_EQ(throttle_map_linear(500, 500, 3500), 0);
+    CHECK_EQ(throttle_map_linear(3500, 500, 3500), 255);
+    CHECK_EQ(throttle_map_linear(2000, 500, 3500), 127);
+    CHECK_EQ(throttle_map_linear(0, 500, 3500), 0);
+    CHECK_EQ(throttle_map_linear(4095, 500, 3500), 255);
+    // Empty range
+    CHECK_EQ(throttle_map_linear(2000, 3500, 3500), 0);
+    CHECK_EQ(throttle_map_linear(2000, 3500, 500), 0);
+}
+
+static void test_linear_is_monotonic(void)
+{
+    uint8_t last = 0;
+    for (uint32_t adc = 0; adc <= 4095; adc++) {
+        uint8_t mapped = throttle_map_linear(adc, 300, 3800);
+        CHECK(mapped >= last);
+        last = mapped;
+    }
+    CHECK_EQ(last, 255);
+}
+
+static void test_combined(void)
+{
+    const uint32_t t_min = 400, t_max = 3600, b_min = 500, b_max = 3500;
+
+    // Brake released fully (at its minimum) forces 0
+    CHECK_EQ(throttle_map_combined(2000, t_min, t_max, b_min, b_min, b_max), 0);
+    // Brake at its maximum hands over to the inverted throttle
+    CHECK_EQ(throttle_map_combined(t_max, t_min, t_max, b_max, b_min, b_max), THROTTLE_MAP_NEUTRAL);
+    CHECK_EQ(throttle_map_combined(t_min, t_min, t_max, b_max, b_min, b_max), 255);
+    // Halfway brake halves the throttle value
+    uint8_t full = throttle_map_combined(t_min, t_min, t_max, b_max, b_min, b_max);
+    uint8_t half = throttle_map_combined(t_min, t_min, t_max, (b_min + b_max) / 2, b_min, b_max);
+    CHECK_NEAR(half, full / 2, 1);
+    // Out of range readings are clamped
+    CHECK_EQ(throttle_map_combined(-5, t_min, t_max, 4095, b_min, b_max), 255);
+    // Empty ranges stay neutral
+    CHECK_EQ(throttle_map_combined(2000, t_min, t_min, 2000, b_min, b_max), THROTTLE_MAP_NEUTRAL);
+    CHECK_EQ(throttle_map_combined(2000, t_min, t_max, 2000, b_max, b_max), THROTTLE_MAP_NEUTRAL);
+}
+
+int main(void)
+{
+    RUN_TEST(test_mean);
+    RUN_TEST(test_linear_endpoints_and_clamp);
+    RUN_TEST(test_linear_is_monotonic);
+    RUN_TEST(test_combined);
+    return host_test_result();
+}
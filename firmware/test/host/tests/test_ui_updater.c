@@ -0,0 +1,142 @@
+#include <string.h>
+#include <stdlib.h>
+#include "host_test.h"
+#include "host_shim.h"
+#include "host_ble.h"
+#include "lvgl.h"
+#include "lcd.h"
+#include "ui.h"
+#include "screens.h"
+#include "ui_updater.h"
+#include "ble.h"
+#include "settings.h"
+#include "vesc_config.h"
+#include "kinematics.h"
+#include "telemetry_decode.h"
+
+HOST_TEST_DEFINE
+
+// A display that only counts what LVGL flushes to it
+static lv_disp_draw_buf_t draw_buf;
+static lv_disp_drv_t disp_drv;
+static uint32_t flushed_pixels = 0;
+
+static void flush_cb(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    (void)color_map;
+    flushed_pixels += lv_area_get_size(area);
+    lv_disp_flush_ready(drv);
+}
+
+static void display_init(void)
+{
+    lv_init();
+    size_t pixels = LV_HOR_RES_MAX * (LV_VER_RES_MAX / 8);
+    lv_disp_draw_buf_init(&draw_buf, malloc(pixels * sizeof(lv_color_t)), NULL, pixels);
+    lv_disp_drv_init(&disp_drv);
+    disp_drv.flush_cb = flush_cb;
+    disp_drv.draw_buf = &draw_buf;
+    disp_drv.hor_res = LV_HOR_RES_MAX;
+    disp_drv.ver_res = LV_VER_RES_MAX;
+    lv_disp_drv_register(&disp_drv);
+}
+
+static const char *label_text(lv_obj_t *label)
+{
+    return label != NULL ? lv_label_get_text(label) : "";
+}
+
+static void test_screens_render(void)
+{
+    ui_init();
+    lv_scr_load(objects.home_screen);
+    lv_refr_now(NULL);
+    CHECK(objects.speedlabel != NULL);
+    CHECK_EQ(flushed_pixels, LV_HOR_RES_MAX * LV_VER_RES_MAX);
+}
+
+static void update_speed_44(void)
+{
+    ui_update_speed(44);
+}
+
+static void test_direct_updates(void)
+{
+    ui_update_speed(42);
+    CHECK(strcmp(label_text(objects.speedlabel), "42") == 0);
+    ui_update_skate_battery_percentage(77);
+    CHECK(strcmp(label_text(objects.skate_battery_text), "77") == 0);
+
+    // Not on the active screen, nothing changes
+    lv_scr_load(objects.splash_screen);
+    ui_update_speed(43);
+    CHECK(strcmp(label_text(objects.speedlabel), "42") == 0);
+    lv_scr_load(objects.home_screen);
+
+    // Another holder of the LVGL mutex makes the update skip after the
+    // mutex timeout, not block
+    CHECK(take_lvgl_mutex());
+    host_test_run_in_task(update_speed_44);
+    host_clock_advance_ms(20);
+    give_lvgl_mutex();
+    CHECK(strcmp(label_text(objects.speedlabel), "42") == 0);
+}
+
+static void start_tasks(void)
+{
+    ui_start_update_tasks();
+}
+
+static void test_speed_task_follows_telemetry(void)
+{
+    host_test_run_in_task(start_tasks);
+    host_clock_advance_ms(600);
+
+    host_ble_connect(BLE_LINK_PRIMARY);
+    vesc_config_t config;
+    vesc_config_load(&config);
+    int32_t erpm = 20000;
+
+    telemetry_snapshot_t snapshot = {0};
+    snapshot.erpm = erpm;
+    snapshot.voltage_c100 = 4000;
+    uint8_t frame[TELEMETRY_FRAME_LEN];
+    telemetry_encode_frame(&snapshot, frame);
+    host_ble_notify(BLE_LINK_PRIMARY, frame, sizeof(frame));
+    host_clock_advance_ms(50);
+
+    char expected[12];
+    snprintf(expected, sizeof(expected), "%ld", (long)kinematics_get_speed(false));
+    CHECK(kinematics_get_speed(false) > 0);
+    CHECK(strcmp(label_text(objects.speedlabel), expected) == 0);
+    CHECK(strcmp(label_text(objects.static_speed), "km/h") == 0);
+
+    // Unit change picked up on the forced reload
+    config.speed_unit_mph = true;
+    vesc_config_save(&config);
+    ui_force_config_reload();
+    host_clock_advance_ms(50);
+    CHECK(strcmp(label_text(objects.static_speed), "mi/h") == 0);
+    snprintf(expected, sizeof(expected), "%ld", (long)kinematics_get_speed(true));
+    CHECK(strcmp(label_text(objects.speedlabel), expected) == 0);
+
+    // Disconnect zeroes the speed
+    host_ble_disconnect(BLE_LINK_PRIMARY);
+    CHECK(strcmp(label_text(objects.speedlabel), "0") == 0);
+}
+
+int main(void)
+{
+    host_clock_set_mode(HOST_CLOCK_VIRTUAL);
+    host_nvs_reset();
+    settings_init();
+    kinematics_init();
+    display_init();
+    ui_updater_init();
+    spp_client_demo_init();
+
+    RUN_TEST(test_screens_render);
+    RUN_TEST(test_direct_updates);
+    RUN_TEST(test_speed_task_follows_telemetry);
+    return host_test_result();
+}
@@ -0,0 +1,188 @@
+#include <string.h>
+#include "host_test.h"
+#include "esp_rom_crc.h"
+#include "usb_proto.h"
+
+// COBS framing and the CRC of usb_proto.c: known encodings, round trips
+// around the 254-byte group limit, and frames that usb_proto_handle_frame
+// must drop without a reply.
+
+HOST_TEST_DEFINE
+
+static uint8_t written[2 * USB_PROTO_MAX_ENCODED];
+static size_t written_len;
+
+static void capture(const void *data, size_t len)
+{
+    if (written_len + len <= sizeof(written)) {
+        memcpy(written + written_len, data, len);
+    }
+    written_len += len;
+}
+
+static void check_encoding(const uint8_t *in, size_t len, const uint8_t *expected, size_t expected_len)
+{
+    uint8_t out[16];
+    CHECK_EQ(usb_proto_cobs_encode(in, len, out), expected_len);
+    CHECK(memcmp(out, expected, expected_len) == 0);
+
+    uint8_t decoded[16];
+    CHECK_EQ(usb_proto_cobs_decode(out, expected_len, decoded, sizeof(decoded)), len);
+    CHECK(memcmp(decoded, in, len) == 0);
+}
+
+static void test_known_encodings(void)
+{
+    check_encoding((const uint8_t[]){ 0x00 }, 1, (const uint8_t[]){ 0x01, 0x01 }, 2);
+    check_encoding((const uint8_t[]){ 0x00, 0x00 }, 2, (const uint8_t[]){ 0x01, 0x01, 0x01 }, 3);
+    check_encoding((const uint8_t[]){ 0x11, 0x22, 0x00, 0x33 }, 4,
+                   (const uint8_t[]){ 0x03, 0x11, 0x22, 0x02, 0x33 }, 5);
+    check_encoding((const uint8_t[]){ 0x11, 0x00, 0x00, 0x00 }, 4,
+                   (const uint8_t[]){ 0x02, 0x11, 0x01, 0x01, 0x01 }, 5);
+}
+
+// len bytes, non-zero except where zero_every hits (0 for none)
+static void fill(uint8_t *buf, size_t len, size_t zero_every)
+{
+    for (size_t i = 0; i < len; i++) {
+        buf[i] = (zero_every > 0 && i % zero_every == zero_every - 1) ? 0 : (uint8_t)(i % 255 + 1);
+    }
+}
+
+static void check_round_trip(const uint8_t *in, size_t len)
+{
+    static uint8_t encoded[USB_PROTO_MAX_ENCODED];
+    static uint8_t decoded[USB_PROTO_MAX_FRAME];
+
+    size_t encoded_len = usb_proto_cobs_encode(in, len, encoded);
+    CHECK(encoded_len <= len + len / 254 + 1);
+    CHECK(memchr(encoded, 0, encoded_len) == NULL);
+    CHECK_EQ(usb_proto_cobs_decode(encoded, encoded_len, decoded, sizeof(decoded)), len);
+    CHECK(memcmp(decoded, in, len) == 0);
+}
+
+static void test_round_trip_around_254_byte_runs(void)
+{
+    static uint8_t buf[USB_PROTO_MAX_FRAME];
+    static const size_t lengths[] = { 0, 1, 253, 254, 255, 256, 507, 508, 509, USB_PROTO_MAX_FRAME };
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+        // One run of non-zero bytes, and runs cut by a zero either side of 254
+        fill(buf, lengths[l], 0);
+        check_round_trip(buf, lengths[l]);
+        fill(buf, lengths[l], 254);
+        check_round_trip(buf, lengths[l]);
+        fill(buf, lengths[l], 255);
+        check_round_trip(buf, lengths[l]);
+        // All zeros
+        memset(buf, 0, lengths[l]);
+        check_round_trip(buf, lengths[l]);
+    }
+
+    // A 254-byte run takes a full group with no implied zero after it
+    uint8_t encoded[300];
+    fill(buf, 254, 0);
+    CHECK_EQ(usb_proto_cobs_encode(buf, 254, encoded), 256);
+    CHECK_EQ(encoded[0], 0xFF);
+    CHECK_EQ(encoded[255], 0x01);
+}
+
+static void test_decode_refuses_bad_input(void)
+{
+    uint8_t out[8];
+    // Zero inside the frame, group running past the end, output too small
+    CHECK_EQ(usb_proto_cobs_decode((const uint8_t[]){ 0x02, 0x11, 0x00, 0x01 }, 4, out, sizeof(out)), 0);
+    CHECK_EQ(usb_proto_cobs_decode((const uint8_t[]){ 0x05, 0x11, 0x22 }, 3, out, sizeof(out)), 0);
+    CHECK_EQ(usb_proto_cobs_decode((const uint8_t[]){ 0x04, 0x11, 0x22, 0x33 }, 4, out, 2), 0);
+}
+
+// Encoded frame between the delimiters, as a host sends it
+static size_t build_frame(uint8_t type, uint8_t seq, const uint8_t *payload, size_t len, uint8_t *encoded)
+{
+    static uint8_t frame[USB_PROTO_MAX_FRAME];
+    frame[0] = type;
+    frame[1] = seq;
+    if (len > 0) {
+        memcpy(&frame[2], payload, len);
+    }
+    uint32_t crc = esp_rom_crc32_le(0, frame, len + 2);
+    memcpy(&frame[len + 2], &crc, sizeof(crc));
+    return usb_proto_cobs_encode(frame, len + USB_PROTO_OVERHEAD, encoded);
+}
+
+static void test_echo_round_trip(void)
+{
+    static uint8_t payload[USB_PROTO_MAX_PAYLOAD];
+    static uint8_t encoded[USB_PROTO_MAX_ENCODED];
+    static uint8_t reply[USB_PROTO_MAX_FRAME];
+
+    // A run of zeros and a run longer than one COBS group
+    fill(payload, sizeof(payload), 0);
+    memset(&payload[10], 0, 20);
+
+    size_t len = build_frame(USB_MSG_ECHO, 0x5A, payload, sizeof(payload), encoded);
+    written_len = 0;
+    CHECK(!usb_proto_handle_frame(encoded, len));
+
+    CHECK(written_len > 2);
+    CHECK_EQ(written[0], 0);
+    CHECK_EQ(written[written_len - 1], 0);
+    size_t reply_len = usb_proto_cobs_decode(&written[1], written_len - 2, reply, sizeof(reply));
+    CHECK_EQ(reply_len, sizeof(payload) + USB_PROTO_OVERHEAD);
+    if (reply_len != sizeof(payload) + USB_PROTO_OVERHEAD) {
+        return;
+    }
+    CHECK_EQ(reply[0], USB_MSG_ECHO | USB_PROTO_REPLY);
+    CHECK_EQ(reply[1], 0x5A);
+    CHECK(memcmp(&reply[2], payload, sizeof(payload)) == 0);
+    uint32_t crc;
+    memcpy(&crc, &reply[reply_len - 4], sizeof(crc));
+    CHECK_EQ(crc, esp_rom_crc32_le(0, reply, reply_len - 4));
+}
+
+static void test_bad_crc_is_dropped(void)
+{
+    uint8_t frame[8] = { USB_MSG_PING, 1 };
+    uint32_t crc = esp_rom_crc32_le(0, frame, 2) ^ 0x00010000;
+    memcpy(&frame[2], &crc, sizeof(crc));
+    uint8_t encoded[16];
+    size_t len = usb_proto_cobs_encode(frame, USB_PROTO_OVERHEAD, encoded);
+
+    written_len = 0;
+    CHECK(!usb_proto_handle_frame(encoded, len));
+    CHECK_EQ(written_len, 0);
+
+    // The same frame with the right CRC is answered
+    len = build_frame(USB_MSG_PING, 1, NULL, 0, encoded);
+    CHECK(!usb_proto_handle_frame(encoded, len));
+    CHECK(written_len > 0);
+}
+
+static void test_truncated_frame_is_dropped(void)
+{
+    const uint8_t payload[] = { 1, 2, 0, 4 };
+    uint8_t encoded[32];
+    size_t len = build_frame(USB_MSG_ECHO, 2, payload, sizeof(payload), encoded);
+
+    // Every cut either breaks the COBS groups, the minimum length or the CRC
+    written_len = 0;
+    for (size_t cut = 1; cut < len; cut++) {
+        CHECK(!usb_proto_handle_frame(encoded, cut));
+    }
+    CHECK_EQ(written_len, 0);
+
+    CHECK(!usb_proto_handle_frame(encoded, len));
+    CHECK(written_len > 0);
+}
+
+int main(void)
+{
+    usb_proto_init(capture);
+
+    RUN_TEST(test_known_encodings);
+    RUN_TEST(test_round_trip_around_254_byte_runs);
+    RUN_TEST(test_decode_refuses_bad_input);
+    RUN_TEST(test_echo_round_trip);
+    RUN_TEST(test_bad_crc_is_dropped);
+    RUN_TEST(test_truncated_frame_is_dropped);
+    return host_test_result();
+}
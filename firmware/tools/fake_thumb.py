@@ -0,0 +1,545 @@
+#!/usr/bin/env python3
+"""Simulated GS-THUMB receiver for soak and throughput tests of the remote.
+
+Runs on a Linux (BlueZ) or macOS host with a Bluetooth adapter and stands
+in for the receiver board. It advertises as GS-THUMB with the SPP service
+(0xABF0) and the characteristics ble.c expects:
+
+    0xABF1  data receive, throttle writes from the remote
+    0xABF2  data notify, telemetry frames to the remote
+    0xABF3  command
+    0xABF4  status notify
+
+Telemetry is a synthetic ride (speed sweep, current, sag, warming FETs,
+cell spread) in the 55-byte layout of main/telemetry_schema.h, or with
+--frame-version 2 in the v2 layout that only carries the --cells valid
+cells. Faults can be injected while it runs:
+
+    --corrupt P          fraction of frames replaced by a corrupt one; half
+                         are truncated (the remote must reject them), half
+                         are 55 random bytes (the remote must survive them)
+    --disconnect-every S stop the peripheral every S seconds for --down-time,
+                         the remote has to rescan and reconnect
+    --mtu-schedule L     cycle through ATT MTUs, "23:20,185:20,517:60" holds
+                         each MTU for the given seconds. A server cuts a
+                         notify to MTU - 3 bytes, so telemetry notifies are
+                         cut the same way; the remote must reject the cut
+                         frames and take the whole ones
+
+An ESP-NOW pairing offer on the command characteristic (espnow pair ble
+on the remote) is answered on the status characteristic with --espnow-mac,
+so the BLE side of the handshake can be checked. The remote only sends
+the offer once the link is encrypted, so the host has to accept Just Works
+pairing (bluetoothctl: agent NoInputNoOutput, default-agent). The ESP-NOW
+traffic itself needs a second ESP32 as the peer.
+
+With --ota IMAGE the firmware image is pushed to the remote over the
+status/command characteristics (main/ble_ota.h) once it has subscribed,
+the ride is parked so the remote accepts it, and the report adds the
+transfer rate measured here and the one the remote reports. Use
+--ota-bad-hash to check that a corrupted transfer is refused. BEGIN is
+refused until the link is encrypted, so the host has to accept the Just
+Works pairing the remote starts, and the image must be signed with the
+remote's key (build/remote.bin from idf.py build is).
+
+With --name GS-THUMB-2 or --name GS-BMS it stands in for the second drive
+or the standalone BMS instead (main/ble_transport.h), next to the real
+receiver or another instance on a second adapter; the remote's links
+command then shows the per-link rates.
+
+Every throttle write is timestamped and can be saved with --writes. With
+--remote the remote's USB port is polled for its counters (usbproto.py
+system) at the start, every --poll seconds and at the end. The report then
+covers frames decoded against frames sent, rejected frames, reconnect time
+and heap drift. Ctrl-C or --duration ends the run.
+
+    fake_thumb.py --rate 50 --duration 7200 --remote /dev/ttyACM0
+    fake_thumb.py --rate 200 --corrupt 0.01 --disconnect-every 300 --writes writes.csv
+    fake_thumb.py --ota build/remote.bin --duration 300
+
+Backend comparison. Pings on the command characteristic (main/ble_bench.h)
+are echoed on the status characteristic and the remote times the round
+trip. With --backend-pings N and --remote, the run types ble_backend ping N
+on the remote's console once it writes, and the report ends with the
+remote's ble_backend output: free heap and low-water mark, the image in its
+app slot, the notify round trip (min, p50, p99, max) and what each throttle
+write cost adc_send_task. To compare Bluedroid and NimBLE
+(main/ble_transport.h), run the same soak against each build, with the
+same board, adapter and distance:
+
+    idf.py build && idf.py size && idf.py -p /dev/ttyACM0 flash
+    fake_thumb.py --rate 50 --duration 3600 --remote /dev/ttyACM0 \
+        --backend-pings 1000 --writes writes-bluedroid.csv > soak-bluedroid.txt
+
+    rm sdkconfig
+    idf.py -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;sdkconfig.defaults.nimble" build
+    idf.py size && idf.py -p /dev/ttyACM0 flash
+    fake_thumb.py --rate 50 --duration 3600 --remote /dev/ttyACM0 \
+        --backend-pings 1000 --writes writes-nimble.csv > soak-nimble.txt
+
+Decoded against sent frames, heap drift and the throttle write intervals
+(--writes) come from the same runs.
+
+The MTU the host stack negotiates cannot be forced from here, so
+--mtu-schedule emulates the change on top of it, for telemetry notifies
+only (an OTA push keeps the chunk size the remote asked for). Needs bless
+(and pyserial for --remote).
+"""
+
+import argparse
+import asyncio
+import csv
+import hashlib
+import math
+import random
+import struct
+import sys
+import time
+
+import telemetry_schema
+
+SERVICE_UUID = "0000abf0-0000-1000-8000-00805f9b34fb"
+DATA_RECV_UUID = "0000abf1-0000-1000-8000-00805f9b34fb"
+DATA_NOTIFY_UUID = "0000abf2-0000-1000-8000-00805f9b34fb"
+COMMAND_UUID = "0000abf3-0000-1000-8000-00805f9b34fb"
+STATUS_UUID = "0000abf4-0000-1000-8000-00805f9b34fb"
+
+FRAME_LEN = telemetry_schema.FRAME_LEN
+PING_LEN = 5        # 'L' and the remote's u32 time, main/ble_bench.h
+
+OTA_BEGIN, OTA_DATA, OTA_END, OTA_ABORT = 0x01, 0x02, 0x03, 0x04
+OTA_READY, OTA_ACK, OTA_NAK, OTA_DONE = 0x81, 0x82, 0x83, 0x84
+OTA_RESULTS = ["ok", "busy", "bad size", "board moving", "flash error", "hash mismatch",
+               "invalid image", "aborted", "timeout", "link not encrypted"]
+OTA_ERR_UNENCRYPTED = 9
+OTA_BEGIN_ATTEMPTS = 5      # The remote pairs after refusing the first BEGIN
+
+
+def encode_frame(temp_mos, temp_motor, current_motor, current_in, erpm, voltage,
+                 bms_voltage, bms_current, bms_remaining, bms_nominal, cell_mv, version=1):
+    """Telemetry notify in the layout of main/telemetry_schema.h, cells in mV."""
+    frame = telemetry_schema.encode({
+        "temp_mos": temp_mos, "temp_motor": temp_motor, "current_motor": current_motor,
+        "current_in": current_in, "erpm": erpm, "voltage": voltage, "bms_voltage": bms_voltage,
+        "bms_current": bms_current, "bms_remaining": bms_remaining, "bms_nominal": bms_nominal,
+    }, cell_mv, version)
+    assert len(frame) == (FRAME_LEN if version == 1 else telemetry_schema.v2_len(len(cell_mv)))
+    return frame
+
+
+def parse_mtu_schedule(text):
+    """[(mtu, seconds)] from "23:20,517:60"."""
+    schedule = []
+    for item in text.split(","):
+        mtu, seconds = item.split(":")
+        if not 23 <= int(mtu) <= 517 or float(seconds) <= 0:
+            raise ValueError("MTU must be 23-517 and the time positive: %s" % item)
+        schedule.append((int(mtu), float(seconds)))
+    return schedule
+
+
+class Ride:
+    """Deterministic ride profile, a function of the time since start."""
+
+    def __init__(self, cells=12, capacity_ah=10.0, parked=False, version=1):
+        self.cells = cells
+        self.version = version
+        self.parked = parked
+        self.capacity_ah = capacity_ah
+        self.used_ah = 0.0
+        self.last_t = 0.0
+
+    def frame(self, t):
+        dt = t - self.last_t
+        self.last_t = t
+        # 40 s speed sweep, with braking (negative current) on the way down
+        phase = 0.0 if self.parked else math.sin(2 * math.pi * t / 40.0)
+        erpm = max(0.0, phase) * 24000
+        current_motor = 35.0 * math.cos(2 * math.pi * t / 40.0) * (1 if phase > 0 else 0.3)
+        current_in = current_motor * erpm / 30000.0
+        self.used_ah = min(self.capacity_ah, self.used_ah + max(current_in, 0) * dt / 3600.0)
+
+        soc = 1.0 - self.used_ah / self.capacity_ah
+        rest_mv = 3300 + 900 * soc
+        sag_mv = current_in * 4
+        cell_mv = [int(rest_mv - sag_mv - (i % 4) * 6) for i in range(self.cells)]
+        pack_v = sum(cell_mv) / 1000.0
+
+        temp_mos = 30.0 + min(50.0, t / 120.0)
+        temp_motor = 28.0 + min(60.0, t / 90.0)
+        return encode_frame(temp_mos, temp_motor, current_motor, current_in, erpm, pack_v,
+                            pack_v, current_in, self.capacity_ah - self.used_ah,
+                            self.capacity_ah, cell_mv, self.version)
+
+
+def is_truncated(frame):
+    """True for a length the remote rejects, neither full nor v2."""
+    try:
+        telemetry_schema.decode(frame)
+        return False
+    except ValueError:
+        return True
+
+
+def corrupt_frame(rng):
+    if rng.random() < 0.5:
+        frame = bytearray(rng.getrandbits(8) for _ in range(rng.randrange(1, FRAME_LEN)))
+        if not is_truncated(frame):
+            frame[telemetry_schema.COUNT_OFS] = 0xFF    # Would pass as v2
+        return bytes(frame)
+    return bytes(rng.getrandbits(8) for _ in range(FRAME_LEN))
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(len(ordered) * p))]
+
+
+class FakeThumb:
+    def __init__(self, args):
+        self.args = args
+        self.rng = random.Random(args.seed)
+        self.ride = Ride(args.cells, parked=bool(args.ota), version=args.frame_version)
+        self.mtu_schedule = parse_mtu_schedule(args.mtu_schedule) if args.mtu_schedule else None
+        self.mtu = None
+        self.mtu_changes = 0
+        self.mtu_cut = 0
+        self.server = None
+        self.started = time.monotonic()
+        self.sent = 0
+        self.truncated = 0
+        self.garbage = 0
+        self.disconnects = 0
+        self.up_since = None
+        self.reconnect_s = []
+        self.writes = []          # (time since start, value)
+        self.remote_samples = []  # (time since start, counters)
+        self.loop = None
+        self.ota_replies = None
+        self.ota_result = None
+        self.pings = 0
+        self.backend_report = None
+
+    def on_write(self, characteristic, value, **kwargs):
+        uuid = str(characteristic.uuid).lower()
+        if uuid == COMMAND_UUID and value:
+            self.on_command(bytes(value))
+            return
+        if uuid != DATA_RECV_UUID or not value:
+            return
+        now = time.monotonic() - self.started
+        if self.up_since is not None:
+            self.reconnect_s.append(now - self.up_since)
+            self.up_since = None
+        self.writes.append((now, value[0]))
+
+    def on_command(self, value):
+        # Backend ping (main/ble_bench.h): straight back on the status notify
+        if value[:1] == b"L" and len(value) == PING_LEN:
+            self.pings += 1
+            self.notify_status(value)
+            return
+        if value[:1] == b"O" and len(value) >= 2 and self.ota_replies is not None:
+            # Write callbacks may come from another thread
+            self.loop.call_soon_threadsafe(self.ota_replies.put_nowait, value)
+            return
+        # 'P', remote MAC, channel, key: see main/espnow_packet.h
+        if len(value) != 1 + 6 + 1 + 16 or value[0] != ord("P"):
+            return
+        mac = ":".join("%02x" % b for b in value[1:7])
+        print("ESP-NOW pairing offer from %s, channel %d, key %s" % (mac, value[7], value[8:].hex()))
+        answer = b"P" + bytes.fromhex(self.args.espnow_mac.replace(":", ""))
+        self.server.get_characteristic(STATUS_UUID).value = bytearray(answer)
+        self.server.update_value(SERVICE_UUID, STATUS_UUID)
+
+    async def start_server(self):
+        from bless import (BlessServer, GATTAttributePermissions,
+                           GATTCharacteristicProperties)
+
+        self.server = BlessServer(name=self.args.name)
+        self.server.read_request_func = lambda characteristic, **kwargs: characteristic.value
+        self.server.write_request_func = self.on_write
+        await self.server.add_new_service(SERVICE_UUID)
+        rw = GATTAttributePermissions.readable | GATTAttributePermissions.writeable
+        write = GATTCharacteristicProperties.read | GATTCharacteristicProperties.write_without_response
+        command = write | GATTCharacteristicProperties.write
+        notify = GATTCharacteristicProperties.read | GATTCharacteristicProperties.notify
+        for uuid, props in ((DATA_RECV_UUID, write), (DATA_NOTIFY_UUID, notify),
+                            (COMMAND_UUID, command), (STATUS_UUID, notify)):
+            await self.server.add_new_characteristic(SERVICE_UUID, uuid, props, bytearray(1), rw)
+        await self.server.start()
+
+    def current_mtu(self, elapsed):
+        """Emulated MTU of the schedule at this time, None without one."""
+        if not self.mtu_schedule:
+            return None
+        cycle = sum(seconds for _, seconds in self.mtu_schedule)
+        t = elapsed % cycle
+        for mtu, seconds in self.mtu_schedule:
+            if t < seconds:
+                return mtu
+            t -= seconds
+        return self.mtu_schedule[-1][0]
+
+    async def notify(self, frame):
+        self.server.get_characteristic(DATA_NOTIFY_UUID).value = bytearray(frame)
+        self.server.update_value(SERVICE_UUID, DATA_NOTIFY_UUID)
+
+    def notify_status(self, message):
+        self.server.get_characteristic(STATUS_UUID).value = bytearray(message)
+        self.server.update_value(SERVICE_UUID, STATUS_UUID)
+
+    async def ota_reply(self, timeout):
+        value = await asyncio.wait_for(self.ota_replies.get(), timeout)
+        return value[1], value[2:]
+
+    async def push_ota(self, image):
+        """Streams the image, returns (result, seconds, remote bytes/s, NAKs)."""
+        digest = hashlib.sha256(image).digest()
+        if self.args.ota_bad_hash:
+            digest = bytes([digest[0] ^ 0xFF]) + digest[1:]
+        while not await self.server.is_connected():
+            await asyncio.sleep(0.5)
+        await asyncio.sleep(3.0)    # Service discovery and notify subscriptions
+
+        for _ in range(OTA_BEGIN_ATTEMPTS):
+            self.notify_status(b"O" + bytes([OTA_BEGIN]) + struct.pack("<I", len(image)) + digest)
+            op, payload = await self.ota_reply(10)
+            while op != OTA_READY:
+                op, payload = await self.ota_reply(10)
+            result, max_chunk, window = struct.unpack("<BHI", payload[:7])
+            if result != OTA_ERR_UNENCRYPTED:
+                break
+            await asyncio.sleep(2.0)    # Pairing
+        if result != 0:
+            return OTA_RESULTS[result], 0.0, 0, 0
+        chunk = min(max_chunk, self.args.ota_chunk) if self.args.ota_chunk else max_chunk
+        print("OTA: %d bytes, %d byte chunks, %d byte window" % (len(image), chunk, window))
+
+        start = time.monotonic()
+        sent = acked = naks = 0
+        end_sent = False
+        while True:
+            while sent < len(image) and sent - acked < window:
+                data = image[sent:sent + chunk]
+                self.notify_status(b"O" + bytes([OTA_DATA]) + struct.pack("<I", sent) + data)
+                sent += len(data)
+                await asyncio.sleep(0)
+            if sent >= len(image) and not end_sent:
+                self.notify_status(b"O" + bytes([OTA_END]))
+                end_sent = True
+            op, payload = await self.ota_reply(30 if end_sent else 10)
+            if op == OTA_ACK:
+                acked = max(acked, struct.unpack("<I", payload[:4])[0])
+            elif op == OTA_NAK:
+                # Resend from there, END again once caught up
+                naks += 1
+                sent = struct.unpack("<I", payload[:4])[0]
+                end_sent = False
+            elif op == OTA_DONE:
+                result, rate = struct.unpack("<BI", payload[:5])
+                return OTA_RESULTS[result], time.monotonic() - start, rate, naks
+
+    async def run_ota(self):
+        with open(self.args.ota, "rb") as f:
+            image = f.read()
+        try:
+            result, seconds, remote_rate, naks = await self.push_ota(image)
+        except asyncio.TimeoutError:
+            result, seconds, remote_rate, naks = "no reply from the remote", 0.0, 0, 0
+        self.ota_result = (len(image), result, seconds, remote_rate, naks)
+
+    async def remote_console(self, remote, line):
+        loop = asyncio.get_running_loop()
+        return await loop.run_in_executor(None, remote.console, line)
+
+    async def poll_remote(self, remote):
+        loop = asyncio.get_running_loop()
+        counters = await loop.run_in_executor(None, remote.get_system)
+        self.remote_samples.append((time.monotonic() - self.started, counters))
+
+    async def run(self):
+        args = self.args
+        remote = None
+        if args.remote:
+            from usbproto import Remote
+            remote = Remote(args.remote)
+            await self.poll_remote(remote)
+
+        await self.start_server()
+        self.up_since = 0.0
+        ota_task = None
+        if args.ota:
+            self.loop = asyncio.get_running_loop()
+            self.ota_replies = asyncio.Queue()
+            ota_task = asyncio.create_task(self.run_ota())
+        period = 1.0 / args.rate
+        next_frame = time.monotonic()
+        next_poll = next_frame + args.poll
+        next_drop = next_frame + args.disconnect_every if args.disconnect_every else None
+        end = next_frame + args.duration if args.duration else None
+        pings_started = False
+
+        try:
+            while end is None or time.monotonic() < end:
+                now = time.monotonic()
+                if ota_task is not None and ota_task.done():
+                    break
+                if next_drop is not None and now >= next_drop:
+                    await self.server.stop()
+                    self.disconnects += 1
+                    await asyncio.sleep(args.down_time)
+                    await self.start_server()
+                    self.up_since = time.monotonic() - self.started
+                    next_drop = time.monotonic() + args.disconnect_every
+                    next_frame = time.monotonic()
+                if remote and now >= next_poll:
+                    await self.poll_remote(remote)
+                    next_poll += args.poll
+
+                if await self.server.is_connected():
+                    if remote and args.backend_pings and not pings_started and self.writes:
+                        print((await self.remote_console(remote, "ble_backend ping %d" % args.backend_pings)).strip())
+                        pings_started = True
+                    if self.rng.random() < args.corrupt:
+                        frame = corrupt_frame(self.rng)
+                        if len(frame) != FRAME_LEN:
+                            self.truncated += 1
+                        else:
+                            self.garbage += 1
+                    else:
+                        frame = self.ride.frame(now - self.started)
+                    mtu = self.current_mtu(now - self.started)
+                    if mtu != self.mtu:
+                        if self.mtu is not None:
+                            self.mtu_changes += 1
+                            print("MTU %d -> %d" % (self.mtu, mtu))
+                        self.mtu = mtu
+                    if mtu is not None and len(frame) > mtu - 3:
+                        frame = frame[:mtu - 3]
+                        if is_truncated(frame):
+                            self.mtu_cut += 1
+                    await self.notify(frame)
+                    self.sent += 1
+
+                next_frame += period
+                delay = next_frame - time.monotonic()
+                if delay > 0:
+                    await asyncio.sleep(delay)
+                else:
+                    next_frame = time.monotonic()    # Behind, do not burst
+        except (KeyboardInterrupt, asyncio.CancelledError):
+            pass
+        finally:
+            if ota_task is not None and not ota_task.done():
+                ota_task.cancel()
+            if remote and args.backend_pings:
+                self.backend_report = await self.remote_console(remote, "ble_backend")
+            await self.server.stop()
+            if remote:
+                await self.poll_remote(remote)
+                remote.close()
+
+    def report(self, out=sys.stdout):
+        elapsed = time.monotonic() - self.started
+        out.write("run: %.0f s at %d Hz, frame v%d\n" % (elapsed, self.args.rate, self.args.frame_version))
+        out.write("frames sent: %d (%d truncated, %d garbage)\n" %
+                  (self.sent, self.truncated, self.garbage))
+        if self.mtu_schedule:
+            out.write("MTU changes: %d, frames cut by the MTU: %d\n" % (self.mtu_changes, self.mtu_cut))
+        out.write("disconnects injected: %d\n" % self.disconnects)
+        if self.pings:
+            out.write("backend pings echoed: %d\n" % self.pings)
+        if self.reconnect_s:
+            out.write("reconnect to first write: min %.2f s, median %.2f s, max %.2f s\n" %
+                      (min(self.reconnect_s), percentile(self.reconnect_s, 0.5), max(self.reconnect_s)))
+
+        if self.ota_result:
+            size, result, seconds, remote_rate, naks = self.ota_result
+            out.write("ota: %s, %d bytes in %.1f s (%.0f B/s here, %d B/s on the remote), %d NAKs\n" %
+                      (result, size, seconds, size / seconds if seconds else 0, remote_rate, naks))
+
+        gaps = [b[0] - a[0] for a, b in zip(self.writes, self.writes[1:])]
+        if gaps:
+            out.write("throttle writes: %d, interval mean %.1f ms, p99 %.1f ms, max %.1f ms\n" %
+                      (len(self.writes), 1000 * sum(gaps) / len(gaps),
+                       1000 * percentile(gaps, 0.99), 1000 * max(gaps)))
+
+        if len(self.remote_samples) >= 2:
+            (t0, first), (t1, last) = self.remote_samples[0], self.remote_samples[-1]
+            decoded = last["frames_decoded"] - first["frames_decoded"]
+            rejected = last["frames_rejected"] - first["frames_rejected"]
+            valid_sent = self.sent - self.truncated - self.mtu_cut
+            lost = valid_sent - decoded
+            out.write("remote decoded: %d of %d valid frames (%d lost, %.2f%%), %.1f frames/s\n" %
+                      (decoded, valid_sent, lost, 100.0 * lost / max(1, valid_sent),
+                       decoded / max(1e-9, t1 - t0)))
+            out.write("remote rejected: %d (%d truncated, %d cut by the MTU sent)\n" %
+                      (rejected, self.truncated, self.mtu_cut))
+            out.write("remote connects: %d\n" % (last["connects"] - first["connects"]))
+            heap = [s["free_heap"] for _, s in self.remote_samples]
+            out.write("remote heap: %d -> %d bytes free (%+d), lowest %d, low-water mark %d\n" %
+                      (heap[0], heap[-1], heap[-1] - heap[0], min(heap), last["min_free_heap"]))
+        if self.backend_report:
+            out.write(self.backend_report.strip() + "\n")
+
+    def save_writes(self, path):
+        with open(path, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(["time_s", "value"])
+            for t, value in self.writes:
+                writer.writerow(["%.4f" % t, value])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rate", type=int, default=20, help="telemetry frames per second, 1-200")
+    parser.add_argument("--duration", type=float, default=0, help="seconds, 0 runs until Ctrl-C")
+    parser.add_argument("--cells", type=int, default=12)
+    parser.add_argument("--frame-version", type=int, default=1, choices=[1, 2],
+                        help="1: 55-byte frames, 2: only the valid cells")
+    parser.add_argument("--mtu-schedule", help="emulated MTUs and seconds each, e.g. 23:20,517:60")
+    parser.add_argument("--corrupt", type=float, default=0.0, help="fraction of corrupt frames")
+    parser.add_argument("--disconnect-every", type=float, default=0, help="seconds between drops")
+    parser.add_argument("--down-time", type=float, default=2.0, help="seconds the peripheral stays away")
+    parser.add_argument("--remote", help="USB serial port of the remote, for its counters")
+    parser.add_argument("--poll", type=float, default=60.0, help="seconds between counter polls")
+    parser.add_argument("--writes", help="save the timestamped throttle writes to this CSV")
+    parser.add_argument("--backend-pings", type=int, default=0,
+                        help="with --remote: notify round trips for the remote to time, see above")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--name", default="GS-THUMB", choices=["GS-THUMB", "GS-THUMB-2", "GS-BMS"],
+                        help="advertised name, picks the remote's link")
+    parser.add_argument("--ota", help="firmware image to push to the remote")
+    parser.add_argument("--ota-chunk", type=int, default=0, help="chunk size cap, default the remote's maximum")
+    parser.add_argument("--ota-bad-hash", action="store_true", help="send a wrong SHA-256 on purpose")
+    parser.add_argument("--espnow-mac", default="02:00:00:00:00:01",
+                        help="MAC sent back to an ESP-NOW pairing offer")
+    args = parser.parse_args()
+    if not 1 <= args.rate <= 200:
+        sys.exit("--rate must be between 1 and 200")
+    if not 0 <= args.cells <= telemetry_schema.MAX_CELLS:
+        sys.exit("--cells must be between 0 and %d" % telemetry_schema.MAX_CELLS)
+    if args.backend_pings and not args.remote:
+        sys.exit("--backend-pings needs --remote")
+    if args.mtu_schedule:
+        try:
+            parse_mtu_schedule(args.mtu_schedule)
+        except ValueError as e:
+            sys.exit("--mtu-schedule: %s" % e)
+
+    thumb = FakeThumb(args)
+    try:
+        asyncio.run(thumb.run())
+    except KeyboardInterrupt:
+        pass
+    thumb.report()
+    if args.writes:
+        thumb.save_writes(args.writes)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,144 @@
+#!/usr/bin/env python3
+"""Seed corpus for the host fuzz harnesses in firmware/test/host/fuzz.
+
+Telemetry seeds are frames of the fake_thumb.py ride, the same bytes the
+simulated receiver notifies: the 55-byte layout and v2 frames for several
+cell counts, at points of the ride from parked to full speed, the same
+frames wrapped in ESP-NOW TELEMETRY packets (main/espnow_packet.h), and
+fake_thumb's truncated and random corrupt frames. Console seeds are the
+commands of the USB console with typical and borderline arguments.
+
+The output is deterministic, so a rerun only changes files when the frame
+layout or the command set has changed:
+
+    fuzz_corpus.py                      # writes firmware/test/host/fuzz/corpus
+    fuzz_corpus.py --out /tmp/corpus
+"""
+
+import argparse
+import os
+import random
+import struct
+import sys
+
+import fake_thumb
+
+CORPUS_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "test", "host", "fuzz", "corpus")
+
+ESPNOW_MAGIC = ord("G")
+ESPNOW_TELEMETRY = 2
+ESPNOW_PING = 3
+
+CONSOLE_LINES = [
+    "help",
+    "get_config",
+    "GET_CONFIG",
+    "  get_firmware_version",
+    "reset_odometer",
+    "set_motor_pulley 15",
+    "set_wheel_pulley\t36",
+    "set_wheel_size 90",
+    "set_motor_poles 14",
+    "set_motor_poles 0",
+    "set_motor_poles 256",
+    "set_motor_poles -1",
+    "set_motor_poles 99999999999",
+    "set_motor_poles 14x",
+    "calibrate_throttle",
+    "get_calibration",
+    "set_speed_unit_kmh",
+    "set_speed_unit_mph",
+    "log_status",
+    "log_rate 50",
+    "log_export",
+    "log_erase",
+    "get_stats",
+    "set_pack_cells 12",
+    "set_pack_capacity 10000",
+    "get_range",
+    "get_cells",
+    "stream 20",
+    "stream 0",
+    "stream x",
+    "bench_latency",
+    "espnow on",
+    "espnow off",
+    "espnow bench",
+    "espnow pair ble",
+    "espnow pair aa:bb:cc:dd:ee:ff",
+    "espnow pair AA:BB:CC:DD:EE:FF 00112233445566778899aabbccddeeff",
+    "espnow pair aa:bb:cc:dd:ee",
+    "espnow unpair",
+    "ota",
+    "links",
+    "links reset",
+    "residency",
+    "lvgl_heap",
+    "glass",
+    "glass reset",
+    "deadline",
+    "deadline reset",
+    "telemetry",
+    "telemetry csv",
+    "telemetry bench 100",
+    "bench",
+    "bench radio 4",
+    "ble_backend",
+    "ble_backend ping 500",
+    "x" * 80,
+]
+
+
+def espnow_packet(ptype, seq, payload):
+    return struct.pack("<BBH", ESPNOW_MAGIC, ptype, seq) + payload
+
+
+def telemetry_seeds():
+    seeds = {}
+    for version in (1, 2):
+        for cells in (0, 1, 10, 12, 16):
+            ride = fake_thumb.Ride(cells, version=version)
+            for t in (0.0, 5.0, 10.0, 30.0, 600.0):
+                seeds["v%d_c%02d_t%03d" % (version, cells, t)] = ride.frame(t)
+
+    # The full 55-byte frame is longer than an ESP-NOW payload may be, the
+    # receiver sends v2 there
+    seq = 0
+    for name, frame in sorted(seeds.items()):
+        if name.startswith("v2") and len(frame) <= 64:
+            seeds["espnow_" + name] = espnow_packet(ESPNOW_TELEMETRY, seq, frame)
+            seq += 7
+    seeds["espnow_ping"] = espnow_packet(ESPNOW_PING, 0xFFFF, struct.pack("<I", 123456))
+
+    rng = random.Random(63)
+    for i in range(8):
+        seeds["corrupt_%d" % i] = fake_thumb.corrupt_frame(rng)
+    seeds["empty"] = b""
+    return seeds
+
+
+def console_seeds():
+    return {"cmd_%02d" % i: line.encode() for i, line in enumerate(CONSOLE_LINES)}
+
+
+def write_corpus(directory, seeds):
+    os.makedirs(directory, exist_ok=True)
+    for name, data in seeds.items():
+        with open(os.path.join(directory, name), "wb") as f:
+            f.write(data)
+    return len(seeds)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--out", default=CORPUS_DIR, help="corpus root, one directory per harness")
+    args = parser.parse_args()
+
+    count = write_corpus(os.path.join(args.out, "fuzz_telemetry_decode"), telemetry_seeds())
+    count += write_corpus(os.path.join(args.out, "fuzz_console_parse"), console_seeds())
+    print("%d seeds written to %s" % (count, os.path.normpath(args.out)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
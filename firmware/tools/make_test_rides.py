@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""Rides for the range estimator replay test, firmware/test/host/rides.
+
+Writes the CSV that ride_log_to_csv.py makes of a ride log export, for two
+rides of a 12S 10 Ah pack with a BMS, recorded at 2 Hz:
+
+    cruise.csv  12 min around town, 15-25 km/h with stops and regen
+    climb.csv   5 min cruise, 2 min climb at 2 kW (~50 A) with heavy sag, 5 min cruise
+
+The pack is simulated with its own open-circuit curve and 160 mOhm of
+internal resistance, both a little off from the model in range.c as a
+real pack would be, plus sensor noise. The BMS columns hold the true
+remaining charge, so the test can strip them to replay the same ride as
+a voltage-only one and still know the truth. Deterministic; rerun after a
+change to the ride log channels:
+
+    make_test_rides.py
+"""
+
+import csv
+import math
+import os
+import random
+import sys
+
+import ride_log_to_csv
+import telemetry_schema
+
+RIDES_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "test", "host", "rides")
+
+RATE_HZ = 2
+CELLS = 12
+CAPACITY_AH = 10.0
+RESISTANCE_OHM = 0.16
+START_SOC = 0.9
+RECORDS_PER_BLOCK = 200
+
+# Default geometry (15/33 pulleys, 115 mm wheels, 14 poles): mm/s per ERPM
+MM_S_PER_ERPM = 115 * math.pi / 60 * 15 / 33 / 14
+
+# (soc, cell mV) of the simulated cells
+OCV = [(0.0, 3000), (0.03, 3300), (0.08, 3450), (0.15, 3550), (0.25, 3620),
+       (0.35, 3680), (0.45, 3730), (0.55, 3790), (0.65, 3860), (0.75, 3940),
+       (0.85, 4020), (0.95, 4100), (1.0, 4190)]
+
+
+def ocv_mv(soc):
+    for (s0, v0), (s1, v1) in zip(OCV, OCV[1:]):
+        if soc <= s1:
+            return v0 + (v1 - v0) * (max(soc, s0) - s0) / (s1 - s0)
+    return OCV[-1][1]
+
+
+def cruise_kmh(t):
+    """Town riding: a speed wave, and a 15 s stop every 4 minutes."""
+    into_cycle = t % 240
+    if into_cycle >= 225:
+        return 0.0
+    speed = 20 + 5 * math.sin(2 * math.pi * t / 90)
+    if into_cycle < 10:
+        speed *= into_cycle / 10                # Pulling away
+    elif into_cycle > 215:
+        speed *= (225 - into_cycle) / 10        # Braking into the stop
+    return speed
+
+
+def cruise_power_w(t, speed_kmh):
+    into_cycle = t % 240
+    if 215 < into_cycle < 225:
+        return -90.0                            # Regen while braking
+    return 10 * speed_kmh + 0.015 * speed_kmh ** 3 + (150 if into_cycle < 10 else 0)
+
+
+def climb_profile(t):
+    """(km/h, W): cruise, a 2 minute climb, cruise."""
+    if 300 <= t < 420:
+        return 12.0, 2000.0
+    speed = cruise_kmh(t)
+    return speed, cruise_power_w(t, speed)
+
+
+class Pack:
+    def __init__(self, rng):
+        self.rng = rng
+        self.soc = START_SOC
+
+    def step(self, power_w, dt):
+        """(pack V, pack A) for dt seconds at power_w, draining the pack."""
+        ocv = ocv_mv(self.soc) * CELLS / 1000.0
+        # P = (OCV - I R) I, the smaller root
+        disc = ocv * ocv - 4 * RESISTANCE_OHM * power_w
+        current = (ocv - math.sqrt(max(disc, 0.0))) / (2 * RESISTANCE_OHM)
+        self.soc -= current * dt / 3600.0 / CAPACITY_AH
+        voltage = ocv - current * RESISTANCE_OHM
+        return voltage + self.rng.gauss(0, 0.04), current + self.rng.gauss(0, 0.1)
+
+
+def ride_rows(duration_s, profile, seed):
+    rng = random.Random(seed)
+    pack = Pack(rng)
+    rows = []
+    dt = 1.0 / RATE_HZ
+    for i in range(int(duration_s * RATE_HZ)):
+        t = i * dt
+        speed_kmh, power_w = profile(t)
+        voltage, current = pack.step(power_w, dt)
+        erpm = round(speed_kmh / 3.6 * 1000 / MM_S_PER_ERPM)
+        cell_v = voltage / CELLS
+        values = {
+            "erpm": erpm,
+            "current_motor": current * (1.4 if speed_kmh > 0 else 0),
+            "current_in": current,
+            "temp_mos": 30 + t / 60,
+            "temp_motor": 28 + t / 45,
+            "voltage": voltage,
+            "bms_voltage": voltage,
+            "bms_current": current,
+            "bms_remaining": pack.soc * CAPACITY_AH,
+            "throttle_raw": 0,
+            "throttle_mapped": 128,
+            "throttle_sent": 128,
+            "rssi_dbm": -60,
+            "num_cells": CELLS,
+        }
+        row = [1, i // RECORDS_PER_BLOCK, int(t * 1000)]
+        for name, scale in ride_log_to_csv.CHANNELS:
+            value = values[name]
+            row.append(int(value) if scale == 1 else round(value, 2))
+        row += [round(cell_v + rng.gauss(0, 0.003), 3) for _ in range(CELLS)]
+        row += [0.0] * (ride_log_to_csv.MAX_CELLS - CELLS)
+        rows.append(row)
+    return rows
+
+
+def write_ride(name, rows):
+    header = (["boot_id", "block_seq", "time_ms"] + [name for name, _ in ride_log_to_csv.CHANNELS] +
+              telemetry_schema.CELL_COLUMNS)
+    path = os.path.join(RIDES_DIR, name)
+    with open(path, "w", newline="") as f:
+        writer = csv.writer(f)
+        writer.writerow(header)
+        writer.writerows(rows)
+    print("%s: %d records" % (os.path.normpath(path), len(rows)))
+
+
+def main():
+    os.makedirs(RIDES_DIR, exist_ok=True)
+    write_ride("cruise.csv", ride_rows(12 * 60, lambda t: (cruise_kmh(t), cruise_power_w(t, cruise_kmh(t))), 56))
+    write_ride("climb.csv", ride_rows(12 * 60, climb_profile, 57))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+"""Convert a ride log export from the remote into CSV.
+
+The remote answers the `log_export` console command with:
+
+    RIDELOG <block_count> <block_size>\\n
+    <block_count * block_size raw bytes, oldest block first>
+    RIDELOG END\\n
+
+Usage:
+    ride_log_to_csv.py --port /dev/ttyACM0 -o ride.csv
+    ride_log_to_csv.py --input export.bin -o ride.csv
+
+Reading from a port needs pyserial. Use --save to keep the raw export.
+`usbproto.py export` fetches the same stream over the binary protocol.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+import time
+import zlib
+
+import telemetry_schema
+
+BLOCK_MAGIC = 0x474F4C52
+BLOCK_VERSION = 1
+HEADER = struct.Struct("<IHHIIIHHI")
+MAX_CELLS = telemetry_schema.MAX_CELLS
+
+# ride_log_channel_t in firmware/main/ride_recorder.h: the telemetry fields
+# of RIDE_LOG_TELEMETRY_FIELDS, named and scaled by the schema, then the
+# channels the recorder adds. (CSV column, raw units per unit)
+CHANNELS = [(field.name, field.scale) for field in telemetry_schema.RIDE_LOG_FIELDS] + [
+    ("throttle_raw", 1),
+    ("throttle_mapped", 1),
+    ("throttle_sent", 1),
+    ("rssi_dbm", 1),
+    (telemetry_schema.COUNT_FIELD, 1),
+]
+CELL_BASE = len(CHANNELS)
+CHANNEL_COUNT = CELL_BASE + MAX_CELLS
+
+
+def read_uvarint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        if pos >= len(data):
+            raise ValueError("truncated varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, pos
+        shift += 7
+        if shift > 35:
+            raise ValueError("varint too long")
+
+
+def read_svarint(data, pos):
+    value, pos = read_uvarint(data, pos)
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def decode_block(block):
+    """Yield (header, records) for a block, or None if it is not valid."""
+    if len(block) < HEADER.size:
+        return None
+    (magic, version, record_count, seq, boot_id, start_time_ms,
+     payload_bytes, _reserved, crc) = HEADER.unpack_from(block)
+    if magic != BLOCK_MAGIC or version != BLOCK_VERSION:
+        return None
+    if payload_bytes > len(block) - HEADER.size:
+        return None
+    payload = block[HEADER.size:HEADER.size + payload_bytes]
+    if zlib.crc32(payload, zlib.crc32(block[:HEADER.size - 4])) != crc:
+        return None
+
+    records = []
+    prev = [0] * CHANNEL_COUNT
+    time_ms = start_time_ms
+    pos = 0
+    for _ in range(record_count):
+        dt_ms, pos = read_uvarint(payload, pos)
+        time_ms += dt_ms
+        values = list(prev)
+        ch = 0
+        while ch < CELL_BASE + min(values[CELL_BASE - 1], MAX_CELLS):
+            delta, pos = read_svarint(payload, pos)
+            values[ch] = prev[ch] + delta
+            ch += 1
+        # Cells beyond num_cells are not encoded and read back as zero
+        for i in range(ch, CHANNEL_COUNT):
+            values[i] = 0
+        prev = values
+        records.append((time_ms, values))
+
+    header = {"seq": seq, "boot_id": boot_id}
+    return header, records
+
+
+def read_export(stream):
+    """Read one export from a binary stream, skipping console text before it."""
+    while True:
+        line = stream.readline()
+        if not line:
+            raise EOFError("no RIDELOG preamble found")
+        line = line.strip()
+        if line.startswith(b"RIDELOG ") and line != b"RIDELOG END":
+            _, count, size = line.split()
+            break
+
+    count = int(count)
+    size = int(size)
+    blocks = []
+    for _ in range(count):
+        block = b""
+        while len(block) < size:
+            chunk = stream.read(size - len(block))
+            if not chunk:
+                raise EOFError("export ended after %d of %d blocks" % (len(blocks), count))
+            block += chunk
+        blocks.append(block)
+    return blocks
+
+
+class SerialStream:
+    def __init__(self, port, baud, timeout):
+        import serial  # pyserial, only needed for live export
+        self.serial = serial.Serial(port, baud, timeout=timeout)
+        self.serial.reset_input_buffer()
+        self.serial.write(b"log_export\r")
+        self.raw = bytearray()
+
+    def readline(self):
+        line = self.serial.readline()
+        self.raw += line
+        return line
+
+    def read(self, n):
+        data = self.serial.read(n)
+        self.raw += data
+        return data
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port of the remote")
+    source.add_argument("--input", help="previously saved raw export")
+    parser.add_argument("--baud", type=int, default=115200)
+    parser.add_argument("--timeout", type=float, default=10.0)
+    parser.add_argument("--save", help="also write the raw export to this file")
+    parser.add_argument("-o", "--output", help="CSV file (default: stdout)")
+    args = parser.parse_args()
+
+    if args.port:
+        stream = SerialStream(args.port, args.baud, args.timeout)
+        started = time.time()
+        blocks = read_export(stream)
+        print("Read %d blocks in %.1f s" % (len(blocks), time.time() - started), file=sys.stderr)
+        if args.save:
+            with open(args.save, "wb") as f:
+                f.write(stream.raw)
+    else:
+        with open(args.input, "rb") as f:
+            blocks = read_export(f)
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.writer(out)
+    writer.writerow(["boot_id", "block_seq", "time_ms"] +
+                    [name for name, _ in CHANNELS] +
+                    telemetry_schema.CELL_COLUMNS)
+
+    bad = 0
+    rows = 0
+    for block in blocks:
+        decoded = decode_block(block)
+        if decoded is None:
+            bad += 1
+            continue
+        header, records = decoded
+        for time_ms, values in records:
+            row = [header["boot_id"], header["seq"], time_ms]
+            for (_, scale), value in zip(CHANNELS, values):
+                row.append(value if scale == 1 else round(value / scale, 2))
+            row += [round(mv / telemetry_schema.CELL_SCALE, 3) for mv in values[CELL_BASE:]]
+            writer.writerow(row)
+            rows += 1
+
+    if out is not sys.stdout:
+        out.close()
+    print("%d records from %d blocks, %d blocks skipped" % (rows, len(blocks) - bad, bad),
+          file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
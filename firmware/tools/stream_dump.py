@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Live telemetry and throttle stream from the remote (firmware/main/stream.h).
+
+Asks the remote to stream at the given rate and prints the records as they
+arrive, or writes them to CSV. Ctrl-C stops the stream.
+
+    stream_dump.py --port /dev/ttyACM0 --rate 50
+    stream_dump.py --port /dev/ttyACM0 --rate 100 --csv bench.csv
+
+Telemetry and throttle records go to the same CSV, told apart by the kind
+column; fields that do not apply to a kind are left empty, as are the
+cells past the record's count. Cells are in volts under the same
+cell1_v.. columns as ride_log_to_csv.py writes. The dropped
+column counts records the remote lost because the host read too slowly.
+
+Needs pyserial.
+"""
+
+import argparse
+import csv
+import struct
+import sys
+
+from telemetry_schema import CELL_COLUMNS, CELL_SCALE, FIELDS, STREAM_FIELDS, format_line
+from usbproto import MSG_STATUS, MSG_STREAM, MSG_STREAM_DATA, REPLY, ProtocolError, Remote
+
+KIND_TELEMETRY = 1
+KIND_THROTTLE = 2
+
+# Raw snapshot members, in the record order of STREAM_TELEMETRY_FIELDS
+TELEMETRY_FIELDS = [field.member for field in STREAM_FIELDS]
+THROTTLE_FIELDS = ["throttle_raw", "throttle_mapped", "throttle_sent"]
+COLUMNS = ["time_ms", "kind", "dropped"] + TELEMETRY_FIELDS + CELL_COLUMNS + THROTTLE_FIELDS
+
+
+def read_uvarint(data, pos):
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return value, pos
+        shift += 7
+
+
+def read_svarint(data, pos):
+    value, pos = read_uvarint(data, pos)
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def decode_stream_frame(payload):
+    """Records of one STREAM_DATA payload as dicts, in time order."""
+    dropped, time_ms, count = struct.unpack_from("<IIB", payload)
+    pos = 9
+    records = []
+    for _ in range(count):
+        kind = payload[pos]
+        dt_ms, pos = read_uvarint(payload, pos + 1)
+        time_ms = (time_ms + dt_ms) & 0xFFFFFFFF
+        record = {"time_ms": time_ms, "dropped": dropped}
+        if kind == KIND_TELEMETRY:
+            record["kind"] = "telemetry"
+            for field in TELEMETRY_FIELDS:
+                record[field], pos = read_svarint(payload, pos)
+            cells = payload[pos]
+            pos += 1
+            prev = 0
+            for column in CELL_COLUMNS[:cells]:
+                delta, pos = read_svarint(payload, pos)
+                prev += delta
+                record[column] = round(prev / CELL_SCALE, 3)
+        elif kind == KIND_THROTTLE:
+            record["kind"] = "throttle"
+            record["throttle_raw"], pos = read_svarint(payload, pos)
+            record["throttle_mapped"] = payload[pos]
+            record["throttle_sent"] = payload[pos + 1]
+            pos += 2
+        else:
+            raise ProtocolError("unknown stream record kind %d" % kind)
+        records.append(record)
+    return records
+
+
+def format_record(record):
+    if record["kind"] == "throttle":
+        return "%10d  throttle  raw %5d  mapped %3d  sent %3d" % (
+            record["time_ms"], record["throttle_raw"], record["throttle_mapped"],
+            record["throttle_sent"])
+    # Same "name=value unit" line as the remote logs, stream fields are the raw members
+    values = {field.name: record[field.member] / field.scale if field.scale > 1 else record[field.member]
+              for field in FIELDS if field.member in record}
+    return "%10d  telemetry  %s" % (record["time_ms"], format_line(values))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", required=True, help="serial port of the remote")
+    parser.add_argument("--rate", type=int, default=50, help="records per second and kind, 1-100")
+    parser.add_argument("--csv", help="write records to this file instead of printing them")
+    args = parser.parse_args()
+
+    with Remote(args.port) as remote:
+        remote.expect_ok(remote.request(MSG_STREAM, struct.pack("<H", args.rate), expect=MSG_STATUS))
+        out = None
+        writer = None
+        if args.csv:
+            out = open(args.csv, "w", newline="")
+            writer = csv.DictWriter(out, fieldnames=COLUMNS)
+            writer.writeheader()
+
+        total = 0
+        dropped = 0
+        lost_frames = 0
+        next_seq = None
+        try:
+            while True:
+                rtype, seq, payload = remote.receive()
+                if rtype != MSG_STREAM_DATA | REPLY:
+                    continue
+                if next_seq is not None and seq != next_seq:
+                    lost_frames += (seq - next_seq) & 0xFF
+                next_seq = (seq + 1) & 0xFF
+                for record in decode_stream_frame(payload):
+                    dropped = record["dropped"]
+                    total += 1
+                    if writer:
+                        writer.writerow(record)
+                    else:
+                        print(format_record(record))
+                if writer:
+                    sys.stderr.write("\r%d records, %d dropped" % (total, dropped))
+        except KeyboardInterrupt:
+            pass
+        finally:
+            remote.send(MSG_STREAM, struct.pack("<H", 0))
+            if out:
+                out.close()
+        sys.stderr.write("\n%d records, %d dropped on the remote, %d frames lost\n" %
+                         (total, dropped, lost_frames))
+
+
+if __name__ == "__main__":
+    main()
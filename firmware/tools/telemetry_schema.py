@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Telemetry notify layout, read from TELEMETRY_SCHEMA in the firmware.
+
+main/telemetry_schema.h is the one description of the 55-byte frame the
+receiver notifies. This module parses its X-macro rows at import, so the
+host tools encode and decode exactly what the firmware does without a
+second copy of the offsets and scales:
+
+    from telemetry_schema import FIELDS, FRAME_LEN, encode, decode
+    frame = encode({"erpm": 12000, "voltage": 41.2}, cell_mv=[4120] * 10)
+    values, cells = decode(frame)
+    print(format_line(values))
+
+Values are scaled (volts, amps, degrees), missing fields are sent as 0.
+encode(..., version=2) leaves out the unused cells (TELEMETRY_SCHEMA_V2_LEN).
+RIDE_LOG_FIELDS and STREAM_FIELDS are the fields of the ride log and the
+USB stream records, in their record order. CELL_COLUMNS are the CSV
+column names of the cells, cell1_v..cell16_v in volts, from
+TELEMETRY_SCHEMA_CELL_NAME. Run it to print the table.
+"""
+
+import os
+import re
+import struct
+from collections import namedtuple
+
+MAIN_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "main")
+SCHEMA_H = os.path.join(MAIN_DIR, "telemetry_schema.h")
+TELEMETRY_H = os.path.join(MAIN_DIR, "telemetry.h")
+
+Field = namedtuple("Field", "id name member type offset scale unit")
+
+WIRE_FORMATS = {"U8": "B", "I16": "h", "I32": "i"}
+
+_ROW = re.compile(r'X\(\s*(\w+)\s*,\s*"(\w+)"\s*,\s*(\w+)\s*,\s*(U8|I16|I32)\s*,\s*(\d+)\s*,'
+                  r'\s*(\d+)\s*,\s*"([^"]*)"\s*\)')
+
+
+def _define(text, name):
+    match = re.search(r"#define\s+%s\s+(\d+)" % name, text)
+    if not match:
+        raise RuntimeError("%s not found" % name)
+    return int(match.group(1))
+
+
+def _string_define(text, name):
+    match = re.search(r'#define\s+%s\s+"([^"]*)"' % name, text)
+    if not match:
+        raise RuntimeError("%s not found" % name)
+    return match.group(1)
+
+
+def _field_list(schema, macro, fields):
+    """Fields named by an X(ID) list macro such as RIDE_LOG_TELEMETRY_FIELDS, in its order."""
+    body = re.search(r"#define %s\(X\)(.*?)\n\n" % macro, schema, re.S)
+    if not body:
+        raise RuntimeError("%s not found in %s" % (macro, SCHEMA_H))
+    by_id = {field.id: field for field in fields}
+    return [by_id[field_id] for field_id in re.findall(r"X\((\w+)\)", body.group(1))]
+
+
+def _load():
+    with open(SCHEMA_H) as f:
+        schema = f.read()
+    with open(TELEMETRY_H) as f:
+        telemetry = f.read()
+    body = re.search(r"#define TELEMETRY_SCHEMA\(X\)(.*?)\n\n", schema, re.S)
+    if not body:
+        raise RuntimeError("TELEMETRY_SCHEMA not found in %s" % SCHEMA_H)
+    fields = [Field(m[0], m[1], m[2], m[3], int(m[4]), int(m[5]), m[6])
+              for m in _ROW.findall(body.group(1))]
+    return (fields, _field_list(schema, "RIDE_LOG_TELEMETRY_FIELDS", fields),
+            _field_list(schema, "STREAM_TELEMETRY_FIELDS", fields),
+            _define(schema, "TELEMETRY_SCHEMA_CELLS_OFS"),
+            _define(schema, "TELEMETRY_SCHEMA_CELL_SCALE"), _string_define(schema, "TELEMETRY_SCHEMA_CELL_NAME"),
+            _define(telemetry, "TELEMETRY_MAX_CELLS"))
+
+
+FIELDS, RIDE_LOG_FIELDS, STREAM_FIELDS, CELLS_OFS, CELL_SCALE, CELL_NAME, MAX_CELLS = _load()
+CELL_COLUMNS = [CELL_NAME % (i + 1) for i in range(MAX_CELLS)]
+FRAME_LEN = CELLS_OFS + MAX_CELLS * 2
+COUNT_FIELD = "num_cells"
+COUNT_OFS = next(field.offset for field in FIELDS if field.name == COUNT_FIELD)
+
+
+def v2_len(cells):
+    return CELLS_OFS + cells * 2
+
+
+def encode(values, cell_mv=(), version=1):
+    """Frame from {name: scaled value}; num_cells follows cell_mv. Version 2
+    only carries the valid cells."""
+    cells = [int(mv) for mv in list(cell_mv)[:MAX_CELLS]]
+    frame = bytearray(FRAME_LEN)
+    for field in FIELDS:
+        if field.name == COUNT_FIELD:
+            raw = len(cells)
+        else:
+            raw = round(values.get(field.name, 0) * field.scale)
+        struct.pack_into(">" + WIRE_FORMATS[field.type], frame, field.offset, raw)
+    struct.pack_into(">%dh" % MAX_CELLS, frame, CELLS_OFS, *(cells + [0] * (MAX_CELLS - len(cells))))
+    if version == 2:
+        return bytes(frame[:v2_len(len(cells))])
+    return bytes(frame)
+
+
+def decode(frame):
+    """({name: scaled value}, [cell mV]) of a frame, like telemetry_decode_frame."""
+    if len(frame) != FRAME_LEN:
+        if len(frame) <= COUNT_OFS or frame[COUNT_OFS] >= MAX_CELLS or len(frame) != v2_len(frame[COUNT_OFS]):
+            raise ValueError("telemetry frame is %d bytes, neither %d nor v2" % (len(frame), FRAME_LEN))
+        frame = bytes(frame) + bytes(FRAME_LEN - len(frame))
+    values = {}
+    for field in FIELDS:
+        raw = struct.unpack_from(">" + WIRE_FORMATS[field.type], frame, field.offset)[0]
+        values[field.name] = raw / field.scale if field.scale > 1 else raw
+    count = min(int(values.get(COUNT_FIELD, 0)), MAX_CELLS)
+    cells = list(struct.unpack_from(">%dh" % MAX_CELLS, frame, CELLS_OFS))[:count]
+    return values, cells
+
+
+def format_value(field, value):
+    """Scaled value with as many decimals as the scale, like telemetry_format_field."""
+    if field.scale <= 1:
+        return "%d" % value
+    return "%.*f" % (len(str(field.scale)) - 1, value)
+
+
+def format_line(values):
+    """"name=value unit" for the fields in values, like telemetry_format_line."""
+    parts = []
+    for field in FIELDS:
+        if field.name in values:
+            text = "%s=%s" % (field.name, format_value(field, values[field.name]))
+            parts.append(text + " " + field.unit if field.unit else text)
+    return " ".join(parts)
+
+
+if __name__ == "__main__":
+    for field in FIELDS:
+        print("%-14s %-3s @%-3d /%-4d %s" % (field.name, field.type, field.offset, field.scale, field.unit))
+    print("cells          I16 @%-3d x%d, %d frame bytes" % (CELLS_OFS, MAX_CELLS, FRAME_LEN))
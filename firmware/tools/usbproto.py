@@ -0,0 +1,378 @@
+#!/usr/bin/env python3
+"""Host side of the remote's binary USB protocol (firmware/main/usb_proto.h).
+
+Frames are 0x00, COBS(type | seq | payload | crc32 LE), 0x00 and share the
+port with the text console. Console and log text around the frames is
+ignored. Used as a library:
+
+    from usbproto import Remote
+    with Remote("/dev/ttyACM0") as remote:
+        print(remote.ping())
+        settings = remote.get_settings()
+        settings["wheel_diameter_mm"] = 100
+        remote.set_settings(settings)
+
+or from the command line:
+
+    usbproto.py --port /dev/ttyACM0 ping
+    usbproto.py --port /dev/ttyACM0 settings [key=value ...]
+    usbproto.py --port /dev/ttyACM0 stats
+    usbproto.py --port /dev/ttyACM0 telemetry
+    usbproto.py --port /dev/ttyACM0 system
+    usbproto.py --port /dev/ttyACM0 calibrate
+    usbproto.py --port /dev/ttyACM0 export -o ride.bin   # then ride_log_to_csv.py --input
+    usbproto.py --port /dev/ttyACM0 bench [--bytes N]
+
+Needs pyserial.
+"""
+
+import argparse
+import struct
+import sys
+import time
+import zlib
+
+PROTO_VERSION = 1
+MAX_PAYLOAD = 512
+REPLY = 0x80
+
+MSG_PING = 0x01
+MSG_GET_SETTINGS = 0x02
+MSG_SET_SETTINGS = 0x03
+MSG_CALIBRATE = 0x04
+MSG_GET_CALIBRATION = 0x05
+MSG_GET_STATS = 0x06
+MSG_LOG_EXPORT = 0x07
+MSG_LOG_DATA = 0x08
+MSG_GET_TELEMETRY = 0x09
+MSG_ECHO = 0x0A
+MSG_DISCARD = 0x0B
+MSG_BULK_READ = 0x0C
+MSG_BULK_DATA = 0x0D
+MSG_STREAM = 0x0E
+MSG_STREAM_DATA = 0x0F
+MSG_GET_SYSTEM = 0x10
+MSG_STATUS = 0x7F
+
+# Must match settings_t in firmware/main/settings.h (packed)
+SETTINGS_FIELDS = [
+    ("motor_pulley", "B"), ("wheel_pulley", "B"), ("wheel_diameter_mm", "B"),
+    ("motor_poles", "B"), ("speed_unit_mph", "B"), ("invert_throttle", "B"),
+    ("throttle_calibrated", "B"), ("reserved0", "B"),
+    ("throttle_min", "I"), ("throttle_max", "I"), ("brake_min", "I"), ("brake_max", "I"),
+    ("pack_cells_series", "B"), ("reserved1", "B"), ("pack_capacity_mah", "H"),
+]
+SETTINGS = struct.Struct("<" + "".join(f for _, f in SETTINGS_FIELDS))
+
+CALIBRATION = struct.Struct("<BII")
+STATS_FIELDS = ["trip_mm", "total_mm", "ride_time_ms", "moving_time_ms", "max_speed_mm_s",
+                "avg_speed_mm_s", "energy_drawn_mwh", "energy_regen_mwh", "wh_per_km_x10",
+                "peak_temp_mos_c100", "peak_temp_motor_c100"]
+STATS = struct.Struct("<QQIIIIIIihh")
+NO_TEMP = -32768    # RIDE_STATS_NO_TEMP, no peak temperature yet
+
+MAX_CELLS = 16
+TELEMETRY_FIELDS = ["rx_time_us", "frame_seq", "erpm", "temp_mos_c100", "temp_motor_c100",
+                    "current_motor_c100", "current_in_c100", "voltage_c100", "bms_voltage_c100",
+                    "bms_current_c100", "bms_remaining_c100", "bms_nominal_c100", "bms_num_cells"]
+TELEMETRY = struct.Struct("<qIi9hB%dhiBBb" % MAX_CELLS)
+
+SYSTEM_FIELDS = ["uptime_ms", "free_heap", "min_free_heap", "free_internal",
+                 "frames_decoded", "frames_rejected", "connects"]
+SYSTEM = struct.Struct("<7I")
+
+
+def cobs_encode(data):
+    out = bytearray([0])
+    code_pos = 0
+    code = 1
+    for byte in data:
+        if byte == 0:
+            out[code_pos] = code
+            code_pos = len(out)
+            out.append(0)
+            code = 1
+        else:
+            out.append(byte)
+            code += 1
+            if code == 0xFF:
+                out[code_pos] = code
+                code_pos = len(out)
+                out.append(0)
+                code = 1
+    out[code_pos] = code
+    return bytes(out)
+
+
+def cobs_decode(data):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        code = data[pos]
+        pos += 1
+        if code == 0 or pos + code - 1 > len(data):
+            raise ValueError("bad COBS data")
+        out += data[pos:pos + code - 1]
+        pos += code - 1
+        if code != 0xFF and pos < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+def encode_frame(msg_type, seq, payload=b""):
+    body = bytes([msg_type, seq]) + payload
+    body += struct.pack("<I", zlib.crc32(body))
+    return b"\x00" + cobs_encode(body) + b"\x00"
+
+
+def decode_frame(encoded):
+    """Returns (type, seq, payload) or None for anything that is not a valid frame."""
+    try:
+        body = cobs_decode(encoded)
+    except ValueError:
+        return None
+    if len(body) < 6:
+        return None
+    crc, = struct.unpack_from("<I", body, len(body) - 4)
+    if zlib.crc32(body[:-4]) != crc:
+        return None
+    return body[0], body[1], body[2:-4]
+
+
+class ProtocolError(Exception):
+    pass
+
+
+class Remote:
+    def __init__(self, port, timeout=5.0):
+        import serial  # pyserial
+        self.serial = serial.Serial(port, 115200, timeout=timeout)
+        self.timeout = timeout
+        self.seq = 0
+        self.pending = bytearray()
+        self.serial.reset_input_buffer()
+
+    def close(self):
+        self.serial.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def console(self, line, wait=1.0):
+        """Types a text console command, returns what it printed within wait seconds."""
+        self.serial.write(line.encode() + b"\n")
+        deadline = time.time() + wait
+        text = bytearray()
+        while time.time() < deadline:
+            text += self.serial.read(max(1, self.serial.in_waiting))
+        return text.decode(errors="replace").replace("\r\n", "\n")
+
+    def send(self, msg_type, payload=b""):
+        self.seq = (self.seq + 1) & 0xFF
+        self.serial.write(encode_frame(msg_type, self.seq, payload))
+        return self.seq
+
+    def receive(self, timeout=None):
+        """Next valid frame from the device, skipping console text."""
+        deadline = time.time() + (timeout or self.timeout)
+        while time.time() < deadline:
+            while True:
+                start = self.pending.find(b"\x00")
+                if start < 0:
+                    self.pending.clear()
+                    break
+                end = self.pending.find(b"\x00", start + 1)
+                if end < 0:
+                    del self.pending[:start]
+                    break
+                encoded = bytes(self.pending[start + 1:end])
+                if not encoded:
+                    # Closing delimiter of one frame, opening of the next
+                    del self.pending[:start + 1]
+                    continue
+                frame = decode_frame(encoded)
+                if frame is None:
+                    # Text between frames; its closing zero may open the next one
+                    del self.pending[:end]
+                    continue
+                del self.pending[:end + 1]
+                return frame
+            self.pending += self.serial.read(max(1, self.serial.in_waiting))
+        raise ProtocolError("timed out waiting for a frame")
+
+    def request(self, msg_type, payload=b"", expect=None, timeout=None):
+        seq = self.send(msg_type, payload)
+        expect = (msg_type if expect is None else expect) | REPLY
+        while True:
+            rtype, rseq, rpayload = self.receive(timeout)
+            if rseq != seq:
+                continue
+            if rtype == MSG_STATUS | REPLY and expect != rtype:
+                status, = struct.unpack("<i", rpayload)
+                raise ProtocolError("device returned error 0x%x" % status)
+            if rtype == expect:
+                return rpayload
+
+    def expect_ok(self, payload):
+        status, = struct.unpack("<i", payload)
+        if status != 0:
+            raise ProtocolError("device returned error 0x%x" % status)
+
+    def ping(self):
+        payload = self.request(MSG_PING)
+        return payload[0], payload[1:].rstrip(b"\x00").decode()
+
+    def get_settings(self):
+        payload = self.request(MSG_GET_SETTINGS)
+        # Older firmware sends a shorter struct; newer fields keep defaults of 0
+        payload = payload[:SETTINGS.size].ljust(SETTINGS.size, b"\x00")
+        return dict(zip((name for name, _ in SETTINGS_FIELDS), SETTINGS.unpack(payload)))
+
+    def set_settings(self, settings):
+        payload = SETTINGS.pack(*(settings[name] for name, _ in SETTINGS_FIELDS))
+        self.expect_ok(self.request(MSG_SET_SETTINGS, payload, expect=MSG_STATUS))
+
+    def calibrate(self):
+        payload = self.request(MSG_CALIBRATE, expect=MSG_GET_CALIBRATION, timeout=30)
+        return dict(zip(("calibrated", "min", "max"), CALIBRATION.unpack(payload)))
+
+    def get_calibration(self):
+        payload = self.request(MSG_GET_CALIBRATION)
+        return dict(zip(("calibrated", "min", "max"), CALIBRATION.unpack(payload)))
+
+    def get_stats(self):
+        stats = dict(zip(STATS_FIELDS, STATS.unpack(self.request(MSG_GET_STATS))))
+        for key in ("peak_temp_mos_c100", "peak_temp_motor_c100"):
+            if stats[key] == NO_TEMP:
+                stats[key] = None
+        return stats
+
+    def get_telemetry(self):
+        values = TELEMETRY.unpack(self.request(MSG_GET_TELEMETRY))
+        result = dict(zip(TELEMETRY_FIELDS, values))
+        base = len(TELEMETRY_FIELDS)
+        result["cell_mv"] = list(values[base:base + MAX_CELLS])
+        result["throttle_raw"], result["throttle_mapped"], result["throttle_sent"], result["rssi"] = \
+            values[base + MAX_CELLS:]
+        return result
+
+    def get_system(self):
+        return dict(zip(SYSTEM_FIELDS, SYSTEM.unpack(self.request(MSG_GET_SYSTEM))))
+
+    def export_log(self):
+        """Raw export stream, same bytes as the text log_export command."""
+        seq = self.send(MSG_LOG_EXPORT)
+        data = bytearray()
+        while True:
+            rtype, rseq, payload = self.receive(timeout=30)
+            if rseq != seq:
+                continue
+            if rtype == MSG_LOG_DATA | REPLY:
+                offset, = struct.unpack_from("<I", payload)
+                if offset != len(data):
+                    raise ProtocolError("export gap at %d (expected %d)" % (offset, len(data)))
+                data += payload[4:]
+            elif rtype == MSG_STATUS | REPLY:
+                self.expect_ok(payload)
+                return bytes(data)
+
+    def bench_download(self, total):
+        seq = self.send(MSG_BULK_READ, struct.pack("<I", total))
+        started = time.time()
+        received = 0
+        while True:
+            rtype, rseq, payload = self.receive()
+            if rseq != seq:
+                continue
+            if rtype == MSG_BULK_DATA | REPLY:
+                received += len(payload)
+            elif rtype == MSG_STATUS | REPLY:
+                self.expect_ok(payload)
+                return received, time.time() - started
+
+    def bench_upload(self, total):
+        chunk = bytes((i * 7 + 1) & 0xFF or 1 for i in range(MAX_PAYLOAD))
+        started = time.time()
+        sent = 0
+        while sent < total:
+            n = min(total - sent, MAX_PAYLOAD)
+            self.expect_ok(self.request(MSG_DISCARD, chunk[:n], expect=MSG_STATUS))
+            sent += n
+        return sent, time.time() - started
+
+    def bench_round_trip(self, count):
+        started = time.time()
+        for i in range(count):
+            self.request(MSG_ECHO, struct.pack("<I", i))
+        return (time.time() - started) / count
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", required=True, help="serial port of the remote")
+    parser.add_argument("--timeout", type=float, default=5.0)
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("ping")
+    settings = sub.add_parser("settings", help="print, or change with key=value")
+    settings.add_argument("changes", nargs="*")
+    sub.add_parser("stats")
+    sub.add_parser("telemetry")
+    sub.add_parser("system", help="uptime, heap and BLE link counters")
+    sub.add_parser("calibrate")
+    export = sub.add_parser("export", help="raw ride log export for ride_log_to_csv.py --input")
+    export.add_argument("-o", "--output", required=True)
+    bench = sub.add_parser("bench", help="measure link throughput in both directions")
+    bench.add_argument("--bytes", type=int, default=256 * 1024)
+    args = parser.parse_args()
+
+    with Remote(args.port, args.timeout) as remote:
+        if args.command == "ping":
+            version, firmware = remote.ping()
+            print("protocol %d, firmware %s" % (version, firmware))
+        elif args.command == "settings":
+            current = remote.get_settings()
+            if args.changes:
+                for change in args.changes:
+                    key, value = change.split("=", 1)
+                    if key not in current:
+                        sys.exit("unknown setting: %s" % key)
+                    current[key] = int(value, 0)
+                remote.set_settings(current)
+                current = remote.get_settings()
+            for key, value in current.items():
+                print("%s = %d" % (key, value))
+        elif args.command == "stats":
+            for key, value in remote.get_stats().items():
+                print("%s = %d" % (key, value))
+        elif args.command == "telemetry":
+            for key, value in remote.get_telemetry().items():
+                print("%s = %s" % (key, value))
+        elif args.command == "system":
+            for key, value in remote.get_system().items():
+                print("%s = %d" % (key, value))
+        elif args.command == "calibrate":
+            print("Move the throttle through its full range...")
+            print(remote.calibrate())
+        elif args.command == "export":
+            started = time.time()
+            data = remote.export_log()
+            with open(args.output, "wb") as f:
+                f.write(data)
+            print("%d bytes in %.1f s" % (len(data), time.time() - started))
+        elif args.command == "bench":
+            rtt = remote.bench_round_trip(100)
+            print("round trip: %.2f ms" % (rtt * 1000))
+            received, elapsed = remote.bench_download(args.bytes)
+            print("device -> host: %d bytes in %.2f s, %.1f KB/s" %
+                  (received, elapsed, received / elapsed / 1024))
+            sent, elapsed = remote.bench_upload(args.bytes)
+            print("host -> device: %d bytes in %.2f s, %.1f KB/s" %
+                  (sent, elapsed, sent / elapsed / 1024))
+
+
+if __name__ == "__main__":
+    main()